@@ -188,6 +188,14 @@ CONSTANT(int, Xapian, DB_BACKEND_HONEY);
 CONSTANT(int, Xapian, DB_BACKEND_INMEMORY);
 CONSTANT(int, Xapian, DB_BACKEND_STUB);
 CONSTANT(int, Xapian, DB_RETRY_LOCK);
+CONSTANT(int, Xapian, DB_MMAP);
+CONSTANT(int, Xapian, DB_MMAP_RANDOM);
+CONSTANT(int, Xapian, DB_MMAP_WILLNEED);
+CONSTANT(int, Xapian, DB_DOCLEN_COLUMN);
+CONSTANT(int, Xapian, DB_COLUMNAR_VALUES);
+CONSTANT(int, Xapian, DB_WRITE_AHEAD_LOG);
+CONSTANT(int, Xapian, DB_COMPRESS_LZ4);
+CONSTANT(int, Xapian, DB_COMPRESS_ZSTD);
 CONSTANT(int, Xapian, DBCHECK_SHORT_TREE);
 CONSTANT(int, Xapian, DBCHECK_FULL_TREE);
 CONSTANT(int, Xapian, DBCHECK_SHOW_FREELIST);
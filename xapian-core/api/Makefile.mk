@@ -3,6 +3,8 @@ noinst_HEADERS +=\
 	api/documentvaluelist.h\
 	api/editdistance.h\
 	api/enquireinternal.h\
+	api/filtercacheinternal.h\
+	api/msetcacheinternal.h\
 	api/msetinternal.h\
 	api/result.h\
 	api/postingiteratorinternal.h\
@@ -31,9 +33,11 @@ lib_src +=\
 	api/enquire.cc\
 	api/error.cc\
 	api/expanddecider.cc\
+	api/filtercache.cc\
 	api/keymaker.cc\
 	api/matchspy.cc\
 	api/mset.cc\
+	api/msetcache.cc\
 	api/msetiterator.cc\
 	api/result.cc\
 	api/positioniterator.cc\
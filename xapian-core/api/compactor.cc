@@ -79,6 +79,19 @@ class CmpByFirstUsed {
     }
 };
 
+/// Append a setting for @a table (or all tables if empty) to @a settings.
+static void
+append_table_setting(string& settings, const string& table,
+		     const string& value)
+{
+    if (!settings.empty()) settings += ',';
+    if (!table.empty()) {
+	settings += table;
+	settings += '=';
+    }
+    settings += value;
+}
+
 namespace Xapian {
 
 Compactor::~Compactor() { }
@@ -99,6 +112,18 @@ Compactor::resolve_duplicate_metadata(const string & key,
     return tags[0];
 }
 
+void
+Compactor::set_honey_index_type(const string& type, const string& table)
+{
+    append_table_setting(honey_index_types, table, type);
+}
+
+void
+Compactor::set_honey_bloom_bits(unsigned bits, const string& table)
+{
+    append_table_setting(honey_bloom_bits, table, str(bits));
+}
+
 }
 
 [[noreturn]]
@@ -37,6 +37,10 @@
 #include <xapian/termiterator.h>
 #include <xapian/unicode.h>
 
+#ifdef XAPIAN_HAS_GLASS_BACKEND
+# include "backends/glass/glass_blockcache.h"
+#endif
+
 #include <algorithm>
 #include <cstdlib> // For abs().
 #include <memory>
@@ -519,12 +523,78 @@ Database::unlock() {
     return Xapian::Database(internal->update_lock(Xapian::DB_READONLY_));
 }
 
+size_t
+Database::get_readahead_issued() const
+{
+    size_t issued = 0, used = 0;
+    internal->get_readahead_stats(issued, used);
+    return issued;
+}
+
+size_t
+Database::get_readahead_used() const
+{
+    size_t issued = 0, used = 0;
+    internal->get_readahead_stats(issued, used);
+    return used;
+}
+
 Xapian::rev
 Database::get_revision() const
 {
     return internal->get_revision();
 }
 
+void
+Database::set_block_cache_size(size_t size)
+{
+#ifdef XAPIAN_HAS_GLASS_BACKEND
+    GlassBlockCache::get_shared().set_capacity(size);
+#else
+    (void)size;
+#endif
+}
+
+size_t
+Database::get_block_cache_size()
+{
+#ifdef XAPIAN_HAS_GLASS_BACKEND
+    return GlassBlockCache::get_shared().get_capacity();
+#else
+    return 0;
+#endif
+}
+
+unsigned long long
+Database::get_block_cache_hits()
+{
+#ifdef XAPIAN_HAS_GLASS_BACKEND
+    return GlassBlockCache::get_shared().get_stats().hits;
+#else
+    return 0;
+#endif
+}
+
+unsigned long long
+Database::get_block_cache_misses()
+{
+#ifdef XAPIAN_HAS_GLASS_BACKEND
+    return GlassBlockCache::get_shared().get_stats().misses;
+#else
+    return 0;
+#endif
+}
+
+unsigned long long
+Database::get_block_cache_evictions()
+{
+#ifdef XAPIAN_HAS_GLASS_BACKEND
+    return GlassBlockCache::get_shared().get_stats().evictions;
+#else
+    return 0;
+#endif
+}
+
 string
 Database::reconstruct_text(Xapian::docid did,
 			   size_t length,
@@ -541,6 +611,30 @@ WritableDatabase::commit()
     internal->commit();
 }
 
+void
+WritableDatabase::commit_async()
+{
+    internal->commit_async();
+}
+
+void
+WritableDatabase::wait_for_commit()
+{
+    internal->wait_for_commit();
+}
+
+void
+WritableDatabase::set_flush_memory_limit(size_t limit)
+{
+    internal->set_flush_memory_limit(limit);
+}
+
+size_t
+WritableDatabase::get_buffered_memory() const
+{
+    return internal->get_buffered_memory();
+}
+
 void
 WritableDatabase::begin_transaction(bool flushed)
 {
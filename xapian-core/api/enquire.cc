@@ -27,6 +27,9 @@
 #include "expand/expandweight.h"
 #include "matcher/matcher.h"
 #include "msetinternal.h"
+#include "net/serialise.h"
+#include "pack.h"
+#include "serialise-double.h"
 #include "vectortermlist.h"
 #include "weight/weightinternal.h"
 #include "xapian/database.h"
@@ -195,6 +198,36 @@ Enquire::set_time_limit(double time_limit)
     internal->time_limit = time_limit;
 }
 
+void
+Enquire::set_match_threads(unsigned n_threads)
+{
+    internal->match_threads = n_threads;
+}
+
+void
+Enquire::set_mset_cache(const MSetCache& cache)
+{
+    internal->mset_cache = cache.internal.get();
+}
+
+void
+Enquire::clear_mset_cache()
+{
+    internal->mset_cache = NULL;
+}
+
+void
+Enquire::set_filter_cache(const FilterCache& cache)
+{
+    internal->filter_cache = cache.internal.get();
+}
+
+void
+Enquire::clear_filter_cache()
+{
+    internal->filter_cache = NULL;
+}
+
 MSet
 Enquire::get_mset(doccount first,
 		  doccount maxitems,
@@ -288,6 +321,23 @@ Enquire::Internal::get_mset(doccount first,
 	checkatleast = max(checkatleast, first + maxitems);
     }
 
+    string cache_key;
+    if (mset_cache.get()) {
+	cache_key = get_cache_key(first, maxitems, checkatleast, rset,
+				  mdecider);
+	string serialised;
+	if (!cache_key.empty() && mset_cache->find(cache_key, serialised)) {
+	    MSet mset;
+	    mset.internal->unserialise(serialised.data(),
+				       serialised.data() + serialised.size());
+	    if (first_orig != first) {
+		mset.internal->set_first(first_orig);
+	    }
+	    mset.internal->set_enquire(this);
+	    return mset;
+	}
+    }
+
     unique_ptr<Xapian::Weight::Internal> stats(new Xapian::Weight::Internal);
     ::Matcher match(db,
 		    query,
@@ -306,6 +356,10 @@ Enquire::Internal::get_mset(doccount first,
 		    sort_val_reverse,
 		    time_limit,
 		    matchspies);
+    if (filter_cache.get()) {
+	match.set_filter_cache(filter_cache.get());
+    }
+    match.set_range_databases(&range_dbs);
 
     MSet mset = match.get_mset(first,
 			       maxitems,
@@ -323,19 +377,77 @@ Enquire::Internal::get_mset(doccount first,
 			       sort_by,
 			       sort_val_reverse,
 			       time_limit,
+			       match_threads,
 			       matchspies);
 
+    if (!mset.internal->get_stats()) {
+	mset.internal->set_stats(stats.release());
+    }
+
+    if (!cache_key.empty()) {
+	mset_cache->add(cache_key, mset.internal->serialise());
+    }
+
     if (first_orig != first && mset.internal.get()) {
 	mset.internal->set_first(first_orig);
     }
 
     mset.internal->set_enquire(this);
 
-    if (!mset.internal->get_stats()) {
-	mset.internal->set_stats(stats.release());
+    return mset;
+}
+
+string
+Enquire::Internal::get_cache_key(doccount first,
+				 doccount maxitems,
+				 doccount checkatleast,
+				 const RSet* rset,
+				 const MatchDecider* mdecider) const
+{
+    // The results must be fully determined by what goes into the key, which
+    // rules out anything which calls back into user code in a way we can't
+    // serialise, or whose side effects the caller relies on.
+    if (mdecider || !matchspies.empty() || time_limit != 0.0)
+	return string();
+
+    string key = db.internal->get_cache_key();
+    if (key.empty())
+	return key;
+
+    string weight_name = weight->name();
+    if (weight_name.empty())
+	return string();
+
+    try {
+	pack_string(key, query.serialise());
+	pack_string(key, weight_name);
+	pack_string(key, weight->serialise());
+	if (sort_functor.get()) {
+	    pack_string(key, sort_functor->name());
+	    pack_string(key, sort_functor->serialise());
+	} else {
+	    pack_string(key, string());
+	}
+    } catch (const Xapian::UnimplementedError&) {
+	return string();
     }
 
-    return mset;
+    pack_uint(key, query_length);
+    pack_uint(key, unsigned(order));
+    pack_uint(key, unsigned(sort_by));
+    pack_uint(key, sort_key);
+    pack_bool(key, sort_val_reverse);
+    pack_uint(key, collapse_key);
+    pack_uint(key, collapse_max);
+    pack_uint(key, unsigned(percent_threshold));
+    key += serialise_double(weight_threshold);
+    pack_uint(key, first);
+    pack_uint(key, maxitems);
+    pack_uint(key, checkatleast);
+    if (rset) {
+	key += serialise_rset(*rset);
+    }
+    return key;
 }
 
 TermIterator
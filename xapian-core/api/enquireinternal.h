@@ -22,6 +22,8 @@
 #define XAPIAN_INCLUDED_ENQUIREINTERNAL_H
 
 #include "backends/databaseinternal.h"
+#include "filtercacheinternal.h"
+#include "msetcacheinternal.h"
 #include "xapian/constants.h"
 #include "xapian/database.h"
 #include "xapian/enquire.h"
@@ -79,10 +81,34 @@ class Enquire::Internal : public Xapian::Internal::intrusive_base {
 
     double time_limit = 0.0;
 
+    unsigned match_threads = 0;
+
+    /** Other instances of the database for matching docid ranges.
+     *
+     *  Kept between searches so they don't need opening again each time.
+     */
+    mutable std::vector<Xapian::Database> range_dbs;
+
+    /// Cache of search results to use (NULL for none).
+    Xapian::Internal::intrusive_ptr<MSetCache::Internal> mset_cache;
+
+    /// Cache of the documents matching filter subqueries (NULL for none).
+    Xapian::Internal::intrusive_ptr<FilterCache::Internal> filter_cache;
+
     enum { EXPAND_TRAD, EXPAND_BO1 } eweight = EXPAND_TRAD;
 
     double expand_k = 1.0;
 
+    /** Build the key to cache the results of a search under.
+     *
+     *  @return The key, or an empty string if the search can't be cached.
+     */
+    std::string get_cache_key(doccount first,
+			      doccount maxitems,
+			      doccount checkatleast,
+			      const RSet* rset,
+			      const MatchDecider* mdecider) const;
+
   public:
     explicit
     Internal(const Database& db_);
@@ -0,0 +1,212 @@
+/** @file
+ * @brief Cache of the documents matching filter subqueries
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "xapian/filtercache.h"
+
+#include "filtercacheinternal.h"
+#include "omassert.h"
+#include "str.h"
+
+using namespace std;
+
+FilterDocidSet::FilterDocidSet(vector<Xapian::docid>&& dids)
+    : count(dids.size())
+{
+    if (dids.empty()) return;
+    first = dids.front();
+    last = dids.back();
+    size_t nbits = size_t(last - first) + 1;
+    if (posting_bitmap_size(nbits) < dids.size() * sizeof(Xapian::docid)) {
+	bitmap.resize(posting_bitmap_size(nbits));
+	auto bits = reinterpret_cast<unsigned char*>(&bitmap[0]);
+	for (Xapian::docid did : dids) {
+	    posting_bitmap_set(bits, did - first);
+	}
+    } else {
+	swap(docids, dids);
+	docids.shrink_to_fit();
+    }
+}
+
+namespace Xapian {
+
+FilterCache::FilterCache(const FilterCache&) = default;
+
+FilterCache&
+FilterCache::operator=(const FilterCache&) = default;
+
+FilterCache::FilterCache(FilterCache&&) = default;
+
+FilterCache&
+FilterCache::operator=(FilterCache&&) = default;
+
+FilterCache::FilterCache(size_t max_size, unsigned min_uses)
+    : internal(new FilterCache::Internal(max_size, min_uses)) {}
+
+FilterCache::~FilterCache() {}
+
+size_t
+FilterCache::size() const
+{
+    lock_guard<std::mutex> lock(internal->mutex);
+    return internal->n_sets;
+}
+
+size_t
+FilterCache::get_memory_used() const
+{
+    lock_guard<std::mutex> lock(internal->mutex);
+    return internal->current_size;
+}
+
+size_t
+FilterCache::get_hits() const
+{
+    lock_guard<std::mutex> lock(internal->mutex);
+    return internal->hits;
+}
+
+size_t
+FilterCache::get_misses() const
+{
+    lock_guard<std::mutex> lock(internal->mutex);
+    return internal->misses;
+}
+
+size_t
+FilterCache::get_evictions() const
+{
+    lock_guard<std::mutex> lock(internal->mutex);
+    return internal->evictions;
+}
+
+void
+FilterCache::clear()
+{
+    lock_guard<std::mutex> lock(internal->mutex);
+    internal->index.clear();
+    internal->entries.clear();
+    internal->current_size = 0;
+    internal->n_sets = 0;
+}
+
+string
+FilterCache::get_description() const
+{
+    lock_guard<std::mutex> lock(internal->mutex);
+    string desc = "FilterCache(";
+    desc += str(internal->n_sets);
+    desc += " entries, ";
+    desc += str(internal->current_size);
+    desc += '/';
+    desc += str(internal->max_size);
+    desc += " bytes, hits=";
+    desc += str(internal->hits);
+    desc += ", misses=";
+    desc += str(internal->misses);
+    desc += ", evictions=";
+    desc += str(internal->evictions);
+    desc += ')';
+    return desc;
+}
+
+void
+FilterCache::Internal::remove(entry_iterator i)
+{
+    current_size -= entry_size(*i);
+    if (i->docids) --n_sets;
+    index.erase(i->key);
+    entries.erase(i);
+}
+
+void
+FilterCache::Internal::make_room(size_t size)
+{
+    while (current_size + size > max_size) {
+	Assert(!entries.empty());
+	auto oldest = prev(entries.end());
+	if (oldest->docids) ++evictions;
+	remove(oldest);
+    }
+}
+
+shared_ptr<const FilterDocidSet>
+FilterCache::Internal::find(const string& key, bool& build)
+{
+    lock_guard<std::mutex> lock(mutex);
+    build = false;
+    auto i = index.find(key);
+    if (i == index.end()) {
+	++misses;
+	build = (min_uses <= 1);
+	if (!build) {
+	    // Remember the filter has been used once.
+	    Entry entry(key);
+	    size_t size = entry_size(entry);
+	    if (size <= max_size) {
+		make_room(size);
+		entries.push_front(move(entry));
+		index.emplace(key, entries.begin());
+		current_size += size;
+	    }
+	}
+	return nullptr;
+    }
+
+    // Move the entry to the front as it's now the most recently used.
+    entries.splice(entries.begin(), entries, i->second);
+    Entry& entry = *i->second;
+    if (entry.docids) {
+	++hits;
+	return entry.docids;
+    }
+    ++misses;
+    build = (++entry.uses >= min_uses);
+    return nullptr;
+}
+
+void
+FilterCache::Internal::add(const string& key,
+			   const shared_ptr<const FilterDocidSet>& docids)
+{
+    lock_guard<std::mutex> lock(mutex);
+    auto i = index.find(key);
+    if (i != index.end()) {
+	// Either the entry recording earlier uses, or the same filter was
+	// added by a search running in parallel.
+	remove(i->second);
+    }
+
+    Entry entry(key);
+    entry.docids = docids;
+    size_t size = entry_size(entry);
+    if (size > max_size) {
+	// Don't discard everything else for something which won't fit.
+	return;
+    }
+    make_room(size);
+    entries.push_front(move(entry));
+    index.emplace(key, entries.begin());
+    current_size += size;
+    ++n_sets;
+}
+
+}
@@ -0,0 +1,204 @@
+/** @file
+ * @brief Cache of the documents matching filter subqueries
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_FILTERCACHEINTERNAL_H
+#define XAPIAN_INCLUDED_FILTERCACHEINTERNAL_H
+
+#include "backends/docidsearch.h"
+#include "backends/postingbitmap.h"
+#include "xapian/filtercache.h"
+#include "xapian/intrusive_ptr.h"
+#include "xapian/types.h"
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/** Set of the docids matching a filter in a shard.
+ *
+ *  This is stored as a bitmap of the docids from the first to the last (see
+ *  backends/postingbitmap.h) if that's smaller than an array of the docids,
+ *  which is the case for filters matching more than about one document in
+ *  32.
+ */
+class FilterDocidSet {
+    /// The first docid in the set (0 if the set is empty).
+    Xapian::docid first = 0;
+
+    /// The last docid in the set (0 if the set is empty).
+    Xapian::docid last = 0;
+
+    /// The number of docids in the set.
+    Xapian::doccount count;
+
+    /// The bitmap, if the set is stored as a bitmap.
+    std::string bitmap;
+
+    /// The docids in ascending order, if the set isn't stored as a bitmap.
+    std::vector<Xapian::docid> docids;
+
+  public:
+    /// Construct from @a dids, which must be in ascending order.
+    explicit FilterDocidSet(std::vector<Xapian::docid>&& dids);
+
+    /// Return the number of docids in the set.
+    Xapian::doccount size() const { return count; }
+
+    /// Return the approximate number of bytes used by this object.
+    std::size_t get_memory_used() const {
+	return sizeof(*this) + bitmap.size() +
+	       docids.size() * sizeof(Xapian::docid);
+    }
+
+    /** Find the first docid in the set which is >= @a did.
+     *
+     *  @param did	The docid to start from (must be > 0).
+     *  @param pos	Used to search forwards from the previous position
+     *			when the set is stored as an array.  Should be 0
+     *			initially, and then passed back in with @a did
+     *			increasing on each call.
+     *
+     *  @return The docid found, or 0 if there isn't one.
+     */
+    Xapian::docid find(Xapian::docid did, std::size_t& pos) const {
+	if (did > last) return 0;
+	if (did < first) did = first;
+	if (!bitmap.empty()) {
+	    // The bit for the last docid is set so we'll always find one.
+	    auto bits = reinterpret_cast<const unsigned char*>(bitmap.data());
+	    std::size_t nbits = std::size_t(last - first) + 1;
+	    return first + Xapian::docid(posting_bitmap_find(bits, nbits,
+							     did - first));
+	}
+	auto i = find_docid_ge(docids.data() + pos,
+			       docids.data() + docids.size(),
+			       did);
+	pos = i - docids.data();
+	return *i;
+    }
+
+    /** Return the docids from the one at @a pos, if stored as an array.
+     *
+     *  @param pos		Position as set by find().
+     *  @param[out] block_end	Set to the end of the docids.
+     *
+     *  @return Pointer to the docid at @a pos, or NULL if the set is stored
+     *		as a bitmap.
+     */
+    const Xapian::docid* get_block(std::size_t pos,
+				   const Xapian::docid*& block_end) const {
+	if (docids.empty()) return NULL;
+	block_end = docids.data() + docids.size();
+	return docids.data() + pos;
+    }
+};
+
+namespace Xapian {
+
+class FilterCache::Internal : public Xapian::Internal::intrusive_base {
+    friend class FilterCache;
+
+    struct Entry {
+	/// Key identifying the shard and the filter subquery.
+	std::string key;
+
+	/// The matching docids (NULL until the filter has been used enough).
+	std::shared_ptr<const FilterDocidSet> docids;
+
+	/// Number of times the filter has been used.
+	unsigned uses = 1;
+
+	explicit Entry(const std::string& key_) : key(key_) {}
+    };
+
+    /// Protects all the other members.
+    mutable std::mutex mutex;
+
+    /// Cached entries, most recently used first.
+    std::list<Entry> entries;
+
+    typedef decltype(entries)::iterator entry_iterator;
+
+    /// Index from key to the entry in @a entries.
+    std::unordered_map<std::string, entry_iterator> index;
+
+    /// Approximate maximum size of the cache in bytes.
+    std::size_t max_size;
+
+    /// Number of uses of a filter before we store its matching docids.
+    unsigned min_uses;
+
+    /// Approximate current size of the cache in bytes.
+    std::size_t current_size = 0;
+
+    /// Number of entries with docids stored.
+    std::size_t n_sets = 0;
+
+    std::size_t hits = 0;
+
+    std::size_t misses = 0;
+
+    std::size_t evictions = 0;
+
+    /// Approximate size in bytes of an entry.
+    static std::size_t entry_size(const Entry& entry) {
+	// Allow for the list node, hash table node and string objects.
+	std::size_t size = entry.key.size() * 2 + 128;
+	if (entry.docids) size += entry.docids->get_memory_used();
+	return size;
+    }
+
+    /// Remove @a i from the cache.
+    void remove(entry_iterator i);
+
+    /// Remove entries until @a size more bytes will fit.
+    void make_room(std::size_t size);
+
+  public:
+    Internal(std::size_t max_size_, unsigned min_uses_)
+	: max_size(max_size_), min_uses(min_uses_) {}
+
+    /** Look up a filter.
+     *
+     *  @param key		Key identifying the shard and filter subquery.
+     *  @param[out] build	Set to true if the filter isn't cached but has
+     *				now been used enough times that the caller
+     *				should find its matching docids and add() them.
+     *
+     *  @return The matching docids, or NULL if they aren't cached.
+     */
+    std::shared_ptr<const FilterDocidSet> find(const std::string& key,
+					       bool& build);
+
+    /** Add the docids matching a filter.
+     *
+     *  @param key		Key identifying the shard and filter subquery.
+     *  @param docids	The matching docids.
+     */
+    void add(const std::string& key,
+	     const std::shared_ptr<const FilterDocidSet>& docids);
+};
+
+}
+
+#endif // XAPIAN_INCLUDED_FILTERCACHEINTERNAL_H
@@ -0,0 +1,149 @@
+/** @file
+ * @brief Cache of search results
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "xapian/msetcache.h"
+
+#include "msetcacheinternal.h"
+#include "omassert.h"
+#include "str.h"
+
+using namespace std;
+
+namespace Xapian {
+
+MSetCache::MSetCache(const MSetCache&) = default;
+
+MSetCache&
+MSetCache::operator=(const MSetCache&) = default;
+
+MSetCache::MSetCache(MSetCache&&) = default;
+
+MSetCache&
+MSetCache::operator=(MSetCache&&) = default;
+
+MSetCache::MSetCache(size_t max_size)
+    : internal(new MSetCache::Internal(max_size)) {}
+
+MSetCache::~MSetCache() {}
+
+size_t
+MSetCache::size() const
+{
+    lock_guard<std::mutex> lock(internal->mutex);
+    return internal->entries.size();
+}
+
+size_t
+MSetCache::get_hits() const
+{
+    lock_guard<std::mutex> lock(internal->mutex);
+    return internal->hits;
+}
+
+size_t
+MSetCache::get_misses() const
+{
+    lock_guard<std::mutex> lock(internal->mutex);
+    return internal->misses;
+}
+
+void
+MSetCache::clear()
+{
+    lock_guard<std::mutex> lock(internal->mutex);
+    internal->index.clear();
+    internal->entries.clear();
+    internal->current_size = 0;
+}
+
+string
+MSetCache::get_description() const
+{
+    lock_guard<std::mutex> lock(internal->mutex);
+    string desc = "MSetCache(";
+    desc += str(internal->entries.size());
+    desc += " entries, ";
+    desc += str(internal->current_size);
+    desc += '/';
+    desc += str(internal->max_size);
+    desc += " bytes, hits=";
+    desc += str(internal->hits);
+    desc += ", misses=";
+    desc += str(internal->misses);
+    desc += ')';
+    return desc;
+}
+
+void
+MSetCache::Internal::remove_oldest()
+{
+    Assert(!entries.empty());
+    auto& entry = entries.back();
+    current_size -= entry_size(entry.first, entry.second);
+    index.erase(entry.first);
+    entries.pop_back();
+}
+
+bool
+MSetCache::Internal::find(const string& key, string& value)
+{
+    lock_guard<std::mutex> lock(mutex);
+    auto i = index.find(key);
+    if (i == index.end()) {
+	++misses;
+	return false;
+    }
+    ++hits;
+    // Move the entry to the front as it's now the most recently used.
+    entries.splice(entries.begin(), entries, i->second);
+    value = i->second->second;
+    return true;
+}
+
+void
+MSetCache::Internal::add(const string& key, const string& value)
+{
+    lock_guard<std::mutex> lock(mutex);
+    size_t size = entry_size(key, value);
+    if (size > max_size) {
+	// Don't discard everything else for something which won't fit.
+	return;
+    }
+
+    auto i = index.find(key);
+    if (i != index.end()) {
+	// This can happen if the same search is run again before the
+	// results of the first are added.
+	current_size -= entry_size(key, i->second->second);
+	entries.erase(i->second);
+	index.erase(i);
+    }
+
+    while (current_size + size > max_size) {
+	remove_oldest();
+    }
+
+    entries.emplace_front(key, value);
+    index.emplace(key, entries.begin());
+    current_size += size;
+}
+
+}
@@ -0,0 +1,91 @@
+/** @file
+ * @brief Xapian::MSetCache internals
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_MSETCACHEINTERNAL_H
+#define XAPIAN_INCLUDED_MSETCACHEINTERNAL_H
+
+#include "xapian/intrusive_ptr.h"
+#include "xapian/msetcache.h"
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace Xapian {
+
+class MSetCache::Internal : public Xapian::Internal::intrusive_base {
+    friend class MSetCache;
+
+    /// Protects all the other members.
+    mutable std::mutex mutex;
+
+    /// Cached entries (key and serialised MSet), most recently used first.
+    std::list<std::pair<std::string, std::string>> entries;
+
+    typedef decltype(entries)::iterator entry_iterator;
+
+    /// Index from key to the entry in @a entries.
+    std::unordered_map<std::string, entry_iterator> index;
+
+    /// Approximate maximum size of the cache in bytes.
+    std::size_t max_size;
+
+    /// Approximate current size of the cache in bytes.
+    std::size_t current_size = 0;
+
+    std::size_t hits = 0;
+
+    std::size_t misses = 0;
+
+    /// Approximate size in bytes of an entry.
+    static std::size_t entry_size(const std::string& key,
+				  const std::string& value) {
+	// Allow for the list node, hash table node and string objects.
+	return key.size() * 2 + value.size() + 128;
+    }
+
+    /// Remove the least recently used entry.
+    void remove_oldest();
+
+  public:
+    explicit Internal(std::size_t max_size_) : max_size(max_size_) {}
+
+    /** Look up a search.
+     *
+     *  @param key		Key describing the search.
+     *  @param[out] value	The serialised MSet, if found.
+     *
+     *  @return true if found.
+     */
+    bool find(const std::string& key, std::string& value);
+
+    /** Add the results of a search.
+     *
+     *  @param key		Key describing the search.
+     *  @param value	The serialised MSet.
+     */
+    void add(const std::string& key, const std::string& value);
+};
+
+}
+
+#endif // XAPIAN_INCLUDED_MSETCACHEINTERNAL_H
@@ -46,6 +46,7 @@
 #include "matcher/queryoptimiser.h"
 #include "matcher/valuerangepostlist.h"
 #include "matcher/valuegepostlist.h"
+#include "matcher/wandpostlist.h"
 #include "pack.h"
 #include "serialise-double.h"
 #include "stringutils.h"
@@ -242,7 +243,9 @@ Context<T>::expand_wildcard(const QueryWildcard* query,
     if (expansions_left == 0)
 	--expansions_left;
     while (true) {
-	t->next();
+	// A segmented shard gives a MultiAllTermsList, which can prune.
+	if (TermList* ret = t->next())
+	    t.reset(ret);
 done_skip_to:
 	if (t->at_end())
 	    break;
@@ -259,7 +262,8 @@ done_skip_to:
 	    skip_ucase = false;
 	    if (term[0] <= 'Z') {
 		static_assert('Z' + 1 == '[', "'Z' + 1 == '['");
-		t->skip_to("[");
+		if (TermList* ret = t->skip_to("["))
+		    t.reset(ret);
 		goto done_skip_to;
 	    }
 	}
@@ -316,7 +320,9 @@ Context<T>::expand_edit_distance(const QueryEditDistance* query,
     if (expansions_left == 0)
 	--expansions_left;
     while (true) {
-	t->next();
+	// A segmented shard gives a MultiAllTermsList, which can prune.
+	if (TermList* ret = t->next())
+	    t.reset(ret);
 done_skip_to:
 	if (t->at_end())
 	    break;
@@ -334,7 +340,8 @@ done_skip_to:
 	    skip_ucase = false;
 	    if (term[0] <= 'Z') {
 		static_assert('Z' + 1 == '[', "'Z' + 1 == '['");
-		t->skip_to("[");
+		if (TermList* ret = t->skip_to("["))
+		    t.reset(ret);
 		goto done_skip_to;
 	    }
 	}
@@ -440,6 +447,16 @@ OrContext::postlist()
 
     qopt->add_op(EstimateOp::OR, pls.size());
 
+    if (pls.size() >= qopt->get_wand_min_subqueries()) {
+	// For a wide OR, a single WandPostList can skip documents which can't
+	// make it into the MSet far more effectively than a tree of binary
+	// OrPostList objects, since it considers all the subqueries together.
+	PostList* pl = new WandPostList(pls.begin(), pls.end(),
+					qopt->matcher, qopt->db_size);
+	pls.clear();
+	return pl;
+    }
+
     // Make postlists into a heap so that the postlist with the greatest term
     // frequency is at the top of the heap.
     init_tf();
@@ -1153,7 +1170,8 @@ QueryPostingSource::postlist(QueryOptimiser * qopt, double factor) const
 	    const_cast<Xapian::Database::Internal*>(&(qopt->db)));
     RETURN(new ExternalPostList(wrappeddb, source.get(), estimate_op, factor,
 				qopt->matcher->get_max_weight_cached_flag_ptr(),
-				qopt->shard_index));
+				qopt->shard_index,
+				qopt->matching_docid_range()));
 }
 
 PostList*
@@ -2499,33 +2517,42 @@ QueryAndMaybe::postlist_sub_and_like(AndContext& ctx,
     return true;
 }
 
+/** Add an unweighted filter subquery to an AndContext.
+ *
+ *  If there's a filter cache, the documents the filter matches may be read
+ *  from it rather than running the subquery.
+ */
+static bool
+filter_sub_and_like(const Query& subq, AndContext& ctx, QueryOptimiser* qopt)
+{
+    PostList* pl;
+    if (qopt->open_cached_filter(subq, pl))
+	return ctx.add_postlist(pl);
+    return subq.internal->postlist_sub_and_like(ctx, qopt, 0.0);
+}
+
 PostList*
 QueryFilter::postlist(QueryOptimiser * qopt, double factor) const
 {
     LOGCALL(QUERY, PostList*, "QueryFilter::postlist", qopt | factor);
     AndContext ctx(qopt, subqueries.size());
-    for (const auto& subq : subqueries) {
-	// MatchNothing subqueries should have been removed by done().
-	Assert(subq.internal.get());
-	if (!subq.internal->postlist_sub_and_like(ctx, qopt, factor))
-	    break;
-	// Second and subsequent subqueries are unweighted.
-	factor = 0.0;
-    }
+    postlist_sub_and_like(ctx, qopt, factor);
     RETURN(ctx.postlist());
 }
 
 bool
 QueryFilter::postlist_sub_and_like(AndContext& ctx, QueryOptimiser * qopt, double factor) const
 {
-    QueryVector::const_iterator i;
-    for (i = subqueries.begin(); i != subqueries.end(); ++i) {
-	// MatchNothing subqueries should have been removed by done().
+    QueryVector::const_iterator i = subqueries.begin();
+    // MatchNothing subqueries should have been removed by done().
+    Assert((*i).internal.get());
+    if (!(*i).internal->postlist_sub_and_like(ctx, qopt, factor))
+	return false;
+    // Second and subsequent subqueries are unweighted.
+    while (++i != subqueries.end()) {
 	Assert((*i).internal.get());
-	if (!(*i).internal->postlist_sub_and_like(ctx, qopt, factor))
+	if (!filter_sub_and_like(*i, ctx, qopt))
 	    return false;
-	// Second and subsequent subqueries are unweighted.
-	factor = 0.0;
     }
     return true;
 }
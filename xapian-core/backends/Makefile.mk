@@ -6,12 +6,14 @@ noinst_HEADERS +=\
 	backends/databasehelpers.h\
 	backends/databaseinternal.h\
 	backends/databasereplicator.h\
+	backends/docidsearch.h\
 	backends/documentinternal.h\
 	backends/empty_database.h\
 	backends/flint_lock.h\
 	backends/leafpostlist.h\
 	backends/multi.h\
 	backends/positionlist.h\
+	backends/postingbitmap.h\
 	backends/postlist.h\
 	backends/prefix_compressed_strings.h\
 	backends/slowvaluelist.h\
@@ -29,6 +31,7 @@ lib_src +=\
 	backends/databaseinternal.cc\
 	backends/databasereplicator.cc\
 	backends/dbfactory.cc\
+	backends/docidsearch.cc\
 	backends/documentinternal.cc\
 	backends/empty_database.cc\
 	backends/leafpostlist.cc\
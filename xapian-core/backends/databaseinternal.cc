@@ -26,6 +26,7 @@
 #include "api/termlist.h"
 #include "heap.h"
 #include "omassert.h"
+#include "pack.h"
 #include "postlist.h"
 #include "slowvaluelist.h"
 #include "stringutils.h"
@@ -103,6 +104,19 @@ Database::Internal::commit()
     invalid_operation("WritableDatabase::commit() called with a read-only shard");
 }
 
+void
+Database::Internal::commit_async()
+{
+    if (transaction_active())
+	throw Xapian::InvalidOperationError("Can't commit during a transaction");
+    commit();
+}
+
+void
+Database::Internal::wait_for_commit()
+{
+}
+
 void
 Database::Internal::cancel()
 {
@@ -111,6 +125,17 @@ Database::Internal::cancel()
     invalid_operation("WritableDatabase::cancel() called with a read-only shard");
 }
 
+void
+Database::Internal::set_flush_memory_limit(size_t)
+{
+}
+
+size_t
+Database::Internal::get_buffered_memory() const
+{
+    return 0;
+}
+
 void
 Database::Internal::begin_transaction(bool flushed)
 {
@@ -385,6 +410,17 @@ Database::Internal::write_changesets_to_fd(int, const string&, bool, Replication
     throw Xapian::UnimplementedError("This backend doesn't provide changesets");
 }
 
+Database::Internal*
+Database::Internal::open_instance() const
+{
+    return NULL;
+}
+
+void
+Database::Internal::get_readahead_stats(size_t&, size_t&) const
+{
+}
+
 Xapian::rev
 Database::Internal::get_revision() const
 {
@@ -397,6 +433,24 @@ Database::Internal::get_uuid() const
     return string();
 }
 
+string
+Database::Internal::get_cache_key() const
+{
+    if (!is_read_only())
+	return string();
+    string uuid = get_uuid();
+    if (uuid.empty())
+	return uuid;
+    string key;
+    pack_string(key, uuid);
+    try {
+	pack_uint(key, get_revision());
+    } catch (const Xapian::UnimplementedError&) {
+	return string();
+    }
+    return key;
+}
+
 void
 Database::Internal::invalidate_doc_object(Xapian::Document::Internal*) const
 {
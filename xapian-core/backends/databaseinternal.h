@@ -33,6 +33,7 @@
 #include <xapian/types.h>
 #include <xapian/valueiterator.h>
 
+#include <cstddef>
 #include <string>
 
 typedef Xapian::TermIterator::Internal TermList;
@@ -89,11 +90,6 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
     /// Current transaction state.
     transaction_state state;
 
-    /// Test if this shard is read-only.
-    bool is_read_only() const {
-	return state == TRANSACTION_READONLY;
-    }
-
     /// Test if a transaction is currently active.
     bool transaction_active() const { return state > 0; }
 
@@ -122,6 +118,11 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
      */
     virtual ~Internal() {}
 
+    /// Test if this shard is read-only.
+    bool is_read_only() const {
+	return state == TRANSACTION_READONLY;
+    }
+
     typedef Xapian::doccount size_type;
 
     virtual size_type size() const;
@@ -380,9 +381,39 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
     /** Commit pending modifications to the database. */
     virtual void commit();
 
+    /** Commit pending modifications, syncing them to disk in the background.
+     *
+     *  See WritableDatabase::commit_async() for more information.
+     *
+     *  The default implementation calls commit().
+     */
+    virtual void commit_async();
+
+    /** Wait for a commit by commit_async() to be synced to disk.
+     *
+     *  The default implementation does nothing, which is appropriate for
+     *  backends where commit_async() doesn't return before the sync.
+     */
+    virtual void wait_for_commit();
+
     /** Cancel pending modifications to the database. */
     virtual void cancel();
 
+    /** Set the memory limit for buffered modifications.
+     *
+     *  See WritableDatabase::set_flush_memory_limit() for more information.
+     *
+     *  The default implementation does nothing, which is appropriate for
+     *  backends which don't buffer modifications.
+     */
+    virtual void set_flush_memory_limit(std::size_t limit);
+
+    /** Return the approximate memory used by buffered modifications.
+     *
+     *  The default implementation returns 0.
+     */
+    virtual std::size_t get_buffered_memory() const;
+
     /** Begin transaction. */
     virtual void begin_transaction(bool flushed);
 
@@ -434,6 +465,29 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 					bool need_whole_db,
 					ReplicationInfo* info);
 
+    /** Open another instance of this shard.
+     *
+     *  This is used to match docid ranges of a shard in parallel, as a
+     *  Database::Internal object can't be used from more than one thread at
+     *  once.  The new instance is opened with the same flags as this one,
+     *  but at the latest revision, which may be newer than this one's.
+     *
+     *  The default implementation returns NULL, meaning this isn't
+     *  supported.
+     */
+    virtual Internal* open_instance() const;
+
+    /** Add the counts of postlist readahead to @a issued and @a used.
+     *
+     *  @param[in,out] issued	Number of blocks readahead was issued for.
+     *  @param[in,out] used	Number of those blocks which were then read.
+     *
+     *  The default implementation adds nothing, which is appropriate for
+     *  backends which don't readahead.
+     */
+    virtual void get_readahead_stats(std::size_t& issued,
+				     std::size_t& used) const;
+
     /// Get revision number of database (if meaningful).
     virtual Xapian::rev get_revision() const;
 
@@ -449,6 +503,21 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
      */
     virtual std::string get_uuid() const;
 
+    /** Get a key identifying the current contents of this database.
+     *
+     *  Two database objects with the same non-empty key are guaranteed to
+     *  return the same search results, which allows results to be cached
+     *  (see Xapian::MSetCache).
+     *
+     *  The default implementation combines the UUID and the revision for a
+     *  read-only database.
+     *
+     *  If the contents can't be identified (for example because the database
+     *  is writable, or the backend doesn't support UUIDs or revisions) the
+     *  empty string is returned.
+     */
+    virtual std::string get_cache_key() const;
+
     /** Notify the database that document is no longer valid.
      *
      *  This is used to invalidate references to a document kept by a
@@ -38,6 +38,9 @@
 #ifdef XAPIAN_HAS_HONEY_BACKEND
 #include "honey/honey_dbcheck.h"
 #include "honey/honey_version.h"
+# ifdef XAPIAN_HAS_GLASS_BACKEND
+#  include "honey/honey_segmented.h"
+# endif
 #endif
 
 #include "backends.h"
@@ -221,6 +224,18 @@ check_db_dir(const string & path, int opts, std::ostream *out)
 #endif
     }
 
+    if (stat((path + "/" HONEY_SEGMENTED_MANIFEST).c_str(), &sb) == 0) {
+#if !defined XAPIAN_HAS_HONEY_BACKEND || !defined XAPIAN_HAS_GLASS_BACKEND
+	(void)opts;
+	(void)out;
+	auto msg = "Segmented honey database support isn't enabled";
+	throw Xapian::FeatureUnavailableError(msg);
+#else
+	// Check each segment and the glass database holding the metadata.
+	return HoneySegmentedDatabase::check(path, opts, out);
+#endif
+    }
+
     if (stat((path + "/iamchert").c_str(), &sb) == 0) {
 	// Chert is no longer supported as of Xapian 1.5.0.
 	throw Xapian::FeatureUnavailableError("Chert database support was removed in Xapian 1.5.0");
@@ -45,6 +45,9 @@
 #include "glass/glass_defs.h"
 #ifdef XAPIAN_HAS_HONEY_BACKEND
 # include "honey/honey_database.h"
+# ifdef XAPIAN_HAS_GLASS_BACKEND
+#  include "honey/honey_segmented.h"
+# endif
 #endif
 #include "honey/honey_defs.h"
 #ifdef XAPIAN_HAS_INMEMORY_BACKEND
@@ -61,24 +64,33 @@ using namespace std;
 namespace Xapian {
 
 static void
-open_stub(Database& db, const string& file)
+open_stub(Database& db, const string& file, int flags)
 {
     read_stub_file(file,
-		   [&db](const string& path) {
-		       db.add_database(Database(path));
+		   [&db, flags](const string& path) {
+		       db.add_database(Database(path, flags));
 		   },
-		   [&db](const string& path) {
+		   [&db, flags](const string& path) {
 #ifdef XAPIAN_HAS_GLASS_BACKEND
-		       db.add_database(Database(new GlassDatabase(path)));
+		       bool use_mmap = (flags & DB_MMAP);
+		       db.add_database(Database(new GlassDatabase(path,
+								  DB_READONLY_,
+								  0u,
+								  use_mmap)));
 #else
 		       (void)path;
+		       (void)flags;
 #endif
 		   },
-		   [&db](const string& path) {
+		   [&db, flags](const string& path) {
 #ifdef XAPIAN_HAS_HONEY_BACKEND
-		       db.add_database(Database(new HoneyDatabase(path)));
+		       int mmap_flags = (flags & DB_MMAP_MASK_);
+		       db.add_database(Database(new HoneyDatabase(path,
+								  DB_READONLY_,
+								  mmap_flags)));
 #else
 		       (void)path;
+		       (void)flags;
 #endif
 		   },
 		   [&db](const string& prog, const string& args) {
@@ -161,25 +173,36 @@ Database::Database(const string& path, int flags)
     LOGCALL_CTOR(API, "Database", path|flags);
 
     int type = flags & DB_BACKEND_MASK_;
+    bool use_mmap = (flags & DB_MMAP);
+    int mmap_flags = (flags & DB_MMAP_MASK_);
+    // Clear the backend bits, so we just pass on other flags to open_stub.
+    flags &= ~DB_BACKEND_MASK_;
     switch (type) {
 	case DB_BACKEND_CHERT:
 	    throw FeatureUnavailableError("Chert backend no longer supported");
 	case DB_BACKEND_GLASS:
 #ifdef XAPIAN_HAS_GLASS_BACKEND
-	    internal = new GlassDatabase(path);
+	    internal = new GlassDatabase(path, DB_READONLY_, 0u, use_mmap);
 	    return;
 #else
 	    throw FeatureUnavailableError("Glass backend disabled");
 #endif
 	case DB_BACKEND_HONEY:
 #ifdef XAPIAN_HAS_HONEY_BACKEND
-	    internal = new HoneyDatabase(path);
+# ifdef XAPIAN_HAS_GLASS_BACKEND
+	    if (HoneySegmentedDatabase::exists(path)) {
+		internal = new HoneySegmentedDatabase(path, DB_READONLY_,
+						      mmap_flags);
+		return;
+	    }
+# endif
+	    internal = new HoneyDatabase(path, DB_READONLY_, mmap_flags);
 	    return;
 #else
 	    throw FeatureUnavailableError("Honey backend disabled");
 #endif
 	case DB_BACKEND_STUB:
-	    open_stub(*this, path);
+	    open_stub(*this, path, flags);
 	    return;
 	case DB_BACKEND_INMEMORY:
 #ifdef XAPIAN_HAS_INMEMORY_BACKEND
@@ -204,7 +227,7 @@ Database::Database(const string& path, int flags)
 	    case BACKEND_GLASS:
 #ifdef XAPIAN_HAS_GLASS_BACKEND
 		// Single file glass format.
-		internal = new GlassDatabase(fd);
+		internal = new GlassDatabase(fd, use_mmap);
 		return;
 #else
 		throw FeatureUnavailableError("Glass backend disabled");
@@ -212,14 +235,14 @@ Database::Database(const string& path, int flags)
 	    case BACKEND_HONEY:
 #ifdef XAPIAN_HAS_HONEY_BACKEND
 		// Single file honey format.
-		internal = new HoneyDatabase(fd);
+		internal = new HoneyDatabase(fd, DB_READONLY_, mmap_flags);
 		return;
 #else
 		throw FeatureUnavailableError("Honey backend disabled");
 #endif
 	}
 
-	open_stub(*this, path);
+	open_stub(*this, path, flags);
 	return;
     }
 
@@ -229,23 +252,29 @@ Database::Database(const string& path, int flags)
 
 #ifdef XAPIAN_HAS_GLASS_BACKEND
     if (file_exists(path + "/iamglass")) {
-	internal = new GlassDatabase(path);
+	internal = new GlassDatabase(path, DB_READONLY_, 0u, use_mmap);
 	return;
     }
 #endif
 
 #ifdef XAPIAN_HAS_HONEY_BACKEND
     if (file_exists(path + "/iamhoney")) {
-	internal = new HoneyDatabase(path);
+	internal = new HoneyDatabase(path, DB_READONLY_, mmap_flags);
+	return;
+    }
+# ifdef XAPIAN_HAS_GLASS_BACKEND
+    if (HoneySegmentedDatabase::exists(path)) {
+	internal = new HoneySegmentedDatabase(path, DB_READONLY_, mmap_flags);
 	return;
     }
+# endif
 #endif
 
     // Check for "stub directories".
     string stub_file = path;
     stub_file += "/XAPIANDB";
     if (usual(file_exists(stub_file))) {
-	open_stub(*this, stub_file);
+	open_stub(*this, stub_file, flags);
 	return;
     }
 
@@ -297,11 +326,11 @@ database_factory(int fd, int flags)
     switch (type) {
 #ifdef XAPIAN_HAS_GLASS_BACKEND
 	case DB_BACKEND_GLASS:
-	    return new GlassDatabase(fd);
+	    return new GlassDatabase(fd, (flags & DB_MMAP));
 #endif
 #ifdef XAPIAN_HAS_HONEY_BACKEND
 	case DB_BACKEND_HONEY:
-	    return new HoneyDatabase(fd);
+	    return new HoneyDatabase(fd, DB_READONLY_, (flags & DB_MMAP_MASK_));
 #endif
     }
 #endif
@@ -359,6 +388,13 @@ WritableDatabase::WritableDatabase(const std::string &path, int flags, int block
 		// Existing honey DB.
 		throw InvalidOperationError("Honey backend doesn't support "
 					    "updating existing databases");
+	    } else if (file_exists(path + "/" HONEY_SEGMENTED_MANIFEST)) {
+		// Existing segmented honey DB.
+#if defined XAPIAN_HAS_HONEY_BACKEND && defined XAPIAN_HAS_GLASS_BACKEND
+		type = DB_BACKEND_HONEY;
+#else
+		throw FeatureUnavailableError("Honey backend disabled");
+#endif
 	    } else if (file_exists(path + "/iamchert")) {
 		// Existing chert DB.
 		throw FeatureUnavailableError("Chert backend no longer supported");
@@ -390,8 +426,18 @@ WritableDatabase::WritableDatabase(const std::string &path, int flags, int block
 	    return;
 #endif
 	case DB_BACKEND_HONEY:
+#if defined XAPIAN_HAS_HONEY_BACKEND && defined XAPIAN_HAS_GLASS_BACKEND
+	    // Only a segmented honey database can be updated.
+	    if (file_exists(path + "/iamhoney")) {
+		throw InvalidArgumentError("Honey backend doesn't support "
+					   "updating existing databases");
+	    }
+	    internal = new HoneySegmentedDatabase(path, flags);
+	    return;
+#else
 	    throw InvalidArgumentError("Honey backend doesn't support "
 				       "updating existing databases");
+#endif
 	case DB_BACKEND_CHERT:
 	    throw FeatureUnavailableError("Chert backend no longer supported");
 	case DB_BACKEND_INMEMORY:
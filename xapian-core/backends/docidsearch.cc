@@ -0,0 +1,75 @@
+/** @file
+ * @brief Search arrays of docids
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "docidsearch.h"
+
+#include "omassert.h"
+
+#include <cstddef>
+
+using namespace std;
+
+/** Narrow the range by binary search until it has at most this many entries.
+ *
+ *  The remaining entries are then all compared with the target.
+ */
+static const size_t COMPARE_ALL_MAX = 16;
+
+const Xapian::docid*
+find_docid_ge_gallop(const Xapian::docid* begin,
+		     const Xapian::docid* end,
+		     Xapian::docid target)
+{
+    size_t n = end - begin;
+    AssertRel(n, >, 0);
+    AssertRel(begin[0], <, target);
+
+    // Gallop forwards until we find an entry >= target or run off the end.
+    // Invariant: begin[lo] < target.
+    size_t lo = 0;
+    size_t hi = 1;
+    while (hi < n && begin[hi] < target) {
+	lo = hi;
+	hi *= 2;
+    }
+    if (hi > n) hi = n;
+
+    // The answer is in (lo, hi], where hi == n means "not found".
+    while (hi - lo > COMPARE_ALL_MAX) {
+	size_t mid = lo + (hi - lo) / 2;
+	if (begin[mid] < target) {
+	    lo = mid;
+	} else {
+	    hi = mid;
+	}
+    }
+
+    // The array is ascending so the number of entries < target is the
+    // offset of the first one >= target.  Counting them without branches is
+    // faster than a binary search for so few entries, and compilers can
+    // vectorise this loop.  Explicit SIMD versions selected at runtime were
+    // slower than this for these small counts.
+    size_t count = 0;
+    for (size_t i = lo + 1; i != hi; ++i) {
+	count += (begin[i] < target);
+    }
+    return begin + lo + 1 + count;
+}
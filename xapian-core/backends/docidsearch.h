@@ -0,0 +1,53 @@
+/** @file
+ * @brief Search arrays of docids
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_DOCIDSEARCH_H
+#define XAPIAN_INCLUDED_DOCIDSEARCH_H
+
+#include "xapian/types.h"
+
+/** Galloping search for find_docid_ge().
+ *
+ *  @a begin must be < @a end and *begin must be < @a target.
+ */
+const Xapian::docid* find_docid_ge_gallop(const Xapian::docid* begin,
+					  const Xapian::docid* end,
+					  Xapian::docid target);
+
+/** Find the first docid >= @a target in an ascending array of docids.
+ *
+ *  This uses a galloping search from @a begin (checking entries 1, 2, 4, 8,
+ *  ... after it), so it's cheapest when the answer is near the start, which
+ *  is the usual case when skipping forwards through a posting list.  The
+ *  last few candidates are compared with the target all at once.
+ *
+ *  @return Pointer to the docid found, or @a end if there isn't one.
+ */
+inline const Xapian::docid*
+find_docid_ge(const Xapian::docid* begin,
+	      const Xapian::docid* end,
+	      Xapian::docid target)
+{
+    // Dense lists often have the answer in one of the first two entries.
+    if (begin == end || begin[0] >= target) return begin;
+    if (++begin == end || begin[0] >= target) return begin;
+    return find_docid_ge_gallop(begin, end, target);
+}
+
+#endif // XAPIAN_INCLUDED_DOCIDSEARCH_H
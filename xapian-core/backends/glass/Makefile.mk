@@ -5,6 +5,7 @@ if BUILD_BACKEND_GLASS
 noinst_HEADERS +=\
 	backends/glass/glass_alldocspostlist.h\
 	backends/glass/glass_alltermslist.h\
+	backends/glass/glass_blockcache.h\
 	backends/glass/glass_changes.h\
 	backends/glass/glass_check.h\
 	backends/glass/glass_cursor.h\
@@ -13,6 +14,7 @@ noinst_HEADERS +=\
 	backends/glass/glass_dbcheck.h\
 	backends/glass/glass_defs.h\
 	backends/glass/glass_docdata.h\
+	backends/glass/glass_doclencolumn.h\
 	backends/glass/glass_document.h\
 	backends/glass/glass_freelist.h\
 	backends/glass/glass_inverter.h\
@@ -29,17 +31,20 @@ noinst_HEADERS +=\
 	backends/glass/glass_termlisttable.h\
 	backends/glass/glass_valuelist.h\
 	backends/glass/glass_values.h\
-	backends/glass/glass_version.h
+	backends/glass/glass_version.h\
+	backends/glass/glass_wal.h
 
 lib_src +=\
 	backends/glass/glass_alldocspostlist.cc\
 	backends/glass/glass_alltermslist.cc\
+	backends/glass/glass_blockcache.cc\
 	backends/glass/glass_changes.cc\
 	backends/glass/glass_check.cc\
 	backends/glass/glass_compact.cc\
 	backends/glass/glass_cursor.cc\
 	backends/glass/glass_database.cc\
 	backends/glass/glass_dbcheck.cc\
+	backends/glass/glass_doclencolumn.cc\
 	backends/glass/glass_document.cc\
 	backends/glass/glass_freelist.cc\
 	backends/glass/glass_inverter.cc\
@@ -54,7 +59,8 @@ lib_src +=\
 	backends/glass/glass_termlisttable.cc\
 	backends/glass/glass_valuelist.cc\
 	backends/glass/glass_values.cc\
-	backends/glass/glass_version.cc
+	backends/glass/glass_version.cc\
+	backends/glass/glass_wal.cc
 
 if BUILD_BACKEND_REMOTE
 lib_src += \
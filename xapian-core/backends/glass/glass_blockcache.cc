@@ -0,0 +1,213 @@
+/** @file
+ * @brief Process-wide cache of glass B-tree blocks
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "glass_blockcache.h"
+
+#include "xapian/error.h"
+
+#include "omassert.h"
+#include "parseint.h"
+#include "safesysstat.h"
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+GlassBlockCache&
+GlassBlockCache::get_shared()
+{
+    static GlassBlockCache* instance = []() {
+	size_t capacity = 0;
+	const char* p = getenv("XAPIAN_GLASS_BLOCK_CACHE_SIZE");
+	if (p && *p) {
+	    if (!parse_unsigned(p, capacity)) {
+		throw Xapian::InvalidArgumentError("XAPIAN_GLASS_BLOCK_CACHE_SIZE "
+						   "must be a non-negative "
+						   "integer");
+	    }
+	}
+	// Intentionally never deleted, so it remains usable by tables which
+	// are destroyed during static destruction.
+	return new GlassBlockCache(capacity);
+    }();
+    return *instance;
+}
+
+void
+GlassBlockCache::set_capacity(size_t capacity)
+{
+    shard_capacity = capacity / N_SHARDS;
+    for (Shard& shard : shards) {
+	lock_guard<mutex> lock(shard.mutex);
+	make_room(shard, 0);
+    }
+}
+
+GlassBlockCache::file_id
+GlassBlockCache::acquire_file_id(int fd, off_t offset)
+{
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) != 0 || statbuf.st_ino == 0) {
+	// Without a usable inode number we can't reliably tell if two tables
+	// are on the same file (e.g. st_ino is always 0 on Windows).
+	return 0;
+    }
+#ifdef HAVE_STRUCT_STAT_ST_CTIM_TV_NSEC
+    long ctime_nsec = statbuf.st_ctim.tv_nsec;
+#else
+    long ctime_nsec = 0;
+#endif
+
+    auto file_key = make_tuple(statbuf.st_dev, statbuf.st_ino, offset);
+    lock_guard<mutex> lock(files_mutex);
+    auto i = files.find(file_key);
+    if (i != files.end()) {
+	FileInfo& info = i->second;
+	if (info.ctime == statbuf.st_ctime &&
+	    info.ctime_nsec == ctime_nsec &&
+	    info.size == statbuf.st_size) {
+	    ++info.refs;
+	    return info.id;
+	}
+	// The file has been modified since the id was allocated - either a
+	// writer has committed a new revision (in which case blocks cached
+	// for earlier revisions remain valid for tables using the old id) or
+	// the database has been overwritten in place (in which case they
+	// aren't valid for us).  We can't easily tell which, so use a new id.
+	// Tables still using the old id aren't counted in the new entry.
+	info = FileInfo{statbuf.st_ctime, ctime_nsec, statbuf.st_size,
+			++last_file_id, 1};
+	return last_file_id;
+    }
+    files.emplace(file_key,
+		  FileInfo{statbuf.st_ctime, ctime_nsec, statbuf.st_size,
+			   ++last_file_id, 1});
+    return last_file_id;
+}
+
+void
+GlassBlockCache::release_file_id(file_id id)
+{
+    lock_guard<mutex> lock(files_mutex);
+    for (auto i = files.begin(); i != files.end(); ++i) {
+	if (i->second.id == id) {
+	    if (--i->second.refs == 0) {
+		files.erase(i);
+	    }
+	    return;
+	}
+    }
+}
+
+void
+GlassBlockCache::make_room(Shard& shard, unsigned size)
+{
+    while (shard.bytes + size > shard_capacity) {
+	AssertRel(shard.bytes, >, 0);
+	if (shard.hand >= shard.entries.size()) shard.hand = 0;
+	Entry& e = shard.entries[shard.hand++];
+	if (e.size == 0) continue;
+	if (e.referenced) {
+	    e.referenced = false;
+	    continue;
+	}
+	shard.index.erase(e.key);
+	shard.bytes -= e.size;
+	e.size = 0;
+	e.data.reset();
+	shard.unused.push_back(&e - shard.entries.data());
+	++shard.evictions;
+    }
+}
+
+bool
+GlassBlockCache::read_block(file_id file, glass_revision_number_t rev,
+			    glass_block_t n, uint8_t* p, unsigned block_size)
+{
+    Key key{file, rev, n};
+    Shard& shard = shard_for(key);
+    lock_guard<mutex> lock(shard.mutex);
+    auto i = shard.index.find(key);
+    if (i == shard.index.end()) {
+	++shard.misses;
+	return false;
+    }
+    Entry& e = shard.entries[i->second];
+    AssertEq(e.size, block_size);
+    memcpy(p, e.data.get(), block_size);
+    e.referenced = true;
+    ++shard.hits;
+    return true;
+}
+
+void
+GlassBlockCache::add_block(file_id file, glass_revision_number_t rev,
+			   glass_block_t n, const uint8_t* p,
+			   unsigned block_size)
+{
+    if (block_size > shard_capacity) return;
+
+    Key key{file, rev, n};
+    Shard& shard = shard_for(key);
+    lock_guard<mutex> lock(shard.mutex);
+    // The capacity may have been reduced since we checked above.
+    if (block_size > shard_capacity) return;
+    if (shard.index.find(key) != shard.index.end()) {
+	// Another table added this block since we looked it up.
+	return;
+    }
+    make_room(shard, block_size);
+
+    size_t idx;
+    if (shard.unused.empty()) {
+	idx = shard.entries.size();
+	shard.entries.emplace_back();
+    } else {
+	idx = shard.unused.back();
+	shard.unused.pop_back();
+    }
+    Entry& e = shard.entries[idx];
+    e.key = key;
+    e.size = block_size;
+    // Start unreferenced so that blocks which are only read once (e.g. by a
+    // scan of a whole table) get evicted in preference to reused blocks.
+    e.referenced = false;
+    e.data.reset(new uint8_t[block_size]);
+    memcpy(e.data.get(), p, block_size);
+    shard.index.emplace(key, idx);
+    shard.bytes += block_size;
+}
+
+GlassBlockCache::Stats
+GlassBlockCache::get_stats()
+{
+    Stats stats;
+    for (Shard& shard : shards) {
+	lock_guard<mutex> lock(shard.mutex);
+	stats.hits += shard.hits;
+	stats.misses += shard.misses;
+	stats.evictions += shard.evictions;
+	stats.blocks += shard.index.size();
+	stats.bytes += shard.bytes;
+    }
+    return stats;
+}
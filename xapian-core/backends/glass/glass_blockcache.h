@@ -0,0 +1,268 @@
+/** @file
+ * @brief Process-wide cache of glass B-tree blocks
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_GLASS_BLOCKCACHE_H
+#define XAPIAN_INCLUDED_GLASS_BLOCKCACHE_H
+
+#include "glass_defs.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/types.h>
+
+/** Cache of B-tree blocks shared by all read-only glass tables in a process.
+ *
+ *  Blocks are keyed by the file they live in, the revision the reading table
+ *  is open at, and the block number.  Glass never modifies a block which is
+ *  part of a committed revision in place - a changed block is written to a
+ *  new block number, and a freed block number is only reused for a later
+ *  revision - so the contents of block @a n as seen by a reader of revision
+ *  @a rev can't change.  Blocks with a revision newer than the reader's are
+ *  never added, so a reader which finds its revision has been overwritten
+ *  still gets DatabaseModifiedError as it would without the cache.
+ *
+ *  Writable tables don't use the cache.
+ *
+ *  The cache is split into a number of independently locked shards, each of
+ *  which uses the CLOCK algorithm to approximate LRU replacement.
+ *
+ *  The initial size of the cache in bytes is set by the
+ *  XAPIAN_GLASS_BLOCK_CACHE_SIZE environment variable, which is read the first
+ *  time the cache is needed, and it can be changed with
+ *  Xapian::Database::set_block_cache_size().  If the size is 0 (the default)
+ *  then no block cache is used.
+ */
+class GlassBlockCache {
+  public:
+    /** Identifies a file (and offset within it) to the cache.
+     *
+     *  0 means "don't cache".
+     */
+    typedef unsigned long long file_id;
+
+    /// Statistics about the use of the cache.
+    struct Stats {
+	/// Number of lookups which found the block in the cache.
+	unsigned long long hits = 0;
+
+	/// Number of lookups which didn't find the block in the cache.
+	unsigned long long misses = 0;
+
+	/// Number of blocks evicted to make room for other blocks.
+	unsigned long long evictions = 0;
+
+	/// Number of blocks currently cached.
+	size_t blocks = 0;
+
+	/// Number of bytes of block data currently cached.
+	size_t bytes = 0;
+    };
+
+  private:
+    /// Number of independently locked shards.
+    static constexpr unsigned N_SHARDS = 16;
+
+    struct Key {
+	file_id file;
+
+	glass_revision_number_t rev;
+
+	glass_block_t n;
+
+	bool operator==(const Key& o) const {
+	    return file == o.file && rev == o.rev && n == o.n;
+	}
+    };
+
+    struct KeyHash {
+	size_t operator()(const Key& k) const {
+	    unsigned long long h = k.file * 0x9e3779b97f4a7c15ull;
+	    h ^= (static_cast<unsigned long long>(k.rev) << 32) | k.n;
+	    h *= 0xff51afd7ed558ccdull;
+	    return size_t(h ^ (h >> 29));
+	}
+    };
+
+    struct Entry {
+	Key key;
+
+	/// Size of the block (0 if this entry is unused).
+	unsigned size = 0;
+
+	/// Set when the entry is used, cleared when the clock hand passes.
+	bool referenced = false;
+
+	std::unique_ptr<uint8_t[]> data;
+    };
+
+    struct Shard {
+	std::mutex mutex;
+
+	std::unordered_map<Key, size_t, KeyHash> index;
+
+	std::vector<Entry> entries;
+
+	/// Indices of unused entries in @a entries.
+	std::vector<size_t> unused;
+
+	/// Current position of the clock hand in @a entries.
+	size_t hand = 0;
+
+	size_t bytes = 0;
+
+	unsigned long long hits = 0;
+
+	unsigned long long misses = 0;
+
+	unsigned long long evictions = 0;
+    };
+
+    /// Maximum number of bytes of block data to store in each shard.
+    std::atomic<size_t> shard_capacity;
+
+    Shard shards[N_SHARDS];
+
+    struct FileInfo {
+	/// Inode change time (seconds part).
+	time_t ctime;
+
+	/// Inode change time (nanoseconds part, or 0 if not available).
+	long ctime_nsec;
+
+	/// File size.
+	off_t size;
+
+	file_id id;
+
+	/// Number of tables currently using @a id.
+	unsigned refs;
+    };
+
+    /// Protects @a files and @a last_file_id.
+    std::mutex files_mutex;
+
+    /** Map (device, inode, offset) to information about the file.
+     *
+     *  An entry is removed once no table has the file open, after which the
+     *  inode could be reused by a different file.
+     */
+    std::map<std::tuple<dev_t, ino_t, off_t>, FileInfo> files;
+
+    file_id last_file_id = 0;
+
+    Shard& shard_for(const Key& key) {
+	return shards[KeyHash()(key) % N_SHARDS];
+    }
+
+    /// Evict entries from @a shard until @a size more bytes will fit.
+    void make_room(Shard& shard, unsigned size);
+
+    /// Don't allow copying.
+    GlassBlockCache(const GlassBlockCache&) = delete;
+
+    /// Don't allow assignment.
+    GlassBlockCache& operator=(const GlassBlockCache&) = delete;
+
+  public:
+    /** Construct a cache.
+     *
+     *  @param capacity	Maximum number of bytes of block data to cache.
+     */
+    explicit GlassBlockCache(size_t capacity)
+	: shard_capacity(capacity / N_SHARDS) { }
+
+    /** Return the process-wide block cache.
+     *
+     *  The cache is created if necessary, even if it is disabled.
+     */
+    static GlassBlockCache& get_shared();
+
+    /** Return the process-wide block cache if it is enabled.
+     *
+     *  @return The cache, or NULL if block caching is disabled.
+     */
+    static GlassBlockCache* get_instance() {
+	GlassBlockCache& cache = get_shared();
+	return cache.shard_capacity ? &cache : NULL;
+    }
+
+    /// Return the maximum number of bytes of block data to cache.
+    size_t get_capacity() const { return shard_capacity * N_SHARDS; }
+
+    /** Change the maximum number of bytes of block data to cache.
+     *
+     *  Blocks are evicted as necessary to fit the new size.  Setting the
+     *  size to 0 disables the cache for tables opened afterwards, and stops
+     *  any blocks being cached for tables already using it.
+     */
+    void set_capacity(size_t capacity);
+
+    /** Get the id to use when caching blocks from a file.
+     *
+     *  Tables opened on the same file (and at the same offset within it for
+     *  a single-file database) get the same id, so they share cached blocks.
+     *
+     *  Each successful call must be matched by a call to release_file_id()
+     *  before @a fd is closed.
+     *
+     *  @param fd	File descriptor open on the file.
+     *  @param offset	Offset of the table within the file.
+     *
+     *  @return	The id, or 0 if blocks from this file can't be cached.
+     */
+    file_id acquire_file_id(int fd, off_t offset);
+
+    /** Release an id returned by acquire_file_id().
+     *
+     *  Blocks cached under the id aren't removed immediately, but will be
+     *  evicted in due course.
+     */
+    void release_file_id(file_id id);
+
+    /** Look up a block in the cache.
+     *
+     *  @param file	Id returned by acquire_file_id().
+     *  @param rev	Revision the reading table is open at.
+     *  @param n	Block number.
+     *  @param p	Buffer of size @a block_size to copy the block to.
+     *  @param block_size	The block size of the table.
+     *
+     *  @return true if the block was found (and copied into @a p).
+     */
+    bool read_block(file_id file, glass_revision_number_t rev,
+		    glass_block_t n, uint8_t* p, unsigned block_size);
+
+    /** Add a block to the cache.
+     *
+     *  Parameters are as for read_block().
+     */
+    void add_block(file_id file, glass_revision_number_t rev,
+		   glass_block_t n, const uint8_t* p, unsigned block_size);
+
+    /// Return statistics summed over all shards.
+    Stats get_stats();
+};
+
+#endif // XAPIAN_INCLUDED_GLASS_BLOCKCACHE_H
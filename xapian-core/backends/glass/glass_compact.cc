@@ -36,6 +36,7 @@
 #include "backends/flint_lock.h"
 #include "glass_database.h"
 #include "glass_defs.h"
+#include "glass_postlist.h"
 #include "glass_table.h"
 #include "glass_cursor.h"
 #include "glass_version.h"
@@ -185,12 +186,63 @@ encode_valuestats(Xapian::doccount freq,
     return value;
 }
 
-static void
+/// Convert value chunk @a tag to the columnar format, if it isn't already.
+static string
+make_columnar_value_chunk(const string & tag)
+{
+    if (!tag.empty() && tag[0] == '\0') return tag;
+    // Only the docid deltas are stored in the tag, so the first docid we
+    // tell the reader doesn't matter.
+    Glass::ValueChunkReader reader(tag.data(), tag.size(), 1);
+    Glass::ColumnarChunkBuilder builder;
+    while (!reader.at_end()) {
+	builder.add(reader.get_docid(), reader.get_value());
+	reader.next();
+    }
+    string result;
+    builder.build(result);
+    return result;
+}
+
+/** Convert postlist chunk @a tag to a bitmap chunk if that's smaller.
+ *
+ *  @return true if @a tag is a bitmap chunk.
+ */
+static bool
+make_bitmap_postlist_chunk(string & tag)
+{
+    const char * p = tag.data();
+    const char * end = p + tag.size();
+    // Skip the "is last chunk" flag.
+    if (p == end) throw Xapian::DatabaseCorruptError("Empty postlist chunk");
+    ++p;
+    Xapian::docid increase_to_last;
+    if (!unpack_uint(&p, end, &increase_to_last))
+	throw Xapian::DatabaseCorruptError("Bad postlist chunk header");
+    size_t header_size = p - tag.data();
+    string data(p, end);
+    if (!Glass::make_bitmap_chunk(data, increase_to_last)) return false;
+    tag.resize(header_size);
+    tag += data;
+    return true;
+}
+
+/** Merge postlist tables.
+ *
+ *  If @a bitmap_postings is true, postlist chunks are stored as bitmaps
+ *  where that's smaller.
+ *
+ *  @return true if any bitmap chunks were written.
+ */
+static bool
 merge_postlists(Xapian::Compactor * compactor,
 		GlassTable * out, vector<Xapian::docid>::const_iterator offset,
 		vector<const GlassTable*>::const_iterator b,
-		vector<const GlassTable*>::const_iterator e)
+		vector<const GlassTable*>::const_iterator e,
+		bool columnar_values = false,
+		bool bitmap_postings = false)
 {
+    bool used_bitmaps = false;
     priority_queue<PostlistCursor *, vector<PostlistCursor *>, PostlistCursorGt> pq;
     for ( ; b != e; ++b, ++offset) {
 	const GlassTable *in = *b;
@@ -327,7 +379,11 @@ merge_postlists(Xapian::Compactor * compactor,
 	const string & key = cur->key;
 	if (!is_valuechunk_key(key)) break;
 	Assert(!is_user_metadata_key(key));
-	out->add(key, cur->tag);
+	if (columnar_values) {
+	    out->add(key, make_columnar_value_chunk(cur->tag));
+	} else {
+	    out->add(key, cur->tag);
+	}
 	pq.pop();
 	if (cur->next()) {
 	    pq.push(cur);
@@ -347,6 +403,12 @@ merge_postlists(Xapian::Compactor * compactor,
 	Assert(cur == NULL || !is_user_metadata_key(cur->key));
 	if (cur == NULL || cur->key != last_key) {
 	    if (!tags.empty()) {
+		if (bitmap_postings && !is_doclenchunk_key(last_key)) {
+		    for (auto& t : tags) {
+			if (make_bitmap_postlist_chunk(t.second))
+			    used_bitmaps = true;
+		    }
+		}
 		string first_tag;
 		pack_uint(first_tag, tf);
 		pack_uint(first_tag, cf);
@@ -385,6 +447,7 @@ merge_postlists(Xapian::Compactor * compactor,
 	    delete cur;
 	}
     }
+    return used_bitmaps;
 }
 
 struct MergeCursor : public GlassCursor {
@@ -423,8 +486,10 @@ merge_spellings(GlassTable * out,
 	string key = cur->current_key;
 	if (pq.empty() || pq.top()->current_key > key) {
 	    // No need to merge the tags, just copy the (possibly compressed)
-	    // tag value.
-	    bool compressed = cur->read_tag(true);
+	    // tag value (unless the output uses a different codec).
+	    bool keep_compressed =
+		(cur->get_compression_codec() == out->get_compression_codec());
+	    bool compressed = cur->read_tag(keep_compressed);
 	    out->add(key, cur->current_tag, compressed);
 	    if (cur->next()) {
 		pq.push(cur);
@@ -532,8 +597,10 @@ merge_synonyms(GlassTable * out,
 	string key = cur->current_key;
 	if (pq.empty() || pq.top()->current_key > key) {
 	    // No need to merge the tags, just copy the (possibly compressed)
-	    // tag value.
-	    bool compressed = cur->read_tag(true);
+	    // tag value (unless the output uses a different codec).
+	    bool keep_compressed =
+		(cur->get_compression_codec() == out->get_compression_codec());
+	    bool compressed = cur->read_tag(keep_compressed);
 	    out->add(key, cur->current_tag, compressed);
 	    if (cur->next()) {
 		pq.push(cur);
@@ -593,11 +660,12 @@ merge_synonyms(GlassTable * out,
     }
 }
 
-static void
+static bool
 multimerge_postlists(Xapian::Compactor * compactor,
 		     GlassTable * out, const char * tmpdir,
 		     vector<const GlassTable *> tmp,
-		     vector<Xapian::docid> off)
+		     vector<Xapian::docid> off,
+		     bool columnar_values)
 {
     unsigned int c = 0;
     while (tmp.size() > 3) {
@@ -643,7 +711,9 @@ multimerge_postlists(Xapian::Compactor * compactor,
 	swap(off, newoff);
 	++c;
     }
-    merge_postlists(compactor, out, off.begin(), tmp.begin(), tmp.end());
+    bool used_bitmaps = merge_postlists(compactor, out, off.begin(),
+					tmp.begin(), tmp.end(),
+					columnar_values, true);
     if (c > 0) {
 	for (size_t k = 0; k < tmp.size(); ++k) {
 	    unlink(tmp[k]->get_path().c_str());
@@ -651,6 +721,7 @@ multimerge_postlists(Xapian::Compactor * compactor,
 	    tmp[k] = NULL;
 	}
     }
+    return used_bitmaps;
 }
 
 class PositionCursor : private GlassCursor {
@@ -739,6 +810,11 @@ merge_docid_keyed(GlassTable *out, const vector<const GlassTable*> & inputs,
 	GlassCursor cur(in);
 	cur.rewind();
 
+	// Copy compressed tags as they are unless the output uses a
+	// different codec.
+	bool keep_compressed =
+	    (in->get_compression_codec() == out->get_compression_codec());
+
 	string key;
 	while (cur.next()) {
 	    // Adjust the key if this isn't the first database.
@@ -762,7 +838,7 @@ merge_docid_keyed(GlassTable *out, const vector<const GlassTable*> & inputs,
 	    } else {
 		key = cur.current_key;
 	    }
-	    bool compressed = cur.read_tag(true);
+	    bool compressed = cur.read_tag(keep_compressed);
 	    out->add(key, cur.current_tag, compressed);
 	}
     }
@@ -854,11 +930,17 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 	version_file_out.reset(new GlassVersion(destdir));
     }
 
-    version_file_out->create(block_size);
+    version_file_out->create(block_size, compression_codec_from_flags(flags));
     for (size_t i = 0; i != sources.size(); ++i) {
-	auto db = static_cast<const GlassDatabase*>(sources[i]);
+	auto db = static_cast<const GlassDatabase*>(sources[i])->tables_db();
 	version_file_out->merge_stats(db->version_file);
     }
+    // Convert all the value chunks to the columnar format if asked to.
+    // Otherwise chunks are copied as they are, so the output needs the
+    // feature if any of the inputs have it (merge_stats() handles that).
+    bool columnar_values = (flags & Xapian::DB_COLUMNAR_VALUES);
+    if (columnar_values)
+	version_file_out->set_feature(Glass::FEATURE_COLUMNAR_VALUES);
 
     string fl_serialised;
     if (single_file) {
@@ -903,7 +985,7 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 	inputs.reserve(sources.size());
 	size_t inputs_present = 0;
 	for (auto src : sources) {
-	    auto db = static_cast<const GlassDatabase*>(src);
+	    auto db = static_cast<const GlassDatabase*>(src)->tables_db();
 	    const GlassTable * table;
 	    switch (t->type) {
 		case Glass::POSTLIST:
@@ -950,6 +1032,11 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 		    bad_stat = true;
 		    output_will_exist = true;
 		    ++inputs_present;
+		} else if (!table->empty()) {
+		    // The table has just been created by a reader replaying the
+		    // write-ahead log.
+		    output_will_exist = true;
+		    ++inputs_present;
 		}
 	    }
 	    inputs.push_back(table);
@@ -997,13 +1084,22 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 
 	switch (t->type) {
 	    case Glass::POSTLIST: {
+		bool used_bitmaps;
 		if (multipass && inputs.size() > 3) {
-		    multimerge_postlists(compactor, out, destdir,
-					 inputs, offset);
+		    used_bitmaps = multimerge_postlists(compactor, out, destdir,
+							inputs, offset,
+							columnar_values);
 		} else {
-		    merge_postlists(compactor, out, offset.begin(),
-				    inputs.begin(), inputs.end());
+		    used_bitmaps = merge_postlists(compactor, out,
+						   offset.begin(),
+						   inputs.begin(), inputs.end(),
+						   columnar_values, true);
 		}
+		// Dense postlists are stored as bitmaps where that's smaller,
+		// which older versions can't read, so only flag the feature if
+		// that happened (or an input already had it).
+		if (used_bitmaps)
+		    version_file_out->set_feature(Glass::FEATURE_BITMAP_POSTINGS);
 		break;
 	    }
 	    case Glass::SPELLING:
@@ -1113,5 +1209,16 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 	delete tabs[j];
     }
 
+    if (!single_file && (flags & Xapian::DB_DOCLEN_COLUMN)) {
+	// Write the dense document length column by reading the document
+	// lengths back from the new database.
+	if (compactor)
+	    compactor->set_status("doclens", string());
+	GlassDatabase db(destdir);
+	db.write_doclen_column(FLAGS, true);
+	if (compactor)
+	    compactor->set_status("doclens", "Done");
+    }
+
     if (!single_file) lock.release();
 }
@@ -26,8 +26,11 @@
 
 #include <xapian/error.h>
 
+#include <algorithm>
+
 #include "glass_table.h"
 #include "debuglog.h"
+#include "io_utils.h"
 #include "omassert.h"
 
 using namespace Glass;
@@ -51,13 +54,25 @@ hex_display_encode(const string & input)
 
 #define DIR_START        11
 
+Mapping::~Mapping()
+{
+    io_munmap(reinterpret_cast<const char*>(base), size);
+}
+
 GlassCursor::GlassCursor(const GlassTable *B_, const Glass::Cursor * C_)
 	: is_positioned(false),
 	  is_after_end(false),
 	  tag_status(UNREAD),
 	  B(B_),
 	  version(B_->cursor_version),
-	  level(B_->level)
+	  level(B_->level),
+	  readahead_leaf(BLK_UNUSED),
+	  readahead_leaf_parent(BLK_UNUSED),
+	  readahead_leaf_c(0),
+	  readahead_parent(BLK_UNUSED),
+	  readahead_c(0),
+	  readahead_issued(0),
+	  readahead_used(0)
 {
     B->cursor_created_since_last_modification = true;
     C = new Glass::Cursor[level + 1];
@@ -102,6 +117,88 @@ GlassCursor::~GlassCursor()
     delete [] C;
 }
 
+unsigned
+GlassCursor::readahead_leaves(const string & prefix, unsigned count)
+{
+    LOGCALL(DB, unsigned, "GlassCursor::readahead_leaves", prefix | count);
+    if (level == 0 || B->handle < 0 || !is_positioned)
+	RETURN(0);
+
+    uint4 leaf = C[0].get_n();
+    if (leaf == readahead_leaf)
+	RETURN(0);
+
+    // Only readahead if the cursor has moved on to the next leaf, or to one
+    // we've already issued readahead for - if we've jumped elsewhere, the
+    // blocks after it may well not be wanted either.
+    bool step;
+    if (B->sequential) {
+	// Allow for a branch block between consecutive leaf blocks.
+	step = (leaf > readahead_leaf && leaf - readahead_leaf <= 2);
+    } else {
+	step = (C[1].get_n() == readahead_leaf_parent &&
+		C[1].c == readahead_leaf_c + D2);
+	readahead_leaf_parent = C[1].get_n();
+	readahead_leaf_c = C[1].c;
+    }
+    readahead_leaf = leaf;
+
+    auto i = std::find(readahead_pending.begin(), readahead_pending.end(),
+		       leaf);
+    if (i != readahead_pending.end()) {
+	++readahead_used;
+	++B->readahead_used;
+	// Any blocks before this one were skipped over.
+	readahead_pending.erase(readahead_pending.begin(), i + 1);
+    } else {
+	readahead_pending.clear();
+	if (!step)
+	    RETURN(0);
+    }
+
+    unsigned issued = 0;
+    if (B->sequential) {
+	uint4 start = leaf + 1;
+	if (!readahead_pending.empty())
+	    start = readahead_pending.back() + 1;
+	uint4 end = std::min(leaf + 1 + count,
+			     B->free_list.get_first_unused_block());
+	if (start < end &&
+	    io_readahead_blocks(B->handle, B->block_size, start, end - start,
+				B->offset)) {
+	    for (uint4 n = start; n != end; ++n) {
+		readahead_pending.push_back(n);
+	    }
+	    issued = end - start;
+	}
+    } else {
+	const uint8_t * p = C[1].get_p();
+	int c = C[1].c + D2;
+	if (C[1].get_n() == readahead_parent)
+	    c = std::max(c, readahead_c + D2);
+	int c_end = std::min(DIR_END(p), C[1].c + int(count + 1) * D2);
+	readahead_parent = C[1].get_n();
+	for ( ; c < c_end; c += D2) {
+	    BItem item(p, c);
+	    Key k = item.key();
+	    if (size_t(k.length()) < prefix.size() ||
+		memcmp(k.data(), prefix.data(), prefix.size()) != 0) {
+		// This leaf starts with a key after the range of interest.
+		break;
+	    }
+	    uint4 n = item.block_given_by();
+	    if (!io_readahead_block(B->handle, B->block_size, n, B->offset))
+		break;
+	    readahead_pending.push_back(n);
+	    readahead_c = c;
+	    ++issued;
+	}
+    }
+    readahead_issued += issued;
+    B->readahead_issued += issued;
+    RETURN(issued);
+}
+
 bool
 GlassCursor::next()
 {
@@ -284,6 +381,12 @@ GlassCursor::get_key(string * key) const
     (void)LeafItem(C[0].get_p(), C[0].c).key().read(key);
 }
 
+compression_codec
+GlassCursor::get_compression_codec() const
+{
+    return B->get_compression_codec();
+}
+
 bool
 GlassCursor::read_tag(bool keep_compressed)
 {
@@ -26,17 +26,62 @@
 #include "glass_defs.h"
 
 #include "alignment_cast.h"
+#include "compression_stream.h"
 #include "omassert.h"
 
 #include <algorithm>
 #include <cstring>
 #include <string>
+#include <vector>
+#include <sys/types.h>
 using std::string;
 
 #define BLK_UNUSED uint4(-1)
 
 namespace Glass {
 
+/** A read-only memory mapping of a table file.
+ *
+ *  This is reference counted by the table which created it and by each Cursor
+ *  with a block inside it, so a Cursor can still read its block after the
+ *  table has been reopened and switched to a new mapping.
+ */
+class Mapping {
+    /// Don't allow copying.
+    Mapping(const Mapping&) = delete;
+
+    /// Don't allow assignment.
+    Mapping& operator=(const Mapping&) = delete;
+
+    /// Reference count.
+    unsigned refs = 1;
+
+    /// Private so only unref() can delete the mapping.
+    ~Mapping();
+
+  public:
+    /// Start of the mapping.
+    const uint8_t* base;
+
+    /// Size of the mapping in bytes.
+    size_t size;
+
+    /// Device of the mapped file.
+    dev_t dev;
+
+    /// Inode of the mapped file.
+    ino_t ino;
+
+    Mapping(const uint8_t* base_, size_t size_, dev_t dev_, ino_t ino_)
+	: base(base_), size(size_), dev(dev_), ino(ino_) { }
+
+    void ref() { ++refs; }
+
+    void unref() {
+	if (--refs == 0) delete this;
+    }
+};
+
 class Cursor {
     // Prevent copying
     Cursor(const Cursor &);
@@ -45,13 +90,33 @@ class Cursor {
     /// Pointer to reference counted data.
     char * data;
 
+    /** The mapping containing the current block, or NULL.
+     *
+     *  If non-NULL then @a data is NULL, and the block is at @a mapped_p.
+     */
+    Mapping * mapping;
+
+    /// Pointer to the block in @a mapping.
+    const uint8_t * mapped_p;
+
+    /// Block number of the block in @a mapping.
+    uint4 mapped_n;
+
+    void release_mapping() {
+	if (mapping) {
+	    mapping->unref();
+	    mapping = NULL;
+	}
+    }
+
   public:
     /// Constructor.
-    Cursor() : data(0), c(-1), rewrite(false) { }
+    Cursor() : data(0), mapping(0), c(-1), rewrite(false) { }
 
     ~Cursor() { destroy(); }
 
     uint8_t * init(unsigned block_size) {
+	release_mapping();
 	if (data && refs() > 1) {
 	    --refs();
 	    data = NULL;
@@ -65,7 +130,28 @@ class Cursor {
 	return reinterpret_cast<uint8_t*>(data + 8);
     }
 
+    /** Point to block @a n at @a p in mapping @a m.
+     *
+     *  The block is read directly from the mapping, so can't be modified.
+     */
+    void init_mapped(Mapping * m, uint4 n, const uint8_t * p) {
+	if (m != mapping) {
+	    destroy();
+	    m->ref();
+	    mapping = m;
+	}
+	mapped_p = p;
+	mapped_n = n;
+	rewrite = false;
+	c = -1;
+    }
+
     const uint8_t * clone(const Cursor & o) {
+	if (o.mapping) {
+	    init_mapped(o.mapping, o.mapped_n, o.mapped_p);
+	    return mapped_p;
+	}
+	release_mapping();
 	if (data != o.data) {
 	    destroy();
 	    data = o.data;
@@ -76,11 +162,15 @@ class Cursor {
 
     void swap(Cursor & o) {
 	std::swap(data, o.data);
+	std::swap(mapping, o.mapping);
+	std::swap(mapped_p, o.mapped_p);
+	std::swap(mapped_n, o.mapped_n);
 	std::swap(c, o.c);
 	std::swap(rewrite, o.rewrite);
     }
 
     void destroy() {
+	release_mapping();
 	if (data) {
 	    if (--refs() == 0)
 		delete [] data;
@@ -99,11 +189,16 @@ class Cursor {
      *  Returns BLK_UNUSED if no block is currently loaded.
      */
     uint4 get_n() const {
+	if (mapping) return mapped_n;
 	Assert(data);
 	return *alignment_cast<uint4*>(data + 4);
     }
 
     void set_n(uint4 n) {
+	if (mapping) {
+	    mapped_n = n;
+	    return;
+	}
 	Assert(data);
 	// Assert(refs() == 1);
 	*alignment_cast<uint4*>(data + 4) = n;
@@ -114,11 +209,15 @@ class Cursor {
      * Returns NULL if no block is currently loaded.
      */
     const uint8_t * get_p() const {
+	if (mapping) return mapped_p;
 	if (rare(!data)) return NULL;
 	return reinterpret_cast<uint8_t*>(data + 8);
     }
 
     uint8_t * get_modifiable_p(unsigned block_size) {
+	// Only tables opened for writing modify blocks, and they never use a
+	// mapping.
+	Assert(!mapping);
 	if (rare(!data)) return NULL;
 	if (refs() > 1) {
 	    char * new_data = new char[block_size + 8];
@@ -186,6 +285,24 @@ class GlassCursor {
     /** The value of level in the Btree structure. */
     int level;
 
+    /// Leaf block the cursor was on at the last call to readahead_leaves().
+    uint4 readahead_leaf;
+
+    /// Parent block of readahead_leaf (if the table isn't sequential).
+    uint4 readahead_leaf_parent;
+
+    /// Directory offset of readahead_leaf in readahead_leaf_parent.
+    int readahead_leaf_c;
+
+    /// Branch block readahead_leaves() last issued readahead from.
+    uint4 readahead_parent;
+
+    /// Directory offset in readahead_parent of the last block issued.
+    int readahead_c;
+
+    /// Blocks readahead has been issued for which the cursor hasn't reached.
+    std::vector<uint4> readahead_pending;
+
     /** Get the key.
      *
      *  The key of the item at the cursor is copied into key.
@@ -242,6 +359,33 @@ class GlassCursor {
      */
     string current_tag;
 
+    /// Number of blocks readahead_leaves() has issued readahead for.
+    unsigned long readahead_issued;
+
+    /// Number of those blocks which the cursor has since moved to.
+    unsigned long readahead_used;
+
+    /** Readahead leaf blocks after the one the cursor is on.
+     *
+     *  This is intended to be called by a user iterating forwards through a
+     *  range of keys each time it moves to a new entry, and issues readahead
+     *  for up to @a count leaf blocks beyond the current one, which have not
+     *  already had readahead issued for them.
+     *
+     *  Readahead is only issued once the cursor has moved on to the next
+     *  leaf block (or to one readahead was issued for), so a user which
+     *  only looks at one leaf, or jumps around, doesn't waste reads.
+     *
+     *  Where the B-tree structure tells us the first key in a leaf block,
+     *  we stop at the first leaf whose first key doesn't start with
+     *  @a prefix.  For a table which was written sequentially, leaf blocks
+     *  are read in block number order and we can't check the keys without
+     *  reading the blocks, so up to @a count blocks are always readahead.
+     *
+     *  @return	The number of blocks readahead was issued for.
+     */
+    unsigned readahead_leaves(const string & prefix, unsigned count);
+
     /** Position cursor on the dummy empty key.
      *
      *  Calling next() after this moves the cursor to the first entry.
@@ -264,6 +408,9 @@ class GlassCursor {
      */
     bool read_tag(bool keep_compressed = false);
 
+    /// Return the codec used to compress tags in the cursor's table.
+    compression_codec get_compression_codec() const;
+
     /** Advance to the next key.
      *
      *  If cursor is unpositioned, the result is simply false.
@@ -50,12 +50,14 @@
 #include "glass_valuelist.h"
 #include "glass_values.h"
 #include "debuglog.h"
+#include "errno_to_string.h"
 #include "fd.h"
 #include "filetests.h"
 #include "io_utils.h"
 #include "pack.h"
 #include "parseint.h"
 #include "net/remoteconnection.h"
+#include "net/serialise.h"
 #include "api/replication.h"
 #include "replicationprotocol.h"
 #include "posixy_wrapper.h"
@@ -67,10 +69,15 @@
 #include <sys/types.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cerrno>
 #include <cstdlib>
 #include <memory>
 #include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 using namespace std;
 using namespace Xapian;
@@ -96,7 +103,7 @@ using Xapian::Internal::intrusive_ptr;
  * and stores handles to the tables.
  */
 GlassDatabase::GlassDatabase(const string &glass_dir, int flags,
-			     unsigned int block_size)
+			     unsigned int block_size, bool use_mmap)
 	: Xapian::Database::Internal(flags == Xapian::DB_READONLY_ ?
 				     TRANSACTION_READONLY :
 				     TRANSACTION_NONE),
@@ -108,17 +115,20 @@ GlassDatabase::GlassDatabase(const string &glass_dir, int flags,
 	  // Note: (Xapian::DB_READONLY_ & Xapian::DB_NO_TERMLIST) is true,
 	  // so opening to read we always permit the termlist to be missing.
 	  termlist_table(db_dir, readonly, (flags & Xapian::DB_NO_TERMLIST)),
-	  value_manager(&postlist_table, &termlist_table),
+	  value_manager(&postlist_table, &termlist_table, &version_file),
 	  synonym_table(db_dir, readonly),
 	  spelling_table(db_dir, readonly),
 	  docdata_table(db_dir, readonly),
 	  lock(db_dir),
-	  changes(db_dir)
+	  changes(db_dir),
+	  doclen_column(db_dir)
 {
-    LOGCALL_CTOR(DB, "GlassDatabase", glass_dir | flags | block_size);
+    LOGCALL_CTOR(DB, "GlassDatabase", glass_dir | flags | block_size | use_mmap);
 
     if (readonly) {
+	if (use_mmap) set_mmap();
 	open_tables(flags);
+	update_wal_overlay();
 	return;
     }
 
@@ -165,7 +175,35 @@ GlassDatabase::GlassDatabase(const string &glass_dir, int flags,
     open_tables(flags);
 }
 
-GlassDatabase::GlassDatabase(int fd)
+GlassDatabase::GlassDatabase(const string& glass_dir, GlassWALOverlay)
+	: Xapian::Database::Internal(TRANSACTION_READONLY),
+	  db_dir(glass_dir),
+	  readonly(false),
+	  is_wal_overlay(true),
+	  version_file(db_dir),
+	  postlist_table(db_dir, readonly),
+	  position_table(db_dir, readonly),
+	  // Like a reader, permit the termlist to be missing.
+	  termlist_table(db_dir, readonly, true),
+	  value_manager(&postlist_table, &termlist_table, &version_file),
+	  synonym_table(db_dir, readonly),
+	  spelling_table(db_dir, readonly),
+	  docdata_table(db_dir, readonly),
+	  lock(db_dir),
+	  changes(db_dir),
+	  doclen_column(db_dir)
+{
+    LOGCALL_CTOR(DB, "GlassDatabase", glass_dir | Literal("overlay"));
+    postlist_table.set_private_writes();
+    position_table.set_private_writes();
+    termlist_table.set_private_writes();
+    synonym_table.set_private_writes();
+    spelling_table.set_private_writes();
+    docdata_table.set_private_writes();
+    open_tables(Xapian::DB_OPEN | Xapian::DB_NO_SYNC);
+}
+
+GlassDatabase::GlassDatabase(int fd, bool use_mmap)
 	: Xapian::Database::Internal(TRANSACTION_READONLY),
 	  db_dir(),
 	  readonly(true),
@@ -173,20 +211,42 @@ GlassDatabase::GlassDatabase(int fd)
 	  postlist_table(fd, version_file.get_offset(), readonly),
 	  position_table(fd, version_file.get_offset(), readonly),
 	  termlist_table(fd, version_file.get_offset(), readonly, true),
-	  value_manager(&postlist_table, &termlist_table),
+	  value_manager(&postlist_table, &termlist_table, &version_file),
 	  synonym_table(fd, version_file.get_offset(), readonly),
 	  spelling_table(fd, version_file.get_offset(), readonly),
 	  docdata_table(fd, version_file.get_offset(), readonly),
 	  lock(),
-	  changes(string())
+	  changes(string()),
+	  doclen_column(string())
 {
-    LOGCALL_CTOR(DB, "GlassDatabase", fd);
+    LOGCALL_CTOR(DB, "GlassDatabase", fd | use_mmap);
+    if (use_mmap) set_mmap();
     open_tables(Xapian::DB_READONLY_);
 }
 
+void
+GlassDatabase::set_mmap()
+{
+    mmapped = true;
+    postlist_table.set_mmap(true);
+    position_table.set_mmap(true);
+    termlist_table.set_mmap(true);
+    synonym_table.set_mmap(true);
+    spelling_table.set_mmap(true);
+    docdata_table.set_mmap(true);
+}
+
 GlassDatabase::~GlassDatabase()
 {
     LOGCALL_DTOR(DB, "GlassDatabase");
+    if (sync_thread.joinable()) {
+	sync_thread.join();
+	if (sync_errno) {
+	    // We can't throw from a destructor, so all we can do is log it.
+	    LOGLINE(DB, "Syncing a commit in the background failed: " <<
+			errno_to_string(sync_errno));
+	}
+    }
 }
 
 bool
@@ -204,7 +264,9 @@ GlassDatabase::create_and_open_tables(int flags, unsigned int block_size)
     // already exist.
 
     GlassVersion &v = version_file;
-    v.create(block_size);
+    v.create(block_size, compression_codec_from_flags(flags));
+    if (flags & Xapian::DB_COLUMNAR_VALUES)
+	v.set_feature(Glass::FEATURE_COLUMNAR_VALUES);
 
     glass_revision_number_t rev = v.get_revision();
     const string& tmpfile = v.write(rev, flags);
@@ -220,6 +282,10 @@ GlassDatabase::create_and_open_tables(int flags, unsigned int block_size)
 	throw Xapian::DatabaseCreateError("Failed to create iamglass file");
     }
 
+    doclen_column.open(v.get_uuid(), rev, true,
+		       (flags & Xapian::DB_DOCLEN_COLUMN));
+    postlist_table.set_doclen_column(&doclen_column);
+
     Assert(database_exists());
 }
 
@@ -241,6 +307,8 @@ GlassDatabase::open_tables(int flags)
     }
 
     version_file.read();
+    if (!readonly && (flags & Xapian::DB_COLUMNAR_VALUES))
+	version_file.set_feature(Glass::FEATURE_COLUMNAR_VALUES);
     glass_revision_number_t rev = version_file.get_revision();
     if (cur_rev && cur_rev == rev) {
 	// We're reopening a database and the revision hasn't changed so we
@@ -254,6 +322,8 @@ GlassDatabase::open_tables(int flags)
     termlist_table.open(flags, version_file.get_root(Glass::TERMLIST), rev);
     position_table.open(flags, version_file.get_root(Glass::POSITION), rev);
     postlist_table.open(flags, version_file.get_root(Glass::POSTLIST), rev);
+    doclen_column.open(version_file.get_uuid(), rev, !readonly,
+		       (flags & Xapian::DB_DOCLEN_COLUMN));
 
     Xapian::termcount swfub = version_file.get_spelling_wordfreq_upper_bound();
     spelling_table.set_wordfreq_upper_bound(swfub);
@@ -261,6 +331,9 @@ GlassDatabase::open_tables(int flags)
     value_manager.reset();
 
     if (!readonly) {
+	postlist_table.set_doclen_column(&doclen_column);
+	// Nothing replayed for a reader gets written, so it isn't a change.
+	if (is_wal_overlay) RETURN(true);
 	changes.set_oldest_changeset(version_file.get_oldest_changeset());
 	glass_revision_number_t revision = version_file.get_revision();
 	GlassChanges * p = changes.start(revision, revision + 1, flags);
@@ -327,10 +400,32 @@ GlassDatabase::get_changeset_revisions(const string & path,
 				    "changeset at " + path);
 }
 
+/** Sync some files.
+ *
+ *  @param fds		The file descriptors to sync.
+ *  @param n_fds	The number of file descriptors.
+ *
+ *  @return 0 if successful, otherwise the errno from the first which failed.
+ */
+static int
+sync_fds(const int* fds, size_t n_fds)
+{
+    for (size_t i = 0; i != n_fds; ++i) {
+	if (!io_sync(fds[i])) {
+	    return errno ? errno : EIO;
+	}
+    }
+    return 0;
+}
+
 void
-GlassDatabase::set_revision_number(int flags, glass_revision_number_t new_revision)
+GlassDatabase::set_revision_number(int flags, glass_revision_number_t new_revision,
+				   bool background)
 {
-    LOGCALL_VOID(DB, "GlassDatabase::set_revision_number", flags|new_revision);
+    LOGCALL_VOID(DB, "GlassDatabase::set_revision_number", flags|new_revision|background);
+
+    // The previous revision must be on disk before we write this one.
+    finish_background_sync();
 
     glass_revision_number_t rev = version_file.get_revision();
     if (new_revision <= rev && rev != 0) {
@@ -358,30 +453,168 @@ GlassDatabase::set_revision_number(int flags, glass_revision_number_t new_revisi
     docdata_table.commit(new_revision, version_file.root_to_set(Glass::DOCDATA));
 
     const string & tmpfile = version_file.write(new_revision, flags);
-    if (!postlist_table.sync() ||
-	!position_table.sync() ||
-	!termlist_table.sync() ||
-	!synonym_table.sync() ||
-	!spelling_table.sync() ||
-	!docdata_table.sync() ||
+    if (background && can_sync_in_background(flags)) {
+	vector<int> fds(Glass::MAX_);
+	fds.resize(get_fds_to_sync(fds.data()));
+	int version_fd = version_file.get_fd_to_sync();
+	string dir = db_dir;
+	string tmp = tmpfile;
+	sync_done = false;
+	auto do_sync = [this, fds, version_fd, dir, tmp, flags]() {
+	    int e = sync_fds(fds.data(), fds.size());
+	    if (e) {
+		(void)::close(version_fd);
+		(void)unlink(tmp.c_str());
+	    } else if (!GlassVersion::sync_file(version_fd, tmp, dir, flags)) {
+		e = errno ? errno : EIO;
+	    }
+	    sync_errno = e;
+	    sync_done.store(true, memory_order_release);
+	};
+	try {
+	    sync_thread = thread(do_sync);
+	} catch (const system_error&) {
+	    // Fall back to syncing in this thread.
+	    background = false;
+	}
+	if (background) {
+	    version_file.release_fd(new_revision);
+	    // Blocks on the freelist may be used by the revision on disk
+	    // until the sync is done.
+	    set_reuse_free_blocks(false);
+	    return;
+	}
+    }
+
+    if (!sync_tables(flags) ||
 	!version_file.sync(tmpfile, new_revision, flags)) {
 	int saved_errno = errno;
 	(void)unlink(tmpfile.c_str());
 	throw Xapian::DatabaseError("Commit failed", saved_errno);
     }
 
+    write_doclen_column(flags);
+
     changes.commit(new_revision, flags);
 }
 
+size_t
+GlassDatabase::get_fds_to_sync(int* fds) const
+{
+    const GlassTable* tables[] = {
+	&postlist_table,
+	&position_table,
+	&termlist_table,
+	&synonym_table,
+	&spelling_table,
+	&docdata_table
+    };
+    // Tables which haven't been created yet have nothing to sync.
+    size_t n_fds = 0;
+    for (const GlassTable* table : tables) {
+	int fd = table->get_fd_to_sync();
+	if (fd >= 0) fds[n_fds++] = fd;
+    }
+    return n_fds;
+}
+
+bool
+GlassDatabase::sync_tables(int flags)
+{
+    LOGCALL(DB, bool, "GlassDatabase::sync_tables", flags);
+    if (flags & Xapian::DB_NO_SYNC) RETURN(true);
+
+    int fds[Glass::MAX_];
+    int e = sync_fds(fds, get_fds_to_sync(fds));
+    if (e) {
+	errno = e;
+	RETURN(false);
+    }
+    RETURN(true);
+}
+
+void
+GlassDatabase::set_reuse_free_blocks(bool reuse)
+{
+    postlist_table.set_reuse_free_blocks(reuse);
+    position_table.set_reuse_free_blocks(reuse);
+    termlist_table.set_reuse_free_blocks(reuse);
+    synonym_table.set_reuse_free_blocks(reuse);
+    spelling_table.set_reuse_free_blocks(reuse);
+    docdata_table.set_reuse_free_blocks(reuse);
+}
+
+bool
+GlassDatabase::can_sync_in_background(int flags) const
+{
+    // Changesets are written by all the tables to a single file, and the
+    // doclen column is written after the version file is in place, so just
+    // do these cases synchronously.
+    return !(flags & (Xapian::DB_NO_SYNC | Xapian::DB_DANGEROUS)) &&
+	   !version_file.single_file() &&
+	   !doclen_column.is_maintained() &&
+	   !changes.is_active();
+}
+
+void
+GlassDatabase::finish_background_sync(bool wait)
+{
+    LOGCALL_VOID(DB, "GlassDatabase::finish_background_sync", wait);
+    if (!sync_thread.joinable()) return;
+    if (!wait && !sync_done.load(memory_order_acquire)) return;
+
+    sync_thread.join();
+    if (sync_errno) {
+	// The revision we've moved on from isn't on disk, so continuing could
+	// lose changes or overwrite blocks the revision on disk uses.
+	int e = sync_errno;
+	sync_errno = 0;
+	// Our caller may be a destructor which has to discard the exception.
+	LOGLINE(DB, "Syncing a commit in the background failed: " <<
+		    errno_to_string(e));
+	GlassDatabase::close();
+	throw Xapian::DatabaseError("Commit failed", e);
+    }
+    set_reuse_free_blocks(true);
+}
+
+void
+GlassDatabase::write_doclen_column(int flags, bool create)
+{
+    LOGCALL_VOID(DB, "GlassDatabase::write_doclen_column", flags|create);
+    if (!create && !doclen_column.is_maintained()) return;
+
+    // If we don't have the column for the previous revision, read all the
+    // document lengths from the postlist table.  We can't use
+    // open_post_list() here as this may be called while the database is
+    // being destroyed.
+    unique_ptr<GlassPostList> pl;
+    if (!doclen_column.can_update())
+	pl.reset(new GlassPostList(postlist_table, string()));
+    doclen_column.commit(version_file.get_uuid(),
+			 version_file.get_revision(),
+			 version_file.get_last_docid(),
+			 version_file.get_doclength_upper_bound(),
+			 pl.get(), flags);
+}
+
 void
 GlassDatabase::request_document(Xapian::docid did) const
 {
+    if (wal_overlay.get()) {
+	wal_overlay->request_document(did);
+	return;
+    }
     docdata_table.readahead_for_document(did);
 }
 
 void
 GlassDatabase::readahead_for_query(const Xapian::Query &query) const
 {
+    if (wal_overlay.get()) {
+	wal_overlay->readahead_for_query(query);
+	return;
+    }
     Xapian::TermIterator t;
     for (t = query.get_unique_terms_begin(); t != Xapian::TermIterator(); ++t) {
 	const string & term = *t;
@@ -395,20 +628,77 @@ GlassDatabase::reopen()
 {
     LOGCALL(DB, bool, "GlassDatabase::reopen", NO_ARGS);
     if (!readonly) RETURN(false);
-    RETURN(open_tables(postlist_table.get_flags()));
+    bool changed = open_tables(postlist_table.get_flags());
+    // A commit to the write-ahead log doesn't change the revision, but it
+    // does make the log longer.
+    if (changed) {
+	update_wal_overlay();
+    } else if (!db_dir.empty()) {
+	off_t wal_size = GlassWAL::file_size(db_dir);
+	if (wal_size != wal_overlay_size) {
+	    // If the log has just grown, replay the new commits on top of
+	    // those we've already replayed.
+	    auto overlay =
+		static_cast<GlassWritableDatabase*>(wal_overlay.get());
+	    if (overlay && wal_size > wal_overlay_size &&
+		overlay->replay_more_wal()) {
+		wal_overlay_size = wal_size;
+	    } else {
+		update_wal_overlay();
+	    }
+	    changed = true;
+	}
+    }
+    RETURN(changed);
+}
+
+void
+GlassDatabase::update_wal_overlay()
+{
+    LOGCALL_VOID(DB, "GlassDatabase::update_wal_overlay", NO_ARGS);
+    wal_overlay = NULL;
+    // A single-file database can't have a write-ahead log.
+    wal_overlay_size = db_dir.empty() ? 0 : GlassWAL::file_size(db_dir);
+    if (wal_overlay_size == 0) return;
+
+    // The overlay opens the latest revision itself, which is normally the
+    // one we just opened, and replays the log if it's for that revision.
+    intrusive_ptr<GlassWritableDatabase> overlay;
+    overlay = new GlassWritableDatabase(db_dir, GlassWALOverlay());
+    if (overlay->replayed_wal())
+	wal_overlay = overlay.get();
 }
 
 void
 GlassDatabase::close()
 {
     LOGCALL_VOID(DB, "GlassDatabase::close", NO_ARGS);
+    if (wal_overlay.get()) {
+	// Not GlassWritableDatabase::close(), which would write the
+	// modifications to the tables.
+	wal_overlay->GlassDatabase::close();
+	wal_overlay = NULL;
+    }
+    // Don't close the tables while they're being synced.
+    int e = 0;
+    if (sync_thread.joinable()) {
+	sync_thread.join();
+	e = sync_errno;
+	sync_errno = 0;
+    }
     postlist_table.close(true);
     position_table.close(true);
     termlist_table.close(true);
     synonym_table.close(true);
     spelling_table.close(true);
     docdata_table.close(true);
+    doclen_column.close();
     lock.release();
+    if (e) {
+	LOGLINE(DB, "Syncing a commit in the background failed: " <<
+		    errno_to_string(e));
+	throw Xapian::DatabaseError("Commit failed", e);
+    }
 }
 
 void
@@ -654,9 +944,9 @@ GlassDatabase::modifications_failed(glass_revision_number_t new_revision,
 }
 
 void
-GlassDatabase::apply()
+GlassDatabase::apply(bool background)
 {
-    LOGCALL_VOID(DB, "GlassDatabase::apply", NO_ARGS);
+    LOGCALL_VOID(DB, "GlassDatabase::apply", background);
     if (!postlist_table.is_modified() &&
 	!position_table.is_modified() &&
 	!termlist_table.is_modified() &&
@@ -664,14 +954,28 @@ GlassDatabase::apply()
 	!synonym_table.is_modified() &&
 	!spelling_table.is_modified() &&
 	!docdata_table.is_modified()) {
+	// There's nothing new to commit, but a revision from commit_async()
+	// still needs to be on disk before commit() returns.
+	if (!background) finish_background_sync();
 	return;
     }
 
+    if (rare(is_wal_overlay)) {
+	// The modifications are from replaying the write-ahead log for a
+	// reader, and are only in memory.
+	throw Xapian::InvalidOperationError("Can't commit a replay of the "
+					    "write-ahead log");
+    }
+
+    // If syncing the previous revision failed, we want to throw that error
+    // rather than trying to roll back.
+    finish_background_sync();
+
     glass_revision_number_t new_revision = get_next_revision_number();
 
     int flags = postlist_table.get_flags();
     try {
-	set_revision_number(flags, new_revision);
+	set_revision_number(flags, new_revision, background);
     } catch (const Xapian::Error &e) {
 	modifications_failed(new_revision, e.get_description());
 	throw;
@@ -695,6 +999,7 @@ void
 GlassDatabase::cancel()
 {
     LOGCALL_VOID(DB, "GlassDatabase::cancel", NO_ARGS);
+    finish_background_sync();
     version_file.cancel();
     glass_revision_number_t rev = version_file.get_revision();
     postlist_table.cancel(version_file.get_root(Glass::POSTLIST), rev);
@@ -704,6 +1009,7 @@ GlassDatabase::cancel()
     synonym_table.cancel(version_file.get_root(Glass::SYNONYM), rev);
     spelling_table.cancel(version_file.get_root(Glass::SPELLING), rev);
     docdata_table.cancel(version_file.get_root(Glass::DOCDATA), rev);
+    doclen_column.cancel();
 
     Xapian::termcount ub = version_file.get_spelling_wordfreq_upper_bound();
     spelling_table.set_wordfreq_upper_bound(ub);
@@ -713,6 +1019,7 @@ Xapian::doccount
 GlassDatabase::get_doccount() const
 {
     LOGCALL(DB, Xapian::doccount, "GlassDatabase::get_doccount", NO_ARGS);
+    if (wal_overlay.get()) RETURN(wal_overlay->get_doccount());
     RETURN(version_file.get_doccount());
 }
 
@@ -720,6 +1027,7 @@ Xapian::docid
 GlassDatabase::get_lastdocid() const
 {
     LOGCALL(DB, Xapian::docid, "GlassDatabase::get_lastdocid", NO_ARGS);
+    if (wal_overlay.get()) RETURN(wal_overlay->get_lastdocid());
     RETURN(version_file.get_last_docid());
 }
 
@@ -727,6 +1035,7 @@ Xapian::totallength
 GlassDatabase::get_total_length() const
 {
     LOGCALL(DB, Xapian::totallength, "GlassDatabase::get_total_length", NO_ARGS);
+    if (wal_overlay.get()) RETURN(wal_overlay->get_total_length());
     RETURN(version_file.get_total_doclen());
 }
 
@@ -734,7 +1043,11 @@ Xapian::termcount
 GlassDatabase::get_doclength(Xapian::docid did) const
 {
     LOGCALL(DB, Xapian::termcount, "GlassDatabase::get_doclength", did);
+    if (wal_overlay.get()) RETURN(wal_overlay->get_doclength(did));
     Assert(did != 0);
+    Xapian::termcount doclen;
+    if (doclen_column.get_doclength(did, doclen))
+	RETURN(doclen);
     intrusive_ptr<const GlassDatabase> ptrtothis(this);
     RETURN(postlist_table.get_doclength(did, ptrtothis));
 }
@@ -743,6 +1056,7 @@ Xapian::termcount
 GlassDatabase::get_unique_terms(Xapian::docid did) const
 {
     LOGCALL(DB, Xapian::termcount, "GlassDatabase::get_unique_terms", did);
+    if (wal_overlay.get()) RETURN(wal_overlay->get_unique_terms(did));
     Assert(did != 0);
     intrusive_ptr<const GlassDatabase> ptrtothis(this);
     RETURN(GlassTermList(ptrtothis, did).get_unique_terms());
@@ -752,6 +1066,7 @@ Xapian::termcount
 GlassDatabase::get_wdfdocmax(Xapian::docid did) const
 {
     LOGCALL(DB, Xapian::termcount, "GlassDatabase::get_wdfdocmax", did);
+    if (wal_overlay.get()) RETURN(wal_overlay->get_wdfdocmax(did));
     Assert(did != 0);
     intrusive_ptr<const GlassDatabase> ptrtothis(this);
     GlassTermList termlist(ptrtothis, did);
@@ -771,6 +1086,10 @@ GlassDatabase::get_freqs(const string & term,
 			 Xapian::termcount * collfreq_ptr) const
 {
     LOGCALL_VOID(DB, "GlassDatabase::get_freqs", term | termfreq_ptr | collfreq_ptr);
+    if (wal_overlay.get()) {
+	wal_overlay->get_freqs(term, termfreq_ptr, collfreq_ptr);
+	return;
+    }
     Assert(!term.empty());
     postlist_table.get_freqs(term, termfreq_ptr, collfreq_ptr);
 }
@@ -779,6 +1098,7 @@ Xapian::doccount
 GlassDatabase::get_value_freq(Xapian::valueno slot) const
 {
     LOGCALL(DB, Xapian::doccount, "GlassDatabase::get_value_freq", slot);
+    if (wal_overlay.get()) RETURN(wal_overlay->get_value_freq(slot));
     RETURN(value_manager.get_value_freq(slot));
 }
 
@@ -786,6 +1106,7 @@ std::string
 GlassDatabase::get_value_lower_bound(Xapian::valueno slot) const
 {
     LOGCALL(DB, std::string, "GlassDatabase::get_value_lower_bound", slot);
+    if (wal_overlay.get()) RETURN(wal_overlay->get_value_lower_bound(slot));
     RETURN(value_manager.get_value_lower_bound(slot));
 }
 
@@ -793,24 +1114,28 @@ std::string
 GlassDatabase::get_value_upper_bound(Xapian::valueno slot) const
 {
     LOGCALL(DB, std::string, "GlassDatabase::get_value_upper_bound", slot);
+    if (wal_overlay.get()) RETURN(wal_overlay->get_value_upper_bound(slot));
     RETURN(value_manager.get_value_upper_bound(slot));
 }
 
 Xapian::termcount
 GlassDatabase::get_doclength_lower_bound() const
 {
+    if (wal_overlay.get()) return wal_overlay->get_doclength_lower_bound();
     return version_file.get_doclength_lower_bound();
 }
 
 Xapian::termcount
 GlassDatabase::get_doclength_upper_bound() const
 {
+    if (wal_overlay.get()) return wal_overlay->get_doclength_upper_bound();
     return version_file.get_doclength_upper_bound();
 }
 
 Xapian::termcount
 GlassDatabase::get_wdf_upper_bound(const string & term) const
 {
+    if (wal_overlay.get()) return wal_overlay->get_wdf_upper_bound(term);
     Assert(!term.empty());
     Xapian::termcount wdfub;
     postlist_table.get_freqs(term, NULL, NULL, &wdfub);
@@ -820,6 +1145,7 @@ GlassDatabase::get_wdf_upper_bound(const string & term) const
 Xapian::termcount
 GlassDatabase::get_unique_terms_lower_bound() const
 {
+    if (wal_overlay.get()) return wal_overlay->get_unique_terms_lower_bound();
     return version_file.get_unique_terms_lower_bound();
 }
 
@@ -827,6 +1153,7 @@ bool
 GlassDatabase::term_exists(const string & term) const
 {
     LOGCALL(DB, bool, "GlassDatabase::term_exists", term);
+    if (wal_overlay.get()) RETURN(wal_overlay->term_exists(term));
     if (term.empty()) {
 	RETURN(get_doccount() != 0);
     }
@@ -836,6 +1163,7 @@ GlassDatabase::term_exists(const string & term) const
 bool
 GlassDatabase::has_positions() const
 {
+    if (wal_overlay.get()) return wal_overlay->has_positions();
     return !position_table.empty();
 }
 
@@ -843,6 +1171,7 @@ PostList *
 GlassDatabase::open_post_list(const string& term) const
 {
     LOGCALL(DB, PostList *, "GlassDatabase::open_post_list", term);
+    if (wal_overlay.get()) RETURN(wal_overlay->open_post_list(term));
     RETURN(GlassDatabase::open_leaf_post_list(term, false));
 }
 
@@ -850,6 +1179,8 @@ LeafPostList*
 GlassDatabase::open_leaf_post_list(const string& term, bool need_read_pos) const
 {
     LOGCALL(DB, LeafPostList *, "GlassDatabase::open_leaf_post_list", term | need_read_pos);
+    if (wal_overlay.get())
+	RETURN(wal_overlay->open_leaf_post_list(term, need_read_pos));
     (void)need_read_pos;
     intrusive_ptr<const GlassDatabase> ptrtothis(this);
 
@@ -869,6 +1200,7 @@ ValueList *
 GlassDatabase::open_value_list(Xapian::valueno slot) const
 {
     LOGCALL(DB, ValueList *, "GlassDatabase::open_value_list", slot);
+    if (wal_overlay.get()) RETURN(wal_overlay->open_value_list(slot));
     intrusive_ptr<const GlassDatabase> ptrtothis(this);
     RETURN(new GlassValueList(slot, ptrtothis));
 }
@@ -877,6 +1209,7 @@ TermList *
 GlassDatabase::open_term_list(Xapian::docid did) const
 {
     LOGCALL(DB, TermList *, "GlassDatabase::open_term_list", did);
+    if (wal_overlay.get()) RETURN(wal_overlay->open_term_list(did));
     Assert(did != 0);
     if (!termlist_table.is_open())
 	throw_termlist_table_close_exception();
@@ -887,6 +1220,7 @@ GlassDatabase::open_term_list(Xapian::docid did) const
 TermList *
 GlassDatabase::open_term_list_direct(Xapian::docid did) const
 {
+    if (wal_overlay.get()) return wal_overlay->open_term_list_direct(did);
     return GlassDatabase::open_term_list(did);
 }
 
@@ -894,6 +1228,7 @@ Xapian::Document::Internal *
 GlassDatabase::open_document(Xapian::docid did, bool lazy) const
 {
     LOGCALL(DB, Xapian::Document::Internal *, "GlassDatabase::open_document", did | lazy);
+    if (wal_overlay.get()) RETURN(wal_overlay->open_document(did, lazy));
     Assert(did != 0);
     if (!lazy) {
 	// This will throw DocNotFoundError if the document doesn't exist.
@@ -909,6 +1244,10 @@ GlassDatabase::read_position_list(GlassRePositionList* pos_list,
 				  Xapian::docid did,
 				  const string& term) const
 {
+    if (wal_overlay.get()) {
+	wal_overlay->read_position_list(pos_list, did, term);
+	return;
+    }
     Assert(did != 0);
     pos_list->read_data(did, term);
 }
@@ -916,12 +1255,14 @@ GlassDatabase::read_position_list(GlassRePositionList* pos_list,
 Xapian::termcount
 GlassDatabase::positionlist_count(Xapian::docid did, const string& term) const
 {
+    if (wal_overlay.get()) return wal_overlay->positionlist_count(did, term);
     return position_table.positionlist_count(did, term);
 }
 
 PositionList *
 GlassDatabase::open_position_list(Xapian::docid did, const string& term) const
 {
+    if (wal_overlay.get()) return wal_overlay->open_position_list(did, term);
     Assert(did != 0);
     return new GlassPositionList(&position_table, did, term);
 }
@@ -930,6 +1271,7 @@ TermList *
 GlassDatabase::open_allterms(const string & prefix) const
 {
     LOGCALL(DB, TermList *, "GlassDatabase::open_allterms", NO_ARGS);
+    if (wal_overlay.get()) RETURN(wal_overlay->open_allterms(prefix));
     RETURN(new GlassAllTermsList(intrusive_ptr<const GlassDatabase>(this),
 				 prefix));
 }
@@ -937,12 +1279,14 @@ GlassDatabase::open_allterms(const string & prefix) const
 TermList *
 GlassDatabase::open_spelling_termlist(const string & word) const
 {
+    if (wal_overlay.get()) return wal_overlay->open_spelling_termlist(word);
     return spelling_table.open_termlist(word);
 }
 
 TermList *
 GlassDatabase::open_spelling_wordlist() const
 {
+    if (wal_overlay.get()) return wal_overlay->open_spelling_wordlist();
     GlassCursor * cursor = spelling_table.cursor_get();
     if (!cursor) return NULL;
     return new GlassSpellingWordsList(intrusive_ptr<const GlassDatabase>(this),
@@ -952,18 +1296,21 @@ GlassDatabase::open_spelling_wordlist() const
 Xapian::doccount
 GlassDatabase::get_spelling_frequency(const string & word) const
 {
+    if (wal_overlay.get()) return wal_overlay->get_spelling_frequency(word);
     return spelling_table.get_word_frequency(word);
 }
 
 TermList *
 GlassDatabase::open_synonym_termlist(const string & term) const
 {
+    if (wal_overlay.get()) return wal_overlay->open_synonym_termlist(term);
     return synonym_table.open_termlist(term);
 }
 
 TermList *
 GlassDatabase::open_synonym_keylist(const string & prefix) const
 {
+    if (wal_overlay.get()) return wal_overlay->open_synonym_keylist(prefix);
     GlassCursor * cursor = synonym_table.cursor_get();
     if (!cursor) return NULL;
     return new GlassSynonymTermList(intrusive_ptr<const GlassDatabase>(this),
@@ -974,6 +1321,7 @@ string
 GlassDatabase::get_metadata(const string & key) const
 {
     LOGCALL(DB, string, "GlassDatabase::get_metadata", key);
+    if (wal_overlay.get()) RETURN(wal_overlay->get_metadata(key));
     string btree_key("\x00\xc0", 2);
     btree_key += key;
     string tag;
@@ -985,19 +1333,55 @@ TermList *
 GlassDatabase::open_metadata_keylist(const std::string &prefix) const
 {
     LOGCALL(DB, TermList *, "GlassDatabase::open_metadata_keylist", NO_ARGS);
+    if (wal_overlay.get()) RETURN(wal_overlay->open_metadata_keylist(prefix));
     GlassCursor * cursor = postlist_table.cursor_get();
     if (!cursor) RETURN(NULL);
     RETURN(new GlassMetadataTermList(intrusive_ptr<const GlassDatabase>(this),
 				     cursor, prefix));
 }
 
+Xapian::Database::Internal*
+GlassDatabase::open_instance() const
+{
+    LOGCALL(DB, Xapian::Database::Internal*, "GlassDatabase::open_instance", NO_ARGS);
+    // A single-file database opened from an fd has no path to open again.
+    // Another instance could replay a different amount of the write-ahead
+    // log, so we don't open one while we're using it.
+    if (!readonly || db_dir.empty() || wal_overlay.get())
+	RETURN(NULL);
+    RETURN(new GlassDatabase(db_dir, Xapian::DB_READONLY_, 0u, mmapped));
+}
+
+void
+GlassDatabase::get_readahead_stats(size_t& issued, size_t& used) const
+{
+    if (wal_overlay.get()) {
+	wal_overlay->get_readahead_stats(issued, used);
+	return;
+    }
+    issued += postlist_table.get_readahead_issued();
+    used += postlist_table.get_readahead_used();
+}
+
 Xapian::rev
 GlassDatabase::get_revision() const
 {
     LOGCALL(DB, Xapian::rev, "GlassDatabase::get_revision", NO_ARGS);
+    if (wal_overlay.get()) RETURN(wal_overlay->get_revision());
     RETURN(version_file.get_revision());
 }
 
+string
+GlassDatabase::get_cache_key() const
+{
+    LOGCALL(DB, string, "GlassDatabase::get_cache_key", NO_ARGS);
+    string key = Xapian::Database::Internal::get_cache_key();
+    // The write-ahead log only grows until the revision changes.
+    if (wal_overlay.get() && !key.empty())
+	pack_uint(key, static_cast<unsigned long long>(wal_overlay_size));
+    RETURN(key);
+}
+
 string
 GlassDatabase::get_uuid() const
 {
@@ -1019,6 +1403,10 @@ void
 GlassDatabase::get_used_docid_range(Xapian::docid & first,
 				    Xapian::docid & last) const
 {
+    if (wal_overlay.get()) {
+	wal_overlay->get_used_docid_range(first, last);
+	return;
+    }
     last = version_file.get_last_docid();
     if (last == version_file.get_doccount()) {
 	// Contiguous range starting at 1.
@@ -1074,7 +1462,8 @@ GlassWritableDatabase::GlassWritableDatabase(const string &dir, int flags,
 	  change_count(0),
 	  flush_threshold(0),
 	  modify_shortcut_document(NULL),
-	  modify_shortcut_docid(0)
+	  modify_shortcut_docid(0),
+	  wal(dir)
 {
     LOGCALL_CTOR(DB, "GlassWritableDatabase", dir | flags | block_size);
 
@@ -1085,34 +1474,187 @@ GlassWritableDatabase::GlassWritableDatabase(const string &dir, int flags,
 					       "be a non-negative integer");
 	}
     }
-    if (flush_threshold == 0)
-	flush_threshold = 10000;
+
+    p = getenv("XAPIAN_WAL_CHECKPOINT_SIZE");
+    if (p && *p) {
+	make_unsigned<off_t>::type value;
+	if (!parse_unsigned(p, value) || value == 0 || off_t(value) < 0) {
+	    throw Xapian::InvalidArgumentError("XAPIAN_WAL_CHECKPOINT_SIZE "
+					       "must be a positive integer");
+	}
+	wal_checkpoint_size = off_t(value);
+    }
+
+    // With DB_DANGEROUS, uncommitted changes can overwrite the revision the
+    // log applies to.
+    use_wal = (flags & Xapian::DB_WRITE_AHEAD_LOG) &&
+	      !(flags & Xapian::DB_DANGEROUS);
+
+    // Make any modifications which were committed to the write-ahead log but
+    // not written to the tables.
+    string mods;
+    wal.read(version_file.get_uuid(), version_file.get_revision(), mods);
+    if (!mods.empty()) {
+	// Modifying documents creates intrusive_ptr-s to this object, which
+	// would delete it when destroyed as it's not referenced yet.
+	++_refs;
+	try {
+	    replay_wal(mods);
+	    if (!use_wal) checkpoint();
+	} catch (...) {
+	    --_refs;
+	    throw;
+	}
+	--_refs;
+    }
+}
+
+GlassWritableDatabase::GlassWritableDatabase(const string& dir,
+					     GlassWALOverlay tag)
+	: GlassDatabase(dir, tag),
+	  change_count(0),
+	  flush_threshold(0),
+	  modify_shortcut_document(NULL),
+	  modify_shortcut_docid(0),
+	  wal(dir)
+{
+    LOGCALL_CTOR(DB, "GlassWritableDatabase", dir | Literal("overlay"));
+    string mods;
+    wal.read(version_file.get_uuid(), version_file.get_revision(), mods, true);
+    if (!mods.empty()) replay_wal_for_reader(mods);
+}
+
+void
+GlassWritableDatabase::replay_wal_for_reader(const string& mods)
+{
+    LOGCALL_VOID(DB, "GlassWritableDatabase::replay_wal_for_reader", mods.size());
+    ++_refs;
+    try {
+	replay_wal(mods);
+	// Merge the buffered changes into the tables (in memory), as
+	// compaction reads the tables directly.
+	flush_postlist_changes();
+	value_manager.set_value_stats(value_stats);
+	synonym_table.flush_db();
+	Xapian::termcount swfub = spelling_table.flush_db();
+	version_file.set_spelling_wordfreq_upper_bound(swfub);
+    } catch (...) {
+	--_refs;
+	throw;
+    }
+    --_refs;
+}
+
+bool
+GlassWritableDatabase::replay_more_wal()
+{
+    LOGCALL(DB, bool, "GlassWritableDatabase::replay_more_wal", NO_ARGS);
+    string mods;
+    if (!wal.read_more(version_file.get_uuid(), version_file.get_revision(),
+		       mods)) {
+	RETURN(false);
+    }
+    if (!mods.empty()) replay_wal_for_reader(mods);
+    RETURN(true);
 }
 
 GlassWritableDatabase::~GlassWritableDatabase()
 {
     LOGCALL_DTOR(DB, "GlassWritableDatabase");
+    if (use_wal && !transaction_active()) {
+	// Write the modifications to the tables so that readers see them.
+	try {
+	    checkpoint();
+	} catch (...) {
+	    // If they were committed they're still in the log.
+	}
+    }
     dtor_called();
 }
 
+void
+GlassWritableDatabase::checkpoint()
+{
+    if (change_count) flush_postlist_changes();
+    apply();
+}
+
 void
 GlassWritableDatabase::commit()
 {
     if (transaction_active())
 	throw Xapian::InvalidOperationError("Can't commit during a transaction");
+    if (!use_wal) {
+	checkpoint();
+	return;
+    }
+
+    if (wal_mods.empty()) return;
+    try {
+	wal.append(wal_mods, version_file.get_uuid(),
+		   version_file.get_revision(), postlist_table.get_flags());
+    } catch (...) {
+	// Discard the modifications, as happens if writing a new revision
+	// fails.
+	try {
+	    GlassWritableDatabase::cancel();
+	} catch (...) {
+	}
+	throw;
+    }
+    wal_mods.clear();
+    if (wal.get_size() >= wal_checkpoint_size) checkpoint();
+}
+
+void
+GlassWritableDatabase::commit_async()
+{
+    if (transaction_active())
+	throw Xapian::InvalidOperationError("Can't commit during a transaction");
+    if (use_wal) {
+	// Appending to the log is cheap enough anyway.
+	commit();
+	return;
+    }
     if (change_count) flush_postlist_changes();
-    apply();
+    apply(true);
+}
+
+void
+GlassWritableDatabase::wait_for_commit()
+{
+    finish_background_sync();
+}
+
+void
+GlassWritableDatabase::set_flush_memory_limit(size_t limit)
+{
+    flush_memory_limit = limit;
+}
+
+size_t
+GlassWritableDatabase::get_buffered_memory() const
+{
+    return inverter.get_memory_used() + value_manager.get_memory_used();
 }
 
 void
 GlassWritableDatabase::check_flush_threshold()
 {
-    // FIXME: this should be done by checking memory usage, not the number of
-    // changes.  We could also look at the amount of data the inverter object
-    // currently holds.
-    if (++change_count >= flush_threshold) {
+    ++change_count;
+    bool flush;
+    if (flush_memory_limit) {
+	flush = get_buffered_memory() >= flush_memory_limit ||
+		(flush_threshold && change_count >= flush_threshold);
+    } else {
+	flush = change_count >= (flush_threshold ? flush_threshold : 10000);
+    }
+    if (flush) {
 	flush_postlist_changes();
-	if (!transaction_active()) apply();
+	if (!transaction_active() && !wal_suspended) apply();
+    } else {
+	// If a background sync has finished, start reusing free blocks again.
+	finish_background_sync(false);
     }
 }
 
@@ -1123,6 +1665,9 @@ GlassWritableDatabase::flush_postlist_changes()
 	version_file.set_oldest_changeset(changes.get_oldest_changeset());
 	inverter.flush(postlist_table);
 	inverter.flush_pos_lists(position_table);
+	// Value changes would otherwise stay buffered until the changes are
+	// committed, which doesn't happen here within a transaction.
+	value_manager.merge_changes();
 
 	change_count = 0;
     } catch (...) {
@@ -1139,17 +1684,113 @@ GlassWritableDatabase::close()
 {
     LOGCALL_VOID(DB, "GlassWritableDatabase::close", NO_ARGS);
     if (!transaction_active()) {
-	commit();
-	// FIXME: if commit() throws, should we still close?
+	// Unlike commit(), this writes any modifications which are only in
+	// the write-ahead log to the tables.
+	checkpoint();
+	// FIXME: if checkpoint() throws, should we still close?
     }
     GlassDatabase::close();
 }
 
 void
-GlassWritableDatabase::apply()
+GlassWritableDatabase::apply(bool background)
 {
     value_manager.set_value_stats(value_stats);
-    GlassDatabase::apply();
+    // Don't replay the log if cancel() gets called because applying the
+    // changes fails.
+    wal_suspended = true;
+    try {
+	GlassDatabase::apply(background);
+    } catch (...) {
+	wal_suspended = false;
+	if (wal.exists() && postlist_table.is_open()) {
+	    // The tables have been rolled back to the last revision and given
+	    // a new revision number, so the log needs to apply to that.
+	    try {
+		glass_revision_number_t rev = version_file.get_revision();
+		wal.rebase(version_file.get_uuid(), rev,
+			   postlist_table.get_flags());
+		string mods;
+		wal.read(version_file.get_uuid(), rev, mods);
+		replay_wal(mods);
+	    } catch (...) {
+	    }
+	}
+	throw;
+    }
+    wal_suspended = false;
+
+    // The new revision includes everything in the log.
+    wal_mods.clear();
+    if (wal.exists()) wal.remove();
+}
+
+void
+GlassWritableDatabase::replay_wal(const string& mods)
+{
+    LOGCALL_VOID(DB, "GlassWritableDatabase::replay_wal", mods.size());
+    const char* p = mods.data();
+    const char* end = p + mods.size();
+    wal_suspended = true;
+    try {
+	while (p != end) {
+	    unsigned char type = *p++;
+	    Xapian::docid did;
+	    Xapian::termcount freq;
+	    string a, b;
+	    bool ok;
+	    switch (type) {
+		case Glass::WAL_REPLACE_DOCUMENT:
+		    ok = unpack_uint(&p, end, &did) && did &&
+			 unpack_string(&p, end, a);
+		    if (ok) replace_document(did, unserialise_document(a));
+		    break;
+		case Glass::WAL_DELETE_DOCUMENT:
+		    ok = unpack_uint(&p, end, &did) && did;
+		    if (ok) delete_document(did);
+		    break;
+		case Glass::WAL_SET_METADATA:
+		    ok = unpack_string(&p, end, a) &&
+			 unpack_string(&p, end, b);
+		    if (ok) set_metadata(a, b);
+		    break;
+		case Glass::WAL_ADD_SPELLING:
+		    ok = unpack_string(&p, end, a) &&
+			 unpack_uint(&p, end, &freq);
+		    if (ok) add_spelling(a, freq);
+		    break;
+		case Glass::WAL_REMOVE_SPELLING:
+		    ok = unpack_string(&p, end, a) &&
+			 unpack_uint(&p, end, &freq);
+		    if (ok) (void)remove_spelling(a, freq);
+		    break;
+		case Glass::WAL_ADD_SYNONYM:
+		    ok = unpack_string(&p, end, a) &&
+			 unpack_string(&p, end, b);
+		    if (ok) add_synonym(a, b);
+		    break;
+		case Glass::WAL_REMOVE_SYNONYM:
+		    ok = unpack_string(&p, end, a) &&
+			 unpack_string(&p, end, b);
+		    if (ok) remove_synonym(a, b);
+		    break;
+		case Glass::WAL_CLEAR_SYNONYMS:
+		    ok = unpack_string(&p, end, a);
+		    if (ok) clear_synonyms(a);
+		    break;
+		default:
+		    ok = false;
+	    }
+	    if (!ok) {
+		throw Xapian::DatabaseCorruptError("Bad modification in "
+						   "write-ahead log");
+	    }
+	}
+    } catch (...) {
+	wal_suspended = false;
+	throw;
+    }
+    wal_suspended = false;
 }
 
 Xapian::docid
@@ -1202,6 +1843,12 @@ GlassWritableDatabase::add_document_(Xapian::docid did,
 	// Set the new document length
 	inverter.set_doclength(did, new_doclen, true);
 	version_file.add_document(new_doclen);
+
+	if (logging_to_wal()) {
+	    wal_mods += char(Glass::WAL_REPLACE_DOCUMENT);
+	    pack_uint(wal_mods, did);
+	    pack_string(wal_mods, serialise_document(document));
+	}
     } catch (...) {
 	// If an error occurs while adding a document, or doing any other
 	// transaction, the modifications so far must be cleared before
@@ -1268,6 +1915,11 @@ GlassWritableDatabase::delete_document(Xapian::docid did)
 
 	// Mark this document as removed.
 	inverter.delete_doclength(did);
+
+	if (logging_to_wal()) {
+	    wal_mods += char(Glass::WAL_DELETE_DOCUMENT);
+	    pack_uint(wal_mods, did);
+	}
     } catch (...) {
 	// If an error occurs while deleting a document, or doing any other
 	// transaction, the modifications so far must be cleared before
@@ -1306,6 +1958,11 @@ GlassWritableDatabase::replace_document(Xapian::docid did,
 	    throw_termlist_table_close_exception();
 	}
 
+	// Serialise the document before we modify the database, as parts of
+	// it may be read lazily from the version we're replacing.
+	string serialised_doc;
+	if (logging_to_wal()) serialised_doc = serialise_document(document);
+
 	// Check for a document read from this database being replaced - ie, a
 	// modification operation.
 	bool modifying = false;
@@ -1428,6 +2085,12 @@ GlassWritableDatabase::replace_document(Xapian::docid did,
 	    // Replace the values.
 	    value_manager.replace_document(did, document, value_stats);
 	}
+
+	if (logging_to_wal()) {
+	    wal_mods += char(Glass::WAL_REPLACE_DOCUMENT);
+	    pack_uint(wal_mods, did);
+	    pack_string(wal_mods, serialised_doc);
+	}
     } catch (...) {
 	// If an error occurs while replacing a document, or doing any other
 	// transaction, the modifications so far must be cleared before
@@ -1653,6 +2316,14 @@ GlassWritableDatabase::cancel()
     inverter.clear();
     value_stats.clear();
     change_count = 0;
+    wal_mods.clear();
+
+    if (wal.exists() && !wal_suspended) {
+	// Make the modifications committed to the write-ahead log again.
+	string mods;
+	wal.read(version_file.get_uuid(), version_file.get_revision(), mods);
+	replay_wal(mods);
+    }
 }
 
 void
@@ -1660,13 +2331,24 @@ GlassWritableDatabase::add_spelling(const string & word,
 				    Xapian::termcount freqinc) const
 {
     spelling_table.add_word(word, freqinc);
+    if (logging_to_wal()) {
+	wal_mods += char(Glass::WAL_ADD_SPELLING);
+	pack_string(wal_mods, word);
+	pack_uint(wal_mods, freqinc);
+    }
 }
 
 Xapian::termcount
 GlassWritableDatabase::remove_spelling(const string & word,
 				       Xapian::termcount freqdec) const
 {
-    return spelling_table.remove_word(word, freqdec);
+    Xapian::termcount result = spelling_table.remove_word(word, freqdec);
+    if (logging_to_wal()) {
+	wal_mods += char(Glass::WAL_REMOVE_SPELLING);
+	pack_string(wal_mods, word);
+	pack_uint(wal_mods, freqdec);
+    }
+    return result;
 }
 
 TermList *
@@ -1688,6 +2370,11 @@ GlassWritableDatabase::add_synonym(const string & term,
 				   const string & synonym) const
 {
     synonym_table.add_synonym(term, synonym);
+    if (logging_to_wal()) {
+	wal_mods += char(Glass::WAL_ADD_SYNONYM);
+	pack_string(wal_mods, term);
+	pack_string(wal_mods, synonym);
+    }
 }
 
 void
@@ -1695,12 +2382,21 @@ GlassWritableDatabase::remove_synonym(const string & term,
 				      const string & synonym) const
 {
     synonym_table.remove_synonym(term, synonym);
+    if (logging_to_wal()) {
+	wal_mods += char(Glass::WAL_REMOVE_SYNONYM);
+	pack_string(wal_mods, term);
+	pack_string(wal_mods, synonym);
+    }
 }
 
 void
 GlassWritableDatabase::clear_synonyms(const string & term) const
 {
     synonym_table.clear_synonyms(term);
+    if (logging_to_wal()) {
+	wal_mods += char(Glass::WAL_CLEAR_SYNONYMS);
+	pack_string(wal_mods, term);
+    }
 }
 
 void
@@ -1714,6 +2410,11 @@ GlassWritableDatabase::set_metadata(const string & key, const string & value)
     } else {
 	postlist_table.add(btree_key, value);
     }
+    if (logging_to_wal()) {
+	wal_mods += char(Glass::WAL_SET_METADATA);
+	pack_string(wal_mods, key);
+	pack_string(wal_mods, value);
+    }
 }
 
 void
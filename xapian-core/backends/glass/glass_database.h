@@ -29,6 +29,7 @@
 #include "backends/databaseinternal.h"
 #include "glass_changes.h"
 #include "glass_docdata.h"
+#include "glass_doclencolumn.h"
 #include "glass_inverter.h"
 #include "glass_positionlist.h"
 #include "glass_postlist.h"
@@ -37,6 +38,7 @@
 #include "glass_termlisttable.h"
 #include "glass_values.h"
 #include "glass_version.h"
+#include "glass_wal.h"
 #include "../flint_lock.h"
 #include "glass_defs.h"
 #include "backends/valuestats.h"
@@ -44,13 +46,21 @@
 #include "xapian/compactor.h"
 #include "xapian/constants.h"
 
+#include <atomic>
+#include <cstddef>
 #include <map>
+#include <thread>
 
 class GlassTermList;
 class GlassAllDocsPostList;
 class HoneyDatabase;
 class RemoteConnection;
 
+/** Tag for opening a glass database to replay its write-ahead log for a
+ *  reader (see GlassDatabase::wal_overlay).
+ */
+struct GlassWALOverlay { };
+
 /** A backend designed for efficient indexing and retrieval, using
  *  compressed posting lists and a btree storage scheme.
  */
@@ -73,6 +83,13 @@ class GlassDatabase : public Xapian::Database::Internal {
      */
     bool readonly;
 
+    /** Is this replaying the write-ahead log for a reader?
+     *
+     *  If so, the tables are opened to write but keep the modifications in
+     *  memory, and nothing can be committed.
+     */
+    bool is_wal_overlay = false;
+
     /** The file describing the Glass database.
      *  This file has information about the format of the database
      *  which can't easily be stored in any of the individual tables.
@@ -116,11 +133,47 @@ class GlassDatabase : public Xapian::Database::Internal {
     /// Replication changesets.
     GlassChanges changes;
 
+    /// Dense column of document lengths (see Xapian::DB_DOCLEN_COLUMN).
+    GlassDocLenColumn doclen_column;
+
+    /** Thread syncing the last revision to disk.
+     *
+     *  Only used if the revision was committed with commit_async().
+     */
+    std::thread sync_thread;
+
+    /// Set by sync_thread once it's done.
+    std::atomic<bool> sync_done{false};
+
+    /// The errno from sync_thread if syncing failed, or 0.
+    int sync_errno = 0;
+
+    /// Were the tables opened to read via memory mappings?
+    bool mmapped = false;
+
+    /** The database with the write-ahead log replayed, or NULL.
+     *
+     *  Commits made with Xapian::DB_WRITE_AHEAD_LOG are only in the log
+     *  until a checkpoint, so if a reader finds a log it opens a
+     *  GlassWritableDatabase which replays it without writing anything, and
+     *  forwards the methods which read the database to that.
+     */
+    Xapian::Internal::intrusive_ptr<GlassDatabase> wal_overlay;
+
+    /// Size of the write-ahead log file when wal_overlay was last updated.
+    off_t wal_overlay_size = 0;
+
+    /// Update wal_overlay after the tables have been (re)opened.
+    void update_wal_overlay();
+
     /** Return true if a database exists at the path specified for this
      *  database.
      */
     bool database_exists();
 
+    /// Make all tables read blocks via memory mappings.
+    void set_mmap();
+
     /** Create new tables, and open them.
      *  Any existing tables will be removed first.
      */
@@ -163,8 +216,48 @@ class GlassDatabase : public Xapian::Database::Internal {
      *          be greater than the current revision number.  FIXME: If
      *          we support rewinding to a previous revision, maybe this
      *          needs to be greater than any previously used revision.
+     *
+     *  @param background If true, the syncing to disk is done on another
+     *		thread where possible (see finish_background_sync()).
+     */
+    void set_revision_number(int flags, glass_revision_number_t new_revision,
+			     bool background = false);
+
+    /** Wait for the syncing of a revision in the background to finish.
+     *
+     *  If the syncing failed, the database is closed and DatabaseError is
+     *  thrown.
+     *
+     *  @param wait	If false, only finish if the syncing already has.
+     */
+    void finish_background_sync(bool wait = true);
+
+    /** Sync the tables to disk.
+     *
+     *  @return true if all the syncs succeeded, otherwise false with errno
+     *		set.
+     */
+    bool sync_tables(int flags);
+
+    /** Get the file descriptors to sync the open tables.
+     *
+     *  @param fds	Array of at least Glass::MAX_ entries to store them in.
+     *
+     *  @return The number of file descriptors stored.
      */
-    void set_revision_number(int flags, glass_revision_number_t new_revision);
+    size_t get_fds_to_sync(int* fds) const;
+
+    /// Set whether the tables reuse blocks from their freelists.
+    void set_reuse_free_blocks(bool reuse);
+
+    /// Can a revision be synced to disk on another thread?
+    bool can_sync_in_background(int flags) const;
+
+    /** Write the dense document length column for the current revision.
+     *
+     *  @param create	Write it even if the column isn't being maintained.
+     */
+    void write_doclen_column(int flags, bool create = false);
 
     /** Re-open tables to recover from an overwritten condition,
      *  or just get most up-to-date version.
@@ -191,7 +284,7 @@ class GlassDatabase : public Xapian::Database::Internal {
      *  with increased revision numbers), and the outstanding changes will
      *  be lost.
      */
-    void apply();
+    void apply(bool background = false);
 
     /** Cancel any outstanding changes to the tables.
      */
@@ -226,15 +319,35 @@ class GlassDatabase : public Xapian::Database::Internal {
      *                    tables.  This is only important, and has the
      *                    correct value, when the database is being
      *                    created.
+     *
+     *  @param use_mmap   Read blocks via memory mappings of the table files
+     *                    (only used when opening read-only).
      */
     explicit GlassDatabase(const string& db_dir_,
 			   int flags = Xapian::DB_READONLY_,
-			   unsigned int block_size = 0u);
+			   unsigned int block_size = 0u,
+			   bool use_mmap = false);
 
-    explicit GlassDatabase(int fd);
+    explicit GlassDatabase(int fd, bool use_mmap = false);
+
+    /** Open a glass database to replay its write-ahead log for a reader.
+     *
+     *  The tables are opened to write, but with private writes (see
+     *  GlassTable::set_private_writes()), so the write lock isn't needed.
+     */
+    GlassDatabase(const string& db_dir_, GlassWALOverlay);
 
     ~GlassDatabase();
 
+    /** Get the database whose tables hold what this one reads.
+     *
+     *  That's wal_overlay if a write-ahead log has been replayed.  Used by
+     *  compaction, which reads the tables directly.
+     */
+    const GlassDatabase* tables_db() const {
+	return wal_overlay.get() ? wal_overlay.get() : this;
+    }
+
     /// Get a postlist table cursor (used by GlassValueList).
     GlassCursor * get_postlist_cursor() const {
 	return postlist_table.cursor_get();
@@ -292,12 +405,15 @@ class GlassDatabase : public Xapian::Database::Internal {
 				const string & start_revision,
 				bool need_whole_db,
 				Xapian::ReplicationInfo * info);
+    Xapian::Database::Internal* open_instance() const;
+    void get_readahead_stats(std::size_t& issued, std::size_t& used) const;
     /** Get the revision number which the tables are opened at.
      *
      *  @return the current revision number.
      */
     Xapian::rev get_revision() const;
     string get_uuid() const;
+    string get_cache_key() const;
 
     void request_document(Xapian::docid /*did*/) const;
     void readahead_for_query(const Xapian::Query &query) const;
@@ -348,9 +464,19 @@ class GlassWritableDatabase : public GlassDatabase {
      */
     mutable Xapian::doccount change_count;
 
-    /// If change_count reaches this threshold we automatically flush.
+    /** If change_count reaches this threshold we automatically flush.
+     *
+     *  0 means XAPIAN_FLUSH_THRESHOLD wasn't set, in which case we flush
+     *  every 10000 changes unless flush_memory_limit is set.
+     */
     Xapian::doccount flush_threshold;
 
+    /** If the buffered changes use this many bytes we automatically flush.
+     *
+     *  0 means there's no limit.
+     */
+    std::size_t flush_memory_limit = 0;
+
     /** A pointer to the last document which was returned by
      *  open_document(), or NULL if there is no such valid document.  This
      *  is used purely for comparing with a supplied document to help with
@@ -363,6 +489,52 @@ class GlassWritableDatabase : public GlassDatabase {
      */
     mutable Xapian::docid modify_shortcut_docid;
 
+    /// Write-ahead log (see Xapian::DB_WRITE_AHEAD_LOG).
+    GlassWAL wal;
+
+    /// Should commit() append to the write-ahead log?
+    bool use_wal = false;
+
+    /** Write the log to the tables if a commit makes it this many bytes.
+     *
+     *  Set from XAPIAN_WAL_CHECKPOINT_SIZE (default 16MB) - readers replay
+     *  the whole log on opening, so this limits the work they do.
+     */
+    off_t wal_checkpoint_size = 16 * 1024 * 1024;
+
+    /** Modifications since the last commit, to append to the write-ahead log.
+     *
+     *  Only used if use_wal is true.  Each modification is encoded as
+     *  described for Glass::wal_mod_type.
+     */
+    mutable std::string wal_mods;
+
+    /** Are the modifications being made already in the write-ahead log?
+     *
+     *  This is set while the log is being replayed, and while the
+     *  modifications are being written to the tables.
+     */
+    bool wal_suspended = false;
+
+    /// Should modifications be added to wal_mods?
+    bool logging_to_wal() const { return use_wal && !wal_suspended; }
+
+    /// Apply modifications read from the write-ahead log.
+    void replay_wal(const std::string& mods);
+
+    /** Apply modifications from the write-ahead log for a reader.
+     *
+     *  The changes are merged into the tables (in memory), as compaction
+     *  reads the tables directly.
+     */
+    void replay_wal_for_reader(const std::string& mods);
+
+    /** Write the modifications to the tables as a new revision.
+     *
+     *  This is what commit() does unless the write-ahead log is being used.
+     */
+    void checkpoint();
+
     /** Check if we should autoflush.
      *
      *  Called at the end of each document changing operation.
@@ -376,7 +548,7 @@ class GlassWritableDatabase : public GlassDatabase {
     void close();
 
     /// Apply changes.
-    void apply();
+    void apply(bool background = false);
 
     //@{
     /** Implementation of virtual methods: see Database::Internal for
@@ -384,9 +556,17 @@ class GlassWritableDatabase : public GlassDatabase {
      */
     void commit();
 
+    void commit_async();
+
+    void wait_for_commit();
+
     /** Cancel pending modifications to the database. */
     void cancel();
 
+    void set_flush_memory_limit(std::size_t limit);
+
+    std::size_t get_buffered_memory() const;
+
     Xapian::docid add_document(const Xapian::Document& document);
     Xapian::docid add_document_(Xapian::docid did,
 				const Xapian::Document& document);
@@ -419,6 +599,22 @@ class GlassWritableDatabase : public GlassDatabase {
      */
     GlassWritableDatabase(const string &dir, int flags, int block_size);
 
+    /** Replay the write-ahead log of a glass database for a reader.
+     *
+     *  @param dir directory holding glass tables
+     */
+    GlassWritableDatabase(const string& dir, GlassWALOverlay tag);
+
+    /// Were there any modifications in the write-ahead log to replay?
+    bool replayed_wal() const { return wal.exists(); }
+
+    /** Replay the commits added to the write-ahead log since it was read.
+     *
+     *  @return false if the log needs replaying from the start instead, in
+     *		which case nothing has been replayed.
+     */
+    bool replay_more_wal();
+
     ~GlassWritableDatabase();
 
     /** Virtual methods of Database::Internal. */
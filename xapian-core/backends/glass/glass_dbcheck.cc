@@ -31,6 +31,7 @@
 #include "glass_check.h"
 #include "glass_cursor.h"
 #include "glass_defs.h"
+#include "glass_postlist.h"
 #include "glass_table.h"
 #include "glass_version.h"
 #include "pack.h"
@@ -512,6 +513,20 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 		continue;
 	    }
 	    lastdid += did;
+	    string expanded;
+	    if (Glass::is_bitmap_chunk(pos, end)) {
+		// Check the bitmap by converting it to the standard format.
+		try {
+		    expanded = Glass::expand_bitmap_chunk(pos, end);
+		} catch (const Xapian::DatabaseCorruptError & e) {
+		    if (out)
+			*out << e.get_msg() << endl;
+		    ++errors;
+		    continue;
+		}
+		pos = expanded.data();
+		end = pos + expanded.size();
+	    }
 	    bool bad = false;
 	    while (true) {
 		Xapian::termcount wdf;
@@ -42,6 +42,12 @@
  */
 #define GLASS_MAX_DOCID Xapian::docid(0xffffffffffffffff)
 
+/** Approximate number of bytes a std::map node uses besides its value.
+ *
+ *  Used to estimate how much memory buffered changes are using.
+ */
+#define GLASS_MAP_NODE_OVERHEAD (4 * sizeof(void*))
+
 namespace Glass {
     enum table_type {
 	POSTLIST,
@@ -52,6 +58,16 @@ namespace Glass {
 	SYNONYM,
 	MAX_
     };
+
+    /// Optional features which a database can use.
+    enum feature {
+	/// Value chunks may be in the columnar format.
+	FEATURE_COLUMNAR_VALUES = 1,
+	/// Postlist chunks may be in the bitmap format.
+	FEATURE_BITMAP_POSTINGS = 2,
+	/// All the features we understand.
+	FEATURE_MASK_ = FEATURE_COLUMNAR_VALUES | FEATURE_BITMAP_POSTINGS
+    };
 }
 
 /// A block number in a glass Btree file.
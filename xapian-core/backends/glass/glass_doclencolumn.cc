@@ -0,0 +1,538 @@
+/** @file
+ * @brief Dense column of document lengths for a glass database
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "glass_doclencolumn.h"
+
+#include "backends/leafpostlist.h"
+#include "debuglog.h"
+#include "fd.h"
+#include "filetests.h"
+#include "glass_inverter.h"
+#include "io_utils.h"
+#include "omassert.h"
+#include "pack.h"
+#include "posixy_wrapper.h"
+#include "str.h"
+#include "stringutils.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/types.h>
+#include "safesysstat.h"
+#include "safefcntl.h"
+#include "safeunistd.h"
+
+#include "xapian/constants.h"
+#include "xapian/error.h"
+
+using namespace std;
+
+#define DOCLEN_COLUMN_MAGIC "xdoclen1"
+
+#define DOCLEN_LOG_MAGIC "xdoclog1"
+
+/// Size of the header at the start of the column file.
+static const size_t HEADER_SIZE = 40;
+
+/// Size of the header at the start of the log file.
+static const size_t LOG_HEADER_SIZE = 28;
+
+/** Smallest size at which the log is replaced by a new column file.
+ *
+ *  Above this, a new column file is written once the log would be more than
+ *  an eighth of the size of the column file, which bounds both the work
+ *  readers do to apply the log and the memory they use to hold it.
+ */
+static const uint64_t LOG_REWRITE_MIN = 64 * 1024;
+
+/// Widest entry we support, so an entry never spans more than 8 bytes.
+static const unsigned MAX_WIDTH = 56;
+
+/// Size of the packed data for @a count entries of @a width bits.
+static uint64_t
+packed_size(uint64_t count, unsigned width)
+{
+    return (count * width + 7) / 8 + 8;
+}
+
+void
+GlassDocLenColumn::throw_doc_not_found(Xapian::docid did)
+{
+    throw Xapian::DocNotFoundError("Document " + str(did) + " not found");
+}
+
+void
+GlassDocLenColumn::unload()
+{
+    if (mapping) {
+	io_munmap(mapping, mapping_size);
+	mapping = NULL;
+    }
+    string().swap(copy);
+    data = NULL;
+    overlay.clear();
+    log_end = 0;
+}
+
+bool
+GlassDocLenColumn::load_base(const char* uuid, glass_revision_number_t new_rev)
+{
+    LOGCALL(DB, bool, "GlassDocLenColumn::load_base", new_rev);
+    unload();
+    FD fd(posixy_open(path.c_str(), O_RDONLY | O_BINARY | O_CLOEXEC));
+    if (fd < 0) RETURN(false);
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) < 0 || statbuf.st_size < off_t(HEADER_SIZE))
+	RETURN(false);
+    size_t size = size_t(statbuf.st_size);
+    const char* p = io_mmap_read(fd, size);
+    if (p) {
+	mapping = p;
+	mapping_size = size;
+    } else {
+	copy.resize(size);
+	if (io_read(fd, &copy[0], size) != size) {
+	    unload();
+	    RETURN(false);
+	}
+	p = copy.data();
+    }
+
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    uint64_t n = do_unaligned_read<uint64_t>(u + 32);
+    unsigned w = unaligned_read4(u + 28);
+    glass_revision_number_t r = unaligned_read4(u + 24);
+    if (memcmp(p, DOCLEN_COLUMN_MAGIC, 8) != 0 ||
+	memcmp(p + 8, uuid, 16) != 0 ||
+	r > new_rev ||
+	w == 0 || w > MAX_WIDTH ||
+	n != Xapian::docid(n) ||
+	size - HEADER_SIZE != packed_size(n, w)) {
+	unload();
+	RETURN(false);
+    }
+    width = w;
+    base_count = count = Xapian::docid(n);
+    base_rev = rev = r;
+    data = u + HEADER_SIZE;
+    RETURN(true);
+}
+
+bool
+GlassDocLenColumn::read_log(const char* uuid, glass_revision_number_t new_rev)
+{
+    LOGCALL(DB, bool, "GlassDocLenColumn::read_log", new_rev);
+    FD fd(posixy_open(log_path.c_str(), O_RDONLY | O_BINARY | O_CLOEXEC));
+    if (fd < 0) RETURN(false);
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) < 0 || statbuf.st_size < off_t(LOG_HEADER_SIZE))
+	RETURN(false);
+    uint64_t size = uint64_t(statbuf.st_size);
+    if (size < log_end) RETURN(false);
+
+    // Check the log is still the one we've been reading (a new column file
+    // comes with a new log), then read the entries we haven't seen.
+    string buf(LOG_HEADER_SIZE, '\0');
+    io_read(fd, &buf[0], LOG_HEADER_SIZE, LOG_HEADER_SIZE);
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(&buf[0]);
+    if (memcmp(&buf[0], DOCLEN_LOG_MAGIC, 8) != 0 ||
+	memcmp(&buf[8], uuid, 16) != 0 ||
+	unaligned_read4(u + 24) != base_rev) {
+	RETURN(false);
+    }
+    uint64_t start = log_end ? log_end : LOG_HEADER_SIZE;
+    buf.resize(size - start);
+    if (io_pread(fd, &buf[0], buf.size(), off_t(start)) != buf.size())
+	RETURN(false);
+
+    const char* p = buf.data();
+    const char* end = p + buf.size();
+    while (rev != new_rev) {
+	// A record which is incomplete is still being written.
+	if (end - p < 4) RETURN(false);
+	auto u_len = reinterpret_cast<const unsigned char*>(p);
+	size_t len = unaligned_read4(u_len);
+	p += 4;
+	if (size_t(end - p) < len) RETURN(false);
+	const char* rec_end = p + len;
+	glass_revision_number_t r;
+	Xapian::docid last_docid;
+	if (!unpack_uint(&p, rec_end, &r) ||
+	    !unpack_uint(&p, rec_end, &last_docid) ||
+	    r <= rev || r > new_rev) {
+	    RETURN(false);
+	}
+	Xapian::docid did = 0;
+	while (p != rec_end) {
+	    Xapian::docid gap;
+	    uint64_t entry;
+	    if (!unpack_uint(&p, rec_end, &gap) ||
+		!unpack_uint(&p, rec_end, &entry) ||
+		entry > uint64_t(OVERLAY_DELETED)) {
+		RETURN(false);
+	    }
+	    did += gap + 1;
+	    if (entry == 0) {
+		overlay[did] = OVERLAY_DELETED;
+	    } else {
+		overlay[did] = Xapian::termcount(entry - 1);
+	    }
+	}
+	rev = r;
+	count = last_docid;
+	log_end = start + uint64_t(p - buf.data());
+    }
+    RETURN(true);
+}
+
+bool
+GlassDocLenColumn::load(const char* uuid, glass_revision_number_t new_rev)
+{
+    LOGCALL(DB, bool, "GlassDocLenColumn::load", new_rev);
+    if (data && rev == new_rev &&
+	memcmp(data - HEADER_SIZE + 8, uuid, 16) == 0) {
+	RETURN(true);
+    }
+    // If we have the column loaded, try just reading the new log entries.
+    if (data && rev < new_rev &&
+	memcmp(data - HEADER_SIZE + 8, uuid, 16) == 0 &&
+	read_log(uuid, new_rev)) {
+	RETURN(true);
+    }
+    if (!load_base(uuid, new_rev)) RETURN(false);
+    if (rev != new_rev && !read_log(uuid, new_rev)) {
+	unload();
+	RETURN(false);
+    }
+    RETURN(true);
+}
+
+void
+GlassDocLenColumn::open(const char* uuid, glass_revision_number_t new_rev,
+			bool writable, bool create)
+{
+    changes.clear();
+    if (path.empty()) {
+	unload();
+	return;
+    }
+    bool loaded = load(uuid, new_rev);
+    if (writable) {
+	maintain = create || loaded || file_exists(path);
+	// A log left after the column file was deleted is no use.
+	if (!maintain) (void)unlink(log_path.c_str());
+    }
+}
+
+void
+GlassDocLenColumn::merge_changes(const map<Xapian::docid,
+					   Xapian::termcount>& doclens)
+{
+    for (auto i : doclens) {
+	changes[i.first] = i.second;
+    }
+}
+
+namespace {
+
+/// Packs fixed width entries most significant bit first.
+class BitPacker {
+    string& out;
+
+    unsigned width;
+
+    /// Bits not yet appended to out (in the bottom acc_bits bits).
+    uint64_t acc = 0;
+
+    unsigned acc_bits = 0;
+
+  public:
+    BitPacker(string& out_, unsigned width_) : out(out_), width(width_) { }
+
+    /// Value with all bits set, used for an absent document.
+    uint64_t absent() const { return (uint64_t(1) << width) - 1; }
+
+    /// Add a document length, returning false if it's too wide.
+    bool add_length(uint64_t value) {
+	if (rare(value >= absent())) return false;
+	add(value);
+	return true;
+    }
+
+    void add(uint64_t value) {
+	AssertRel(value, <=, absent());
+	// acc_bits < 8 here, so the result fits in 64 bits.
+	acc = (acc << width) | value;
+	acc_bits += width;
+	while (acc_bits >= 8) {
+	    acc_bits -= 8;
+	    out += char(acc >> acc_bits);
+	}
+    }
+
+    void finish() {
+	if (acc_bits) out += char(acc << (8 - acc_bits));
+	out.append(8, '\0');
+    }
+};
+
+}
+
+bool
+GlassDocLenColumn::write_column(const char* uuid,
+				glass_revision_number_t new_rev,
+				Xapian::docid last_docid,
+				Xapian::termcount doclen_ubound,
+				LeafPostList* pl, int flags)
+{
+    LOGCALL(DB, bool, "GlassDocLenColumn::write_column", new_rev | last_docid | doclen_ubound | pl | flags);
+    // Use the smallest width which can represent every length as well as
+    // the all bits set value for an absent document.
+    const uint64_t ubound = doclen_ubound;
+    unsigned new_width = 1;
+    while (new_width < 64 && (ubound >> new_width) != 0) ++new_width;
+    if (ubound == (uint64_t(1) << new_width) - 1) ++new_width;
+    if (new_width > MAX_WIDTH) {
+	// Readers will see the column is out of date and not use it.
+	RETURN(false);
+    }
+
+    string buf(DOCLEN_COLUMN_MAGIC, 8);
+    buf.append(uuid, 16);
+    buf.resize(HEADER_SIZE);
+    unsigned char* h = reinterpret_cast<unsigned char*>(&buf[0]);
+    unaligned_write4(h + 24, new_rev);
+    unaligned_write4(h + 28, new_width);
+    do_unaligned_write<uint64_t, uint64_t>(h + 32, last_docid);
+    buf.reserve(HEADER_SIZE + packed_size(last_docid, new_width));
+
+    BitPacker packer(buf, new_width);
+    bool ok = true;
+    Xapian::docid did = 1;
+    if (pl) {
+	for (pl->next(); ok && !pl->at_end(); pl->next()) {
+	    Xapian::docid pl_did = pl->get_docid();
+	    while (did < pl_did) {
+		packer.add(packer.absent());
+		++did;
+	    }
+	    ok = packer.add_length(pl->get_wdf());
+	    ++did;
+	}
+    } else {
+	auto change = changes.begin();
+	auto o = overlay.begin();
+	for ( ; ok && did <= last_docid; ++did) {
+	    Xapian::termcount doclen;
+	    bool present;
+	    while (o != overlay.end() && o->first < did) ++o;
+	    if (change != changes.end() && change->first == did) {
+		doclen = change->second;
+		present = (doclen != DELETED_POSTING);
+		++change;
+	    } else if (o != overlay.end() && o->first == did) {
+		doclen = o->second;
+		present = (doclen != OVERLAY_DELETED);
+	    } else if (did <= base_count && read_entry(did) != absent()) {
+		doclen = Xapian::termcount(read_entry(did));
+		present = true;
+	    } else {
+		present = false;
+	    }
+	    if (present) {
+		ok = packer.add_length(doclen);
+	    } else {
+		packer.add(packer.absent());
+	    }
+	}
+    }
+    while (did <= last_docid) {
+	packer.add(packer.absent());
+	++did;
+    }
+    packer.finish();
+    if (!ok) {
+	// doclen_ubound was wrong, so don't write a column.
+	RETURN(false);
+    }
+    AssertEq(buf.size(), HEADER_SIZE + packed_size(last_docid, new_width));
+
+    string tmpfile = path + ".tmp";
+    try {
+	FD fd(posixy_open(tmpfile.c_str(),
+			  O_WRONLY | O_CREAT | O_TRUNC | O_BINARY | O_CLOEXEC,
+			  0666));
+	if (fd < 0) {
+	    throw Xapian::DatabaseError("Couldn't create " + tmpfile, errno);
+	}
+	io_write(fd, buf.data(), buf.size());
+	if (!(flags & Xapian::DB_NO_SYNC) && !io_sync(fd)) {
+	    throw Xapian::DatabaseError("Couldn't sync " + tmpfile, errno);
+	}
+	if (fd.close() < 0) {
+	    throw Xapian::DatabaseError("Couldn't close " + tmpfile, errno);
+	}
+	if (!io_tmp_rename(tmpfile, path)) {
+	    throw Xapian::DatabaseError("Couldn't update " + path, errno);
+	}
+    } catch (const Xapian::DatabaseError&) {
+	(void)unlink(tmpfile.c_str());
+	RETURN(false);
+    }
+
+    // The log was for the old column file.  If we fail to remove it,
+    // readers will see it doesn't match the new column and ignore it.
+    (void)unlink(log_path.c_str());
+    unload();
+    RETURN(load_base(uuid, new_rev));
+}
+
+string
+GlassDocLenColumn::make_log_record(glass_revision_number_t new_rev,
+				   Xapian::docid last_docid) const
+{
+    string rec(4, '\0');
+    pack_uint(rec, new_rev);
+    pack_uint(rec, last_docid);
+    Xapian::docid prev_did = 0;
+    for (auto i : changes) {
+	pack_uint(rec, i.first - prev_did - 1);
+	if (i.second == DELETED_POSTING) {
+	    pack_uint(rec, 0u);
+	} else {
+	    pack_uint(rec, uint64_t(i.second) + 1);
+	}
+	prev_did = i.first;
+    }
+    unaligned_write4(reinterpret_cast<unsigned char*>(&rec[0]),
+		     uint32_t(rec.size() - 4));
+    return rec;
+}
+
+bool
+GlassDocLenColumn::append_log(const char* uuid,
+			      glass_revision_number_t new_rev,
+			      Xapian::docid last_docid,
+			      const string& rec, int flags)
+{
+    LOGCALL(DB, bool, "GlassDocLenColumn::append_log", new_rev | last_docid | rec.size() | flags);
+    try {
+	if (log_end == 0) {
+	    // Start a new log for the current column file.
+	    string buf(DOCLEN_LOG_MAGIC, 8);
+	    buf.append(uuid, 16);
+	    buf.resize(LOG_HEADER_SIZE);
+	    unaligned_write4(reinterpret_cast<unsigned char*>(&buf[24]),
+			     base_rev);
+	    buf += rec;
+	    string tmpfile = log_path + ".tmp";
+	    FD fd(posixy_open(tmpfile.c_str(),
+			      O_WRONLY | O_CREAT | O_TRUNC | O_BINARY |
+			      O_CLOEXEC,
+			      0666));
+	    if (fd < 0) {
+		throw Xapian::DatabaseError("Couldn't create " + tmpfile,
+					    errno);
+	    }
+	    try {
+		io_write(fd, buf.data(), buf.size());
+		if (!(flags & Xapian::DB_NO_SYNC) && !io_sync(fd)) {
+		    throw Xapian::DatabaseError("Couldn't sync " + tmpfile,
+						errno);
+		}
+		if (fd.close() < 0) {
+		    throw Xapian::DatabaseError("Couldn't close " + tmpfile,
+						errno);
+		}
+		if (!io_tmp_rename(tmpfile, log_path)) {
+		    throw Xapian::DatabaseError("Couldn't update " + log_path,
+						errno);
+		}
+	    } catch (...) {
+		(void)unlink(tmpfile.c_str());
+		throw;
+	    }
+	    log_end = LOG_HEADER_SIZE;
+	} else {
+	    FD fd(posixy_open(log_path.c_str(),
+			      O_WRONLY | O_BINARY | O_CLOEXEC));
+	    if (fd < 0) {
+		throw Xapian::DatabaseError("Couldn't open " + log_path,
+					    errno);
+	    }
+	    io_pwrite(fd, rec.data(), rec.size(), off_t(log_end));
+	    if (!(flags & Xapian::DB_NO_SYNC) && !io_sync(fd)) {
+		throw Xapian::DatabaseError("Couldn't sync " + log_path,
+					    errno);
+	    }
+	    if (fd.close() < 0) {
+		throw Xapian::DatabaseError("Couldn't close " + log_path,
+					    errno);
+	    }
+	}
+    } catch (const Xapian::DatabaseError&) {
+	RETURN(false);
+    }
+
+    static_assert(OVERLAY_DELETED == DELETED_POSTING,
+		  "Deleted documents are marked the same way in overlay");
+    for (auto i : changes) {
+	overlay[i.first] = i.second;
+    }
+    log_end += rec.size();
+    rev = new_rev;
+    count = last_docid;
+    RETURN(true);
+}
+
+void
+GlassDocLenColumn::commit(const char* uuid, glass_revision_number_t new_rev,
+			  Xapian::docid last_docid,
+			  Xapian::termcount doclen_ubound,
+			  LeafPostList* pl, int flags)
+{
+    LOGCALL_VOID(DB, "GlassDocLenColumn::commit", new_rev | last_docid | doclen_ubound | pl | flags);
+    if (path.empty()) return;
+    AssertEq(pl == NULL, can_update());
+
+    bool ok;
+    if (pl) {
+	ok = write_column(uuid, new_rev, last_docid, doclen_ubound, pl, flags);
+    } else {
+	// Write a new column instead once the log would get large.
+	string rec = make_log_record(new_rev, last_docid);
+	uint64_t column_size = HEADER_SIZE + packed_size(base_count, width);
+	uint64_t limit = max(LOG_REWRITE_MIN, column_size / 8);
+	uint64_t log_size = max(log_end, uint64_t(LOG_HEADER_SIZE));
+	if (log_size + rec.size() > limit || rec.size() - 4 > 0xffffffff) {
+	    ok = write_column(uuid, new_rev, last_docid, doclen_ubound, NULL,
+			      flags);
+	} else {
+	    ok = append_log(uuid, new_rev, last_docid, rec, flags);
+	}
+    }
+    if (!ok) {
+	// Readers will see the column is out of date and not use it.
+	unload();
+    }
+    changes.clear();
+}
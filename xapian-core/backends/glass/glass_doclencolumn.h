@@ -0,0 +1,283 @@
+/** @file
+ * @brief Dense column of document lengths for a glass database
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_GLASS_DOCLENCOLUMN_H
+#define XAPIAN_INCLUDED_GLASS_DOCLENCOLUMN_H
+
+#include "glass_defs.h"
+#include "wordaccess.h"
+#include "xapian/types.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+class LeafPostList;
+
+/** Dense column of document lengths.
+ *
+ *  The document lengths are also stored in the postlist table (as the
+ *  postlist for the empty term), but looking one up there means finding and
+ *  decoding a chunk.  The column is a file "doclens" in the database
+ *  directory holding the length of every document bit-packed into an array
+ *  indexed by docid, so a lookup is a single read.
+ *
+ *  The file records the UUID and revision of the database it matches.  Each
+ *  commit appends just the changed document lengths to a log file
+ *  "doclens.log" beside it, and readers apply the log entries up to their
+ *  revision when they open the database (and the new entries when they
+ *  reopen it).  Once the log is large compared to the column, the next
+ *  commit writes a new column file instead (renaming it into place, so
+ *  readers with the old file mapped are unaffected) and removes the log.
+ *  If the column and log don't match the revision a reader has open (e.g.
+ *  they are missing, or a commit happened between opening the version file
+ *  and the column) the postlist table is used instead.
+ *
+ *  The column file starts with a 40 byte header:
+ *
+ *	8 byte magic string "xdoclen1"
+ *	16 byte database UUID
+ *	4 byte revision
+ *	4 byte width in bits of each entry
+ *	8 byte number of entries (the last docid at that revision)
+ *
+ *  followed by the entries packed most significant bit first, and then 8
+ *  zero bytes so that every entry can be read with one unaligned 8 byte
+ *  read.  An entry with all bits set means there is no such document.
+ *
+ *  The log file starts with a 28 byte header:
+ *
+ *	8 byte magic string "xdoclog1"
+ *	16 byte database UUID
+ *	4 byte revision of the column file the log applies to
+ *
+ *  followed by a record for each later revision, in order: a 4 byte length
+ *  of the rest of the record, then pack_uint() encoded the revision, the
+ *  last docid, and for each changed document the gap since the previous
+ *  changed docid and its length plus one (0 for a deleted document).
+ */
+class GlassDocLenColumn {
+    /// Path of the column file (empty for a single-file database).
+    std::string path;
+
+    /// Path of the log file (empty for a single-file database).
+    std::string log_path;
+
+    /// The file's memory mapping (NULL if not mapped).
+    const char* mapping = NULL;
+
+    /// Size of the mapping.
+    size_t mapping_size = 0;
+
+    /// Copy of the file used if it can't be mapped.
+    std::string copy;
+
+    /// The packed entries (NULL if the column isn't loaded).
+    const unsigned char* data = NULL;
+
+    /// Width in bits of each entry.
+    unsigned width = 0;
+
+    /// Number of entries in the column file.
+    Xapian::docid base_count = 0;
+
+    /// The revision the column file is for.
+    glass_revision_number_t base_rev = 0;
+
+    /// The revision the loaded column and log entries are for.
+    glass_revision_number_t rev = 0;
+
+    /// The last docid at revision @a rev.
+    Xapian::docid count = 0;
+
+    /** Document lengths from the log, which override the column file.
+     *
+     *  A deleted document has the length OVERLAY_DELETED.
+     */
+    std::map<Xapian::docid, Xapian::termcount> overlay;
+
+    /// Marks a deleted document in @a overlay (the same as DELETED_POSTING).
+    static constexpr Xapian::termcount OVERLAY_DELETED =
+	Xapian::termcount(-1);
+
+    /// Offset of the end of the log entries read (0 if we have no log).
+    std::uint64_t log_end = 0;
+
+    /// Should we write a new column at each commit?
+    bool maintain = false;
+
+    /** Document length changes made since the column was loaded.
+     *
+     *  The column can't be used for lookups while there are any.
+     */
+    std::map<Xapian::docid, Xapian::termcount> changes;
+
+    /// Read the raw entry for @a did (which must be <= base_count).
+    std::uint64_t read_entry(Xapian::docid did) const {
+	std::uint64_t bit = std::uint64_t(did - 1) * width;
+	auto v = do_unaligned_read<std::uint64_t>(data + (bit >> 3));
+	return (v << (bit & 7)) >> (64 - width);
+    }
+
+    /// Return the value of an entry meaning there's no such document.
+    std::uint64_t absent() const {
+	return (std::uint64_t(1) << width) - 1;
+    }
+
+    /// Release the current file.
+    void unload();
+
+    /** Try to load the column file.
+     *
+     *  @return true if it exists and matches @a uuid, and is for
+     *		@a new_rev or an earlier revision.
+     */
+    bool load_base(const char* uuid, glass_revision_number_t new_rev);
+
+    /** Apply log entries after those already read up to @a new_rev.
+     *
+     *  @return true if that brings us to @a new_rev.
+     */
+    bool read_log(const char* uuid, glass_revision_number_t new_rev);
+
+    /** Try to load the column and log for a revision.
+     *
+     *  If the column is already loaded, just the new log entries are read
+     *  if possible.
+     *
+     *  @return true if they match @a uuid and @a new_rev.
+     */
+    bool load(const char* uuid, glass_revision_number_t new_rev);
+
+    /// Write a new column file for revision @a new_rev and remove the log.
+    bool write_column(const char* uuid, glass_revision_number_t new_rev,
+		      Xapian::docid last_docid,
+		      Xapian::termcount doclen_ubound,
+		      LeafPostList* pl, int flags);
+
+    /// Encode the changes for revision @a new_rev as a log record.
+    std::string make_log_record(glass_revision_number_t new_rev,
+				Xapian::docid last_docid) const;
+
+    /// Append log record @a rec for revision @a new_rev to the log.
+    bool append_log(const char* uuid, glass_revision_number_t new_rev,
+		    Xapian::docid last_docid, const std::string& rec,
+		    int flags);
+
+  public:
+    explicit GlassDocLenColumn(const std::string& db_dir)
+	: path(db_dir.empty() ? db_dir : db_dir + "/doclens"),
+	  log_path(db_dir.empty() ? db_dir : path + ".log") { }
+
+    ~GlassDocLenColumn() { unload(); }
+
+    /** Open the column for a revision of the database.
+     *
+     *  @param uuid		The database's UUID (16 bytes).
+     *  @param new_rev	The revision of the database which is open.
+     *  @param writable	Are we opening for writing?  If so, we maintain
+     *				the column if it already exists or @a create
+     *				is true.
+     *  @param create	Start maintaining the column if it doesn't exist.
+     */
+    void open(const char* uuid, glass_revision_number_t new_rev,
+	      bool writable, bool create);
+
+    /// Close the column.
+    void close() {
+	unload();
+	changes.clear();
+    }
+
+    /** Look up the length of a document.
+     *
+     *  @param did		The docid to look up.
+     *  @param[out] doclen	Set to the document length.
+     *
+     *  @return false if the column can't be used, in which case the caller
+     *		should look in the postlist table.
+     *
+     *  @exception Xapian::DocNotFoundError if the document doesn't exist.
+     */
+    bool get_doclength(Xapian::docid did, Xapian::termcount& doclen) const {
+	if (!data || !changes.empty()) return false;
+	if (rare(did > count)) throw_doc_not_found(did);
+	if (!overlay.empty()) {
+	    auto i = overlay.find(did);
+	    if (i != overlay.end()) {
+		if (i->second == OVERLAY_DELETED) throw_doc_not_found(did);
+		doclen = i->second;
+		return true;
+	    }
+	}
+	std::uint64_t entry;
+	if (did > base_count || (entry = read_entry(did)) == absent())
+	    throw_doc_not_found(did);
+	doclen = Xapian::termcount(entry);
+	return true;
+    }
+
+    /// Throw DocNotFoundError for @a did.
+    [[noreturn]]
+    static void throw_doc_not_found(Xapian::docid did);
+
+    /// Note document length changes which have been merged into the table.
+    void merge_changes(const std::map<Xapian::docid,
+				      Xapian::termcount>& doclens);
+
+    /// Discard any uncommitted changes.
+    void cancel() { changes.clear(); }
+
+    /// Is the column updated at each commit?
+    bool is_maintained() const { return maintain; }
+
+    /** Can the column be written from the loaded column and the changes?
+     *
+     *  If not, commit() needs to be passed a postlist to read all the
+     *  document lengths from.
+     */
+    bool can_update() const { return data != NULL; }
+
+    /** Update the column for a newly committed revision.
+     *
+     *  This appends the changes to the log, or writes a new column file if
+     *  @a pl is passed or the log has got too large.  It does this even if
+     *  the column isn't being maintained (which is how compaction creates
+     *  it), but does nothing for a single-file database.
+     *
+     *  Errors writing the column don't cause the commit to fail - the
+     *  column is just left out of date so readers won't use it.
+     *
+     *  @param uuid		The database's UUID (16 bytes).
+     *  @param new_rev	The new revision.
+     *  @param last_docid	The last docid used at revision @a new_rev.
+     *  @param doclen_ubound	An upper bound on the document lengths.
+     *  @param pl		If not NULL, a postlist over all documents at
+     *				revision @a new_rev to read the lengths from;
+     *				otherwise the loaded column and the changes
+     *				are used (see can_update()).
+     *  @param flags		Xapian::DB_* flags (Xapian::DB_NO_SYNC is
+     *				respected).
+     */
+    void commit(const char* uuid, glass_revision_number_t new_rev,
+		Xapian::docid last_docid, Xapian::termcount doclen_ubound,
+		LeafPostList* pl, int flags);
+};
+
+#endif // XAPIAN_INCLUDED_GLASS_DOCLENCOLUMN_H
@@ -78,7 +78,7 @@ uint4
 GlassFreeList::get_block(const GlassTable *B, uint4 block_size,
 			 uint4 * blk_to_free)
 {
-    if (fl == fl_end) {
+    if (fl == fl_end || !reuse_blocks) {
 	return first_unused_block++;
     }
 
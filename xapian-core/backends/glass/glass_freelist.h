@@ -81,6 +81,12 @@ class GlassFreeList {
 
     bool flw_appending;
 
+    /** Reuse blocks from the freelist?
+     *
+     *  If false, new blocks are always allocated from the end of the file.
+     */
+    bool reuse_blocks;
+
   private:
     /// Current freelist block.
     uint8_t * p;
@@ -93,6 +99,7 @@ class GlassFreeList {
 	revision = 0;
 	first_unused_block = 0;
 	flw_appending = false;
+	reuse_blocks = true;
 	p = pw = NULL;
     }
 
@@ -116,6 +123,15 @@ class GlassFreeList {
     uint4 get_revision() const { return revision; }
     void set_revision(uint4 revision_) { revision = revision_; }
 
+    /** Set whether to reuse blocks from the freelist.
+     *
+     *  Until the previous revision has been synced to disk, the revision
+     *  before it is still the one which will be opened after a crash, and
+     *  the freelist contains blocks it uses.  Not reusing blocks avoids
+     *  overwriting them.
+     */
+    void set_reuse_blocks(bool reuse) { reuse_blocks = reuse; }
+
     uint4 get_first_unused_block() const { return first_unused_block; }
 
     // Used when compacting to a single file.
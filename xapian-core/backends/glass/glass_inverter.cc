@@ -52,6 +52,8 @@ Inverter::store_positions(const GlassPositionListTable & position_table,
 	    auto j = m.find(did);
 	    if (j != m.end()) {
 		// Update existing entry.
+		pos_memory += s.size();
+		pos_memory -= j->second.size();
 		swap(j->second, s);
 		return;
 	    }
@@ -106,8 +108,18 @@ Inverter::set_positionlist(Xapian::docid did,
 			   const string & s)
 {
     has_positions_cache = s.empty() ? -1 : 1;
-    pos_changes.insert(make_pair(term, map<Xapian::docid, string>()))
-	.first->second[did] = s;
+    auto i = pos_changes.insert(make_pair(term, map<Xapian::docid, string>()));
+    if (i.second) {
+	pos_memory += GLASS_MAP_NODE_OVERHEAD + sizeof(*i.first) + term.size();
+    }
+    auto j = i.first->second.insert(make_pair(did, string()));
+    if (j.second) {
+	pos_memory += GLASS_MAP_NODE_OVERHEAD + sizeof(*j.first);
+    } else {
+	pos_memory -= j.first->second.size();
+    }
+    j.first->second = s;
+    pos_memory += s.size();
 }
 
 void
@@ -160,6 +172,7 @@ void
 Inverter::flush_doclengths(GlassPostListTable & table)
 {
     table.merge_doclen_changes(doclen_changes);
+    postlist_memory -= doclen_changes.size() * DOCID_CHANGE_SIZE;
     doclen_changes.clear();
 }
 
@@ -172,6 +185,7 @@ Inverter::flush_post_list(GlassPostListTable & table, const string & term)
 
     // Flush buffered changes for just this term's postlist.
     table.merge_changes(term, i->second);
+    postlist_memory -= postlist_changes_size(term, i->second);
     postlist_changes.erase(i);
 }
 
@@ -181,6 +195,7 @@ Inverter::flush_all_post_lists(GlassPostListTable & table)
     map<string, PostingChanges>::const_iterator i;
     for (i = postlist_changes.begin(); i != postlist_changes.end(); ++i) {
 	table.merge_changes(i->first, i->second);
+	postlist_memory -= postlist_changes_size(i->first, i->second);
     }
     postlist_changes.clear();
 }
@@ -209,6 +224,7 @@ Inverter::flush_post_lists(GlassPostListTable & table, const string & pfx)
 
     for (i = begin; i != end; ++i) {
 	table.merge_changes(i->first, i->second);
+	postlist_memory -= postlist_changes_size(i->first, i->second);
     }
 
     // Erase all the entries in one go, as that's:
@@ -239,5 +255,6 @@ Inverter::flush_pos_lists(GlassPositionListTable & table)
 	}
     }
     pos_changes.clear();
+    pos_memory = 0;
     has_positions_cache = -1;
 }
@@ -24,7 +24,9 @@
 #include "xapian/types.h"
 
 #include "api/smallvector.h"
+#include "glass_defs.h"
 
+#include <cstddef>
 #include <map>
 #include <string>
 #include <vector>
@@ -111,11 +113,38 @@ class Inverter {
 
 	/// Get the collection frequency delta.
 	Xapian::termcount_diff get_cfdelta() const { return cf_delta; }
+
+	/// Get the number of documents with a changed posting.
+	std::size_t get_change_count() const { return pl_changes.size(); }
     };
 
+    /// Approximate memory used by each buffered posting or doclen change.
+    static constexpr std::size_t DOCID_CHANGE_SIZE =
+	GLASS_MAP_NODE_OVERHEAD +
+	sizeof(std::pair<const Xapian::docid, Xapian::termcount>);
+
     /// Buffered changes to postlists.
     std::map<std::string, PostingChanges> postlist_changes;
 
+    /** Approximate memory used by the postlist and doclen changes.
+     *
+     *  This is kept up to date as changes are buffered and flushed, as
+     *  calculating it would mean iterating all the changes.
+     */
+    std::size_t postlist_memory = 0;
+
+    /// Approximate memory used by the positional data changes.
+    std::size_t pos_memory = 0;
+
+    /// Approximate memory used by the changes to @a term's postlist.
+    static std::size_t postlist_changes_size(const std::string& term,
+					     const PostingChanges& changes) {
+	return GLASS_MAP_NODE_OVERHEAD +
+	       sizeof(std::pair<const std::string, PostingChanges>) +
+	       term.size() +
+	       changes.get_change_count() * DOCID_CHANGE_SIZE;
+    }
+
     /** Cached answer to Inverter::has_positions().
      *
      *  -1: needs calculating
@@ -147,10 +176,14 @@ class Inverter {
 	std::map<std::string, PostingChanges>::iterator i;
 	i = postlist_changes.find(term);
 	if (i == postlist_changes.end()) {
-	    postlist_changes.insert(
-		std::make_pair(term, PostingChanges(did, wdf)));
+	    i = postlist_changes.insert(
+		std::make_pair(term, PostingChanges(did, wdf))).first;
+	    postlist_memory += postlist_changes_size(term, i->second);
 	} else {
+	    std::size_t old_count = i->second.get_change_count();
 	    i->second.add_posting(did, wdf);
+	    postlist_memory += (i->second.get_change_count() - old_count) *
+			       DOCID_CHANGE_SIZE;
 	}
     }
 
@@ -159,10 +192,14 @@ class Inverter {
 	std::map<std::string, PostingChanges>::iterator i;
 	i = postlist_changes.find(term);
 	if (i == postlist_changes.end()) {
-	    postlist_changes.insert(
-		std::make_pair(term, PostingChanges(did, wdf, false)));
+	    i = postlist_changes.insert(
+		std::make_pair(term, PostingChanges(did, wdf, false))).first;
+	    postlist_memory += postlist_changes_size(term, i->second);
 	} else {
+	    std::size_t old_count = i->second.get_change_count();
 	    i->second.remove_posting(did, wdf);
+	    postlist_memory += (i->second.get_change_count() - old_count) *
+			       DOCID_CHANGE_SIZE;
 	}
     }
 
@@ -172,10 +209,14 @@ class Inverter {
 	std::map<std::string, PostingChanges>::iterator i;
 	i = postlist_changes.find(term);
 	if (i == postlist_changes.end()) {
-	    postlist_changes.insert(
-		std::make_pair(term, PostingChanges(did, old_wdf, new_wdf)));
+	    i = postlist_changes.insert(
+		std::make_pair(term, PostingChanges(did, old_wdf, new_wdf))).first;
+	    postlist_memory += postlist_changes_size(term, i->second);
 	} else {
+	    std::size_t old_count = i->second.get_change_count();
 	    i->second.update_posting(did, old_wdf, new_wdf);
+	    postlist_memory += (i->second.get_change_count() - old_count) *
+			       DOCID_CHANGE_SIZE;
 	}
     }
 
@@ -199,18 +240,35 @@ class Inverter {
 	postlist_changes.clear();
 	pos_changes.clear();
 	has_positions_cache = -1;
+	postlist_memory = 0;
+	pos_memory = 0;
+    }
+
+    /** Return the approximate number of bytes used by buffered changes.
+     *
+     *  This counts the changes to postlists, document lengths and
+     *  positional data.
+     */
+    std::size_t get_memory_used() const {
+	return postlist_memory + pos_memory;
     }
 
     void set_doclength(Xapian::docid did, Xapian::termcount doclen, bool add) {
 	if (add) {
 	    Assert(doclen_changes.find(did) == doclen_changes.end() || doclen_changes[did] == DELETED_POSTING);
 	}
+	std::size_t old_count = doclen_changes.size();
 	doclen_changes[did] = doclen;
+	postlist_memory += (doclen_changes.size() - old_count) *
+			   DOCID_CHANGE_SIZE;
     }
 
     void delete_doclength(Xapian::docid did) {
 	Assert(doclen_changes.find(did) == doclen_changes.end() || doclen_changes[did] != DELETED_POSTING);
+	std::size_t old_count = doclen_changes.size();
 	doclen_changes[did] = DELETED_POSTING;
+	postlist_memory += (doclen_changes.size() - old_count) *
+			   DOCID_CHANGE_SIZE;
     }
 
     bool get_doclength(Xapian::docid did, Xapian::termcount & doclen) const {
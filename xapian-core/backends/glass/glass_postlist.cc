@@ -27,6 +27,7 @@
 
 #include "glass_cursor.h"
 #include "glass_database.h"
+#include "backends/postingbitmap.h"
 #include "debuglog.h"
 #include "pack.h"
 #include "str.h"
@@ -35,6 +36,13 @@
 using Xapian::Internal::intrusive_ptr;
 using namespace std;
 
+/** How many leaf blocks to readahead when iterating a postlist.
+ *
+ *  This is the maximum number of leaf blocks beyond the current one we try
+ *  to have readahead outstanding for.
+ */
+const unsigned POSTLIST_READAHEAD_BLOCKS = 4;
+
 // Static functions
 
 /// Report an error when reading the posting list.
@@ -125,6 +133,76 @@ read_wdf(const char ** posptr, const char * end, Xapian::termcount * wdf_ptr)
     if (!unpack_uint(posptr, end, wdf_ptr)) report_read_error(*posptr);
 }
 
+string
+Glass::expand_bitmap_chunk(const char * p, const char * end)
+{
+    Assert(is_bitmap_chunk(p, end));
+    p += 2;
+    Xapian::termcount wdf;
+    read_wdf(&p, end, &wdf);
+    auto chunk_bitmap = reinterpret_cast<const unsigned char *>(p);
+    size_t nbits = size_t(end - p) * 8;
+    size_t i = posting_bitmap_find(chunk_bitmap, nbits, 0);
+    if (i != 0) {
+	throw Xapian::DatabaseCorruptError("Postlist bitmap doesn't start "
+					   "with the first docid in the chunk");
+    }
+    string data;
+    pack_uint(data, wdf);
+    while (true) {
+	size_t j = posting_bitmap_find(chunk_bitmap, nbits, i + 1);
+	if (j == nbits) break;
+	pack_uint(data, Xapian::docid(j - i - 1));
+	pack_uint(data, wdf);
+	i = j;
+    }
+    return data;
+}
+
+bool
+Glass::make_bitmap_chunk(string & data, Xapian::docid increase_to_last)
+{
+    const char * p = data.data();
+    const char * end = p + data.size();
+    if (is_bitmap_chunk(p, end)) return true;
+
+    size_t nbits = size_t(increase_to_last) + 1;
+    // Each entry takes at least two bytes in the standard format, so this
+    // means the bitmap is used for chunks where more than about 1 in 16
+    // docids are present.
+    if (posting_bitmap_size(nbits) + 3 >= data.size()) return false;
+
+    Xapian::termcount wdf;
+    read_wdf(&p, end, &wdf);
+    string result("\x80\0", 2);
+    pack_uint(result, wdf);
+    size_t header_size = result.size();
+    result.resize(header_size + posting_bitmap_size(nbits));
+    auto chunk_bitmap = reinterpret_cast<unsigned char *>(&result[header_size]);
+    posting_bitmap_set(chunk_bitmap, 0);
+    size_t i = 0;
+    while (p != end) {
+	Xapian::docid did_increase;
+	if (!unpack_uint(&p, end, &did_increase)) report_read_error(p);
+	i += size_t(did_increase) + 1;
+	Xapian::termcount entry_wdf;
+	read_wdf(&p, end, &entry_wdf);
+	if (entry_wdf != wdf) return false;
+	if (i >= nbits) {
+	    throw Xapian::DatabaseCorruptError("Postlist chunk entry after "
+					       "the last docid in the chunk");
+	}
+	posting_bitmap_set(chunk_bitmap, i);
+    }
+    if (i != nbits - 1) {
+	throw Xapian::DatabaseCorruptError("Postlist chunk doesn't end with "
+					   "the last docid in the chunk");
+    }
+    if (result.size() >= data.size()) return false;
+    swap(data, result);
+    return true;
+}
+
 /// Read the start of a chunk.
 static Xapian::docid
 read_start_of_chunk(const char ** posptr,
@@ -185,6 +263,7 @@ GlassPostListTable::get_freqs(const string & term,
 		(void)read_start_of_chunk(&p, e, did + 1, &is_last);
 		(void)is_last;
 		Xapian::termcount first_wdf;
+		if (Glass::is_bitmap_chunk(p, e)) p += 2;
 		if (!unpack_uint(&p, e, &first_wdf))
 		    report_read_error(p);
 		*wdfub_ptr = max(cf - first_wdf, first_wdf);
@@ -299,6 +378,12 @@ class Glass::PostlistChunkReader {
     PostlistChunkReader(Xapian::docid first_did, const string & data_)
 	: data(data_), pos(data.data()), end(pos + data.length()), at_end(data.empty()), did(first_did)
     {
+	if (Glass::is_bitmap_chunk(pos, end)) {
+	    // Changes are always written in the standard format.
+	    data = Glass::expand_bitmap_chunk(pos, end);
+	    pos = data.data();
+	    end = pos + data.length();
+	}
 	if (!at_end) read_wdf(&pos, end, &wdf);
     }
 
@@ -691,6 +776,10 @@ void GlassPostList::read_number_of_entries(const char ** posptr,
  *  4)  increment in docid to next item, followed by wdf for the item.
  *  5)  (4) repeatedly.
  *
+ *  If every item in a chunk has the same wdf, (3) to (5) may instead be
+ *  stored as a bitmap (see Glass::is_bitmap_chunk()).  Compaction does this
+ *  for chunks where it's smaller, which is the case for dense posting lists.
+ *
  *  The first chunk begins with the number of entries, the collection
  *  frequency, then the docid of the first document, then has the header of a
  *  standard chunk.
@@ -708,6 +797,18 @@ GlassPostList::GlassPostList(intrusive_ptr<const GlassDatabase> this_db_,
     init();
 }
 
+GlassPostList::GlassPostList(const GlassPostListTable& table,
+			     const string & term_)
+	: LeafPostList(term_),
+	  this_db(NULL),
+	  have_started(false),
+	  is_at_end(false),
+	  cursor(table.cursor_get())
+{
+    LOGCALL_CTOR(DB, "GlassPostList", &table | term_);
+    init();
+}
+
 GlassPostList::GlassPostList(intrusive_ptr<const GlassDatabase> this_db_,
 			     const string & term_,
 			     GlassCursor * cursor_)
@@ -746,19 +847,41 @@ GlassPostList::init()
     first_did_in_chunk = did;
     last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
 					    &is_last_chunk);
-    read_wdf(&pos, end, &wdf);
+    read_first_entry();
     // This works even if there's only one entry (when wdf == collfreq)
     // or when collfreq is 0 (=> wdf is 0 too).
     wdf_upper_bound = max(collfreq - wdf, wdf);
+    if (!is_last_chunk) readahead();
     LOGLINE(DB, "Initial docid " << did);
 }
 
 GlassPostList::~GlassPostList()
 {
     LOGCALL_DTOR(DB, "GlassPostList");
+    if (cursor->readahead_issued) {
+	LOGLINE(DB, "Readahead for postlist of " << term << ": " <<
+		    cursor->readahead_issued << " blocks, " <<
+		    cursor->readahead_used << " used");
+    }
     delete positionlist;
 }
 
+void
+GlassPostList::readahead()
+{
+    LOGCALL_VOID(DB, "GlassPostList::readahead", NO_ARGS);
+    if (chunk_key_prefix.empty()) {
+	if (term.empty()) {
+	    // Special case for doclen lists.
+	    chunk_key_prefix.assign("\x00\xe0", 2);
+	} else {
+	    pack_string_preserving_sort(chunk_key_prefix, term);
+	}
+    }
+    (void)cursor->readahead_leaves(chunk_key_prefix,
+				   POSTLIST_READAHEAD_BLOCKS);
+}
+
 LeafPostList *
 GlassPostList::open_nearby_postlist(const std::string & term_,
 				    bool need_read_pos) const
@@ -772,10 +895,41 @@ GlassPostList::open_nearby_postlist(const std::string & term_,
     RETURN(new GlassPostList(this_db, term_, cursor->clone()));
 }
 
+void
+GlassPostList::read_first_entry()
+{
+    if (!Glass::is_bitmap_chunk(pos, end)) {
+	bitmap = NULL;
+	read_wdf(&pos, end, &wdf);
+	return;
+    }
+
+    pos += 2;
+    read_wdf(&pos, end, &wdf);
+    // Check the bitmap is the right size and that the bits for the first and
+    // last docids are set, so searching it can't run off the end.
+    size_t nbits = size_t(last_did_in_chunk - first_did_in_chunk) + 1;
+    bitmap = reinterpret_cast<const unsigned char *>(pos);
+    if (size_t(end - pos) != posting_bitmap_size(nbits) ||
+	!posting_bitmap_test(bitmap, 0) ||
+	!posting_bitmap_test(bitmap, nbits - 1)) {
+	throw Xapian::DatabaseCorruptError("Bad bitmap in posting list for '" +
+					   term + "'");
+    }
+}
+
 bool
 GlassPostList::next_in_chunk()
 {
     LOGCALL(DB, bool, "GlassPostList::next_in_chunk", NO_ARGS);
+    if (bitmap) {
+	if (did == last_did_in_chunk) RETURN(false);
+	size_t nbits = size_t(last_did_in_chunk - first_did_in_chunk) + 1;
+	did = first_did_in_chunk +
+	      posting_bitmap_find(bitmap, nbits, did - first_did_in_chunk + 1);
+	RETURN(true);
+    }
+
     if (pos == end) RETURN(false);
 
     read_did_increase(&pos, end, &did);
@@ -832,7 +986,8 @@ GlassPostList::next_chunk()
     first_did_in_chunk = did;
     last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
 					    &is_last_chunk);
-    read_wdf(&pos, end, &wdf);
+    read_first_entry();
+    if (!is_last_chunk) readahead();
 }
 
 PositionList *
@@ -930,11 +1085,15 @@ GlassPostList::move_to_chunk_containing(Xapian::docid desired_did)
     first_did_in_chunk = did;
     last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
 					    &is_last_chunk);
-    read_wdf(&pos, end, &wdf);
+    read_first_entry();
 
     // Possible, since desired_did might be after end of this chunk and before
     // the next.
-    if (desired_did > last_did_in_chunk) next_chunk();
+    if (desired_did > last_did_in_chunk) {
+	next_chunk();
+    } else if (!is_last_chunk) {
+	readahead();
+    }
 }
 
 bool
@@ -945,6 +1104,13 @@ GlassPostList::move_forward_in_chunk_to_at_least(Xapian::docid desired_did)
 	RETURN(true);
 
     if (desired_did <= last_did_in_chunk) {
+	if (bitmap) {
+	    size_t nbits = size_t(last_did_in_chunk - first_did_in_chunk) + 1;
+	    did = first_did_in_chunk +
+		  posting_bitmap_find(bitmap, nbits,
+				      desired_did - first_did_in_chunk);
+	    RETURN(true);
+	}
 	while (pos != end) {
 	    read_did_increase(&pos, end, &did);
 	    if (did >= desired_did) {
@@ -960,6 +1126,7 @@ GlassPostList::move_forward_in_chunk_to_at_least(Xapian::docid desired_did)
     }
 
     pos = end;
+    if (bitmap) did = last_did_in_chunk;
     RETURN(false);
 }
 
@@ -1097,8 +1264,13 @@ GlassPostListTable::get_chunk(const string &tname,
 	// until I've a clearer picture of everything which needs to be done.
 	// (FIXME)
 	*from = NULL;
-	(*to)->raw_append(first_did_in_chunk, last_did_in_chunk,
-			  string(pos, end));
+	if (Glass::is_bitmap_chunk(pos, end)) {
+	    (*to)->raw_append(first_did_in_chunk, last_did_in_chunk,
+			      Glass::expand_bitmap_chunk(pos, end));
+	} else {
+	    (*to)->raw_append(first_did_in_chunk, last_did_in_chunk,
+			      string(pos, end));
+	}
     } else {
 	*from = new PostlistChunkReader(first_did_in_chunk, string(pos, end));
     }
@@ -1134,6 +1306,8 @@ GlassPostListTable::merge_doclen_changes(const map<Xapian::docid, Xapian::termco
     LOGVALUE(DB, doclens.size());
     if (doclens.empty()) return;
 
+    if (doclen_column) doclen_column->merge_changes(doclens);
+
     // Ensure there's a first chunk.
     string current_key = make_key(string());
     if (!key_exists(current_key)) {
@@ -39,6 +39,7 @@
 
 class GlassCursor;
 class GlassDatabase;
+class GlassDocLenColumn;
 
 namespace Glass {
     class PostlistChunkReader;
@@ -48,12 +49,45 @@ namespace Glass {
 
 using Glass::RootInfo;
 
+namespace Glass {
+    /** Is postlist chunk data in the bitmap format?
+     *
+     *  The data for a chunk in the standard format starts with the wdf of
+     *  the first entry.  The bitmap format can be used when every entry in
+     *  the chunk has the same wdf, and starts with the bytes "\x80\0" (which
+     *  pack_uint() never produces), then that wdf, then a posting bitmap
+     *  (see postingbitmap.h) with a bit for each docid from the first to
+     *  the last in the chunk.
+     */
+    inline bool is_bitmap_chunk(const char * p, const char * end) {
+	return end - p >= 2 && p[0] == '\x80' && p[1] == '\0';
+    }
+
+    /** Convert postlist chunk data in the bitmap format to the standard
+     *  format.
+     */
+    std::string expand_bitmap_chunk(const char * p, const char * end);
+
+    /** Convert postlist chunk data to the bitmap format if that's smaller.
+     *
+     *  @param data		The chunk data (without the chunk header).
+     *  @param increase_to_last	The last docid in the chunk minus the first.
+     *
+     *  @return true if the data is now in the bitmap format.
+     */
+    bool make_bitmap_chunk(std::string & data,
+			   Xapian::docid increase_to_last);
+}
+
 class GlassPostList;
 
 class GlassPostListTable : public GlassTable {
     /// PostList for looking up document lengths.
     mutable std::unique_ptr<GlassPostList> doclen_pl;
 
+    /// Dense document length column to tell about doclen changes (or NULL).
+    GlassDocLenColumn* doclen_column = NULL;
+
   public:
     /** Create a new table object.
      *
@@ -87,6 +121,11 @@ class GlassPostListTable : public GlassTable {
     void merge_changes(const std::string& term,
 		       const Inverter::PostingChanges& changes);
 
+    /// Set the dense document length column to tell about doclen changes.
+    void set_doclen_column(GlassDocLenColumn* column) {
+	doclen_column = column;
+    }
+
     /// Merge document length changes.
     void merge_doclen_changes(const std::map<Xapian::docid,
 					Xapian::termcount>& doclens);
@@ -174,6 +213,9 @@ class GlassPostList : public LeafPostList {
     /// Pointer to byte after end of current chunk.
     const char * end;
 
+    /// The bitmap if the current chunk is in the bitmap format, else NULL.
+    const unsigned char * bitmap = NULL;
+
     /// Document id we're currently at.
     Xapian::docid did;
 
@@ -186,6 +228,12 @@ class GlassPostList : public LeafPostList {
     /// Upper bound on wdf for this postlist.
     Xapian::termcount wdf_upper_bound;
 
+    /** Prefix of the keys of chunks after the first.
+     *
+     *  Set the first time readahead() is called.
+     */
+    std::string chunk_key_prefix;
+
     /// Copying is not allowed.
     GlassPostList(const GlassPostList &);
 
@@ -197,6 +245,12 @@ class GlassPostList : public LeafPostList {
      */
     bool next_in_chunk();
 
+    /** Read the first entry in a chunk.
+     *
+     *  Called with pos pointing to the chunk data after the header.
+     */
+    void read_first_entry();
+
     /** Move to the next chunk.
      *
      *  If there are no more chunks in this postlist, this will set
@@ -204,6 +258,12 @@ class GlassPostList : public LeafPostList {
      */
     void next_chunk();
 
+    /** Readahead blocks holding the chunks after the current one.
+     *
+     *  Called after moving to a chunk which isn't the last.
+     */
+    void readahead();
+
     /** Return true if the given document ID lies in the range covered
      *  by the current chunk.  This does not say whether the document ID
      *  is actually present.  It will return false if the document ID
@@ -249,6 +309,13 @@ class GlassPostList : public LeafPostList {
 		  const std::string& term,
 		  bool keep_reference);
 
+    /** Construct a postlist which reads directly from @a table.
+     *
+     *  This doesn't need a reference to the database so can be used while
+     *  the database is being constructed or destroyed.
+     */
+    GlassPostList(const GlassPostListTable& table, const std::string& term);
+
     /// Destructor.
     ~GlassPostList();
 
@@ -49,9 +49,11 @@
 #include "filetests.h"
 #include "io_utils.h"
 #include "pack.h"
+#include "safesysstat.h"
 #include "wordaccess.h"
 
 #include <algorithm>  // for std::min()
+#include <limits>
 #include <string>
 
 #include "xapian/constants.h"
@@ -155,6 +157,18 @@ static inline uint8_t *zeroed_new(size_t size)
 
 #define BYTE_PAIR_RANGE (1 << 2 * CHAR_BIT)
 
+/// Check the directory end of block n at p is valid.
+static inline void
+check_dir_end(uint4 n, const uint8_t * p, unsigned block_size)
+{
+    int dir_end = DIR_END(p);
+    if (rare(dir_end < DIR_START || unsigned(dir_end) > block_size)) {
+	string msg("dir_end invalid in block ");
+	msg += str(n);
+	throw Xapian::DatabaseCorruptError(msg);
+    }
+}
+
 /// read_block(n, p) reads block n of the DB file to address p.
 void
 GlassTable::read_block(uint4 n, uint8_t * p) const
@@ -165,16 +179,115 @@ GlassTable::read_block(uint4 n, uint8_t * p) const
 	GlassTable::throw_database_closed();
     AssertRel(n,<,free_list.get_first_unused_block());
 
+    if (private_writes) {
+	auto i = private_blocks.find(n);
+	if (i != private_blocks.end()) {
+	    memcpy(p, i->second.data(), block_size);
+	    return;
+	}
+    }
+
+    GlassBlockCache* block_cache = NULL;
+    if (cache_file_id) {
+	block_cache = &GlassBlockCache::get_shared();
+	if (block_cache->read_block(cache_file_id, revision_number, n, p,
+				    block_size)) {
+	    // Only blocks which passed the checks below get cached.
+	    return;
+	}
+    }
+
     io_read_block(handle, reinterpret_cast<char *>(p), block_size, n, offset);
 
     if (GET_LEVEL(p) != LEVEL_FREELIST) {
-	int dir_end = DIR_END(p);
-	if (rare(dir_end < DIR_START || unsigned(dir_end) > block_size)) {
-	    string msg("dir_end invalid in block ");
-	    msg += str(n);
-	    throw Xapian::DatabaseCorruptError(msg);
+	check_dir_end(n, p, block_size);
+	// Every block we've written is in private_blocks, so this one has
+	// been reused by the writer.
+	if (private_writes && REVISION(p) > revision_number)
+	    set_overwritten();
+	// Don't cache a block which has been overwritten by a later revision
+	// - block_to_cursor() will report that to the caller.
+	if (block_cache && REVISION(p) <= revision_number) {
+	    block_cache->add_block(cache_file_id, revision_number, n, p,
+				   block_size);
+	}
+    }
+}
+
+/** load_block(cur, n) makes block n of the DB file the block in cursor cur.
+ *
+ *  If the block is in the table's mapping, it's taken from there, otherwise
+ *  it is read into cur's buffer.  Returns a pointer to the block.
+ */
+const uint8_t *
+GlassTable::load_block(Glass::Cursor & cur, uint4 n) const
+{
+    if (mapping) {
+	size_t o = size_t(offset) + size_t(n) * block_size;
+	if (usual(o + block_size <= mapping->size)) {
+	    if (rare(handle == -2))
+		GlassTable::throw_database_closed();
+	    AssertRel(n,<,free_list.get_first_unused_block());
+	    const uint8_t * p = mapping->base + o;
+	    if (single_file()) {
+		// A single-file database can't be updated, so cur can point
+		// at the block in the mapping.
+		if (GET_LEVEL(p) != LEVEL_FREELIST) {
+		    check_dir_end(n, p, block_size);
+		}
+		cur.init_mapped(mapping, n, p);
+		return p;
+	    }
+	    // A writer could reuse the block for a later revision while we're
+	    // decoding it, so copy it and check the copy as read_block() does.
+	    // If the block has been reused, block_to_cursor() reports that.
+	    uint8_t * q = cur.init(block_size);
+	    memcpy(q, p, block_size);
+	    if (GET_LEVEL(q) != LEVEL_FREELIST) {
+		check_dir_end(n, q, block_size);
+	    }
+	    cur.set_n(n);
+	    return q;
+	}
+	// The block was added to the file after we mapped it.
+    }
+    uint8_t * q = cur.init(block_size);
+    read_block(n, q);
+    cur.set_n(n);
+    return q;
+}
+
+/// Map the table file if use_mmap is set and it isn't already mapped.
+void
+GlassTable::update_mapping()
+{
+    LOGCALL_VOID(DB, "GlassTable::update_mapping", NO_ARGS);
+    Assert(!writable);
+    struct stat statbuf;
+    if (fstat(handle, &statbuf) != 0) {
+	// Just read blocks instead.
+	return;
+    }
+    if (mapping) {
+	if (mapping->dev == statbuf.st_dev &&
+	    mapping->ino == statbuf.st_ino &&
+	    off_t(mapping->size) == statbuf.st_size) {
+	    // Still the same file and no blocks have been added to it.
+	    return;
 	}
+	mapping->unref();
+	mapping = NULL;
+    }
+    if (statbuf.st_size <= 0 ||
+	(sizeof(off_t) > sizeof(size_t) &&
+	 statbuf.st_size > off_t(numeric_limits<size_t>::max()))) {
+	return;
     }
+    size_t size = size_t(statbuf.st_size);
+    const char * p = io_mmap_read(handle, size);
+    if (!p) return;
+    mapping = new Glass::Mapping(reinterpret_cast<const uint8_t *>(p), size,
+				 statbuf.st_dev, statbuf.st_ino);
 }
 
 /** write_block(n, p, appending) writes block n in the DB file from address p.
@@ -218,6 +331,10 @@ GlassTable::write_block(uint4 n, const uint8_t * p, bool appending) const
     }
 
     const char * p_char = reinterpret_cast<const char *>(p);
+    if (private_writes) {
+	private_blocks[n].assign(p_char, block_size);
+	return;
+    }
     io_write_block(handle, p_char, block_size, n, offset);
 
     if (!changes_obj) return;
@@ -291,7 +408,7 @@ GlassTable::set_overwritten() const
     LOGCALL_VOID(DB, "GlassTable::set_overwritten", NO_ARGS);
     // If we're writable, there shouldn't be another writer who could cause
     // overwritten to be flagged, so that's a DatabaseCorruptError.
-    if (writable)
+    if (writable && !private_writes)
 	throw Xapian::DatabaseCorruptError("Db block overwritten - are there multiple writers?");
     throw Xapian::DatabaseModifiedError("The revision being read has been discarded - you should call Xapian::Database::reopen() and retry the operation");
 }
@@ -324,10 +441,7 @@ GlassTable::block_to_cursor(Glass::Cursor * C_, int j, uint4 n) const
     if (n == C[j].get_n()) {
 	p = C_[j].clone(C[j]);
     } else {
-	uint8_t * q = C_[j].init(block_size);
-	read_block(n, q);
-	p = q;
-	C_[j].set_n(n);
+	p = load_block(C_[j], n);
     }
 
     if (j < level) {
@@ -1284,7 +1398,7 @@ GlassTable::add(const string &key, string tag, bool already_compressed)
 	    GlassTable::throw_database_closed();
 	}
 	RootInfo root_info;
-	root_info.init(block_size, compress_min);
+	root_info.init(block_size, compress_min, comp_stream.get_codec());
 	do_open_to_write(&root_info);
     }
 
@@ -1590,6 +1704,7 @@ GlassTable::basic_open(const RootInfo * root_info, glass_revision_number_t rev)
     }
 
     compress_min = root_info->get_compress_min();
+    comp_stream.set_codec(root_info->get_compression_codec());
 
     /* kt holds constructed items as well as keys */
     kt = LeafItem_wr(zeroed_new(block_size));
@@ -1664,7 +1779,39 @@ GlassTable::do_open_to_write(const RootInfo * root_info,
     if (handle <= -2) {
 	// Single file database.
 	handle = -3 - handle;
+    } else if (private_writes) {
+	handle = io_open_block_rd(name + GLASS_TABLE_EXTENSION);
+	if (handle < 0) {
+	    if (errno != ENOENT) {
+		string message("Couldn't open ");
+		message += name;
+		message += GLASS_TABLE_EXTENSION" to read";
+		throw Xapian::DatabaseOpeningError(message, errno);
+	    }
+	    if (lazy && rev) {
+		revision_number = rev;
+		return;
+	    }
+	    // The table is being created, so every block will be in
+	    // private_blocks, but we still need an fd - use the version file,
+	    // which is in the same directory.
+	    string::size_type slash = name.rfind('/');
+	    string version_path(name, 0, slash + 1);
+	    version_path += "iamglass";
+	    handle = io_open_block_rd(version_path);
+	    if (handle < 0) {
+		throw Xapian::DatabaseOpeningError("Couldn't open " +
+						   version_path, errno);
+	    }
+	}
     } else {
+	if (rev == 0) {
+	    // Remove any existing file rather than truncating it, so readers
+	    // with it mapped (see DB_MMAP) don't get SIGBUS.  If this fails
+	    // (e.g. the file doesn't exist) the file is truncated when opened.
+	    string filename = name + GLASS_TABLE_EXTENSION;
+	    (void)posixy_unlink(filename.c_str());
+	}
 	handle = io_open_block_wr(name + GLASS_TABLE_EXTENSION, (rev == 0));
 	if (handle < 0) {
 	    // lazy doesn't make a lot of sense when we're creating a DB (which
@@ -1723,7 +1870,10 @@ GlassTable::GlassTable(const char * tablename_, const string & path_,
 	  comp_stream(Z_DEFAULT_STRATEGY),
 	  lazy(lazy_),
 	  last_readahead(BLK_UNUSED),
-	  offset(0)
+	  offset(0),
+	  cache_file_id(0),
+	  use_mmap(false),
+	  mapping(NULL)
 {
     LOGCALL_CTOR(DB, "GlassTable", tablename_ | path_ | readonly_ | lazy_);
 }
@@ -1758,7 +1908,10 @@ GlassTable::GlassTable(const char * tablename_, int fd, off_t offset_,
 	  comp_stream(Z_DEFAULT_STRATEGY),
 	  lazy(lazy_),
 	  last_readahead(BLK_UNUSED),
-	  offset(offset_)
+	  offset(offset_),
+	  cache_file_id(0),
+	  use_mmap(false),
+	  mapping(NULL)
 {
     LOGCALL_CTOR(DB, "GlassTable", tablename_ | fd | offset_ | readonly_ | lazy_);
 }
@@ -1793,6 +1946,7 @@ GlassTable::create_and_open(int flags_, const RootInfo & root_info)
 	close();
 	(void)io_unlink(name + GLASS_TABLE_EXTENSION);
 	compress_min = root_info.get_compress_min();
+	comp_stream.set_codec(root_info.get_compression_codec());
     } else {
 	// FIXME: it would be good to arrange that this works such that there's
 	// always a valid table in place if you run create_and_open() on an
@@ -1805,11 +1959,19 @@ GlassTable::create_and_open(int flags_, const RootInfo & root_info)
 GlassTable::~GlassTable() {
     LOGCALL_DTOR(DB, "GlassTable");
     GlassTable::close();
+    // Cursors which still have a block in the mapping hold their own
+    // reference to it.
+    if (mapping) mapping->unref();
 }
 
 void GlassTable::close(bool permanent) {
     LOGCALL_VOID(DB, "GlassTable::close", permanent);
 
+    if (cache_file_id) {
+	GlassBlockCache::get_shared().release_file_id(cache_file_id);
+	cache_file_id = 0;
+    }
+
     if (handle >= 0) {
 	if (single_file()) {
 	    handle = -3 - handle;
@@ -1830,6 +1992,7 @@ void GlassTable::close(bool permanent) {
     for (int j = level; j >= 0; --j) {
 	C[j].destroy();
     }
+    private_blocks.clear();
     delete [] split_p;
     split_p = 0;
 
@@ -1865,6 +2028,7 @@ GlassTable::commit(glass_revision_number_t revision, RootInfo * root_info)
 {
     LOGCALL_VOID(DB, "GlassTable::commit", revision|root_info);
     Assert(writable);
+    Assert(!private_writes);
 
     if (revision <= revision_number) {
 	throw Xapian::DatabaseError("New revision too low");
@@ -1955,6 +2119,7 @@ GlassTable::cancel(const RootInfo & root_info, glass_revision_number_t rev)
     }
 
     Btree_modified = false;
+    private_blocks.clear();
 
     for (int j = 0; j <= level; ++j) {
 	C[j].init(block_size);
@@ -1999,6 +2164,16 @@ GlassTable::do_open_to_read(const RootInfo * root_info,
 	}
     }
 
+    if (use_mmap) {
+	update_mapping();
+    }
+
+    // There's no point also caching blocks we can access in the mapping.
+    GlassBlockCache* block_cache = GlassBlockCache::get_instance();
+    if (block_cache && !mapping) {
+	cache_file_id = block_cache->acquire_file_id(handle, offset);
+    }
+
     basic_open(root_info, rev);
 
     read_root();
@@ -2057,10 +2232,7 @@ GlassTable::prev_for_sequential(Glass::Cursor * C_, int /*dummy*/) const
 		// Block isn't in the built-in cursor, so the form on disk
 		// is valid, so read it to check if it's the next level 0
 		// block.
-		uint8_t * q = C_[0].init(block_size);
-		read_block(n, q);
-		p = q;
-		C_[0].set_n(n);
+		p = load_block(C_[0], n);
 	    }
 	    if (REVISION(p) > revision_number + writable) {
 		set_overwritten();
@@ -2111,14 +2283,10 @@ GlassTable::next_for_sequential(Glass::Cursor * C_, int /*dummy*/) const
 		    // Block isn't in the built-in cursor, so the form on disk
 		    // is valid, so read it to check if it's the next level 0
 		    // block.
-		    uint8_t * q = C_[0].init(block_size);
-		    read_block(n, q);
-		    p = q;
+		    p = load_block(C_[0], n);
 		}
 	    } else {
-		uint8_t * q = C_[0].init(block_size);
-		read_block(n, q);
-		p = q;
+		p = load_block(C_[0], n);
 	    }
 	    if (REVISION(p) > revision_number + writable) {
 		set_overwritten();
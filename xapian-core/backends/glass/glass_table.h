@@ -27,6 +27,7 @@
 #include <xapian/constants.h>
 #include <xapian/error.h>
 
+#include "glass_blockcache.h"
 #include "glass_freelist.h"
 #include "glass_cursor.h"
 #include "glass_defs.h"
@@ -41,6 +42,7 @@
 
 #include <algorithm>
 #include <string>
+#include <unordered_map>
 
 namespace Glass {
 
@@ -485,6 +487,23 @@ class GlassTable {
 
     bool readahead_key(const string &key) const;
 
+    /// Return the number of blocks cursors have issued readahead for.
+    unsigned long long get_readahead_issued() const {
+	return readahead_issued;
+    }
+
+    /// Return the number of those blocks which cursors then moved to.
+    unsigned long long get_readahead_used() const {
+	return readahead_used;
+    }
+
+    /** Read blocks via a memory mapping of the table file.
+     *
+     *  Only has an effect for a table opened read-only, and must be called
+     *  before the table is opened.
+     */
+    void set_mmap(bool use_mmap_) { use_mmap = use_mmap_; }
+
     /** Determine whether the btree exists on disk.
      */
     bool exists() const;
@@ -542,6 +561,36 @@ class GlassTable {
 	       io_sync(handle);
     }
 
+    /** Return the file descriptor to sync this table (-1 if not open).
+     *
+     *  This allows the table to be synced from another thread.
+     */
+    int get_fd_to_sync() const { return handle < 0 ? -1 : handle; }
+
+    /** Set whether to reuse blocks from the freelist.
+     *
+     *  See GlassFreeList::set_reuse_blocks().
+     */
+    void set_reuse_free_blocks(bool reuse) {
+	free_list.set_reuse_blocks(reuse);
+    }
+
+    /** Keep blocks written to the table in memory instead of the file.
+     *
+     *  This is used to replay the write-ahead log for a reader: the table
+     *  is opened as if to write, but the file is only ever read so the
+     *  writer isn't disturbed.  If a block on disk has been overwritten
+     *  since the revision which is open, DatabaseModifiedError is thrown as
+     *  it would be for a reader.
+     *
+     *  Must be called before the table is opened.  Such a table can't be
+     *  committed.
+     */
+    void set_private_writes() {
+	private_writes = true;
+	free_list.set_reuse_blocks(false);
+    }
+
     /** Cancel any outstanding changes.
      *
      *  This will discard any modifications which haven't been committed
@@ -658,6 +707,11 @@ class GlassTable {
 
     void set_full_compaction(bool parity);
 
+    /// Return the codec used to compress tags in this table.
+    compression_codec get_compression_codec() const {
+	return comp_stream.get_codec();
+    }
+
     /** Get the revision number at which this table
      *  is currently open.
      *
@@ -740,6 +794,8 @@ class GlassTable {
     bool find(Glass::Cursor *) const;
     int delete_kt();
     void read_block(uint4 n, uint8_t *p) const;
+    const uint8_t * load_block(Glass::Cursor & cur, uint4 n) const;
+    void update_mapping();
     void write_block(uint4 n, const uint8_t *p,
 		     bool appending = false) const;
     [[noreturn]]
@@ -788,6 +844,15 @@ class GlassTable {
      */
     bool sequential;
 
+    /** Number of blocks cursors on this table have issued readahead for.
+     *
+     *  Summed over all cursors, and kept when the table is reopened.
+     */
+    mutable unsigned long long readahead_issued = 0;
+
+    /// Number of those blocks which the cursors then moved to.
+    mutable unsigned long long readahead_used = 0;
+
     /** File descriptor of the table.
      *
      *  If close() has been called, this will be -2.
@@ -842,6 +907,12 @@ class GlassTable {
     /// Set to true when the database is opened to write.
     bool writable;
 
+    /// Are written blocks kept in private_blocks?  See set_private_writes().
+    bool private_writes = false;
+
+    /// Blocks written while private_writes is set, keyed by block number.
+    mutable std::unordered_map<uint4, std::string> private_blocks;
+
     /// Flag for tracking when cursors need to rebuild.
     mutable bool cursor_created_since_last_modification;
 
@@ -912,6 +983,25 @@ class GlassTable {
     /// offset to start of table in file.
     off_t offset;
 
+    /** Id of this table's file in the block cache.
+     *
+     *  0 if blocks read by this table aren't cached (which is always the
+     *  case for a writable table).
+     */
+    GlassBlockCache::file_id cache_file_id;
+
+    /// Should read-only opens map the table file?
+    bool use_mmap;
+
+    /** Read-only mapping of the table file, or NULL.
+     *
+     *  Blocks within the mapping are copied from it rather than read, or
+     *  for a single-file database (which can't be updated) accessed in
+     *  place.  The mapping is kept when the table is reopened if the file
+     *  hasn't changed size.
+     */
+    Glass::Mapping * mapping;
+
     /* Debugging methods */
 //    void report_block_full(int m, int n, const uint8_t * p);
 };
@@ -42,6 +42,19 @@ GlassValueList::update_reader()
     return true;
 }
 
+void
+GlassValueList::find_chunk_in_range(const string& lo, const string* hi)
+{
+    while (!cursor->after_end() && update_reader()) {
+	if (!reader.at_end() && reader.may_contain(lo, hi)) return;
+	cursor->next();
+    }
+
+    // We've reached the end.
+    delete cursor;
+    cursor = NULL;
+}
+
 GlassValueList::~GlassValueList()
 {
     delete cursor;
@@ -162,6 +175,48 @@ GlassValueList::check(Xapian::docid did)
     return true;
 }
 
+void
+GlassValueList::next_in_range(const string& lo, const string* hi)
+{
+    if (!cursor) {
+	cursor = db->get_postlist_cursor();
+	if (!cursor) return;
+	cursor->find_entry_ge(make_valuechunk_key(slot, 1));
+    } else if (!reader.at_end()) {
+	// We only check the bounds when we move to a new chunk.
+	reader.next();
+	if (!reader.at_end()) return;
+	cursor->next();
+    }
+
+    find_chunk_in_range(lo, hi);
+}
+
+void
+GlassValueList::skip_to_in_range(Xapian::docid did,
+				 const string& lo, const string* hi)
+{
+    if (!cursor) {
+	cursor = db->get_postlist_cursor();
+	if (!cursor) return;
+    } else if (!reader.at_end()) {
+	reader.skip_to(did);
+	if (!reader.at_end()) return;
+    }
+
+    if (!cursor->find_entry(make_valuechunk_key(slot, did))) {
+	if (update_reader() && reader.may_contain(lo, hi)) {
+	    reader.skip_to(did);
+	    if (!reader.at_end()) return;
+	}
+	// The requested docid is between two chunks, or the chunk containing
+	// it has no values in the range.
+	cursor->next();
+    }
+
+    find_chunk_in_range(lo, hi);
+}
+
 string
 GlassValueList::get_description() const
 {
@@ -46,6 +46,15 @@ class GlassValueList : public Xapian::ValueIterator::Internal {
     /// Update @a reader to use the chunk currently pointed to by @a cursor.
     bool update_reader();
 
+    /** Move to the first chunk which might contain a value in a range.
+     *
+     *  Starts from the chunk currently pointed to by @a cursor.
+     *
+     *  @param lo	The lower end of the range.
+     *  @param hi	The upper end of the range, or NULL for no upper end.
+     */
+    void find_chunk_in_range(const std::string& lo, const std::string* hi);
+
   public:
     GlassValueList(Xapian::valueno slot_,
 		   Xapian::Internal::intrusive_ptr<const GlassDatabase> db_)
@@ -67,6 +76,12 @@ class GlassValueList : public Xapian::ValueIterator::Internal {
 
     bool check(Xapian::docid did);
 
+    void next_in_range(const std::string& lo, const std::string* hi);
+
+    void skip_to_in_range(Xapian::docid did,
+			  const std::string& lo,
+			  const std::string* hi);
+
     std::string get_description() const;
 };
 
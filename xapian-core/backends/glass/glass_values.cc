@@ -26,6 +26,7 @@
 #include "glass_cursor.h"
 #include "glass_postlist.h"
 #include "glass_termlist.h"
+#include "glass_version.h"
 #include "debuglog.h"
 #include "backends/documentinternal.h"
 #include "pack.h"
@@ -74,8 +75,58 @@ ValueChunkReader::assign(const char * p_, size_t len, Xapian::docid did_)
     p = p_;
     end = p_ + len;
     did = did_;
-    if (!unpack_string(&p, end, value))
-	throw Xapian::DatabaseCorruptError("Failed to unpack first value");
+    if (len == 0 || *p != '\0') {
+	vpos = NULL;
+	if (!unpack_string(&p, end, value))
+	    throw Xapian::DatabaseCorruptError("Failed to unpack first value");
+	return;
+    }
+
+    // Columnar format.
+    ++p;
+    size_t docids_len;
+    if (!unpack_string(&p, end, lower_bound) ||
+	!unpack_string(&p, end, upper_bound) ||
+	!unpack_uint(&p, end, &width) ||
+	!unpack_uint(&p, end, &docids_len) ||
+	docids_len > size_t(end - p)) {
+	throw Xapian::DatabaseCorruptError("Bad columnar value chunk header");
+    }
+    const char * docids = p;
+    p += docids_len;
+    if (width == 0) {
+	size_t lengths_len;
+	if (!unpack_uint(&p, end, &lengths_len) ||
+	    lengths_len > size_t(end - p)) {
+	    throw Xapian::DatabaseCorruptError("Bad columnar value chunk "
+					       "lengths");
+	}
+	lpos = p;
+	lend = p + lengths_len;
+	p = lend;
+    }
+    vpos = p;
+    vend = end;
+    value_len = 0;
+    p = docids;
+    end = docids + docids_len;
+    advance_value();
+    value.assign(vpos, value_len);
+}
+
+void
+ValueChunkReader::advance_value()
+{
+    vpos += value_len;
+    if (width) {
+	value_len = width;
+    } else if (rare(!unpack_uint(&lpos, lend, &value_len))) {
+	throw Xapian::DatabaseCorruptError("Failed to unpack columnar value "
+					   "length");
+    }
+    if (rare(value_len > size_t(vend - vpos))) {
+	throw Xapian::DatabaseCorruptError("Columnar value chunk truncated");
+    }
 }
 
 void
@@ -90,6 +141,11 @@ ValueChunkReader::next()
     if (!unpack_uint(&p, end, &delta))
 	throw Xapian::DatabaseCorruptError("Failed to unpack streamed value docid");
     did += delta + 1;
+    if (vpos) {
+	advance_value();
+	value.assign(vpos, value_len);
+	return;
+    }
     if (!unpack_string(&p, end, value))
 	throw Xapian::DatabaseCorruptError("Failed to unpack streamed value");
 }
@@ -100,7 +156,25 @@ ValueChunkReader::skip_to(Xapian::docid target)
     if (p == NULL || target <= did)
 	return;
 
-    size_t value_len;
+    if (vpos) {
+	// The docids are stored separately, so we only need to step over the
+	// values we skip.
+	while (p != end) {
+	    Xapian::docid delta;
+	    if (rare(!unpack_uint(&p, end, &delta)))
+		throw Xapian::DatabaseCorruptError("Failed to unpack streamed value docid");
+	    did += delta + 1;
+	    advance_value();
+	    if (did >= target) {
+		value.assign(vpos, value_len);
+		return;
+	    }
+	}
+	p = NULL;
+	return;
+    }
+
+    size_t len;
     while (p != end) {
 	// Get the next docid
 	Xapian::docid delta;
@@ -109,26 +183,68 @@ ValueChunkReader::skip_to(Xapian::docid target)
 	did += delta + 1;
 
 	// Get the length of the string
-	if (rare(!unpack_uint(&p, end, &value_len))) {
+	if (rare(!unpack_uint(&p, end, &len))) {
 	    throw Xapian::DatabaseCorruptError("Failed to unpack streamed value length");
 	}
 
 	// Check that it's not too long
-	if (rare(value_len > size_t(end - p))) {
+	if (rare(len > size_t(end - p))) {
 	    throw Xapian::DatabaseCorruptError("Failed to unpack streamed value");
 	}
 
 	// Assign the value and return only if we've reached the target
 	if (did >= target) {
-	    value.assign(p, value_len);
-	    p += value_len;
+	    value.assign(p, len);
+	    p += len;
 	    return;
 	}
-	p += value_len;
+	p += len;
     }
     p = NULL;
 }
 
+void
+ColumnarChunkBuilder::add(Xapian::docid did, const string & v)
+{
+    Assert(!v.empty());
+    if (first_did == 0) {
+	first_did = did;
+	width = v.size();
+	lower_bound = v;
+	upper_bound = v;
+    } else {
+	AssertRel(did,>,prev_did);
+	pack_uint(docids, did - prev_did - 1);
+	if (v.size() != width) width = 0;
+	if (v < lower_bound) {
+	    lower_bound = v;
+	} else if (v > upper_bound) {
+	    upper_bound = v;
+	}
+    }
+    prev_did = did;
+    pack_uint(lengths, v.size());
+    values += v;
+}
+
+void
+ColumnarChunkBuilder::build(string & tag)
+{
+    Assert(!empty());
+    tag.assign(1, '\0');
+    pack_string(tag, lower_bound);
+    pack_string(tag, upper_bound);
+    pack_uint(tag, width);
+    pack_string(tag, docids);
+    if (width == 0) pack_string(tag, lengths);
+    tag += values;
+
+    first_did = 0;
+    docids.resize(0);
+    lengths.resize(0);
+    values.resize(0);
+}
+
 void
 GlassValueManager::add_value(Xapian::docid did, Xapian::valueno slot,
 			     const string & val)
@@ -136,8 +252,16 @@ GlassValueManager::add_value(Xapian::docid did, Xapian::valueno slot,
     auto i = changes.find(slot);
     if (i == changes.end()) {
 	i = changes.insert(make_pair(slot, map<Xapian::docid, string>())).first;
+	changes_memory += GLASS_MAP_NODE_OVERHEAD + sizeof(*i);
     }
-    i->second[did] = val;
+    auto j = i->second.insert(make_pair(did, string()));
+    if (j.second) {
+	changes_memory += GLASS_MAP_NODE_OVERHEAD + sizeof(*j.first);
+    } else {
+	changes_memory -= j.first->second.size();
+    }
+    j.first->second = val;
+    changes_memory += val.size();
 }
 
 void
@@ -146,8 +270,15 @@ GlassValueManager::remove_value(Xapian::docid did, Xapian::valueno slot)
     auto i = changes.find(slot);
     if (i == changes.end()) {
 	i = changes.insert(make_pair(slot, map<Xapian::docid, string>())).first;
+	changes_memory += GLASS_MAP_NODE_OVERHEAD + sizeof(*i);
+    }
+    auto j = i->second.insert(make_pair(did, string()));
+    if (j.second) {
+	changes_memory += GLASS_MAP_NODE_OVERHEAD + sizeof(*j.first);
+    } else {
+	changes_memory -= j.first->second.size();
+	j.first->second = string();
     }
-    i->second[did] = string();
 }
 
 Xapian::docid
@@ -198,6 +329,11 @@ class ValueUpdater {
 
     Xapian::valueno slot;
 
+    /// Write chunks in the columnar format?
+    bool columnar;
+
+    ColumnarChunkBuilder builder;
+
     string ctag;
 
     ValueChunkReader reader;
@@ -214,6 +350,11 @@ class ValueUpdater {
 
     void append_to_stream(Xapian::docid did, const string & value) {
 	Assert(did);
+	if (columnar) {
+	    builder.add(did, value);
+	    if (builder.size() >= CHUNK_SIZE_THRESHOLD) write_tag();
+	    return;
+	}
 	if (tag.empty()) {
 	    new_first_did = did;
 	} else {
@@ -226,6 +367,10 @@ class ValueUpdater {
     }
 
     void write_tag() {
+	if (columnar && !builder.empty()) {
+	    new_first_did = builder.get_first_docid();
+	    builder.build(tag);
+	}
 	// If the first docid has changed, delete the old entry.
 	if (first_did && new_first_did != first_did) {
 	    table->del(make_valuechunk_key(slot, first_did));
@@ -238,8 +383,10 @@ class ValueUpdater {
     }
 
   public:
-    ValueUpdater(GlassPostListTable * table_, Xapian::valueno slot_)
-	: table(table_), slot(slot_), first_did(0), last_allowed_did(0) { }
+    ValueUpdater(GlassPostListTable * table_, Xapian::valueno slot_,
+		 bool columnar_)
+	: table(table_), slot(slot_), columnar(columnar_),
+	  first_did(0), last_allowed_did(0) { }
 
     ~ValueUpdater() {
 	while (!reader.at_end()) {
@@ -338,13 +485,15 @@ GlassValueManager::merge_changes()
 
     for (auto i : changes) {
 	Xapian::valueno slot = i.first;
-	Glass::ValueUpdater updater(postlist_table, slot);
+	Glass::ValueUpdater updater(postlist_table, slot,
+				    version_file->has_feature(FEATURE_COLUMNAR_VALUES));
 	const map<Xapian::docid, string>& slot_changes = i.second;
 	for (auto j : slot_changes) {
 	    updater.update(j.first, j.second);
 	}
     }
     changes.clear();
+    changes_memory = 0;
 }
 
 void
@@ -395,7 +544,13 @@ GlassValueManager::add_document(Xapian::docid did, const Xapian::Document &doc,
     if (slots_used.empty() && slots.find(did) == slots.end()) {
 	// Adding a new document with no values which we didn't just remove.
     } else {
-	swap(slots[did], slots_used);
+	auto i = slots.insert(make_pair(did, string()));
+	if (i.second) {
+	    changes_memory += GLASS_MAP_NODE_OVERHEAD + sizeof(*i.first);
+	}
+	changes_memory += slots_used.size();
+	changes_memory -= i.first->second.size();
+	swap(i.first->second, slots_used);
     }
 }
 
@@ -408,10 +563,13 @@ GlassValueManager::delete_document(Xapian::docid did,
     string s;
     if (it != slots.end()) {
 	swap(s, it->second);
+	changes_memory -= s.size();
     } else {
 	// Get from table, making a swift exit if this document has no values.
 	if (!termlist_table->get_exact_entry(make_slot_key(did), s)) return;
 	slots.insert(make_pair(did, string()));
+	changes_memory += GLASS_MAP_NODE_OVERHEAD +
+			  sizeof(pair<const Xapian::docid, string>);
     }
     const char * p = s.data();
     const char * end = p + s.size();
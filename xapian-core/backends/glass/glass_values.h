@@ -22,12 +22,14 @@
 #ifndef XAPIAN_INCLUDED_GLASS_VALUES_H
 #define XAPIAN_INCLUDED_GLASS_VALUES_H
 
+#include "glass_defs.h"
 #include "pack.h"
 #include "backends/valuestats.h"
 
 #include "xapian/error.h"
 #include "xapian/types.h"
 
+#include <cstddef>
 #include <map>
 #include <memory>
 #include <string>
@@ -72,6 +74,7 @@ namespace Xapian {
 
 class GlassPostListTable;
 class GlassTermListTable;
+class GlassVersion;
 struct ValueStats;
 
 class GlassValueManager {
@@ -89,10 +92,16 @@ class GlassValueManager {
 
     GlassTermListTable * termlist_table;
 
+    /// Used to check which format to write value chunks in.
+    const GlassVersion * version_file;
+
     std::map<Xapian::docid, std::string> slots;
 
     std::map<Xapian::valueno, std::map<Xapian::docid, std::string>> changes;
 
+    /// Approximate memory used by @a slots and @a changes.
+    std::size_t changes_memory = 0;
+
     mutable std::unique_ptr<GlassCursor> cursor;
 
     void add_value(Xapian::docid did, Xapian::valueno slot,
@@ -112,10 +121,12 @@ class GlassValueManager {
   public:
     /** Create a new GlassValueManager object. */
     GlassValueManager(GlassPostListTable * postlist_table_,
-		      GlassTermListTable * termlist_table_)
+		      GlassTermListTable * termlist_table_,
+		      const GlassVersion * version_file_)
 	: mru_slot(Xapian::BAD_VALUENO),
 	  postlist_table(postlist_table_),
-	  termlist_table(termlist_table_) { }
+	  termlist_table(termlist_table_),
+	  version_file(version_file_) { }
 
     // Merge in batched-up changes.
     void merge_changes();
@@ -167,23 +178,83 @@ class GlassValueManager {
 	return !changes.empty();
     }
 
+    /// Return the approximate number of bytes used by batched-up changes.
+    std::size_t get_memory_used() const { return changes_memory; }
+
     void cancel() {
 	// Discard batched-up changes.
 	slots.clear();
 	changes.clear();
+	changes_memory = 0;
     }
 };
 
 namespace Glass {
 
+/** Reads a value chunk.
+ *
+ *  There are two formats of value chunk.  The original format interleaves
+ *  the docid deltas and values:
+ *
+ *	S<first value> { I<docid delta - 1> S<value> }*
+ *
+ *  The columnar format (used if the database has the
+ *  Glass::FEATURE_COLUMNAR_VALUES feature) starts with a zero byte (which
+ *  can't start the original format as empty values aren't stored), then
+ *  the smallest and largest values in the chunk (a "zone map" which allows
+ *  a whole chunk to be skipped without decoding it), then the docid deltas
+ *  and values stored separately:
+ *
+ *	'\0' S<lower bound> S<upper bound> I<width>
+ *	S<docid deltas: { I<docid delta - 1> }*>
+ *	(width ? <values: width bytes each>
+ *	       : S<value lengths: { I<length> }*> <values>)
+ *
+ *  If all the values in the chunk are the same length, width is that length
+ *  and each value is at a fixed offset; otherwise it's 0.  Either way, the
+ *  docids can be skipped over without touching the values.
+ */
 class ValueChunkReader {
+    /// Current position in the docids (NULL if at_end()).
     const char *p;
+
+    /// End of the docids.
     const char *end;
 
     Xapian::docid did;
 
     std::string value;
 
+    /// Position of the current value in a columnar chunk (else NULL).
+    const char *vpos = NULL;
+
+    /// End of the values in a columnar chunk.
+    const char *vend;
+
+    /// Current position in the lengths in a columnar chunk.
+    const char *lpos;
+
+    /// End of the lengths in a columnar chunk.
+    const char *lend;
+
+    /// Width of each value in a columnar chunk (0 if they vary).
+    size_t width;
+
+    /// Length of the current value in a columnar chunk.
+    size_t value_len;
+
+    /// Smallest value in a columnar chunk.
+    std::string lower_bound;
+
+    /// Largest value in a columnar chunk.
+    std::string upper_bound;
+
+    /** Move to the next value in a columnar chunk.
+     *
+     *  This just updates vpos and value_len - it doesn't set value.
+     */
+    void advance_value();
+
   public:
     /// Create a ValueChunkReader which is already at_end().
     ValueChunkReader() : p(NULL) { }
@@ -200,11 +271,83 @@ class ValueChunkReader {
 
     const std::string & get_value() const { return value; }
 
+    /// Is the chunk in the columnar format?
+    bool is_columnar() const { return vpos != NULL; }
+
+    /** Smallest value in the chunk.
+     *
+     *  Only available for a columnar chunk (see is_columnar()).
+     */
+    const std::string & get_lower_bound() const { return lower_bound; }
+
+    /** Largest value in the chunk.
+     *
+     *  Only available for a columnar chunk (see is_columnar()).
+     */
+    const std::string & get_upper_bound() const { return upper_bound; }
+
+    /** Might the chunk contain a value in the range [@a lo, @a hi]?
+     *
+     *  This is always true for a chunk in the original format, as it
+     *  doesn't record bounds.
+     *
+     *  @param lo	The lower end of the range.
+     *  @param hi	The upper end of the range, or NULL for no upper end.
+     */
+    bool may_contain(const std::string & lo, const std::string * hi) const {
+	if (!is_columnar()) return true;
+	return upper_bound >= lo && (!hi || lower_bound <= *hi);
+    }
+
     void next();
 
     void skip_to(Xapian::docid target);
 };
 
+/// Builds a value chunk in the columnar format.
+class ColumnarChunkBuilder {
+    /// The first docid in the chunk.
+    Xapian::docid first_did = 0;
+
+    /// The previous docid added.
+    Xapian::docid prev_did = 0;
+
+    /// Encoded docid deltas.
+    std::string docids;
+
+    /// Encoded value lengths.
+    std::string lengths;
+
+    /// The values.
+    std::string values;
+
+    /// Width of the values (0 if they vary in length).
+    size_t width = 0;
+
+    std::string lower_bound, upper_bound;
+
+  public:
+    bool empty() const { return first_did == 0; }
+
+    /// Return the first docid in the chunk.
+    Xapian::docid get_first_docid() const { return first_did; }
+
+    /// Return the approximate size of the encoded chunk.
+    size_t size() const {
+	return docids.size() + lengths.size() + values.size();
+    }
+
+    /** Add an entry.
+     *
+     *  @param did	The docid, which must be greater than any already added.
+     *  @param v	The value (which must not be empty).
+     */
+    void add(Xapian::docid did, const std::string & v);
+
+    /// Set @a tag to the encoded chunk and reset for a new chunk.
+    void build(std::string & tag);
+};
+
 }
 
 #endif // XAPIAN_INCLUDED_GLASS_VALUES_H
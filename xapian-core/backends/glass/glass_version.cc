@@ -50,7 +50,9 @@
 using namespace std;
 
 /// Glass format version (date of change):
-#define GLASS_FORMAT_VERSION DATE_TO_VERSION(2016,03,14)
+#define GLASS_FORMAT_VERSION DATE_TO_VERSION(2026,10,17)
+// 2026,10,17 1.5.0 feature flags (columnar value chunks) in version file
+// 2026,10,16 1.5.0 compression codec in version file
 // 2016,03,14 1.3.5 compress_min in version file; partly eliminate component_of
 // 2015,12,24 1.3.4 2 bytes "components_of" per item eliminated, and much more
 // 2014,11,21 1.3.2 Brass renamed to Glass
@@ -62,12 +64,25 @@ using namespace std;
 #define VERSION_TO_MONTH(V) ((unsigned(V) >> 5) & 0x0f)
 #define VERSION_TO_DAY(V) (unsigned(V) & 0x1f)
 
+/** Format version without the compression codec in the version file.
+ *
+ *  We still write this format if all the tables use zlib, so such databases
+ *  can still be read by older versions.
+ */
+#define GLASS_FORMAT_VERSION_ZLIB_ONLY DATE_TO_VERSION(2016,03,14)
+
+/** Format version without the feature flags in the version file.
+ *
+ *  We still write this format if no feature flags are set, so such databases
+ *  can still be read by older versions.
+ */
+#define GLASS_FORMAT_VERSION_NO_FEATURES DATE_TO_VERSION(2026,10,16)
+
 #define GLASS_VERSION_MAGIC_LEN 14
 #define GLASS_VERSION_MAGIC_AND_VERSION_LEN 16
 
-static const char GLASS_VERSION_MAGIC[GLASS_VERSION_MAGIC_AND_VERSION_LEN] = {
-    '\x0f', '\x0d', 'X', 'a', 'p', 'i', 'a', 'n', ' ', 'G', 'l', 'a', 's', 's',
-    char((GLASS_FORMAT_VERSION >> 8) & 0xff), char(GLASS_FORMAT_VERSION & 0xff)
+static const char GLASS_VERSION_MAGIC[GLASS_VERSION_MAGIC_LEN] = {
+    '\x0f', '\x0d', 'X', 'a', 'p', 'i', 'a', 'n', ' ', 'G', 'l', 'a', 's', 's'
 };
 
 GlassVersion::GlassVersion(int fd_)
@@ -75,7 +90,7 @@ GlassVersion::GlassVersion(int fd_)
       doccount(0), total_doclen(0), last_docid(0),
       doclen_lbound(0), doclen_ubound(0),
       wdf_ubound(0), spelling_wordfreq_ubound(0),
-      oldest_changeset(0)
+      oldest_changeset(0), features(0)
 {
     offset = lseek(fd, 0, SEEK_CUR);
     if (rare(offset < 0)) {
@@ -133,7 +148,9 @@ GlassVersion::read()
     version = static_cast<unsigned char>(buf[GLASS_VERSION_MAGIC_LEN]);
     version <<= 8;
     version |= static_cast<unsigned char>(buf[GLASS_VERSION_MAGIC_LEN + 1]);
-    if (version != GLASS_FORMAT_VERSION) {
+    if (version != GLASS_FORMAT_VERSION &&
+	version != GLASS_FORMAT_VERSION_NO_FEATURES &&
+	version != GLASS_FORMAT_VERSION_ZLIB_ONLY) {
 	string msg;
 	if (!single_file()) {
 	    msg = db_dir;
@@ -157,13 +174,25 @@ GlassVersion::read()
     if (!unpack_uint(&p, end, &rev))
 	throw Xapian::DatabaseCorruptError("Rev file failed to decode revision");
 
+    bool with_codec = (version != GLASS_FORMAT_VERSION_ZLIB_ONLY);
     for (unsigned table_no = 0; table_no < Glass::MAX_; ++table_no) {
-	if (!root[table_no].unserialise(&p, end)) {
+	if (!root[table_no].unserialise(&p, end, with_codec)) {
 	    throw Xapian::DatabaseCorruptError("Rev file root_info missing");
 	}
 	old_root[table_no] = root[table_no];
     }
 
+    features = 0;
+    if (version == GLASS_FORMAT_VERSION) {
+	if (!unpack_uint(&p, end, &features))
+	    throw Xapian::DatabaseCorruptError("Rev file features missing");
+	if (features & ~unsigned(Glass::FEATURE_MASK_)) {
+	    throw Xapian::DatabaseVersionError("Database uses features which "
+					       "this version doesn't "
+					       "understand");
+	}
+    }
+
     // For a single-file database, this will assign extra data.  We read
     // sizeof(buf) above, then skip GLASS_VERSION_MAGIC_AND_VERSION_LEN,
     // then 16, then the size of the serialised root info.
@@ -236,6 +265,8 @@ GlassVersion::unserialise_stats()
 void
 GlassVersion::merge_stats(const GlassVersion & o)
 {
+    features |= o.features;
+
     doccount += o.get_doccount();
     if (doccount < o.get_doccount()) {
 	throw Xapian::DatabaseError("doccount overflowed!");
@@ -273,14 +304,34 @@ GlassVersion::write(glass_revision_number_t new_rev, int flags)
 {
     LOGCALL(DB, const string, "GlassVersion::write", new_rev|flags);
 
-    string s(GLASS_VERSION_MAGIC, GLASS_VERSION_MAGIC_AND_VERSION_LEN);
+    bool with_codec = false;
+    for (unsigned table_no = 0; table_no < Glass::MAX_; ++table_no) {
+	if (root[table_no].get_compression_codec() != COMPRESSION_ZLIB) {
+	    with_codec = true;
+	    break;
+	}
+    }
+    unsigned version;
+    if (features) {
+	version = GLASS_FORMAT_VERSION;
+	with_codec = true;
+    } else if (with_codec) {
+	version = GLASS_FORMAT_VERSION_NO_FEATURES;
+    } else {
+	version = GLASS_FORMAT_VERSION_ZLIB_ONLY;
+    }
+
+    string s(GLASS_VERSION_MAGIC, GLASS_VERSION_MAGIC_LEN);
+    s += char((version >> 8) & 0xff);
+    s += char(version & 0xff);
     s.append(uuid.data(), uuid.BINARY_SIZE);
 
     pack_uint(s, new_rev);
 
     for (unsigned table_no = 0; table_no < Glass::MAX_; ++table_no) {
-	root[table_no].serialise(s);
+	root[table_no].serialise(s, with_codec);
     }
+    if (features) pack_uint(s, features);
 
     // Serialise database statistics.
     serialise_stats();
@@ -359,39 +410,71 @@ GlassVersion::sync(const string & tmpfile,
     } else {
 	int fd_to_close = fd;
 	fd = -1;
-	if ((flags & Xapian::DB_NO_SYNC) == 0 &&
-	    ((flags & Xapian::DB_FULL_SYNC) ?
-	      !io_full_sync(fd_to_close) :
-	      !io_sync(fd_to_close))) {
-	    int save_errno = errno;
-	    (void)close(fd_to_close);
-	    if (!tmpfile.empty())
-		(void)unlink(tmpfile.c_str());
-	    errno = save_errno;
-	    return false;
-	}
-
-	if (close(fd_to_close) != 0) {
-	    if (!tmpfile.empty()) {
-		int save_errno = errno;
-		(void)unlink(tmpfile.c_str());
-		errno = save_errno;
-	    }
+	if (!sync_file(fd_to_close, tmpfile, db_dir, flags)) {
 	    return false;
 	}
+    }
 
-	if (!tmpfile.empty()) {
-	    if (!io_tmp_rename(tmpfile, db_dir + "/iamglass")) {
-		return false;
-	    }
-	}
+    for (unsigned table_no = 0; table_no < Glass::MAX_; ++table_no) {
+	old_root[table_no] = root[table_no];
     }
 
+    rev = new_rev;
+    return true;
+}
+
+int
+GlassVersion::get_fd_to_sync() const
+{
+    Assert(!single_file());
+    return fd;
+}
+
+void
+GlassVersion::release_fd(glass_revision_number_t new_rev)
+{
+    Assert(new_rev > rev || rev == 0);
+    Assert(!single_file());
+
+    fd = -1;
+
     for (unsigned table_no = 0; table_no < Glass::MAX_; ++table_no) {
 	old_root[table_no] = root[table_no];
     }
 
     rev = new_rev;
+}
+
+bool
+GlassVersion::sync_file(int fd_, const string & tmpfile,
+			const string & db_dir_, int flags)
+{
+    if ((flags & Xapian::DB_NO_SYNC) == 0 &&
+	((flags & Xapian::DB_FULL_SYNC) ?
+	  !io_full_sync(fd_) :
+	  !io_sync(fd_))) {
+	int save_errno = errno;
+	(void)close(fd_);
+	if (!tmpfile.empty())
+	    (void)unlink(tmpfile.c_str());
+	errno = save_errno;
+	return false;
+    }
+
+    if (close(fd_) != 0) {
+	if (!tmpfile.empty()) {
+	    int save_errno = errno;
+	    (void)unlink(tmpfile.c_str());
+	    errno = save_errno;
+	}
+	return false;
+    }
+
+    if (!tmpfile.empty()) {
+	if (!io_tmp_rename(tmpfile, db_dir_ + "/iamglass")) {
+	    return false;
+	}
+    }
     return true;
 }
 
@@ -414,19 +497,28 @@ static const uint4 compress_min_tab[] = {
 };
 
 void
-GlassVersion::create(unsigned blocksize)
+GlassVersion::create(unsigned blocksize, compression_codec codec)
 {
     AssertRel(blocksize,>=,GLASS_MIN_BLOCKSIZE);
+    if (!compression_codec_supported(codec)) {
+	throw Xapian::FeatureUnavailableError("Requested compression codec "
+					      "not supported by this build");
+    }
     uuid.generate();
     for (unsigned table_no = 0; table_no < Glass::MAX_; ++table_no) {
-	root[table_no].init(blocksize, compress_min_tab[table_no]);
+	uint4 compress_min = compress_min_tab[table_no];
+	// Tables which don't compress tags stick with zlib so they don't
+	// needlessly require the newer format.
+	root[table_no].init(blocksize, compress_min,
+			    compress_min ? codec : COMPRESSION_ZLIB);
     }
 }
 
 namespace Glass {
 
 void
-RootInfo::init(unsigned blocksize_, uint4 compress_min_)
+RootInfo::init(unsigned blocksize_, uint4 compress_min_,
+	       compression_codec codec_)
 {
     AssertRel(blocksize_,>=,GLASS_MIN_BLOCKSIZE);
     root = 0;
@@ -436,11 +528,12 @@ RootInfo::init(unsigned blocksize_, uint4 compress_min_)
     sequential = true;
     blocksize = blocksize_;
     compress_min = compress_min_;
+    codec = codec_;
     fl_serialised.resize(0);
 }
 
 void
-RootInfo::serialise(string &s) const
+RootInfo::serialise(string &s, bool with_codec) const
 {
     pack_uint(s, root);
     unsigned val = level << 2;
@@ -450,19 +543,28 @@ RootInfo::serialise(string &s) const
     pack_uint(s, num_entries);
     pack_uint(s, blocksize >> 11);
     pack_uint(s, compress_min);
+    if (with_codec) {
+	pack_uint(s, unsigned(codec));
+    } else {
+	AssertEq(codec, COMPRESSION_ZLIB);
+    }
     pack_string(s, fl_serialised);
 }
 
 bool
-RootInfo::unserialise(const char ** p, const char * end)
+RootInfo::unserialise(const char ** p, const char * end, bool with_codec)
 {
     unsigned val;
+    unsigned codec_ = COMPRESSION_ZLIB;
     if (!unpack_uint(p, end, &root) ||
 	!unpack_uint(p, end, &val) ||
 	!unpack_uint(p, end, &num_entries) ||
 	!unpack_uint(p, end, &blocksize) ||
 	!unpack_uint(p, end, &compress_min) ||
+	(with_codec && !unpack_uint(p, end, &codec_)) ||
 	!unpack_string(p, end, fl_serialised)) return false;
+    if (codec_ > COMPRESSION_ZSTD) return false;
+    codec = compression_codec(codec_);
     level = val >> 2;
     sequential = val & 0x02;
     root_is_fake = val & 0x01;
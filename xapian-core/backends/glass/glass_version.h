@@ -32,6 +32,7 @@
 #include <string>
 
 #include "backends/uuids.h"
+#include "compression_stream.h"
 #include "internaltypes.h"
 #include "min_non_zero.h"
 #include "xapian/types.h"
@@ -47,14 +48,22 @@ class RootInfo {
     unsigned blocksize;
     /// Should be >= 4 or 0 for no compression.
     uint4 compress_min;
+    /// Codec used to compress tags.
+    compression_codec codec;
     std::string fl_serialised;
 
   public:
-    void init(unsigned blocksize_, uint4 compress_min_);
+    void init(unsigned blocksize_, uint4 compress_min_,
+	      compression_codec codec_ = COMPRESSION_ZLIB);
 
-    void serialise(std::string &s) const;
+    /** Serialise.
+     *
+     *  @param with_codec  Include the codec (which older format versions
+     *		   lack, and which must be COMPRESSION_ZLIB if false).
+     */
+    void serialise(std::string &s, bool with_codec) const;
 
-    bool unserialise(const char ** p, const char * end);
+    bool unserialise(const char ** p, const char * end, bool with_codec);
 
     glass_block_t get_root() const { return root; }
     int get_level() const { return int(level); }
@@ -67,6 +76,7 @@ class RootInfo {
 	return blocksize;
     }
     uint4 get_compress_min() const { return compress_min; }
+    compression_codec get_compression_codec() const { return codec; }
     const std::string & get_free_list() const { return fl_serialised; }
 
     void set_level(int level_) { level = unsigned(level_); }
@@ -147,6 +157,9 @@ class GlassVersion {
     /// Oldest changeset removed when max_changesets is set
     mutable glass_revision_number_t oldest_changeset;
 
+    /// Optional features used by this database (Glass::FEATURE_* bits).
+    unsigned features;
+
     /// The serialised database stats.
     std::string serialised_stats;
 
@@ -162,14 +175,18 @@ class GlassVersion {
 	  doccount(0), total_doclen(0), last_docid(0),
 	  doclen_lbound(0), doclen_ubound(0),
 	  wdf_ubound(0), spelling_wordfreq_ubound(0),
-	  oldest_changeset(0) { }
+	  oldest_changeset(0), features(0) { }
 
     explicit GlassVersion(int fd_);
 
     ~GlassVersion();
 
-    /** Create the version file. */
-    void create(unsigned blocksize);
+    /** Create the version file.
+     *
+     *  @param codec	Codec for tables which compress tags to use.
+     */
+    void create(unsigned blocksize,
+		compression_codec codec = COMPRESSION_ZLIB);
 
     void set_changes(GlassChanges * changes_) { changes = changes_; }
 
@@ -186,6 +203,36 @@ class GlassVersion {
     bool sync(const std::string & tmpfile,
 	      glass_revision_number_t new_rev, int flags);
 
+    /** Return the file descriptor of the new version file.
+     *
+     *  This is the file written by write().  Not supported for a single-file
+     *  database.
+     */
+    int get_fd_to_sync() const;
+
+    /** Update the state as sync() does, but leave the syncing to the caller.
+     *
+     *  The caller becomes responsible for passing the file descriptor
+     *  returned by get_fd_to_sync() to sync_file() (possibly from another
+     *  thread).
+     */
+    void release_fd(glass_revision_number_t new_rev);
+
+    /** Sync and close the new version file, then rename it into place.
+     *
+     *  This only makes system calls, so it's safe to call on another thread
+     *  while this object is being used.
+     *
+     *  @param fd_	The file descriptor returned by release_fd().
+     *  @param tmpfile	The temporary file name returned by write().
+     *  @param db_dir_	The database directory.
+     *  @param flags	The flags the database was opened with.
+     *
+     *  @return true if successful, otherwise false with errno set.
+     */
+    static bool sync_file(int fd_, const std::string & tmpfile,
+			  const std::string & db_dir_, int flags);
+
     glass_revision_number_t get_revision() const { return rev; }
 
     const RootInfo & get_root(Glass::table_type tbl) const {
@@ -237,6 +284,18 @@ class GlassVersion {
 	return (doclen_lbound - 1) / wdf_ubound + 1;
     }
 
+    /// Does this database use feature @a feature (a Glass::FEATURE_* bit)?
+    bool has_feature(unsigned feature) const {
+	return (features & feature) != 0;
+    }
+
+    /** Start using feature @a feature (a Glass::FEATURE_* bit).
+     *
+     *  This takes effect when the next revision is written, after which the
+     *  database can't be read by versions which don't support the feature.
+     */
+    void set_feature(unsigned feature) { features |= feature; }
+
     void set_last_docid(Xapian::docid did) { last_docid = did; }
 
     void set_oldest_changeset(glass_revision_number_t changeset) const {
@@ -0,0 +1,291 @@
+/** @file
+ * @brief Write-ahead log for a glass database
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "glass_wal.h"
+
+#include "debuglog.h"
+#include "fd.h"
+#include "io_utils.h"
+#include "omassert.h"
+#include "posixy_wrapper.h"
+#include "wordaccess.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include "safesysstat.h"
+#include "safefcntl.h"
+#include "safeunistd.h"
+
+#include <zlib.h>
+
+#include "xapian/constants.h"
+#include "xapian/error.h"
+
+using namespace std;
+
+#define WAL_MAGIC "xglwal01"
+
+/// Size of the header at the start of the log.
+static const size_t HEADER_SIZE = 28;
+
+/// Size of the header at the start of each record.
+static const size_t RECORD_HEADER_SIZE = 12;
+
+/// Calculate the CRC-32 of @a len bytes at @a p.
+static uint32_t
+calc_crc(const char* p, size_t len)
+{
+    uLong crc = crc32(0L, Z_NULL, 0);
+    while (len) {
+	// crc32() takes the length as a uInt.
+	uInt n = uInt(min(len, size_t(1) << 30));
+	crc = crc32(crc, reinterpret_cast<const Bytef*>(p), n);
+	p += n;
+	len -= n;
+    }
+    return uint32_t(crc);
+}
+
+/// Build the log header for @a uuid and @a rev.
+static string
+make_header(const char* uuid, glass_revision_number_t rev)
+{
+    string header(HEADER_SIZE, '\0');
+    auto u = reinterpret_cast<unsigned char*>(&header[0]);
+    memcpy(u, WAL_MAGIC, 8);
+    memcpy(u + 8, uuid, 16);
+    unaligned_write4(u + 24, rev);
+    return header;
+}
+
+void
+GlassWAL::close_fd()
+{
+    if (fd >= 0) {
+	(void)::close(fd);
+	fd = -1;
+    }
+}
+
+void
+GlassWAL::read_records(const string& buf, string& mods)
+{
+    size_t pos = 0;
+    while (buf.size() - pos >= RECORD_HEADER_SIZE) {
+	auto u = reinterpret_cast<const unsigned char*>(buf.data() + pos);
+	auto len = do_unaligned_read<uint64_t>(u);
+	uint32_t crc = unaligned_read4(u + 8);
+	if (len > buf.size() - pos - RECORD_HEADER_SIZE) break;
+	const char* p = buf.data() + pos + RECORD_HEADER_SIZE;
+	if (calc_crc(p, len) != crc) break;
+	mods.append(p, len);
+	last_record = size + off_t(pos);
+	last_record_header.assign(buf, pos, RECORD_HEADER_SIZE);
+	pos += RECORD_HEADER_SIZE + len;
+    }
+    size += off_t(pos);
+}
+
+void
+GlassWAL::read(const char* uuid, glass_revision_number_t rev, string& mods,
+	       bool readonly)
+{
+    LOGCALL_VOID(DB, "GlassWAL::read", rev | Literal("[mods]") | readonly);
+    close_fd();
+    size = 0;
+    last_record = 0;
+    mods.clear();
+
+    string buf;
+    {
+	FD fd_in(posixy_open(path.c_str(), O_RDONLY | O_BINARY | O_CLOEXEC));
+	if (fd_in < 0) {
+	    if (errno == ENOENT) return;
+	    throw Xapian::DatabaseOpeningError("Couldn't open " + path, errno);
+	}
+	struct stat statbuf;
+	if (fstat(fd_in, &statbuf) < 0) {
+	    throw Xapian::DatabaseOpeningError("Couldn't stat " + path, errno);
+	}
+	buf.resize(size_t(statbuf.st_size));
+	buf.resize(io_read(fd_in, &buf[0], buf.size()));
+    }
+
+    if (buf.size() < HEADER_SIZE ||
+	buf.compare(0, HEADER_SIZE, make_header(uuid, rev)) != 0) {
+	// The log is from before the last checkpoint (or is incomplete, in
+	// which case nothing was committed to it).
+	if (!readonly) (void)unlink(path.c_str());
+	return;
+    }
+
+    buf.erase(0, HEADER_SIZE);
+    size = HEADER_SIZE;
+    read_records(buf, mods);
+    if (last_record == 0) {
+	size = 0;
+	if (!readonly) (void)unlink(path.c_str());
+	return;
+    }
+    // Anything after size is discarded by the next append().
+}
+
+bool
+GlassWAL::read_more(const char* uuid, glass_revision_number_t rev,
+		    string& mods)
+{
+    LOGCALL(DB, bool, "GlassWAL::read_more", rev | Literal("[mods]"));
+    mods.clear();
+    if (size == 0) RETURN(false);
+
+    FD fd_in(posixy_open(path.c_str(), O_RDONLY | O_BINARY | O_CLOEXEC));
+    if (fd_in < 0) RETURN(false);
+    struct stat statbuf;
+    if (fstat(fd_in, &statbuf) < 0 || statbuf.st_size < size) RETURN(false);
+
+    // A checkpoint starts a new log for a new revision.  A commit which
+    // failed after writing its record gets overwritten by the next one,
+    // and that can only be the last record we read.
+    string buf(HEADER_SIZE, '\0');
+    if (io_pread(fd_in, &buf[0], HEADER_SIZE, 0) != HEADER_SIZE ||
+	buf != make_header(uuid, rev)) {
+	RETURN(false);
+    }
+    buf.resize(RECORD_HEADER_SIZE);
+    if (io_pread(fd_in, &buf[0], RECORD_HEADER_SIZE, last_record) !=
+	    RECORD_HEADER_SIZE ||
+	buf != last_record_header) {
+	RETURN(false);
+    }
+
+    buf.resize(size_t(statbuf.st_size - size));
+    buf.resize(io_pread(fd_in, &buf[0], buf.size(), size));
+    read_records(buf, mods);
+    RETURN(true);
+}
+
+void
+GlassWAL::append(const string& mods,
+		 const char* uuid, glass_revision_number_t rev, int flags)
+{
+    LOGCALL_VOID(DB, "GlassWAL::append", Literal("[mods]") | rev | flags);
+    string buf;
+    if (size == 0) buf = make_header(uuid, rev);
+    unsigned char record_header[RECORD_HEADER_SIZE];
+    do_unaligned_write<uint64_t, uint64_t>(record_header, mods.size());
+    unaligned_write4(record_header + 8, calc_crc(mods.data(), mods.size()));
+    buf.append(reinterpret_cast<const char*>(record_header),
+	       RECORD_HEADER_SIZE);
+    buf += mods;
+
+    try {
+	if (fd < 0) {
+	    fd = posixy_open(path.c_str(),
+			     O_WRONLY | O_CREAT | O_BINARY | O_CLOEXEC, 0666);
+	    if (fd < 0) {
+		throw Xapian::DatabaseError("Couldn't open " + path, errno);
+	    }
+	    // Discard anything after the valid part of the log.
+	    if (ftruncate(fd, size) < 0 || lseek(fd, size, SEEK_SET) < 0) {
+		throw Xapian::DatabaseError("Couldn't truncate " + path, errno);
+	    }
+	}
+	io_write(fd, buf.data(), buf.size());
+	if ((flags & Xapian::DB_NO_SYNC) == 0 &&
+	    ((flags & Xapian::DB_FULL_SYNC) ?
+	      !io_full_sync(fd) :
+	      !io_sync(fd))) {
+	    throw Xapian::DatabaseError("Couldn't sync " + path, errno);
+	}
+    } catch (...) {
+	// The next append() reopens the log and truncates it, so a partial
+	// record doesn't get left before the records after it.
+	close_fd();
+	throw;
+    }
+    size += off_t(buf.size());
+    last_record = size - off_t(RECORD_HEADER_SIZE + mods.size());
+    last_record_header.assign(reinterpret_cast<const char*>(record_header),
+			      RECORD_HEADER_SIZE);
+}
+
+void
+GlassWAL::rebase(const char* uuid, glass_revision_number_t rev, int flags)
+{
+    LOGCALL_VOID(DB, "GlassWAL::rebase", rev | flags);
+    if (size == 0) return;
+    close_fd();
+
+    string buf(size_t(size), '\0');
+    {
+	FD fd_in(posixy_open(path.c_str(), O_RDONLY | O_BINARY | O_CLOEXEC));
+	if (fd_in < 0) {
+	    throw Xapian::DatabaseError("Couldn't open " + path, errno);
+	}
+	(void)io_read(fd_in, &buf[0], buf.size(), buf.size());
+    }
+    buf.replace(0, HEADER_SIZE, make_header(uuid, rev));
+
+    string tmpfile = path + ".tmp";
+    FD fd_out(posixy_open(tmpfile.c_str(),
+			  O_WRONLY | O_CREAT | O_TRUNC | O_BINARY | O_CLOEXEC,
+			  0666));
+    if (fd_out < 0) {
+	throw Xapian::DatabaseError("Couldn't create " + tmpfile, errno);
+    }
+    try {
+	io_write(fd_out, buf.data(), buf.size());
+	if (!(flags & Xapian::DB_NO_SYNC) && !io_sync(fd_out)) {
+	    throw Xapian::DatabaseError("Couldn't sync " + tmpfile, errno);
+	}
+	if (fd_out.close() < 0) {
+	    throw Xapian::DatabaseError("Couldn't close " + tmpfile, errno);
+	}
+    } catch (...) {
+	(void)unlink(tmpfile.c_str());
+	throw;
+    }
+    if (!io_tmp_rename(tmpfile, path)) {
+	throw Xapian::DatabaseError("Couldn't update " + path, errno);
+    }
+}
+
+void
+GlassWAL::remove()
+{
+    LOGCALL_VOID(DB, "GlassWAL::remove", NO_ARGS);
+    close_fd();
+    size = 0;
+    last_record = 0;
+    // If this fails the log is ignored anyway as it's for an old revision.
+    (void)unlink(path.c_str());
+}
+
+off_t
+GlassWAL::file_size(const string& db_dir)
+{
+    struct stat statbuf;
+    string path = db_dir + "/wal";
+    if (stat(path.c_str(), &statbuf) < 0) return 0;
+    return statbuf.st_size;
+}
@@ -0,0 +1,182 @@
+/** @file
+ * @brief Write-ahead log for a glass database
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_GLASS_WAL_H
+#define XAPIAN_INCLUDED_GLASS_WAL_H
+
+#include "glass_defs.h"
+
+#include <string>
+#include <sys/types.h>
+
+namespace Glass {
+
+/** Types of modification recorded in the write-ahead log.
+ *
+ *  Each modification is a byte giving its type followed by its arguments.
+ */
+enum wal_mod_type {
+    /// Docid (pack_uint) and serialised document (pack_string).
+    WAL_REPLACE_DOCUMENT,
+    /// Docid (pack_uint).
+    WAL_DELETE_DOCUMENT,
+    /// Key and value (pack_string).
+    WAL_SET_METADATA,
+    /// Word (pack_string) and frequency increment (pack_uint).
+    WAL_ADD_SPELLING,
+    /// Word (pack_string) and frequency decrement (pack_uint).
+    WAL_REMOVE_SPELLING,
+    /// Term and synonym (pack_string).
+    WAL_ADD_SYNONYM,
+    /// Term and synonym (pack_string).
+    WAL_REMOVE_SYNONYM,
+    /// Term (pack_string).
+    WAL_CLEAR_SYNONYMS
+};
+
+}
+
+/** Write-ahead log of the changes committed since a revision.
+ *
+ *  When a glass WritableDatabase is opened with Xapian::DB_WRITE_AHEAD_LOG,
+ *  committing appends the modifications made since the previous commit to
+ *  the file "wal" in the database directory and syncs it, instead of
+ *  writing a new revision of the tables.  The modifications are written to
+ *  the tables (as a new revision) at a checkpoint, after which the log is
+ *  removed.  When the database is next opened for writing, the
+ *  modifications in the log are applied again.  Readers replay the log in
+ *  memory (see GlassDatabase::wal_overlay).
+ *
+ *  The file starts with a 28 byte header:
+ *
+ *	8 byte magic string "xglwal01"
+ *	16 byte database UUID
+ *	4 byte revision the log applies to
+ *
+ *  followed by a record for each commit:
+ *
+ *	8 byte length of the modifications
+ *	4 byte CRC-32 of the modifications
+ *	the modifications
+ *
+ *  A log for a different UUID or revision was left by a checkpoint which
+ *  didn't get as far as removing it, so is ignored.  A record which is
+ *  incomplete or fails its CRC check is from a commit which didn't finish,
+ *  so it and anything after it are ignored.
+ */
+class GlassWAL {
+    /// Path of the log file.
+    std::string path;
+
+    /// File descriptor to append to the log (or -1 if not open).
+    int fd = -1;
+
+    /// Size of the valid part of the log (0 if there's no log).
+    off_t size = 0;
+
+    /// Offset of the last valid record read (0 if none).
+    off_t last_record = 0;
+
+    /// The header of the last valid record read.
+    std::string last_record_header;
+
+    /// Close fd if it's open.
+    void close_fd();
+
+    /** Append the modifications from the valid records in @a buf to @a mods.
+     *
+     *  @param buf	Data read from the log, starting at the end of the
+     *			valid part we've already read, @a size.
+     *
+     *  @a size, @a last_record and @a last_record_header are updated.
+     */
+    void read_records(const std::string& buf, std::string& mods);
+
+  public:
+    explicit GlassWAL(const std::string& db_dir) : path(db_dir + "/wal") { }
+
+    ~GlassWAL() { close_fd(); }
+
+    /** Read the modifications committed to the log.
+     *
+     *  If there's no log for @a uuid and @a rev, any log file is removed
+     *  (unless @a readonly is true).
+     *
+     *  @param uuid	The database's UUID (16 bytes).
+     *  @param rev	The revision of the database which is open.
+     *  @param[out] mods	The modifications from each commit, concatenated.
+     *  @param readonly	Leave the log file alone - used when replaying the
+     *			log for a reader, which doesn't hold the write lock.
+     */
+    void read(const char* uuid, glass_revision_number_t rev,
+	      std::string& mods, bool readonly = false);
+
+    /** Read the modifications committed to the log since read() or
+     *  read_more() was last called.
+     *
+     *  This is used to bring a reader's replay of the log up to date, so
+     *  leaves the log file alone.
+     *
+     *  @param uuid	The database's UUID (16 bytes).
+     *  @param rev	The revision of the database which is open.
+     *  @param[out] mods	The modifications from each new commit,
+     *			concatenated.
+     *
+     *  @return false if the log isn't the one previously read (e.g. there's
+     *		been a checkpoint) - then the whole log needs to be read
+     *		again.
+     */
+    bool read_more(const char* uuid, glass_revision_number_t rev,
+		   std::string& mods);
+
+    /** Append the modifications from a commit to the log and sync it.
+     *
+     *  @param mods	The modifications.
+     *  @param uuid	The database's UUID (16 bytes).
+     *  @param rev	The revision of the database which is open.
+     *  @param flags	The flags the database was opened with.
+     */
+    void append(const std::string& mods,
+		const char* uuid, glass_revision_number_t rev, int flags);
+
+    /** Make the log apply to a new revision.
+     *
+     *  Used if the tables have been given a new revision number without
+     *  their contents changing.
+     */
+    void rebase(const char* uuid, glass_revision_number_t rev, int flags);
+
+    /// Is there a log?
+    bool exists() const { return size != 0; }
+
+    /// Return the size of the valid part of the log.
+    off_t get_size() const { return size; }
+
+    /// Remove the log.
+    void remove();
+
+    /** Return the size of the log file for the database in @a db_dir.
+     *
+     *  Returns 0 if there's no log file.  Commits only append to the log,
+     *  so readers use this to check if there's anything new to replay.
+     */
+    static off_t file_size(const std::string& db_dir);
+};
+
+#endif // XAPIAN_INCLUDED_GLASS_WAL_H
@@ -5,11 +5,13 @@ if BUILD_BACKEND_HONEY
 noinst_HEADERS +=\
 	backends/honey/honey_alldocspostlist.h\
 	backends/honey/honey_alltermslist.h\
+	backends/honey/honey_bloom.h\
 	backends/honey/honey_check.h\
 	backends/honey/honey_cursor.h\
 	backends/honey/honey_database.h\
 	backends/honey/honey_dbcheck.h\
 	backends/honey/honey_defs.h\
+	backends/honey/honey_deletions.h\
 	backends/honey/honey_docdata.h\
 	backends/honey/honey_document.h\
 	backends/honey/honey_freelist.h\
@@ -17,9 +19,13 @@ noinst_HEADERS +=\
 	backends/honey/honey_lazytable.h\
 	backends/honey/honey_metadata.h\
 	backends/honey/honey_positionlist.h\
+	backends/honey/honey_postingblock.h\
 	backends/honey/honey_postlist.h\
 	backends/honey/honey_postlist_encodings.h\
 	backends/honey/honey_postlisttable.h\
+	backends/honey/honey_segmented.h\
+	backends/honey/honey_segmentedpostlist.h\
+	backends/honey/honey_segmentedvaluelist.h\
 	backends/honey/honey_spelling.h\
 	backends/honey/honey_spellingwordslist.h\
 	backends/honey/honey_synonym.h\
@@ -33,18 +39,24 @@ noinst_HEADERS +=\
 lib_src +=\
 	backends/honey/honey_alldocspostlist.cc\
 	backends/honey/honey_alltermslist.cc\
+	backends/honey/honey_bloom.cc\
 	backends/honey/honey_check.cc\
 	backends/honey/honey_compact.cc\
 	backends/honey/honey_cursor.cc\
 	backends/honey/honey_database.cc\
 	backends/honey/honey_dbcheck.cc\
+	backends/honey/honey_deletions.cc\
 	backends/honey/honey_document.cc\
 	backends/honey/honey_freelist.cc\
 	backends/honey/honey_inverter.cc\
 	backends/honey/honey_metadata.cc\
 	backends/honey/honey_positionlist.cc\
+	backends/honey/honey_postingblock.cc\
 	backends/honey/honey_postlist.cc\
 	backends/honey/honey_postlisttable.cc\
+	backends/honey/honey_segmented.cc\
+	backends/honey/honey_segmentedpostlist.cc\
+	backends/honey/honey_segmentedvaluelist.cc\
 	backends/honey/honey_spelling.cc\
 	backends/honey/honey_spellingwordslist.cc\
 	backends/honey/honey_synonym.cc\
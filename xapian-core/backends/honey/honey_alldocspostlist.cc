@@ -41,6 +41,8 @@ HoneyAllDocsPostList::HoneyAllDocsPostList(const HoneyDatabase* db,
       doccount(doccount_)
 {
     LOGCALL_CTOR(DB, "HoneyAllDocsPostList", db | doccount_);
+    if (rare(!db->get_deletions().empty()))
+	deletions = &db->get_deletions();
     static const char doclen_key_prefix[2] = {
 	0, char(Honey::KEY_DOCLEN_CHUNK)
     };
@@ -86,39 +88,38 @@ HoneyAllDocsPostList::at_end() const
     return cursor == NULL;
 }
 
-PostList*
-HoneyAllDocsPostList::next(double)
+void
+HoneyAllDocsPostList::move_next()
 {
     Assert(cursor);
     if (!reader.at_end()) {
-	if (reader.next()) return NULL;
+	if (reader.next()) return;
 	cursor->next();
     }
 
     if (!cursor->after_end()) {
 	if (reader.update(cursor)) {
-	    if (!reader.at_end()) return NULL;
+	    if (!reader.at_end()) return;
 	}
     }
 
     // We've reached the end.
     delete cursor;
     cursor = NULL;
-    return NULL;
 }
 
-PostList*
-HoneyAllDocsPostList::skip_to(Xapian::docid did, double)
+void
+HoneyAllDocsPostList::move_to(Xapian::docid did)
 {
     if (rare(!cursor)) {
 	// No-op if already at_end.
-	return NULL;
+	return;
     }
 
     Assert(!reader.at_end());
 
     if (reader.skip_to(did))
-	return NULL;
+	return;
 
     if (cursor->find_entry_ge(make_doclenchunk_key(did))) {
 	// Exact match.
@@ -126,12 +127,12 @@ HoneyAllDocsPostList::skip_to(Xapian::docid did, double)
 	    // Shouldn't be possible.
 	    Assert(false);
 	}
-	if (reader.skip_to(did)) return NULL;
+	if (reader.skip_to(did)) return;
 	// The chunk's last docid is did, so skip_to() should always succeed.
 	Assert(false);
     } else if (!cursor->after_end()) {
 	if (reader.update(cursor)) {
-	    if (reader.skip_to(did)) return NULL;
+	    if (reader.skip_to(did)) return;
 	    // The chunk's last docid is >= did, so skip_to() should always
 	    // succeed.
 	    Assert(false);
@@ -141,12 +142,33 @@ HoneyAllDocsPostList::skip_to(Xapian::docid did, double)
     // We've reached the end.
     delete cursor;
     cursor = NULL;
+}
+
+PostList*
+HoneyAllDocsPostList::next(double)
+{
+    move_next();
+    skip_deleted();
     return NULL;
 }
 
 PostList*
-HoneyAllDocsPostList::check(Xapian::docid did, double, bool& valid)
+HoneyAllDocsPostList::skip_to(Xapian::docid did, double)
 {
+    move_to(did);
+    skip_deleted();
+    return NULL;
+}
+
+PostList*
+HoneyAllDocsPostList::check(Xapian::docid did, double w_min, bool& valid)
+{
+    if (rare(deletions)) {
+	// The checks below would find a deleted document.
+	valid = true;
+	return HoneyAllDocsPostList::skip_to(did, w_min);
+    }
+
     if (rare(!cursor)) {
 	// Already at_end.
 	valid = true;
@@ -233,13 +255,12 @@ DocLenChunkReader::update(HoneyCursor* cursor)
     Xapian::docid last_did = docid_from_key(cursor->current_key);
     if (!last_did) return false;
 
-    cursor->read_tag();
-
-    size_t len = cursor->current_tag.size();
+    size_t len;
+    const char* tag = cursor->read_tag_view(len);
     if (rare(len == 0))
 	throw Xapian::DatabaseCorruptError("Doclen data chunk is empty");
 
-    p = reinterpret_cast<const unsigned char*>(cursor->current_tag.data());
+    p = reinterpret_cast<const unsigned char*>(tag);
     end = p + len;
     width = *p++;
     if (((width - 8) &~ 0x18) != 0) {
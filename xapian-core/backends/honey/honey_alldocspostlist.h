@@ -28,6 +28,7 @@
 
 #include "backends/leafpostlist.h"
 #include "honey_defs.h"
+#include "honey_deletions.h"
 #include "pack.h"
 #include "wordaccess.h"
 
@@ -149,6 +150,23 @@ class HoneyAllDocsPostList : public LeafPostList {
     /// The number of documents in the database.
     Xapian::doccount doccount;
 
+    /// Documents deleted from the database, or NULL if there aren't any.
+    const HoneyDeletions* deletions = NULL;
+
+    /// Advance to the next entry, including deleted documents.
+    void move_next();
+
+    /// Skip to @a did or the entry after, including deleted documents.
+    void move_to(Xapian::docid did);
+
+    /// Advance past any deleted documents.
+    void skip_deleted() {
+	if (rare(deletions)) {
+	    while (cursor && deletions->contains(reader.get_docid()))
+		move_next();
+	}
+    }
+
   public:
     HoneyAllDocsPostList(const HoneyDatabase* db_, Xapian::doccount doccount_);
 
@@ -40,11 +40,18 @@ HoneyAllTermsList::read_termfreq() const
     LOGCALL_VOID(DB, "HoneyAllTermsList::read_termfreq", NO_ARGS);
     Assert(!at_end());
 
+    if (rare(!database->get_deletions().empty())) {
+	// The postings of deleted documents remain until the segment is
+	// merged, so the stored termfreq may be too high.
+	database->HoneyDatabase::get_freqs(current_term, &termfreq, NULL);
+	return;
+    }
+
     // Unpack the termfreq from the tag.
     Xapian::termcount collfreq;
-    cursor->read_tag();
-    const char* p = cursor->current_tag.data();
-    const char* pend = p + cursor->current_tag.size();
+    size_t len;
+    const char* p = cursor->read_tag_view(len);
+    const char* pend = p + len;
     if (!decode_initial_chunk_header_freqs(&p, pend,
 					   termfreq, collfreq)) {
 	throw Xapian::DatabaseCorruptError("Postlist initial chunk header not "
@@ -86,10 +93,10 @@ HoneyAllTermsList::get_termfreq() const
     RETURN(termfreq);
 }
 
-TermList*
-HoneyAllTermsList::next()
+void
+HoneyAllTermsList::next_term()
 {
-    LOGCALL(DB, TermList*, "HoneyAllTermsList::next", NO_ARGS);
+    LOGCALL_VOID(DB, "HoneyAllTermsList::next_term", NO_ARGS);
     // Set termfreq to 0 to indicate no termfreq has been read for the current
     // term.
     termfreq = 0;
@@ -107,14 +114,14 @@ HoneyAllTermsList::next()
 		// The exact term we asked for is there, so just copy it rather
 		// than wasting effort unpacking it from the key.
 		current_term = prefix;
-		RETURN(NULL);
+		return;
 	    }
 	}
 	if (cursor->after_end()) {
 	    delete cursor;
 	    cursor = NULL;
 	    database = NULL;
-	    RETURN(NULL);
+	    return;
 	}
 	goto first_time;
     }
@@ -124,7 +131,7 @@ HoneyAllTermsList::next()
 	    delete cursor;
 	    cursor = NULL;
 	    database = NULL;
-	    RETURN(NULL);
+	    return;
 	}
 
 first_time:
@@ -147,7 +154,23 @@ first_time:
 	cursor = NULL;
 	database = NULL;
     }
+}
 
+bool
+HoneyAllTermsList::only_deleted() const
+{
+    if (!cursor || database->get_deletions().empty()) return false;
+    read_termfreq();
+    return termfreq == 0;
+}
+
+TermList*
+HoneyAllTermsList::next()
+{
+    LOGCALL(DB, TermList*, "HoneyAllTermsList::next", NO_ARGS);
+    do {
+	next_term();
+    } while (rare(only_deleted()));
     RETURN(NULL);
 }
 
@@ -204,6 +227,10 @@ HoneyAllTermsList::skip_to(const string& term)
 	database = NULL;
     }
 
+    if (rare(only_deleted())) {
+	RETURN(next());
+    }
+
     RETURN(NULL);
 }
 
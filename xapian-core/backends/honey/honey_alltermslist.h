@@ -71,6 +71,12 @@ class HoneyAllTermsList : public AllTermsList {
     /// Read and cache the term frequency.
     void read_termfreq() const;
 
+    /// Advance to the next term, including terms of deleted documents.
+    void next_term();
+
+    /// Does the current term only index deleted documents?
+    bool only_deleted() const;
+
   public:
     HoneyAllTermsList(const HoneyDatabase* database_,
 		      const std::string& prefix_)
@@ -0,0 +1,108 @@
+/** @file
+ * @brief Bloom filter over the keys in a honey table
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "honey_bloom.h"
+
+#include "omassert.h"
+#include "pack.h"
+
+using namespace std;
+
+uint64_t
+HoneyBloomFilter::hash(const char* p, size_t len)
+{
+    // FNV-1a, followed by the MurmurHash3 finaliser so that all the bits of
+    // the result depend on all the bytes of the key.
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i != len; ++i) {
+	h ^= static_cast<unsigned char>(p[i]);
+	h *= 0x100000001b3ull;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+/** Remix hash @a h to pick the bits to set within its block.
+ *
+ *  Each probe uses the next 9 bits of the result to pick one of the 512 bits
+ *  in the block.  The block is chosen by the high bits of @a h, while these
+ *  mostly come from its low bits.
+ */
+static inline uint64_t
+probe_bits(uint64_t h)
+{
+    return h * 0x9e3779b97f4a7c15ull;
+}
+
+void
+HoneyBloomFilter::build(const vector<uint64_t>& hashes, unsigned bits_per_key)
+{
+    uint64_t bits = uint64_t(hashes.size()) * bits_per_key;
+    num_blocks = (bits + BLOCK_SIZE * 8 - 1) / (BLOCK_SIZE * 8);
+    if (num_blocks == 0) num_blocks = 1;
+    data.assign(blocks_size(num_blocks), '\0');
+    for (uint64_t h : hashes) {
+	unsigned char* block =
+	    reinterpret_cast<unsigned char*>(&data[block_offset(h)]);
+	uint64_t g = probe_bits(h);
+	for (int i = 0; i != PROBES; ++i) {
+	    unsigned bit = g & 511;
+	    block[bit >> 3] |= 1 << (bit & 7);
+	    g >>= 9;
+	}
+    }
+}
+
+void
+HoneyBloomFilter::serialise(string& out) const
+{
+    pack_uint(out, num_blocks);
+    out += data;
+}
+
+void
+HoneyBloomFilter::assign(uint64_t num_blocks_, string&& blocks)
+{
+    AssertEq(blocks.size(), blocks_size(num_blocks_));
+    num_blocks = num_blocks_;
+    data = std::move(blocks);
+}
+
+bool
+HoneyBloomFilter::may_contain(const string& key) const
+{
+    if (num_blocks == 0) return true;
+    uint64_t h = hash(key);
+    const unsigned char* block =
+	reinterpret_cast<const unsigned char*>(data.data() + block_offset(h));
+    uint64_t g = probe_bits(h);
+    for (int i = 0; i != PROBES; ++i) {
+	unsigned bit = g & 511;
+	if (!(block[bit >> 3] & (1 << (bit & 7))))
+	    return false;
+	g >>= 9;
+    }
+    return true;
+}
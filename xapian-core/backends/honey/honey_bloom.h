@@ -0,0 +1,99 @@
+/** @file
+ * @brief Bloom filter over the keys in a honey table
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_HONEY_BLOOM_H
+#define XAPIAN_INCLUDED_HONEY_BLOOM_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/** Bloom filter over the keys in a honey table.
+ *
+ *  This lets lookups of keys which aren't in the table (e.g. terms which
+ *  don't index any documents) usually return without reading the table.
+ *
+ *  The filter is a "blocked" Bloom filter - the bits are split into 512 bit
+ *  blocks and all the bits for a key are in the same block, so each lookup
+ *  only touches one cache line.  It is serialised as I<number of blocks>
+ *  followed by the blocks.
+ */
+class HoneyBloomFilter {
+    /// Size of each block in bytes.
+    enum { BLOCK_SIZE = 64 };
+
+    /// Number of bits set in the block for each key.
+    enum { PROBES = 7 };
+
+    /// The blocks of the filter.
+    std::string data;
+
+    /// The number of blocks.
+    std::uint64_t num_blocks = 0;
+
+    /// Return the offset of the block in data to use for @a h.
+    std::size_t block_offset(std::uint64_t h) const {
+	// Map the high 32 bits of h onto [0, num_blocks) without a division.
+	return std::size_t(((h >> 32) * num_blocks) >> 32) * BLOCK_SIZE;
+    }
+
+  public:
+    /** Hash a key.
+     *
+     *  This is part of the on-disk format, so mustn't be changed.
+     */
+    static std::uint64_t hash(const char* p, std::size_t len);
+
+    static std::uint64_t hash(const std::string& key) {
+	return hash(key.data(), key.size());
+    }
+
+    /** Build a filter.
+     *
+     *  @param hashes		The hashes of the keys to add.
+     *  @param bits_per_key	The number of bits to use for each key (10
+     *				gives a false positive rate of about 1%).
+     */
+    void build(const std::vector<std::uint64_t>& hashes,
+	       unsigned bits_per_key);
+
+    /// Append the serialised filter to @a out.
+    void serialise(std::string& out) const;
+
+    /// Return the size of the filter in bytes.
+    std::size_t size() const { return data.size(); }
+
+    /** Set the filter from its serialised form.
+     *
+     *  @param num_blocks_	The number of blocks.
+     *  @param blocks		The blocks (num_blocks_ * 64 bytes).
+     */
+    void assign(std::uint64_t num_blocks_, std::string&& blocks);
+
+    /// Return the size in bytes of @a n blocks.
+    static std::uint64_t blocks_size(std::uint64_t n) { return n * BLOCK_SIZE; }
+
+    /** Check if a key might be present.
+     *
+     *  @return false if @a key is definitely not present.
+     */
+    bool may_contain(const std::string& key) const;
+};
+
+#endif // XAPIAN_INCLUDED_HONEY_BLOOM_H
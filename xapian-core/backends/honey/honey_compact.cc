@@ -27,18 +27,23 @@
 #include "xapian/types.h"
 
 #include <algorithm>
+#include <functional>
+#include <map>
 #include <memory>
 #include <queue>
 #include <type_traits>
 
 #include <cerrno>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 #include "backends/flint_lock.h"
 #include "compression_stream.h"
 #include "honey_cursor.h"
 #include "honey_database.h"
 #include "honey_defs.h"
+#include "honey_postingblock.h"
 #include "honey_postlist_encodings.h"
 #include "honey_table.h"
 #include "honey_values.h"
@@ -46,7 +51,9 @@
 #include "filetests.h"
 #include "internaltypes.h"
 #include "pack.h"
+#include "parseint.h"
 #include "backends/valuestats.h"
+#include "stringutils.h"
 #include "wordaccess.h"
 
 #include "../byte_length_strings.h"
@@ -54,6 +61,7 @@
 
 #ifdef XAPIAN_HAS_GLASS_BACKEND
 # include "../glass/glass_database.h"
+# include "../glass/glass_postlist.h"
 # include "../glass/glass_table.h"
 # include "../glass/glass_values.h"
 #endif
@@ -155,6 +163,179 @@ template<>
 class PostlistCursor<const GlassTable&> : private GlassCursor {
     Xapian::docid offset;
 
+    /** Glass doclen data left after splitting a chunk at a large gap.
+     *
+     *  This starts with a document length, rather than a gap.
+     */
+    string doclen_rest;
+
+    /// The docid of the first entry in @a doclen_rest.
+    Xapian::docid doclen_rest_firstdid = 0;
+
+    /** Value stats tags which still need to be returned, by slot.
+     *
+     *  Glass encodes the slot in value stats keys with pack_uint_last(),
+     *  which doesn't sort the same way as the slot numbers, so we read all
+     *  the value stats (there's one entry per slot used) and return them in
+     *  slot order.
+     */
+    map<Xapian::valueno, string> pending_valuestats;
+
+    /** Slots whose value chunks still need to be returned.
+     *
+     *  In descending order, so the next slot is at the back.
+     */
+    vector<Xapian::valueno> valuechunk_slots;
+
+    /** Key prefix for the value chunks of the slot we're currently in.
+     *
+     *  Empty if we're not in the value chunks.
+     */
+    string valuechunk_prefix;
+
+    /** Read all the value stats, starting from the current entry.
+     *
+     *  The cursor is left on the last value stats entry.
+     */
+    void read_valuestats() {
+	do {
+	    const char* p = current_key.data();
+	    const char* end = p + current_key.size();
+	    p += 2;
+	    Xapian::valueno slot;
+	    if (!unpack_uint_last(&p, end, &slot))
+		throw Xapian::DatabaseCorruptError("bad value stats key");
+	    read_tag();
+	    pending_valuestats[slot] = current_tag;
+	} while (GlassCursor::next() &&
+		 GlassCompact::is_valuestats_key(current_key));
+	find_entry_lt(string("\0\xd1", 2));
+    }
+
+    /** Find the slots which have value chunks.
+     *
+     *  Glass encodes the slot in value chunk keys with pack_uint(), which
+     *  doesn't sort the same way as the slot numbers, so we find all the
+     *  slots used (seeking past the chunks for each) and then return the
+     *  chunks for one slot at a time in slot order.  Buffering up the
+     *  chunks themselves could be prohibitively costly.
+     *
+     *  The cursor must be on the first value chunk entry.  It's left on the
+     *  first value chunk entry for the lowest slot.
+     */
+    void find_valuechunk_slots() {
+	do {
+	    const char* p = current_key.data();
+	    const char* end = p + current_key.size();
+	    p += 2;
+	    Xapian::valueno slot;
+	    if (!unpack_uint(&p, end, &slot))
+		throw Xapian::DatabaseCorruptError("bad value key");
+	    valuechunk_slots.push_back(slot);
+	    // The last byte pack_uint() produces is < 0x80, so incrementing
+	    // it gives a key which sorts after all the chunks for this slot
+	    // and before those for any other slot.
+	    string next_slot_key(current_key, 0, p - current_key.data());
+	    ++next_slot_key.back();
+	    find_entry_ge(next_slot_key);
+	} while (!after_end() && GlassCompact::is_valuechunk_key(current_key));
+	sort(valuechunk_slots.begin(), valuechunk_slots.end(),
+	     greater<Xapian::valueno>());
+	next_valuechunk_slot();
+    }
+
+    /** Move to the first value chunk for the next slot.
+     *
+     *  If there are no more slots, move to the first entry after the value
+     *  chunks.
+     *
+     *  @return false if that leaves the cursor after the end.
+     */
+    bool next_valuechunk_slot() {
+	if (valuechunk_slots.empty()) {
+	    valuechunk_prefix.clear();
+	    find_entry_ge(string("\0\xd9", 2));
+	} else {
+	    valuechunk_prefix.assign("\0\xd8", 2);
+	    pack_uint(valuechunk_prefix, valuechunk_slots.back());
+	    valuechunk_slots.pop_back();
+	    find_entry_ge(valuechunk_prefix);
+	}
+	return !after_end();
+    }
+
+    /** Convert glass doclen data to a honey doclen chunk in @a tag.
+     *
+     *  Honey doclen chunks store an entry for every docid, so if there's a
+     *  large gap we end the chunk there and leave the rest of the data in
+     *  @a doclen_rest.
+     */
+    void convert_doclens(const char* d, const char* e) {
+	string newtag;
+	Xapian::termcount doclen_max = 0;
+	while (true) {
+	    Xapian::termcount doclen;
+	    if (!unpack_uint(&d, e, &doclen))
+		throw Xapian::DatabaseCorruptError("Decoding doclen in "
+						   "glass docdata chunk");
+	    if (doclen > doclen_max)
+		doclen_max = doclen;
+	    unsigned char buf[4];
+	    unaligned_write4(buf, doclen);
+	    newtag.append(reinterpret_cast<char*>(buf), 4);
+	    if (d == e)
+		break;
+	    Xapian::docid gap_size;
+	    if (!unpack_uint(&d, e, &gap_size))
+		throw Xapian::DatabaseCorruptError("Decoding docid "
+						   "gap_size in glass "
+						   "docdata chunk");
+	    if (gap_size > HONEY_DOCLEN_CHUNK_MAX) {
+		// Split the chunk rather than padding it out.
+		doclen_rest.assign(d, e - d);
+		doclen_rest_firstdid = firstdid + newtag.size() / 4 + gap_size;
+		break;
+	    }
+	    newtag.append(4 * gap_size, '\xff');
+	}
+
+	Assert(!startswith(newtag, "\xff\xff\xff\xff"));
+	Assert(!endswith(newtag, "\xff\xff\xff\xff"));
+
+	AssertEq(newtag.size() % 4, 0);
+	chunk_lastdid = firstdid - 1 + newtag.size() / 4;
+
+	// Only encode document lengths using a whole number of bytes for
+	// now.  We could allow arbitrary bit widths, but it complicates
+	// encoding and decoding so we should consider if the fairly small
+	// additional saving is worth it.
+	if (doclen_max >= 0xffff) {
+	    if (doclen_max >= 0xffffff) {
+		newtag.insert(0, 1, char(32));
+		swap(tag, newtag);
+	    } else if (doclen_max >= 0xffffffff) {
+		// FIXME: Handle these.
+		const char* m = "Document length values >= 0xffffffff not "
+				"currently handled";
+		throw Xapian::FeatureUnavailableError(m);
+	    } else {
+		tag.assign(1, char(24));
+		for (size_t i = 1; i < newtag.size(); i += 4)
+		    tag.append(newtag, i, 3);
+	    }
+	} else {
+	    if (doclen_max >= 0xff) {
+		tag.assign(1, char(16));
+		for (size_t i = 2; i < newtag.size(); i += 4)
+		    tag.append(newtag, i, 2);
+	    } else {
+		tag.assign(1, char(8));
+		for (size_t i = 3; i < newtag.size(); i += 4)
+		    tag.append(newtag, i, 1);
+	    }
+	}
+    }
+
   public:
     string key, tag;
     Xapian::docid firstdid;
@@ -171,36 +352,45 @@ class PostlistCursor<const GlassTable&> : private GlassCursor {
     }
 
     bool next() {
-	if (!GlassCursor::next()) return false;
+	if (!doclen_rest.empty()) {
+	    // Continue a doclen chunk which we split.
+	    string rest;
+	    swap(rest, doclen_rest);
+	    firstdid = doclen_rest_firstdid;
+	    tf = cf = 0;
+	    convert_doclens(rest.data(), rest.data() + rest.size());
+	    return true;
+	}
+	if (pending_valuestats.empty()) {
+	    bool ok = GlassCursor::next();
+	    if (!valuechunk_prefix.empty()) {
+		if (!ok || !startswith(current_key, valuechunk_prefix)) {
+		    ok = next_valuechunk_slot();
+		}
+	    } else if (ok && GlassCompact::is_valuechunk_key(current_key)) {
+		find_valuechunk_slots();
+	    } else if (ok && GlassCompact::is_valuestats_key(current_key)) {
+		read_valuestats();
+	    }
+	    if (!ok) return false;
+	}
+	tf = cf = 0;
+	if (!pending_valuestats.empty()) {
+	    auto i = pending_valuestats.begin();
+	    key = Honey::make_valuestats_key(i->first);
+	    swap(tag, i->second);
+	    pending_valuestats.erase(i);
+	    return true;
+	}
 	// We put all chunks into the non-initial chunk form here, then fix up
 	// the first chunk for each term in the merged database as we merge.
 	read_tag();
 	key = current_key;
 	tag = current_tag;
-	tf = cf = 0;
 	if (GlassCompact::is_user_metadata_key(key)) {
 	    key[1] = Honey::KEY_USER_METADATA;
 	    return true;
 	}
-	if (GlassCompact::is_valuestats_key(key)) {
-	    // Adjust key.
-	    const char* p = key.data();
-	    const char* end = p + key.length();
-	    p += 2;
-	    Xapian::valueno slot;
-	    if (!unpack_uint_last(&p, end, &slot))
-		throw Xapian::DatabaseCorruptError("bad value stats key");
-	    // FIXME: pack_uint_last() is not a good encoding for keys, as the
-	    // encoded values do not in general sort the same way as the
-	    // numeric values.  The first 256 values will be in order at least.
-	    //
-	    // We could just buffer up the stats for all the slots - it's
-	    // unlikely there are going to be very many.  Another option is
-	    // to use multiple cursors or seek a single cursor around.
-	    AssertRel(slot, <=, 256);
-	    key = Honey::make_valuestats_key(slot);
-	    return true;
-	}
 	if (GlassCompact::is_valuechunk_key(key)) {
 	    const char* p = key.data();
 	    const char* end = p + key.length();
@@ -208,14 +398,6 @@ class PostlistCursor<const GlassTable&> : private GlassCursor {
 	    Xapian::valueno slot;
 	    if (!unpack_uint(&p, end, &slot))
 		throw Xapian::DatabaseCorruptError("bad value key");
-	    // FIXME: pack_uint() is not a good encoding for keys, as the
-	    // encoded values do not in general sort the same way as the
-	    // numeric values.  The first 128 values will be in order at least.
-	    //
-	    // Buffering up this data for all slots is potentially prohibitively
-	    // costly.  We probably need to use multiple cursors or seek a
-	    // single cursor around.
-	    AssertRel(slot, <=, 128);
 	    Xapian::docid first_did;
 	    if (!unpack_uint_preserving_sort(&p, end, &first_did))
 		throw Xapian::DatabaseCorruptError("bad value key");
@@ -223,15 +405,43 @@ class PostlistCursor<const GlassTable&> : private GlassCursor {
 
 	    Glass::ValueChunkReader reader(tag.data(), tag.size(), first_did);
 	    Xapian::docid last_did = first_did;
-	    while (reader.next(), !reader.at_end()) {
-		last_did = reader.get_docid();
+	    string lbound = reader.get_value();
+	    string ubound = lbound;
+	    if (reader.is_columnar()) {
+		// Honey uses glass's original format for the entries, so
+		// convert the chunk back to that.  The chunk records its
+		// bounds so we don't need to find them.
+		lbound = reader.get_lower_bound();
+		ubound = reader.get_upper_bound();
+		string row_tag;
+		pack_string(row_tag, reader.get_value());
+		while (reader.next(), !reader.at_end()) {
+		    Xapian::docid did = reader.get_docid();
+		    pack_uint(row_tag, did - last_did - 1);
+		    pack_string(row_tag, reader.get_value());
+		    last_did = did;
+		}
+		swap(tag, row_tag);
+	    } else {
+		while (reader.next(), !reader.at_end()) {
+		    last_did = reader.get_docid();
+		    const string& value = reader.get_value();
+		    if (value < lbound) {
+			lbound = value;
+		    } else if (value > ubound) {
+			ubound = value;
+		    }
+		}
 	    }
 
 	    key = Honey::make_valuechunk_key(slot, last_did);
 
-	    // Add the docid delta across the chunk to the start of the tag.
+	    // Add the docid delta across the chunk and the bounds on the
+	    // values in it to the start of the tag.
 	    string newtag;
 	    pack_uint(newtag, last_did - first_did);
+	    pack_string(newtag, lbound);
+	    pack_string(newtag, lbound == ubound ? string() : ubound);
 	    tag.insert(0, newtag);
 
 	    return true;
@@ -270,9 +480,6 @@ class PostlistCursor<const GlassTable&> : private GlassCursor {
 	    d = tag.data();
 	    e = d + tag.size();
 
-	    // Convert doclen chunk to honey format.
-	    string newtag;
-
 	    // Skip the "last chunk" flag and increase_to_last.
 	    if (d == e)
 		throw Xapian::DatabaseCorruptError("No last chunk flag in "
@@ -283,64 +490,8 @@ class PostlistCursor<const GlassTable&> : private GlassCursor {
 		throw Xapian::DatabaseCorruptError("Decoding last docid delta "
 						   "in glass docdata chunk");
 
-	    Xapian::termcount doclen_max = 0;
-	    while (true) {
-		Xapian::termcount doclen;
-		if (!unpack_uint(&d, e, &doclen))
-		    throw Xapian::DatabaseCorruptError("Decoding doclen in "
-						       "glass docdata chunk");
-		if (doclen > doclen_max)
-		    doclen_max = doclen;
-		unsigned char buf[4];
-		unaligned_write4(buf, doclen);
-		newtag.append(reinterpret_cast<char*>(buf), 4);
-		if (d == e)
-		    break;
-		Xapian::docid gap_size;
-		if (!unpack_uint(&d, e, &gap_size))
-		    throw Xapian::DatabaseCorruptError("Decoding docid "
-						       "gap_size in glass "
-						       "docdata chunk");
-		// FIXME: Split chunk if the gap_size is at all large.
-		newtag.append(4 * gap_size, '\xff');
-	    }
-
-	    Assert(!startswith(newtag, "\xff\xff\xff\xff"));
-	    Assert(!endswith(newtag, "\xff\xff\xff\xff"));
-
-	    AssertEq(newtag.size() % 4, 0);
-	    chunk_lastdid = firstdid - 1 + newtag.size() / 4;
-
-	    // Only encode document lengths using a whole number of bytes for
-	    // now.  We could allow arbitrary bit widths, but it complicates
-	    // encoding and decoding so we should consider if the fairly small
-	    // additional saving is worth it.
-	    if (doclen_max >= 0xffff) {
-		if (doclen_max >= 0xffffff) {
-		    newtag.insert(0, 1, char(32));
-		    swap(tag, newtag);
-		} else if (doclen_max >= 0xffffffff) {
-		    // FIXME: Handle these.
-		    const char* m = "Document length values >= 0xffffffff not "
-				    "currently handled";
-		    throw Xapian::FeatureUnavailableError(m);
-		} else {
-		    tag.assign(1, char(24));
-		    for (size_t i = 1; i < newtag.size(); i += 4)
-			tag.append(newtag, i, 3);
-		}
-	    } else {
-		if (doclen_max >= 0xff) {
-		    tag.assign(1, char(16));
-		    for (size_t i = 2; i < newtag.size(); i += 4)
-			tag.append(newtag, i, 2);
-		} else {
-		    tag.assign(1, char(8));
-		    for (size_t i = 3; i < newtag.size(); i += 4)
-			tag.append(newtag, i, 1);
-		}
-	    }
-
+	    // Convert doclen chunk to honey format.
+	    convert_doclens(d, e);
 	    return true;
 	}
 
@@ -365,7 +516,6 @@ class PostlistCursor<const GlassTable&> : private GlassCursor {
 	    ++firstdid;
 	    have_wdfs = (cf != 0);
 	    tag.erase(0, d - tag.data());
-	    wdf_max = 0;
 	} else {
 	    // Not an initial chunk, so adjust key.
 	    size_t tmp = d - key.data();
@@ -391,6 +541,12 @@ class PostlistCursor<const GlassTable&> : private GlassCursor {
 	    throw Xapian::DatabaseCorruptError("Decoding last docid delta in "
 					       "glass posting chunk");
 	chunk_lastdid = firstdid + increase_to_last;
+	string expanded;
+	if (Glass::is_bitmap_chunk(d, e)) {
+	    expanded = Glass::expand_bitmap_chunk(d, e);
+	    d = expanded.data();
+	    e = d + expanded.size();
+	}
 	if (!unpack_uint(&d, e, &first_wdf))
 	    throw Xapian::DatabaseCorruptError("Decoding first wdf in glass "
 					       "posting chunk");
@@ -404,7 +560,9 @@ class PostlistCursor<const GlassTable&> : private GlassCursor {
 	    throw Xapian::DatabaseError("Honey does not support a term having "
 					"both zero and non-zero wdf");
 	}
-	wdf_max = max(wdf_max, first_wdf);
+	// Track the maximum wdf in each chunk - the maximum for the whole
+	// posting list is calculated when merging.
+	wdf_max = first_wdf;
 
 	while (d != e) {
 	    Xapian::docid delta;
@@ -520,9 +678,11 @@ class PostlistCursor<const HoneyTable&> : private HoneyCursor {
 	    e = d + tag.size();
 
 	    Xapian::docid lastdid;
+	    Xapian::termcount chunk_wdf_max;
 	    if (!decode_initial_chunk_header(&d, e, tf, cf,
 					     firstdid, lastdid, chunk_lastdid,
-					     first_wdf, wdf_max)) {
+					     first_wdf, wdf_max,
+					     chunk_wdf_max)) {
 		throw Xapian::DatabaseCorruptError("Bad postlist initial "
 						   "chunk header");
 	    }
@@ -548,6 +708,16 @@ class PostlistCursor<const HoneyTable&> : private HoneyCursor {
 		    }
 		}
 	    }
+	    if (!tag.empty()) {
+		// Convert the posting data back to a sequence of varints.
+		string postings;
+		Honey::decode_posting_blocks(tag.data(),
+					     tag.data() + tag.size(),
+					     have_wdfs, postings);
+		tag = std::move(postings);
+	    }
+	    // From here on wdf_max is the maximum wdf in the current chunk.
+	    wdf_max = chunk_wdf_max;
 	} else {
 	    if (cf > 0) {
 		// The cf we report should only be non-zero for initial chunks
@@ -578,7 +748,7 @@ class PostlistCursor<const HoneyTable&> : private HoneyCursor {
 
 	    if (have_wdfs) {
 		if (!decode_delta_chunk_header(&d, e, chunk_lastdid, firstdid,
-					       first_wdf)) {
+					       first_wdf, wdf_max)) {
 		    throw Xapian::DatabaseCorruptError("Bad postlist delta "
 						       "chunk header");
 		}
@@ -588,8 +758,12 @@ class PostlistCursor<const HoneyTable&> : private HoneyCursor {
 		    throw Xapian::DatabaseCorruptError("Bad postlist delta "
 						       "chunk header");
 		}
+		// The wdf is flat for all entries in non-initial chunks.
+		wdf_max = first_wdf;
 	    }
-	    tag.erase(0, d - tag.data());
+	    string postings;
+	    Honey::decode_posting_blocks(d, e, have_wdfs, postings);
+	    tag = std::move(postings);
 	}
 	firstdid += offset;
 	chunk_lastdid += offset;
@@ -903,7 +1077,10 @@ merge_postlists(Xapian::Compactor* compactor,
 	/// Append postings to tag, which should only contain the chunk header.
 	void append_postings_to(string& tag, bool want_wdfs) {
 	    if (data.empty()) {
-		if (tf == 1) {
+		if (tf <= 1) {
+		    // Either a term which only occurs in one document, or a
+		    // non-initial chunk (which always has tf == 0 here) with
+		    // only a single entry.
 		    return;
 		}
 		AssertEq(tf, 2);
@@ -958,6 +1135,13 @@ merge_postlists(Xapian::Compactor* compactor,
     };
     vector<HoneyPostListChunk> tags;
 
+    // Return the maximum wdf in the chunk formed by merging tags [i,j).
+    auto chunk_wdf_upper_bound = [&tags](size_t i, size_t j) {
+	Xapian::termcount result = 0;
+	while (i != j) result = max(result, tags[i++].wdf_max);
+	return result;
+    };
+
     Xapian::termcount tf = 0, cf = 0; // Initialise to avoid warnings.
 
     while (true) {
@@ -1027,19 +1211,26 @@ merge_postlists(Xapian::Compactor* compactor,
 		}
 
 		chunk_lastdid = tags[j - 1].last;
+		Xapian::termcount chunk_wdf_max = chunk_wdf_upper_bound(0, j);
 
 		string first_tag;
 		encode_initial_chunk_header(tf, cf, tags[0].first, last_did,
 					    chunk_lastdid,
-					    first_wdf, wdf_max, first_tag);
+					    first_wdf, wdf_max, chunk_wdf_max,
+					    first_tag);
 
 		if (tf > 2) {
 		    // If tf <= 2 there's no explicit posting data.
-		    tags[0].append_postings_to(first_tag, have_wdfs);
+		    string postings;
+		    tags[0].append_postings_to(postings, have_wdfs);
 		    for (size_t chunk = 1; chunk != j; ++chunk) {
-			tags[chunk].append_postings_to(first_tag, have_wdfs,
+			tags[chunk].append_postings_to(postings, have_wdfs,
 						       tags[chunk - 1].last);
 		    }
+		    Honey::encode_posting_blocks(postings.data(),
+						 postings.data() +
+						 postings.size(),
+						 have_wdfs, first_tag);
 		}
 		out->add(last_key, first_tag);
 
@@ -1069,6 +1260,8 @@ merge_postlists(Xapian::Compactor* compactor,
 			    encode_delta_chunk_header(tags[i].first,
 						      last_did,
 						      tags[i].first_wdf,
+						      chunk_wdf_upper_bound(i,
+									    j),
 						      tag);
 			} else {
 			    encode_delta_chunk_header_no_wdf(tags[i].first,
@@ -1076,11 +1269,16 @@ merge_postlists(Xapian::Compactor* compactor,
 							     tag);
 			}
 
-			tags[i].append_postings_to(tag, have_wdfs);
+			string postings;
+			tags[i].append_postings_to(postings, have_wdfs);
 			while (++i != j) {
-			    tags[i].append_postings_to(tag, have_wdfs,
+			    tags[i].append_postings_to(postings, have_wdfs,
 						       tags[i - 1].last);
 			}
+			Honey::encode_posting_blocks(postings.data(),
+						     postings.data() +
+						     postings.size(),
+						     have_wdfs, tag);
 
 			out->add(pack_honey_postlist_key(term, last_did), tag);
 		    }
@@ -1260,7 +1458,8 @@ merge_spellings(HoneyTable* out,
 		    break;
 		}
 		default:
-		    compressed = cur->read_tag(true);
+		    compressed = cur->read_tag(cur->get_compression_codec() ==
+					       out->get_compression_codec());
 		    break;
 	    }
 	    out->add(key, cur->current_tag, compressed);
@@ -1491,8 +1690,9 @@ merge_synonyms(T* out, U b, U e)
 	string key = cur->current_key;
 	if (pq.empty() || pq.top()->current_key > key) {
 	    // No need to merge the tags, just copy the (possibly compressed)
-	    // tag value.
-	    bool compressed = cur->read_tag(true);
+	    // tag value (unless the output uses a different codec).
+	    bool compressed = cur->read_tag(cur->get_compression_codec() ==
+					    out->get_compression_codec());
 	    out->add(key, cur->current_tag, compressed);
 	    if (cur->next()) {
 		pq.push(cur);
@@ -1996,7 +2196,8 @@ next_without_next:
 		if (!next_result) break;
 		if (next_already_done) goto next_without_next;
 	    } else {
-		bool compressed = cur.read_tag(true);
+		bool compressed = cur.read_tag(cur.get_compression_codec() ==
+					       out->get_compression_codec());
 		out->add(key, cur.current_tag, compressed);
 	    }
 	}
@@ -2004,6 +2205,129 @@ next_without_next:
 }
 #endif
 
+/** Parse the name of an index type.
+ *
+ *  Throws InvalidArgumentError if @a name isn't recognised.
+ *
+ *  @param what	Where the setting came from, for error messages.
+ */
+static Honey::sstindex_type
+parse_index_type(const char* what, const string& name)
+{
+    if (name == "array") return Honey::SSTINDEX_ARRAY;
+    if (name == "binarychop") return Honey::SSTINDEX_BINARY_CHOP;
+    if (name == "skiplist") return Honey::SSTINDEX_SKIPLIST;
+    if (name == "eytzinger") return Honey::SSTINDEX_EYTZINGER;
+    throw Xapian::InvalidArgumentError(string(what) + ": Unknown index type "
+				       "'" + name + "'");
+}
+
+/** Get the setting for a table from a list of settings.
+ *
+ *  The list is comma separated, and each entry is either a value to use for
+ *  all tables or a table=value pair (e.g.
+ *  "eytzinger,termlist=binarychop").  Later entries take precedence.
+ *
+ *  @param settings	The list of settings (NULL or empty for none).
+ *  @param what		Where the settings came from, for error messages.
+ *  @param name		The base name of the table.
+ *  @param parse	Function to parse and check a value, which should
+ *			throw InvalidArgumentError if it isn't valid.
+ *  @param value	The value to use if no setting applies to the table.
+ */
+template<typename T, typename P>
+static T
+get_table_setting(const char* settings, const char* what, const char* name,
+		  P parse, T value)
+{
+    const char* p = settings;
+    if (!p || !*p) return value;
+    while (true) {
+	const char* e = strchr(p, ',');
+	if (!e) e = p + strlen(p);
+	const char* eq = static_cast<const char*>(memchr(p, '=', e - p));
+	if (!eq) {
+	    value = parse(what, string(p, e));
+	} else {
+	    T v = parse(what, string(eq + 1, e));
+	    if (string(p, eq) == name) value = v;
+	}
+	if (*e == '\0') break;
+	p = e + 1;
+    }
+    return value;
+}
+
+/** Get the index type to use for a table.
+ *
+ *  This can be overridden by setting XAPIAN_HONEY_SSTINDEX to either an
+ *  index type to use for all tables, or a comma separated list of
+ *  table=type pairs (e.g. "postlist=skiplist,termlist=binarychop"), and
+ *  by Compactor::set_honey_index_type(), which takes precedence.
+ *
+ *  @param compactor	The Compactor (or NULL).
+ *  @param name		The base name of the table.
+ *  @param type		The default index type for the table.
+ */
+static Honey::sstindex_type
+get_index_type(const Xapian::Compactor* compactor, const char* name,
+	       Honey::sstindex_type type)
+{
+    type = get_table_setting(getenv("XAPIAN_HONEY_SSTINDEX"),
+			     "XAPIAN_HONEY_SSTINDEX", name,
+			     parse_index_type, type);
+    if (compactor) {
+	type = get_table_setting(compactor->get_honey_index_types().c_str(),
+				 "Compactor::set_honey_index_type()", name,
+				 parse_index_type, type);
+    }
+    return type;
+}
+
+/** Parse the number of bits per key to use for a Bloom filter.
+ *
+ *  Throws InvalidArgumentError if @a value isn't a number of bits we allow.
+ *
+ *  @param what	Where the setting came from, for error messages.
+ */
+static unsigned
+parse_bloom_bits(const char* what, const string& value)
+{
+    unsigned bits;
+    if (!parse_unsigned(value.c_str(), bits) || bits > 64) {
+	throw Xapian::InvalidArgumentError(string(what) + ": Expected bits "
+					   "per key from 0 to 64, not '" +
+					   value + "'");
+    }
+    return bits;
+}
+
+/** Get the number of bits per key for a table's Bloom filter (0 for none).
+ *
+ *  This can be overridden by setting XAPIAN_HONEY_BLOOM_BITS to either a
+ *  number of bits to use for all tables, or a comma separated list of
+ *  table=bits pairs (e.g. "postlist=16,synonym=10"), and by
+ *  Compactor::set_honey_bloom_bits(), which takes precedence.
+ *
+ *  @param compactor	The Compactor (or NULL).
+ *  @param name		The base name of the table.
+ *  @param bits		The default number of bits per key for the table.
+ */
+static unsigned
+get_bloom_bits(const Xapian::Compactor* compactor, const char* name,
+	       unsigned bits)
+{
+    bits = get_table_setting(getenv("XAPIAN_HONEY_BLOOM_BITS"),
+			     "XAPIAN_HONEY_BLOOM_BITS", name,
+			     parse_bloom_bits, bits);
+    if (compactor) {
+	bits = get_table_setting(compactor->get_honey_bloom_bits().c_str(),
+				 "Compactor::set_honey_bloom_bits()", name,
+				 parse_bloom_bits, bits);
+    }
+    return bits;
+}
+
 }
 
 using namespace HoneyCompact;
@@ -2029,20 +2353,41 @@ HoneyDatabase::compact(Xapian::Compactor* compactor,
 	Honey::table_type type;
 	// Create tables after position lazily.
 	bool lazy;
+	// The default bits per key for a Bloom filter (0 for none).
+	unsigned bloom_bits;
     };
 
+    // Lookups of terms which don't exist are common in the postlist table
+    // (misspellings, or terms from other shards) so we build a Bloom filter
+    // for it.
     static const table_list tables[] = {
-	// name		type			lazy
-	{ "postlist",	Honey::POSTLIST,	false },
-	{ "docdata",	Honey::DOCDATA,		true },
-	{ "termlist",	Honey::TERMLIST,	false },
-	{ "position",	Honey::POSITION,	true },
-	{ "spelling",	Honey::SPELLING,	true },
-	{ "synonym",	Honey::SYNONYM,		true }
+	// name		type		lazy	bloom_bits
+	{ "postlist",	Honey::POSTLIST,	false,	10 },
+	{ "docdata",	Honey::DOCDATA,		true,	0 },
+	{ "termlist",	Honey::TERMLIST,	false,	0 },
+	{ "position",	Honey::POSITION,	true,	0 },
+	{ "spelling",	Honey::SPELLING,	true,	0 },
+	{ "synonym",	Honey::SYNONYM,		true,	0 }
     };
     const table_list* tables_end = tables +
 	(sizeof(tables) / sizeof(tables[0]));
 
+    // Check for an invalid index type or number of Bloom filter bits before
+    // we start.
+    Honey::sstindex_type index_types[sizeof(tables) / sizeof(tables[0])];
+    unsigned bloom_bits[sizeof(tables) / sizeof(tables[0])];
+    for (const table_list* t = tables; t < tables_end; ++t) {
+	// The eytzinger index gives the fastest random lookups for every
+	// table.  The array index only has an entry per first byte of the key,
+	// so it scans a long way in a large table - particularly those keyed
+	// by docid, where few first byte values are used.  The cost of
+	// eytzinger is loading the sampled keys when the database is opened.
+	index_types[t - tables] = get_index_type(compactor, t->name,
+						 Honey::SSTINDEX_EYTZINGER);
+	bloom_bits[t - tables] = get_bloom_bits(compactor, t->name,
+						t->bloom_bits);
+    }
+
     const int FLAGS = Xapian::DB_DANGEROUS;
 
     bool single_file = (flags & Xapian::DBCOMPACT_SINGLE_FILE);
@@ -2110,7 +2455,8 @@ HoneyDatabase::compact(Xapian::Compactor* compactor,
 	bool source_single_file = false;
 	if (source_backend == Xapian::DB_BACKEND_GLASS) {
 #ifdef XAPIAN_HAS_GLASS_BACKEND
-	    auto db = static_cast<const GlassDatabase*>(sources[i]);
+	    auto glass_db = static_cast<const GlassDatabase*>(sources[i]);
+	    auto db = glass_db->tables_db();
 	    auto& v_in = db->version_file;
 	    auto& v_out = version_file_out;
 	    // Glass backend doesn't track unique term bounds, hence setting
@@ -2163,7 +2509,8 @@ if (source_backend == Xapian::DB_BACKEND_GLASS) {
 #ifndef XAPIAN_HAS_GLASS_BACKEND
     throw Xapian::FeatureUnavailableError("Glass backend disabled");
 #else
-    vector<HoneyTable*> tabs;
+    // Owning, so the output tables get closed if we throw.
+    vector<unique_ptr<HoneyTable>> tabs;
     tabs.reserve(tables_end - tables);
     off_t prev_size = 0;
     for (const table_list* t = tables; t < tables_end; ++t) {
@@ -2199,7 +2546,7 @@ if (source_backend == Xapian::DB_BACKEND_GLASS) {
 	inputs.reserve(sources.size());
 	size_t inputs_present = 0;
 	for (auto src : sources) {
-	    auto db = static_cast<const GlassDatabase*>(src);
+	    auto db = static_cast<const GlassDatabase*>(src)->tables_db();
 	    const GlassTable* table;
 	    switch (t->type) {
 		case Honey::POSTLIST:
@@ -2249,6 +2596,11 @@ if (source_backend == Xapian::DB_BACKEND_GLASS) {
 		    bad_totals = bad_stat = true;
 		    output_will_exist = true;
 		    ++inputs_present;
+		} else if (!table->empty()) {
+		    // The table has just been created by a reader replaying the
+		    // write-ahead log.
+		    output_will_exist = true;
+		    ++inputs_present;
 		}
 	    }
 	    inputs.push_back(table);
@@ -2293,7 +2645,7 @@ if (source_backend == Xapian::DB_BACKEND_GLASS) {
 	} else {
 	    out = new HoneyTable(t->name, dest, false, t->lazy);
 	}
-	tabs.push_back(out);
+	tabs.emplace_back(out);
 	Honey::RootInfo* root_info = version_file_out->root_to_set(t->type);
 	if (single_file) {
 	    root_info->set_free_list(fl_serialised);
@@ -2304,6 +2656,8 @@ if (source_backend == Xapian::DB_BACKEND_GLASS) {
 	} else {
 	    out->create_and_open(FLAGS, *root_info);
 	}
+	out->set_index_type(index_types[t - tables]);
+	out->set_bloom_bits(bloom_bits[t - tables]);
 
 	switch (t->type) {
 	    case Honey::POSTLIST: {
@@ -2443,12 +2797,10 @@ if (source_backend == Xapian::DB_BACKEND_GLASS) {
     }
     // Commit with revision 1.
     version_file_out->sync(tmpfile, 1, FLAGS);
-    for (unsigned j = 0; j != tabs.size(); ++j) {
-	delete tabs[j];
-    }
 #endif
 } else {
-    vector<HoneyTable*> tabs;
+    // Owning, so the output tables get closed if we throw.
+    vector<unique_ptr<HoneyTable>> tabs;
     tabs.reserve(tables_end - tables);
     off_t prev_size = HONEY_MIN_DB_SIZE;
     for (const table_list* t = tables; t < tables_end; ++t) {
@@ -2578,7 +2930,7 @@ if (source_backend == Xapian::DB_BACKEND_GLASS) {
 	} else {
 	    out = new HoneyTable(t->name, dest, false, t->lazy);
 	}
-	tabs.push_back(out);
+	tabs.emplace_back(out);
 	Honey::RootInfo* root_info = version_file_out->root_to_set(t->type);
 	if (single_file) {
 	    root_info->set_free_list(fl_serialised);
@@ -2589,6 +2941,8 @@ if (source_backend == Xapian::DB_BACKEND_GLASS) {
 	} else {
 	    out->create_and_open(FLAGS, *root_info);
 	}
+	out->set_index_type(index_types[t - tables]);
+	out->set_bloom_bits(bloom_bits[t - tables]);
 
 	switch (t->type) {
 	    case Honey::POSTLIST: {
@@ -2712,9 +3066,6 @@ if (source_backend == Xapian::DB_BACKEND_GLASS) {
     }
     // Commit with revision 1.
     version_file_out->sync(tmpfile, 1, FLAGS);
-    for (unsigned j = 0; j != tabs.size(); ++j) {
-	delete tabs[j];
-    }
 }
 
     if (!single_file) lock.release();
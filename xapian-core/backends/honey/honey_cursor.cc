@@ -69,10 +69,15 @@ HoneyCursor::do_next()
 				    errno);
     }
     size_t key_size = ch;
-    char buf[256];
-    store.read(buf, key_size);
     current_key.assign(last_key, 0, reuse);
-    current_key.append(buf, key_size);
+    const char* key_data = store.read_view(key_size);
+    if (key_data) {
+	current_key.append(key_data, key_size);
+    } else {
+	char buf[256];
+	store.read(buf, key_size);
+	current_key.append(buf, key_size);
+    }
     last_key = current_key;
 
 #ifdef DEBUGGING
@@ -118,6 +123,7 @@ HoneyCursor::next_from_index()
     // all the data before reading it.
     if (true && val_size == 0)
 	current_tag.resize(0);
+    tag_view = NULL;
 
     is_at_end = false;
     return true;
@@ -126,6 +132,11 @@ HoneyCursor::next_from_index()
 bool
 HoneyCursor::read_tag(bool keep_compressed)
 {
+    if (tag_view) {
+	// The tag was returned by read_tag_view() without being copied.
+	current_tag.assign(tag_view, tag_view_size);
+	tag_view = NULL;
+    }
     if (val_size) {
 	if (store.was_forced_closed()) {
 	    HoneyTable::throw_database_closed();
@@ -166,6 +177,30 @@ HoneyCursor::read_tag(bool keep_compressed)
     return current_compressed;
 }
 
+const char*
+HoneyCursor::read_tag_view(size_t& len)
+{
+    if (tag_view) {
+	len = tag_view_size;
+	return tag_view;
+    }
+    if (val_size && !current_compressed) {
+	if (store.was_forced_closed()) {
+	    HoneyTable::throw_database_closed();
+	}
+	const char* p = store.read_view(val_size);
+	if (p) {
+	    tag_view = p;
+	    tag_view_size = len = val_size;
+	    val_size = 0;
+	    return p;
+	}
+    }
+    read_tag();
+    len = current_tag.size();
+    return current_tag.data();
+}
+
 bool
 HoneyCursor::do_find(const string& key, bool greater_than)
 {
@@ -194,7 +229,7 @@ HoneyCursor::do_find(const string& key, bool greater_than)
 	    current_key = last_key;
 	    return true;
 	}
-	if (cmp0 < 0) {
+	if (cmp0 < 0 && table->index_by_first_byte()) {
 	    // We're going forwards to a key with the same first character, so
 	    // an array index won't help us.
 	    use_index = false;
@@ -206,173 +241,33 @@ HoneyCursor::do_find(const string& key, bool greater_than)
     }
 
     if (use_index) {
-	store.rewind(root);
-	int index_type = store.read();
-	switch (index_type) {
-	    case EOF:
-		return false;
-	    case 0x00: {
-		unsigned char first = key[0] - store.read();
-		unsigned char range = store.read();
-		if (first > range) {
-		    is_at_end = true;
-		    return false;
-		}
-		store.skip(first * 4); // FIXME: pointer width
-		off_t jump = store.read_uint4_be();
-		store.rewind(jump);
-		// The jump point will be an entirely new key (because it is
-		// the first key with that initial character), and we drop in
-		// as if this was the first key so set last_key to be empty.
-		last_key = string();
-		break;
-	    }
-	    case 0x01: {
-		size_t j = store.read_uint4_be();
-		if (j == 0) {
-		    is_at_end = true;
-		    return false;
-		}
-		off_t base = store.get_pos();
-		char kkey[SSTINDEX_BINARY_CHOP_KEY_SIZE];
-		size_t kkey_len = 0;
-		size_t i = 0;
-		while (j - i > 1) {
-		    size_t k = i + (j - i) / 2;
-		    store.set_pos(base + k * SSTINDEX_BINARY_CHOP_ENTRY_SIZE);
-		    store.read(kkey, SSTINDEX_BINARY_CHOP_KEY_SIZE);
-		    kkey_len = 4;
-		    while (kkey_len > 0 && kkey[kkey_len - 1] == '\0')
-			--kkey_len;
-		    int r = key.compare(0, SSTINDEX_BINARY_CHOP_KEY_SIZE,
-					kkey, kkey_len);
-		    if (r < 0) {
-			j = k;
-		    } else {
-			i = k;
-			if (r == 0) {
-			    break;
-			}
-		    }
-		}
-		store.set_pos(base + i * SSTINDEX_BINARY_CHOP_ENTRY_SIZE);
-		store.read(kkey, SSTINDEX_BINARY_CHOP_KEY_SIZE);
-		kkey_len = 4;
-		while (kkey_len > 0 && kkey[kkey_len - 1] == '\0') --kkey_len;
-		off_t jump = store.read_uint4_be();
-		store.rewind(jump);
-		// The jump point is to the first key with prefix kkey, so will
-		// work if we set last key to kkey.  Unless we're jumping to the
-		// start of the table, in which case last_key needs to be empty.
-		last_key.assign(kkey, jump == 0 ? 0 : kkey_len);
-		break;
-	    }
-	    case 0x02: {
-		// FIXME: If "close" just seek forwards?  Or consider seeking
-		// from current index pos?
-		// off_t pos = store.get_pos();
-		string index_key, prev_index_key;
-		make_unsigned<off_t>::type ptr = 0;
-		int cmp0 = 1;
-#ifdef DEBUGGING
-		{
-		    cerr << "Using skiplist index\n";
-		}
-#endif
-		while (true) {
-		    int reuse = store.read();
-		    if (reuse == EOF) break;
-		    int len = store.read();
-		    if (len == EOF) abort(); // FIXME
-#ifdef DEBUGGING
-		    {
-			cerr << "reuse = " << reuse << " len = " << len << endl;
-		    }
-#endif
-		    index_key.resize(reuse + len);
-		    store.read(&index_key[reuse], len);
-
-#ifdef DEBUGGING
-		    {
-			string desc;
-			description_append(desc, index_key);
-			cerr << "Index key: " << desc << endl;
-		    }
-#endif
-
-		    cmp0 = index_key.compare(key);
-		    if (cmp0 > 0) {
-			index_key = prev_index_key;
-			break;
-		    }
-		    char buf[8];
-		    char* e = buf;
-		    while (true) {
-			int b = store.read();
-			*e++ = b;
-			if ((b & 0x80) == 0) break;
-		    }
-		    const char* p = buf;
-		    if (!unpack_uint(&p, e, &ptr) || p != e) abort(); // FIXME
-#ifdef DEBUGGING
-		    {
-			cerr << " -> " << ptr << endl;
-		    }
-#endif
-		    if (cmp0 == 0)
-			break;
-		    prev_index_key = index_key;
-#ifdef DEBUGGING
-		    {
-			string desc;
-			description_append(desc, prev_index_key);
-			cerr << "prev_index_key -> " << desc << endl;
-		    }
-#endif
-		}
-#ifdef DEBUGGING
-		{
-		    string desc;
-		    description_append(desc, index_key);
-		    cerr << " index_key = " << desc << ", cmp0 = " << cmp0
-			 << ", going to " << ptr << endl;
-		}
-#endif
-		store.set_pos(ptr);
-
-		if (ptr != 0) {
-		    last_key = current_key = index_key;
-		    bool res = next_from_index();
-		    (void)res;
-		    Assert(res);
-		    if (cmp0 == 0) {
-			Assert(ptr != 0);
-			return true;
-		    }
-		    store.skip(val_size);
-		} else {
-		    last_key = current_key = string();
-		}
+	// Searching the index may move store's position.
+	off_t cur_pos = store.get_pos();
+	off_t pos;
+	string index_key;
+	if (!table->search_index(store, key, pos, index_key)) {
+	    is_at_end = true;
+	    return false;
+	}
 
+	if (!is_at_end && !last_key.empty() && last_key < key &&
+	    pos <= cur_pos) {
+	    // We're already between the index point and key, so just scan
+	    // forwards from where we are.
+	    store.set_pos(cur_pos);
+	} else {
 #ifdef DEBUGGING
-		{
-		    string desc;
-		    description_append(desc, current_key);
-		    cerr << "cmp0 was " << cmp0
-			 << ", Dropped to data layer on key: " << desc << endl;
-		}
-#endif
-
-		break;
-	    }
-	    default: {
-		string m = "HoneyCursor: Unknown index type ";
-		m += str(index_type);
-		throw Xapian::DatabaseCorruptError(m);
+	    {
+		string desc;
+		description_append(desc, index_key);
+		cerr << "Index says " << desc << " @" << pos << endl;
 	    }
+#endif
+	    store.set_pos(pos);
+	    last_key = current_key = index_key;
+	    is_at_end = false;
+	    val_size = 0;
 	}
-	is_at_end = false;
-	val_size = 0;
     }
 
     while (do_next()) {
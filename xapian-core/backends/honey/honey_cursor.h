@@ -39,6 +39,15 @@ class HoneyCursor {
 
     BufferedFile store;
 
+    /// The table this cursor is on (used to search its index).
+    const HoneyTable* table;
+
+    /// The current tag in the file mapping if read_tag_view() returned it.
+    const char* tag_view = NULL;
+
+    /// The size of the tag at tag_view.
+    size_t tag_view_size = 0;
+
   public:
     std::string current_key, current_tag;
     mutable size_t val_size = 0;
@@ -54,17 +63,21 @@ class HoneyCursor {
     off_t offset;
 
     // Forward to next constructor form.
-    explicit HoneyCursor(const HoneyTable* table)
-	: store(table->store),
+    explicit HoneyCursor(const HoneyTable* table_)
+	: store(table_->store),
+	  table(table_),
 	  comp_stream(Z_DEFAULT_STRATEGY),
-	  root(table->get_root()),
-	  offset(table->get_offset())
+	  root(table_->get_root()),
+	  offset(table_->get_offset())
     {
 	store.set_pos(offset); // FIXME root
     }
 
     HoneyCursor(const HoneyCursor& o)
 	: store(o.store),
+	  table(o.table),
+	  tag_view(o.tag_view),
+	  tag_view_size(o.tag_view_size),
 	  current_key(o.current_key),
 	  current_tag(o.current_tag), // FIXME really copy?
 	  val_size(o.val_size),
@@ -87,6 +100,7 @@ class HoneyCursor {
 	current_key = last_key = std::string();
 	is_at_end = false;
 	val_size = 0;
+	tag_view = NULL;
     }
 
     void to_end() { is_at_end = true; }
@@ -103,6 +117,23 @@ class HoneyCursor {
 
     bool read_tag(bool keep_compressed = false);
 
+    /** Read the current tag, avoiding copying it if possible.
+     *
+     *  If the table is memory mapped and the tag isn't compressed then this
+     *  returns a pointer into the mapping.  Otherwise the tag is read (and
+     *  decompressed) into current_tag as read_tag() does.
+     *
+     *  @param[out] len	Set to the length of the tag.
+     *
+     *  @return Pointer to the tag, which is valid until the cursor moves.
+     */
+    const char* read_tag_view(size_t& len);
+
+    /// Return the codec used to compress tags (always zlib for honey).
+    compression_codec get_compression_codec() const {
+	return COMPRESSION_ZLIB;
+    }
+
     bool find_exact(const std::string& key) {
 	return do_find(key, false);
     }
@@ -124,19 +155,19 @@ class HoneyCursor {
 };
 
 class MutableHoneyCursor : public HoneyCursor {
-    HoneyTable* table;
+    HoneyTable* mutable_table;
 
   public:
     MutableHoneyCursor(HoneyTable* table_)
 	: HoneyCursor(table_),
-	  table(table_)
+	  mutable_table(table_)
     { }
 
     bool del() {
 	Assert(!is_at_end);
 	std::string key_to_del = current_key;
 	bool res = next();
-	table->del(key_to_del);
+	mutable_table->del(key_to_del);
 	return res;
     }
 };
@@ -25,6 +25,7 @@
 #include "honey_alltermslist.h"
 #include "honey_document.h"
 #include "honey_metadata.h"
+#include "honey_postlist.h"
 #include "honey_termlist.h"
 #include "honey_spellingwordslist.h"
 #include "honey_valuelist.h"
@@ -33,6 +34,8 @@
 #include "backends/leafpostlist.h"
 #include "xapian/error.h"
 
+#include <memory>
+
 using namespace std;
 
 void
@@ -45,13 +48,25 @@ HoneyDatabase::throw_termlist_table_close_exception() const
     throw Xapian::FeatureUnavailableError("Database has no termlist");
 }
 
+[[noreturn]]
+static void
+throw_doc_not_found(Xapian::docid did)
+{
+    string message = "Document ID not in use: ";
+    message += str(did);
+    throw Xapian::DocNotFoundError(message);
+}
+
 // Relied on below - opening to read should allow the termlist to be missing.
 static_assert(Xapian::DB_READONLY_ & Xapian::DB_NO_TERMLIST,
 	"Xapian::DB_READONLY_ should imply Xapian::DB_NO_TERMLIST");
 
-HoneyDatabase::HoneyDatabase(const std::string& path_, int flags)
+HoneyDatabase::HoneyDatabase(const std::string& path_, int flags,
+			     int mmap_flags)
     : Xapian::Database::Internal(TRANSACTION_READONLY),
       path(path_),
+      open_flags(flags),
+      open_mmap_flags(mmap_flags),
       version_file(path_),
       docdata_table(path_, true),
       postlist_table(path_, true),
@@ -71,10 +86,13 @@ HoneyDatabase::HoneyDatabase(const std::string& path_, int flags)
     spelling_table.open(flags, version_file.get_root(Honey::SPELLING), rev);
     synonym_table.open(flags, version_file.get_root(Honey::SYNONYM), rev);
     termlist_table.open(flags, version_file.get_root(Honey::TERMLIST), rev);
+    map_tables(mmap_flags);
 }
 
-HoneyDatabase::HoneyDatabase(int fd, int flags)
+HoneyDatabase::HoneyDatabase(int fd, int flags, int mmap_flags)
     : Xapian::Database::Internal(TRANSACTION_READONLY),
+      open_flags(flags),
+      open_mmap_flags(mmap_flags),
       version_file(fd),
       docdata_table(fd, version_file.get_offset(), true),
       postlist_table(fd, version_file.get_offset(), true),
@@ -95,6 +113,7 @@ HoneyDatabase::HoneyDatabase(int fd, int flags)
     spelling_table.open(flags, version_file.get_root(Honey::SPELLING), rev);
     synonym_table.open(flags, version_file.get_root(Honey::SYNONYM), rev);
     termlist_table.open(flags, version_file.get_root(Honey::TERMLIST), rev);
+    map_tables(mmap_flags);
 }
 
 HoneyDatabase::~HoneyDatabase()
@@ -102,6 +121,19 @@ HoneyDatabase::~HoneyDatabase()
     delete doclen_cursor;
 }
 
+void
+HoneyDatabase::map_tables(int mmap_flags)
+{
+    if (!(mmap_flags & Xapian::DB_MMAP))
+	return;
+    docdata_table.use_mmap(mmap_flags);
+    postlist_table.use_mmap(mmap_flags);
+    position_table.use_mmap(mmap_flags);
+    spelling_table.use_mmap(mmap_flags);
+    synonym_table.use_mmap(mmap_flags);
+    termlist_table.use_mmap(mmap_flags);
+}
+
 void
 HoneyDatabase::readahead_for_query(const Xapian::Query& query) const
 {
@@ -112,7 +144,7 @@ HoneyDatabase::readahead_for_query(const Xapian::Query& query) const
 Xapian::doccount
 HoneyDatabase::get_doccount() const
 {
-    return version_file.get_doccount();
+    return version_file.get_doccount() - deletions.size();
 }
 
 Xapian::docid
@@ -124,19 +156,24 @@ HoneyDatabase::get_lastdocid() const
 Xapian::totallength
 HoneyDatabase::get_total_length() const
 {
-    return version_file.get_total_doclen();
+    return version_file.get_total_doclen() - deletions.get_total_length();
 }
 
-Xapian::termcount
-HoneyDatabase::get_doclength(Xapian::docid did) const
+bool
+HoneyDatabase::find_doclength(Xapian::docid did,
+			      Xapian::termcount& doclen) const
 {
     Assert(did != 0);
     if (usual(did <= version_file.get_last_docid())) {
+	if (rare(deletions.contains(did)))
+	    return false;
+
 	if (doclen_cursor == NULL) {
 	    doclen_cursor = get_postlist_cursor();
 	} else {
 	    if (doclen_chunk_reader.find_doclength(did)) {
-		return doclen_chunk_reader.get_doclength();
+		doclen = doclen_chunk_reader.get_doclength();
+		return true;
 	    }
 	}
 
@@ -144,23 +181,35 @@ HoneyDatabase::get_doclength(Xapian::docid did) const
 	bool exact =
 	    doclen_cursor->find_entry_ge(Honey::make_doclenchunk_key(did));
 	if (doclen_chunk_reader.update(doclen_cursor)) {
-	    if (exact)
-		return doclen_chunk_reader.back();
+	    if (exact) {
+		doclen = doclen_chunk_reader.back();
+		return true;
+	    }
 	    if (doclen_chunk_reader.find_doclength(did)) {
-		return doclen_chunk_reader.get_doclength();
+		doclen = doclen_chunk_reader.get_doclength();
+		return true;
 	    }
 	}
     }
+    return false;
+}
 
-    string message = "Document ID not in use: ";
-    message += str(did);
-    throw Xapian::DocNotFoundError(message);
+Xapian::termcount
+HoneyDatabase::get_doclength(Xapian::docid did) const
+{
+    Xapian::termcount doclen;
+    if (usual(find_doclength(did, doclen)))
+	return doclen;
+
+    throw_doc_not_found(did);
 }
 
 Xapian::termcount
 HoneyDatabase::get_unique_terms(Xapian::docid did) const
 {
     Assert(did != 0);
+    if (rare(deletions.contains(did)))
+	throw_doc_not_found(did);
     return HoneyTermList(this, did).get_unique_terms();
 }
 
@@ -168,6 +217,8 @@ Xapian::termcount
 HoneyDatabase::get_wdfdocmax(Xapian::docid did) const
 {
     Assert(did != 0);
+    if (rare(deletions.contains(did)))
+	throw_doc_not_found(did);
     HoneyTermList termlist(this, did);
     Xapian::termcount max_wdf = 0;
     termlist.next();
@@ -185,23 +236,52 @@ HoneyDatabase::get_freqs(const string& term,
 			 Xapian::termcount* collfreq_ptr) const
 {
     postlist_table.get_freqs(term, termfreq_ptr, collfreq_ptr);
+    if (rare(!deletions.empty()) && (termfreq_ptr || collfreq_ptr)) {
+	// The postings of deleted documents remain until the segment is
+	// merged, so discount them.
+	unique_ptr<HoneyPostList> pl(
+	    static_cast<HoneyPostList*>(postlist_table.open_post_list(this,
+								      term,
+								      false)));
+	Xapian::doccount deleted_tf;
+	Xapian::termcount deleted_cf;
+	pl->count_deleted(deleted_tf, deleted_cf);
+	if (termfreq_ptr) *termfreq_ptr -= deleted_tf;
+	if (collfreq_ptr) *collfreq_ptr -= deleted_cf;
+    }
 }
 
 Xapian::doccount
 HoneyDatabase::get_value_freq(Xapian::valueno slot) const
 {
-    return value_manager.get_value_freq(slot);
+    Xapian::doccount value_freq = value_manager.get_value_freq(slot);
+    if (rare(!deletions.empty()) && value_freq) {
+	// The values of deleted documents remain until the segment is
+	// merged, so discount them.
+	Xapian::docid did = 1;
+	while ((did = deletions.find(did)) != 0) {
+	    if (!value_manager.get_value(did, slot).empty())
+		--value_freq;
+	    ++did;
+	}
+    }
+    return value_freq;
 }
 
 string
 HoneyDatabase::get_value_lower_bound(Xapian::valueno slot) const
 {
+    // The bounds are left alone by deletions unless no values are left.
+    if (rare(!deletions.empty()) && HoneyDatabase::get_value_freq(slot) == 0)
+	return string();
     return value_manager.get_value_lower_bound(slot);
 }
 
 string
 HoneyDatabase::get_value_upper_bound(Xapian::valueno slot) const
 {
+    if (rare(!deletions.empty()) && HoneyDatabase::get_value_freq(slot) == 0)
+	return string();
     return value_manager.get_value_upper_bound(slot);
 }
 
@@ -251,6 +331,12 @@ HoneyDatabase::term_exists(const string& term) const
 {
     if (term.empty())
 	return HoneyDatabase::get_doccount() != 0;
+    if (rare(!deletions.empty())) {
+	// The term may only index deleted documents.
+	Xapian::doccount tf;
+	HoneyDatabase::get_freqs(term, &tf, NULL);
+	return tf != 0;
+    }
     return postlist_table.term_exists(term);
 }
 
@@ -289,6 +375,8 @@ HoneyDatabase::open_term_list(Xapian::docid did) const
     Assert(did != 0);
     if (!termlist_table.is_open())
 	throw_termlist_table_close_exception();
+    if (rare(deletions.contains(did)))
+	throw_doc_not_found(did);
     HoneyTermList* tl = new HoneyTermList(this, did);
     if (tl->size() == 0) {
 	// It could be the document has no terms, but maybe it doesn't exist -
@@ -485,6 +573,16 @@ HoneyDatabase::get_backend_info(string* path_ptr) const
     return BACKEND_HONEY;
 }
 
+Xapian::Database::Internal*
+HoneyDatabase::open_instance() const
+{
+    // A single-file database opened from an fd has no path to open again,
+    // and a segment of a segmented database has deletions we'd lose.
+    if (path.empty() || !deletions.empty())
+	return NULL;
+    return new HoneyDatabase(path, open_flags, open_mmap_flags);
+}
+
 void
 HoneyDatabase::get_used_docid_range(Xapian::docid& first,
 				    Xapian::docid& last) const
@@ -25,6 +25,7 @@
 #include "backends/databaseinternal.h"
 
 #include "honey_alldocspostlist.h"
+#include "honey_deletions.h"
 #include "honey_docdata.h"
 #include "honey_postlisttable.h"
 #include "honey_positionlist.h"
@@ -60,6 +61,12 @@ class HoneyDatabase : public Xapian::Database::Internal {
     /// Path of the directory.
     std::string path;
 
+    /// Flags the database was opened with.
+    int open_flags;
+
+    /// Xapian::DB_MMAP flags the database was opened with.
+    int open_mmap_flags;
+
     /// Version file ("iamhoney").
     HoneyVersion version_file;
 
@@ -81,15 +88,37 @@ class HoneyDatabase : public Xapian::Database::Internal {
 
     mutable HoneyCursor* doclen_cursor = NULL;
 
+    /** Documents deleted from this database.
+     *
+     *  Only a segment of a segmented database has any.
+     */
+    HoneyDeletions deletions;
+
+    /// Look up the length of document @a did, returning false if not found.
+    bool find_doclength(Xapian::docid did, Xapian::termcount& doclen) const;
+
     [[noreturn]]
     void throw_termlist_table_close_exception() const;
 
+    /// Map the tables into memory as specified by Xapian::DB_MMAP* flags.
+    void map_tables(int mmap_flags);
+
   public:
+    /** Open a honey database.
+     *
+     *  @param path_	The directory the database is in.
+     *  @param flags	Flags to open the tables with.
+     *  @param mmap_flags	Xapian::DB_MMAP and any access pattern hints to
+     *			read the tables via memory mappings, or 0 to read
+     *			them into buffers.
+     */
     explicit
-    HoneyDatabase(const std::string& path_, int flags = Xapian::DB_READONLY_);
+    HoneyDatabase(const std::string& path_, int flags = Xapian::DB_READONLY_,
+		  int mmap_flags = 0);
 
     explicit
-    HoneyDatabase(int fd, int flags = Xapian::DB_READONLY_);
+    HoneyDatabase(int fd, int flags = Xapian::DB_READONLY_,
+		  int mmap_flags = 0);
 
     ~HoneyDatabase();
 
@@ -372,6 +401,8 @@ class HoneyDatabase : public Xapian::Database::Internal {
      */
     int get_backend_info(std::string* path) const;
 
+    Xapian::Database::Internal* open_instance() const;
+
     /** Find lowest and highest docids actually in use.
      *
      *  Only used by compaction, so only needs to be implemented by
@@ -402,6 +433,21 @@ class HoneyDatabase : public Xapian::Database::Internal {
 	return postlist_table.cursor_get();
     }
 
+    /// Check if document @a did exists and hasn't been deleted.
+    bool document_exists(Xapian::docid did) const {
+	Xapian::termcount doclen;
+	return find_doclength(did, doclen);
+    }
+
+    /// Return the set of documents deleted from this database.
+    const HoneyDeletions& get_deletions() const { return deletions; }
+
+    /** Return the set of documents deleted from this database for updating.
+     *
+     *  Used by HoneySegmentedDatabase to record deletions from a segment.
+     */
+    HoneyDeletions& get_deletions() { return deletions; }
+
     /// Return a string describing this object.
     std::string get_description() const;
 };
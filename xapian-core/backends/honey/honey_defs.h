@@ -28,6 +28,9 @@
 /// Honey table extension.
 #define HONEY_TABLE_EXTENSION "honey"
 
+/// The file listing the segments of a segmented honey database.
+#define HONEY_SEGMENTED_MANIFEST "iamsegmented"
+
 /** Minimum size to pad a honey table to.
  *
  *  Having this minimum size means we can usually know from the size that a
@@ -75,6 +78,21 @@ enum table_type {
     MAX_
 };
 
+/** Types of index for a honey table.
+ *
+ *  The type is stored as the first byte of the table's index.
+ */
+enum sstindex_type {
+    /// One entry for each possible first byte of the key.
+    SSTINDEX_ARRAY = 0x00,
+    /// Sorted fixed-width entries searched by binary chop.
+    SSTINDEX_BINARY_CHOP = 0x01,
+    /// A multi-level skiplist of sampled keys.
+    SSTINDEX_SKIPLIST = 0x02,
+    /// Sampled keys loaded into memory and searched in Eytzinger order.
+    SSTINDEX_EYTZINGER = 0x03
+};
+
 /// Postlist key second bytes when first byte is zero.
 enum {
     KEY_USER_METADATA = 0x00,
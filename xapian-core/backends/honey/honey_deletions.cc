@@ -0,0 +1,124 @@
+/** @file
+ * @brief Set of the documents deleted from a honey database
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "honey_deletions.h"
+
+#include "fd.h"
+#include "io_utils.h"
+#include "pack.h"
+#include "posixy_wrapper.h"
+#include "xapian/constants.h"
+#include "xapian/error.h"
+
+#include <cerrno>
+#include <cstring>
+#include "safefcntl.h"
+#include "safesysstat.h"
+#include "safeunistd.h"
+
+using namespace std;
+
+#define DELETIONS_MAGIC "xhydel01"
+#define DELETIONS_MAGIC_LEN 8
+
+bool
+HoneyDeletions::add(Xapian::docid did, Xapian::termcount doclen)
+{
+    Assert(did != 0);
+    size_t i = did - 1;
+    if ((i >> 3) >= bitmap.size()) {
+	bitmap.resize(posting_bitmap_size(i + 1));
+    } else if (posting_bitmap_test(bits(), i)) {
+	return false;
+    }
+    posting_bitmap_set(reinterpret_cast<unsigned char*>(&bitmap[0]), i);
+    ++count;
+    length += doclen;
+    modified = true;
+    return true;
+}
+
+void
+HoneyDeletions::read(const string& file, Xapian::rev rev)
+{
+    string buf;
+    {
+	FD fd(posixy_open(file.c_str(), O_RDONLY | O_BINARY | O_CLOEXEC));
+	if (fd < 0) {
+	    throw Xapian::DatabaseOpeningError("Couldn't open " + file, errno);
+	}
+	struct stat statbuf;
+	if (fstat(fd, &statbuf) < 0) {
+	    throw Xapian::DatabaseOpeningError("Couldn't stat " + file, errno);
+	}
+	buf.resize(size_t(statbuf.st_size));
+	(void)io_read(fd, &buf[0], buf.size(), buf.size());
+    }
+
+    const char* p = buf.data();
+    const char* end = p + buf.size();
+    if (buf.size() < DELETIONS_MAGIC_LEN ||
+	memcmp(p, DELETIONS_MAGIC, DELETIONS_MAGIC_LEN) != 0) {
+	throw Xapian::DatabaseCorruptError(file + ": Bad magic");
+    }
+    p += DELETIONS_MAGIC_LEN;
+    if (!unpack_uint(&p, end, &count) || !unpack_uint(&p, end, &length)) {
+	throw Xapian::DatabaseCorruptError(file + ": Bad header");
+    }
+    bitmap.assign(p, end - p);
+    revision = rev;
+    modified = false;
+}
+
+void
+HoneyDeletions::write(const string& file, Xapian::rev rev, int flags)
+{
+    string buf(DELETIONS_MAGIC, DELETIONS_MAGIC_LEN);
+    pack_uint(buf, count);
+    pack_uint(buf, length);
+    buf += bitmap;
+
+    string tmpfile = file + ".tmp";
+    FD fd(posixy_open(tmpfile.c_str(),
+		      O_WRONLY | O_CREAT | O_TRUNC | O_BINARY | O_CLOEXEC,
+		      0666));
+    if (fd < 0) {
+	throw Xapian::DatabaseError("Couldn't create " + tmpfile, errno);
+    }
+    try {
+	io_write(fd, buf.data(), buf.size());
+	if ((flags & Xapian::DB_NO_SYNC) == 0 &&
+	    ((flags & Xapian::DB_FULL_SYNC) ? !io_full_sync(fd) : !io_sync(fd))) {
+	    throw Xapian::DatabaseError("Couldn't sync " + tmpfile, errno);
+	}
+	if (fd.close() < 0) {
+	    throw Xapian::DatabaseError("Couldn't close " + tmpfile, errno);
+	}
+    } catch (...) {
+	(void)unlink(tmpfile.c_str());
+	throw;
+    }
+    if (!io_tmp_rename(tmpfile, file)) {
+	throw Xapian::DatabaseError("Couldn't update " + file, errno);
+    }
+    revision = rev;
+    modified = false;
+}
@@ -0,0 +1,132 @@
+/** @file
+ * @brief Set of the documents deleted from a honey database
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_HONEY_DELETIONS_H
+#define XAPIAN_INCLUDED_HONEY_DELETIONS_H
+
+#include "backends/postingbitmap.h"
+#include "omassert.h"
+#include "xapian/types.h"
+
+#include <string>
+
+/** Set of the documents deleted from a honey database.
+ *
+ *  Honey databases can't be updated, so a segment of a segmented database
+ *  (see honey_segmented.h) has its deletions recorded separately, and the
+ *  HoneyDatabase for the segment skips them.  The documents are removed
+ *  when the segment is merged.
+ *
+ *  The set is stored as a bitmap with bit (did - 1) set for each deleted
+ *  docid.  In the file this is preceded by a magic string, the number of
+ *  deleted documents and their total length.
+ */
+class HoneyDeletions {
+    /// The bitmap.
+    std::string bitmap;
+
+    /// The number of deleted documents.
+    Xapian::doccount count = 0;
+
+    /// The total length of the deleted documents.
+    Xapian::totallength length = 0;
+
+    /// The revision the set was read from (0 if it wasn't read from a file).
+    Xapian::rev revision = 0;
+
+    /// Has the set been modified since it was read or written?
+    bool modified = false;
+
+    const unsigned char* bits() const {
+	return reinterpret_cast<const unsigned char*>(bitmap.data());
+    }
+
+  public:
+    bool empty() const { return count == 0; }
+
+    /// Return the number of deleted documents.
+    Xapian::doccount size() const { return count; }
+
+    /// Return the total length of the deleted documents.
+    Xapian::totallength get_total_length() const { return length; }
+
+    /// Return the revision the set was read from or last written at.
+    Xapian::rev get_revision() const { return revision; }
+
+    bool is_modified() const { return modified; }
+
+    /// Is document @a did deleted?
+    bool contains(Xapian::docid did) const {
+	Assert(did != 0);
+	size_t i = did - 1;
+	return (i >> 3) < bitmap.size() && posting_bitmap_test(bits(), i);
+    }
+
+    /** Return the first deleted docid which is >= @a did.
+     *
+     *  @return The docid found, or 0 if there isn't one.
+     */
+    Xapian::docid find(Xapian::docid did) const {
+	Assert(did != 0);
+	size_t nbits = bitmap.size() * 8;
+	size_t i = posting_bitmap_find(bits(), nbits, did - 1);
+	return i == nbits ? 0 : Xapian::docid(i + 1);
+    }
+
+    /** Mark document @a did as deleted.
+     *
+     *  @param did	The docid.
+     *  @param doclen	The length of the document.
+     *
+     *  @return false if @a did was already deleted.
+     */
+    bool add(Xapian::docid did, Xapian::termcount doclen);
+
+    /** Empty the set.
+     *
+     *  This restores the state of a set which was never read from a file.
+     */
+    void clear() {
+	bitmap.clear();
+	count = 0;
+	length = 0;
+	revision = 0;
+	modified = false;
+    }
+
+    /** Read the set from a file.
+     *
+     *  @param file	The file to read.
+     *  @param rev	The revision the file was written at.
+     */
+    void read(const std::string& file, Xapian::rev rev);
+
+    /** Write the set to a file.
+     *
+     *  The file is written under a temporary name and renamed into place.
+     *
+     *  @param file	The file to write.
+     *  @param rev	The revision being written.
+     *  @param flags	Xapian::DB_NO_SYNC and Xapian::DB_FULL_SYNC are
+     *			respected.
+     */
+    void write(const std::string& file, Xapian::rev rev, int flags);
+};
+
+#endif // XAPIAN_INCLUDED_HONEY_DELETIONS_H
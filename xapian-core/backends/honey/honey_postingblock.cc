@@ -0,0 +1,484 @@
+/** @file
+ * @brief Block-packed encoding of honey posting list data
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "honey_postingblock.h"
+
+#include "backends/postingbitmap.h"
+#include "omassert.h"
+#include "pack.h"
+#include "xapian/error.h"
+
+#ifdef HAVE_X86_SIMD_DISPATCH
+# include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace Honey {
+
+/// Tables for decoding the four values described by a control byte.
+struct VByteTables {
+    /// Total number of data bytes for each control byte.
+    unsigned char length[256];
+
+    /// Byte shuffle which expands the data bytes to four 32-bit values.
+    alignas(16) unsigned char shuffle[256][16];
+
+    VByteTables() {
+	for (unsigned c = 0; c != 256; ++c) {
+	    unsigned offset = 0;
+	    for (unsigned k = 0; k != 4; ++k) {
+		unsigned len = ((c >> (2 * k)) & 3) + 1;
+		for (unsigned j = 0; j != 4; ++j) {
+		    // 0x80 makes the shuffle zero the byte.
+		    shuffle[c][4 * k + j] = j < len ? offset + j : 0x80;
+		}
+		offset += len;
+	    }
+	    length[c] = offset;
+	}
+    }
+};
+
+static const VByteTables vbyte_tables;
+
+/** Decode values @a i to @a n - 1 one at a time.
+ *
+ *  @return Pointer after the data, or NULL if it's truncated.
+ */
+static const unsigned char*
+decode_vbyte_tail(const unsigned char* ctrl,
+		  const unsigned char* data,
+		  const unsigned char* end,
+		  unsigned i, unsigned n,
+		  uint32_t* out)
+{
+    for ( ; i != n; ++i) {
+	unsigned len = ((ctrl[i / 4] >> (2 * (i % 4))) & 3) + 1;
+	if (rare(unsigned(end - data) < len))
+	    return NULL;
+	uint32_t v = 0;
+	for (unsigned j = 0; j != len; ++j) {
+	    v |= uint32_t(data[j]) << (8 * j);
+	}
+	out[i] = v;
+	data += len;
+    }
+    return data;
+}
+
+static const unsigned char*
+decode_vbyte_scalar(const unsigned char* ctrl,
+		    const unsigned char* data,
+		    const unsigned char* end,
+		    unsigned n,
+		    uint32_t* out)
+{
+    return decode_vbyte_tail(ctrl, data, end, 0, n, out);
+}
+
+static void
+docids_from_deltas_scalar(uint32_t* values, unsigned n, uint32_t base)
+{
+    for (unsigned i = 0; i != n; ++i) {
+	base += values[i] + 1;
+	values[i] = base;
+    }
+}
+
+#ifdef HAVE_X86_SIMD_DISPATCH
+__attribute__((target("sse4.1")))
+static const unsigned char*
+decode_vbyte_sse41_tail(const unsigned char* ctrl,
+			const unsigned char* data,
+			const unsigned char* end,
+			unsigned i, unsigned n,
+			uint32_t* out)
+{
+    // Each 16 byte load may read past the data for these four values, so
+    // only use it while that can't read past the end.
+    while (i + 4 <= n && end - data >= 16) {
+	unsigned c = ctrl[i / 4];
+	__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+	__m128i s = _mm_load_si128(reinterpret_cast<const __m128i*>(
+					vbyte_tables.shuffle[c]));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+			 _mm_shuffle_epi8(v, s));
+	data += vbyte_tables.length[c];
+	i += 4;
+    }
+    return decode_vbyte_tail(ctrl, data, end, i, n, out);
+}
+
+__attribute__((target("sse4.1")))
+static const unsigned char*
+decode_vbyte_sse41(const unsigned char* ctrl,
+		   const unsigned char* data,
+		   const unsigned char* end,
+		   unsigned n,
+		   uint32_t* out)
+{
+    return decode_vbyte_sse41_tail(ctrl, data, end, 0, n, out);
+}
+
+__attribute__((target("avx2")))
+static const unsigned char*
+decode_vbyte_avx2(const unsigned char* ctrl,
+		  const unsigned char* data,
+		  const unsigned char* end,
+		  unsigned n,
+		  uint32_t* out)
+{
+    unsigned i = 0;
+    // Decode eight values at once, with the data for each group of four in
+    // one 128-bit lane.
+    while (i + 8 <= n && end - data >= 32) {
+	unsigned c0 = ctrl[i / 4];
+	unsigned c1 = ctrl[i / 4 + 1];
+	const unsigned char* data1 = data + vbyte_tables.length[c0];
+	__m256i v = _mm256_inserti128_si256(
+	    _mm256_castsi128_si256(
+		_mm_loadu_si128(reinterpret_cast<const __m128i*>(data))),
+	    _mm_loadu_si128(reinterpret_cast<const __m128i*>(data1)), 1);
+	__m256i s = _mm256_inserti128_si256(
+	    _mm256_castsi128_si256(
+		_mm_load_si128(reinterpret_cast<const __m128i*>(
+				    vbyte_tables.shuffle[c0]))),
+	    _mm_load_si128(reinterpret_cast<const __m128i*>(
+				vbyte_tables.shuffle[c1])), 1);
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+			    _mm256_shuffle_epi8(v, s));
+	data = data1 + vbyte_tables.length[c1];
+	i += 8;
+    }
+    return decode_vbyte_sse41_tail(ctrl, data, end, i, n, out);
+}
+
+__attribute__((target("sse4.1")))
+static void
+docids_from_deltas_sse41(uint32_t* values, unsigned n, uint32_t base)
+{
+    unsigned i = 0;
+    __m128i prev = _mm_set1_epi32(int(base));
+    const __m128i one = _mm_set1_epi32(1);
+    for ( ; i + 4 <= n; i += 4) {
+	__m128i* ptr = reinterpret_cast<__m128i*>(values + i);
+	__m128i v = _mm_add_epi32(_mm_loadu_si128(ptr), one);
+	// Prefix sum within the vector.
+	v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+	v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+	v = _mm_add_epi32(v, prev);
+	_mm_storeu_si128(ptr, v);
+	prev = _mm_shuffle_epi32(v, 0xff);
+    }
+    if (i != n) {
+	docids_from_deltas_scalar(values + i, n - i,
+				  uint32_t(_mm_cvtsi128_si32(prev)));
+    }
+}
+
+__attribute__((target("avx2")))
+static void
+docids_from_deltas_avx2(uint32_t* values, unsigned n, uint32_t base)
+{
+    unsigned i = 0;
+    __m256i prev = _mm256_set1_epi32(int(base));
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i last = _mm256_set1_epi32(7);
+    for ( ; i + 8 <= n; i += 8) {
+	__m256i* ptr = reinterpret_cast<__m256i*>(values + i);
+	__m256i v = _mm256_add_epi32(_mm256_loadu_si256(ptr), one);
+	// Prefix sum within each 128-bit lane.
+	v = _mm256_add_epi32(v, _mm256_slli_si256(v, 4));
+	v = _mm256_add_epi32(v, _mm256_slli_si256(v, 8));
+	// Add the total of the low lane to the high lane.
+	__m256i low_total = _mm256_shuffle_epi32(v, 0xff);
+	v = _mm256_add_epi32(v, _mm256_permute2x128_si256(low_total,
+							  low_total, 0x08));
+	v = _mm256_add_epi32(v, prev);
+	_mm256_storeu_si256(ptr, v);
+	prev = _mm256_permutevar8x32_epi32(v, last);
+    }
+    if (i != n) {
+	docids_from_deltas_scalar(values + i, n - i,
+				  uint32_t(_mm256_extract_epi32(prev, 0)));
+    }
+}
+#endif
+
+typedef const unsigned char* (*vbyte_decoder)(const unsigned char*,
+					      const unsigned char*,
+					      const unsigned char*,
+					      unsigned,
+					      uint32_t*);
+
+typedef void (*delta_decoder)(uint32_t*, unsigned, uint32_t);
+
+#ifdef HAVE_X86_SIMD_DISPATCH
+static vbyte_decoder
+select_vbyte_decoder()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+	return decode_vbyte_avx2;
+    if (__builtin_cpu_supports("sse4.1"))
+	return decode_vbyte_sse41;
+    return decode_vbyte_scalar;
+}
+
+static delta_decoder
+select_delta_decoder()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+	return docids_from_deltas_avx2;
+    if (__builtin_cpu_supports("sse4.1"))
+	return docids_from_deltas_sse41;
+    return docids_from_deltas_scalar;
+}
+
+static const vbyte_decoder vbyte_decode = select_vbyte_decoder();
+static const delta_decoder delta_decode = select_delta_decoder();
+#else
+static const vbyte_decoder vbyte_decode = decode_vbyte_scalar;
+static const delta_decoder delta_decode = docids_from_deltas_scalar;
+#endif
+
+bool
+decode_vbyte(const char** p, const char* end, unsigned n, uint32_t* out)
+{
+    AssertRel(n, <=, POSTING_BLOCK_MAX);
+    auto ctrl = reinterpret_cast<const unsigned char*>(*p);
+    size_t ctrl_len = (n + 3) / 4;
+    if (rare(size_t(end - *p) < ctrl_len))
+	return false;
+    auto data = vbyte_decode(ctrl, ctrl + ctrl_len,
+			     reinterpret_cast<const unsigned char*>(end),
+			     n, out);
+    if (rare(data == NULL))
+	return false;
+    *p = reinterpret_cast<const char*>(data);
+    return true;
+}
+
+void
+docids_from_deltas(uint32_t* values, unsigned n, uint32_t base)
+{
+    delta_decode(values, n, base);
+}
+
+/** Check if an unsigned value fits in 32 bits.
+ *
+ *  Shifting twice avoids warnings about the comparison always being true and
+ *  undefined behaviour from shifting by the width of the type when T is 32
+ *  bits.
+ */
+template<typename T>
+static inline bool
+fits_in_32_bits(T v)
+{
+    return (v >> 16 >> 16) == 0;
+}
+
+/// Append @a n values StreamVByte encoded to @a out.
+template<typename T>
+static void
+encode_vbyte(const T* values, unsigned n, string& out)
+{
+    size_t ctrl_pos = out.size();
+    out.append((n + 3) / 4, '\0');
+    for (unsigned i = 0; i != n; ++i) {
+	uint32_t v = uint32_t(values[i]);
+	unsigned len = 1;
+	while (len < 4 && (v >> (8 * len)) != 0) ++len;
+	out[ctrl_pos + i / 4] |= char((len - 1) << (2 * (i % 4)));
+	for (unsigned j = 0; j != len; ++j) {
+	    out += char(v >> (8 * j));
+	}
+    }
+}
+
+void
+encode_posting_blocks(const char* p, const char* end, bool have_wdfs,
+		      string& out)
+{
+    Xapian::docid deltas[POSTING_BLOCK_MAX];
+    Xapian::termcount wdfs[POSTING_BLOCK_MAX];
+    string data;
+    while (p != end) {
+	unsigned n = 0;
+	Xapian::docid delta_sum = 0;
+	bool fits = true;
+	do {
+	    if (!unpack_uint(&p, end, &deltas[n]) ||
+		(have_wdfs && !unpack_uint(&p, end, &wdfs[n]))) {
+		throw Xapian::DatabaseCorruptError("Bad posting list data");
+	    }
+	    delta_sum += deltas[n];
+	    if (!fits_in_32_bits(deltas[n]) ||
+		(have_wdfs && !fits_in_32_bits(wdfs[n]))) {
+		fits = false;
+	    }
+	} while (++n != POSTING_BLOCK_MAX && p != end);
+
+	data.resize(0);
+	bool bitmap = false;
+	if (fits) {
+	    encode_vbyte(deltas, n, data);
+	    size_t nbits = size_t(delta_sum) + n;
+	    if (posting_bitmap_size(nbits) < data.size()) {
+		// The block is dense enough that a bitmap is smaller.
+		data.assign(posting_bitmap_size(nbits), '\0');
+		auto bits = reinterpret_cast<unsigned char*>(&data[0]);
+		size_t k = 0;
+		for (unsigned i = 0; i != n; ++i) {
+		    k += deltas[i];
+		    posting_bitmap_set(bits, k);
+		    ++k;
+		}
+		bitmap = true;
+	    }
+	    if (have_wdfs) {
+		encode_vbyte(wdfs, n, data);
+	    }
+	} else {
+	    for (unsigned i = 0; i != n; ++i) {
+		pack_uint(data, deltas[i]);
+		if (have_wdfs) {
+		    pack_uint(data, wdfs[i]);
+		}
+	    }
+	}
+
+	out += char((n - 1) | (fits ? 0 : POSTING_BLOCK_VARINT_FLAG));
+	pack_uint(out, delta_sum);
+	pack_uint(out, data.size() * 2 + bitmap);
+	out += data;
+    }
+}
+
+bool
+decode_posting_block_header(const char** p, const char* end,
+			    unsigned& n, posting_block_type& type,
+			    Xapian::docid& delta_sum,
+			    const char** data_end)
+{
+    if (*p == end)
+	return false;
+    unsigned char header = **p;
+    ++*p;
+    n = (header & ~POSTING_BLOCK_VARINT_FLAG) + 1;
+    size_t len;
+    if (!unpack_uint(p, end, &delta_sum) ||
+	!unpack_uint(p, end, &len) ||
+	(len >> 1) > size_t(end - *p)) {
+	return false;
+    }
+    if (len & 1) {
+	// A bitmap block can't be varint encoded.
+	if (header & POSTING_BLOCK_VARINT_FLAG)
+	    return false;
+	type = POSTING_BLOCK_BITMAP;
+    } else if (header & POSTING_BLOCK_VARINT_FLAG) {
+	type = POSTING_BLOCK_VARINT;
+    } else {
+	type = POSTING_BLOCK_VBYTE;
+    }
+    *data_end = *p + (len >> 1);
+    return true;
+}
+
+bool
+decode_bitmap_docids(const char** p, const char* end, unsigned n,
+		     Xapian::docid delta_sum, Xapian::docid base,
+		     Xapian::docid* out)
+{
+    size_t nbits = size_t(delta_sum) + n;
+    size_t nbytes = posting_bitmap_size(nbits);
+    if (rare(nbytes > size_t(end - *p)))
+	return false;
+    auto bits = reinterpret_cast<const unsigned char*>(*p);
+    size_t k = 0;
+    for (unsigned i = 0; i != n; ++i) {
+	k = posting_bitmap_find(bits, nbits, k);
+	if (rare(k == nbits))
+	    return false;
+	out[i] = base + 1 + Xapian::docid(k);
+	++k;
+    }
+    // The last entry must be the last docid in the block.
+    if (rare(k != nbits))
+	return false;
+    *p += nbytes;
+    return true;
+}
+
+void
+decode_posting_blocks(const char* p, const char* end, bool have_wdfs,
+		      string& out)
+{
+    while (p != end) {
+	unsigned n;
+	posting_block_type type;
+	Xapian::docid delta_sum;
+	const char* data_end;
+	if (!decode_posting_block_header(&p, end, n, type, delta_sum,
+					 &data_end)) {
+	    throw Xapian::DatabaseCorruptError("Bad posting block header");
+	}
+	if (type == POSTING_BLOCK_VARINT) {
+	    out.append(p, data_end - p);
+	} else if (type == POSTING_BLOCK_BITMAP) {
+	    Xapian::docid dids[POSTING_BLOCK_MAX];
+	    uint32_t wdfs[POSTING_BLOCK_MAX];
+	    if (!decode_bitmap_docids(&p, data_end, n, delta_sum, 0, dids) ||
+		(have_wdfs && !decode_vbyte(&p, data_end, n, wdfs)) ||
+		p != data_end) {
+		throw Xapian::DatabaseCorruptError("Bad posting block");
+	    }
+	    Xapian::docid prev = 0;
+	    for (unsigned i = 0; i != n; ++i) {
+		pack_uint(out, dids[i] - prev - 1);
+		prev = dids[i];
+		if (have_wdfs) {
+		    pack_uint(out, wdfs[i]);
+		}
+	    }
+	} else {
+	    uint32_t deltas[POSTING_BLOCK_MAX];
+	    uint32_t wdfs[POSTING_BLOCK_MAX];
+	    if (!decode_vbyte(&p, data_end, n, deltas) ||
+		(have_wdfs && !decode_vbyte(&p, data_end, n, wdfs)) ||
+		p != data_end) {
+		throw Xapian::DatabaseCorruptError("Bad posting block");
+	    }
+	    for (unsigned i = 0; i != n; ++i) {
+		pack_uint(out, deltas[i]);
+		if (have_wdfs) {
+		    pack_uint(out, wdfs[i]);
+		}
+	    }
+	}
+	p = data_end;
+    }
+}
+
+}
@@ -0,0 +1,162 @@
+/** @file
+ * @brief Block-packed encoding of honey posting list data
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_HONEY_POSTINGBLOCK_H
+#define XAPIAN_INCLUDED_HONEY_POSTINGBLOCK_H
+
+#include "xapian/types.h"
+
+#include <cstdint>
+#include <string>
+
+/* The postings in a honey posting list chunk after those stored in the chunk
+ * header are stored in blocks of up to POSTING_BLOCK_MAX entries.  Each entry
+ * has a docid delta (the docid minus the previous docid minus 1) and, if the
+ * wdfs for the term aren't implicit, a wdf.  Each block is:
+ *
+ *  C<(number of entries - 1) | 0x80 if varint encoded>
+ *  I<sum of docid deltas in the block>
+ *  I<length in bytes of the rest of the block * 2 + 1 if a bitmap block>
+ *
+ * followed by either (usually):
+ *
+ *  <StreamVByte encoded docid deltas> [<StreamVByte encoded wdfs>]
+ *
+ * or, if any value won't fit in 32 bits (only possible if Xapian::docid or
+ * Xapian::termcount is a 64-bit type):
+ *
+ *  [I<docid delta> [I<wdf>]]...
+ *
+ * or, for a bitmap block:
+ *
+ *  <bitmap> [<StreamVByte encoded wdfs>]
+ *
+ * where the bitmap has a bit for each docid covered by the block (the sum of
+ * the docid deltas plus the number of entries) with the bit for each entry
+ * set (see postingbitmap.h).  This is used when it's smaller than the
+ * StreamVByte encoded docid deltas, which is the case for dense posting
+ * lists.
+ *
+ * StreamVByte (Lemire et al, https://arxiv.org/abs/1709.08990) stores a 2 bit
+ * length code for each value in a separate array of control bytes (least
+ * significant bits first), followed by the bytes of each value little-endian
+ * with leading zero bytes dropped.  This allows four values to be decoded at
+ * once using a byte shuffle, which we do using SSE4.1 or AVX2 instructions if
+ * the CPU supports them.
+ *
+ * The header lets the reader skip a block without decoding it.
+ */
+
+namespace Honey {
+
+/// Maximum number of entries in a block of postings.
+const unsigned POSTING_BLOCK_MAX = 128;
+
+/// Flag in the first byte of a block indicating varint encoding.
+const unsigned char POSTING_BLOCK_VARINT_FLAG = 0x80;
+
+/// How the entries in a block of postings are encoded.
+enum posting_block_type {
+    POSTING_BLOCK_VBYTE,
+    POSTING_BLOCK_VARINT,
+    POSTING_BLOCK_BITMAP
+};
+
+/** Encode posting data into blocks.
+ *
+ *  @param p		Start of posting data encoded as a sequence of
+ *			pack_uint() docid deltas, each followed by a pack_uint()
+ *			wdf if @a have_wdfs is true.
+ *  @param end		End of the posting data.
+ *  @param have_wdfs	Are wdfs stored in the posting data?
+ *  @param out		The blocks are appended to this.
+ */
+void encode_posting_blocks(const char* p, const char* end, bool have_wdfs,
+			   std::string& out);
+
+/** Decode blocks of posting data.
+ *
+ *  This is the inverse of encode_posting_blocks().
+ *
+ *  @param p		Start of the blocks.
+ *  @param end		End of the blocks.
+ *  @param have_wdfs	Are wdfs stored in the posting data?
+ *  @param out		The posting data as a sequence of pack_uint() encoded
+ *			values is appended to this.
+ */
+void decode_posting_blocks(const char* p, const char* end, bool have_wdfs,
+			   std::string& out);
+
+/** Decode the header of a block of postings.
+ *
+ *  @param p		Pointer to the start of the block, which is updated to
+ *			point to the block's data.
+ *  @param end		End of the posting data.
+ *  @param n		Set to the number of entries in the block.
+ *  @param type		Set to how the block's entries are encoded.
+ *  @param delta_sum	Set to the sum of the docid deltas in the block.
+ *  @param data_end	Set to the end of the block's data.
+ *
+ *  @return false if the header isn't valid.
+ */
+bool decode_posting_block_header(const char** p, const char* end,
+				 unsigned& n, posting_block_type& type,
+				 Xapian::docid& delta_sum,
+				 const char** data_end);
+
+/** Decode the docids from the bitmap in a bitmap block.
+ *
+ *  @param p		Pointer to the bitmap, which is updated to point after
+ *			it.
+ *  @param end		End of the block's data.
+ *  @param n		Number of entries in the block.
+ *  @param delta_sum	Sum of the docid deltas in the block.
+ *  @param base		The docid before the block.
+ *  @param out		Array to store the decoded docids in.
+ *
+ *  @return false if the bitmap isn't valid.
+ */
+bool decode_bitmap_docids(const char** p, const char* end, unsigned n,
+			  Xapian::docid delta_sum, Xapian::docid base,
+			  Xapian::docid* out);
+
+/** Decode @a n StreamVByte encoded values.
+ *
+ *  @param p	Pointer to the control bytes, which is updated to point after
+ *		the encoded values.
+ *  @param end	End of the data which may be read.
+ *  @param n	Number of values to decode (at most POSTING_BLOCK_MAX).
+ *  @param out	Array to store the decoded values in.
+ *
+ *  @return false if the data is truncated.
+ */
+bool decode_vbyte(const char** p, const char* end, unsigned n,
+		  std::uint32_t* out);
+
+/** Convert docid deltas to docids in place.
+ *
+ *  @param values	On entry, the docid deltas.  On exit, the docids.
+ *  @param n		Number of values.
+ *  @param base		The docid before the first delta.
+ */
+void docids_from_deltas(std::uint32_t* values, unsigned n, std::uint32_t base);
+
+}
+
+#endif // XAPIAN_INCLUDED_HONEY_POSTINGBLOCK_H
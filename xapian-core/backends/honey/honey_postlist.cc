@@ -22,12 +22,14 @@
 
 #include "honey_postlist.h"
 
+#include "backends/docidsearch.h"
 #include "honey_cursor.h"
 #include "honey_database.h"
 #include "honey_positionlist.h"
 #include "honey_postlist_encodings.h"
 #include "pack.h"
 
+#include <algorithm>
 #include <string>
 
 using namespace Honey;
@@ -39,9 +41,9 @@ HoneyPostList::update_reader()
     Xapian::docid chunk_last = docid_from_key(term, cursor->current_key);
     if (!chunk_last) return false;
 
-    cursor->read_tag();
-    const string& tag = cursor->current_tag;
-    reader.assign(tag.data(), tag.size(), chunk_last);
+    size_t len;
+    const char* tag = cursor->read_tag_view(len);
+    reader.assign(tag, len, chunk_last);
     return true;
 }
 
@@ -53,6 +55,9 @@ HoneyPostList::HoneyPostList(const HoneyDatabase* db_,
 			     HoneyCursor* cursor_)
     : LeafPostList(term_), cursor(cursor_), db(db_)
 {
+    if (rare(!db->get_deletions().empty()))
+	deletions = &db->get_deletions();
+
     if (!cursor) {
 	// Term not present in db.
 	reader.init();
@@ -61,11 +66,9 @@ HoneyPostList::HoneyPostList(const HoneyDatabase* db_,
 	return;
     }
 
-    cursor->read_tag();
-    const string& chunk = cursor->current_tag;
-
-    const char* p = chunk.data();
-    const char* pend = p + chunk.size();
+    size_t len;
+    const char* p = cursor->read_tag_view(len);
+    const char* pend = p + len;
     // FIXME: Make use of [first,last] ranges to calculate better estimates and
     // potentially to spot subqueries that can't match anything.
     Xapian::doccount tf;
@@ -73,9 +76,11 @@ HoneyPostList::HoneyPostList(const HoneyDatabase* db_,
     Xapian::docid first_did;
     Xapian::termcount first_wdf;
     Xapian::docid chunk_last;
+    Xapian::termcount chunk_wdf_max;
     if (!decode_initial_chunk_header(&p, pend, tf, cf,
 				     first_did, last_did,
-				     chunk_last, first_wdf, wdf_max))
+				     chunk_last, first_wdf, wdf_max,
+				     chunk_wdf_max))
 	throw Xapian::DatabaseCorruptError("Postlist initial chunk header");
 
     Xapian::termcount cf_info = cf;
@@ -107,7 +112,8 @@ HoneyPostList::HoneyPostList(const HoneyDatabase* db_,
     }
 
     reader.init(tf, cf_info);
-    reader.assign(p, pend - p, first_did, last_did, first_wdf);
+    reader.assign(p, pend - p, first_did, chunk_last, first_wdf,
+		  chunk_wdf_max);
 }
 
 HoneyPostList::~HoneyPostList()
@@ -118,9 +124,49 @@ HoneyPostList::~HoneyPostList()
 Xapian::doccount
 HoneyPostList::get_termfreq() const
 {
+    if (rare(deletions)) {
+	// The postings of deleted documents remain until the segment is
+	// merged, so they need to be discounted.
+	if (live_termfreq == Xapian::doccount(-1))
+	    db->get_freqs(term, &live_termfreq, NULL);
+	return live_termfreq;
+    }
     return reader.get_termfreq();
 }
 
+void
+HoneyPostList::count_deleted(Xapian::doccount& tf, Xapian::termcount& cf)
+{
+    Assert(!started);
+    tf = 0;
+    cf = 0;
+    if (!deletions || !cursor) return;
+
+    if (deletions->size() < reader.get_termfreq()) {
+	// Probe the posting list for each deleted document.
+	Xapian::docid did = deletions->find(reader.get_docid());
+	while (did) {
+	    move_to(did);
+	    if (!cursor) break;
+	    Xapian::docid pl_did = reader.get_docid();
+	    if (pl_did == did) {
+		++tf;
+		cf += reader.get_wdf();
+		++pl_did;
+	    }
+	    did = deletions->find(pl_did);
+	}
+    } else {
+	while (cursor) {
+	    if (deletions->contains(reader.get_docid())) {
+		++tf;
+		cf += reader.get_wdf();
+	    }
+	    move_next();
+	}
+    }
+}
+
 LeafPostList*
 HoneyPostList::open_nearby_postlist(const string& term_,
 				    bool need_read_pos) const
@@ -130,8 +176,11 @@ HoneyPostList::open_nearby_postlist(const string& term_,
     // FIXME: Once Honey supports writing, we need to return NULL here if the
     // DB is writable and has uncommitted modifications.
 
-    unique_ptr<HoneyCursor> new_cursor(new HoneyCursor(*cursor));
-    if (!new_cursor->find_exact(Honey::make_postingchunk_key(term_))) {
+    string key = Honey::make_postingchunk_key(term_);
+    unique_ptr<HoneyCursor> new_cursor;
+    if (db->postlist_table.may_contain(key))
+	new_cursor.reset(new HoneyCursor(*cursor));
+    if (!new_cursor || !new_cursor->find_exact(key)) {
 	// FIXME: Return NULL here and handle that in Query::Internal
 	// postlist() methods as we build the PostList tree.
 	// We also need to distinguish this case from "open_nearby_postlist()
@@ -165,30 +214,33 @@ HoneyPostList::at_end() const
     return cursor == NULL;
 }
 
+const Xapian::docid*
+HoneyPostList::get_docid_block(const Xapian::docid*& block_end) const
+{
+    // The block may include deleted documents.
+    if (!started || !cursor || deletions) return NULL;
+    return reader.get_docid_block(block_end);
+}
+
 PositionList*
 HoneyPostList::open_position_list() const
 {
     return new HoneyPositionList(db->position_table, get_docid(), term);
 }
 
-PostList*
-HoneyPostList::next(double)
+void
+HoneyPostList::move_next()
 {
-    if (!started) {
-	started = true;
-	return NULL;
-    }
-
     Assert(!reader.at_end());
 
     if (reader.next())
-	return NULL;
+	return;
 
     if (reader.get_docid() >= last_did) {
 	// We've reached the end.
 	delete cursor;
 	cursor = NULL;
-	return NULL;
+	return;
     }
 
     if (rare(!cursor->next()))
@@ -197,32 +249,26 @@ HoneyPostList::next(double)
 
     if (rare(!update_reader()))
 	throw Xapian::DatabaseCorruptError("Missing postlist chunk");
-
-    return NULL;
 }
 
-PostList*
-HoneyPostList::skip_to(Xapian::docid did, double)
+void
+HoneyPostList::move_to(Xapian::docid did)
 {
-    if (!started) {
-	started = true;
-    }
-
     if (rare(!cursor)) {
 	// No-op if already at_end.
-	return NULL;
+	return;
     }
 
     Assert(!reader.at_end());
 
     if (reader.skip_to(did))
-	return NULL;
+	return;
 
     if (did > last_did) {
 	// We've reached the end.
 	delete cursor;
 	cursor = NULL;
-	return NULL;
+	return;
     }
 
     // At this point we know that skip_to() must succeed since last_did
@@ -242,7 +288,26 @@ HoneyPostList::skip_to(Xapian::docid did, double)
     if (rare(!reader.skip_to(did)))
 	throw Xapian::DatabaseCorruptError("Postlist chunk doesn't contain "
 					   "its last entry");
+}
+
+PostList*
+HoneyPostList::next(double)
+{
+    if (!started) {
+	started = true;
+    } else {
+	move_next();
+    }
+    skip_deleted();
+    return NULL;
+}
 
+PostList*
+HoneyPostList::skip_to(Xapian::docid did, double)
+{
+    started = true;
+    move_to(did);
+    skip_deleted();
     return NULL;
 }
 
@@ -252,6 +317,17 @@ HoneyPostList::get_wdf_upper_bound() const
     return wdf_max;
 }
 
+Xapian::termcount
+HoneyPostList::get_block_wdf_upper_bound(Xapian::docid& block_last) const
+{
+    if (rare(!cursor)) {
+	block_last = Xapian::docid(-1);
+	return 0;
+    }
+    block_last = reader.get_chunk_last();
+    return reader.get_chunk_wdf_max();
+}
+
 string
 HoneyPostList::get_description() const
 {
@@ -288,36 +364,151 @@ HoneyPosPostList::get_description() const
 
 namespace Honey {
 
+/// Decode StreamVByte docid deltas directly into 32-bit docids.
+static bool
+decode_docids(const char** p, const char* end, unsigned n,
+	      Xapian::docid base, uint32_t* out)
+{
+    if (!decode_vbyte(p, end, n, out))
+	return false;
+    docids_from_deltas(out, n, base);
+    return true;
+}
+
+/// Decode StreamVByte docid deltas into wider docids.
+template<typename T>
+static bool
+decode_docids(const char** p, const char* end, unsigned n,
+	      Xapian::docid base, T* out)
+{
+    uint32_t deltas[POSTING_BLOCK_MAX];
+    if (!decode_vbyte(p, end, n, deltas))
+	return false;
+    for (unsigned i = 0; i != n; ++i) {
+	base += deltas[i] + 1;
+	out[i] = base;
+    }
+    return true;
+}
+
+/// Decode StreamVByte wdfs directly into 32-bit wdfs.
+static bool
+decode_wdfs(const char** p, const char* end, unsigned n, uint32_t* out)
+{
+    return decode_vbyte(p, end, n, out);
+}
+
+/// Decode StreamVByte wdfs into wider wdfs.
+template<typename T>
+static bool
+decode_wdfs(const char** p, const char* end, unsigned n, T* out)
+{
+    uint32_t wdfs[POSTING_BLOCK_MAX];
+    if (!decode_vbyte(p, end, n, wdfs))
+	return false;
+    copy(wdfs, wdfs + n, out);
+    return true;
+}
+
+void
+PostingChunkReader::check_flat_wdf()
+{
+    if (collfreq_info & TOP_BIT_SET(decltype(collfreq_info))) {
+	wdf = collfreq_info &~ TOP_BIT_SET(decltype(collfreq_info));
+	collfreq_info = 0;
+    }
+}
+
+Xapian::docid
+PostingChunkReader::read_block(Xapian::docid base)
+{
+    unsigned n;
+    posting_block_type type;
+    Xapian::docid delta_sum;
+    const char* data_end;
+    if (!decode_posting_block_header(&p, end, n, type, delta_sum,
+				     &data_end)) {
+	throw Xapian::DatabaseCorruptError("postlist block header");
+    }
+    if (type == POSTING_BLOCK_VARINT) {
+	for (unsigned i = 0; i != n; ++i) {
+	    Xapian::docid delta;
+	    if (!unpack_uint(&p, data_end, &delta)) {
+		throw Xapian::DatabaseCorruptError("postlist docid delta");
+	    }
+	    base += delta + 1;
+	    block_dids[i] = base;
+	    if (collfreq_info) {
+		if (!unpack_uint(&p, data_end, &block_wdfs[i])) {
+		    throw Xapian::DatabaseCorruptError("postlist wdf");
+		}
+	    }
+	}
+    } else if (type == POSTING_BLOCK_BITMAP) {
+	if (!decode_bitmap_docids(&p, data_end, n, delta_sum, base,
+				  block_dids) ||
+	    (collfreq_info && !decode_wdfs(&p, data_end, n, block_wdfs))) {
+	    throw Xapian::DatabaseCorruptError("postlist bitmap block");
+	}
+    } else {
+	if (!decode_docids(&p, data_end, n, base, block_dids) ||
+	    (collfreq_info && !decode_wdfs(&p, data_end, n, block_wdfs))) {
+	    throw Xapian::DatabaseCorruptError("postlist block");
+	}
+    }
+    p = data_end;
+    block_pos = 0;
+    block_size = n;
+    return block_dids[n - 1];
+}
+
 void
 PostingChunkReader::assign(const char* p_, size_t len,
 			   Xapian::docid chunk_last)
 {
     const char* pend = p_ + len;
-    if (collfreq_info ?
-	!decode_delta_chunk_header(&p_, pend, chunk_last, did, wdf) :
-	!decode_delta_chunk_header_no_wdf(&p_, pend, chunk_last, did)) {
-	throw Xapian::DatabaseCorruptError("Postlist delta chunk header");
+    check_flat_wdf();
+    if (collfreq_info) {
+	if (!decode_delta_chunk_header(&p_, pend, chunk_last, did, wdf,
+				       chunk_wdf_max)) {
+	    throw Xapian::DatabaseCorruptError("Postlist delta chunk header");
+	}
+    } else {
+	if (!decode_delta_chunk_header_no_wdf(&p_, pend, chunk_last, did)) {
+	    throw Xapian::DatabaseCorruptError("Postlist delta chunk header");
+	}
+	// The wdf is the same for every entry in this chunk.
+	chunk_wdf_max = wdf;
     }
     p = p_;
     end = pend;
     last_did = chunk_last;
+    block_pos = block_size = 0;
 }
 
 void
 PostingChunkReader::assign(const char* p_, size_t len, Xapian::docid did_,
 			   Xapian::docid last_did_in_chunk,
-			   Xapian::termcount wdf_)
+			   Xapian::termcount wdf_,
+			   Xapian::termcount chunk_wdf_max_)
 {
     p = p_;
     end = p_ + len;
     did = did_;
     last_did = last_did_in_chunk;
     wdf = wdf_;
+    chunk_wdf_max = chunk_wdf_max_;
+    block_pos = block_size = 0;
 }
 
 bool
 PostingChunkReader::next()
 {
+    if (block_pos != block_size) {
+	use_block_entry(block_pos);
+	return true;
+    }
+
     if (p == end) {
 	if (termfreq == 2 && did != last_did) {
 	    did = last_did;
@@ -328,23 +519,9 @@ PostingChunkReader::next()
 	return false;
     }
 
-    // The "constant wdf apart from maybe the first entry" case.
-    if (collfreq_info & TOP_BIT_SET(decltype(collfreq_info))) {
-	wdf = collfreq_info &~ TOP_BIT_SET(decltype(collfreq_info));
-	collfreq_info = 0;
-    }
-
-    Xapian::docid delta;
-    if (!unpack_uint(&p, end, &delta)) {
-	throw Xapian::DatabaseCorruptError("postlist docid delta");
-    }
-    did += delta + 1;
-    if (collfreq_info) {
-	if (!unpack_uint(&p, end, &wdf)) {
-	    throw Xapian::DatabaseCorruptError("postlist wdf");
-	}
-    }
-
+    check_flat_wdf();
+    (void)read_block(did);
+    use_block_entry(0);
     return true;
 }
 
@@ -362,6 +539,20 @@ PostingChunkReader::skip_to(Xapian::docid target)
 	return false;
     }
 
+    Xapian::docid base = did;
+    if (block_pos != block_size) {
+	if (target <= block_dids[block_size - 1]) {
+	    // The target is in the block we've already decoded.
+	    auto i = find_docid_ge(block_dids + block_pos,
+				   block_dids + block_size,
+				   target);
+	    use_block_entry(i - block_dids);
+	    return true;
+	}
+	base = block_dids[block_size - 1];
+	block_pos = block_size;
+    }
+
     if (p == end) {
 	// Given the checks above, this must be the termfreq == 2 case with the
 	// current position being on the first entry, and so skip_to() must
@@ -372,41 +563,36 @@ PostingChunkReader::skip_to(Xapian::docid target)
 	return true;
     }
 
-    // The "constant wdf apart from maybe the first entry" case.
-    if (collfreq_info & TOP_BIT_SET(decltype(collfreq_info))) {
-	wdf = collfreq_info &~ TOP_BIT_SET(decltype(collfreq_info));
-	collfreq_info = 0;
-    }
-
-    if (target == last_did) {
-	if (collfreq_info) {
-	    if (!unpack_uint_backwards(&end, p, &wdf))
-		throw Xapian::DatabaseCorruptError("postlist final wdf");
-	}
-	did = last_did;
-	p = end;
-	return true;
-    }
+    check_flat_wdf();
 
-    do {
+    // Skip over blocks which end before target without decoding them.
+    while (true) {
 	if (rare(p == end)) {
 	    // FIXME: Shouldn't happen unless last_did was wrong.
 	    p = NULL;
 	    return false;
 	}
 
-	Xapian::docid delta;
-	if (!unpack_uint(&p, end, &delta)) {
-	    throw Xapian::DatabaseCorruptError("postlist docid delta");
+	const char* q = p;
+	unsigned n;
+	posting_block_type type;
+	Xapian::docid delta_sum;
+	const char* data_end;
+	if (!decode_posting_block_header(&q, end, n, type, delta_sum,
+					 &data_end)) {
+	    throw Xapian::DatabaseCorruptError("postlist block header");
 	}
-	did += delta + 1;
-	if (collfreq_info) {
-	    if (!unpack_uint(&p, end, &wdf)) {
-		throw Xapian::DatabaseCorruptError("postlist wdf");
-	    }
-	}
-    } while (target > did);
+	Xapian::docid block_last = base + delta_sum + n;
+	if (target <= block_last) break;
+	base = block_last;
+	p = data_end;
+    }
 
+    if (rare(read_block(base) < target)) {
+	throw Xapian::DatabaseCorruptError("postlist block docid sum");
+    }
+    auto i = lower_bound(block_dids, block_dids + block_size, target);
+    use_block_entry(i - block_dids);
     return true;
 }
 
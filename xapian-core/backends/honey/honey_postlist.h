@@ -23,7 +23,10 @@
 #define XAPIAN_INCLUDED_HONEY_POSTLIST_H
 
 #include "backends/leafpostlist.h"
+#include "honey_deletions.h"
 #include "honey_positionlist.h"
+#include "honey_postingblock.h"
+#include "omassert.h"
 #include "pack.h"
 
 #include <string>
@@ -85,6 +88,9 @@ class PostingChunkReader {
     /// The last docid in this chunk.
     Xapian::docid last_did;
 
+    /// The maximum wdf in this chunk.
+    Xapian::termcount chunk_wdf_max;
+
     Xapian::doccount termfreq;
 
     /** Value "to do with" collection frequency.
@@ -110,6 +116,36 @@ class PostingChunkReader {
      */
     Xapian::termcount collfreq_info;
 
+    /// Index in block_dids of the entry after the current one.
+    unsigned block_pos = 0;
+
+    /// Number of entries in block_dids.
+    unsigned block_size = 0;
+
+    /// Docids from the most recently decoded block of postings.
+    Xapian::docid block_dids[POSTING_BLOCK_MAX];
+
+    /// Wdfs from the most recently decoded block (if stored explicitly).
+    Xapian::termcount block_wdfs[POSTING_BLOCK_MAX];
+
+    /// Handle the "constant wdf apart from maybe the first entry" case.
+    void check_flat_wdf();
+
+    /** Decode the block of postings at @a p.
+     *
+     *  @param base	The docid before the first entry in the block.
+     *
+     *  @return The last docid in the block.
+     */
+    Xapian::docid read_block(Xapian::docid base);
+
+    /// Move to entry @a i in the decoded block.
+    void use_block_entry(unsigned i) {
+	did = block_dids[i];
+	if (collfreq_info) wdf = block_wdfs[i];
+	block_pos = i + 1;
+    }
+
   public:
     /// Create an uninitialised PostingChunkReader.
     PostingChunkReader() : p(NULL) { }
@@ -131,7 +167,8 @@ class PostingChunkReader {
 
     void assign(const char* p_, size_t len, Xapian::docid did_,
 		Xapian::docid last_did_in_chunk,
-		Xapian::termcount wdf_);
+		Xapian::termcount wdf_,
+		Xapian::termcount chunk_wdf_max_);
 
     bool at_end() const { return p == NULL; }
 
@@ -141,6 +178,23 @@ class PostingChunkReader {
 
     Xapian::termcount get_wdf() const { return wdf; }
 
+    /// Return the last docid in the current chunk.
+    Xapian::docid get_chunk_last() const { return last_did; }
+
+    /// Return the maximum wdf in the current chunk.
+    Xapian::termcount get_chunk_wdf_max() const { return chunk_wdf_max; }
+
+    /// Return the decoded docids from the current one, or NULL.
+    const Xapian::docid* get_docid_block(const Xapian::docid*& block_end) const
+    {
+	// The current entry is only in block_dids if we moved to it from there
+	// (the first entry in a chunk is stored in the chunk header).
+	if (block_pos == 0) return NULL;
+	AssertEq(block_dids[block_pos - 1], did);
+	block_end = block_dids + block_size;
+	return block_dids + block_pos - 1;
+    }
+
     /// Advance, returning false if we've run out of data.
     bool next();
 
@@ -169,6 +223,12 @@ class HoneyPostList : public LeafPostList {
     /// HoneyDatabase to get position table object from.
     const HoneyDatabase* db;
 
+    /// Documents deleted from @a db, or NULL if there aren't any.
+    const HoneyDeletions* deletions = NULL;
+
+    /// Term frequency excluding deleted documents (-1 if not yet counted).
+    mutable Xapian::doccount live_termfreq = Xapian::doccount(-1);
+
     /** Maximum wdf for this postlist.
      *
      *  We store this for honey, so it's exact - not just an upper bound.
@@ -184,6 +244,20 @@ class HoneyPostList : public LeafPostList {
     /// Update @a reader to use the chunk currently pointed to by @a cursor.
     bool update_reader();
 
+    /// Advance to the next entry, including deleted documents.
+    void move_next();
+
+    /// Skip to @a did or the entry after, including deleted documents.
+    void move_to(Xapian::docid did);
+
+    /// Advance past any deleted documents.
+    void skip_deleted() {
+	if (rare(deletions)) {
+	    while (cursor && deletions->contains(reader.get_docid()))
+		move_next();
+	}
+    }
+
   public:
     /// Create HoneyPostList from already positioned @a cursor_.
     HoneyPostList(const HoneyDatabase* db_,
@@ -194,6 +268,13 @@ class HoneyPostList : public LeafPostList {
 
     Xapian::doccount get_termfreq() const;
 
+    /** Count the postings of deleted documents.
+     *
+     *  This walks whichever of the deletions and the postings is shorter, and
+     *  must be called before the list is started.
+     */
+    void count_deleted(Xapian::doccount& tf, Xapian::termcount& cf);
+
     LeafPostList* open_nearby_postlist(const std::string& term_,
 				       bool need_read_pos) const;
 
@@ -209,8 +290,13 @@ class HoneyPostList : public LeafPostList {
 
     PostList* skip_to(Xapian::docid did, double w_min);
 
+    const Xapian::docid*
+    get_docid_block(const Xapian::docid*& block_end) const;
+
     Xapian::termcount get_wdf_upper_bound() const;
 
+    Xapian::termcount get_block_wdf_upper_bound(Xapian::docid& block_last) const;
+
     std::string get_description() const;
 };
 
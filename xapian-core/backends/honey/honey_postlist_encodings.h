@@ -31,6 +31,7 @@ encode_initial_chunk_header(Xapian::doccount termfreq,
 			    Xapian::docid chunk_last,
 			    Xapian::termcount first_wdf,
 			    Xapian::termcount wdf_max,
+			    Xapian::termcount chunk_wdf_max,
 			    std::string& out)
 {
     Assert(termfreq != 0);
@@ -54,6 +55,7 @@ encode_initial_chunk_header(Xapian::doccount termfreq,
 	AssertEq(last, chunk_last);
 	AssertEq(collfreq, wdf_max);
 	AssertEq(collfreq, first_wdf);
+	AssertEq(collfreq, chunk_wdf_max);
     } else if (termfreq == 2) {
 	// A term which only occurs in two documents.  By Zipf's Law these
 	// are also fairly common (typically 10-15% of words in a large
@@ -90,6 +92,7 @@ encode_initial_chunk_header(Xapian::doccount termfreq,
     } else if (collfreq == 0) {
 	AssertEq(first_wdf, 0);
 	AssertEq(wdf_max, 0);
+	AssertEq(chunk_wdf_max, 0);
 	pack_uint(out, 0u);
 	pack_uint(out, termfreq - 3);
 	pack_uint(out, last - first - (termfreq - 1));
@@ -104,9 +107,20 @@ encode_initial_chunk_header(Xapian::doccount termfreq,
 
 	if (first_wdf >= collfreq - first_wdf - (termfreq - 2)) {
 	    AssertEq(wdf_max, first_wdf);
+	    AssertEq(chunk_wdf_max, first_wdf);
 	} else {
 	    AssertRel(wdf_max, >=, first_wdf);
 	    pack_uint(out, wdf_max - first_wdf);
+	    if (chunk_last != last) {
+		// Store the maximum wdf in this chunk so the matcher can
+		// bound the weight of each block of postings.  If this is
+		// the only chunk then it's the same as wdf_max.
+		AssertRel(chunk_wdf_max, >=, first_wdf);
+		AssertRel(chunk_wdf_max, <=, wdf_max);
+		pack_uint(out, wdf_max - chunk_wdf_max);
+	    } else {
+		AssertEq(chunk_wdf_max, wdf_max);
+	    }
 	}
     }
 }
@@ -119,7 +133,8 @@ decode_initial_chunk_header(const char** p, const char* end,
 			    Xapian::docid& last,
 			    Xapian::docid& chunk_last,
 			    Xapian::termcount& first_wdf,
-			    Xapian::termcount& wdf_max)
+			    Xapian::termcount& wdf_max,
+			    Xapian::termcount& chunk_wdf_max)
 {
     if (!unpack_uint(p, end, &first)) {
 	return false;
@@ -134,7 +149,7 @@ decode_initial_chunk_header(const char** p, const char* end,
 	// Single occurrence term.
 	termfreq = 1;
 	chunk_last = last = first;
-	wdf_max = first_wdf = collfreq;
+	chunk_wdf_max = wdf_max = first_wdf = collfreq;
 	return true;
     }
 
@@ -147,6 +162,7 @@ decode_initial_chunk_header(const char** p, const char* end,
 	termfreq = 2;
 	first_wdf = collfreq / 2;
 	wdf_max = std::max(first_wdf, collfreq - first_wdf);
+	chunk_wdf_max = wdf_max;
 	return true;
     }
 
@@ -160,6 +176,7 @@ decode_initial_chunk_header(const char** p, const char* end,
 	chunk_last = last = first + termfreq + 1;
 	termfreq = 2;
 	wdf_max = std::max(first_wdf, collfreq - first_wdf);
+	chunk_wdf_max = wdf_max;
 	return true;
     }
 
@@ -171,7 +188,7 @@ decode_initial_chunk_header(const char** p, const char* end,
     chunk_last += first;
 
     if (collfreq == 0) {
-	wdf_max = first_wdf = 0;
+	chunk_wdf_max = wdf_max = first_wdf = 0;
     } else {
 	collfreq += (termfreq - 1);
 	if (!unpack_uint(p, end, &first_wdf)) {
@@ -179,12 +196,21 @@ decode_initial_chunk_header(const char** p, const char* end,
 	}
 	++first_wdf;
 	if (first_wdf >= collfreq - first_wdf - (termfreq - 2)) {
-	    wdf_max = first_wdf;
+	    chunk_wdf_max = wdf_max = first_wdf;
 	} else {
 	    if (!unpack_uint(p, end, &wdf_max)) {
 		return false;
 	    }
 	    wdf_max += first_wdf;
+	    if (chunk_last != last) {
+		if (!unpack_uint(p, end, &chunk_wdf_max) ||
+		    chunk_wdf_max > wdf_max - first_wdf) {
+		    return false;
+		}
+		chunk_wdf_max = wdf_max - chunk_wdf_max;
+	    } else {
+		chunk_wdf_max = wdf_max;
+	    }
 	}
     }
 
@@ -247,25 +273,31 @@ inline void
 encode_delta_chunk_header(Xapian::docid chunk_first,
 			  Xapian::docid chunk_last,
 			  Xapian::termcount chunk_first_wdf,
+			  Xapian::termcount chunk_wdf_max,
 			  std::string& out)
 {
     Assert(chunk_first_wdf != 0);
+    AssertRel(chunk_wdf_max, >=, chunk_first_wdf);
     pack_uint(out, chunk_last - chunk_first);
     pack_uint(out, chunk_first_wdf - 1);
+    pack_uint(out, chunk_wdf_max - chunk_first_wdf);
 }
 
 inline bool
 decode_delta_chunk_header(const char** p, const char* end,
 			  Xapian::docid chunk_last,
 			  Xapian::docid& chunk_first,
-			  Xapian::termcount& chunk_first_wdf)
+			  Xapian::termcount& chunk_first_wdf,
+			  Xapian::termcount& chunk_wdf_max)
 {
     if (!unpack_uint(p, end, &chunk_first) ||
-	!unpack_uint(p, end, &chunk_first_wdf)) {
+	!unpack_uint(p, end, &chunk_first_wdf) ||
+	!unpack_uint(p, end, &chunk_wdf_max)) {
 	return false;
     }
     chunk_first = chunk_last - chunk_first;
     ++chunk_first_wdf;
+    chunk_wdf_max += chunk_first_wdf;
     return true;
 }
 
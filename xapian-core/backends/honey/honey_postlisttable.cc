@@ -41,9 +41,12 @@ HoneyPostListTable::open_post_list(const HoneyDatabase* db,
 {
     Assert(!term.empty());
     // Try to position cursor first so we avoid creating HoneyPostList objects
-    // for terms which don't exist.
-    unique_ptr<HoneyCursor> cursor(cursor_get());
-    if (!cursor->find_exact(Honey::make_postingchunk_key(term))) {
+    // for terms which don't exist.  If the Bloom filter says the term isn't
+    // present we don't need a cursor at all.
+    string key = Honey::make_postingchunk_key(term);
+    unique_ptr<HoneyCursor> cursor;
+    if (may_contain(key)) cursor.reset(cursor_get());
+    if (!cursor || !cursor->find_exact(key)) {
 	// FIXME: Return NULL here and handle that in Query::Internal
 	// postlist() methods as we build the PostList tree.
 	// return NULL;
@@ -146,8 +149,9 @@ HoneyPostListTable::get_wdf_upper_bound(const std::string& term) const
     Xapian::docid chunk_last;
     Xapian::termcount first_wdf;
     Xapian::termcount wdf_max;
+    Xapian::termcount chunk_wdf_max;
     if (!decode_initial_chunk_header(&p, pend, tf, cf, first, last, chunk_last,
-				     first_wdf, wdf_max))
+				     first_wdf, wdf_max, chunk_wdf_max))
 	throw Xapian::DatabaseCorruptError("Postlist initial chunk header");
     return wdf_max;
 }
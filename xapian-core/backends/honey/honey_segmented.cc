@@ -0,0 +1,1454 @@
+/** @file
+ * @brief Updatable database made of immutable honey segments
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "honey_segmented.h"
+
+// The buffer of new documents is a glass database.
+#ifdef XAPIAN_HAS_GLASS_BACKEND
+
+#include "backends/backends.h"
+#include "backends/documentinternal.h"
+#include "fd.h"
+#include "fileutils.h"
+#include "filetests.h"
+#include "honey_segmentedpostlist.h"
+#include "honey_segmentedvaluelist.h"
+#include "io_utils.h"
+#include "omassert.h"
+#include "pack.h"
+#include "parseint.h"
+#include "posixy_wrapper.h"
+#include "str.h"
+#include "stringutils.h"
+#include "xapian/constants.h"
+#include "xapian/database.h"
+#include "xapian/document.h"
+#include "xapian/error.h"
+#include "xapian/postingiterator.h"
+
+#include "../glass/glass_database.h"
+#include "../multi/multi_alltermslist.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <ostream>
+#include <type_traits>
+#include "safedirent.h"
+#include "safefcntl.h"
+#include "safesysstat.h"
+#include "safeunistd.h"
+
+using namespace std;
+using Xapian::Internal::intrusive_ptr;
+
+#define MANIFEST_MAGIC "xhyseg01"
+#define MANIFEST_MAGIC_LEN 8
+
+[[noreturn]]
+static void
+throw_doc_not_found(Xapian::docid did)
+{
+    string message = "Document ID not in use: ";
+    message += str(did);
+    throw Xapian::DocNotFoundError(message);
+}
+
+[[noreturn]]
+static void
+throw_closed()
+{
+    throw Xapian::DatabaseClosedError("Database has been closed");
+}
+
+HoneySegmentedDatabase::Segment::Segment(unsigned number_,
+					 Xapian::rev del_rev_,
+					 HoneyDatabase* db_)
+    : number(number_), del_rev(del_rev_), db(db_)
+{
+    db->get_used_docid_range(first, last);
+}
+
+HoneySegmentedDatabase::HoneySegmentedDatabase(const string& path_,
+					       int flags_,
+					       int mmap_flags_)
+    : Xapian::Database::Internal(flags_ == Xapian::DB_READONLY_ ?
+				 TRANSACTION_READONLY :
+				 TRANSACTION_NONE),
+      path(path_),
+      flags(flags_),
+      mmap_flags(mmap_flags_),
+      lock(path_),
+      merge_done(false)
+{
+    if (is_read_only()) {
+	Manifest manifest;
+	if (!read_manifest(manifest)) {
+	    string msg("No segmented honey database found at path '");
+	    msg += path;
+	    msg += '\'';
+	    throw Xapian::DatabaseNotFoundError(msg);
+	}
+	open_revision(manifest);
+	return;
+    }
+
+    const char* p = getenv("XAPIAN_FLUSH_THRESHOLD");
+    if (p && *p) {
+	if (!parse_unsigned(p, flush_threshold)) {
+	    throw Xapian::InvalidArgumentError("XAPIAN_FLUSH_THRESHOLD must "
+					       "be a non-negative integer");
+	}
+    }
+    p = getenv("XAPIAN_SEGMENT_MERGE_FACTOR");
+    if (p && *p) {
+	if (!parse_unsigned(p, merge_factor)) {
+	    throw Xapian::InvalidArgumentError("XAPIAN_SEGMENT_MERGE_FACTOR "
+					       "must be a non-negative "
+					       "integer");
+	}
+    }
+
+    open_writable();
+}
+
+HoneySegmentedDatabase::~HoneySegmentedDatabase()
+{
+    // Install any running merge in the final commit rather than starting
+    // another which we'd have to throw away.
+    closing = true;
+    try {
+	wait_for_merge();
+    } catch (...) {
+    }
+    if (!closed) dtor_called();
+    if (merge_thread.joinable()) merge_thread.join();
+    if (merge) {
+	// The merge didn't get installed, so its output isn't referenced.
+	try {
+	    removedir(segment_path(merge->output));
+	} catch (...) {
+	}
+    }
+    if (buffer.get() && !closed) {
+	try {
+	    buffer->cancel();
+	    buffer->close();
+	    removedir(path + "/buffer");
+	} catch (...) {
+	}
+    }
+}
+
+bool
+HoneySegmentedDatabase::exists(const string& path_)
+{
+    return file_exists(path_ + "/" HONEY_SEGMENTED_MANIFEST);
+}
+
+size_t
+HoneySegmentedDatabase::check(const string& path_, int opts, ostream* out)
+{
+    // Keep the segments open so a writer can't remove them under us.
+    HoneySegmentedDatabase db(path_, Xapian::DB_READONLY_);
+    size_t errors = 0;
+    for (auto&& seg : db.segments) {
+	if (out) *out << "seg" << seg.number << ":\n";
+	errors += Xapian::Database::check(db.segment_path(seg.number), opts,
+					  out);
+    }
+    if (out) *out << "meta:\n";
+    errors += Xapian::Database::check(path_ + "/meta", opts, out);
+    return errors;
+}
+
+string
+HoneySegmentedDatabase::segment_path(unsigned number) const
+{
+    string result = path;
+    result += "/seg";
+    result += str(number);
+    return result;
+}
+
+string
+HoneySegmentedDatabase::deletions_path(unsigned number, Xapian::rev rev) const
+{
+    string result = segment_path(number);
+    result += ".del";
+    result += str(rev);
+    return result;
+}
+
+bool
+HoneySegmentedDatabase::read_manifest(Manifest& manifest) const
+{
+    string file = path + "/" HONEY_SEGMENTED_MANIFEST;
+    string buf;
+    {
+	FD fd(posixy_open(file.c_str(), O_RDONLY | O_BINARY | O_CLOEXEC));
+	if (fd < 0) {
+	    if (errno == ENOENT || errno == ENOTDIR) return false;
+	    throw Xapian::DatabaseOpeningError("Couldn't open " + file, errno);
+	}
+	struct stat statbuf;
+	if (fstat(fd, &statbuf) < 0) {
+	    throw Xapian::DatabaseOpeningError("Couldn't stat " + file, errno);
+	}
+	buf.resize(size_t(statbuf.st_size));
+	(void)io_read(fd, &buf[0], buf.size(), buf.size());
+    }
+
+    const char* p = buf.data();
+    const char* end = p + buf.size();
+    if (buf.size() < MANIFEST_MAGIC_LEN ||
+	memcmp(p, MANIFEST_MAGIC, MANIFEST_MAGIC_LEN) != 0) {
+	throw Xapian::DatabaseCorruptError(file + ": Bad magic");
+    }
+    p += MANIFEST_MAGIC_LEN;
+    size_t n_segments;
+    if (!unpack_uint(&p, end, &manifest.revision) ||
+	size_t(end - p) < Uuid::BINARY_SIZE) {
+	throw Xapian::DatabaseCorruptError(file + ": Bad header");
+    }
+    manifest.uuid.assign(p);
+    p += Uuid::BINARY_SIZE;
+    if (!unpack_uint(&p, end, &manifest.last_docid) ||
+	!unpack_uint(&p, end, &manifest.next_segment) ||
+	!unpack_uint(&p, end, &n_segments)) {
+	throw Xapian::DatabaseCorruptError(file + ": Bad header");
+    }
+    manifest.segments.clear();
+    while (n_segments--) {
+	unsigned number;
+	Xapian::rev del_rev;
+	if (!unpack_uint(&p, end, &number) ||
+	    !unpack_uint(&p, end, &del_rev)) {
+	    throw Xapian::DatabaseCorruptError(file + ": Bad segment list");
+	}
+	manifest.segments.emplace_back(number, del_rev);
+    }
+    if (p != end) {
+	throw Xapian::DatabaseCorruptError(file + ": Junk at end");
+    }
+    return true;
+}
+
+void
+HoneySegmentedDatabase::write_manifest(Xapian::rev new_rev)
+{
+    string buf(MANIFEST_MAGIC, MANIFEST_MAGIC_LEN);
+    pack_uint(buf, new_rev);
+    buf.append(uuid.data(), Uuid::BINARY_SIZE);
+    pack_uint(buf, last_docid);
+    pack_uint(buf, next_segment);
+    pack_uint(buf, segments.size());
+    for (auto&& seg : segments) {
+	pack_uint(buf, seg.number);
+	pack_uint(buf, seg.del_rev);
+    }
+
+    string file = path + "/" HONEY_SEGMENTED_MANIFEST;
+    string tmpfile = file + ".tmp";
+    FD fd(posixy_open(tmpfile.c_str(),
+		      O_WRONLY | O_CREAT | O_TRUNC | O_BINARY | O_CLOEXEC,
+		      0666));
+    if (fd < 0) {
+	throw Xapian::DatabaseError("Couldn't create " + tmpfile, errno);
+    }
+    try {
+	io_write(fd, buf.data(), buf.size());
+	if ((flags & Xapian::DB_NO_SYNC) == 0 &&
+	    ((flags & Xapian::DB_FULL_SYNC) ? !io_full_sync(fd) : !io_sync(fd))) {
+	    throw Xapian::DatabaseError("Couldn't sync " + tmpfile, errno);
+	}
+	if (fd.close() < 0) {
+	    throw Xapian::DatabaseError("Couldn't close " + tmpfile, errno);
+	}
+    } catch (...) {
+	(void)unlink(tmpfile.c_str());
+	throw;
+    }
+    if (!io_tmp_rename(tmpfile, file)) {
+	throw Xapian::DatabaseError("Couldn't update " + file, errno);
+    }
+}
+
+void
+HoneySegmentedDatabase::open_segments(const Manifest& manifest)
+{
+    vector<Segment> new_segments;
+    new_segments.reserve(manifest.segments.size());
+    for (auto&& entry : manifest.segments) {
+	unsigned number = entry.first;
+	Xapian::rev del_rev = entry.second;
+	auto it = find_if(segments.begin(), segments.end(),
+			  [&](const Segment& seg) {
+			      return seg.number == number &&
+				     seg.del_rev == del_rev;
+			  });
+	if (it != segments.end()) {
+	    new_segments.push_back(*it);
+	    continue;
+	}
+	auto db = new HoneyDatabase(segment_path(number), Xapian::DB_READONLY_,
+				    mmap_flags);
+	new_segments.emplace_back(number, del_rev, db);
+	if (del_rev) {
+	    db->get_deletions().read(deletions_path(number, del_rev), del_rev);
+	}
+    }
+    swap(segments, new_segments);
+    last_found = 0;
+    revision = manifest.revision;
+    uuid = manifest.uuid;
+    last_docid = committed_last_docid = manifest.last_docid;
+    next_segment = manifest.next_segment;
+}
+
+void
+HoneySegmentedDatabase::open_revision(Manifest& manifest)
+{
+    while (true) {
+	try {
+	    open_segments(manifest);
+	    if (meta.get()) {
+		meta->reopen();
+	    } else {
+		meta = new GlassDatabase(path + "/meta");
+	    }
+	    return;
+	} catch (const Xapian::DatabaseOpeningError&) {
+	    // A writer may have committed a new revision and removed files
+	    // which we needed, in which case we try again with that revision.
+	    Manifest latest;
+	    if (!read_manifest(latest) ||
+		(latest.revision == manifest.revision &&
+		 memcmp(latest.uuid.data(), manifest.uuid.data(),
+			Uuid::BINARY_SIZE) == 0)) {
+		throw;
+	    }
+	    manifest = std::move(latest);
+	}
+    }
+}
+
+void
+HoneySegmentedDatabase::open_writable()
+{
+    int action = flags & Xapian::DB_ACTION_MASK_;
+    if (action == Xapian::DB_OPEN) {
+	if (!exists(path)) {
+	    string msg("No segmented honey database found at path '");
+	    msg += path;
+	    msg += '\'';
+	    throw Xapian::DatabaseNotFoundError(msg);
+	}
+    } else if (mkdir(path.c_str(), 0755) < 0) {
+	int mkdir_errno = errno;
+	if (mkdir_errno != EEXIST || !dir_exists(path)) {
+	    throw Xapian::DatabaseCreateError(path + ": mkdir failed",
+					      mkdir_errno);
+	}
+    }
+
+    string explanation;
+    bool retry = flags & Xapian::DB_RETRY_LOCK;
+    FlintLock::reason why = lock.lock(true, retry, explanation);
+    if (why != FlintLock::SUCCESS) {
+	lock.throw_databaselockerror(why, path, explanation);
+    }
+
+    Manifest manifest;
+    bool found = read_manifest(manifest);
+    if (found && action == Xapian::DB_CREATE) {
+	throw Xapian::DatabaseCreateError("Can't create new database at '" +
+					  path + "': a database already "
+					  "exists and I was told not to "
+					  "overwrite it");
+    }
+    if (!found && action == Xapian::DB_OPEN) {
+	string msg("No segmented honey database found at path '");
+	msg += path;
+	msg += '\'';
+	throw Xapian::DatabaseNotFoundError(msg);
+    }
+
+    bool create = !found || action == Xapian::DB_CREATE_OR_OVERWRITE;
+    int meta_flags = create ? Xapian::DB_CREATE_OR_OVERWRITE :
+			      Xapian::DB_CREATE_OR_OPEN;
+    meta_flags |= flags & (Xapian::DB_NO_SYNC | Xapian::DB_FULL_SYNC);
+    meta = new GlassWritableDatabase(path + "/meta", meta_flags, 0);
+
+    if (create) {
+	// Keep counting up the revision and segment numbers when overwriting
+	// so readers notice the change.
+	if (found) ++manifest.revision;
+	manifest.uuid.generate();
+	manifest.last_docid = 0;
+	manifest.segments.clear();
+	open_segments(manifest);
+	write_manifest(revision);
+    } else {
+	open_segments(manifest);
+    }
+
+    remove_unreferenced();
+    reset_buffer();
+}
+
+void
+HoneySegmentedDatabase::remove_unreferenced()
+{
+    set<string> referenced;
+    for (auto&& seg : segments) {
+	string name = "seg";
+	name += str(seg.number);
+	referenced.insert(name);
+	if (seg.del_rev) {
+	    name += ".del";
+	    name += str(seg.del_rev);
+	    referenced.insert(name);
+	}
+    }
+
+    DIR* dir = opendir(path.c_str());
+    if (dir == NULL) return;
+    vector<string> unreferenced;
+    while (struct dirent* entry = readdir(dir)) {
+	string name(entry->d_name);
+	if ((startswith(name, "seg") && referenced.count(name) == 0) ||
+	    name == "buffer" || name == "merge" || endswith(name, ".tmp")) {
+	    unreferenced.push_back(path + "/" + name);
+	}
+    }
+    closedir(dir);
+
+    for (auto&& file : unreferenced) {
+	if (dir_exists(file)) {
+	    removedir(file);
+	} else {
+	    (void)unlink(file.c_str());
+	}
+    }
+}
+
+void
+HoneySegmentedDatabase::remove_obsolete()
+{
+    // The files are no longer referenced, so failing to remove them just
+    // leaves them for remove_unreferenced() to clean up next time.
+    for (auto&& file : obsolete) {
+	try {
+	    if (dir_exists(file)) {
+		removedir(file);
+	    } else {
+		(void)unlink(file.c_str());
+	    }
+	} catch (const Xapian::DatabaseError&) {
+	}
+    }
+    obsolete.clear();
+}
+
+void
+HoneySegmentedDatabase::reset_buffer()
+{
+    string buffer_path = path + "/buffer";
+    if (buffer.get()) {
+	buffer->cancel();
+	buffer->close();
+	buffer = NULL;
+    }
+    removedir(buffer_path);
+    buffer = new GlassWritableDatabase(buffer_path,
+				       Xapian::DB_CREATE | Xapian::DB_NO_SYNC,
+				       0);
+    buffer_docs.clear();
+    buffer_modified = false;
+}
+
+void
+HoneySegmentedDatabase::flush_buffer()
+{
+    Assert(!buffer_docs.empty());
+    buffer->commit();
+
+    unsigned number = next_segment++;
+    string segdir = segment_path(number);
+    if (mkdir(segdir.c_str(), 0755) < 0) {
+	throw Xapian::DatabaseError("Couldn't create " + segdir, errno);
+    }
+    try {
+	vector<const Xapian::Database::Internal*> sources(1, buffer.get());
+	vector<Xapian::docid> offset(1, 0);
+	HoneyDatabase::compact(NULL, segdir.c_str(), -1,
+			       Xapian::DB_BACKEND_GLASS, sources, offset,
+			       Xapian::Compactor::STANDARD, 0,
+			       *buffer_docs.rbegin());
+	segments.emplace_back(number, 0,
+			      new HoneyDatabase(segdir, Xapian::DB_READONLY_,
+						mmap_flags));
+    } catch (...) {
+	try {
+	    removedir(segdir);
+	} catch (...) {
+	}
+	throw;
+    }
+
+    // The documents are now in the new segment.
+    reset_buffer();
+}
+
+void
+HoneySegmentedDatabase::check_flush_threshold()
+{
+    ++change_count;
+    bool flush;
+    if (flush_memory_limit) {
+	flush = buffer->get_buffered_memory() >= flush_memory_limit ||
+		(flush_threshold && change_count >= flush_threshold);
+    } else {
+	flush = change_count >= (flush_threshold ? flush_threshold : 10000);
+    }
+    if (flush && !transaction_active()) commit();
+}
+
+size_t
+HoneySegmentedDatabase::find_segment(Xapian::docid did) const
+{
+    size_t n = segments.size();
+    if (n == 0) return 0;
+    // Lookups tend to be for docids near the previous one, so start with
+    // the segment we found last time.
+    if (last_found >= n) last_found = 0;
+    size_t i = last_found;
+    do {
+	const Segment& seg = segments[i];
+	if (did >= seg.first && did <= seg.last &&
+	    seg.db->document_exists(did)) {
+	    last_found = i;
+	    return i;
+	}
+	if (++i == n) i = 0;
+    } while (i != last_found);
+    return n;
+}
+
+const Xapian::Database::Internal*
+HoneySegmentedDatabase::find_shard(Xapian::docid did) const
+{
+    if (buffer_docs.count(did)) return buffer.get();
+    size_t i = find_segment(did);
+    if (i == segments.size()) return NULL;
+    return segments[i].db.get();
+}
+
+const Xapian::Database::Internal*
+HoneySegmentedDatabase::get_shard(Xapian::docid did) const
+{
+    Assert(did != 0);
+    auto shard = find_shard(did);
+    if (!shard) throw_doc_not_found(did);
+    return shard;
+}
+
+void
+HoneySegmentedDatabase::maybe_start_merge()
+{
+    if (closing || merge_factor <= 1 || merge) return;
+
+    // A segment's level is the number of digits in its document count when
+    // written in base merge_factor, and we merge merge_factor segments from
+    // the lowest level which has that many.
+    vector<size_t> chosen;
+    map<unsigned, vector<size_t>> levels;
+    for (size_t i = 0; i != segments.size(); ++i) {
+	if (segments[i].merging) continue;
+	Xapian::doccount live = segments[i].db->get_doccount();
+	unsigned level = 0;
+	while (live >= merge_factor) {
+	    live /= merge_factor;
+	    ++level;
+	}
+	levels[level].push_back(i);
+    }
+    for (auto&& level : levels) {
+	if (level.second.size() >= merge_factor) {
+	    chosen.assign(level.second.begin(),
+			  level.second.begin() + merge_factor);
+	    break;
+	}
+    }
+    if (chosen.empty()) {
+	// Otherwise rewrite a segment which is mostly deleted documents.
+	for (size_t i = 0; i != segments.size(); ++i) {
+	    const Segment& seg = segments[i];
+	    if (!seg.merging &&
+		seg.db->get_deletions().size() > seg.db->get_doccount()) {
+		chosen.push_back(i);
+		break;
+	    }
+	}
+	if (chosen.empty()) return;
+    }
+
+    sort(chosen.begin(), chosen.end(),
+	 [this](size_t a, size_t b) {
+	     return segments[a].first < segments[b].first;
+	 });
+    unique_ptr<Merge> m(new Merge);
+    for (size_t i : chosen) {
+	const Segment& seg = segments[i];
+	const HoneyDeletions& deletions = seg.db->get_deletions();
+	m->inputs.push_back(seg.number);
+	m->deletions.push_back(deletions);
+	auto db = new HoneyDatabase(segment_path(seg.number));
+	m->dbs.emplace_back(db);
+	db->get_deletions() = deletions;
+	if (!deletions.empty() || seg.first <= m->last_docid)
+	    m->compact = false;
+	m->last_docid = max(m->last_docid, seg.last);
+    }
+    m->output = next_segment++;
+
+    merge = std::move(m);
+    merge_done = false;
+    try {
+	merge_thread = thread([this]() { run_merge(); });
+    } catch (...) {
+	merge.reset();
+	throw;
+    }
+    for (size_t i : chosen) {
+	segments[i].merging = true;
+    }
+}
+
+void
+HoneySegmentedDatabase::run_merge()
+{
+    // This runs in the merge thread, and only uses the input databases in
+    // merge, so the writer can carry on making changes.
+    try {
+	string outdir = segment_path(merge->output);
+	if (mkdir(outdir.c_str(), 0755) < 0) {
+	    throw Xapian::DatabaseError("Couldn't create " + outdir, errno);
+	}
+	vector<const Xapian::Database::Internal*> sources;
+	vector<Xapian::docid> offset;
+	if (merge->compact) {
+	    for (auto&& db : merge->dbs) {
+		sources.push_back(db.get());
+		offset.push_back(0);
+	    }
+	    HoneyDatabase::compact(NULL, outdir.c_str(), -1,
+				   Xapian::DB_BACKEND_HONEY, sources, offset,
+				   Xapian::Compactor::STANDARD, 0,
+				   merge->last_docid);
+	} else {
+	    // Honey compaction can't drop deleted documents or interleave
+	    // docid ranges, so copy the live documents to a glass database
+	    // and compact that.
+	    string tmpdir = path + "/merge";
+	    removedir(tmpdir);
+	    intrusive_ptr<Xapian::Database::Internal> tmp;
+	    tmp = new GlassWritableDatabase(tmpdir,
+					    Xapian::DB_CREATE |
+					    Xapian::DB_NO_SYNC,
+					    0);
+	    for (auto&& db : merge->dbs) {
+		Xapian::Database in(db.get());
+		Xapian::PostingIterator end = in.postlist_end(string());
+		for (auto i = in.postlist_begin(string()); i != end; ++i) {
+		    Xapian::docid did = *i;
+		    tmp->replace_document(did, in.get_document(did));
+		}
+	    }
+	    tmp->commit();
+	    sources.push_back(tmp.get());
+	    offset.push_back(0);
+	    HoneyDatabase::compact(NULL, outdir.c_str(), -1,
+				   Xapian::DB_BACKEND_GLASS, sources, offset,
+				   Xapian::Compactor::STANDARD, 0,
+				   merge->last_docid);
+	    tmp->close();
+	    tmp = NULL;
+	    removedir(tmpdir);
+	}
+    } catch (...) {
+	merge_error = current_exception();
+    }
+    merge_done = true;
+}
+
+void
+HoneySegmentedDatabase::wait_for_merge()
+{
+    if (merge_thread.joinable()) merge_thread.join();
+}
+
+void
+HoneySegmentedDatabase::install_merge()
+{
+    wait_for_merge();
+    merge_done = false;
+    unique_ptr<Merge> m(std::move(merge));
+    string outdir = segment_path(m->output);
+    for (auto&& seg : segments) {
+	seg.merging = false;
+    }
+
+    if (merge_error) {
+	exception_ptr e = merge_error;
+	merge_error = nullptr;
+	try {
+	    removedir(outdir);
+	} catch (...) {
+	}
+	rethrow_exception(e);
+    }
+
+    Segment output(m->output, 0,
+		   new HoneyDatabase(outdir, Xapian::DB_READONLY_, mmap_flags));
+    HoneyDatabase* output_db = output.db.get();
+    HoneyDeletions& output_deletions = output_db->get_deletions();
+    vector<Segment> new_segments;
+    new_segments.reserve(segments.size() + 1 - m->inputs.size());
+    for (auto&& seg : segments) {
+	auto it = find(m->inputs.begin(), m->inputs.end(), seg.number);
+	if (it == m->inputs.end()) {
+	    new_segments.push_back(seg);
+	    continue;
+	}
+
+	// Carry over documents deleted since the merge started.
+	const HoneyDeletions& deletions = seg.db->get_deletions();
+	const HoneyDeletions& old_deletions = m->deletions[it - m->inputs.begin()];
+	if (deletions.size() != old_deletions.size()) {
+	    Xapian::docid did = deletions.find(1);
+	    while (did) {
+		if (!old_deletions.contains(did)) {
+		    output_deletions.add(did, output_db->get_doclength(did));
+		}
+		if (did == Xapian::docid(-1)) break;
+		did = deletions.find(did + 1);
+	    }
+	}
+
+	// The output goes where the first input was.
+	if (output.db.get()) {
+	    new_segments.push_back(output);
+	    output.db = NULL;
+	}
+	obsolete.push_back(segment_path(seg.number));
+	if (seg.del_rev) {
+	    obsolete.push_back(deletions_path(seg.number, seg.del_rev));
+	}
+    }
+    swap(segments, new_segments);
+    last_found = 0;
+}
+
+Xapian::doccount
+HoneySegmentedDatabase::get_doccount() const
+{
+    Xapian::doccount result = buffer.get() ? buffer->get_doccount() : 0;
+    for (auto&& seg : segments) {
+	result += seg.db->get_doccount();
+    }
+    return result;
+}
+
+Xapian::docid
+HoneySegmentedDatabase::get_lastdocid() const
+{
+    return last_docid;
+}
+
+Xapian::totallength
+HoneySegmentedDatabase::get_total_length() const
+{
+    Xapian::totallength result = buffer.get() ? buffer->get_total_length() : 0;
+    for (auto&& seg : segments) {
+	result += seg.db->get_total_length();
+    }
+    return result;
+}
+
+Xapian::termcount
+HoneySegmentedDatabase::get_doclength(Xapian::docid did) const
+{
+    return get_shard(did)->get_doclength(did);
+}
+
+Xapian::termcount
+HoneySegmentedDatabase::get_unique_terms(Xapian::docid did) const
+{
+    return get_shard(did)->get_unique_terms(did);
+}
+
+Xapian::termcount
+HoneySegmentedDatabase::get_wdfdocmax(Xapian::docid did) const
+{
+    return get_shard(did)->get_wdfdocmax(did);
+}
+
+void
+HoneySegmentedDatabase::get_freqs(const string& term,
+				  Xapian::doccount* termfreq_ptr,
+				  Xapian::termcount* collfreq_ptr) const
+{
+    Assert(!term.empty());
+
+    Xapian::doccount tf;
+    Xapian::doccount* tf_ptr = termfreq_ptr ? &tf : NULL;
+    Xapian::doccount total_tf = 0;
+
+    Xapian::termcount cf;
+    Xapian::termcount* cf_ptr = collfreq_ptr ? &cf : NULL;
+    Xapian::termcount total_cf = 0;
+
+    auto add_freqs = [&](const Xapian::Database::Internal* shard) {
+	shard->get_freqs(term, tf_ptr, cf_ptr);
+	if (tf_ptr) total_tf += tf;
+	if (cf_ptr) total_cf += cf;
+    };
+    for (auto&& seg : segments) {
+	add_freqs(seg.db.get());
+    }
+    if (buffer.get()) add_freqs(buffer.get());
+
+    if (termfreq_ptr) *termfreq_ptr = total_tf;
+    if (collfreq_ptr) *collfreq_ptr = total_cf;
+}
+
+Xapian::doccount
+HoneySegmentedDatabase::get_value_freq(Xapian::valueno slot) const
+{
+    Xapian::doccount result = buffer.get() ? buffer->get_value_freq(slot) : 0;
+    for (auto&& seg : segments) {
+	result += seg.db->get_value_freq(slot);
+    }
+    return result;
+}
+
+string
+HoneySegmentedDatabase::get_value_lower_bound(Xapian::valueno slot) const
+{
+    string result;
+    auto update = [&](const Xapian::Database::Internal* shard) {
+	string shard_result = shard->get_value_lower_bound(slot);
+	if (shard_result.empty())
+	    return;
+	if (result.empty() || shard_result < result)
+	    result = std::move(shard_result);
+    };
+    for (auto&& seg : segments) {
+	update(seg.db.get());
+    }
+    if (buffer.get()) update(buffer.get());
+    return result;
+}
+
+string
+HoneySegmentedDatabase::get_value_upper_bound(Xapian::valueno slot) const
+{
+    string result = buffer.get() ? buffer->get_value_upper_bound(slot) : string();
+    for (auto&& seg : segments) {
+	string shard_result = seg.db->get_value_upper_bound(slot);
+	if (shard_result > result)
+	    result = std::move(shard_result);
+    }
+    return result;
+}
+
+Xapian::termcount
+HoneySegmentedDatabase::get_doclength_lower_bound() const
+{
+    // As for MultiDatabase, negate so that any non-zero bound "beats" 0.
+    static_assert(std::is_unsigned<Xapian::termcount>::value,
+		  "Unsigned type required");
+    Xapian::termcount result = 0;
+    if (buffer.get()) result = -buffer->get_doclength_lower_bound();
+    for (auto&& seg : segments) {
+	Xapian::termcount shard_result = -seg.db->get_doclength_lower_bound();
+	result = max(result, shard_result);
+    }
+    return -result;
+}
+
+Xapian::termcount
+HoneySegmentedDatabase::get_doclength_upper_bound() const
+{
+    Xapian::termcount result = 0;
+    if (buffer.get()) result = buffer->get_doclength_upper_bound();
+    for (auto&& seg : segments) {
+	result = max(result, seg.db->get_doclength_upper_bound());
+    }
+    return result;
+}
+
+Xapian::termcount
+HoneySegmentedDatabase::get_wdf_upper_bound(const string& term) const
+{
+    Assert(!term.empty());
+
+    Xapian::termcount result = 0;
+    if (buffer.get()) result = buffer->get_wdf_upper_bound(term);
+    for (auto&& seg : segments) {
+	result = max(result, seg.db->get_wdf_upper_bound(term));
+    }
+    return result;
+}
+
+Xapian::termcount
+HoneySegmentedDatabase::get_unique_terms_lower_bound() const
+{
+    Xapian::termcount result = 0;
+    if (buffer.get()) result = -buffer->get_unique_terms_lower_bound();
+    for (auto&& seg : segments) {
+	Xapian::termcount shard_result = -seg.db->get_unique_terms_lower_bound();
+	result = max(result, shard_result);
+    }
+    return -result;
+}
+
+Xapian::termcount
+HoneySegmentedDatabase::get_unique_terms_upper_bound() const
+{
+    Xapian::termcount result = 0;
+    if (buffer.get()) result = buffer->get_unique_terms_upper_bound();
+    for (auto&& seg : segments) {
+	result = max(result, seg.db->get_unique_terms_upper_bound());
+    }
+    return result;
+}
+
+bool
+HoneySegmentedDatabase::term_exists(const string& term) const
+{
+    if (buffer.get() && buffer->term_exists(term))
+	return true;
+    for (auto&& seg : segments) {
+	if (seg.db->term_exists(term))
+	    return true;
+    }
+    return false;
+}
+
+bool
+HoneySegmentedDatabase::has_positions() const
+{
+    if (buffer.get() && buffer->has_positions())
+	return true;
+    for (auto&& seg : segments) {
+	if (seg.db->has_positions())
+	    return true;
+    }
+    return false;
+}
+
+PostList*
+HoneySegmentedDatabase::open_post_list(const string& term) const
+{
+    return HoneySegmentedDatabase::open_leaf_post_list(term, false);
+}
+
+LeafPostList*
+HoneySegmentedDatabase::open_leaf_post_list(const string& term,
+					    bool need_read_pos) const
+{
+    // Always wrap the segments' postlists, as the wrapper keeps the segments
+    // alive if a commit drops them.
+    unique_ptr<HoneySegmentedPostList> pl(new HoneySegmentedPostList(term));
+    auto add = [&](const Xapian::Database::Internal* shard) {
+	LeafPostList* sub_pl = shard->open_leaf_post_list(term,
+							  need_read_pos);
+	if (sub_pl->get_termfreq() == 0) {
+	    delete sub_pl;
+	    return;
+	}
+	pl->add_postlist(sub_pl, shard);
+    };
+    for (auto&& seg : segments) {
+	add(seg.db.get());
+    }
+    if (buffer.get()) add(buffer.get());
+    return pl.release();
+}
+
+ValueList*
+HoneySegmentedDatabase::open_value_list(Xapian::valueno slot) const
+{
+    unique_ptr<HoneySegmentedValueList> vl(new HoneySegmentedValueList(slot));
+    for (auto&& seg : segments) {
+	vl->add_valuelist(seg.db->open_value_list(slot), seg.db.get());
+    }
+    if (buffer.get()) vl->add_valuelist(buffer->open_value_list(slot), buffer.get());
+    return vl.release();
+}
+
+TermList*
+HoneySegmentedDatabase::open_term_list(Xapian::docid did) const
+{
+    return get_shard(did)->open_term_list(did);
+}
+
+TermList*
+HoneySegmentedDatabase::open_term_list_direct(Xapian::docid did) const
+{
+    return get_shard(did)->open_term_list_direct(did);
+}
+
+TermList*
+HoneySegmentedDatabase::open_allterms(const string& prefix) const
+{
+    size_t count = 0;
+    TermList** termlists = new TermList*[segments.size() + 1];
+    try {
+	for (auto&& seg : segments) {
+	    termlists[count] = seg.db->open_allterms(prefix);
+	    ++count;
+	}
+	if (buffer.get()) {
+	    termlists[count] = buffer->open_allterms(prefix);
+	    ++count;
+	}
+	return new MultiAllTermsList(count, termlists);
+    } catch (...) {
+	while (count)
+	    delete termlists[--count];
+	delete [] termlists;
+	throw;
+    }
+}
+
+PositionList*
+HoneySegmentedDatabase::open_position_list(Xapian::docid did,
+					   const string& term) const
+{
+    auto shard = find_shard(did);
+    // Like the other backends, return an empty list for a document which
+    // doesn't exist - meta has no documents so gives us one.
+    if (!shard) shard = meta.get();
+    return shard->open_position_list(did, term);
+}
+
+Xapian::Document::Internal*
+HoneySegmentedDatabase::open_document(Xapian::docid did, bool lazy) const
+{
+    auto shard = get_shard(did);
+    auto doc = shard->open_document(did, lazy);
+    if (buffer.get() && shard != buffer.get()) {
+	// The buffer spots its own documents being replaced unmodified.
+	modify_shortcut_document = doc;
+	modify_shortcut_docid = did;
+    }
+    return doc;
+}
+
+TermList*
+HoneySegmentedDatabase::open_spelling_termlist(const string& word) const
+{
+    return meta->open_spelling_termlist(word);
+}
+
+TermList*
+HoneySegmentedDatabase::open_spelling_wordlist() const
+{
+    return meta->open_spelling_wordlist();
+}
+
+Xapian::doccount
+HoneySegmentedDatabase::get_spelling_frequency(const string& word) const
+{
+    return meta->get_spelling_frequency(word);
+}
+
+void
+HoneySegmentedDatabase::add_spelling(const string& word,
+				     Xapian::termcount freqinc) const
+{
+    meta->add_spelling(word, freqinc);
+}
+
+Xapian::termcount
+HoneySegmentedDatabase::remove_spelling(const string& word,
+					Xapian::termcount freqdec) const
+{
+    return meta->remove_spelling(word, freqdec);
+}
+
+TermList*
+HoneySegmentedDatabase::open_synonym_termlist(const string& term) const
+{
+    return meta->open_synonym_termlist(term);
+}
+
+TermList*
+HoneySegmentedDatabase::open_synonym_keylist(const string& prefix) const
+{
+    return meta->open_synonym_keylist(prefix);
+}
+
+void
+HoneySegmentedDatabase::add_synonym(const string& term,
+				    const string& synonym) const
+{
+    meta->add_synonym(term, synonym);
+}
+
+void
+HoneySegmentedDatabase::remove_synonym(const string& term,
+				       const string& synonym) const
+{
+    meta->remove_synonym(term, synonym);
+}
+
+void
+HoneySegmentedDatabase::clear_synonyms(const string& term) const
+{
+    meta->clear_synonyms(term);
+}
+
+string
+HoneySegmentedDatabase::get_metadata(const string& key) const
+{
+    return meta->get_metadata(key);
+}
+
+TermList*
+HoneySegmentedDatabase::open_metadata_keylist(const string& prefix) const
+{
+    return meta->open_metadata_keylist(prefix);
+}
+
+void
+HoneySegmentedDatabase::set_metadata(const string& key, const string& value)
+{
+    meta->set_metadata(key, value);
+}
+
+bool
+HoneySegmentedDatabase::reopen()
+{
+    if (closed)
+	throw_closed();
+    if (!is_read_only()) return false;
+    Manifest manifest;
+    if (!read_manifest(manifest)) return false;
+    if (manifest.revision == revision &&
+	memcmp(manifest.uuid.data(), uuid.data(), Uuid::BINARY_SIZE) == 0) {
+	// Committing metadata, spellings or synonyms only updates meta.
+	return meta->reopen();
+    }
+    open_revision(manifest);
+    return true;
+}
+
+void
+HoneySegmentedDatabase::close()
+{
+    if (closed) return;
+    closing = true;
+    if (!is_read_only()) {
+	wait_for_merge();
+	if (!transaction_active()) commit();
+	buffer->cancel();
+	buffer->close();
+	try {
+	    removedir(path + "/buffer");
+	} catch (const Xapian::DatabaseError&) {
+	}
+    }
+    meta->close();
+    for (auto&& seg : segments) {
+	seg.db->close();
+    }
+    lock.release();
+    closed = true;
+}
+
+void
+HoneySegmentedDatabase::commit()
+{
+    if (closed)
+	throw_closed();
+    if (transaction_active())
+	throw Xapian::InvalidOperationError("Can't commit during a transaction");
+
+    bool changed = false;
+    if (merge_done) {
+	install_merge();
+	changed = true;
+    }
+
+    if (!buffer_docs.empty()) {
+	flush_buffer();
+	changed = true;
+    } else if (buffer_modified) {
+	reset_buffer();
+    }
+
+    // Drop segments with no live documents left.
+    for (size_t i = 0; i != segments.size(); ) {
+	const Segment& seg = segments[i];
+	if (seg.merging || seg.db->get_doccount() != 0) {
+	    ++i;
+	    continue;
+	}
+	obsolete.push_back(segment_path(seg.number));
+	if (seg.del_rev) {
+	    obsolete.push_back(deletions_path(seg.number, seg.del_rev));
+	}
+	segments.erase(segments.begin() + i);
+	last_found = 0;
+	changed = true;
+    }
+
+    Xapian::rev new_rev = revision + 1;
+    for (auto&& seg : segments) {
+	HoneyDeletions& deletions = seg.db->get_deletions();
+	if (!deletions.is_modified()) continue;
+	deletions.write(deletions_path(seg.number, new_rev), new_rev, flags);
+	if (seg.del_rev) {
+	    obsolete.push_back(deletions_path(seg.number, seg.del_rev));
+	}
+	seg.del_rev = new_rev;
+	changed = true;
+    }
+
+    // Committing meta doesn't need a new manifest.
+    meta->commit();
+
+    if (changed || last_docid != committed_last_docid) {
+	write_manifest(new_rev);
+	revision = new_rev;
+	committed_last_docid = last_docid;
+	remove_obsolete();
+    }
+    change_count = 0;
+
+    maybe_start_merge();
+}
+
+void
+HoneySegmentedDatabase::cancel()
+{
+    if (closed)
+	throw_closed();
+    for (auto&& seg : segments) {
+	HoneyDeletions& deletions = seg.db->get_deletions();
+	if (!deletions.is_modified()) continue;
+	if (seg.del_rev) {
+	    deletions.read(deletions_path(seg.number, seg.del_rev),
+			   seg.del_rev);
+	} else {
+	    deletions.clear();
+	}
+    }
+    meta->cancel();
+    if (buffer_modified) reset_buffer();
+    modify_shortcut_document = NULL;
+    modify_shortcut_docid = 0;
+    last_docid = committed_last_docid;
+    change_count = 0;
+}
+
+void
+HoneySegmentedDatabase::set_flush_memory_limit(size_t limit)
+{
+    flush_memory_limit = limit;
+}
+
+size_t
+HoneySegmentedDatabase::get_buffered_memory() const
+{
+    return buffer->get_buffered_memory();
+}
+
+Xapian::docid
+HoneySegmentedDatabase::add_document(const Xapian::Document& document)
+{
+    if (last_docid == Xapian::docid(-1))
+	throw Xapian::DatabaseError("Run out of docids - you'll have to use copydatabase to eliminate any gaps before you can add more documents");
+    Xapian::docid did = last_docid + 1;
+    buffer->replace_document(did, document);
+    buffer_modified = true;
+    buffer_docs.insert(did);
+    last_docid = did;
+    check_flush_threshold();
+    return did;
+}
+
+void
+HoneySegmentedDatabase::delete_document(Xapian::docid did)
+{
+    Assert(did != 0);
+    if (did == modify_shortcut_docid) {
+	modify_shortcut_document = NULL;
+	modify_shortcut_docid = 0;
+    }
+    if (buffer_docs.count(did)) {
+	buffer->delete_document(did);
+	buffer_modified = true;
+	buffer_docs.erase(did);
+    } else {
+	size_t i = find_segment(did);
+	if (i == segments.size()) throw_doc_not_found(did);
+	HoneyDatabase* db = segments[i].db.get();
+	db->get_deletions().add(did, db->get_doclength(did));
+    }
+    check_flush_threshold();
+}
+
+void
+HoneySegmentedDatabase::delete_document(const string& unique_term)
+{
+    // Find the documents first, as the postlist would skip documents as we
+    // move them between the buffer and the segments.
+    vector<Xapian::docid> dids;
+    {
+	unique_ptr<PostList> pl(open_post_list(unique_term));
+	while (pl->next(), !pl->at_end()) {
+	    dids.push_back(pl->get_docid());
+	}
+    }
+
+    // We want this operation to be atomic, so temporarily enter an unflushed
+    // transaction to stop check_flush_threshold() committing part way.
+    auto old_state = state;
+    state = TRANSACTION_UNFLUSHED;
+    try {
+	for (Xapian::docid did : dids) {
+	    delete_document(did);
+	}
+    } catch (...) {
+	state = old_state;
+	throw;
+    }
+    state = old_state;
+}
+
+void
+HoneySegmentedDatabase::replace_document(Xapian::docid did,
+					 const Xapian::Document& document)
+{
+    Assert(did != 0);
+    if (did == modify_shortcut_docid) {
+	if (document.internal.get() == modify_shortcut_document &&
+	    document.internal->get_docid() == did &&
+	    !document.internal->modified()) {
+	    // The document is unchanged, so there's nothing to do.
+	    return;
+	}
+	modify_shortcut_document = NULL;
+	modify_shortcut_docid = 0;
+    }
+    if (buffer_docs.count(did)) {
+	buffer->replace_document(did, document);
+    } else {
+	size_t i = find_segment(did);
+	// Add the new version before deleting the old one, as the document
+	// may read its contents lazily from the old one.
+	buffer->replace_document(did, document);
+	buffer_docs.insert(did);
+	if (i != segments.size()) {
+	    HoneyDatabase* db = segments[i].db.get();
+	    db->get_deletions().add(did, db->get_doclength(did));
+	}
+	if (did > last_docid) last_docid = did;
+    }
+    buffer_modified = true;
+    check_flush_threshold();
+}
+
+Xapian::docid
+HoneySegmentedDatabase::replace_document(const string& unique_term,
+					 const Xapian::Document& document)
+{
+    vector<Xapian::docid> dids;
+    {
+	unique_ptr<PostList> pl(open_post_list(unique_term));
+	while (pl->next(), !pl->at_end()) {
+	    dids.push_back(pl->get_docid());
+	}
+    }
+    if (dids.empty()) {
+	return add_document(document);
+    }
+
+    auto old_state = state;
+    state = TRANSACTION_UNFLUSHED;
+    try {
+	replace_document(dids[0], document);
+	for (size_t i = 1; i != dids.size(); ++i) {
+	    delete_document(dids[i]);
+	}
+    } catch (...) {
+	state = old_state;
+	throw;
+    }
+    state = old_state;
+    return dids[0];
+}
+
+Xapian::rev
+HoneySegmentedDatabase::get_revision() const
+{
+    return revision;
+}
+
+string
+HoneySegmentedDatabase::get_uuid() const
+{
+    return uuid.to_string();
+}
+
+int
+HoneySegmentedDatabase::get_backend_info(string* path_ptr) const
+{
+    if (path_ptr)
+	*path_ptr = path;
+    return BACKEND_UNKNOWN;
+}
+
+bool
+HoneySegmentedDatabase::locked() const
+{
+    if (!is_read_only()) return true;
+    return lock.test();
+}
+
+string
+HoneySegmentedDatabase::get_description() const
+{
+    string desc = "HoneySegmented(";
+    desc += path;
+    desc += ')';
+    return desc;
+}
+
+#endif // XAPIAN_HAS_GLASS_BACKEND
@@ -0,0 +1,454 @@
+/** @file
+ * @brief Updatable database made of immutable honey segments
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_HONEY_SEGMENTED_H
+#define XAPIAN_INCLUDED_HONEY_SEGMENTED_H
+
+#include "backends/databaseinternal.h"
+#include "backends/flint_lock.h"
+#include "backends/uuids.h"
+#include "honey_database.h"
+#include "honey_defs.h"
+#include "honey_deletions.h"
+
+#include <atomic>
+#include <exception>
+#include <iosfwd>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/** Updatable database made of immutable honey segments.
+ *
+ *  The database directory holds:
+ *
+ *  - "iamsegmented": The manifest, listing the live segments.  A new
+ *    revision is made by writing a new manifest and renaming it into place.
+ *  - "segN": Segment number N, which is a honey database.  Documents keep
+ *    their docids in a segment, so the segments' docid ranges may
+ *    interleave.
+ *  - "segN.delR": The documents deleted from segment N, written at
+ *    revision R (see HoneyDeletions).
+ *  - "meta": A glass database holding the user metadata, spellings and
+ *    synonyms.
+ *
+ *  A writer also uses "buffer", a glass database which new and replaced
+ *  documents are added to.  On commit the buffer is converted into a new
+ *  segment by the honey compaction code, so updating a document never
+ *  rewrites existing postlists.  Once there are enough segments of a similar
+ *  size a background thread merges them into one segment, which gets used
+ *  at the next commit.
+ */
+class HoneySegmentedDatabase : public Xapian::Database::Internal {
+    /// Don't allow assignment.
+    HoneySegmentedDatabase& operator=(const HoneySegmentedDatabase&) = delete;
+
+    /// Don't allow copying.
+    HoneySegmentedDatabase(const HoneySegmentedDatabase&) = delete;
+
+    /// A segment of the database.
+    struct Segment {
+	/// The segment number.
+	unsigned number;
+
+	/// The revision its deletions were written at (0 for none).
+	Xapian::rev del_rev;
+
+	/// The segment's database.
+	Xapian::Internal::intrusive_ptr<HoneyDatabase> db;
+
+	/// The lowest docid in the segment.
+	Xapian::docid first;
+
+	/// The highest docid in the segment.
+	Xapian::docid last;
+
+	/// Is the segment being merged?
+	bool merging = false;
+
+	Segment(unsigned number_, Xapian::rev del_rev_, HoneyDatabase* db_);
+    };
+
+    /// The contents of the manifest.
+    struct Manifest {
+	Xapian::rev revision = 0;
+
+	Uuid uuid;
+
+	Xapian::docid last_docid = 0;
+
+	unsigned next_segment = 1;
+
+	/// The number of each segment and the revision of its deletions.
+	std::vector<std::pair<unsigned, Xapian::rev>> segments;
+    };
+
+    /// A merge being run by the background thread.
+    struct Merge {
+	/// The number of the segment being created.
+	unsigned output;
+
+	/// The numbers of the segments being merged.
+	std::vector<unsigned> inputs;
+
+	/** The deletions from the inputs when the merge started.
+	 *
+	 *  Documents deleted after this need deleting from the output.
+	 */
+	std::vector<HoneyDeletions> deletions;
+
+	/// Databases for the inputs, which only the merge thread uses.
+	std::vector<Xapian::Internal::intrusive_ptr<HoneyDatabase>> dbs;
+
+	/// The highest docid in the inputs.
+	Xapian::docid last_docid = 0;
+
+	/** Can the inputs be combined by the honey compaction code?
+	 *
+	 *  This is the case if there are no deletions and the inputs' docid
+	 *  ranges don't overlap.  Otherwise the live documents are copied via
+	 *  a temporary glass database.
+	 */
+	bool compact = true;
+    };
+
+    /// Path of the directory.
+    std::string path;
+
+    /// The flags the database was opened with.
+    int flags;
+
+    /// Xapian::DB_MMAP* flags to open segments with.
+    int mmap_flags;
+
+    /// Lock object.
+    FlintLock lock;
+
+    /// The revision of the manifest.
+    Xapian::rev revision = 0;
+
+    /// The UUID of the database.
+    Uuid uuid;
+
+    /// The highest docid which has been used.
+    Xapian::docid last_docid = 0;
+
+    /// The highest docid which has been committed.
+    Xapian::docid committed_last_docid = 0;
+
+    /// The number to use for the next segment.
+    unsigned next_segment = 1;
+
+    /// The segments, oldest first.
+    std::vector<Segment> segments;
+
+    /// Index of the segment last found by find_segment().
+    mutable size_t last_found = 0;
+
+    /// Glass database holding user metadata, spellings and synonyms.
+    Xapian::Internal::intrusive_ptr<Xapian::Database::Internal> meta;
+
+    /** Glass database holding new and replaced documents.
+     *
+     *  Only used by a writer.
+     */
+    Xapian::Internal::intrusive_ptr<Xapian::Database::Internal> buffer;
+
+    /// The docids of the documents in @a buffer.
+    std::set<Xapian::docid> buffer_docs;
+
+    /// Has @a buffer been modified since it was created?
+    bool buffer_modified = false;
+
+    /** The last document read from a segment by a writer.
+     *
+     *  Replacing a document with an unmodified copy of itself can then be
+     *  skipped.
+     */
+    mutable const Xapian::Document::Internal* modify_shortcut_document = NULL;
+
+    /// The docid of @a modify_shortcut_document.
+    mutable Xapian::docid modify_shortcut_docid = 0;
+
+    /// The number of changes since the last commit.
+    Xapian::doccount change_count = 0;
+
+    /// Commit after this many changes (0 means use the default).
+    Xapian::doccount flush_threshold = 0;
+
+    /// Commit once the buffered changes use this much memory (0 for no limit).
+    std::size_t flush_memory_limit = 0;
+
+    /** How many segments of a similar size to merge at once.
+     *
+     *  0 or 1 disables merging.
+     */
+    unsigned merge_factor = 10;
+
+    /// Files and directories to remove after the next commit.
+    std::vector<std::string> obsolete;
+
+    /// Set once we start closing, so that no more merges are started.
+    bool closing = false;
+
+    /// Has close() been called?
+    bool closed = false;
+
+    /// The merge being run, if any.
+    std::unique_ptr<Merge> merge;
+
+    /// Thread running @a merge.
+    std::thread merge_thread;
+
+    /// Set by the merge thread when it finishes.
+    std::atomic<bool> merge_done;
+
+    /// Exception thrown by the merge thread.
+    std::exception_ptr merge_error;
+
+    /// Return the path of segment @a number.
+    std::string segment_path(unsigned number) const;
+
+    /// Return the path of the deletions for segment @a number at @a rev.
+    std::string deletions_path(unsigned number, Xapian::rev rev) const;
+
+    /** Read the manifest.
+     *
+     *  @return false if there isn't one.
+     */
+    bool read_manifest(Manifest& manifest) const;
+
+    /// Write the manifest for revision @a new_rev.
+    void write_manifest(Xapian::rev new_rev);
+
+    /** Open the segments listed in @a manifest.
+     *
+     *  Segments which are already open and unchanged are reused.
+     */
+    void open_segments(const Manifest& manifest);
+
+    /** Open the revision described by @a manifest to read.
+     *
+     *  If a writer removes files we need before we've opened them, we
+     *  retry with the new revision.
+     */
+    void open_revision(Manifest& manifest);
+
+    /// Open a writer, creating the database if @a flags say to.
+    void open_writable();
+
+    /// Remove files and directories which aren't referenced.
+    void remove_unreferenced();
+
+    /// Remove the files in @a obsolete.
+    void remove_obsolete();
+
+    /// Discard @a buffer and create a new empty one.
+    void reset_buffer();
+
+    /// Convert the buffered documents into a new segment.
+    void flush_buffer();
+
+    /// Commit if the flush threshold has been reached.
+    void check_flush_threshold();
+
+    /** Find the segment containing document @a did.
+     *
+     *  @return The index of the segment, or segments.size() if not found.
+     */
+    size_t find_segment(Xapian::docid did) const;
+
+    /** Find the shard containing document @a did.
+     *
+     *  @return The buffer or a segment's database.
+     */
+    const Xapian::Database::Internal* find_shard(Xapian::docid did) const;
+
+    /// Find the shard containing document @a did or throw DocNotFoundError.
+    const Xapian::Database::Internal* get_shard(Xapian::docid did) const;
+
+    /// Start a merge if one is needed.
+    void maybe_start_merge();
+
+    /// Run @a merge (called in the merge thread).
+    void run_merge();
+
+    /// Wait for the merge thread to finish.
+    void wait_for_merge();
+
+    /** Replace the inputs of a finished merge with its output.
+     *
+     *  If the merge failed, the exception it threw is rethrown.
+     */
+    void install_merge();
+
+  public:
+    /** Open a segmented honey database.
+     *
+     *  @param path_	The directory the database is in.
+     *  @param flags_	Xapian::DB_READONLY_ to open to read, otherwise the
+     *			flags to open for writing with.
+     *  @param mmap_flags_	Xapian::DB_MMAP* flags to open the segments with.
+     */
+    HoneySegmentedDatabase(const std::string& path_, int flags_,
+			   int mmap_flags_ = 0);
+
+    ~HoneySegmentedDatabase();
+
+    /// Test if @a path_ contains a segmented honey database.
+    static bool exists(const std::string& path_);
+
+    /** Check the segmented honey database at @a path_.
+     *
+     *  Each live segment and the metadata database are checked in turn.
+     *
+     *  @return The number of errors found.
+     */
+    static size_t check(const std::string& path_, int opts,
+			std::ostream* out);
+
+    Xapian::doccount get_doccount() const;
+
+    Xapian::docid get_lastdocid() const;
+
+    Xapian::totallength get_total_length() const;
+
+    Xapian::termcount get_doclength(Xapian::docid did) const;
+
+    Xapian::termcount get_unique_terms(Xapian::docid did) const;
+
+    Xapian::termcount get_wdfdocmax(Xapian::docid did) const;
+
+    void get_freqs(const std::string& term,
+		   Xapian::doccount* termfreq_ptr,
+		   Xapian::termcount* collfreq_ptr) const;
+
+    Xapian::doccount get_value_freq(Xapian::valueno slot) const;
+
+    std::string get_value_lower_bound(Xapian::valueno slot) const;
+
+    std::string get_value_upper_bound(Xapian::valueno slot) const;
+
+    Xapian::termcount get_doclength_lower_bound() const;
+
+    Xapian::termcount get_doclength_upper_bound() const;
+
+    Xapian::termcount get_wdf_upper_bound(const std::string& term) const;
+
+    Xapian::termcount get_unique_terms_lower_bound() const;
+
+    Xapian::termcount get_unique_terms_upper_bound() const;
+
+    bool term_exists(const std::string& term) const;
+
+    bool has_positions() const;
+
+    PostList* open_post_list(const std::string& term) const;
+
+    LeafPostList* open_leaf_post_list(const std::string& term,
+				      bool need_read_pos) const;
+
+    ValueList* open_value_list(Xapian::valueno slot) const;
+
+    TermList* open_term_list(Xapian::docid did) const;
+
+    TermList* open_term_list_direct(Xapian::docid did) const;
+
+    TermList* open_allterms(const std::string& prefix) const;
+
+    PositionList* open_position_list(Xapian::docid did,
+				     const std::string& term) const;
+
+    Xapian::Document::Internal* open_document(Xapian::docid did,
+					      bool lazy) const;
+
+    TermList* open_spelling_termlist(const std::string& word) const;
+
+    TermList* open_spelling_wordlist() const;
+
+    Xapian::doccount get_spelling_frequency(const std::string& word) const;
+
+    void add_spelling(const std::string& word,
+		      Xapian::termcount freqinc) const;
+
+    Xapian::termcount remove_spelling(const std::string& word,
+				      Xapian::termcount freqdec) const;
+
+    TermList* open_synonym_termlist(const std::string& term) const;
+
+    TermList* open_synonym_keylist(const std::string& prefix) const;
+
+    void add_synonym(const std::string& term,
+		     const std::string& synonym) const;
+
+    void remove_synonym(const std::string& term,
+			const std::string& synonym) const;
+
+    void clear_synonyms(const std::string& term) const;
+
+    std::string get_metadata(const std::string& key) const;
+
+    TermList* open_metadata_keylist(const std::string& prefix) const;
+
+    void set_metadata(const std::string& key, const std::string& value);
+
+    bool reopen();
+
+    void close();
+
+    void commit();
+
+    void cancel();
+
+    void set_flush_memory_limit(std::size_t limit);
+
+    std::size_t get_buffered_memory() const;
+
+    Xapian::docid add_document(const Xapian::Document& document);
+
+    void delete_document(Xapian::docid did);
+
+    void delete_document(const std::string& unique_term);
+
+    void replace_document(Xapian::docid did,
+			  const Xapian::Document& document);
+
+    Xapian::docid replace_document(const std::string& unique_term,
+				   const Xapian::Document& document);
+
+    Xapian::rev get_revision() const;
+
+    std::string get_uuid() const;
+
+    /** Get backend information about this database.
+     *
+     *  The segments can't be compacted or accessed as a HoneyDatabase, so
+     *  this reports BACKEND_UNKNOWN.
+     */
+    int get_backend_info(std::string* path) const;
+
+    bool locked() const;
+
+    std::string get_description() const;
+};
+
+#endif // XAPIAN_INCLUDED_HONEY_SEGMENTED_H
@@ -0,0 +1,184 @@
+/** @file
+ * @brief PostList in a segmented honey database
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "honey_segmentedpostlist.h"
+
+#include "omassert.h"
+#include "str.h"
+
+#include <algorithm>
+
+using namespace std;
+
+HoneySegmentedPostList::~HoneySegmentedPostList()
+{
+    for (auto pl : postlists)
+	delete pl;
+}
+
+void
+HoneySegmentedPostList::add_postlist(LeafPostList* pl,
+				     const Xapian::Database::Internal* segment)
+{
+    try {
+	postlists.push_back(pl);
+    } catch (...) {
+	delete pl;
+	throw;
+    }
+    segments.emplace_back(segment);
+    termfreq += pl->get_termfreq();
+    wdf_upper_bound = max(wdf_upper_bound, pl->get_wdf_upper_bound());
+}
+
+void
+HoneySegmentedPostList::update_current()
+{
+    did = 0;
+    size_t j = 0;
+    for (size_t i = 0; i != postlists.size(); ++i) {
+	LeafPostList* pl = postlists[i];
+	if (pl->at_end()) {
+	    delete pl;
+	    continue;
+	}
+	postlists[j] = pl;
+	Xapian::docid pl_did = pl->get_docid();
+	if (did == 0 || pl_did < did) {
+	    did = pl_did;
+	    current = j;
+	}
+	++j;
+    }
+    postlists.resize(j);
+}
+
+Xapian::doccount
+HoneySegmentedPostList::get_termfreq() const
+{
+    return termfreq;
+}
+
+Xapian::docid
+HoneySegmentedPostList::get_docid() const
+{
+    Assert(!at_end());
+    return did;
+}
+
+Xapian::termcount
+HoneySegmentedPostList::get_wdf() const
+{
+    Assert(!at_end());
+    return postlists[current]->get_wdf();
+}
+
+bool
+HoneySegmentedPostList::at_end() const
+{
+    return postlists.empty();
+}
+
+PositionList*
+HoneySegmentedPostList::read_position_list()
+{
+    Assert(!at_end());
+    return postlists[current]->read_position_list();
+}
+
+PositionList*
+HoneySegmentedPostList::open_position_list() const
+{
+    Assert(!at_end());
+    return postlists[current]->open_position_list();
+}
+
+// The segments' postlists are leaf postlists, so they never prune themselves
+// and we can ignore what their next() and skip_to() methods return.
+
+PostList*
+HoneySegmentedPostList::next(double)
+{
+    // Each document is only live in one segment, but a corrupt database
+    // might have it in more than one so advance all postlists on it.
+    for (auto pl : postlists) {
+	// If did is 0 we haven't started yet.
+	if (did == 0 || pl->get_docid() == did)
+	    (void)pl->next();
+    }
+    update_current();
+    return NULL;
+}
+
+PostList*
+HoneySegmentedPostList::skip_to(Xapian::docid target, double)
+{
+    if (did != 0 && target <= did)
+	return NULL;
+    for (auto pl : postlists) {
+	// A postlist which hasn't started yet needs skip_to() calling.
+	if (did == 0 || pl->get_docid() < target)
+	    (void)pl->skip_to(target);
+    }
+    update_current();
+    return NULL;
+}
+
+const Xapian::docid*
+HoneySegmentedPostList::get_docid_block(const Xapian::docid*& block_end) const
+{
+    // With several segments a block from one could skip over documents
+    // from another.
+    if (postlists.size() != 1) return NULL;
+    return postlists[0]->get_docid_block(block_end);
+}
+
+Xapian::termcount
+HoneySegmentedPostList::get_wdf_upper_bound() const
+{
+    return wdf_upper_bound;
+}
+
+Xapian::termcount
+HoneySegmentedPostList::get_block_wdf_upper_bound(Xapian::docid& block_last) const
+{
+    // Every postlist is positioned at or after the current docid, so the
+    // largest of their bounds applies up to the earliest end of a block.
+    block_last = Xapian::docid(-1);
+    Xapian::termcount result = 0;
+    for (auto pl : postlists) {
+	Xapian::docid pl_block_last;
+	result = max(result, pl->get_block_wdf_upper_bound(pl_block_last));
+	block_last = min(block_last, pl_block_last);
+    }
+    return result;
+}
+
+string
+HoneySegmentedPostList::get_description() const
+{
+    string desc = "HoneySegmentedPostList(";
+    desc += term;
+    desc += ", ";
+    desc += str(segments.size());
+    desc += " segments)";
+    return desc;
+}
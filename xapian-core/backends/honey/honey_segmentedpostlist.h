@@ -0,0 +1,109 @@
+/** @file
+ * @brief PostList in a segmented honey database
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_HONEY_SEGMENTEDPOSTLIST_H
+#define XAPIAN_INCLUDED_HONEY_SEGMENTEDPOSTLIST_H
+
+#include "backends/databaseinternal.h"
+#include "backends/leafpostlist.h"
+
+#include <string>
+#include <vector>
+
+/** PostList in a segmented honey database.
+ *
+ *  Documents keep their docids when they're moved between segments, so
+ *  unlike MultiPostList this merges the segments' postlists by docid.  Each
+ *  docid is only live in one segment, and the segments' postlists skip
+ *  deleted documents.
+ */
+class HoneySegmentedPostList : public LeafPostList {
+    /// Don't allow assignment.
+    HoneySegmentedPostList& operator=(const HoneySegmentedPostList&) = delete;
+
+    /// Don't allow copying.
+    HoneySegmentedPostList(const HoneySegmentedPostList&) = delete;
+
+    /// The segments' postlists which haven't reached the end.
+    std::vector<LeafPostList*> postlists;
+
+    /** The segments the postlists are from.
+     *
+     *  A segment can be dropped by a commit while we're still in use.
+     */
+    std::vector<Xapian::Internal::intrusive_ptr<const Xapian::Database::Internal>> segments;
+
+    /// The index in @a postlists of the current entry.
+    size_t current = 0;
+
+    /// The current docid.
+    Xapian::docid did = 0;
+
+    /// The sum of the termfreqs of the segments' postlists.
+    Xapian::doccount termfreq = 0;
+
+    /// The highest wdf upper bound of the segments' postlists.
+    Xapian::termcount wdf_upper_bound = 0;
+
+    /// Drop postlists which have ended and find the lowest docid.
+    void update_current();
+
+  public:
+    explicit HoneySegmentedPostList(const std::string& term_)
+	: LeafPostList(term_) { }
+
+    ~HoneySegmentedPostList();
+
+    /** Add the postlist from one segment.
+     *
+     *  Must be called before next() or skip_to().
+     *
+     *  @param pl	The postlist, which we take ownership of.
+     *  @param segment	The database @a pl is from.
+     */
+    void add_postlist(LeafPostList* pl,
+		      const Xapian::Database::Internal* segment);
+
+    Xapian::doccount get_termfreq() const;
+
+    Xapian::docid get_docid() const;
+
+    Xapian::termcount get_wdf() const;
+
+    bool at_end() const;
+
+    PositionList* read_position_list();
+
+    PositionList* open_position_list() const;
+
+    PostList* next(double w_min);
+
+    PostList* skip_to(Xapian::docid did, double w_min);
+
+    const Xapian::docid*
+    get_docid_block(const Xapian::docid*& block_end) const;
+
+    Xapian::termcount get_wdf_upper_bound() const;
+
+    Xapian::termcount get_block_wdf_upper_bound(Xapian::docid& block_last) const;
+
+    std::string get_description() const;
+};
+
+#endif // XAPIAN_INCLUDED_HONEY_SEGMENTEDPOSTLIST_H
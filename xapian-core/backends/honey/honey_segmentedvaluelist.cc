@@ -0,0 +1,151 @@
+/** @file
+ * @brief Value stream in a segmented honey database
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "honey_segmentedvaluelist.h"
+
+#include "omassert.h"
+#include "str.h"
+
+using namespace std;
+
+HoneySegmentedValueList::~HoneySegmentedValueList()
+{
+    for (auto vl : valuelists)
+	delete vl;
+}
+
+void
+HoneySegmentedValueList::add_valuelist(ValueList* vl,
+				       const Xapian::Database::Internal* segment)
+{
+    try {
+	valuelists.push_back(vl);
+    } catch (...) {
+	delete vl;
+	throw;
+    }
+    segments.emplace_back(segment);
+}
+
+void
+HoneySegmentedValueList::update_current()
+{
+    did = 0;
+    size_t j = 0;
+    for (size_t i = 0; i != valuelists.size(); ++i) {
+	ValueList* vl = valuelists[i];
+	if (vl->at_end()) {
+	    delete vl;
+	    continue;
+	}
+	valuelists[j] = vl;
+	Xapian::docid vl_did = vl->get_docid();
+	if (did == 0 || vl_did < did) {
+	    did = vl_did;
+	    current = j;
+	}
+	++j;
+    }
+    valuelists.resize(j);
+}
+
+Xapian::docid
+HoneySegmentedValueList::get_docid() const
+{
+    Assert(!at_end());
+    return did;
+}
+
+Xapian::valueno
+HoneySegmentedValueList::get_valueno() const
+{
+    return slot;
+}
+
+string
+HoneySegmentedValueList::get_value() const
+{
+    Assert(!at_end());
+    return valuelists[current]->get_value();
+}
+
+bool
+HoneySegmentedValueList::at_end() const
+{
+    return valuelists.empty();
+}
+
+void
+HoneySegmentedValueList::next()
+{
+    for (auto vl : valuelists) {
+	// If did is 0 we haven't started yet.
+	if (did == 0 || vl->get_docid() == did)
+	    vl->next();
+    }
+    update_current();
+}
+
+void
+HoneySegmentedValueList::skip_to(Xapian::docid target)
+{
+    if (did != 0 && target <= did)
+	return;
+    for (auto vl : valuelists) {
+	if (did == 0 || vl->get_docid() < target)
+	    vl->skip_to(target);
+    }
+    update_current();
+}
+
+void
+HoneySegmentedValueList::next_in_range(const string& lo, const string* hi)
+{
+    for (auto vl : valuelists) {
+	if (did == 0 || vl->get_docid() == did)
+	    vl->next_in_range(lo, hi);
+    }
+    update_current();
+}
+
+void
+HoneySegmentedValueList::skip_to_in_range(Xapian::docid target,
+					  const string& lo, const string* hi)
+{
+    if (did != 0 && target <= did)
+	return;
+    for (auto vl : valuelists) {
+	if (did == 0 || vl->get_docid() < target)
+	    vl->skip_to_in_range(target, lo, hi);
+    }
+    update_current();
+}
+
+string
+HoneySegmentedValueList::get_description() const
+{
+    string desc = "HoneySegmentedValueList(slot=";
+    desc += str(slot);
+    desc += ", ";
+    desc += str(segments.size());
+    desc += " segments)";
+    return desc;
+}
@@ -0,0 +1,95 @@
+/** @file
+ * @brief Value stream in a segmented honey database
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_HONEY_SEGMENTEDVALUELIST_H
+#define XAPIAN_INCLUDED_HONEY_SEGMENTEDVALUELIST_H
+
+#include "backends/databaseinternal.h"
+#include "backends/valuelist.h"
+
+#include <string>
+#include <vector>
+
+/** Value stream in a segmented honey database.
+ *
+ *  Like HoneySegmentedPostList, this merges the segments' value streams by
+ *  docid.
+ */
+class HoneySegmentedValueList : public ValueList {
+    /// Don't allow assignment.
+    void operator=(const HoneySegmentedValueList&) = delete;
+
+    /// Don't allow copying.
+    HoneySegmentedValueList(const HoneySegmentedValueList&) = delete;
+
+    /// The segments' value streams which haven't reached the end.
+    std::vector<ValueList*> valuelists;
+
+    /// The segments the value streams are from.
+    std::vector<Xapian::Internal::intrusive_ptr<const Xapian::Database::Internal>> segments;
+
+    /// The index in @a valuelists of the current entry.
+    size_t current = 0;
+
+    /// The current docid (0 if we haven't started yet).
+    Xapian::docid did = 0;
+
+    /// The value slot.
+    Xapian::valueno slot;
+
+    /// Drop value streams which have ended and find the lowest docid.
+    void update_current();
+
+  public:
+    explicit HoneySegmentedValueList(Xapian::valueno slot_) : slot(slot_) { }
+
+    ~HoneySegmentedValueList();
+
+    /** Add the value stream from one segment.
+     *
+     *  Must be called before next() or skip_to().
+     *
+     *  @param vl	The value stream, which we take ownership of.
+     *  @param segment	The database @a vl is from.
+     */
+    void add_valuelist(ValueList* vl,
+		       const Xapian::Database::Internal* segment);
+
+    Xapian::docid get_docid() const;
+
+    Xapian::valueno get_valueno() const;
+
+    std::string get_value() const;
+
+    bool at_end() const;
+
+    void next();
+
+    void skip_to(Xapian::docid target);
+
+    void next_in_range(const std::string& lo, const std::string* hi);
+
+    void skip_to_in_range(Xapian::docid target,
+			  const std::string& lo,
+			  const std::string* hi);
+
+    std::string get_description() const;
+};
+
+#endif // XAPIAN_INCLUDED_HONEY_SEGMENTEDVALUELIST_H
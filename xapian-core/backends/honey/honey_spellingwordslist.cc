@@ -69,11 +69,11 @@ HoneySpellingWordsList::get_termfreq() const
     Assert(!cursor->current_key.empty());
     AssertRel(static_cast<unsigned char>(cursor->current_key[0]), >=,
 	      Honey::KEY_PREFIX_WORD);
-    cursor->read_tag();
+    size_t len;
+    const char* p = cursor->read_tag_view(len);
 
     Xapian::termcount freq;
-    const char* p = cursor->current_tag.data();
-    if (!unpack_uint_last(&p, p + cursor->current_tag.size(), &freq)) {
+    if (!unpack_uint_last(&p, p + len, &freq)) {
 	throw Xapian::DatabaseCorruptError("Bad spelling word freq");
     }
     RETURN(freq);
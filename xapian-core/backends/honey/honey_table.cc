@@ -26,9 +26,11 @@
 
 #include "honey_cursor.h"
 #include "stringutils.h"
+#include "xapian/constants.h"
 
 #include "unicode/description_append.h"
 
+#include <algorithm>
 #include <cerrno>
 
 #ifdef DEBUGGING
@@ -39,6 +41,543 @@ using Honey::RootInfo;
 
 using namespace std;
 
+/// Append an entry for a sampled index (skiplist or Eytzinger).
+static void
+append_sampled_entry(string& out, const string& prev_key, const string& key,
+		     off_t ptr)
+{
+    size_t reuse = common_prefix_length(prev_key, key);
+    out += char(reuse);
+    out += char(key.size() - reuse);
+    out.append(key, reuse, string::npos);
+    pack_uint(out, static_cast<make_unsigned<off_t>::type>(ptr));
+}
+
+/** Read an entry of a sampled index.
+ *
+ *  @param file		The file to read from.
+ *  @param key		On entry, the previous key.  On exit, this entry's key.
+ *  @param ptr		Set to this entry's pointer.
+ *
+ *  @return false at the end of a skiplist level.
+ */
+static bool
+read_sampled_entry(const BufferedFile& file, string& key, off_t& ptr)
+{
+    int reuse = file.read();
+    int len = file.read();
+    if (reuse == EOF || len == EOF || size_t(reuse) > key.size())
+	throw Xapian::DatabaseCorruptError("Bad honey table index entry");
+    if (len == 0) {
+	// Two zero bytes end a level.
+	return false;
+    }
+    key.resize(reuse + len);
+    file.read(&key[reuse], len);
+    make_unsigned<off_t>::type p;
+    if (!file.read_packed_uint(&p))
+	throw Xapian::DatabaseCorruptError("Bad honey table index pointer");
+    ptr = static_cast<off_t>(p);
+    return true;
+}
+
+size_t
+SSTIndex::maybe_add_entry(const string& key, off_t ptr, size_t reuse)
+{
+    switch (type) {
+	case Honey::SSTINDEX_ARRAY:
+	    // The array index points to the first key with each initial byte.
+	    if (reuse == 0) {
+		add_array_entry(key, ptr);
+	    }
+	    break;
+	case Honey::SSTINDEX_BINARY_CHOP:
+	    // When we jump to an index point we only know the truncated key
+	    // from the index, so the entry mustn't reuse more than that.
+	    if (add_binary_chop_entry(key, ptr)) {
+		reuse = min(reuse, size_t(SSTINDEX_BINARY_CHOP_KEY_SIZE));
+	    }
+	    break;
+	case Honey::SSTINDEX_SKIPLIST:
+	case Honey::SSTINDEX_EYTZINGER:
+	    // These store the full key, which is enough to decode the entry
+	    // whatever it reuses.
+	    add_sampled_entry(key, ptr);
+	    break;
+    }
+    return reuse;
+}
+
+void
+SSTIndex::add_array_entry(const string& key, off_t ptr)
+{
+    unsigned char initial = key[0];
+    if (!pointers) {
+	pointers = new off_t[256]();
+	first = initial;
+    }
+    // We should only be called for valid index points.
+    AssertRel(int(initial), !=, last);
+
+    while (++last != int(initial)) {
+	pointers[last] = ptr;
+	// FIXME: Perhaps record this differently so that an exact key
+	// search can return false?
+    }
+    pointers[initial] = ptr;
+    last = initial;
+}
+
+bool
+SSTIndex::add_binary_chop_entry(const string& key, off_t ptr)
+{
+    // We store entries truncated to a maximum width (and trailing zeros
+    // are used to indicate keys shorter than that max width).  These then
+    // point to the first key that maps to this truncated value.
+    //
+    // We need constant width entries to allow binary chop to work, but
+    // there are other ways to achieve this which could be explored.  We
+    // could allow the full key width of 256 bytes, but that would take a
+    // lot more space.  We could store a pointer (offset) to the key data,
+    // but that's more complex to read, and adds the pointer overhead.  We
+    // could use a "SKO" - a fixed width entry which encodes variable
+    // length pointer and key with short keys in the entry and long keys
+    // pointed to (or prefix included and rest pointed to).
+    if (last_index_key.size() == SSTINDEX_BINARY_CHOP_KEY_SIZE) {
+	if (startswith(key, last_index_key)) {
+	    return false;
+	}
+    }
+
+    // Ensure the truncated key doesn't end in a zero byte.
+    if (key.size() >= SSTINDEX_BINARY_CHOP_KEY_SIZE) {
+	// FIXME: Start from char N if we have N array index levels above.
+	last_index_key.assign(key, 0, SSTINDEX_BINARY_CHOP_KEY_SIZE);
+	if (key[SSTINDEX_BINARY_CHOP_KEY_SIZE - 1] == '\0')
+	    return false;
+    } else {
+	last_index_key = key;
+	if (key.back() == '\0')
+	    return false;
+	// Pad with zero bytes.
+	last_index_key.resize(SSTINDEX_BINARY_CHOP_KEY_SIZE);
+    }
+
+    // Thin entries to at most one per INDEXBLOCK sized block.
+    size_t cur_block = ptr / INDEXBLOCK;
+    if (cur_block == block)
+	return false;
+
+    if (sizeof(off_t) > 4 && ptr > off_t(0xffffffff))
+	throw Xapian::DatabaseError("Index offset needs >4 bytes");
+    data += last_index_key;
+    size_t c = data.size();
+    data.resize(c + 4);
+    unaligned_write4(reinterpret_cast<unsigned char*>(&data[c]), ptr);
+    ++num_entries;
+
+    block = cur_block;
+    return true;
+}
+
+void
+SSTIndex::add_sampled_entry(const string& key, off_t ptr)
+{
+    size_t cur_block = ptr / INDEXBLOCK;
+    if (cur_block == block) return;
+
+    append_sampled_entry(data, last_index_key, key, ptr);
+    ++num_entries;
+
+    block = cur_block;
+    last_index_key = key;
+}
+
+void
+SSTIndex::write_array()
+{
+    if (!pointers) {
+	first = last = 0;
+	pointers = new off_t[1]();
+    }
+    data.resize(0);
+    data.resize(3 + (last - first + 1) * 4);
+    data[0] = Honey::SSTINDEX_ARRAY;
+    data[1] = first;
+    data[2] = last - first;
+    for (unsigned ch = first; ch <= last; ++ch) {
+	size_t o = 3 + (ch - first) * 4;
+	// FIXME: Just make offsets 8 bytes?  Or allow different widths?
+	off_t ptr = pointers[ch];
+	if (sizeof(off_t) > 4 && ptr > off_t(0xffffffff))
+	    throw Xapian::DatabaseError("Index offset needs >4 bytes");
+	Assert(o + 4 <= data.size());
+	unaligned_write4(reinterpret_cast<unsigned char*>(&data[o]), ptr);
+    }
+    delete [] pointers;
+    pointers = NULL;
+}
+
+void
+SSTIndex::write_binary_chop(off_t root)
+{
+    if (last_index_key.size() == SSTINDEX_BINARY_CHOP_KEY_SIZE) {
+	// Increment final byte(s) to give a key which is definitely
+	// at or above any key which this could be truncated from.
+	size_t i = last_index_key.size();
+	unsigned char ch;
+	do {
+	    if (i == 0) {
+		// We can't increment "\xff\xff\xff\xff" to give an upper
+		// bound - just skip adding one in this case as the table
+		// will handle it OK and there's not much to be gained by
+		// adding one as few keys are larger.
+		goto skip_adding_upper_bound;
+	    }
+	    --i;
+	    ch = static_cast<unsigned char>(last_index_key[i]) + 1;
+	    last_index_key[i] = ch;
+	} while (ch == 0);
+    } else {
+	// Pad with zeros, which gives an upper bound.
+	last_index_key.resize(SSTINDEX_BINARY_CHOP_KEY_SIZE);
+    }
+
+    {
+	if (sizeof(off_t) > 4 && root > off_t(0xffffffff))
+	    throw Xapian::DatabaseError("Index offset needs >4 bytes");
+	data += last_index_key;
+	size_t c = data.size();
+	data.resize(c + 4);
+	unaligned_write4(reinterpret_cast<unsigned char*>(&data[c]), root);
+	++num_entries;
+    }
+
+skip_adding_upper_bound:
+    // Prepend the type and the number of entries.
+    char header[5];
+    header[0] = Honey::SSTINDEX_BINARY_CHOP;
+    unaligned_write4(reinterpret_cast<unsigned char*>(header + 1),
+		     num_entries);
+    data.insert(0, header, sizeof(header));
+}
+
+void
+SSTIndex::write_skiplist()
+{
+    // Build levels above the one in data until the top level is small enough
+    // to just scan.
+    vector<string> levels;
+    levels.push_back(std::move(data));
+    while (levels.back().size() > INDEXBLOCK) {
+	const string& level = levels.back();
+	string parent;
+	string prev_key, key, parent_prev_key;
+	size_t parent_block = size_t(-1);
+	const char* p = level.data();
+	const char* end = p + level.size();
+	while (p != end) {
+	    size_t entry_offset = p - level.data();
+	    size_t reuse = static_cast<unsigned char>(*p++);
+	    size_t len = static_cast<unsigned char>(*p++);
+	    key.assign(prev_key, 0, reuse);
+	    key.append(p, len);
+	    p += len;
+	    make_unsigned<off_t>::type ptr;
+	    if (!unpack_uint(&p, end, &ptr))
+		throw Xapian::DatabaseError("Bad skiplist entry");
+	    if (entry_offset / INDEXBLOCK != parent_block) {
+		append_sampled_entry(parent, parent_prev_key, key,
+				     off_t(entry_offset));
+		parent_block = entry_offset / INDEXBLOCK;
+		parent_prev_key = key;
+	    }
+	    swap(prev_key, key);
+	}
+	levels.push_back(std::move(parent));
+    }
+
+    size_t n_levels = levels.size();
+    if (n_levels > 255)
+	throw Xapian::DatabaseError("Too many skiplist levels");
+    data.assign(1, char(Honey::SSTINDEX_SKIPLIST));
+    data += char(n_levels);
+    size_t level_offset = data.size() + 4 * n_levels;
+    for (const string& level : levels) {
+	if (level_offset > 0xffffffff)
+	    throw Xapian::DatabaseError("Skiplist index too large");
+	size_t c = data.size();
+	data.resize(c + 4);
+	unaligned_write4(reinterpret_cast<unsigned char*>(&data[c]),
+			 level_offset);
+	level_offset += level.size() + 2;
+    }
+    for (const string& level : levels) {
+	data += level;
+	data.append(2, '\0');
+    }
+}
+
+off_t
+SSTIndex::write(BufferedFile& store)
+{
+    off_t root = store.get_pos();
+
+    switch (type) {
+	case Honey::SSTINDEX_ARRAY:
+	    write_array();
+	    break;
+	case Honey::SSTINDEX_BINARY_CHOP:
+	    write_binary_chop(root);
+	    break;
+	case Honey::SSTINDEX_SKIPLIST:
+	    write_skiplist();
+	    break;
+	case Honey::SSTINDEX_EYTZINGER: {
+	    string header(1, char(Honey::SSTINDEX_EYTZINGER));
+	    pack_uint(header, num_entries);
+	    data.insert(0, header);
+	    break;
+	}
+    }
+
+    store.write(data.data(), data.size());
+    return root;
+}
+
+HoneySampledIndex::HoneySampledIndex(BufferedFile& file)
+{
+    size_t n;
+    if (!file.read_packed_uint(&n))
+	throw Xapian::DatabaseCorruptError("Bad honey table index size");
+    key_offsets.reserve(n + 1);
+    pointers.reserve(n);
+    string key;
+    for (size_t i = 0; i != n; ++i) {
+	off_t ptr;
+	if (!read_sampled_entry(file, key, ptr))
+	    throw Xapian::DatabaseCorruptError("Bad honey table index entry");
+	key_offsets.push_back(key_data.size());
+	key_data += key;
+	pointers.push_back(ptr);
+    }
+    key_offsets.push_back(key_data.size());
+    tree.resize(n + 1);
+    build(1, 0);
+}
+
+size_t
+HoneySampledIndex::build(size_t k, size_t rank)
+{
+    if (k < tree.size()) {
+	rank = build(2 * k, rank);
+	tree[k].prefix = key_prefix(key_data.data() + key_offsets[rank],
+				    key_offsets[rank + 1] - key_offsets[rank]);
+	tree[k].rank = rank;
+	rank = build(2 * k + 1, rank + 1);
+    }
+    return rank;
+}
+
+bool
+HoneySampledIndex::find(const string& key, off_t& pos, string& prev_key) const
+{
+    const uint64_t target = key_prefix(key.data(), key.size());
+    const size_t n = pointers.size();
+    // Descend the tree, going right if the node's key is <= key.
+    size_t k = 1;
+    while (k <= n) {
+	const Node& node = tree[k];
+	bool le;
+	if (node.prefix != target) {
+	    le = (node.prefix < target);
+	} else {
+	    size_t o = key_offsets[node.rank];
+	    le = key.compare(0, key.size(), key_data,
+			     o, key_offsets[node.rank + 1] - o) >= 0;
+	}
+	k = 2 * k + le;
+    }
+    // The first key > key is where we last went left, which we find by
+    // undoing the moves right after it, and then the move left.
+    while (k & 1) k >>= 1;
+    k >>= 1;
+    size_t upper = (k == 0) ? n : tree[k].rank;
+    if (upper == 0)
+	return false;
+    size_t rank = upper - 1;
+    pos = pointers[rank];
+    prev_key.assign(key_data, key_offsets[rank],
+		    key_offsets[rank + 1] - key_offsets[rank]);
+    return true;
+}
+
+void
+HoneyTable::load_index()
+{
+    sampled_index.reset();
+    index_type = EOF;
+    bloom = HoneyBloomFilter();
+    if (!read_only || !store.is_open())
+	return;
+    store.set_pos(root);
+    index_type = store.read();
+    if (index_type == Honey::SSTINDEX_EYTZINGER) {
+	sampled_index.reset(new HoneySampledIndex(store));
+    }
+    if (filter) {
+	store.set_pos(root + filter);
+	uint64_t num_blocks;
+	if (!store.read_packed_uint(&num_blocks))
+	    throw Xapian::DatabaseCorruptError("Bad honey Bloom filter size");
+	string blocks(HoneyBloomFilter::blocks_size(num_blocks), '\0');
+	store.read(&blocks[0], blocks.size());
+	bloom.assign(num_blocks, std::move(blocks));
+    }
+}
+
+void
+HoneyTable::write_filter()
+{
+    filter = 0;
+    if (bloom_bits_per_key == 0 || bloom_hashes.empty())
+	return;
+    HoneyBloomFilter new_bloom;
+    new_bloom.build(bloom_hashes, bloom_bits_per_key);
+    vector<uint64_t>().swap(bloom_hashes);
+    string s;
+    new_bloom.serialise(s);
+    filter = store.get_pos() - root;
+    store.write(s.data(), s.size());
+}
+
+bool
+HoneyTable::search_index(BufferedFile& file, const string& key,
+			 off_t& pos, string& prev_key) const
+{
+    if (sampled_index) {
+	if (!sampled_index->find(key, pos, prev_key)) {
+	    // key is before the first sampled key.
+	    pos = offset;
+	    prev_key.resize(0);
+	}
+	return true;
+    }
+
+    file.rewind(root);
+    int type = file.read();
+    switch (type) {
+	case EOF:
+	    return false;
+	case Honey::SSTINDEX_ARRAY: {
+	    unsigned char first =
+		static_cast<unsigned char>(key[0] - file.read());
+	    unsigned char range = file.read();
+	    if (first > range)
+		return false;
+	    file.skip(first * 4); // FIXME: pointer width
+	    pos = file.read_uint4_be();
+	    // The jump point will be an entirely new key (because it is the
+	    // first key with that initial character), and we drop in as if
+	    // this was the first key so set prev_key to be empty.
+	    prev_key.resize(0);
+	    return true;
+	}
+	case Honey::SSTINDEX_BINARY_CHOP: {
+	    size_t j = file.read_uint4_be();
+	    if (j == 0)
+		return false;
+	    off_t base = file.get_pos();
+	    char kkey[SSTINDEX_BINARY_CHOP_KEY_SIZE];
+	    size_t kkey_len = 0;
+	    size_t i = 0;
+	    while (j - i > 1) {
+		size_t k = i + (j - i) / 2;
+		file.set_pos(base + k * SSTINDEX_BINARY_CHOP_ENTRY_SIZE);
+		file.read(kkey, SSTINDEX_BINARY_CHOP_KEY_SIZE);
+		kkey_len = SSTINDEX_BINARY_CHOP_KEY_SIZE;
+		while (kkey_len > 0 && kkey[kkey_len - 1] == '\0') --kkey_len;
+		int r = key.compare(0, SSTINDEX_BINARY_CHOP_KEY_SIZE,
+				    kkey, kkey_len);
+		if (r < 0) {
+		    j = k;
+		} else {
+		    i = k;
+		    if (r == 0) {
+			break;
+		    }
+		}
+	    }
+	    file.set_pos(base + i * SSTINDEX_BINARY_CHOP_ENTRY_SIZE);
+	    file.read(kkey, SSTINDEX_BINARY_CHOP_KEY_SIZE);
+	    kkey_len = SSTINDEX_BINARY_CHOP_KEY_SIZE;
+	    while (kkey_len > 0 && kkey[kkey_len - 1] == '\0') --kkey_len;
+	    if (key.compare(0, SSTINDEX_BINARY_CHOP_KEY_SIZE,
+			    kkey, kkey_len) < 0) {
+		// key is before the first index entry (the first key in the
+		// table doesn't always get an entry).
+		pos = offset;
+		prev_key.resize(0);
+		return true;
+	    }
+	    pos = file.read_uint4_be();
+	    // The jump point is to the first key with prefix kkey, and entries
+	    // at index points don't reuse more of the previous key than that.
+	    prev_key.assign(kkey, kkey_len);
+	    return true;
+	}
+	case Honey::SSTINDEX_SKIPLIST: {
+	    unsigned n_levels = file.read();
+	    if (n_levels == 0 || n_levels > 255)
+		throw Xapian::DatabaseCorruptError("Bad skiplist index");
+	    // Read the offsets we need: the top level, then each lower level.
+	    vector<off_t> level_start(n_levels);
+	    for (unsigned i = 0; i != n_levels; ++i) {
+		level_start[i] = root + off_t(file.read_uint4_be());
+	    }
+
+	    // Scan the top level from its start.
+	    unsigned level = n_levels - 1;
+	    file.set_pos(level_start[level]);
+	    prev_key.resize(0);
+	    string entry_key;
+	    while (true) {
+		bool found = false;
+		off_t ptr = 0, entry_ptr;
+		entry_key = prev_key;
+		while (read_sampled_entry(file, entry_key, entry_ptr)) {
+		    if (entry_key > key) break;
+		    prev_key = entry_key;
+		    ptr = entry_ptr;
+		    found = true;
+		}
+		if (!found) {
+		    // Only possible at the top level, if key is before the
+		    // first sampled key.
+		    if (level != n_levels - 1)
+			throw Xapian::DatabaseCorruptError("Bad skiplist");
+		    pos = offset;
+		    prev_key.resize(0);
+		    return true;
+		}
+		if (level == 0) {
+		    pos = ptr;
+		    return true;
+		}
+		// Continue scanning from the entry for prev_key in the level
+		// below, which we can decode as we know its full key.
+		--level;
+		file.set_pos(level_start[level] + ptr);
+	    }
+	}
+	default: {
+	    string m = "HoneyTable: Unknown index type ";
+	    m += str(type);
+	    throw Xapian::DatabaseCorruptError(m);
+	}
+    }
+}
+
 void
 HoneyTable::create_and_open(int flags_, const RootInfo& root_info)
 {
@@ -48,10 +587,11 @@ HoneyTable::create_and_open(int flags_, const RootInfo& root_info)
     if (read_only) {
 	num_entries = root_info.get_num_entries();
 	root = root_info.get_root();
-	// FIXME: levels
+	filter = root_info.get_filter();
     }
     if (!store.open(path, read_only))
 	throw Xapian::DatabaseOpeningError("Failed to open HoneyTable", errno);
+    load_index();
 }
 
 void
@@ -62,14 +602,27 @@ HoneyTable::open(int flags_, const RootInfo& root_info, honey_revision_number_t)
     num_entries = root_info.get_num_entries();
     offset = root_info.get_offset();
     root = root_info.get_root();
+    filter = root_info.get_filter();
     if (!single_file() && !store.open(path, read_only)) {
 	if (!lazy)
 	    throw Xapian::DatabaseOpeningError("Failed to open HoneyTable",
 					       errno);
     }
+    load_index();
     store.set_pos(offset);
 }
 
+void
+HoneyTable::use_mmap(int mmap_flags)
+{
+    if (!read_only || !store.map_file())
+	return;
+    if (mmap_flags & Xapian::DB_MMAP_RANDOM)
+	store.advise(IO_MMAP_RANDOM);
+    if (mmap_flags & Xapian::DB_MMAP_WILLNEED)
+	store.advise(IO_MMAP_WILLNEED);
+}
+
 void
 HoneyTable::add(const std::string& key,
 		const char* val,
@@ -99,32 +652,15 @@ HoneyTable::add(const std::string& key,
 	throw Xapian::InvalidOperationError("New key <= previous key");
     size_t reuse = common_prefix_length(last_key, key);
 
-#ifdef SSTINDEX_ARRAY
-    if (reuse == 0) {
-	index.maybe_add_entry(key, store.get_pos());
-    }
-#elif defined SSTINDEX_BINARY_CHOP
-    // For a binary chop index, the index point is before the key info - the
-    // index key must have the same N first bytes as the previous key, where
-    // N >= the keep length.
-    index.maybe_add_entry(key, store.get_pos());
-#elif defined SSTINDEX_SKIPLIST
-    // Handled below.
-#else
-# error SSTINDEX type not specified
-#endif
+    reuse = index.maybe_add_entry(key, store.get_pos(), reuse);
+    if (bloom_bits_per_key)
+	bloom_hashes.push_back(HoneyBloomFilter::hash(key));
 
     store.write(static_cast<unsigned char>(reuse));
     store.write(static_cast<unsigned char>(key.size() - reuse));
     store.write(key.data() + reuse, key.size() - reuse);
     ++num_entries;
 
-#ifdef SSTINDEX_SKIPLIST
-    // For a skiplist index, the index provides the full key, so the index
-    // point is after the key at the level below.
-    index.maybe_add_entry(key, store.get_pos());
-#endif
-
     // Encode "compressed?" flag in bottom bit.
     // FIXME: Don't do this if a table is uncompressed?  That saves a byte
     // for each item where the extra bit pushes the length up by a byte.
@@ -146,6 +682,7 @@ HoneyTable::commit(honey_revision_number_t, RootInfo* root_info)
     root_info->set_num_entries(num_entries);
     // offset should already be set.
     root_info->set_root(root);
+    root_info->set_filter(filter);
     // Not really meaningful.
     // root_info->set_free_list(std::string());
 
@@ -252,186 +789,29 @@ HoneyTable::get_exact_entry(const std::string& key, std::string* tag) const
 	    throw_database_closed();
 	return false;
     }
-    store.rewind(root);
     if (rare(key.empty()))
 	return false;
-    bool exact_match = false;
-    bool compressed = false;
-    size_t val_size = 0;
-    int index_type = store.read();
-    switch (index_type) {
-	case EOF:
-	    return false;
-	case 0x00: {
-	    unsigned char first =
-		static_cast<unsigned char>(key[0] - store.read());
-	    unsigned char range = store.read();
-	    if (first > range)
-		return false;
-	    store.skip(first * 4); // FIXME: pointer width
-	    off_t jump = store.read_uint4_be();
-	    store.rewind(jump);
-	    // The jump point will be an entirely new key (because it is the
-	    // first key with that initial character), and we drop in as if
-	    // this was the first key so set last_key to be empty.
-	    last_key = string();
-	    break;
-	}
-	case 0x01: {
-	    size_t j = store.read_uint4_be();
-	    if (j == 0)
-		return false;
-	    off_t base = store.get_pos();
-	    char kkey[SSTINDEX_BINARY_CHOP_KEY_SIZE];
-	    size_t kkey_len = 0;
-	    size_t i = 0;
-	    while (j - i > 1) {
-		size_t k = i + (j - i) / 2;
-		store.set_pos(base + k * SSTINDEX_BINARY_CHOP_ENTRY_SIZE);
-		store.read(kkey, SSTINDEX_BINARY_CHOP_KEY_SIZE);
-		kkey_len = 4;
-		while (kkey_len > 0 && kkey[kkey_len - 1] == '\0') --kkey_len;
-		int r = key.compare(0, SSTINDEX_BINARY_CHOP_KEY_SIZE,
-				    kkey, kkey_len);
-		if (r < 0) {
-		    j = k;
-		} else {
-		    i = k;
-		    if (r == 0) {
-			break;
-		    }
-		}
-	    }
-	    store.set_pos(base + i * SSTINDEX_BINARY_CHOP_ENTRY_SIZE);
-	    store.read(kkey, SSTINDEX_BINARY_CHOP_KEY_SIZE);
-	    kkey_len = 4;
-	    while (kkey_len > 0 && kkey[kkey_len - 1] == '\0') --kkey_len;
-	    off_t jump = store.read_uint4_be();
-	    store.rewind(jump);
-	    // The jump point is to the first key with prefix kkey, so will
-	    // work if we set last key to kkey.  Unless we're jumping to the
-	    // start of the table, in which case last_key needs to be empty.
-	    last_key.assign(kkey, jump == 0 ? 0 : kkey_len);
-	    break;
-	}
-	case 0x02: {
-	    // FIXME: If "close" just seek forwards?  Or consider seeking from
-	    // current index pos?
-	    // off_t pos = store.get_pos();
-	    string index_key, prev_index_key;
-	    make_unsigned<off_t>::type ptr = 0;
-	    int cmp0 = 1;
-	    while (true) {
-		int reuse = store.read();
-		if (reuse == EOF) break;
-		int len = store.read();
-		if (len == EOF) abort(); // FIXME
-		index_key.resize(reuse + len);
-		store.read(&index_key[reuse], len);
-
-#ifdef DEBUGGING
-		{
-		    string desc;
-		    description_append(desc, index_key);
-		    cerr << "Index key: " << desc << endl;
-		}
-#endif
-
-		cmp0 = index_key.compare(key);
-		if (cmp0 > 0) {
-		    index_key = prev_index_key;
-		    break;
-		}
-		char buf[8];
-		char* e = buf;
-		while (true) {
-		    int b = store.read();
-		    *e++ = b;
-		    if ((b & 0x80) == 0) break;
-		}
-		const char* p = buf;
-		if (!unpack_uint(&p, e, &ptr) || p != e) abort(); // FIXME
-#ifdef DEBUGGING
-		{
-		    cerr << " -> " << ptr << endl;
-		}
-#endif
-		if (cmp0 == 0)
-		    break;
-		prev_index_key = index_key;
-	    }
-#ifdef DEBUGGING
-	    {
-		cerr << " cmp0 = " << cmp0 << ", going to " << ptr << endl;
-	    }
-#endif
-	    store.set_pos(ptr);
-
-	    if (ptr != 0) {
-		last_key = index_key;
-		char buf[8];
-		int r;
-		{
-		    // FIXME: rework to take advantage of buffering that's happening anyway?
-		    char* p = buf;
-		    for (int i = 0; i < 8; ++i) {
-			int ch2 = store.read();
-			if (ch2 == EOF) {
-			    break;
-			}
-			*p++ = ch2;
-			if (ch2 < 128) break;
-		    }
-		    r = p - buf;
-		}
-		const char* p = buf;
-		const char* end = p + r;
-		if (!unpack_uint(&p, end, &val_size)) {
-		    throw Xapian::DatabaseError("val_size unpack_uint invalid");
-		}
-		compressed = val_size & 1;
-		val_size >>= 1;
-		Assert(p == end);
-	    } else {
-		last_key = string();
-	    }
-
-	    if (cmp0 == 0) {
-		exact_match = true;
-		break;
-	    }
-
-#ifdef DEBUGGING
-	    {
-		string desc;
-		description_append(desc, last_key);
-		cerr << "Dropped to data layer on key: " << desc << endl;
-	    }
-#endif
-
-	    break;
-	}
-	default: {
-	    string m = "HoneyTable: Unknown index type ";
-	    m += str(index_type);
-	    throw Xapian::DatabaseCorruptError(m);
-	}
-    }
+    if (!bloom.may_contain(key))
+	return false;
+    off_t pos;
+    if (!search_index(store, key, pos, last_key))
+	return false;
+    store.rewind(pos);
 
     std::string k;
+    bool compressed = false;
+    size_t val_size = 0;
     int cmp;
-    if (!exact_match) {
-	do {
-	    if (val_size) {
-		// Skip val data we've not looked at.
-		store.skip(val_size);
-		val_size = 0;
-	    }
-	    if (!read_key(k, val_size, compressed)) return false;
-	    cmp = k.compare(key);
-	} while (cmp < 0);
-	if (cmp > 0) return false;
-    }
+    do {
+	if (val_size) {
+	    // Skip val data we've not looked at.
+	    store.skip(val_size);
+	    val_size = 0;
+	}
+	if (!read_key(k, val_size, compressed)) return false;
+	cmp = k.compare(key);
+    } while (cmp < 0);
+    if (cmp > 0) return false;
     if (tag != NULL) {
 	if (compressed) {
 	    std::string v;
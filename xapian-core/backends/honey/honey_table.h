@@ -25,10 +25,6 @@
 # error config.h must be included first in each C++ source file
 #endif
 
-#define SSTINDEX_ARRAY
-//#define SSTINDEX_BINARY_CHOP
-//#define SSTINDEX_SKIPLIST
-
 #define SSTINDEX_BINARY_CHOP_KEY_SIZE 4
 #define SSTINDEX_BINARY_CHOP_PTR_SIZE 4
 #define SSTINDEX_BINARY_CHOP_ENTRY_SIZE \
@@ -42,9 +38,12 @@
 #include <iostream> // FIXME
 #endif
 
+#include <cstdint>
 #include <cstdio> // For EOF
 #include <cstdlib> // std::abort()
+#include <memory>
 #include <type_traits>
+#include <vector>
 #ifdef HAVE_SYS_UIO_H
 # include <sys/uio.h>
 #endif
@@ -54,6 +53,7 @@
 #include "safeunistd.h"
 
 #include "compression_stream.h"
+#include "honey_bloom.h"
 #include "honey_defs.h"
 #include "honey_version.h"
 #include "internaltypes.h"
@@ -79,9 +79,17 @@ class BufferedFileCommon {
     unsigned _refs = 0;
     off_t offset = 0;
 
+    /// Read-only mapping of the whole file, or NULL if not mapped.
+    const char* map = nullptr;
+    size_t map_size = 0;
+
     BufferedFileCommon(int fd_, off_t offset_)
 	: fd(fd_), _refs(1), offset(offset_) {}
 
+    ~BufferedFileCommon() {
+	if (map) io_munmap(map, map_size);
+    }
+
     BufferedFileCommon(const BufferedFileCommon&) = delete;
 
     BufferedFileCommon& operator=(const BufferedFileCommon&) = delete;
@@ -90,6 +98,16 @@ class BufferedFileCommon {
 class BufferedFile {
     BufferedFileCommon* common = nullptr;
 
+    /** The file mapping from common, or NULL.
+     *
+     *  When the file is mapped, reads come straight from the mapping and buf
+     *  isn't used.
+     */
+    const char* map = nullptr;
+
+    /// The size of the mapping.
+    off_t map_size = 0;
+
     mutable off_t pos = 0;
     bool read_only = true;
     mutable size_t buf_end = 0;
@@ -100,7 +118,8 @@ class BufferedFile {
   public:
     BufferedFile() { }
 
-    BufferedFile(const BufferedFile& o) : common(o.common) {
+    BufferedFile(const BufferedFile& o)
+	: common(o.common), map(o.map), map_size(o.map_size) {
 	if (!o.read_only) std::abort();
 	if (common) ++common->_refs;
 #if 0
@@ -146,6 +165,8 @@ class BufferedFile {
 	if (common && --common->_refs == 0)
 	    delete common;
 	common = nullptr;
+	map = nullptr;
+	map_size = 0;
 	read_only = read_only_;
 	int fd;
 	if (read_only) {
@@ -160,6 +181,37 @@ class BufferedFile {
 	return true;
     }
 
+    /** Read the file via a memory mapping.
+     *
+     *  The mapping is shared with copies of this object made after this call,
+     *  and remains valid until they have all been destroyed.
+     *
+     *  @return false if the file couldn't be mapped, in which case reads
+     *		continue to use a buffer.
+     */
+    bool map_file() {
+	if (map) return true;
+	if (!read_only || !is_open()) return false;
+	struct stat statbuf;
+	if (fstat(common->fd, &statbuf) < 0 || statbuf.st_size <= 0)
+	    return false;
+	size_t size = statbuf.st_size;
+	const char* p = io_mmap_read(common->fd, size);
+	if (!p) return false;
+	common->map = map = p;
+	common->map_size = size;
+	map_size = size;
+	// Any buffered data is now stale.
+	pos = get_pos();
+	buf_end = 0;
+	return true;
+    }
+
+    /// Hint how the mapping will be accessed (if the file is mapped).
+    void advise(io_mmap_advice advice) const {
+	if (map) io_mmap_advise(map, map_size, advice);
+    }
+
     off_t get_pos() const {
 	return read_only ? pos - buf_end : pos + buf_end;
     }
@@ -257,6 +309,10 @@ class BufferedFile {
     }
 
     int read() const {
+	if (map) {
+	    if (pos >= map_size) return EOF;
+	    return static_cast<unsigned char>(map[pos++]);
+	}
 	if (buf_end == 0) {
 	    // The buffer is currently empty, so we need to read at least one
 	    // byte.
@@ -273,6 +329,21 @@ class BufferedFile {
 	return static_cast<unsigned char>(buf[sizeof(buf) - buf_end--]);
     }
 
+    /// Read a value encoded with pack_uint().
+    template<typename U>
+    bool read_packed_uint(U* result) const {
+	char b[(sizeof(U) * 8 + 6) / 7];
+	char* e = b;
+	while (true) {
+	    int ch = read();
+	    if (ch == EOF || e == b + sizeof(b)) return false;
+	    *e++ = char(ch);
+	    if (ch < 128) break;
+	}
+	const char* p = b;
+	return unpack_uint(&p, e, result);
+    }
+
     uint4 read_uint4_be() const {
 	uint4 res = read() << 24;
 	res |= read() << 16;
@@ -281,7 +352,26 @@ class BufferedFile {
 	return res;
     }
 
+    /** Return a pointer to the next @a len bytes and skip over them.
+     *
+     *  @return NULL if the file isn't mapped, in which case nothing is
+     *		skipped.  Otherwise the returned pointer is valid for as long
+     *		as this object (or a copy of it) exists.
+     */
+    const char* read_view(size_t len) const {
+	if (!map) return NULL;
+	if (len > size_t(map_size - pos))
+	    throw Xapian::DatabaseCorruptError("Read past end of honey table");
+	const char* p = map + pos;
+	pos += len;
+	return p;
+    }
+
     void read(char* p, size_t len) const {
+	if (map) {
+	    memcpy(p, read_view(len), len);
+	    return;
+	}
 	if (buf_end != 0) {
 	    if (len <= buf_end) {
 		memcpy(p, buf + sizeof(buf) - buf_end, len);
@@ -321,213 +411,158 @@ class BufferedFile {
 
 class HoneyCursor;
 
+/** Builds the index for a honey table as entries are added.
+ *
+ *  The index is written after the table's entries, and starts with a byte
+ *  giving its type (see Honey::sstindex_type):
+ *
+ *  SSTINDEX_ARRAY: C<first byte> C<last byte - first byte> followed by a
+ *  4 byte pointer for each possible first byte of a key in that range.
+ *
+ *  SSTINDEX_BINARY_CHOP: 4 byte entry count, then fixed-width entries of a
+ *  key prefix (zero padded) and a 4 byte pointer.
+ *
+ *  SSTINDEX_SKIPLIST: C<number of levels> followed by a 4 byte offset from the
+ *  start of the index to each level.  Each level is a list of entries
+ *  (C<reuse> C<length> key suffix I<pointer>) ended by two zero bytes.  The
+ *  pointers in level 0 are to entries in the table, and those in level N + 1
+ *  are offsets into level N.
+ *
+ *  SSTINDEX_EYTZINGER: I<number of entries> followed by entries encoded as
+ *  for level 0 of a skiplist.  This is loaded into memory when the table is
+ *  opened (see HoneySampledIndex).
+ *
+ *  The skiplist and Eytzinger indexes sample a full key every INDEXBLOCK
+ *  bytes, so lookups only need to scan at most that much of the table.
+ */
 class SSTIndex {
+    /// The type of index to build.
+    Honey::sstindex_type type = Honey::SSTINDEX_ARRAY;
+
+    /** Index entries built so far.
+     *
+     *  For SSTINDEX_ARRAY this is only filled in by write().
+     */
     std::string data;
-#if defined SSTINDEX_BINARY_CHOP
+
+    /// Block of the table (of size INDEXBLOCK) the last entry was added in.
     size_t block = size_t(-1);
-#elif defined SSTINDEX_SKIPLIST
-    size_t block = 0;
-#endif
-#if defined SSTINDEX_BINARY_CHOP || defined SSTINDEX_SKIPLIST
+
+    /// The key for the last entry added.
     std::string last_index_key;
-#endif
+
+    /// Number of entries in data.
+    size_t num_entries = 0;
+
     // Put an index entry every this much:
     // FIXME: tune - seems 64K is common elsewhere
     enum { INDEXBLOCK = 4096 };
-    SSTIndex* parent_index = NULL;
 
-#ifdef SSTINDEX_ARRAY
     unsigned char first, last = static_cast<unsigned char>(-1);
     off_t* pointers = NULL;
-#endif
+
+    void add_array_entry(const std::string& key, off_t ptr);
+
+    bool add_binary_chop_entry(const std::string& key, off_t ptr);
+
+    void add_sampled_entry(const std::string& key, off_t ptr);
+
+    void write_array();
+
+    void write_binary_chop(off_t root);
+
+    void write_skiplist();
 
   public:
-    SSTIndex() {
-#ifdef SSTINDEX_ARRAY
-	// Header added in write() method.
-#elif defined SSTINDEX_BINARY_CHOP
-	data.assign(5, '\x01');
-#elif defined SSTINDEX_SKIPLIST
-	data.assign(1, '\x02');
-#else
-# error SSTINDEX type not specified
-#endif
-    }
+    SSTIndex() { }
 
     ~SSTIndex() {
-#ifdef SSTINDEX_ARRAY
 	delete [] pointers;
-#endif
     }
 
-    void maybe_add_entry(const std::string& key, off_t ptr) {
-#ifdef SSTINDEX_ARRAY
-	unsigned char initial = key[0];
-	if (!pointers) {
-	    pointers = new off_t[256]();
-	    first = initial;
-	}
-	// We should only be called for valid index points.
-	AssertRel(int(initial), !=, last);
-
-	while (++last != int(initial)) {
-	    pointers[last] = ptr;
-	    // FIXME: Perhaps record this differently so that an exact key
-	    // search can return false?
-	}
-	pointers[initial] = ptr;
-	last = initial;
-#elif defined SSTINDEX_BINARY_CHOP
-	// We store entries truncated to a maximum width (and trailing zeros
-	// are used to indicate keys shorter than that max width).  These then
-	// point to the first key that maps to this truncated value.
-	//
-	// We need constant width entries to allow binary chop to work, but
-	// there are other ways to achieve this which could be explored.  We
-	// could allow the full key width of 256 bytes, but that would take a
-	// lot more space.  We could store a pointer (offset) to the key data,
-	// but that's more complex to read, and adds the pointer overhead.  We
-	// could use a "SKO" - a fixed width entry which encodes variable
-	// length pointer and key with short keys in the entry and long keys
-	// pointed to (or prefix included and rest pointed to).
-	if (last_index_key.size() == SSTINDEX_BINARY_CHOP_KEY_SIZE) {
-	    if (startswith(key, last_index_key)) {
-		return;
-	    }
-	}
+    /// Set the type of index to build (before any entries are added).
+    void set_type(Honey::sstindex_type type_) {
+	Assert(num_entries == 0 && !pointers);
+	type = type_;
+    }
 
-	// Ensure the truncated key doesn't end in a zero byte.
-	if (key.size() >= SSTINDEX_BINARY_CHOP_KEY_SIZE) {
-	    // FIXME: Start from char N if we have N array index levels above.
-	    last_index_key.assign(key, 0, SSTINDEX_BINARY_CHOP_KEY_SIZE);
-	    if (key[SSTINDEX_BINARY_CHOP_KEY_SIZE - 1] == '\0')
-		return;
-	} else {
-	    last_index_key = key;
-	    if (key.back() == '\0')
-		return;
-	    // Pad with zero bytes.
-	    last_index_key.resize(SSTINDEX_BINARY_CHOP_KEY_SIZE);
-	}
+    Honey::sstindex_type get_type() const { return type; }
 
-	// Thin entries to at most one per INDEXBLOCK sized block.
-	size_t cur_block = ptr / INDEXBLOCK;
-	if (cur_block == block)
-	    return;
+    /** Add an index entry if @a key is a suitable index point.
+     *
+     *  @param key	The key about to be added to the table.
+     *  @param ptr	The file offset the entry for @a key will start at.
+     *  @param reuse	How many bytes @a key shares with the previous key.
+     *
+     *  @return How many bytes of the previous key the entry for @a key should
+     *		reuse.  This is less than @a reuse if an index entry was added
+     *		which only records a prefix of @a key.
+     */
+    size_t maybe_add_entry(const std::string& key, off_t ptr, size_t reuse);
 
-#if 0
-	{
-	    std::string esc;
-	    description_append(esc, last_index_key);
-	    std::cout << "Adding «" << esc << "» -> file offset " << ptr
-		      << std::endl;
-	}
-#endif
-	data += last_index_key;
-	size_t c = data.size();
-	data.resize(c + 4);
-	unaligned_write4(reinterpret_cast<unsigned char*>(&data[c]), ptr);
+    off_t write(BufferedFile& store);
 
-	block = cur_block;
-#elif defined SSTINDEX_SKIPLIST
-	size_t cur_block = ptr / INDEXBLOCK;
-	if (cur_block == block) return;
+    size_t size() const {
+	// FIXME: For SSTINDEX_ARRAY, data.size() only correct after calling
+	// write().
+	return data.size();
+    }
+};
 
-	size_t reuse = common_prefix_length(last_index_key, key);
+/** In-memory copy of an SSTINDEX_EYTZINGER index.
+ *
+ *  The sampled keys are searched using an Eytzinger layout - the implicit
+ *  binary search tree is stored in breadth-first order, so the first few
+ *  levels of the tree share cache lines and each step only depends on the
+ *  previous comparison.  Each node holds the first 8 bytes of its key as an
+ *  integer so most steps don't need to look at the key itself.
+ */
+class HoneySampledIndex {
+    struct Node {
+	/// The first 8 bytes of the key big-endian (zero padded).
+	std::uint64_t prefix;
 
-	data += char(reuse);
-	data += char(key.size() - reuse);
-	data.append(key, reuse, key.size() - reuse);
-	pack_uint(data, static_cast<std::make_unsigned<off_t>::type>(ptr));
+	/// The position of the key in sorted order.
+	size_t rank;
+    };
 
-	block = cur_block;
-	// FIXME: deal with parent_index...
+    /// The search tree (tree[0] is unused).
+    std::vector<Node> tree;
 
-	last_index_key = key;
-#else
-# error SSTINDEX type not specified
-#endif
-    }
+    /// The sampled keys in sorted order, concatenated.
+    std::string key_data;
 
-    off_t write(BufferedFile& store) {
-	off_t root = store.get_pos();
+    /// Offset of each key in key_data, followed by key_data.size().
+    std::vector<size_t> key_offsets;
 
-#ifdef SSTINDEX_ARRAY
-	if (!pointers) {
-	    first = last = 0;
-	    pointers = new off_t[1]();
-	}
-	data.resize(0);
-	data.resize(3 + (last - first + 1) * 4);
-	data[0] = 0;
-	data[1] = first;
-	data[2] = last - first;
-	for (unsigned ch = first; ch <= last; ++ch) {
-	    size_t o = 3 + (ch - first) * 4;
-	    // FIXME: Just make offsets 8 bytes?  Or allow different widths?
-	    off_t ptr = pointers[ch];
-	    if (sizeof(off_t) > 4 && ptr > off_t(0xffffffff))
-		throw Xapian::DatabaseError("Index offset needs >4 bytes");
-	    Assert(o + 4 <= data.size());
-	    unaligned_write4(reinterpret_cast<unsigned char*>(&data[o]), ptr);
-	}
-	delete [] pointers;
-	pointers = NULL;
-#elif defined SSTINDEX_BINARY_CHOP
-	if (last_index_key.size() == SSTINDEX_BINARY_CHOP_KEY_SIZE) {
-	    // Increment final byte(s) to give a key which is definitely
-	    // at or above any key which this could be truncated from.
-	    size_t i = last_index_key.size();
-	    unsigned char ch;
-	    do {
-		if (i == 0) {
-		    // We can't increment "\xff\xff\xff\xff" to give an upper
-		    // bound - just skip adding one in this case as the table
-		    // will handle it OK and there's not much to be gained by
-		    // adding one as few keys are larger.
-		    goto skip_adding_upper_bound;
-		}
-		--i;
-		ch = static_cast<unsigned char>(last_index_key[i]) + 1;
-		last_index_key[i] = ch;
-	    } while (ch == 0);
-	} else {
-	    // Pad with zeros, which gives an upper bound.
-	    last_index_key.resize(SSTINDEX_BINARY_CHOP_KEY_SIZE);
-	}
+    /// Table offset for each sampled key.
+    std::vector<off_t> pointers;
 
-	{
-	    data += last_index_key;
-	    size_t c = data.size();
-	    data.resize(c + 4);
-	    unaligned_write4(reinterpret_cast<unsigned char*>(&data[c]), root);
+    static std::uint64_t key_prefix(const char* p, size_t len) {
+	std::uint64_t result = 0;
+	for (size_t i = 0; i != 8; ++i) {
+	    result <<= 8;
+	    if (i < len) result |= static_cast<unsigned char>(p[i]);
 	}
+	return result;
+    }
 
-skip_adding_upper_bound:
-	// Fill in bytes 1 to 4 with the number of entries.
-	size_t n_index = (data.size() - 5) / SSTINDEX_BINARY_CHOP_ENTRY_SIZE;
-	data[1] = n_index >> 24;
-	data[2] = n_index >> 16;
-	data[3] = n_index >> 8;
-	data[4] = n_index;
-#elif defined SSTINDEX_SKIPLIST
-	// Already built in data.
-#else
-# error SSTINDEX type not specified
-#endif
+    /// Fill in the subtree at @a k with keys from @a rank onwards.
+    size_t build(size_t k, size_t rank);
 
-	store.write(data.data(), data.size());
-	// FIXME: parent stuff...
-	return root;
-    }
+  public:
+    /// Load the index at the current position of @a file.
+    explicit HoneySampledIndex(BufferedFile& file);
 
-    size_t size() const {
-	// FIXME: For SSTINDEX_ARRAY, data.size() only correct after calling
-	// write().
-	size_t s = data.size();
-	if (parent_index) s += parent_index->size();
-	return s;
-    }
+    /** Find the last sampled key <= @a key.
+     *
+     *  @param key		The key to look for.
+     *  @param[out] pos		The table offset for the sampled key.
+     *  @param[out] prev_key	The sampled key.
+     *
+     *  @return false if all the sampled keys are > @a key.
+     */
+    bool find(const std::string& key, off_t& pos, std::string& prev_key) const;
 };
 
 class HoneyCursor;
@@ -546,6 +581,25 @@ class HoneyTable {
     mutable std::string last_key;
     SSTIndex index;
     off_t root = -1;
+    /// The type of index (or EOF if there isn't one), set by load_index().
+    int index_type = EOF;
+    std::unique_ptr<HoneySampledIndex> sampled_index;
+
+    /** Offset from root of the Bloom filter over the keys.
+     *
+     *  Zero if there isn't one.  The filter is written after the index.
+     */
+    off_t filter = 0;
+
+    /// The Bloom filter (empty if there isn't one), set by load_index().
+    HoneyBloomFilter bloom;
+
+    /// Bits per key for the Bloom filter to write (0 for none).
+    unsigned bloom_bits_per_key = 0;
+
+    /// Hashes of the keys added, used to build the Bloom filter.
+    std::vector<std::uint64_t> bloom_hashes;
+
     honey_tablesize_t num_entries = 0;
     bool lazy;
 
@@ -564,6 +618,15 @@ class HoneyTable {
 
     void read_val(std::string& val, size_t val_size) const;
 
+    /** Load the index into memory if it's a type we do that for.
+     *
+     *  Also loads the Bloom filter if there is one.
+     */
+    void load_index();
+
+    /// Write the Bloom filter (if we're building one) after the index.
+    void write_filter();
+
   public:
     HoneyTable(const char*, const std::string& path_, bool read_only_,
 	       bool lazy_ = false)
@@ -595,6 +658,17 @@ class HoneyTable {
 
     bool is_writable() const { return !read_only; }
 
+    /** Read a read-only table via a memory mapping of its file.
+     *
+     *  Cursors created after this call read keys and tags from the mapping.
+     *  Does nothing if the table is writable or the file can't be mapped.
+     *
+     *  @param mmap_flags	Xapian::DB_MMAP plus any of the access pattern
+     *			hints Xapian::DB_MMAP_RANDOM and
+     *			Xapian::DB_MMAP_WILLNEED.
+     */
+    void use_mmap(int mmap_flags);
+
     int get_flags() const { return flags; }
 
     void create_and_open(int flags_, const Honey::RootInfo& root_info);
@@ -604,6 +678,8 @@ class HoneyTable {
 
     void close(bool permanent) {
 	bool fd_owned = !single_file();
+	// Make sure lookups reach the closed store and report it.
+	bloom = HoneyBloomFilter();
 	if (permanent)
 	    store.force_close(fd_owned);
 	else
@@ -612,6 +688,44 @@ class HoneyTable {
 
     const std::string& get_path() const { return path; }
 
+    /// Set the type of index to write (before any entries are added).
+    void set_index_type(Honey::sstindex_type type) { index.set_type(type); }
+
+    /** Write a Bloom filter over the keys (set before any entries are added).
+     *
+     *  @param bits_per_key	Bits to use for each key, or 0 for no filter.
+     */
+    void set_bloom_bits(unsigned bits_per_key) {
+	bloom_bits_per_key = bits_per_key;
+    }
+
+    /** Check if @a key might be in the table.
+     *
+     *  @return false if the table's Bloom filter shows @a key isn't present
+     *		(always true if there's no filter).
+     */
+    bool may_contain(const std::string& key) const {
+	return bloom.may_contain(key);
+    }
+
+    /** Use the index to find where to start scanning for @a key.
+     *
+     *  @param file		The file to read the index from.
+     *  @param key		The key to look for (which must not be empty).
+     *  @param[out] pos		The offset of the entry to start from.
+     *  @param[out] prev_key	The key to treat as the previous key when
+     *				reading the entry at @a pos.
+     *
+     *  @return false if the index shows @a key isn't in the table.
+     */
+    bool search_index(BufferedFile& file, const std::string& key,
+		      off_t& pos, std::string& prev_key) const;
+
+    /// Does the index only help find the first key with a given first byte?
+    bool index_by_first_byte() const {
+	return index_type == Honey::SSTINDEX_ARRAY;
+    }
+
     void add(const std::string& key,
 	     const char* val,
 	     size_t val_size,
@@ -625,6 +739,7 @@ class HoneyTable {
 
     void flush_db() {
 	root = index.write(store);
+	write_filter();
 	store.flush();
     }
 
@@ -684,6 +799,11 @@ class HoneyTable {
     off_t get_root() const { return root; }
 
     off_t get_offset() const { return offset; }
+
+    /// Return the codec used to compress tags (always zlib for honey).
+    compression_codec get_compression_codec() const {
+	return COMPRESSION_ZLIB;
+    }
 };
 
 #endif // XAPIAN_INCLUDED_HONEY_TABLE_H
@@ -36,12 +36,25 @@ HoneyValueList::update_reader()
     Xapian::docid last_did = docid_from_key(slot, cursor->current_key);
     if (!last_did) return false;
 
-    cursor->read_tag();
-    const string& tag = cursor->current_tag;
-    reader.assign(tag.data(), tag.size(), last_did);
+    size_t len;
+    const char* tag = cursor->read_tag_view(len);
+    reader.assign(tag, len, last_did);
     return true;
 }
 
+void
+HoneyValueList::find_chunk_in_range(const string& lo, const string* hi)
+{
+    while (!cursor->after_end() && update_reader()) {
+	if (reader.may_contain(lo, hi)) return;
+	cursor->next();
+    }
+
+    // We've reached the end.
+    delete cursor;
+    cursor = NULL;
+}
+
 HoneyValueList::~HoneyValueList()
 {
     delete cursor;
@@ -74,7 +87,7 @@ HoneyValueList::at_end() const
 }
 
 void
-HoneyValueList::next()
+HoneyValueList::move_next()
 {
     if (!cursor) {
 	cursor = db->get_postlist_cursor();
@@ -98,7 +111,7 @@ HoneyValueList::next()
 }
 
 void
-HoneyValueList::skip_to(Xapian::docid did)
+HoneyValueList::move_to(Xapian::docid did)
 {
     if (!cursor) {
 	cursor = db->get_postlist_cursor();
@@ -133,6 +146,95 @@ HoneyValueList::skip_to(Xapian::docid did)
     cursor = NULL;
 }
 
+void
+HoneyValueList::move_next_in_range(const string& lo, const string* hi)
+{
+    if (!cursor) {
+	cursor = db->get_postlist_cursor();
+	if (!cursor) return;
+	cursor->find_entry_ge(make_valuechunk_key(slot, 1));
+    } else if (!reader.at_end()) {
+	// We only check the bounds when we move to a new chunk.
+	reader.next();
+	if (!reader.at_end()) return;
+	cursor->next();
+    }
+
+    find_chunk_in_range(lo, hi);
+}
+
+void
+HoneyValueList::move_to_in_range(Xapian::docid did,
+				 const string& lo, const string* hi)
+{
+    if (!cursor) {
+	cursor = db->get_postlist_cursor();
+	if (!cursor) return;
+    } else if (!reader.at_end()) {
+	reader.skip_to(did);
+	if (!reader.at_end()) return;
+    }
+
+    cursor->find_entry_ge(make_valuechunk_key(slot, did));
+    if (!cursor->after_end() && update_reader()) {
+	if (reader.may_contain(lo, hi)) {
+	    reader.skip_to(did);
+	    // The chunk's last docid is >= did, so skip_to() shouldn't reach
+	    // the end.
+	    Assert(!reader.at_end());
+	    return;
+	}
+	cursor->next();
+	find_chunk_in_range(lo, hi);
+	return;
+    }
+
+    // We've reached the end.
+    delete cursor;
+    cursor = NULL;
+}
+
+bool
+HoneyValueList::on_deleted() const
+{
+    const HoneyDeletions& deletions = db->get_deletions();
+    return rare(!deletions.empty()) && cursor &&
+	   deletions.contains(reader.get_docid());
+}
+
+void
+HoneyValueList::next()
+{
+    do {
+	move_next();
+    } while (on_deleted());
+}
+
+void
+HoneyValueList::skip_to(Xapian::docid did)
+{
+    move_to(did);
+    while (on_deleted())
+	move_next();
+}
+
+void
+HoneyValueList::next_in_range(const string& lo, const string* hi)
+{
+    do {
+	move_next_in_range(lo, hi);
+    } while (on_deleted());
+}
+
+void
+HoneyValueList::skip_to_in_range(Xapian::docid did,
+				 const string& lo, const string* hi)
+{
+    move_to_in_range(did, lo, hi);
+    while (on_deleted())
+	move_next_in_range(lo, hi);
+}
+
 string
 HoneyValueList::get_description() const
 {
@@ -46,6 +46,28 @@ class HoneyValueList : public Xapian::ValueIterator::Internal {
     /// Update @a reader to use the chunk currently pointed to by @a cursor.
     bool update_reader();
 
+    /** Move to the first chunk which might contain a value in a range.
+     *
+     *  Starts from the chunk currently pointed to by @a cursor.
+     *
+     *  @param lo	The lower end of the range.
+     *  @param hi	The upper end of the range, or NULL for no upper end.
+     */
+    void find_chunk_in_range(const std::string& lo, const std::string* hi);
+
+    /// Are we on a document which has been deleted?
+    bool on_deleted() const;
+
+    void move_next();
+
+    void move_to(Xapian::docid did);
+
+    void move_next_in_range(const std::string& lo, const std::string* hi);
+
+    void move_to_in_range(Xapian::docid did,
+			  const std::string& lo,
+			  const std::string* hi);
+
   public:
     HoneyValueList(Xapian::valueno slot_, const HoneyDatabase* db_)
 	: cursor(NULL), slot(slot_), db(db_) { }
@@ -64,6 +86,12 @@ class HoneyValueList : public Xapian::ValueIterator::Internal {
 
     void skip_to(Xapian::docid);
 
+    void next_in_range(const std::string& lo, const std::string* hi);
+
+    void skip_to_in_range(Xapian::docid did,
+			  const std::string& lo,
+			  const std::string* hi);
+
     std::string get_description() const;
 };
 
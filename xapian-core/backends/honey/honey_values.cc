@@ -55,6 +55,10 @@ ValueChunkReader::assign(const char* p_, size_t len, Xapian::docid last_did)
     if (!unpack_uint(&p, end, &did))
 	throw Xapian::DatabaseCorruptError("Failed to unpack docid delta");
     did = last_did - did;
+    if (!unpack_string(&p, end, lower_bound) ||
+	!unpack_string(&p, end, upper_bound))
+	throw Xapian::DatabaseCorruptError("Failed to unpack chunk bounds");
+    if (upper_bound.empty()) upper_bound = lower_bound;
     if (!unpack_string(&p, end, value))
 	throw Xapian::DatabaseCorruptError("Failed to unpack first value");
 }
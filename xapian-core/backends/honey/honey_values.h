@@ -224,6 +224,19 @@ class HoneyValueManager {
 
 namespace Honey {
 
+/** Reads a value chunk.
+ *
+ *  The key of a value chunk holds the last docid in the chunk.  The tag
+ *  holds the docid delta across the chunk, the smallest and largest values
+ *  in the chunk (so a chunk which can't contain a value in a range can be
+ *  skipped without decoding its entries), and then the entries:
+ *
+ *	I<last docid - first docid> S<lower bound> S<upper bound>
+ *	S<first value> { I<docid delta - 1> S<value> }*
+ *
+ *  The upper bound is stored as an empty string if it's the same as the
+ *  lower bound (which is safe as empty values aren't stored).
+ */
 class ValueChunkReader {
     const char* p;
     const char* end;
@@ -232,6 +245,12 @@ class ValueChunkReader {
 
     std::string value;
 
+    /// Smallest value in the chunk.
+    std::string lower_bound;
+
+    /// Largest value in the chunk.
+    std::string upper_bound;
+
   public:
     /// Create a ValueChunkReader which is already at_end().
     ValueChunkReader() : p(NULL) { }
@@ -248,6 +267,21 @@ class ValueChunkReader {
 
     const std::string& get_value() const { return value; }
 
+    /// Smallest value in the chunk.
+    const std::string& get_lower_bound() const { return lower_bound; }
+
+    /// Largest value in the chunk.
+    const std::string& get_upper_bound() const { return upper_bound; }
+
+    /** Might the chunk contain a value in the range [@a lo, @a hi]?
+     *
+     *  @param lo	The lower end of the range.
+     *  @param hi	The upper end of the range, or NULL for no upper end.
+     */
+    bool may_contain(const std::string& lo, const std::string* hi) const {
+	return upper_bound >= lo && (!hi || lower_bound <= *hi);
+    }
+
     void next();
 
     void skip_to(Xapian::docid target);
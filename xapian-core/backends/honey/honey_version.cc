@@ -51,8 +51,13 @@
 using namespace std;
 
 /// Honey format version (date of change):
-#define HONEY_FORMAT_VERSION DATE_TO_VERSION(2018,4,3)
-// 2018,4,3   1.5.0 outlaw mixed-wdf terms
+#define HONEY_FORMAT_VERSION DATE_TO_VERSION(2026,10,20)
+// 2026,10,20 1.5.0 bitmap posting blocks
+// 2026,10,19 1.5.0 store per chunk value bounds
+// 2026,10,18 1.5.0 selectable table index types
+// 2026,10,17 1.5.0 block-packed postlist data
+// 2026,10,16 1.5.0 store per chunk wdf_max
+// 2018,4,3         outlaw mixed-wdf terms
 // 2018,3,28        don't special case first entry in SSTable
 // 2018,3,27        new key format for value stats, value chunks, doclen chunks
 // 2018,3,26        use known suffix from spelling B and T keys
@@ -492,6 +497,7 @@ RootInfo::init(uint4 compress_min_)
 {
     offset = 0;
     root = 0;
+    filter = 0;
     num_entries = 0;
     compress_min = compress_min_;
     fl_serialised.resize(0);
@@ -505,7 +511,8 @@ RootInfo::serialise(string& s) const
     AssertRel(root, >=, offset);
     pack_uint(s, uoffset);
     pack_uint(s, root - uoffset);
-    pack_uint(s, 0u);
+    AssertRel(filter, >=, 0);
+    pack_uint(s, std::make_unsigned<off_t>::type(filter));
     pack_uint(s, num_entries);
     pack_uint(s, 2048u >> 11);
     pack_uint(s, compress_min);
@@ -515,21 +522,22 @@ RootInfo::serialise(string& s) const
 bool
 RootInfo::unserialise(const char** p, const char* end)
 {
-    std::make_unsigned<off_t>::type uoffset, uroot;
-    unsigned dummy_val;
+    std::make_unsigned<off_t>::type uoffset, uroot, ufilter;
     unsigned dummy_blocksize;
     if (!unpack_uint(p, end, &uoffset) ||
 	!unpack_uint(p, end, &uroot) ||
-	!unpack_uint(p, end, &dummy_val) ||
+	!unpack_uint(p, end, &ufilter) ||
 	!unpack_uint(p, end, &num_entries) ||
 	!unpack_uint(p, end, &dummy_blocksize) ||
 	!unpack_uint(p, end, &compress_min) ||
 	!unpack_string(p, end, fl_serialised)) return false;
     offset = uoffset;
     root = uoffset + uroot;
+    // This field used to always be zero, so databases without Bloom filters
+    // don't need a new format version.
+    filter = ufilter;
     // Not meaningful, but still there so that existing honey databases
     // continue to work.
-    (void)dummy_val;
     (void)dummy_blocksize;
     // Map old default to new default.
     if (compress_min == 4) {
@@ -40,6 +40,8 @@ namespace Honey {
 class RootInfo {
     off_t offset;
     off_t root;
+    /// Offset from root of the table's Bloom filter (0 if there isn't one).
+    off_t filter;
     honey_tablesize_t num_entries;
     /// Should be >= 4 or 0 for no compression.
     uint4 compress_min;
@@ -54,6 +56,7 @@ class RootInfo {
 
     off_t get_offset() const { return offset; }
     off_t get_root() const { return root; }
+    off_t get_filter() const { return filter; }
     honey_tablesize_t get_num_entries() const { return num_entries; }
     uint4 get_compress_min() const { return compress_min; }
     const std::string& get_free_list() const { return fl_serialised; }
@@ -61,6 +64,7 @@ class RootInfo {
     void set_num_entries(honey_tablesize_t n) { num_entries = n; }
     void set_offset(off_t offset_) { offset = offset_; }
     void set_root(off_t root_) { root = root_; }
+    void set_filter(off_t filter_) { filter = filter_; }
     void set_free_list(const std::string& s) { fl_serialised = s; }
 };
 
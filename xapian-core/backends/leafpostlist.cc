@@ -53,6 +53,23 @@ LeafPostList::recalc_maxweight()
     return weight ? weight->get_maxpart() : 0;
 }
 
+double
+LeafPostList::get_block_maxweight(Xapian::docid& block_last)
+{
+    if (!weight) {
+	block_last = Xapian::docid(-1);
+	return 0;
+    }
+    return weight->get_block_maxpart(get_block_wdf_upper_bound(block_last));
+}
+
+Xapian::termcount
+LeafPostList::get_block_wdf_upper_bound(Xapian::docid& block_last) const
+{
+    block_last = Xapian::docid(-1);
+    return get_wdf_upper_bound();
+}
+
 TermFreqs
 LeafPostList::get_termfreq_est_using_stats(
 	const Xapian::Weight::Internal & stats) const
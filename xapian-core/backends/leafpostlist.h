@@ -98,6 +98,8 @@ class LeafPostList : public PostList {
 
     double recalc_maxweight();
 
+    double get_block_maxweight(Xapian::docid& block_last);
+
     TermFreqs get_termfreq_est_using_stats(
 	const Xapian::Weight::Internal & stats) const;
 
@@ -128,6 +130,17 @@ class LeafPostList : public PostList {
 
     virtual Xapian::termcount get_wdf_upper_bound() const = 0;
 
+    /** Return an upper bound on the wdf in the current block of postings.
+     *
+     *  @param[out] block_last	Set to the last docid in the current block.
+     *
+     *  The default implementation treats the whole list as a single block,
+     *  setting @a block_last to the highest possible docid and returning
+     *  get_wdf_upper_bound().
+     */
+    virtual Xapian::termcount
+    get_block_wdf_upper_bound(Xapian::docid& block_last) const;
+
     /** Set the term name.
      *
      *  This is useful when we optimise a term matching all documents to an
@@ -38,6 +38,32 @@ struct CompareTermListsByTerm {
     }
 };
 
+/** Advance sub-termlist @a tl.
+ *
+ *  A sub-termlist may itself be a MultiAllTermsList (e.g. for a segmented
+ *  shard), which can prune itself.
+ */
+static inline void
+next_sub(TermList*& tl)
+{
+    TermList* ret = tl->next();
+    if (ret) {
+	delete tl;
+	tl = ret;
+    }
+}
+
+/// Skip sub-termlist @a tl to @a term.
+static inline void
+skip_to_sub(TermList*& tl, const string& term)
+{
+    TermList* ret = tl->skip_to(term);
+    if (ret) {
+	delete tl;
+	tl = ret;
+    }
+}
+
 MultiAllTermsList::MultiAllTermsList(size_t count_, TermList** termlists_)
     : count(count_), termlists(termlists_)
 {
@@ -73,7 +99,8 @@ MultiAllTermsList::get_termfreq() const
 	    if (tl->get_termname() != current_term)
 		break;
 	    current_termfreq += tl->get_termfreq();
-	    tl->next();
+	    next_sub(termlists[0]);
+	    tl = termlists[0];
 	    if (tl->at_end()) {
 		Heap::pop(termlists, termlists + count,
 			  CompareTermListsByTerm());
@@ -97,8 +124,8 @@ MultiAllTermsList::next()
 	// earliest sorting term is at the top of the heap.
 	size_t j = 0;
 	for (size_t i = 0; i != count; ++i) {
+	    next_sub(termlists[i]);
 	    TermList* tl = termlists[i];
-	    tl->next();
 	    if (!tl->at_end()) {
 		if (i != j)
 		    swap(termlists[i], termlists[j]);
@@ -115,7 +142,8 @@ MultiAllTermsList::next()
 	    TermList* tl = termlists[0];
 	    if (tl->get_termname() != current_term)
 		break;
-	    tl->next();
+	    next_sub(termlists[0]);
+	    tl = termlists[0];
 	    if (tl->at_end()) {
 		Heap::pop(termlists, termlists + count,
 			  CompareTermListsByTerm());
@@ -152,8 +180,8 @@ MultiAllTermsList::skip_to(const std::string &term)
     // approach more like that next() uses if this ever gets heavy use.
     size_t j = 0;
     for (size_t i = 0; i != count; ++i) {
+	skip_to_sub(termlists[i], term);
 	TermList* tl = termlists[i];
-	tl->skip_to(term);
 	if (!tl->at_end()) {
 	    if (i != j)
 		swap(termlists[i], termlists[j]);
@@ -28,6 +28,7 @@
 #include "multi_postlist.h"
 #include "multi_termlist.h"
 #include "multi_valuelist.h"
+#include "pack.h"
 
 #include <memory>
 
@@ -516,6 +517,20 @@ MultiDatabase::get_uuid() const
     return uuid;
 }
 
+string
+MultiDatabase::get_cache_key() const
+{
+    string key;
+    for (auto&& shard : shards) {
+	const string& sub_key = shard->get_cache_key();
+	// If any shard can't be identified then neither can the combination.
+	if (sub_key.empty())
+	    return sub_key;
+	pack_string(key, sub_key);
+    }
+    return key;
+}
+
 bool
 MultiDatabase::locked() const
 {
@@ -537,6 +552,14 @@ MultiDatabase::write_changesets_to_fd(int,
 					"more than one subdatabase");
 }
 
+void
+MultiDatabase::get_readahead_stats(size_t& issued, size_t& used) const
+{
+    for (auto&& shard : shards) {
+	shard->get_readahead_stats(issued, used);
+    }
+}
+
 Xapian::rev
 MultiDatabase::get_revision() const
 {
@@ -567,6 +590,22 @@ MultiDatabase::commit()
     }
 }
 
+void
+MultiDatabase::commit_async()
+{
+    for (auto&& shard : shards) {
+	shard->commit_async();
+    }
+}
+
+void
+MultiDatabase::wait_for_commit()
+{
+    for (auto&& shard : shards) {
+	shard->wait_for_commit();
+    }
+}
+
 void
 MultiDatabase::cancel()
 {
@@ -575,6 +614,24 @@ MultiDatabase::cancel()
     }
 }
 
+void
+MultiDatabase::set_flush_memory_limit(size_t limit)
+{
+    for (auto&& shard : shards) {
+	shard->set_flush_memory_limit(limit);
+    }
+}
+
+size_t
+MultiDatabase::get_buffered_memory() const
+{
+    size_t result = 0;
+    for (auto&& shard : shards) {
+	result += shard->get_buffered_memory();
+    }
+    return result;
+}
+
 void
 MultiDatabase::begin_transaction(bool flushed)
 {
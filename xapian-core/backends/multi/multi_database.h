@@ -134,6 +134,8 @@ class MultiDatabase : public Xapian::Database::Internal {
 
     std::string get_uuid() const;
 
+    std::string get_cache_key() const;
+
     bool locked() const;
 
     void write_changesets_to_fd(int fd,
@@ -143,14 +145,24 @@ class MultiDatabase : public Xapian::Database::Internal {
 
     void invalidate_doc_object(Xapian::Document::Internal* obj) const;
 
+    void get_readahead_stats(std::size_t& issued, std::size_t& used) const;
+
     Xapian::rev get_revision() const;
 
     int get_backend_info(std::string* path) const;
 
     void commit();
 
+    void commit_async();
+
+    void wait_for_commit();
+
     void cancel();
 
+    void set_flush_memory_limit(std::size_t limit);
+
+    std::size_t get_buffered_memory() const;
+
     void begin_transaction(bool flushed);
 
     void end_transaction_(bool do_commit);
@@ -0,0 +1,108 @@
+/** @file
+ * @brief Helpers for postings stored as a bitmap
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_POSTINGBITMAP_H
+#define XAPIAN_INCLUDED_POSTINGBITMAP_H
+
+#include "pack.h"
+#include "wordaccess.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/* A posting bitmap stores a set of docids in a range using one bit for each
+ * docid in the range, with bit i set if the i-th docid in the range is
+ * present.  Bits are stored most significant bit first in each byte, and any
+ * bits in the last byte after the end of the range must be zero.
+ *
+ * For a dense posting list this is smaller than storing docid deltas, and
+ * finding the next entry at or after a docid only needs to test bits, which
+ * we can do a 64-bit word at a time.
+ */
+
+/// Return the number of bytes needed for a bitmap of @a nbits bits.
+inline size_t
+posting_bitmap_size(size_t nbits)
+{
+    return (nbits + 7) / 8;
+}
+
+/// Set bit @a i of @a bitmap.
+inline void
+posting_bitmap_set(unsigned char* bitmap, size_t i)
+{
+    bitmap[i >> 3] |= static_cast<unsigned char>(0x80 >> (i & 7));
+}
+
+/// Test bit @a i of @a bitmap.
+inline bool
+posting_bitmap_test(const unsigned char* bitmap, size_t i)
+{
+    return (bitmap[i >> 3] << (i & 7)) & 0x80;
+}
+
+/// Return the number of leading zero bits in non-zero @a w.
+inline unsigned
+posting_bitmap_clz(std::uint64_t w)
+{
+#ifdef HAVE_DO_CLZ
+    return unsigned(do_clz(w));
+#else
+    unsigned n = 0;
+    while (!(w & (std::uint64_t(1) << 63))) {
+	w <<= 1;
+	++n;
+    }
+    return n;
+#endif
+}
+
+/** Find the first set bit in a bitmap at or after bit @a i.
+ *
+ *  @param bitmap	The bitmap.
+ *  @param nbits	The number of bits in the bitmap.
+ *  @param i		The bit to start from.
+ *
+ *  @return The index of the set bit found, or @a nbits if there isn't one.
+ */
+inline size_t
+posting_bitmap_find(const unsigned char* bitmap, size_t nbits, size_t i)
+{
+    size_t nbytes = posting_bitmap_size(nbits);
+    size_t byte = i >> 3;
+    if (byte >= nbytes) return nbits;
+    std::uint64_t w = static_cast<unsigned char>(bitmap[byte] << (i & 7)) >>
+		      (i & 7);
+    if (w) return byte * 8 + posting_bitmap_clz(w) - 56;
+    ++byte;
+    // Test a whole word at a time while there's one left.
+    while (nbytes - byte >= 8) {
+	w = do_unaligned_read<std::uint64_t>(bitmap + byte);
+	if (w) return byte * 8 + posting_bitmap_clz(w);
+	byte += 8;
+    }
+    while (byte != nbytes) {
+	w = bitmap[byte];
+	if (w) return byte * 8 + posting_bitmap_clz(w) - 56;
+	++byte;
+    }
+    return nbits;
+}
+
+#endif // XAPIAN_INCLUDED_POSTINGBITMAP_H
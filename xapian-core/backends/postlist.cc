@@ -55,6 +55,13 @@ PostList::open_position_list() const
     throw Xapian::InvalidOperationError("open_position_list() not meaningful for this PostingIterator");
 }
 
+double
+PostList::get_block_maxweight(Xapian::docid& block_last)
+{
+    block_last = Xapian::docid(-1);
+    return recalc_maxweight();
+}
+
 PostList *
 PostList::check(Xapian::docid did, double w_min, bool &valid)
 {
@@ -62,6 +69,12 @@ PostList::check(Xapian::docid did, double w_min, bool &valid)
     return skip_to(did, w_min);
 }
 
+const Xapian::docid*
+PostList::get_docid_block(const Xapian::docid*&) const
+{
+    return NULL;
+}
+
 Xapian::termcount
 PostList::count_matching_subqs() const
 {
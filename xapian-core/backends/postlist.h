@@ -97,6 +97,22 @@ class PostList {
      */
     virtual double recalc_maxweight() = 0;
 
+    /** Return an upper bound on get_weight() for the current block.
+     *
+     *  Some backends store metadata for each chunk of a posting list which
+     *  allows a tighter bound to be calculated for a range of documents
+     *  than recalc_maxweight() gives for the whole list.  Like
+     *  recalc_maxweight(), this method may be called after the postlist has
+     *  reached the end, in which case it should return 0.
+     *
+     *  @param[out] block_last	Set to the last docid which the returned
+     *				bound covers.
+     *
+     *  The default implementation sets @a block_last to the highest possible
+     *  docid and returns recalc_maxweight().
+     */
+    virtual double get_block_maxweight(Xapian::docid& block_last);
+
     /** Read the position list for the term in the current document and
      *  return a pointer to it (owned by the PostList).
      *
@@ -164,6 +180,25 @@ class PostList {
      */
     virtual PostList* check(Xapian::docid did, double w_min, bool &valid);
 
+    /** Return the docids from the current one which are already decoded.
+     *
+     *  This allows a caller to find where skip_to() would move to without
+     *  calling it, as long as the target is within the returned block.
+     *
+     *  Must only be called when positioned on a document (i.e. after next(),
+     *  skip_to() or a check() which set @a valid to true, and not at_end()).
+     *
+     *  @param[out] block_end	Set to the end of the block.
+     *
+     *  @return	Pointer to an ascending array of docids whose first entry is
+     *		the current docid and which ends at @a block_end, valid until
+     *		this PostList is next moved.  NULL if no block is available.
+     *
+     *  The default implementation returns NULL.
+     */
+    virtual const Xapian::docid*
+    get_docid_block(const Xapian::docid*& block_end) const;
+
     /** Advance the current position to the next document in the postlist.
      *
      *  Any weight contribution is acceptable.
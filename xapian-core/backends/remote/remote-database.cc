@@ -375,7 +375,8 @@ RemoteDatabase::update_stats(message_type msg_code, const string & body) const
 	!unpack_uint(&p, p_end, &doclen_lbound) ||
 	!unpack_uint(&p, p_end, &doclen_ubound) ||
 	!unpack_bool(&p, p_end, &has_positional_info) ||
-	!unpack_uint(&p, p_end, &total_length)) {
+	!unpack_uint(&p, p_end, &total_length) ||
+	!unpack_string(&p, p_end, cache_key)) {
 	throw Xapian::NetworkError("Bad stats update message received", context);
     }
     lastdocid += doccount;
@@ -746,6 +747,17 @@ RemoteDatabase::send_global_stats(Xapian::doccount first,
     send_message(MSG_GETMSET, message);
 }
 
+void
+RemoteDatabase::send_min_weight(double min_weight) const
+{
+    // We're still waiting for REPLY_RESULTS and there's no reply to this
+    // message, so send it directly rather than via send_message().
+    Assert(pending_reply);
+    double end_time = RealTime::end_time(timeout);
+    link.send_message(static_cast<unsigned char>(MSG_SETMINWEIGHT),
+		      serialise_double(min_weight), end_time);
+}
+
 Xapian::MSet
 RemoteDatabase::get_mset(const vector<opt_ptr_spy>& matchspies) const
 {
@@ -890,6 +902,15 @@ RemoteDatabase::get_uuid() const
     return uuid;
 }
 
+string
+RemoteDatabase::get_cache_key() const
+{
+    if (!is_read_only())
+	return string();
+    if (!cached_stats_valid) update_stats();
+    return cache_key;
+}
+
 string
 RemoteDatabase::get_metadata(const string & key) const
 {
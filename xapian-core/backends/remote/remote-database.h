@@ -83,6 +83,10 @@ class RemoteDatabase : public Xapian::Database::Internal {
     /// The UUID of the remote database.
     mutable std::string uuid;
 
+    /// Key identifying the revision of the remote database (see
+    /// Database::Internal::get_cache_key()).
+    mutable std::string cache_key;
+
     /// The context to return with any error messages
     std::string context;
 
@@ -218,6 +222,14 @@ class RemoteDatabase : public Xapian::Database::Internal {
 			   const Xapian::KeyMaker* sorter,
 			   const Xapian::Weight::Internal &stats) const;
 
+    /** Send the server a minimum weight for the match it's running.
+     *
+     *  This can be sent between send_global_stats() and get_mset(), and
+     *  allows the server to skip documents which can't make the merged MSet.
+     *  There's no reply.
+     */
+    void send_min_weight(double min_weight) const;
+
     /// Get the MSet from the remote server.
     Xapian::MSet get_mset(const std::vector<opt_ptr_spy>& matchspies) const;
 
@@ -294,6 +306,8 @@ class RemoteDatabase : public Xapian::Database::Internal {
 
     std::string get_uuid() const;
 
+    std::string get_cache_key() const;
+
     std::string get_metadata(const std::string& key) const;
 
     void set_metadata(const std::string& key, const std::string& value);
@@ -92,6 +92,32 @@ class Xapian::ValueIterator::Internal : public Xapian::Internal::intrusive_base
      */
     virtual bool check(Xapian::docid did);
 
+    /** Advance to the next entry which might have a value in a range.
+     *
+     *  This acts like next(), except that a backend which stores bounds on
+     *  the values in each chunk of the stream may skip over any chunks which
+     *  can't contain a value in the range [@a lo, @a hi].  The value at the
+     *  new position isn't necessarily in the range, so the caller still
+     *  needs to check it.
+     *
+     *  @param lo	The lower end of the range.
+     *  @param hi	The upper end of the range, or NULL for no upper end.
+     *
+     *  The default implementation calls next().
+     */
+    virtual void next_in_range(const std::string& lo, const std::string* hi);
+
+    /** Skip forward to a docid, skipping chunks with no values in a range.
+     *
+     *  This acts like skip_to(), but may skip over chunks in the same way
+     *  as next_in_range().
+     *
+     *  The default implementation calls skip_to().
+     */
+    virtual void skip_to_in_range(Xapian::docid did,
+				  const std::string& lo,
+				  const std::string* hi);
+
     /// Return a string description of this object.
     virtual std::string get_description() const = 0;
 };
@@ -64,6 +64,7 @@ bin_xapian_inspect_CPPFLAGS =\
 bin_xapian_inspect_SOURCES = bin/xapian-inspect.cc\
 	api/constinfo.cc\
 	api/error.cc\
+	backends/glass/glass_blockcache.cc\
 	backends/glass/glass_changes.cc\
 	backends/glass/glass_cursor.cc\
 	backends/glass/glass_freelist.cc\
@@ -86,6 +87,7 @@ bin_xapian_inspect_honey_CPPFLAGS =\
 bin_xapian_inspect_honey_SOURCES = bin/xapian-inspect-honey.cc\
 	api/constinfo.cc\
 	api/error.cc\
+	backends/honey/honey_bloom.cc\
 	backends/honey/honey_cursor.cc\
 	backends/honey/honey_freelist.cc\
 	backends/honey/honey_table.cc\
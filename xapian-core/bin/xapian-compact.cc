@@ -62,6 +62,10 @@ static void show_usage() {
 "                     option is only supported when merging databases if they\n"
 "                     have disjoint ranges of used document ids\n"
 "  -s, --single-file  Produce a single file database\n"
+"  -z, --compression=C\n"
+"                     Set the codec used to compress tags in a glass output\n"
+"                     database.  Supported values are 'zlib' (the default),\n"
+"                     'lz4' and 'zstd' (if this build of Xapian supports them)\n"
 "  --help             display this help and exit\n"
 "  --version          output version information and exit" << endl;
 }
@@ -111,7 +115,7 @@ MyCompactor::resolve_duplicate_metadata(const string & key,
 int
 main(int argc, char **argv)
 {
-    const char * opts = "b:B:nFmqs";
+    const char * opts = "b:B:nFmqsz:";
     static const struct option long_opts[] = {
 	{"fuller",	no_argument, 0, 'F'},
 	{"no-full",	no_argument, 0, 'n'},
@@ -120,6 +124,7 @@ main(int argc, char **argv)
 	{"backend",	required_argument, 0, 'B'},
 	{"no-renumber", no_argument, 0, OPT_NO_RENUMBER},
 	{"single-file", no_argument, 0, 's'},
+	{"compression",	required_argument, 0, 'z'},
 	{"quiet",	no_argument, 0, 'q'},
 	{"help",	no_argument, 0, OPT_HELP},
 	{"version",	no_argument, 0, OPT_VERSION},
@@ -183,6 +188,20 @@ main(int argc, char **argv)
 	    case 's':
 		flags |= Xapian::DBCOMPACT_SINGLE_FILE;
 		break;
+	    case 'z':
+		flags &= ~unsigned(Xapian::DB_COMPRESS_LZ4 |
+				   Xapian::DB_COMPRESS_ZSTD);
+		if (strcmp(optarg, "lz4") == 0) {
+		    flags |= Xapian::DB_COMPRESS_LZ4;
+		} else if (strcmp(optarg, "zstd") == 0) {
+		    flags |= Xapian::DB_COMPRESS_ZSTD;
+		} else if (strcmp(optarg, "zlib") != 0) {
+		    cerr << PROG_NAME": Bad value '" << optarg
+			 << "' passed for compression - must be 'zlib', "
+			    "'lz4' or 'zstd'" << endl;
+		    exit(1);
+		}
+		break;
 	    case 'q':
 		compactor.set_quiet(true);
 		break;
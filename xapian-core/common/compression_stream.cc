@@ -1,5 +1,5 @@
 /** @file
- * @brief class wrapper around zlib
+ * @brief class wrapper around zlib, and optionally lz4 and zstd
  */
 /* Copyright (C) 2007,2009,2012,2013,2014,2016,2019 Olly Betts
  * Copyright (C) 2009 Richard Boulton
@@ -24,13 +24,56 @@
 #include "compression_stream.h"
 
 #include "omassert.h"
+#include "pack.h"
 #include "str.h"
 #include "stringutils.h"
 
+#include "xapian/constants.h"
 #include "xapian/error.h"
 
+#ifdef HAVE_LZ4
+# include <lz4.h>
+#endif
+
 using namespace std;
 
+compression_codec
+compression_codec_from_flags(int flags)
+{
+    switch (flags & Xapian::DB_COMPRESS_MASK_) {
+	case Xapian::DB_COMPRESS_LZ4:
+	    return COMPRESSION_LZ4;
+	case Xapian::DB_COMPRESS_ZSTD:
+	    return COMPRESSION_ZSTD;
+	case 0:
+	    return COMPRESSION_ZLIB;
+    }
+    throw Xapian::InvalidArgumentError("Only one of DB_COMPRESS_LZ4 and "
+				       "DB_COMPRESS_ZSTD can be specified");
+}
+
+bool
+compression_codec_supported(compression_codec codec)
+{
+    switch (codec) {
+	case COMPRESSION_ZLIB:
+	    return true;
+	case COMPRESSION_LZ4:
+#ifdef HAVE_LZ4
+	    return true;
+#else
+	    return false;
+#endif
+	case COMPRESSION_ZSTD:
+#ifdef HAVE_ZSTD
+	    return true;
+#else
+	    return false;
+#endif
+    }
+    return false;
+}
+
 CompressionStream::~CompressionStream() {
     if (deflate_zstream) {
 	// Errors which we care about have already been handled, so just ignore
@@ -46,19 +89,53 @@ CompressionStream::~CompressionStream() {
 	delete inflate_zstream;
     }
 
+#ifdef HAVE_ZSTD
+    ZSTD_freeCCtx(zstd_cctx);
+    ZSTD_freeDStream(zstd_dstream);
+#endif
+
     delete [] out;
 }
 
-const char*
-CompressionStream::compress(const char* buf, size_t* p_size) {
-    lazy_alloc_deflate_zstream();
-    size_t size = *p_size;
+void
+CompressionStream::check_codec_supported() const
+{
+    if (rare(!compression_codec_supported(codec))) {
+	string msg = "Compression codec ";
+	msg += str(int(codec));
+	msg += " isn't supported by this build of Xapian";
+	throw Xapian::FeatureUnavailableError(msg);
+    }
+}
+
+void
+CompressionStream::reserve_out(size_t size)
+{
     if (!out || out_len < size) {
 	out_len = size;
 	delete [] out;
 	out = NULL;
 	out = new char[size];
     }
+}
+
+const char*
+CompressionStream::compress(const char* buf, size_t* p_size) {
+    switch (codec) {
+	case COMPRESSION_LZ4:
+	    return compress_lz4(buf, p_size);
+	case COMPRESSION_ZSTD:
+	    return compress_zstd(buf, p_size);
+	default:
+	    return compress_zlib(buf, p_size);
+    }
+}
+
+const char*
+CompressionStream::compress_zlib(const char* buf, size_t* p_size) {
+    lazy_alloc_deflate_zstream();
+    size_t size = *p_size;
+    reserve_out(size);
     deflate_zstream->avail_in = static_cast<uInt>(size);
     deflate_zstream->next_in = reinterpret_cast<const Bytef*>(buf);
     deflate_zstream->next_out = reinterpret_cast<Bytef*>(out);
@@ -82,8 +159,173 @@ CompressionStream::compress(const char* buf, size_t* p_size) {
     return out;
 }
 
+const char*
+CompressionStream::compress_lz4(const char* buf, size_t* p_size) {
+    check_codec_supported();
+#ifdef HAVE_LZ4
+    size_t size = *p_size;
+    if (size > size_t(LZ4_MAX_INPUT_SIZE)) return NULL;
+    // LZ4's block format doesn't record the sizes, so we store the
+    // uncompressed and compressed sizes before the compressed data.  The
+    // compressed size is smaller than the uncompressed size so can't take
+    // more bytes to encode, so we compress leaving room for two copies of
+    // the encoded uncompressed size, and then move the compressed data down
+    // if necessary.
+    string header;
+    pack_uint(header, size);
+    size_t max_header = header.size() * 2;
+    if (max_header >= size) return NULL;
+    reserve_out(size);
+    int block_len = LZ4_compress_default(buf, out + max_header, int(size),
+					 int(size - max_header - 1));
+    if (block_len <= 0) {
+	// It didn't fit in the space available, so it didn't get smaller.
+	return NULL;
+    }
+    pack_uint(header, unsigned(block_len));
+    if (header.size() != max_header) {
+	memmove(out + header.size(), out + max_header, block_len);
+    }
+    memcpy(out, header.data(), header.size());
+    *p_size = header.size() + block_len;
+    return out;
+#else
+    (void)buf;
+    (void)p_size;
+    return NULL;
+#endif
+}
+
+const char*
+CompressionStream::compress_zstd(const char* buf, size_t* p_size) {
+    check_codec_supported();
+#ifdef HAVE_ZSTD
+    if (!zstd_cctx) {
+	zstd_cctx = ZSTD_createCCtx();
+	if (!zstd_cctx) throw std::bad_alloc();
+    }
+    size_t size = *p_size;
+    reserve_out(size);
+    // As for zlib, limit the output buffer to the size of the input so zstd
+    // gives up if the data doesn't compress.
+    size_t res = ZSTD_compressCCtx(zstd_cctx, out, size, buf, size,
+				   ZSTD_CLEVEL_DEFAULT);
+    if (ZSTD_isError(res) || res >= size) {
+	// Presumably the data wasn't compressible.
+	return NULL;
+    }
+    *p_size = res;
+    return out;
+#else
+    (void)buf;
+    (void)p_size;
+    return NULL;
+#endif
+}
+
+void
+CompressionStream::decompress_start()
+{
+    switch (codec) {
+	case COMPRESSION_LZ4:
+	    check_codec_supported();
+	    lz4_in.resize(0);
+	    break;
+	case COMPRESSION_ZSTD:
+	    check_codec_supported();
+#ifdef HAVE_ZSTD
+	    if (!zstd_dstream) {
+		zstd_dstream = ZSTD_createDStream();
+		if (!zstd_dstream) throw std::bad_alloc();
+	    }
+	    (void)ZSTD_initDStream(zstd_dstream);
+#endif
+	    break;
+	default:
+	    lazy_alloc_inflate_zstream();
+	    break;
+    }
+}
+
 bool
 CompressionStream::decompress_chunk(const char* p, int len, string& buf)
+{
+    switch (codec) {
+	case COMPRESSION_LZ4:
+	    return decompress_chunk_lz4(p, len, buf);
+	case COMPRESSION_ZSTD:
+	    return decompress_chunk_zstd(p, len, buf);
+	default:
+	    return decompress_chunk_zlib(p, len, buf);
+    }
+}
+
+bool
+CompressionStream::decompress_chunk_lz4(const char* p, int len, string& buf)
+{
+#ifdef HAVE_LZ4
+    lz4_in.append(p, len);
+    const char* q = lz4_in.data();
+    const char* end = q + lz4_in.size();
+    size_t size;
+    unsigned block_len;
+    if (!unpack_uint(&q, end, &size) || !unpack_uint(&q, end, &block_len)) {
+	if (!q) {
+	    // Not enough data yet.
+	    return false;
+	}
+	throw Xapian::DatabaseCorruptError("Bad lz4 compressed data header");
+    }
+    if (size_t(end - q) < block_len) return false;
+    if (size_t(end - q) > block_len || size > size_t(LZ4_MAX_INPUT_SIZE))
+	throw Xapian::DatabaseCorruptError("Bad lz4 compressed data");
+    size_t old_size = buf.size();
+    buf.resize(old_size + size);
+    int res = LZ4_decompress_safe(q, &buf[old_size], int(block_len),
+				  int(size));
+    if (res < 0 || size_t(res) != size)
+	throw Xapian::DatabaseCorruptError("lz4 decompression failed");
+    lz4_in.resize(0);
+    return true;
+#else
+    (void)p;
+    (void)len;
+    (void)buf;
+    return false;
+#endif
+}
+
+bool
+CompressionStream::decompress_chunk_zstd(const char* p, int len, string& buf)
+{
+#ifdef HAVE_ZSTD
+    char blk[8192];
+
+    ZSTD_inBuffer in = { p, size_t(len), 0 };
+    while (true) {
+	ZSTD_outBuffer output = { blk, sizeof(blk), 0 };
+	size_t res = ZSTD_decompressStream(zstd_dstream, &output, &in);
+	if (ZSTD_isError(res)) {
+	    string msg = "zstd decompression failed (";
+	    msg += ZSTD_getErrorName(res);
+	    msg += ')';
+	    throw Xapian::DatabaseError(msg);
+	}
+	buf.append(blk, output.pos);
+	if (res == 0) return true;
+	// If the output buffer was filled there may be more output pending.
+	if (in.pos == in.size && output.pos < output.size) return false;
+    }
+#else
+    (void)p;
+    (void)len;
+    (void)buf;
+    return false;
+#endif
+}
+
+bool
+CompressionStream::decompress_chunk_zlib(const char* p, int len, string& buf)
 {
     Bytef blk[8192];
 
@@ -1,5 +1,5 @@
 /** @file
- * @brief class wrapper around zlib
+ * @brief class wrapper around zlib, and optionally lz4 and zstd
  */
 /* Copyright (C) 2012 Dan Colish
  * Copyright (C) 2012,2013,2014,2016 Olly Betts
@@ -26,9 +26,32 @@
 #include <string>
 #include <zlib.h>
 
+#ifdef HAVE_ZSTD
+# include <zstd.h>
+#endif
+
+/** Codecs which can be used to compress tags.
+ *
+ *  These values are stored in database version files, so must not be
+ *  changed.
+ */
+enum compression_codec {
+    COMPRESSION_ZLIB = 0,
+    COMPRESSION_LZ4 = 1,
+    COMPRESSION_ZSTD = 2
+};
+
+/// Map Xapian::DB_COMPRESS_* bits in @a flags to a compression_codec.
+compression_codec compression_codec_from_flags(int flags);
+
+/// Return true if compression codec @a codec is supported by this build.
+bool compression_codec_supported(compression_codec codec);
+
 class CompressionStream {
     int compress_strategy;
 
+    compression_codec codec;
+
     size_t out_len;
 
     char* out;
@@ -39,6 +62,45 @@ class CompressionStream {
     /// Zlib state object for inflating
     z_stream* inflate_zstream;
 
+#ifdef HAVE_ZSTD
+    /// Zstd state object for compressing
+    ZSTD_CCtx* zstd_cctx;
+
+    /// Zstd state object for decompressing
+    ZSTD_DStream* zstd_dstream;
+#endif
+
+    /** Compressed data for lz4 accumulated by decompress_chunk().
+     *
+     *  The lz4 block format can't be decompressed incrementally, so we
+     *  gather up all the chunks of a tag and decompress in one go.
+     */
+    std::string lz4_in;
+
+    /// Compress with zlib.
+    const char* compress_zlib(const char* buf, size_t* p_size);
+
+    /// Compress with lz4.
+    const char* compress_lz4(const char* buf, size_t* p_size);
+
+    /// Compress with zstd.
+    const char* compress_zstd(const char* buf, size_t* p_size);
+
+    /// Decompress a chunk of zlib data.
+    bool decompress_chunk_zlib(const char* p, int len, std::string& buf);
+
+    /// Decompress a chunk of lz4 data.
+    bool decompress_chunk_lz4(const char* p, int len, std::string& buf);
+
+    /// Decompress a chunk of zstd data.
+    bool decompress_chunk_zstd(const char* p, int len, std::string& buf);
+
+    /// Ensure the output buffer can hold at least size bytes.
+    void reserve_out(size_t size);
+
+    /// Throw FeatureUnavailableError if the codec isn't supported.
+    void check_codec_supported() const;
+
     /// Allocate the zstream for deflating, if not already allocated.
     void lazy_alloc_deflate_zstream();
 
@@ -50,20 +112,36 @@ class CompressionStream {
      *
      *  @param compress_strategy_	Z_DEFAULT_STRATEGY,
      *					Z_FILTERED, Z_HUFFMAN_ONLY, or Z_RLE.
+     *					Only used by the zlib codec.
      */
     explicit CompressionStream(int compress_strategy_ = Z_DEFAULT_STRATEGY)
 	: compress_strategy(compress_strategy_),
+	  codec(COMPRESSION_ZLIB),
 	  out_len(0),
 	  out(NULL),
 	  deflate_zstream(NULL),
 	  inflate_zstream(NULL)
+#ifdef HAVE_ZSTD
+	  , zstd_cctx(NULL),
+	  zstd_dstream(NULL)
+#endif
     { }
 
     ~CompressionStream();
 
+    /** Set the codec to use.
+     *
+     *  Setting a codec which this build doesn't support is allowed, but
+     *  FeatureUnavailableError will be thrown if an attempt is then made to
+     *  compress or decompress data.
+     */
+    void set_codec(compression_codec codec_) { codec = codec_; }
+
+    compression_codec get_codec() const { return codec; }
+
     const char* compress(const char* buf, size_t* p_size);
 
-    void decompress_start() { lazy_alloc_inflate_zstream(); }
+    void decompress_start();
 
     /** Returns true if this was the final chunk. */
     bool decompress_chunk(const char* p, int len, std::string& buf);
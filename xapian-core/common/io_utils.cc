@@ -26,6 +26,10 @@
 
 #include "safeunistd.h"
 
+#ifdef HAVE_MMAP
+# include <sys/mman.h>
+#endif
+
 #include <cerrno>
 #include <cstring>
 #include <string>
@@ -254,6 +258,39 @@ io_readahead_block(int fd, size_t n, off_t b, off_t o)
     // the same fd.
     return posix_fadvise(fd, o, n, POSIX_FADV_WILLNEED) == 0;
 }
+
+bool
+io_readahead_blocks(int fd, size_t n, off_t b, unsigned count, off_t o)
+{
+    o += b * n;
+    return posix_fadvise(fd, o, off_t(n) * count, POSIX_FADV_WILLNEED) == 0;
+}
+#endif
+
+#ifdef HAVE_MMAP
+const char*
+io_mmap_read(int fd, size_t n)
+{
+    void* p = mmap(NULL, n, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) return NULL;
+    return static_cast<const char*>(p);
+}
+
+void
+io_munmap(const char* p, size_t n)
+{
+    // Nothing useful can be done if this fails.
+    (void)munmap(const_cast<char*>(p), n);
+}
+
+# ifdef HAVE_MADVISE
+bool
+io_mmap_advise(const char* p, size_t n, io_mmap_advice advice)
+{
+    int flag = (advice == IO_MMAP_RANDOM ? MADV_RANDOM : MADV_WILLNEED);
+    return madvise(const_cast<char*>(p), n, flag) == 0;
+}
+# endif
 #endif
 
 void
@@ -156,6 +156,59 @@ bool io_readahead_block(int fd, size_t n, off_t b, off_t o = 0);
 inline bool io_readahead_block(int, size_t, off_t, off_t = 0) { return false; }
 #endif
 
+/** Readahead count consecutive blocks starting at block b size n bytes from
+ *  file descriptor fd.
+ *
+ *  Returns false if we can't readahead on this fd.
+ */
+#ifdef HAVE_POSIX_FADVISE
+bool io_readahead_blocks(int fd, size_t n, off_t b, unsigned count,
+			 off_t o = 0);
+#else
+inline bool io_readahead_blocks(int, size_t, off_t, unsigned, off_t = 0) {
+    return false;
+}
+#endif
+
+/** Map the first n bytes of file descriptor fd into memory read-only.
+ *
+ *  Returns NULL if the file can't be mapped (including if mmap() isn't
+ *  supported on this platform), in which case the caller should fall back to
+ *  reading the file.
+ */
+#ifdef HAVE_MMAP
+const char* io_mmap_read(int fd, size_t n);
+#else
+inline const char* io_mmap_read(int, size_t) { return NULL; }
+#endif
+
+/// Unmap a mapping of size n returned by io_mmap_read().
+#ifdef HAVE_MMAP
+void io_munmap(const char* p, size_t n);
+#else
+inline void io_munmap(const char*, size_t) { }
+#endif
+
+/// Expected access patterns for io_mmap_advise().
+enum io_mmap_advice {
+    /// Pages will be accessed in random order, so don't read ahead.
+    IO_MMAP_RANDOM,
+    /// Pages will be needed soon, so start reading them in.
+    IO_MMAP_WILLNEED
+};
+
+/** Tell the OS how n bytes of a mapping starting at p will be accessed.
+ *
+ *  Returns true if the hint was accepted.
+ */
+#if defined HAVE_MMAP && defined HAVE_MADVISE
+bool io_mmap_advise(const char* p, size_t n, io_mmap_advice advice);
+#else
+inline bool io_mmap_advise(const char*, size_t, io_mmap_advice) {
+    return false;
+}
+#endif
+
 /// Read block b size n bytes into buffer p from file descriptor fd, offset o.
 void io_read_block(int fd, char * p, size_t n, off_t b, off_t o = 0);
 
@@ -22,12 +22,14 @@ xapianinclude_HEADERS =\
 	include/xapian/enquire.h\
 	include/xapian/eset.h\
 	include/xapian/expanddecider.h\
+	include/xapian/filtercache.h\
 	include/xapian/intrusive_ptr.h\
 	include/xapian/iterator.h\
 	include/xapian/keymaker.h\
 	include/xapian/matchdecider.h\
 	include/xapian/matchspy.h\
 	include/xapian/mset.h\
+	include/xapian/msetcache.h\
 	include/xapian/positioniterator.h\
 	include/xapian/postingiterator.h\
 	include/xapian/postingsource.h\
@@ -71,6 +71,8 @@
 #include <xapian/enquire.h>
 #include <xapian/eset.h>
 #include <xapian/mset.h>
+#include <xapian/msetcache.h>
+#include <xapian/filtercache.h>
 #include <xapian/expanddecider.h>
 #include <xapian/keymaker.h>
 #include <xapian/matchdecider.h>
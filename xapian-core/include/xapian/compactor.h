@@ -38,6 +38,12 @@ class Database;
 /** Compact a database, or merge and compact several.
  */
 class XAPIAN_VISIBILITY_DEFAULT Compactor {
+    /// Index types set by set_honey_index_type().
+    std::string honey_index_types;
+
+    /// Bloom filter sizes set by set_honey_bloom_bits().
+    std::string honey_bloom_bits;
+
   public:
     /** Compaction level. */
     typedef enum {
@@ -93,6 +99,67 @@ class XAPIAN_VISIBILITY_DEFAULT Compactor {
     virtual std::string
     resolve_duplicate_metadata(const std::string & key,
 			       size_t num_tags, const std::string tags[]);
+
+    /** Set the type of index to build for tables when compacting to honey.
+     *
+     *  This takes precedence over the XAPIAN_HONEY_SSTINDEX environment
+     *  variable.  Later calls override earlier ones for the same table.
+     *
+     *  @param type	The index type: "array", "binarychop", "skiplist" or
+     *			"eytzinger".  An unknown type causes compaction to
+     *			throw InvalidArgumentError.
+     *  @param table	The table to set the index type for (e.g.
+     *			"postlist"), or an empty string (the default) for all
+     *			tables.
+     *
+     *  Experimental - see
+     *  https://xapian.org/docs/deprecation#experimental-features
+     */
+    void set_honey_index_type(const std::string& type,
+			      const std::string& table = std::string());
+
+    /** Return the index types set by set_honey_index_type().
+     *
+     *  The format is as for XAPIAN_HONEY_SSTINDEX: a comma separated list
+     *  of index types for all tables and table=type pairs, with later
+     *  entries taking precedence.
+     *
+     *  Experimental - see
+     *  https://xapian.org/docs/deprecation#experimental-features
+     */
+    const std::string& get_honey_index_types() const {
+	return honey_index_types;
+    }
+
+    /** Set the size of Bloom filters for tables when compacting to honey.
+     *
+     *  This takes precedence over the XAPIAN_HONEY_BLOOM_BITS environment
+     *  variable.  Later calls override earlier ones for the same table.
+     *
+     *  @param bits	The number of bits per key, from 0 (no Bloom filter)
+     *			to 64.  A larger value causes compaction to throw
+     *			InvalidArgumentError.
+     *  @param table	The table to set the size for (e.g. "postlist"), or
+     *			an empty string (the default) for all tables.
+     *
+     *  Experimental - see
+     *  https://xapian.org/docs/deprecation#experimental-features
+     */
+    void set_honey_bloom_bits(unsigned bits,
+			      const std::string& table = std::string());
+
+    /** Return the Bloom filter sizes set by set_honey_bloom_bits().
+     *
+     *  The format is as for XAPIAN_HONEY_BLOOM_BITS: a comma separated list
+     *  of bits per key for all tables and table=bits pairs, with later
+     *  entries taking precedence.
+     *
+     *  Experimental - see
+     *  https://xapian.org/docs/deprecation#experimental-features
+     */
+    const std::string& get_honey_bloom_bits() const {
+	return honey_bloom_bits;
+    }
 };
 
 }
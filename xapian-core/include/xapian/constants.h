@@ -144,6 +144,119 @@ const int DB_NO_TERMLIST	 = 0x20;
  */
 const int DB_RETRY_LOCK		 = 0x40;
 
+/** Read tables of a read-only database via a memory mapping.
+ *
+ *  By default, each block of a database table is read into a buffer as it
+ *  is needed.  If this flag is specified when opening a Database, then
+ *  blocks of glass tables are instead copied from a read-only memory
+ *  mapping of the table file, which avoids a system call per block read,
+ *  and lets the operating system's page cache be shared between processes
+ *  without duplicating it in each process.  A writer can reuse the blocks
+ *  of old revisions, so each block is checked after it is copied just as
+ *  if it had been read, and Xapian::DatabaseModifiedError is reported in
+ *  the same situations as without this flag.  Single-file glass databases
+ *  can't be updated, so their blocks are accessed in place in the mapping
+ *  without being copied.  For honey databases, keys and (uncompressed)
+ *  tags are read straight from the mapping too.
+ *
+ *  This flag has no effect when opening a WritableDatabase, for backends
+ *  other than glass and honey, or on platforms without mmap().
+ *
+ *  Xapian::DB_CREATE_OR_OVERWRITE replaces glass table files rather than
+ *  truncating them, so mapped readers aren't affected.  However, a
+ *  single-file or honey database shouldn't be overwritten in place (e.g.
+ *  by compacting to the same path) while it is open with this flag, as the
+ *  process may receive SIGBUS if a mapped file is truncated - write the new
+ *  database elsewhere and rename it into place instead.
+ */
+const int DB_MMAP		 = 0x80;
+
+/** Hint that a memory mapped database will be accessed randomly.
+ *
+ *  Use with Xapian::DB_MMAP to tell the operating system not to read ahead
+ *  in the mapped table files of a honey database, which avoids reading data
+ *  which isn't needed when the database is much bigger than the available
+ *  memory.
+ *
+ *  This flag is ignored unless Xapian::DB_MMAP is also specified.
+ */
+const int DB_MMAP_RANDOM	 = 0x2000;
+
+/** Hint that all of a memory mapped database will be needed soon.
+ *
+ *  Use with Xapian::DB_MMAP to ask the operating system to start reading the
+ *  mapped table files of a honey database into memory, which avoids slow
+ *  initial searches when a server starts.
+ *
+ *  This flag is ignored unless Xapian::DB_MMAP is also specified.
+ */
+const int DB_MMAP_WILLNEED	 = 0x4000;
+
+/** Maintain a dense column of document lengths.
+ *
+ *  When creating or opening a glass WritableDatabase, this makes the
+ *  database maintain a file holding the length of every document bit-packed
+ *  into an array indexed by docid, which readers use to look up document
+ *  lengths (needed by most weighting schemes) without searching the postlist
+ *  table.  Each commit appends the changed lengths to a log beside the
+ *  file, and the file is only rewritten (which costs time proportional to
+ *  the number of documents) once the log has grown large.
+ *
+ *  Once the file exists, it continues to be maintained when the database is
+ *  opened for writing without this flag - delete the "doclens" file in the
+ *  database directory to stop this.
+ *
+ *  This flag can also be passed to Database::compact() when producing a
+ *  glass database.  It has no effect for single-file databases or other
+ *  backends.
+ */
+const int DB_DOCLEN_COLUMN	 = 0x8000;
+
+/** Store values in a columnar format with per-chunk bounds.
+ *
+ *  When creating or opening a glass WritableDatabase, this makes value
+ *  chunks get written with the document ids and the values stored
+ *  separately, values of the same length stored at fixed offsets, and the
+ *  smallest and largest value in each chunk recorded at its start.  This
+ *  makes skipping through a value slot cheaper, and allows value range
+ *  queries to skip whole chunks which can't contain a matching value.
+ *  Existing chunks are
+ *  converted as they are updated, and the format continues to be used when
+ *  the database is opened for writing without this flag.
+ *
+ *  This flag can also be passed to Database::compact() when producing a
+ *  glass database, in which case all the value chunks are converted.
+ *
+ *  A database using this format can't be opened by versions of Xapian
+ *  without support for it.
+ */
+const int DB_COLUMNAR_VALUES	 = 0x10000;
+
+/** Commit by appending to a write-ahead log.
+ *
+ *  When opening a glass WritableDatabase, this makes commit() append the
+ *  modifications made since the previous commit to a log file in the
+ *  database directory and sync just that, instead of writing and syncing a
+ *  new revision of the database tables.  This makes frequent small commits
+ *  much cheaper.  The modifications are written to the tables as a new
+ *  revision at a checkpoint - when the automatic flush threshold is reached
+ *  (see WritableDatabase::commit()), or when the database is closed - and
+ *  then the log is removed.
+ *
+ *  The modifications in the log are applied again when the database is next
+ *  opened for writing (with or without this flag), so changes which have
+ *  been committed survive a crash before the next checkpoint.
+ *
+ *  Readers see committed modifications too: when a Database is opened (or
+ *  Database::reopen() is called) and there's a log, it replays the log in
+ *  memory on top of the tables.  This takes longer the more there is in
+ *  the log, which is limited by the checkpoints.
+ *
+ *  This flag has no effect with Xapian::DB_DANGEROUS, or for other
+ *  backends.
+ */
+const int DB_WRITE_AHEAD_LOG	 = 0x20000;
+
 /** Use the glass backend.
  *
  *  When opening a WritableDatabase, this means create a glass database if a
@@ -190,9 +303,11 @@ const int DB_BACKEND_INMEMORY	 = 0x400;
 
 /** Use the honey backend.
  *
- *  When opening a WritableDatabase, this means create a honey database if a
- *  new database is created.  If there's an existing database (of any type)
- *  at the specified path, this flag has no effect.
+ *  When opening a WritableDatabase, this means create a segmented honey
+ *  database if a new database is created - new documents are written to
+ *  small honey databases which are merged in the background.  If there's an
+ *  existing database (of any type other than a single honey database) at the
+ *  specified path, this flag has no effect.
  *
  *  When opening a Database, this flag means to only open it if it's a honey
  *  database.  There's rarely a good reason to do this - it's mostly provided
@@ -201,10 +316,38 @@ const int DB_BACKEND_INMEMORY	 = 0x400;
  */
 const int DB_BACKEND_HONEY	 = 0x500;
 
+/** Compress tags using lz4 rather than zlib.
+ *
+ *  When creating a new glass database (or as a flag to Database::compact()
+ *  producing a glass database), this selects lz4 to compress the tags in
+ *  the tables which are compressed (document data, termlists, spellings and
+ *  synonyms).  lz4 compresses less well than zlib, but decompression is
+ *  much faster.  The codec is recorded in the database, so the flag isn't
+ *  needed when opening it again, and has no effect on an existing database.
+ *
+ *  A database created with this flag can't be opened by versions of Xapian
+ *  without lz4 support.  If this build of Xapian lacks lz4 support, then
+ *  Xapian::FeatureUnavailableError is thrown.
+ */
+const int DB_COMPRESS_LZ4	 = 0x800;
+
+/** Compress tags using zstd rather than zlib.
+ *
+ *  Like Xapian::DB_COMPRESS_LZ4, but uses zstd, which typically compresses
+ *  about as well as zlib, but decompresses several times faster.
+ */
+const int DB_COMPRESS_ZSTD	 = 0x1000;
+
 #ifdef XAPIAN_LIB_BUILD
 /** @internal Bit mask for backend codes. */
 const int DB_BACKEND_MASK_	 = 0x700;
 
+/** @internal Bit mask for compression codec flags. */
+const int DB_COMPRESS_MASK_	 = 0x1800;
+
+/** @internal Bit mask for flags controlling memory mapping. */
+const int DB_MMAP_MASK_		 = DB_MMAP | DB_MMAP_RANDOM | DB_MMAP_WILLNEED;
+
 /** @internal Used internally to signify opening read-only. */
 const int DB_READONLY_		 = -1;
 #endif
@@ -27,6 +27,7 @@
 # error Never use <xapian/database.h> directly; include <xapian.h> instead.
 #endif
 
+#include <cstddef>
 #include <iosfwd>
 #include <string>
 #include <utility>
@@ -616,6 +617,33 @@ class XAPIAN_VISIBILITY_DEFAULT Database {
      */
     Xapian::Database unlock();
 
+    /** Return how many blocks of posting lists have been read ahead.
+     *
+     *  When iterating a posting list which spans several blocks, glass
+     *  databases ask the operating system to start reading the following
+     *  blocks before they're needed.  This returns the number of blocks this
+     *  has been done for since the database was opened, summed over all
+     *  shards.  Comparing the values from before and after a search gives
+     *  the readahead for that search.
+     *
+     *  Backends which don't read ahead don't add anything to the count.
+     *
+     *  Experimental - see
+     *  https://xapian.org/docs/deprecation#experimental-features
+     */
+    size_t get_readahead_issued() const;
+
+    /** Return how many blocks which were read ahead were then used.
+     *
+     *  Blocks counted by get_readahead_issued() which weren't used were
+     *  either skipped over or not reached, so the ratio of the two is a
+     *  measure of how effective readahead is.
+     *
+     *  Experimental - see
+     *  https://xapian.org/docs/deprecation#experimental-features
+     */
+    size_t get_readahead_used() const;
+
     /** Get the revision of the database.
      *
      *  The revision is an unsigned integer which increases with each commit.
@@ -654,6 +682,58 @@ class XAPIAN_VISIBILITY_DEFAULT Database {
 	return check_(NULL, fd, opts, out);
     }
 
+    /** Set the size of the block cache shared by read-only glass databases.
+     *
+     *  Read-only glass databases opened in this process can share a cache
+     *  of B-tree blocks, so that several Database objects on the same
+     *  database avoid reading the same blocks from disk repeatedly.  The
+     *  initial size is taken from the XAPIAN_GLASS_BLOCK_CACHE_SIZE
+     *  environment variable (default 0, which disables the cache).
+     *
+     *  A change only affects databases opened afterwards, except that
+     *  reducing the size evicts blocks immediately.  Databases opened with
+     *  DB_MMAP don't use the cache.
+     *
+     *  @param size	Maximum number of bytes of blocks to cache, or 0 to
+     *			disable the cache.
+     *
+     *  Experimental - see
+     *  https://xapian.org/docs/deprecation#experimental-features
+     */
+    static void set_block_cache_size(size_t size);
+
+    /** Return the size of the block cache shared by glass databases.
+     *
+     *  Experimental - see
+     *  https://xapian.org/docs/deprecation#experimental-features
+     */
+    static size_t get_block_cache_size();
+
+    /** Return how many block reads were answered from the block cache.
+     *
+     *  The count is over all glass databases in the process since the
+     *  cache was first used.
+     *
+     *  Experimental - see
+     *  https://xapian.org/docs/deprecation#experimental-features
+     */
+    static unsigned long long get_block_cache_hits();
+
+    /** Return how many blocks were looked for in the block cache but not
+     *  found.
+     *
+     *  Experimental - see
+     *  https://xapian.org/docs/deprecation#experimental-features
+     */
+    static unsigned long long get_block_cache_misses();
+
+    /** Return how many blocks have been evicted from the block cache.
+     *
+     *  Experimental - see
+     *  https://xapian.org/docs/deprecation#experimental-features
+     */
+    static unsigned long long get_block_cache_evictions();
+
     /** Produce a compact version of this database.
      *
      *  @param output	Path to write the compact version to.  This can be the
@@ -691,6 +771,10 @@ class XAPIAN_VISIBILITY_DEFAULT Database {
      *     only glass to honey conversion is supported, and all shards of the
      *     input must have the same format):
      *     - Xapian::DB_BACKEND_HONEY
+     *   - At most one of the following to specify the codec to compress
+     *     tags with in a glass output database (zlib is used by default):
+     *     - Xapian::DB_COMPRESS_LZ4
+     *     - Xapian::DB_COMPRESS_ZSTD
      *
      *  @param block_size	This specifies the block size (in bytes) for to
      *				use for the output.  For glass, the block size
@@ -1071,12 +1155,91 @@ class XAPIAN_VISIBILITY_DEFAULT WritableDatabase : public Database {
      *  conservative, and if you have a machine with plenty of memory,
      *  you can improve indexing throughput dramatically by setting
      *  XAPIAN_FLUSH_THRESHOLD in the environment to a larger value.
+     *  Alternatively, set_flush_memory_limit() commits them based on the
+     *  memory they use instead.
      *
      *  @since This method was new in Xapian 1.1.0 - in earlier versions it
      *	       was called flush().
      */
     void commit();
 
+    /** Commit pending modifications, syncing them to disk in the background.
+     *
+     *  This works like commit() except that it returns without waiting for
+     *  the modifications to be synced to disk, so you can carry on making
+     *  modifications while that happens.  This can be useful if you need to
+     *  commit often, as syncing to disk is usually what makes committing
+     *  slow.
+     *
+     *  The committed revision becomes visible to readers once the sync
+     *  finishes, and isn't guaranteed to survive a crash before then.  Use
+     *  wait_for_commit() to wait for the sync.  The next commit, or closing
+     *  the database, also waits for it.  If the sync fails, the database is
+     *  closed and Xapian::DatabaseError is thrown by whichever of these
+     *  waits.  So a sync failure is only reported by a later call to
+     *  wait_for_commit(), commit(), commit_async() or close() - if the
+     *  WritableDatabase is destroyed without one, the error can only be
+     *  logged (when Xapian is built with debug logging enabled), so call
+     *  close() or wait_for_commit() if you need to know the last commit
+     *  made it to disk.
+     *
+     *  While a sync is in progress, space freed by earlier revisions isn't
+     *  reused, so the database may grow a little more than it otherwise
+     *  would.
+     *
+     *  Currently only the glass backend supports syncing in the background,
+     *  and not for a single-file database, if the database was opened with
+     *  Xapian::DB_NO_SYNC or Xapian::DB_DANGEROUS, when replication
+     *  changesets are being written, or with Xapian::DB_DOCLEN_COLUMN.  In
+     *  these cases this method is the same as commit().
+     *
+     *  It's not valid to call commit_async() within a transaction.
+     */
+    void commit_async();
+
+    /** Wait for a commit by commit_async() to be synced to disk.
+     *
+     *  Returns immediately if there isn't one in progress.
+     *
+     *  @exception Xapian::DatabaseError is thrown if syncing failed (the
+     *		   database will have been closed).
+     */
+    void wait_for_commit();
+
+    /** Automatically commit when buffered modifications use this much memory.
+     *
+     *  The number of documents it's best to batch up varies a lot with the
+     *  size of the documents, so limiting the memory used by the batched
+     *  modifications is usually a better way to control this than
+     *  XAPIAN_FLUSH_THRESHOLD.  When a limit is set, the default of
+     *  committing every 10000 documents no longer applies, though a
+     *  threshold explicitly set with XAPIAN_FLUSH_THRESHOLD still does.
+     *
+     *  The memory used is estimated, so is only approximate.  It counts the
+     *  changes to posting lists, document lengths, positional data and
+     *  document values, which are what gets batched up (other changes are
+     *  written to the database tables as they are made).
+     *
+     *  Within a transaction, reaching the limit writes the modifications to
+     *  the database tables but doesn't commit them.
+     *
+     *  For a WritableDatabase with several shards, the limit applies to each
+     *  shard separately.  Currently only the glass backend batches up
+     *  modifications like this, and this method has no effect on other
+     *  backends (including remote databases).
+     *
+     *  @param limit	The limit in bytes, or 0 to remove the limit (the
+     *			default).
+     */
+    void set_flush_memory_limit(std::size_t limit);
+
+    /** Return the approximate memory used by batched modifications.
+     *
+     *  This is the total the limit set by set_flush_memory_limit() is
+     *  compared with (summed over all shards).
+     */
+    std::size_t get_buffered_memory() const;
+
     /** Begin a transaction.
      *
      *  A Xapian transaction is a set of consecutive modifications to be
@@ -42,9 +42,11 @@ namespace Xapian {
 // Forward declarations of classes referenced below.
 class Database;
 class ExpandDecider;
+class FilterCache;
 class KeyMaker;
 class MatchDecider;
 class MatchSpy;
+class MSetCache;
 class Query;
 class RSet;
 class Weight;
@@ -358,6 +360,78 @@ class XAPIAN_VISIBILITY_DEFAULT Enquire {
      */
     void set_time_limit(double time_limit);
 
+    /** Set the number of threads to use to match local shards in parallel.
+     *
+     *  By default the local shards of a sharded database are matched one
+     *  after another on the calling thread.  If this is set to more than 1
+     *  then up to that many threads (including the calling thread) are used
+     *  to match the local shards in parallel, each shard being matched
+     *  separately and the results merged.  The shards share the minimum
+     *  weight needed to make it into the MSet so that they can skip
+     *  documents which another shard has shown can't be returned.
+     *
+     *  A database with a single local glass or honey shard is instead split
+     *  into ranges of document ids which are matched in parallel in the same
+     *  way, each range using a separate instance of the database opened at
+     *  the same revision with the same flags.  These instances are kept by
+     *  the Enquire object for later searches, and only reopened when the
+     *  database's revision changes.  This only happens if the shard is large
+     *  enough for it to be worthwhile (see the admin notes), and not for a
+     *  WritableDatabase or a single-file database opened from a file
+     *  descriptor.  Any PostingSource objects must implement clone()
+     *  for a shard to be split - if one doesn't, the match is serial.
+     *
+     *  When this is enabled, any MatchDecider or KeyMaker set must be safe
+     *  to call from multiple threads at once.  Any MatchSpy objects must
+     *  implement clone(), serialise_results() and merge_results() (as is
+     *  required to use them with remote shards) - a clone is used for each
+     *  shard and the results merged into the original afterwards.  If any
+     *  MatchSpy doesn't implement clone() then the shards are matched
+     *  serially.
+     *
+     *  @param n_threads  Maximum number of threads to use (default: 0, which
+     *			  like 1 means to match shards serially)
+     */
+    void set_match_threads(unsigned n_threads);
+
+    /** Use a cache of search results.
+     *
+     *  Searches run by get_mset() which can be cached (see MSetCache) are
+     *  looked up in @a cache, and their results are added to it if not
+     *  found.  The same MSetCache can be used by many Enquire objects,
+     *  including ones for different databases.
+     *
+     *  An MSetCache isn't safe to use from multiple threads at once, so
+     *  Enquire objects in different threads shouldn't share one.
+     *
+     *  @param cache	The MSetCache object to use.
+     */
+    void set_mset_cache(const MSetCache& cache);
+
+    /** Stop using a cache of search results.
+     *
+     *  This doesn't discard the contents of the cache.
+     */
+    void clear_mset_cache();
+
+    /** Use a cache of the documents matching filter subqueries.
+     *
+     *  The documents matching the filter subqueries of Query::OP_FILTER
+     *  (all but the first subquery) in each local shard can be stored in
+     *  @a cache and read from it by later searches (see FilterCache).  The
+     *  same FilterCache can be used by many Enquire objects, including ones
+     *  for different databases and ones in different threads.
+     *
+     *  @param cache	The FilterCache object to use.
+     */
+    void set_filter_cache(const FilterCache& cache);
+
+    /** Stop using a cache of the documents matching filter subqueries.
+     *
+     *  This doesn't discard the contents of the cache.
+     */
+    void clear_filter_cache();
+
     /** Run the query.
      *
      *  Run the query using the settings in this Enquire object and those
@@ -373,7 +447,14 @@ class XAPIAN_VISIBILITY_DEFAULT Enquire {
      *				estimate of the total number of matches -
      *				setting checkatleast higher allows trading off
      *				speed for tighter bounds and a more accurate
-     *				estimate.  (default: 0)
+     *				estimate.  With remote shards, how much the
+     *				remote servers can skip depends on when the
+     *				weight needed arrives from the client, so
+     *				unless checkatleast is more than first +
+     *				maxitems the bounds and estimate may differ
+     *				between runs of the same query (the bounds are
+     *				still valid and the documents returned are the
+     *				same).  (default: 0)
      *  @param rset		Documents marked as relevant (default: no
      *				documents have been marked as relevant)
      *  @param mdecider		Xapian::MatchDecider object - this acts as a
@@ -0,0 +1,136 @@
+/** @file
+ *  @brief Cache of the documents matching filter subqueries
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_FILTERCACHE_H
+#define XAPIAN_INCLUDED_FILTERCACHE_H
+
+#if !defined XAPIAN_IN_XAPIAN_H && !defined XAPIAN_LIB_BUILD
+# error Never use <xapian/filtercache.h> directly; include <xapian.h> instead.
+#endif
+
+#include <cstddef>
+#include <string>
+
+#include <xapian/intrusive_ptr.h>
+#include <xapian/visibility.h>
+
+namespace Xapian {
+
+/** Cache of the documents matching filter subqueries.
+ *
+ *  A FilterCache can be shared by any number of Enquire objects (see
+ *  Enquire::set_filter_cache()).  When a search uses Query::OP_FILTER, the
+ *  set of documents matching each of its filter subqueries (all but the
+ *  first subquery) in each local shard can be stored in the cache, so later
+ *  searches using the same filter just read that set rather than running the
+ *  filter subquery again.  This is useful when many searches are restricted
+ *  by the same few filters (for example access control or date range terms).
+ *
+ *  Only filters which have been used @a min_uses times are stored, so a
+ *  filter only used once doesn't take up space.
+ *
+ *  Like MSetCache, entries are specific to the revision of each shard, so
+ *  reopening a database at a new revision means its old entries are no
+ *  longer used, and filters aren't cached for shards which are writable or
+ *  don't track revisions (e.g. an inmemory database), nor for remote shards.
+ *  A filter subquery which can't be serialised isn't cached.
+ *
+ *  A PostingSource whose results depend on something other than its
+ *  serialised parameters and the database contents shouldn't be used in a
+ *  filter subquery with a FilterCache.
+ *
+ *  When the cache is full, the least recently used entries are discarded.
+ *
+ *  A FilterCache may be used by searches running in different threads at
+ *  the same time (including those using Enquire::set_match_threads()).
+ */
+class XAPIAN_VISIBILITY_DEFAULT FilterCache {
+  public:
+    /// Class representing the FilterCache internals.
+    class Internal;
+    /// @private @internal Reference counted internals.
+    Xapian::Internal::intrusive_ptr_nonnull<Internal> internal;
+
+    /** Copying is allowed.
+     *
+     *  The internals are reference counted, so copying is cheap, and the
+     *  copies share the same cache.
+     */
+    FilterCache(const FilterCache& o);
+
+    /** Copying is allowed.
+     *
+     *  The internals are reference counted, so assignment is cheap.
+     */
+    FilterCache& operator=(const FilterCache& o);
+
+    /// Move constructor.
+    FilterCache(FilterCache&& o);
+
+    /// Move assignment operator.
+    FilterCache& operator=(FilterCache&& o);
+
+    /** Constructor.
+     *
+     *  @param max_size	Approximate maximum size of the cache in bytes
+     *			(default: 64MB).
+     *  @param min_uses	Number of times a filter must be used in a shard
+     *			before the documents matching it are stored
+     *			(default: 2).
+     */
+    explicit FilterCache(std::size_t max_size = 64 * 1024 * 1024,
+			 unsigned min_uses = 2);
+
+    /// Destructor.
+    ~FilterCache();
+
+    /// Return the number of filters whose matching documents are stored.
+    std::size_t size() const;
+
+    /// Return true if no filters' matching documents are stored.
+    bool empty() const { return size() == 0; }
+
+    /// Return the approximate number of bytes the cache is using.
+    std::size_t get_memory_used() const;
+
+    /// Return how many times a filter was found in the cache.
+    std::size_t get_hits() const;
+
+    /** Return how many times a filter wasn't found in the cache.
+     *
+     *  Filters which can't be cached aren't counted as hits or misses.
+     */
+    std::size_t get_misses() const;
+
+    /// Return how many entries have been discarded to make room for others.
+    std::size_t get_evictions() const;
+
+    /** Discard all the cached entries.
+     *
+     *  The hit, miss and eviction counts are kept.
+     */
+    void clear();
+
+    /// Return a string describing this object.
+    std::string get_description() const;
+};
+
+}
+
+#endif // XAPIAN_INCLUDED_FILTERCACHE_H
@@ -0,0 +1,122 @@
+/** @file
+ *  @brief Cache of search results
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_MSETCACHE_H
+#define XAPIAN_INCLUDED_MSETCACHE_H
+
+#if !defined XAPIAN_IN_XAPIAN_H && !defined XAPIAN_LIB_BUILD
+# error Never use <xapian/msetcache.h> directly; include <xapian.h> instead.
+#endif
+
+#include <cstddef>
+#include <string>
+
+#include <xapian/intrusive_ptr.h>
+#include <xapian/visibility.h>
+
+namespace Xapian {
+
+/** Cache of search results.
+ *
+ *  An MSetCache can be shared by any number of Enquire objects (see
+ *  Enquire::set_mset_cache()), and stores the MSet objects they return so a
+ *  repeat of the same search can be answered without running the match.
+ *
+ *  Searches are only cached if the results are fully determined by the
+ *  Query, the Enquire settings and the revision of the database.  So a search
+ *  isn't cached if it uses a MatchDecider, MatchSpy, RSet or time limit, or
+ *  anything which can't be serialised (such as a user subclass of Weight
+ *  or PostingSource which doesn't implement serialisation), or if any shard
+ *  is writable or doesn't track revisions (e.g. an inmemory database).
+ *  Reopening a database at a new revision means its old results are no
+ *  longer used.
+ *
+ *  A PostingSource whose results depend on something other than its
+ *  serialised parameters and the database contents shouldn't be used with
+ *  an MSetCache.
+ *
+ *  When the cache is full, the least recently used results are discarded.
+ *
+ *  An MSetCache may be used by searches running in different threads at the
+ *  same time.
+ */
+class XAPIAN_VISIBILITY_DEFAULT MSetCache {
+  public:
+    /// Class representing the MSetCache internals.
+    class Internal;
+    /// @private @internal Reference counted internals.
+    Xapian::Internal::intrusive_ptr_nonnull<Internal> internal;
+
+    /** Copying is allowed.
+     *
+     *  The internals are reference counted, so copying is cheap, and the
+     *  copies share the same cache.
+     */
+    MSetCache(const MSetCache& o);
+
+    /** Copying is allowed.
+     *
+     *  The internals are reference counted, so assignment is cheap.
+     */
+    MSetCache& operator=(const MSetCache& o);
+
+    /// Move constructor.
+    MSetCache(MSetCache&& o);
+
+    /// Move assignment operator.
+    MSetCache& operator=(MSetCache&& o);
+
+    /** Constructor.
+     *
+     *  @param max_size	Approximate maximum size of the cache in bytes
+     *			(default: 16MB).
+     */
+    explicit MSetCache(std::size_t max_size = 16 * 1024 * 1024);
+
+    /// Destructor.
+    ~MSetCache();
+
+    /// Return the number of searches currently cached.
+    std::size_t size() const;
+
+    /// Return true if no searches are currently cached.
+    bool empty() const { return size() == 0; }
+
+    /** Return how many searches were answered from the cache.
+     *
+     *  Searches which can't be cached aren't counted as hits or misses.
+     */
+    std::size_t get_hits() const;
+
+    /** Return how many searches which could be cached weren't.
+     *
+     *  Searches which can't be cached aren't counted as hits or misses.
+     */
+    std::size_t get_misses() const;
+
+    /// Discard all the cached results (the hit and miss counts are kept).
+    void clear();
+
+    /// Return a string describing this object.
+    std::string get_description() const;
+};
+
+}
+
+#endif // XAPIAN_INCLUDED_MSETCACHE_H
@@ -254,6 +254,19 @@ class XAPIAN_VISIBILITY_DEFAULT Weight {
      */
     virtual double get_maxpart() const = 0;
 
+    /** Return an upper bound on get_sumpart() for a block of postings.
+     *
+     *  Some backends record the maximum wdf for each block of postings,
+     *  which allows the matcher to calculate a tighter bound for a range of
+     *  documents than get_maxpart() gives for the whole posting list.
+     *
+     *  @param wdf_max	An upper bound on the wdf of any posting in the block.
+     *
+     *  The default implementation simply returns get_maxpart(), which is
+     *  always a valid bound.
+     */
+    virtual double get_block_maxpart(Xapian::termcount wdf_max) const;
+
     /** Calculate the term-independent weight component for a document.
      *
      *  The parameter gives information about the document which may be used
@@ -921,6 +934,7 @@ class XAPIAN_VISIBILITY_DEFAULT BM25Weight : public Weight {
 		       Xapian::termcount uniqterm,
 		       Xapian::termcount wdfdocmax) const;
     double get_maxpart() const;
+    double get_block_maxpart(Xapian::termcount wdf_max) const;
 
     double get_sumextra(Xapian::termcount doclen,
 			Xapian::termcount uniqterms,
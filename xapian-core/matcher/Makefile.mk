@@ -2,6 +2,7 @@ noinst_HEADERS +=\
 	matcher/andmaybepostlist.h\
 	matcher/andnotpostlist.h\
 	matcher/boolorpostlist.h\
+	matcher/cachedfilterpostlist.h\
 	matcher/collapser.h\
 	matcher/deciderpostlist.h\
 	matcher/estimateop.h\
@@ -30,6 +31,7 @@ noinst_HEADERS +=\
 	matcher/valuegepostlist.h\
 	matcher/valuerangepostlist.h\
 	matcher/valuestreamdocument.h\
+	matcher/wandpostlist.h\
 	matcher/wrapperpostlist.h
 
 EXTRA_DIST +=\
@@ -47,6 +49,7 @@ lib_src +=\
 	matcher/andmaybepostlist.cc\
 	matcher/andnotpostlist.cc\
 	matcher/boolorpostlist.cc\
+	matcher/cachedfilterpostlist.cc\
 	matcher/collapser.cc\
 	matcher/deciderpostlist.cc\
 	matcher/estimateop.cc\
@@ -69,4 +72,5 @@ lib_src +=\
 	matcher/valuegepostlist.cc\
 	matcher/valuerangepostlist.cc\
 	matcher/valuestreamdocument.cc\
+	matcher/wandpostlist.cc\
 	matcher/wrapperpostlist.cc
@@ -0,0 +1,108 @@
+/** @file
+ * @brief PostList returning the docids stored in a FilterCache
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "cachedfilterpostlist.h"
+
+#include "omassert.h"
+#include "str.h"
+
+using namespace std;
+
+Xapian::doccount
+CachedFilterPostList::get_termfreq() const
+{
+    return docids->size();
+}
+
+Xapian::docid
+CachedFilterPostList::get_docid() const
+{
+    Assert(did != 0);
+    Assert(!ended);
+    return did;
+}
+
+double
+CachedFilterPostList::get_weight(Xapian::termcount,
+				 Xapian::termcount,
+				 Xapian::termcount) const
+{
+    return 0;
+}
+
+bool
+CachedFilterPostList::at_end() const
+{
+    return ended;
+}
+
+double
+CachedFilterPostList::recalc_maxweight()
+{
+    return 0;
+}
+
+PostList*
+CachedFilterPostList::next(double)
+{
+    Assert(!ended);
+    if (rare(did == Xapian::docid(-1))) {
+	ended = true;
+	return NULL;
+    }
+    did = docids->find(did + 1, pos);
+    ended = (did == 0);
+    return NULL;
+}
+
+PostList*
+CachedFilterPostList::skip_to(Xapian::docid target, double)
+{
+    Assert(!ended);
+    if (target > did) {
+	did = docids->find(target, pos);
+	ended = (did == 0);
+    }
+    return NULL;
+}
+
+const Xapian::docid*
+CachedFilterPostList::get_docid_block(const Xapian::docid*& block_end) const
+{
+    Assert(did != 0);
+    Assert(!ended);
+    return docids->get_block(pos, block_end);
+}
+
+Xapian::termcount
+CachedFilterPostList::count_matching_subqs() const
+{
+    return 0;
+}
+
+string
+CachedFilterPostList::get_description() const
+{
+    string desc = "CachedFilterPostList(";
+    desc += str(docids->size());
+    desc += ')';
+    return desc;
+}
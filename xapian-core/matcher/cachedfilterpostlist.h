@@ -0,0 +1,77 @@
+/** @file
+ * @brief PostList returning the docids stored in a FilterCache
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_CACHEDFILTERPOSTLIST_H
+#define XAPIAN_INCLUDED_CACHEDFILTERPOSTLIST_H
+
+#include "api/filtercacheinternal.h"
+#include "backends/postlist.h"
+
+#include <memory>
+
+/// PostList returning the docids stored in a FilterCache.
+class CachedFilterPostList : public PostList {
+    /// Disallow copying.
+    CachedFilterPostList(const CachedFilterPostList&) = delete;
+
+    /// Disallow assignment.
+    void operator=(const CachedFilterPostList&) = delete;
+
+    /// The docids to return.
+    std::shared_ptr<const FilterDocidSet> docids;
+
+    /// The current docid, or 0 if we haven't started or are at the end.
+    Xapian::docid did = 0;
+
+    /// Position in @a docids (see FilterDocidSet::find()).
+    std::size_t pos = 0;
+
+    /// Have we reached the end?
+    bool ended = false;
+
+  public:
+    explicit
+    CachedFilterPostList(const std::shared_ptr<const FilterDocidSet>& docids_)
+	: docids(docids_) {}
+
+    Xapian::doccount get_termfreq() const;
+
+    Xapian::docid get_docid() const;
+
+    double get_weight(Xapian::termcount doclen,
+		      Xapian::termcount unique_terms,
+		      Xapian::termcount wdfdocmax) const;
+
+    bool at_end() const;
+
+    double recalc_maxweight();
+
+    PostList* next(double w_min);
+
+    PostList* skip_to(Xapian::docid target, double w_min);
+
+    const Xapian::docid*
+    get_docid_block(const Xapian::docid*& block_end) const;
+
+    Xapian::termcount count_matching_subqs() const;
+
+    std::string get_description() const;
+};
+
+#endif // XAPIAN_INCLUDED_CACHEDFILTERPOSTLIST_H
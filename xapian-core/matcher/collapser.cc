@@ -71,7 +71,10 @@ CollapseData::check_item(const vector<Result>& results,
 	// weight.
 	next_best_weight = result.get_weight();
 
-	return REPLACE;
+	// There's no entry in the proto-mset for us to replace, so the new
+	// result needs adding to it instead, and then add_item() will update
+	// the stale entry in items.
+	return REPLACE_DROPPED;
     }
 
     if (mcmp(old_result, result)) {
@@ -154,7 +157,7 @@ Collapser::check(Result& result,
 				   old_item);
     if (res == ADD) {
 	++entry_count;
-    } else if (res == REJECT || res == REPLACE) {
+    } else if (res == REJECT || res == REPLACE || res == REPLACE_DROPPED) {
 	++dups_ignored;
     }
     return res;
@@ -170,7 +173,8 @@ Collapser::process(collapse_result action,
 	    Assert(ptr);
 	    ptr->set_item(item);
 	    return;
-	case ADD: {
+	case ADD:
+	case REPLACE_DROPPED: {
 	    Assert(ptr);
 	    ptr->add_item(results, item, collapse_max, mcmp);
 	    break;
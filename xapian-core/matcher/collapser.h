@@ -35,7 +35,8 @@ typedef enum {
     NEW,
     ADD,
     REJECT,
-    REPLACE
+    REPLACE,
+    REPLACE_DROPPED
 } collapse_result;
 
 /// Class tracking information for a given value of the collapse key.
@@ -73,13 +74,18 @@ class CollapseData {
      *  the update of the CollapseData (if the result doesn't actually get
      *  added, then it's OK not to follow up with a call to add_item()).
      *
+     *  REPLACE_DROPPED means the entry @a result should replace has already
+     *  been pushed out of the proto-mset, so @a result should be added (like
+     *  ADD) and add_item() will then take over the dropped entry's place.
+     *
      *  @param results		The results so far.
      *  @param result		The new result.
      *  @param collapse_max	Max no. of items for each collapse key value.
      *  @param mcmp		Result comparison functor.
      *  @param[out] old_item	Item to be replaced (when REPLACE is returned).
      *
-     *  @return How to handle @a result: ADD, REJECT or REPLACE.
+     *  @return How to handle @a result: ADD, REJECT, REPLACE or
+     *		REPLACE_DROPPED.
      */
     collapse_result check_item(const std::vector<Result>& results,
 			       const Result& result,
@@ -192,15 +198,17 @@ class Collapser {
 
     /** Check a new result.
      *
-     *  If this method determines the action to take is NEW or ADD then the
-     *  proto-mset should be updated and then process() called to complete the
-     *  update (if the result doesn't actually get added, then it's OK not
-     *  to follow up with a call to process()).
+     *  If this method determines the action to take is NEW, ADD or
+     *  REPLACE_DROPPED then the proto-mset should be updated and then
+     *  process() called to complete the update (if the result doesn't
+     *  actually get added, then it's OK not to follow up with a call to
+     *  process()).
      *
      *  @param result	The new result.
      *  @param vsdoc	Document for getting values.
      *
-     *  @return How to handle @a result: EMPTY, NEW, ADD, REJECT or REPLACE.
+     *  @return How to handle @a result: EMPTY, NEW, ADD, REJECT, REPLACE or
+     *		REPLACE_DROPPED.
      */
     collapse_result check(Result& result,
 			  Xapian::Document::Internal & vsdoc);
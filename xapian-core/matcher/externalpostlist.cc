@@ -36,13 +36,19 @@ ExternalPostList::ExternalPostList(const Xapian::Database& db,
 				   EstimateOp* estimate_op,
 				   double factor_,
 				   bool* max_weight_cached_flag_ptr,
-				   Xapian::doccount shard_index)
+				   Xapian::doccount shard_index,
+				   bool docid_range)
     : current(0), factor(factor_)
 {
     Assert(source_);
     Xapian::PostingSource* newsource = source_->clone();
     if (newsource != NULL) {
 	source = newsource->release();
+    } else if (docid_range) {
+	// The matcher falls back to matching serially if it gets this.
+	throw Xapian::UnimplementedError("PostingSource subclass must "
+					 "implement clone() to support "
+					 "matching in parallel");
     } else if (shard_index == 0) {
 	// Allow use of a non-clone-able PostingSource with a non-sharded
 	// Database.
@@ -52,13 +52,18 @@ class ExternalPostList : public PostList {
      *  @param estimate_op		    Object to report min/est/max to.
      *  @param max_weight_cached_flag_ptr   Pointer to flag to clear when max
      *					    weight changes.
+     *  @param docid_range		    Are we matching a docid range of
+     *					    the shard (in which case other
+     *					    ranges may be being matched in
+     *					    parallel)?
      */
     ExternalPostList(const Xapian::Database & db,
 		     Xapian::PostingSource *source_,
 		     EstimateOp* estimate_op,
 		     double factor_,
 		     bool* max_weight_cached_flag_ptr,
-		     Xapian::doccount shard_index);
+		     Xapian::doccount shard_index,
+		     bool docid_range);
 
     Xapian::doccount get_termfreq() const;
 
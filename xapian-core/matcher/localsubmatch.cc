@@ -25,16 +25,20 @@
 
 #include "backends/databaseinternal.h"
 #include "backends/leafpostlist.h"
+#include "cachedfilterpostlist.h"
 #include "debuglog.h"
 #include "extraweightpostlist.h"
 #include "omassert.h"
+#include "pack.h"
 #include "queryoptimiser.h"
+#include "stdclamp.h"
 #include "synonympostlist.h"
 #include "api/termlist.h"
 #include "weight/weightinternal.h"
 
 #include "xapian/error.h"
 
+#include <algorithm>
 #include <memory>
 #include <map>
 #include <string>
@@ -171,6 +175,22 @@ LazyWeight::get_maxextra() const
     throw Xapian::InvalidOperationError("LazyWeight::get_maxextra()");
 }
 
+Estimates
+LocalSubMatch::scale_to_range(Estimates e) const
+{
+    Xapian::doccount range_size = range_last - range_first + 1;
+    // Matches outside our range can account for at most this many of those
+    // in the whole shard.
+    Xapian::doccount outside = min(db->get_doccount(),
+				   Xapian::doccount(used_span - range_size));
+    e.min = (e.min > outside ? e.min - outside : 0);
+    e.max = min(e.max, range_size);
+    // Assume the matches are spread evenly over the docids in use.
+    double est = e.est * (double(range_size) / used_span);
+    e.est = STD_CLAMP(Xapian::doccount(est + 0.5), e.min, e.max);
+    return e;
+}
+
 PostList *
 LocalSubMatch::get_postlist(PostListTree * matcher,
 			    Xapian::termcount * total_subqs_ptr)
@@ -315,3 +335,58 @@ LocalSubMatch::open_post_list(const string& term,
     add_op(pl->get_termfreq());
     RETURN(pl);
 }
+
+bool
+LocalSubMatch::open_cached_filter(const Xapian::Query& subquery,
+				  QueryOptimiser* qopt,
+				  PostList*& pl)
+{
+    LOGCALL(MATCH, bool, "LocalSubMatch::open_cached_filter", subquery | qopt);
+    // Filtering by MatchAll is already cheap.
+    if (!filter_cache || subquery.get_type() == Xapian::Query::LEAF_MATCH_ALL)
+	RETURN(false);
+
+    string key = db->get_cache_key();
+    if (key.empty())
+	RETURN(false);
+    try {
+	pack_string(key, subquery.serialise());
+    } catch (const Xapian::UnimplementedError&) {
+	// The subquery uses a PostingSource which can't be serialised.
+	RETURN(false);
+    }
+
+    bool build;
+    shared_ptr<const FilterDocidSet> docids = filter_cache->find(key, build);
+    if (!docids) {
+	if (!build)
+	    RETURN(false);
+
+	// Run the filter subquery over the whole shard (even if we're only
+	// matching a docid range of it) and store the matching docids.
+	vector<Xapian::docid> dids;
+	PostList* sub_pl = subquery.internal->postlist(qopt, 0.0);
+	if (sub_pl) {
+	    while (true) {
+		PostList* result = sub_pl->next(0.0);
+		if (result) {
+		    delete sub_pl;
+		    sub_pl = result;
+		}
+		if (sub_pl->at_end()) break;
+		dids.push_back(sub_pl->get_docid());
+	    }
+	    qopt->destroy_postlist(sub_pl);
+	}
+	docids = make_shared<const FilterDocidSet>(std::move(dids));
+	filter_cache->add(key, docids);
+    }
+
+    if (docids->size() == 0) {
+	pl = NULL;
+    } else {
+	add_op(docids->size());
+	pl = new CachedFilterPostList(docids);
+    }
+    RETURN(true);
+}
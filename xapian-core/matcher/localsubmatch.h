@@ -22,6 +22,7 @@
 #ifndef XAPIAN_INCLUDED_LOCALSUBMATCH_H
 #define XAPIAN_INCLUDED_LOCALSUBMATCH_H
 
+#include "api/filtercacheinternal.h"
 #include "api/queryinternal.h"
 #include "backends/databaseinternal.h"
 #include "estimateop.h"
@@ -76,18 +77,73 @@ class LocalSubMatch {
      */
     EstimateOp* estimate_stack = nullptr;
 
+    /** First docid of the range of the shard to match.
+     *
+     *  Zero means we're matching the whole shard.
+     */
+    Xapian::docid range_first = 0;
+
+    /// Last docid of the range of the shard to match.
+    Xapian::docid range_last = 0;
+
+    /// Size of the span of docids used in the shard.
+    Xapian::docid used_span = 0;
+
+    /** Upper bound on the number of matches in the whole shard.
+     *
+     *  Only set by resolve() when matching a docid range.
+     */
+    Xapian::doccount shard_upper_bound = 0;
+
+    /// Cache of the documents matching filter subqueries, or NULL.
+    Xapian::FilterCache::Internal* filter_cache = nullptr;
+
+    /// Minimum number of OP_OR subqueries to use WandPostList for.
+    size_t wand_min_subqueries;
+
+    /// Scale estimates for the whole shard to those for our docid range.
+    Estimates scale_to_range(Estimates e) const;
+
   public:
     /// Constructor.
     LocalSubMatch(const Xapian::Database::Internal* db_,
 		  const Xapian::Query& query_,
 		  Xapian::termcount qlen_,
 		  const Xapian::Weight& wt_factory_,
-		  Xapian::doccount shard_index_)
+		  Xapian::doccount shard_index_,
+		  size_t wand_min_subqueries_)
 	: total_stats(NULL), query(query_), qlen(qlen_), db(db_),
 	  wt_factory(wt_factory_),
-	  shard_index(shard_index_)
+	  shard_index(shard_index_),
+	  wand_min_subqueries(wand_min_subqueries_)
     {}
 
+    /** Construct to match a docid range of the same shard as @a o.
+     *
+     *  @param db_	Another instance of the shard @a o is for (at the same
+     *			revision) so the range can be matched in a different
+     *			thread to @a o and any other ranges.
+     *  @param first	First docid in the range.
+     *  @param last	Last docid in the range.
+     *  @param span	Size of the span of docids used in the shard.
+     */
+    LocalSubMatch(const LocalSubMatch& o,
+		  const Xapian::Database::Internal* db_,
+		  Xapian::docid first,
+		  Xapian::docid last,
+		  Xapian::docid span)
+	: total_stats(o.total_stats), query(o.query), qlen(o.qlen), db(db_),
+	  wt_factory(o.wt_factory),
+	  shard_index(o.shard_index),
+	  range_first(first), range_last(last), used_span(span),
+	  filter_cache(o.filter_cache),
+	  wand_min_subqueries(o.wand_min_subqueries)
+    {
+	AssertRel(first, >, 0);
+	AssertRel(first, <=, last);
+	AssertRel(last - first, <, span);
+    }
+
     ~LocalSubMatch() {
 	EstimateOp* p = estimate_stack;
 	while (p) {
@@ -120,7 +176,38 @@ class LocalSubMatch {
 	// We shortcut an empty shard and avoid creating a postlist tree for
 	// it so the estimate stack should be empty.
 	Assert(db_size);
-	return estimate_stack->resolve(db_size);
+	Estimates estimates = estimate_stack->resolve(db_size);
+	if (range_first) {
+	    shard_upper_bound = estimates.max;
+	    estimates = scale_to_range(estimates);
+	}
+	return estimates;
+    }
+
+    /// Set the cache of the documents matching filter subqueries.
+    void set_filter_cache(Xapian::FilterCache::Internal* filter_cache_) {
+	filter_cache = filter_cache_;
+    }
+
+    /// Minimum number of OP_OR subqueries to use WandPostList for.
+    size_t get_wand_min_subqueries() const { return wand_min_subqueries; }
+
+    /// Are we matching a docid range of the shard?
+    bool matching_docid_range() const { return range_first != 0; }
+
+    /// First docid of the range to match (0 if matching the whole shard).
+    Xapian::docid get_range_first() const { return range_first; }
+
+    /// Last docid of the range to match.
+    Xapian::docid get_range_last() const { return range_last; }
+
+    /** Upper bound on the number of matches in the whole shard.
+     *
+     *  Only valid after resolve() has been called, and only when matching a
+     *  docid range (the bounds resolve() returns are then for the range).
+     */
+    Xapian::doccount get_shard_upper_bound() const {
+	return shard_upper_bound;
     }
 
     /** Fetch and collate statistics.
@@ -165,6 +252,19 @@ class LocalSubMatch {
 			      Xapian::Internal::QueryOptimiser* qopt,
 			      bool lazy_weight);
 
+    /** Open a PostList for a filter subquery using the filter cache.
+     *
+     *  @param subquery	The filter subquery (which is unweighted).
+     *  @param qopt	The QueryOptimiser.
+     *  @param[out] pl	Set to the PostList, or NULL if the filter matches
+     *			nothing in this shard.
+     *
+     *  @return false if the filter isn't cached (and @a pl is unchanged).
+     */
+    bool open_cached_filter(const Xapian::Query& subquery,
+			    Xapian::Internal::QueryOptimiser* qopt,
+			    PostList*& pl);
+
     bool weight_needs_wdf() const {
 	return wt_factory.get_sumpart_needs_wdf_();
     }
@@ -25,11 +25,14 @@
 #include "api/enquireinternal.h"
 #include "api/msetinternal.h"
 #include "api/rsetinternal.h"
+#include "backends/backends.h"
 #include "backends/multi/multi_database.h"
 #include "deciderpostlist.h"
+#include "heap.h"
 #include "localsubmatch.h"
 #include "msetcmp.h"
 #include "omassert.h"
+#include "parseint.h"
 #include "postlisttree.h"
 #include "protomset.h"
 #include "spymaster.h"
@@ -44,8 +47,16 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
 #include <cerrno>
 #include <cfloat> // For DBL_EPSILON.
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <system_error>
+#include <thread>
 #include <vector>
 
 #ifdef HAVE_POLL_H
@@ -175,6 +186,31 @@ Matcher::for_all_remotes(Action action)
 }
 #endif
 
+/// Default minimum number of OP_OR subqueries to use WandPostList for.
+static constexpr size_t WAND_MIN_SUBQUERIES_DEFAULT = 8;
+
+/** Return the minimum number of subqueries for which OP_OR uses WandPostList.
+ *
+ *  The default can be overridden by setting XAPIAN_WAND_MIN_SUBQUERIES in the
+ *  environment - setting it to 0 disables use of WandPostList.
+ */
+static size_t
+wand_min_subqueries()
+{
+    size_t min_subqueries = WAND_MIN_SUBQUERIES_DEFAULT;
+    const char* p = getenv("XAPIAN_WAND_MIN_SUBQUERIES");
+    if (p && *p) {
+	if (!parse_unsigned(p, min_subqueries)) {
+	    throw Xapian::InvalidArgumentError("XAPIAN_WAND_MIN_SUBQUERIES "
+					       "must be a non-negative "
+					       "integer");
+	}
+	if (min_subqueries == 0)
+	    return numeric_limits<size_t>::max();
+    }
+    return min_subqueries;
+}
+
 Matcher::Matcher(const Xapian::Database& db_,
 		 const Xapian::Query& query_,
 		 Xapian::termcount query_length,
@@ -205,6 +241,9 @@ Matcher::Matcher(const Xapian::Database& db_,
 	subrsets.resize(n_shards);
     }
 
+    // Check this once here rather than each time OP_OR is optimised.
+    size_t wand_min = wand_min_subqueries();
+
     for (Xapian::doccount i = 0; i != n_shards; ++i) {
 	const Xapian::Database::Internal *subdb = db.internal.get();
 	if (n_shards > 1) {
@@ -248,7 +287,7 @@ Matcher::Matcher(const Xapian::Database& db_,
 	    locals.resize(i);
 	locals.emplace_back(new LocalSubMatch(subdb, query, query_length,
 					      wtscheme,
-					      i));
+					      i, wand_min));
 	subdb->readahead_for_query(query);
     }
 
@@ -312,53 +351,37 @@ Matcher::Matcher(const Xapian::Database& db_,
 #endif
 }
 
-Xapian::MSet
-Matcher::get_local_mset(Xapian::doccount first,
-			Xapian::doccount maxitems,
-			Xapian::doccount check_at_least,
-			const Xapian::Weight& wtscheme,
-			const Xapian::MatchDecider* mdecider,
-			const Xapian::KeyMaker* sorter,
-			Xapian::valueno collapse_key,
-			Xapian::doccount collapse_max,
-			int percent_threshold,
-			double percent_threshold_factor,
-			double weight_threshold,
-			Xapian::Enquire::docid_order order,
-			Xapian::valueno sort_key,
-			Xapian::Enquire::Internal::sort_setting sort_by,
-			bool sort_val_reverse,
-			double time_limit,
-			const vector<opt_ptr_spy>& matchspies)
+bool
+Matcher::build_local_postlists(PostListTree& pltree,
+			       ValueStreamDocument& vsdoc,
+			       vector<PostList*>& postlists,
+			       Xapian::termcount& total_subqs,
+			       Xapian::doccount shard,
+			       LocalSubMatch* range_submatch,
+			       const Xapian::MatchDecider* mdecider,
+			       Xapian::doccount check_at_least)
 {
-    Assert(!locals.empty());
-
-    ValueStreamDocument vsdoc(db);
-    ++vsdoc._refs;
-    Xapian::Document doc(&vsdoc);
-
-    vector<PostList*> postlists;
     postlists.reserve(locals.size());
-    PostListTree pltree(vsdoc, db, wtscheme);
-    Xapian::termcount total_subqs = 0;
     try {
 	bool all_null = true;
 	for (size_t i = 0; i != locals.size(); ++i) {
-	    if (!locals[i].get()) {
+	    if (!locals[i].get() || (shard != ALL_SHARDS && i != shard)) {
 		postlists.push_back(NULL);
 		continue;
 	    }
+	    LocalSubMatch* submatch = locals[i].get();
+	    if (range_submatch) submatch = range_submatch;
 	    // Pick the highest total subqueries answer amongst the
 	    // subdatabases, as the query to postlist conversion doesn't
 	    // recurse into positional queries for shards that don't have
 	    // positional data when at least one other shard does.
 	    Xapian::termcount total_subqs_i = 0;
-	    PostList* pl = locals[i]->get_postlist(&pltree, &total_subqs_i);
+	    PostList* pl = submatch->get_postlist(&pltree, &total_subqs_i);
 	    total_subqs = max(total_subqs, total_subqs_i);
 	    if (pl != NULL) {
 		all_null = false;
 		if (mdecider) {
-		    auto estimate_op = locals[i]->add_op(EstimateOp::DECIDER);
+		    auto estimate_op = submatch->add_op(EstimateOp::DECIDER);
 		    if (check_at_least) {
 			// No point creating the DeciderPostList if we aren't
 			// actually going to run the match.
@@ -372,19 +395,65 @@ Matcher::get_local_mset(Xapian::doccount first,
 	Assert(!postlists.empty());
 
 	if (all_null) {
-	    vector<Result> dummy;
-	    return Xapian::MSet(new Xapian::MSet::Internal(first, 0, 0, 0, 0,
-							   0, 0, 0.0, 0.0,
-							   std::move(dummy),
-							   0));
+	    return false;
 	}
     } catch (...) {
 	for (auto pl : postlists) delete pl;
 	throw;
     }
 
-    Xapian::doccount n_shards = postlists.size();
-    pltree.set_postlists(&postlists[0], n_shards);
+    pltree.set_postlists(&postlists[0], postlists.size());
+    if (range_submatch) {
+	pltree.set_docid_range(range_submatch->get_range_first(),
+			       range_submatch->get_range_last());
+    }
+    return true;
+}
+
+Xapian::MSet
+Matcher::run_local_match(PostListTree& pltree,
+			 ValueStreamDocument& vsdoc,
+			 Xapian::doccount shard,
+			 LocalSubMatch* range_submatch,
+			 Xapian::termcount total_subqs,
+			 Xapian::doccount first,
+			 Xapian::doccount maxitems,
+			 Xapian::doccount check_at_least,
+			 const Xapian::MatchDecider* mdecider,
+			 const Xapian::KeyMaker* sorter,
+			 Xapian::valueno collapse_key,
+			 Xapian::doccount collapse_max,
+			 int percent_threshold,
+			 double percent_threshold_factor,
+			 double weight_threshold,
+			 Xapian::Enquire::docid_order order,
+			 Xapian::valueno sort_key,
+			 Xapian::Enquire::Internal::sort_setting sort_by,
+			 bool sort_val_reverse,
+			 double time_limit,
+			 const vector<opt_ptr_spy>& matchspies,
+			 atomic<double>* shared_min_weight)
+{
+    Xapian::Document doc(&vsdoc);
+
+    // Sum the estimates from the shards this match covers.
+    auto resolve_estimates = [&](Xapian::doccount& matches_lower_bound,
+				 Xapian::doccount& matches_estimated,
+				 Xapian::doccount& matches_upper_bound) {
+	matches_lower_bound = 0;
+	matches_estimated = 0;
+	matches_upper_bound = 0;
+	for (size_t i = 0; i != locals.size(); ++i) {
+	    if (locals[i].get() && (shard == ALL_SHARDS || i == shard)) {
+		LocalSubMatch* submatch = locals[i].get();
+		if (range_submatch) submatch = range_submatch;
+		Estimates e = submatch->resolve();
+		matches_lower_bound += e.min;
+		matches_estimated += e.est;
+		matches_upper_bound += e.max;
+	    }
+	}
+    };
 
     // The highest weight a document could get in this match.
     const double max_possible = pltree.recalc_maxweight();
@@ -410,17 +479,12 @@ Matcher::get_local_mset(Xapian::doccount first,
 	// Explicitly delete all PostList objects so they report any stats to
 	// the EstimateOp objects.
 	pltree.delete_postlists();
-	Xapian::doccount matches_lower_bound = 0;
-	Xapian::doccount matches_estimated = 0;
-	Xapian::doccount matches_upper_bound = 0;
-	for (size_t i = 0; i != locals.size(); ++i) {
-	    if (locals[i].get()) {
-		Estimates e = locals[i]->resolve();
-		matches_lower_bound += e.min;
-		matches_estimated += e.est;
-		matches_upper_bound += e.max;
-	    }
-	}
+	Xapian::doccount matches_lower_bound;
+	Xapian::doccount matches_estimated;
+	Xapian::doccount matches_upper_bound;
+	resolve_estimates(matches_lower_bound,
+			  matches_estimated,
+			  matches_upper_bound);
 
 	if (mdecider) {
 	    matches_lower_bound = 0;
@@ -456,7 +520,7 @@ Matcher::get_local_mset(Xapian::doccount first,
 
     // Can we stop once the ProtoMSet is full?
     bool stop_once_full = (sort_forward &&
-			   n_shards == 1 &&
+			   locals.size() == 1 &&
 			   sort_by == DOCID);
 
     ProtoMSet proto_mset(first, maxitems, check_at_least,
@@ -469,8 +533,45 @@ Matcher::get_local_mset(Xapian::doccount first,
 			 time_limit);
     proto_mset.set_new_min_weight(weight_threshold);
 
+    // How many candidate documents to consider between checks of
+    // external_min_weight, which may involve a system call.  We don't check
+    // until this many have been considered, so small matches aren't affected
+    // by exactly when a threshold happens to arrive.  For larger matches the
+    // statistics behind the bounds and estimate do depend on when it arrives
+    // (though the bounds remain valid) - this is documented for
+    // Enquire::get_mset().
+    const unsigned EXTERNAL_MIN_WEIGHT_INTERVAL = 256;
+    ExternalMinWeight* external = shared_min_weight ? NULL : external_min_weight;
+    unsigned external_countdown = EXTERNAL_MIN_WEIGHT_INTERVAL;
+    double external_weight = 0.0;
+
     while (true) {
 	double min_weight = proto_mset.get_min_weight();
+	if (external) {
+	    if (external_countdown-- == 0) {
+		external_countdown = EXTERNAL_MIN_WEIGHT_INTERVAL;
+		external_weight = max(external_weight,
+				      external->get_min_weight());
+	    }
+	    if (external_weight > min_weight) {
+		min_weight = external_weight;
+		proto_mset.set_pruned_externally();
+	    }
+	}
+	if (shared_min_weight) {
+	    // Share our threshold with the other shards being matched in
+	    // parallel, or use theirs if it's higher.
+	    double shared = shared_min_weight->load(memory_order_relaxed);
+	    if (min_weight > shared) {
+		while (!shared_min_weight->compare_exchange_weak(
+			    shared, min_weight, memory_order_relaxed)) {
+		    if (shared >= min_weight) break;
+		}
+	    } else if (shared > min_weight) {
+		min_weight = shared;
+		proto_mset.set_pruned_externally();
+	    }
+	}
 	if (!pltree.next(min_weight)) {
 	    break;
 	}
@@ -529,17 +630,12 @@ Matcher::get_local_mset(Xapian::doccount first,
     // the EstimateOp objects.
     pltree.delete_postlists();
 
-    Xapian::doccount matches_lower_bound = 0;
-    Xapian::doccount matches_estimated = 0;
-    Xapian::doccount matches_upper_bound = 0;
-    for (size_t i = 0; i != locals.size(); ++i) {
-	if (locals[i].get()) {
-	    Estimates e = locals[i]->resolve();
-	    matches_lower_bound += e.min;
-	    matches_estimated += e.est;
-	    matches_upper_bound += e.max;
-	}
-    }
+    Xapian::doccount matches_lower_bound;
+    Xapian::doccount matches_estimated;
+    Xapian::doccount matches_upper_bound;
+    resolve_estimates(matches_lower_bound,
+		      matches_estimated,
+		      matches_upper_bound);
 
     return proto_mset.finalise(mdecider,
 			       matches_lower_bound,
@@ -547,6 +643,433 @@ Matcher::get_local_mset(Xapian::doccount first,
 			       matches_upper_bound);
 }
 
+Xapian::MSet
+Matcher::get_local_mset(Xapian::doccount first,
+			Xapian::doccount maxitems,
+			Xapian::doccount check_at_least,
+			const Xapian::Weight& wtscheme,
+			const Xapian::MatchDecider* mdecider,
+			const Xapian::KeyMaker* sorter,
+			Xapian::valueno collapse_key,
+			Xapian::doccount collapse_max,
+			int percent_threshold,
+			double percent_threshold_factor,
+			double weight_threshold,
+			Xapian::Enquire::docid_order order,
+			Xapian::valueno sort_key,
+			Xapian::Enquire::Internal::sort_setting sort_by,
+			bool sort_val_reverse,
+			double time_limit,
+			const vector<opt_ptr_spy>& matchspies)
+{
+    Assert(!locals.empty());
+
+    ValueStreamDocument vsdoc(db);
+    ++vsdoc._refs;
+
+    vector<PostList*> postlists;
+    PostListTree pltree(vsdoc, db, wtscheme);
+    Xapian::termcount total_subqs = 0;
+    if (!build_local_postlists(pltree, vsdoc, postlists, total_subqs,
+			       ALL_SHARDS, NULL, mdecider, check_at_least)) {
+	vector<Result> dummy;
+	return Xapian::MSet(new Xapian::MSet::Internal(first, 0, 0, 0, 0,
+						       0, 0, 0.0, 0.0,
+						       std::move(dummy),
+						       0));
+    }
+
+    return run_local_match(pltree, vsdoc, ALL_SHARDS, NULL, total_subqs,
+			   first, maxitems, check_at_least,
+			   mdecider, sorter, collapse_key, collapse_max,
+			   percent_threshold, percent_threshold_factor,
+			   weight_threshold, order, sort_key, sort_by,
+			   sort_val_reverse, time_limit, matchspies, NULL);
+}
+
+/// Default for the minimum number of documents in each docid range.
+static constexpr Xapian::doccount MATCH_RANGE_MIN_DOCS_DEFAULT = 100000;
+
+/** Return the minimum number of documents to match in each docid range.
+ *
+ *  The default can be overridden by setting XAPIAN_MATCH_RANGE_MIN_DOCS in
+ *  the environment - setting it to 0 disables splitting a shard into ranges.
+ */
+static Xapian::doccount
+match_range_min_docs()
+{
+    Xapian::doccount min_docs = MATCH_RANGE_MIN_DOCS_DEFAULT;
+    const char* p = getenv("XAPIAN_MATCH_RANGE_MIN_DOCS");
+    if (p && *p) {
+	if (!parse_unsigned(p, min_docs)) {
+	    throw Xapian::InvalidArgumentError("XAPIAN_MATCH_RANGE_MIN_DOCS "
+					       "must be a non-negative "
+					       "integer");
+	}
+	if (min_docs == 0)
+	    return Xapian::doccount(-1);
+    }
+    return min_docs;
+}
+
+/// The state for matching one shard, or a docid range of one, in parallel.
+struct ShardMatch {
+    /// The Database to match.
+    Xapian::Database db;
+
+    /** LocalSubMatch for a docid range (NULL if matching a whole shard).
+     *
+     *  This must be declared before postlists as deleting the PostList
+     *  objects reports stats to the EstimateOp objects this owns.
+     */
+    unique_ptr<LocalSubMatch> range_submatch;
+
+    ValueStreamDocument vsdoc;
+
+    // This must be declared before pltree, which deletes the PostList
+    // objects when it's destroyed.
+    vector<PostList*> postlists;
+
+    PostListTree pltree;
+
+    Xapian::termcount total_subqs = 0;
+
+    Xapian::doccount shard;
+
+    /// Clones of the MatchSpy objects for this match.
+    vector<Xapian::Internal::opt_intrusive_ptr<Xapian::MatchSpy>> spies;
+
+    Xapian::MSet mset;
+
+    exception_ptr error;
+
+    ShardMatch(const Xapian::Database& db_, const Xapian::Weight& wtscheme,
+	       Xapian::doccount shard_)
+	: db(db_), vsdoc(db), pltree(vsdoc, db, wtscheme), shard(shard_) {
+	++vsdoc._refs;
+    }
+};
+
+/** Set up to match a single shard as docid ranges in parallel.
+ *
+ *  A Database::Internal object can't be used from more than one thread at
+ *  once, so we use a separate instance of the shard for each range after
+ *  the first.
+ *
+ *  @param range_dbs	Instances of the shard kept from previous matches,
+ *			which are reused, reopened or added to as needed.
+ *
+ *  @return false if the shard can't usefully be split.
+ */
+static bool
+split_into_ranges(vector<unique_ptr<ShardMatch>>& jobs,
+		  const Xapian::Database& db,
+		  vector<Xapian::Database>& range_dbs,
+		  LocalSubMatch& submatch,
+		  unsigned match_threads,
+		  const Xapian::Weight& wtscheme)
+{
+    const Xapian::Database::Internal* shard_db = db.internal.get();
+    // A WritableDatabase may have changes which a new instance wouldn't see.
+    if (!shard_db->is_read_only())
+	return false;
+    int backend = shard_db->get_backend_info(NULL);
+    if (backend != BACKEND_GLASS && backend != BACKEND_HONEY) {
+	return false;
+    }
+
+    Xapian::docid first_used, last_used;
+    shard_db->get_used_docid_range(first_used, last_used);
+    if (first_used == 0)
+	return false;
+    Xapian::docid span = last_used - first_used + 1;
+    Xapian::doccount n_ranges = span / match_range_min_docs();
+    n_ranges = min(n_ranges, Xapian::doccount(match_threads));
+    if (n_ranges < 2)
+	return false;
+
+    Xapian::rev revision = shard_db->get_revision();
+    jobs.emplace_back(new ShardMatch(db, wtscheme, 0));
+    for (Xapian::doccount i = 1; i != n_ranges; ++i) {
+	try {
+	    if (i > range_dbs.size()) {
+		auto instance = shard_db->open_instance();
+		if (!instance) {
+		    n_ranges = i;
+		    break;
+		}
+		range_dbs.emplace_back(instance);
+	    }
+	    Xapian::Database& range_db = range_dbs[i - 1];
+	    if (range_db.internal->get_revision() != revision) {
+		// The database has been updated since one of us opened it.
+		(void)range_db.reopen();
+		if (range_db.internal->get_revision() != revision) {
+		    // We're not at the latest revision, so can't get another
+		    // instance at the same revision.
+		    n_ranges = i;
+		    break;
+		}
+	    }
+	    jobs.emplace_back(new ShardMatch(range_db, wtscheme, 0));
+	} catch (const Xapian::Error&) {
+	    // Just match in fewer ranges, and open this instance afresh next
+	    // time.
+	    range_dbs.resize(i - 1);
+	    n_ranges = i;
+	    break;
+	}
+    }
+    if (n_ranges < 2) {
+	jobs.clear();
+	return false;
+    }
+
+    for (Xapian::doccount i = 0; i != n_ranges; ++i) {
+	Xapian::docid first = first_used + Xapian::docid(uint64_t(span) * i /
+							 n_ranges);
+	Xapian::docid last = first_used +
+	    Xapian::docid(uint64_t(span) * (i + 1) / n_ranges) - 1;
+	ShardMatch& job = *jobs[i];
+	job.range_submatch.reset(
+	    new LocalSubMatch(submatch, job.db.internal.get(),
+			      first, last, span));
+    }
+    return true;
+}
+
+bool
+Matcher::get_local_msets(vector<Xapian::MSet>& msets,
+			 unsigned match_threads,
+			 Xapian::doccount first,
+			 Xapian::doccount maxitems,
+			 Xapian::doccount check_at_least,
+			 const Xapian::Weight& wtscheme,
+			 const Xapian::MatchDecider* mdecider,
+			 const Xapian::KeyMaker* sorter,
+			 Xapian::valueno collapse_key,
+			 Xapian::doccount collapse_max,
+			 int percent_threshold,
+			 double weight_threshold,
+			 Xapian::Enquire::docid_order order,
+			 Xapian::valueno sort_key,
+			 Xapian::Enquire::Internal::sort_setting sort_by,
+			 bool sort_val_reverse,
+			 double time_limit,
+			 const vector<opt_ptr_spy>& matchspies)
+{
+    // Everything up to actually running the matches happens on this thread,
+    // as creating the PostList trees touches objects shared between shards.
+    vector<unique_ptr<ShardMatch>> jobs;
+    bool ranges = (db.internal->size() == 1);
+    if (ranges) {
+	Assert(locals[0].get());
+	vector<Xapian::Database> tmp_range_dbs;
+	if (!split_into_ranges(jobs, db,
+			       range_dbs ? *range_dbs : tmp_range_dbs,
+			       *locals[0], match_threads, wtscheme))
+	    return false;
+    } else {
+	// A Database object can be added as a shard more than once, but the
+	// same shard can't be safely used from more than one thread at once.
+	auto multidb = static_cast<const MultiDatabase*>(db.internal.get());
+	vector<const Xapian::Database::Internal*> shard_dbs;
+	for (Xapian::doccount i = 0; i != locals.size(); ++i) {
+	    if (locals[i].get())
+		shard_dbs.push_back(multidb->shards[i]);
+	}
+	if (shard_dbs.size() < 2)
+	    return false;
+	sort(shard_dbs.begin(), shard_dbs.end());
+	if (adjacent_find(shard_dbs.begin(), shard_dbs.end()) !=
+	    shard_dbs.end()) {
+	    return false;
+	}
+
+	for (Xapian::doccount i = 0; i != locals.size(); ++i) {
+	    if (locals[i].get())
+		jobs.emplace_back(new ShardMatch(db, wtscheme, i));
+	}
+    }
+
+    for (auto&& job : jobs) {
+	try {
+	    for (auto&& spy : matchspies) {
+		job->spies.emplace_back(spy->clone()->release());
+	    }
+	} catch (const Xapian::UnimplementedError&) {
+	    // A MatchSpy doesn't support clone(), so we can't run in
+	    // parallel.  Nothing has been done to the shards yet, so the
+	    // caller can just fall back to a serial match.
+	    return false;
+	}
+    }
+
+    for (auto it = jobs.begin(); it != jobs.end(); ) {
+	ShardMatch& job = **it;
+	try {
+	    if (!build_local_postlists(job.pltree, job.vsdoc, job.postlists,
+				       job.total_subqs, job.shard,
+				       job.range_submatch.get(),
+				       mdecider, check_at_least)) {
+		// This shard can't match anything.
+		it = jobs.erase(it);
+		continue;
+	    }
+	} catch (const Xapian::UnimplementedError&) {
+	    // A PostingSource doesn't support clone().  When matching docid
+	    // ranges we've only used our own LocalSubMatch objects, so the
+	    // caller can still fall back to a serial match.
+	    if (ranges)
+		return false;
+	    throw;
+	}
+	++it;
+    }
+
+    // Sharing the threshold isn't valid when collapsing, as documents which
+    // make the MSet for one shard may be collapsed away by documents from
+    // another.
+    atomic<double> shared_min_weight(0.0);
+    atomic<double>* shared = collapse_max ? NULL : &shared_min_weight;
+
+    atomic<size_t> next_job(0);
+    auto worker = [&]() {
+	size_t j;
+	while ((j = next_job.fetch_add(1)) < jobs.size()) {
+	    ShardMatch& job = *jobs[j];
+	    try {
+		job.mset = run_local_match(job.pltree, job.vsdoc, job.shard,
+					   job.range_submatch.get(),
+					   job.total_subqs,
+					   first, maxitems, check_at_least,
+					   mdecider, sorter,
+					   collapse_key, collapse_max,
+					   percent_threshold, 0.0,
+					   weight_threshold, order,
+					   sort_key, sort_by, sort_val_reverse,
+					   time_limit, job.spies, shared);
+	    } catch (...) {
+		job.error = current_exception();
+	    }
+	}
+    };
+
+    vector<thread> threads;
+    size_t n_threads = min(size_t(match_threads), jobs.size());
+    if (n_threads > 1) {
+	threads.reserve(n_threads - 1);
+	try {
+	    while (threads.size() != n_threads - 1) {
+		threads.emplace_back(worker);
+	    }
+	} catch (const system_error&) {
+	    // Just use the threads we managed to start.
+	}
+    }
+    // This thread does its share of the work too.
+    worker();
+    for (auto&& t : threads) {
+	t.join();
+    }
+
+    for (auto&& job : jobs) {
+	if (job->error) {
+	    rethrow_exception(job->error);
+	}
+    }
+
+    if (ranges) {
+	// The upper bound for each range is only limited by the size of the
+	// range, so reduce them to total no more than the upper bound for the
+	// whole shard.
+	Xapian::doccount shard_upper_bound = 0;
+	Xapian::doccount total = 0;
+	Xapian::doccount total_uncollapsed = 0;
+	for (auto&& job : jobs) {
+	    shard_upper_bound =
+		max(shard_upper_bound,
+		    job->range_submatch->get_shard_upper_bound());
+	    total += job->mset.internal->matches_upper_bound;
+	    total_uncollapsed += job->mset.internal->uncollapsed_upper_bound;
+	}
+	for (auto&& job : jobs) {
+	    auto& mset_internal = *job->mset.internal;
+	    if (total > shard_upper_bound) {
+		auto& upper = mset_internal.matches_upper_bound;
+		Xapian::doccount limit = max(mset_internal.matches_lower_bound,
+					     mset_internal.matches_estimated);
+		Xapian::doccount reduce = min(total - shard_upper_bound,
+					      upper - limit);
+		upper -= reduce;
+		total -= reduce;
+	    }
+	    if (total_uncollapsed > shard_upper_bound) {
+		auto& upper = mset_internal.uncollapsed_upper_bound;
+		Xapian::doccount limit =
+		    max({mset_internal.uncollapsed_lower_bound,
+			 mset_internal.uncollapsed_estimated,
+			 mset_internal.matches_upper_bound});
+		Xapian::doccount reduce = min(total_uncollapsed -
+					      shard_upper_bound,
+					      upper - limit);
+		upper -= reduce;
+		total_uncollapsed -= reduce;
+	    }
+	}
+    }
+
+    for (auto&& job : jobs) {
+	for (size_t i = 0; i != matchspies.size(); ++i) {
+	    matchspies[i]->merge_results(job->spies[i]->serialise_results());
+	}
+	msets.push_back(std::move(job->mset));
+    }
+    return true;
+}
+
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+/** Track the weight a result needs to make the merged MSet.
+ *
+ *  When results are ordered primarily by weight, this is the weight of the
+ *  k-th best result seen so far from any shard.
+ */
+class MergeThreshold {
+    /// The number of results the merged MSet needs.
+    Xapian::doccount k;
+
+    /// Min-heap of the highest (up to) k weights seen so far.
+    vector<double> weights;
+
+  public:
+    explicit MergeThreshold(Xapian::doccount k_) : k(k_) {}
+
+    /// Note the weights of the results in an MSet.
+    void add(const Xapian::MSet& mset) {
+	for (auto i = mset.begin(); i != mset.end(); ++i) {
+	    double weight = i.get_weight();
+	    if (weights.size() < k) {
+		weights.push_back(weight);
+		Heap::push(weights.begin(), weights.end(), greater<double>());
+	    } else if (weight > weights.front()) {
+		weights.front() = weight;
+		Heap::replace(weights.begin(), weights.end(),
+			      greater<double>());
+	    } else {
+		// The results are in descending weight order.
+		break;
+	    }
+	}
+    }
+
+    /// The minimum weight needed (0.0 until we've seen k results).
+    double get_min_weight() const {
+	if (k == 0 || weights.size() < k) return 0.0;
+	return weights.front();
+    }
+};
+#endif
+
 Xapian::MSet
 Matcher::get_mset(Xapian::doccount first,
 		  Xapian::doccount maxitems,
@@ -564,6 +1087,7 @@ Matcher::get_mset(Xapian::doccount first,
 		  Xapian::Enquire::Internal::sort_setting sort_by,
 		  bool sort_val_reverse,
 		  double time_limit,
+		  unsigned match_threads,
 		  const vector<opt_intrusive_ptr<Xapian::MatchSpy>>& matchspies)
 {
     AssertRel(check_at_least, >=, first + maxitems);
@@ -606,56 +1130,117 @@ Matcher::get_mset(Xapian::doccount first,
 #endif
 
     Xapian::MSet local_mset;
+    // The MSet objects for each local shard if we matched them in parallel.
+    vector<Xapian::MSet> local_msets;
+    bool parallel = false;
     if (!locals.empty()) {
 	for (auto&& submatch : locals) {
 	    if (submatch.get())
 		submatch->start_match(stats);
 	}
 
-	Xapian::doccount local_first = first;
-	Xapian::doccount local_maxitems = maxitems;
-	double local_percent_threshold_factor = percent_threshold_factor;
-#ifdef XAPIAN_HAS_REMOTE_BACKEND
-	if (!remotes.empty()) {
-	    // We need to fetch the first "first" results too, as merging may
-	    // push those down into the part of the merged MSet we care about.
-	    local_first = 0;
-	    local_maxitems = first + maxitems;
-	    if (collapse_max != 0) {
-		// If collapsing we need to fetch all check_at_least items in
-		// order to satisfy the requirement that if there are <=
-		// check_at_least results then then estimated number of matches
-		// is exact.  FIXME: Can we avoid this for the local shard by
-		// making use of information in the Collapser?
-		AssertRel(check_at_least, >=, first + maxitems);
-		local_maxitems = check_at_least;
-	    }
-	    local_percent_threshold_factor = 0.0;
+	// If we're merging MSet objects we need to fetch the first "first"
+	// results too, as merging may push those down into the part of the
+	// merged MSet we care about.
+	Xapian::doccount merge_maxitems = first + maxitems;
+	if (collapse_max != 0) {
+	    // If collapsing we need to fetch all check_at_least items in
+	    // order to satisfy the requirement that if there are <=
+	    // check_at_least results then then estimated number of matches
+	    // is exact.  FIXME: Can we avoid this for the local shard by
+	    // making use of information in the Collapser?
+	    AssertRel(check_at_least, >=, first + maxitems);
+	    merge_maxitems = check_at_least;
 	}
+
+	// There's no point matching in parallel if check_at_least is 0 as we
+	// won't actually run the match.
+	if (match_threads > 1 && check_at_least > 0) {
+	    parallel = get_local_msets(local_msets, match_threads,
+				       0, merge_maxitems,
+				       check_at_least, wtscheme, mdecider,
+				       sorter, collapse_key, collapse_max,
+				       percent_threshold,
+				       weight_threshold, order, sort_key,
+				       sort_by, sort_val_reverse, time_limit,
+				       matchspies);
+	}
+
+	if (!parallel) {
+	    Xapian::doccount local_first = first;
+	    Xapian::doccount local_maxitems = maxitems;
+	    double local_percent_threshold_factor = percent_threshold_factor;
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+	    if (!remotes.empty()) {
+		local_first = 0;
+		local_maxitems = merge_maxitems;
+		local_percent_threshold_factor = 0.0;
+	    }
 #endif
-	local_mset = get_local_mset(local_first, local_maxitems, check_at_least,
-				    wtscheme, mdecider,
-				    sorter, collapse_key, collapse_max,
-				    percent_threshold,
-				    local_percent_threshold_factor,
-				    weight_threshold, order, sort_key, sort_by,
-				    sort_val_reverse, time_limit, matchspies);
+	    local_mset = get_local_mset(local_first, local_maxitems,
+					check_at_least, wtscheme, mdecider,
+					sorter, collapse_key, collapse_max,
+					percent_threshold,
+					local_percent_threshold_factor,
+					weight_threshold, order, sort_key,
+					sort_by, sort_val_reverse, time_limit,
+					matchspies);
+	}
     }
 
 #ifdef XAPIAN_HAS_REMOTE_BACKEND
-    if (remotes.empty()) {
+    if (remotes.empty() && !parallel) {
 	// Another easy case - only local databases.
 	return local_mset;
     }
+#else
+    if (!parallel) {
+	return local_mset;
+    }
+#endif
 
     // We need to merge MSet objects.  We only need the number of remote shards
     // + 1 if there are any local shards, so reserving n_shards may be more
     // than we need.
     vector<pair<Xapian::MSet, Xapian::doccount>> msets;
     Xapian::MSet merged_mset;
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+    // If results are ordered primarily by weight, we can tell remote shards
+    // which are still matching the weight a document needs to make the merged
+    // MSet so they can skip documents which can't.  We don't when collapsing
+    // (a document with a lower weight can make it if others are collapsed
+    // away) or if the caller wants more documents checked than are returned
+    // (as that's to get better estimates).
+    bool share_min_weight = (collapse_max == 0 &&
+			     check_at_least <= first + maxitems &&
+			     (sort_by == REL || sort_by == REL_VAL));
+    MergeThreshold merge_threshold(first + maxitems);
+    auto send_min_weight = [&]() {
+	double min_weight = merge_threshold.get_min_weight();
+	if (min_weight > 0.0) {
+	    for (auto&& submatch : remotes) {
+		submatch->send_min_weight(min_weight);
+	    }
+	}
+    };
+    if (share_min_weight && !locals.empty()) {
+	if (parallel) {
+	    for (auto&& shard_mset : local_msets) {
+		merge_threshold.add(shard_mset);
+	    }
+	} else {
+	    merge_threshold.add(local_mset);
+	}
+	send_min_weight();
+    }
+
     for_all_remotes(
 	[&](RemoteSubMatch* submatch) {
 	    Xapian::MSet remote_mset = submatch->get_mset(matchspies);
+	    if (share_min_weight) {
+		merge_threshold.add(remote_mset);
+		send_min_weight();
+	    }
 	    merged_mset.internal->merge_stats(remote_mset.internal.get(),
 					      collapse_max != 0);
 	    auto& merged_stats = merged_mset.internal->stats;
@@ -671,13 +1256,26 @@ Matcher::get_mset(Xapian::doccount first,
 						 db.internal->size());
 	    msets.push_back({remote_mset, 0});
 	});
+#endif
 
-    if (!locals.empty()) {
+    if (parallel) {
+	for (auto&& shard_mset : local_msets) {
+	    merged_mset.internal->merge_stats(shard_mset.internal.get(),
+					      collapse_max != 0);
+	    if (!shard_mset.empty())
+		msets.push_back({shard_mset, 0});
+	}
+    } else if (!locals.empty()) {
 	if (!local_mset.empty())
 	    msets.push_back({local_mset, 0});
 	merged_mset.internal->merge_stats(local_mset.internal.get(),
 					  collapse_max != 0);
-	merged_mset.internal->stats->merge(stats);
+    }
+    if (!locals.empty()) {
+	// If there are no remote shards then the caller will set the stats.
+	auto& merged_stats = merged_mset.internal->stats;
+	if (merged_stats.get())
+	    merged_stats->merge(stats);
     }
 
     if (merged_mset.internal->max_possible == 0.0) {
@@ -825,7 +1423,4 @@ Matcher::get_mset(Xapian::doccount first,
     }
 
     return merged_mset;
-#else
-    return local_mset;
-#endif
 }
@@ -33,6 +33,7 @@
 #include "xapian/database.h"
 #include "xapian/query.h"
 
+#include <atomic>
 #include <memory>
 #include <vector>
 
@@ -43,7 +44,29 @@ namespace Xapian {
     class Weight;
 }
 
+class PostList;
+class PostListTree;
+class ValueStreamDocument;
+
 class Matcher {
+  public:
+    /** Interface for supplying a minimum weight from outside the match.
+     *
+     *  The remote server uses this to apply thresholds which the client sends
+     *  while the match is running.
+     */
+    class ExternalMinWeight {
+      public:
+	virtual ~ExternalMinWeight() {}
+
+	/** Return the weight documents now need to reach (0.0 for none).
+	 *
+	 *  This is called periodically during the match.
+	 */
+	virtual double get_min_weight() = 0;
+    };
+
+  private:
     typedef Xapian::Internal::opt_intrusive_ptr<Xapian::MatchSpy> opt_ptr_spy;
 
     Xapian::Database db;
@@ -80,10 +103,72 @@ class Matcher {
 # endif
 #endif
 
+    /// Source of minimum weights from outside the match (NULL for none).
+    ExternalMinWeight* external_min_weight = NULL;
+
+    /** Other instances of the shard for matching docid ranges in parallel.
+     *
+     *  NULL if instances aren't kept between matches.
+     */
+    std::vector<Xapian::Database>* range_dbs = NULL;
+
+    /// Special value for the @a shard parameter meaning "all local shards".
+    static constexpr Xapian::doccount ALL_SHARDS = Xapian::doccount(-1);
+
     Matcher(const Matcher&) = delete;
 
     Matcher& operator=(const Matcher&) = delete;
 
+    /** Build the PostList tree for local shards.
+     *
+     *  @param shard		The shard to build for, or ALL_SHARDS.
+     *  @param range_submatch	LocalSubMatch for a docid range of the shard
+     *				to use instead of the shard's (or NULL).
+     *
+     *  @return false if no local shard can match anything.
+     */
+    bool build_local_postlists(PostListTree& pltree,
+			       ValueStreamDocument& vsdoc,
+			       std::vector<PostList*>& postlists,
+			       Xapian::termcount& total_subqs,
+			       Xapian::doccount shard,
+			       LocalSubMatch* range_submatch,
+			       const Xapian::MatchDecider* mdecider,
+			       Xapian::doccount check_at_least);
+
+    /** Run the match over a PostList tree from build_local_postlists().
+     *
+     *  @param shard		The shard the tree was built for, or
+     *				ALL_SHARDS.
+     *  @param range_submatch	LocalSubMatch the tree was built with when
+     *				matching a docid range (or NULL).
+     *  @param shared_min_weight	Minimum weight threshold shared with
+     *				matches running in parallel on other shards
+     *				(NULL if not matching in parallel).
+     */
+    Xapian::MSet run_local_match(PostListTree& pltree,
+				 ValueStreamDocument& vsdoc,
+				 Xapian::doccount shard,
+				 LocalSubMatch* range_submatch,
+				 Xapian::termcount total_subqs,
+				 Xapian::doccount first,
+				 Xapian::doccount maxitems,
+				 Xapian::doccount check_at_least,
+				 const Xapian::MatchDecider* mdecider,
+				 const Xapian::KeyMaker* sorter,
+				 Xapian::valueno collapse_key,
+				 Xapian::doccount collapse_max,
+				 int percent_threshold,
+				 double percent_threshold_factor,
+				 double weight_threshold,
+				 Xapian::Enquire::docid_order order,
+				 Xapian::valueno sort_key,
+				 Xapian::Enquire::Internal::sort_setting sort_by,
+				 bool sort_val_reverse,
+				 double time_limit,
+				 const std::vector<opt_ptr_spy>& matchspies,
+				 std::atomic<double>* shared_min_weight);
+
     Xapian::MSet get_local_mset(Xapian::doccount first,
 				Xapian::doccount maxitems,
 				Xapian::doccount check_at_least,
@@ -102,6 +187,40 @@ class Matcher {
 				double time_limit,
 				const std::vector<opt_ptr_spy>& matchspies);
 
+    /** Match the local shards in parallel.
+     *
+     *  Each local shard is matched separately using up to @a match_threads
+     *  threads, with the shards sharing their minimum weight threshold.  If
+     *  there's only one shard, it is instead split into docid ranges which
+     *  are matched in the same way.
+     *
+     *  @param msets	The MSet for each local shard (or docid range) which
+     *			could match anything is appended to this.
+     *
+     *  @return false if the shards can't be matched in parallel (because a
+     *		MatchSpy or PostingSource doesn't support clone(), the same
+     *		shard appears more than once, or a single shard can't be
+     *		usefully split), in which case nothing has been done.
+     */
+    bool get_local_msets(std::vector<Xapian::MSet>& msets,
+			 unsigned match_threads,
+			 Xapian::doccount first,
+			 Xapian::doccount maxitems,
+			 Xapian::doccount check_at_least,
+			 const Xapian::Weight& wtscheme,
+			 const Xapian::MatchDecider* mdecider,
+			 const Xapian::KeyMaker* sorter,
+			 Xapian::valueno collapse_key,
+			 Xapian::doccount collapse_max,
+			 int percent_threshold,
+			 double weight_threshold,
+			 Xapian::Enquire::docid_order order,
+			 Xapian::valueno sort_key,
+			 Xapian::Enquire::Internal::sort_setting sort_by,
+			 bool sort_val_reverse,
+			 double time_limit,
+			 const std::vector<opt_ptr_spy>& matchspies);
+
     /// Perform action on remotes as they become ready using poll() or select().
     template<typename Action> void for_all_remotes(Action action);
 
@@ -147,6 +266,34 @@ class Matcher {
 	    double time_limit,
 	    const std::vector<opt_ptr_spy>& matchspies);
 
+    /** Set a source of minimum weights from outside the match.
+     *
+     *  This is only consulted when matching serially.
+     */
+    void set_external_min_weight(ExternalMinWeight* source) {
+	external_min_weight = source;
+    }
+
+    /** Set where to keep instances of the shard for matching docid ranges.
+     *
+     *  Opening a shard is relatively expensive, so by keeping the vector
+     *  between matches the instances only need opening once, and reopening
+     *  if the database is updated.
+     */
+    void set_range_databases(std::vector<Xapian::Database>* dbs) {
+	range_dbs = dbs;
+    }
+
+    /** Set the cache of the documents matching filter subqueries.
+     *
+     *  This is used for local shards only.
+     */
+    void set_filter_cache(Xapian::FilterCache::Internal* filter_cache) {
+	for (auto&& submatch : locals) {
+	    if (submatch) submatch->set_filter_cache(filter_cache);
+	}
+    }
+
     /** Run the match and produce an MSet object.
      *
      *  @param first		Zero-based index of the first result to return
@@ -181,6 +328,8 @@ class Matcher {
      *  @param sort_val_reverse	Reverse direction keys sort in?
      *  @param time_limit	time in seconds after which to disable
      *				check_at_least (0.0 means don't).
+     *  @param match_threads	Number of threads to use to match local shards
+     *				in parallel (0 or 1 means don't).
      *  @param matchspies	MatchSpy objects to use
      */
     Xapian::MSet get_mset(Xapian::doccount first,
@@ -199,6 +348,7 @@ class Matcher {
 			  Xapian::Enquire::Internal::sort_setting sort_by,
 			  bool sort_val_reverse,
 			  double time_limit,
+			  unsigned match_threads,
 			  const std::vector<opt_ptr_spy>& matchspies);
 };
 
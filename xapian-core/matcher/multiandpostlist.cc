@@ -22,9 +22,12 @@
 #include <config.h>
 
 #include "multiandpostlist.h"
+#include "backends/docidsearch.h"
 #include "omassert.h"
 #include "debuglog.h"
 
+#include <cstdlib>
+
 using namespace std;
 
 void
@@ -142,6 +145,13 @@ MultiAndPostList::recalc_maxweight()
     return max_total;
 }
 
+bool
+MultiAndPostList::docid_blocks_enabled()
+{
+    const char* p = getenv("XAPIAN_AND_DOCID_BLOCKS");
+    return p && p[0] == '1' && p[1] == '\0';
+}
+
 PostList *
 MultiAndPostList::find_next_match(double w_min)
 {
@@ -151,22 +161,54 @@ advanced_plist0:
 	return NULL;
     }
     did = plist[0]->get_docid();
-    for (size_t i = 1; i < n_kids; ++i) {
-	bool valid;
-	check_helper(i, did, w_min, valid);
-	if (!valid) {
-	    next_helper(0, w_min);
-	    goto advanced_plist0;
-	}
-	if (plist[i]->at_end()) {
-	    did = 0;
-	    return NULL;
-	}
-	Xapian::docid new_did = plist[i]->get_docid();
-	if (new_did != did) {
+    {
+	// If plist[0] has a block of decoded docids we can leapfrog through
+	// it without moving plist[0], in which case this is set to true and
+	// we need to skip plist[0] to did once we've found a match.
+	bool plist0_behind = false;
+try_did:
+	for (size_t i = 1; i < n_kids; ++i) {
+	    Xapian::docid new_did;
+	    const Xapian::docid* block_end;
+	    const Xapian::docid* block = NULL;
+	    if (use_docid_blocks) block = plist[i]->get_docid_block(block_end);
+	    if (block && block_end[-1] >= did) {
+		// We can see where skip_to() would move plist[i] to without
+		// actually moving it.
+		const Xapian::docid* p = find_docid_ge(block, block_end, did);
+		if (*p == did) {
+		    if (p != block) skip_to_helper(i, did, w_min);
+		    continue;
+		}
+		new_did = *p;
+	    } else {
+		bool valid;
+		check_helper(i, did, w_min, valid);
+		if (!valid) {
+		    if (plist0_behind) skip_to_helper(0, did, w_min);
+		    next_helper(0, w_min);
+		    goto advanced_plist0;
+		}
+		if (plist[i]->at_end()) {
+		    did = 0;
+		    return NULL;
+		}
+		new_did = plist[i]->get_docid();
+		if (new_did == did) continue;
+	    }
+
+	    // There's no match at did, so advance plist[0] to new_did.
+	    block = NULL;
+	    if (use_docid_blocks) block = plist[0]->get_docid_block(block_end);
+	    if (block && block_end[-1] >= new_did) {
+		did = *find_docid_ge(block, block_end, new_did);
+		plist0_behind = true;
+		goto try_did;
+	    }
 	    skip_to_helper(0, new_did, w_min);
 	    goto advanced_plist0;
 	}
+	if (plist0_behind) skip_to_helper(0, did, w_min);
     }
     return NULL;
 }
@@ -66,6 +66,19 @@ class MultiAndPostList : public PostList {
     /// Pointer to the matcher object, so we can report pruning.
     PostListTree *matcher;
 
+    /** Use sub-postlists' decoded blocks of docids to find matches?
+     *
+     *  See PostList::get_docid_block().
+     */
+    bool use_docid_blocks;
+
+    /** Should decoded blocks of docids be used?
+     *
+     *  Only if XAPIAN_AND_DOCID_BLOCKS is set to 1 in the environment, as
+     *  this hasn't been found to be faster in general.
+     */
+    static bool docid_blocks_enabled();
+
     /// Calculate the new minimum weight for sub-postlist n.
     double new_min(double w_min, size_t n) {
 	return w_min - (max_total - max_wt[n]);
@@ -122,7 +135,8 @@ class MultiAndPostList : public PostList {
     MultiAndPostList(RandomItor pl_begin, RandomItor pl_end,
 		     PostListTree * matcher_, Xapian::doccount db_size_)
 	: did(0), n_kids(pl_end - pl_begin), plist(NULL), max_wt(NULL),
-	  max_total(0), db_size(db_size_), matcher(matcher_)
+	  max_total(0), db_size(db_size_), matcher(matcher_),
+	  use_docid_blocks(docid_blocks_enabled())
     {
 	allocate_plist_and_max_wt();
 
@@ -138,7 +152,8 @@ class MultiAndPostList : public PostList {
 		     double lmax, double rmax,
 		     PostListTree * matcher_, Xapian::doccount db_size_)
 	: did(0), n_kids(2), plist(NULL), max_wt(NULL),
-	  max_total(lmax + rmax), db_size(db_size_), matcher(matcher_)
+	  max_total(lmax + rmax), db_size(db_size_), matcher(matcher_),
+	  use_docid_blocks(docid_blocks_enabled())
     {
 	// Even if we're the decay product of an OrPostList, we may want to
 	// swap here, as the subqueries may also have decayed and so their
@@ -63,6 +63,21 @@ class PostListTree {
 
     Xapian::Database::Internal* shard_db = nullptr;
 
+    /** Docid to skip to to start the match.
+     *
+     *  Zero if we're not matching a docid range, or once we've started.
+     */
+    Xapian::docid range_first = 0;
+
+    /// Last docid to match.
+    Xapian::docid range_last = Xapian::docid(-1);
+
+    /// Check if the current document is within our docid range.
+    bool in_range() const {
+	return usual(range_last == Xapian::docid(-1)) ||
+	       pl->get_docid() <= range_last;
+    }
+
   public:
     PostListTree(ValueStreamDocument& vsdoc_,
 		 Xapian::Database& db_,
@@ -108,6 +123,17 @@ class PostListTree {
 	    vsdoc.new_shard(current_shard);
     }
 
+    /** Only match documents with docids in [first, last].
+     *
+     *  Only supported for a single shard, and must be called before the
+     *  match is started.
+     */
+    void set_docid_range(Xapian::docid first, Xapian::docid last) {
+	AssertEq(n_shards, 1);
+	range_first = first;
+	range_last = last;
+    }
+
     double recalc_maxweight() {
 	if (!use_cached_max_weight) {
 	    use_cached_max_weight = true;
@@ -148,7 +174,14 @@ class PostListTree {
 	}
 
 	while (true) {
-	    PostList* result = pl->next(w_min);
+	    PostList* result;
+	    if (rare(range_first)) {
+		// Start at the beginning of our docid range.
+		result = pl->skip_to(range_first, w_min);
+		range_first = 0;
+	    } else {
+		result = pl->next(w_min);
+	    }
 	    if (rare(result)) {
 		delete pl;
 		shard_pls[current_shard] = pl = result;
@@ -160,11 +193,11 @@ class PostListTree {
 			    return false;
 			}
 		    }
-		    return true;
+		    return in_range();
 		}
 	    } else {
 		if (usual(!pl->at_end())) {
-		    return true;
+		    return in_range();
 		}
 	    }
 
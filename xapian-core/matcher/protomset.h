@@ -127,6 +127,13 @@ class ProtoMSet {
 
     bool stop_once_full;
 
+    /** Has the match been pruned using a threshold from elsewhere?
+     *
+     *  If so, we can't assume we've seen every match just because we
+     *  didn't fill up.
+     */
+    bool pruned_externally = false;
+
     TimeOut timeout;
 
   public:
@@ -171,6 +178,13 @@ class ProtoMSet {
 
     double get_min_weight() const { return min_weight; }
 
+    /** Note the match was pruned using a threshold from elsewhere.
+     *
+     *  This happens when matching shards in parallel, or when the client of a
+     *  remote server sends it a threshold.
+     */
+    void set_pruned_externally() { pruned_externally = true; }
+
     void update_max_weight(double weight) {
 	if (weight <= max_weight)
 	    return;
@@ -494,7 +508,7 @@ class ProtoMSet {
 	Xapian::doccount uncollapsed_estimated = matches_estimated;
 	Xapian::doccount uncollapsed_upper_bound = matches_upper_bound;
 
-	if (!full()) {
+	if (!full() && !pruned_externally) {
 	    // We didn't get all the results requested, so we know that we've
 	    // got all there are, and the bounds and estimate are all equal to
 	    // that number.
@@ -509,7 +523,8 @@ class ProtoMSet {
 	    } else {
 		AssertRel(matches_estimated, <=, known_matching_docs);
 	    }
-	} else if (!collapser && known_matching_docs < check_at_least) {
+	} else if (!collapser && !pruned_externally &&
+		   known_matching_docs < check_at_least) {
 	    // Similar to the above, but based on known_matching_docs.
 	    matches_lower_bound = known_matching_docs;
 	    matches_estimated = matches_lower_bound;
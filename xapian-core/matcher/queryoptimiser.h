@@ -117,6 +117,26 @@ class QueryOptimiser {
 						   wdf_disjoint);
     }
 
+    /** Open a PostList for a filter subquery using the filter cache.
+     *
+     *  @return false if the filter isn't cached (and @a pl is unchanged).
+     */
+    bool open_cached_filter(const Xapian::Query& subquery, PostList*& pl) {
+	// The cache only stores docids, not positions or wdf.
+	if (need_positions || compound_weight) return false;
+	return localsubmatch.open_cached_filter(subquery, this, pl);
+    }
+
+    /// Minimum number of OP_OR subqueries to use WandPostList for.
+    size_t get_wand_min_subqueries() const {
+	return localsubmatch.get_wand_min_subqueries();
+    }
+
+    /// Are we matching a docid range of the shard?
+    bool matching_docid_range() const {
+	return localsubmatch.matching_docid_range();
+    }
+
     const LeafPostList * get_hint_postlist() const { return hint; }
 
     void set_hint_postlist(LeafPostList * new_hint) {
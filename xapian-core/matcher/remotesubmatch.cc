@@ -47,4 +47,16 @@ RemoteSubMatch::start_match(Xapian::doccount first,
 {
     LOGCALL_VOID(MATCH, "RemoteSubMatch::start_match", first | maxitems | check_at_least | sorter | total_stats);
     db->send_global_stats(first, maxitems, check_at_least, sorter, total_stats);
+    matching = true;
+    sent_min_weight = 0.0;
+}
+
+void
+RemoteSubMatch::send_min_weight(double min_weight)
+{
+    LOGCALL_VOID(MATCH, "RemoteSubMatch::send_min_weight", min_weight);
+    if (!matching || min_weight <= sent_min_weight)
+	return;
+    db->send_min_weight(min_weight);
+    sent_min_weight = min_weight;
 }
@@ -43,6 +43,12 @@ class RemoteSubMatch {
     /// Index of this subdatabase.
     Xapian::doccount shard;
 
+    /// Is the server running a match we've not fetched the results of?
+    bool matching = false;
+
+    /// The highest minimum weight sent to the server for this match.
+    double sent_min_weight = 0.0;
+
   public:
     /// Constructor.
     RemoteSubMatch(const RemoteDatabase* db_, Xapian::doccount shard_)
@@ -83,9 +89,19 @@ class RemoteSubMatch {
      *  @param matchspies   The matchspies to use.
      */
     Xapian::MSet get_mset(const std::vector<opt_ptr_spy>& matchspies) {
+	matching = false;
 	return db->get_mset(matchspies);
     }
 
+    /** Tell the server the weight documents need to make the merged MSet.
+     *
+     *  This does nothing if we've already fetched the MSet, or already sent
+     *  a weight at least as high.
+     *
+     *  @param min_weight	The minimum weight.
+     */
+    void send_min_weight(double min_weight);
+
     /// Return the index of the corresponding Database shard.
     Xapian::doccount get_shard() const { return shard; }
 };
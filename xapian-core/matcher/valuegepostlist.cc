@@ -35,11 +35,11 @@ ValueGePostList::next(double)
 {
     Assert(db);
     if (!valuelist) valuelist = db->open_value_list(slot);
-    valuelist->next();
+    valuelist->next_in_range(begin, NULL);
     while (!valuelist->at_end()) {
 	const string & v = valuelist->get_value();
 	if (v >= begin) return NULL;
-	valuelist->next();
+	valuelist->next_in_range(begin, NULL);
     }
     db = NULL;
     return NULL;
@@ -50,11 +50,11 @@ ValueGePostList::skip_to(Xapian::docid did, double)
 {
     Assert(db);
     if (!valuelist) valuelist = db->open_value_list(slot);
-    valuelist->skip_to(did);
+    valuelist->skip_to_in_range(did, begin, NULL);
     while (!valuelist->at_end()) {
 	const string & v = valuelist->get_value();
 	if (v >= begin) return NULL;
-	valuelist->next();
+	valuelist->next_in_range(begin, NULL);
     }
     db = NULL;
     return NULL;
@@ -97,13 +97,13 @@ ValueRangePostList::next(double)
 {
     Assert(db);
     if (!valuelist) valuelist = db->open_value_list(slot);
-    valuelist->next();
+    valuelist->next_in_range(begin, &end);
     while (!valuelist->at_end()) {
 	const string & v = valuelist->get_value();
 	if (v >= begin && v <= end) {
 	    return NULL;
 	}
-	valuelist->next();
+	valuelist->next_in_range(begin, &end);
     }
     db = NULL;
     return NULL;
@@ -114,13 +114,13 @@ ValueRangePostList::skip_to(Xapian::docid did, double)
 {
     Assert(db);
     if (!valuelist) valuelist = db->open_value_list(slot);
-    valuelist->skip_to(did);
+    valuelist->skip_to_in_range(did, begin, &end);
     while (!valuelist->at_end()) {
 	const string & v = valuelist->get_value();
 	if (v >= begin && v <= end) {
 	    return NULL;
 	}
-	valuelist->next();
+	valuelist->next_in_range(begin, &end);
     }
     db = NULL;
     return NULL;
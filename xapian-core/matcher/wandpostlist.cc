@@ -0,0 +1,385 @@
+/** @file
+ * @brief N-way OR postlist using Block-Max WAND
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "wandpostlist.h"
+
+#include "omassert.h"
+
+#include <algorithm>
+
+using namespace std;
+
+WandPostList::~WandPostList()
+{
+    for (auto&& sub : plist) {
+	delete sub.pl;
+    }
+}
+
+void
+WandPostList::advance(size_t i, Xapian::docid target, double w_min)
+{
+    SubPostList& sub = plist[i];
+    // The weight this sub-postlist needs to contribute for the total to be
+    // able to reach w_min.
+    double w_min_sub = w_min - (max_total - sub.max_wt);
+    PostList* res;
+    if (target) {
+	res = sub.pl->skip_to(target, w_min_sub);
+    } else {
+	res = sub.pl->next(w_min_sub);
+    }
+    if (res) {
+	delete sub.pl;
+	sub.pl = res;
+	sub.block_last = 0;
+	matcher->force_recalc();
+    }
+
+    if (sub.pl->at_end()) {
+	delete sub.pl;
+	sub.pl = NULL;
+	return;
+    }
+
+    sub.did = sub.pl->get_docid();
+}
+
+void
+WandPostList::remove_finished()
+{
+    auto finished = [](const SubPostList& sub) { return sub.pl == NULL; };
+    auto new_end = remove_if(plist.begin(), plist.end(), finished);
+    if (new_end == plist.end())
+	return;
+
+    plist.erase(new_end, plist.end());
+    max_total = 0;
+    for (auto&& sub : plist) {
+	max_total += sub.max_wt;
+    }
+    matcher->force_recalc();
+}
+
+void
+WandPostList::sort_plist()
+{
+    // Only a few entries will typically have moved, so an insertion sort is
+    // a good choice here.
+    for (size_t i = 1; i < plist.size(); ++i) {
+	if (plist[i].did >= plist[i - 1].did)
+	    continue;
+	SubPostList tmp = plist[i];
+	size_t j = i;
+	do {
+	    plist[j] = plist[j - 1];
+	} while (--j != 0 && plist[j - 1].did > tmp.did);
+	plist[j] = tmp;
+    }
+}
+
+double
+WandPostList::block_bound(size_t i, Xapian::docid pivot, Xapian::docid& limit)
+{
+    SubPostList& sub = plist[i];
+    if (sub.block_last < sub.did) {
+	// We've moved on from the block we last looked at.
+	sub.block_max = sub.pl->get_block_maxweight(sub.block_last);
+    }
+
+    // If the current block ends before the pivot then we don't know anything
+    // about the block the pivot is in.
+    if (sub.block_last < pivot || sub.block_max >= sub.max_wt)
+	return sub.max_wt;
+
+    // The block bound only applies up to the end of the block.
+    limit = min(limit, sub.block_last);
+    return sub.block_max;
+}
+
+void
+WandPostList::set_at_end()
+{
+    for (auto&& sub : plist) {
+	delete sub.pl;
+    }
+    plist.clear();
+    max_total = 0;
+    did = 0;
+}
+
+PostList*
+WandPostList::find_next(double w_min)
+{
+    while (true) {
+	remove_finished();
+	if (plist.size() <= 1) {
+	    if (plist.empty()) {
+		did = 0;
+		return NULL;
+	    }
+	    // Prune to the single remaining sub-postlist.
+	    PostList* result = plist[0].pl;
+	    plist.clear();
+	    return result;
+	}
+
+	sort_plist();
+
+	// Find the pivot - the first sub-postlist at which the sum of the
+	// maximum weights of the sub-postlists so far reaches w_min.  No
+	// document before the pivot's docid can reach w_min.
+	double max_sum = 0.0;
+	size_t p = 0;
+	while (true) {
+	    max_sum += plist[p].max_wt;
+	    if (max_sum >= w_min)
+		break;
+	    if (++p == plist.size()) {
+		// Even a document matching every sub-postlist can't reach
+		// w_min.
+		set_at_end();
+		return NULL;
+	    }
+	}
+	Xapian::docid pivot = plist[p].did;
+
+	// Include any other sub-postlists positioned on the pivot.
+	size_t end = p + 1;
+	while (end != plist.size() && plist[end].did == pivot)
+	    ++end;
+
+	if (w_min > 0.0) {
+	    // Documents up to limit can only match sub-postlists [0, end), so
+	    // if the per-block bounds for those show that w_min can't be
+	    // reached then we can skip everything up to limit.
+	    Xapian::docid limit = Xapian::docid(-1);
+	    if (end != plist.size())
+		limit = plist[end].did - 1;
+	    double bound = 0.0;
+	    for (size_t i = 0; i != end; ++i) {
+		bound += block_bound(i, pivot, limit);
+	    }
+	    if (bound < w_min) {
+		if (limit == Xapian::docid(-1)) {
+		    set_at_end();
+		    return NULL;
+		}
+		for (size_t i = 0; i != end; ++i) {
+		    advance(i, limit + 1, w_min);
+		}
+		continue;
+	    }
+	}
+
+	if (plist[0].did == pivot) {
+	    did = pivot;
+	    return NULL;
+	}
+
+	// Move the sub-postlists before the pivot up to it.
+	for (size_t i = 0; plist[i].did < pivot; ++i) {
+	    advance(i, pivot, w_min);
+	}
+    }
+}
+
+Xapian::doccount
+WandPostList::get_termfreq() const
+{
+    // We shortcut an empty shard and avoid creating a postlist tree for it.
+    Assert(db_size);
+
+    // Finished sub-postlists are removed, so there may be none left.
+    if (plist.empty()) return 0;
+
+    // We calculate the estimate assuming independence.  The simplest
+    // way to calculate this seems to be a series of (n_kids - 1) pairwise
+    // calculations, which gives the same answer regardless of the order.
+    double scale = 1.0 / db_size;
+    double P_est = plist[0].pl->get_termfreq() * scale;
+    for (size_t i = 1; i < plist.size(); ++i) {
+	double P_i = plist[i].pl->get_termfreq() * scale;
+	P_est += P_i - P_est * P_i;
+    }
+    return static_cast<Xapian::doccount>(P_est * db_size + 0.5);
+}
+
+TermFreqs
+WandPostList::get_termfreq_est_using_stats(
+	const Xapian::Weight::Internal& stats) const
+{
+    if (plist.empty()) return TermFreqs();
+
+    // We calculate the estimate assuming independence.  The simplest
+    // way to calculate this seems to be a series of (n_kids - 1) pairwise
+    // calculations, which gives the same answer regardless of the order.
+    TermFreqs freqs(plist[0].pl->get_termfreq_est_using_stats(stats));
+
+    // Our caller should have ensured this.
+    Assert(stats.collection_size);
+    double scale = 1.0 / stats.collection_size;
+    double P_est = freqs.termfreq * scale;
+    double rtf_scale = 0.0;
+    if (stats.rset_size != 0) {
+	rtf_scale = 1.0 / stats.rset_size;
+    }
+    double Pr_est = freqs.reltermfreq * rtf_scale;
+    // If total_length is 0, cf must always be 0 so cf_scale is irrelevant.
+    double cf_scale = 0.0;
+    if (usual(stats.total_length != 0)) {
+	cf_scale = 1.0 / stats.total_length;
+    }
+    double Pc_est = freqs.collfreq * cf_scale;
+
+    for (size_t i = 1; i < plist.size(); ++i) {
+	freqs = plist[i].pl->get_termfreq_est_using_stats(stats);
+	double P_i = freqs.termfreq * scale;
+	P_est += P_i - P_est * P_i;
+	double Pc_i = freqs.collfreq * cf_scale;
+	Pc_est += Pc_i - Pc_est * Pc_i;
+	// If the rset is empty, Pr_est should be 0 already, so leave
+	// it alone.
+	if (stats.rset_size != 0) {
+	    double Pr_i = freqs.reltermfreq * rtf_scale;
+	    Pr_est += Pr_i - Pr_est * Pr_i;
+	}
+    }
+    return TermFreqs(Xapian::doccount(P_est * stats.collection_size + 0.5),
+		     Xapian::doccount(Pr_est * stats.rset_size + 0.5),
+		     Xapian::termcount(Pc_est * stats.total_length + 0.5));
+}
+
+Xapian::docid
+WandPostList::get_docid() const
+{
+    return did;
+}
+
+double
+WandPostList::get_weight(Xapian::termcount doclen,
+			 Xapian::termcount unique_terms,
+			 Xapian::termcount wdfdocmax) const
+{
+    Assert(did);
+    double result = 0.0;
+    // The sub-postlists positioned on did are at the start of plist.
+    for (auto&& sub : plist) {
+	if (sub.did != did) break;
+	result += sub.pl->get_weight(doclen, unique_terms, wdfdocmax);
+    }
+    return result;
+}
+
+bool
+WandPostList::at_end() const
+{
+    return did == 0;
+}
+
+double
+WandPostList::recalc_maxweight()
+{
+    max_total = 0;
+    for (auto&& sub : plist) {
+	sub.max_wt = sub.pl->recalc_maxweight();
+	max_total += sub.max_wt;
+    }
+    max_wt_set = true;
+    return max_total;
+}
+
+PostList*
+WandPostList::next(double w_min)
+{
+    if (!max_wt_set && w_min > 0.0)
+	(void)recalc_maxweight();
+
+    if (did == 0) {
+	// Not started yet.
+	for (size_t i = 0; i != plist.size(); ++i) {
+	    advance(i, 0, w_min);
+	}
+    } else {
+	for (size_t i = 0; i != plist.size() && plist[i].did == did; ++i) {
+	    advance(i, 0, w_min);
+	}
+    }
+    return find_next(w_min);
+}
+
+PostList*
+WandPostList::skip_to(Xapian::docid did_min, double w_min)
+{
+    if (did_min <= did)
+	return NULL;
+
+    if (!max_wt_set && w_min > 0.0)
+	(void)recalc_maxweight();
+
+    for (size_t i = 0; i != plist.size() && plist[i].did < did_min; ++i) {
+	advance(i, did_min, w_min);
+    }
+    return find_next(w_min);
+}
+
+string
+WandPostList::get_description() const
+{
+    string desc = "WandPostList(";
+    for (auto&& sub : plist) {
+	if (&sub != &plist.front())
+	    desc += ", ";
+	desc += sub.pl->get_description();
+    }
+    desc += ')';
+    return desc;
+}
+
+Xapian::termcount
+WandPostList::get_wdf() const
+{
+    Xapian::termcount totwdf = 0;
+    for (auto&& sub : plist) {
+	if (sub.did != did) break;
+	totwdf += sub.pl->get_wdf();
+    }
+    return totwdf;
+}
+
+Xapian::termcount
+WandPostList::count_matching_subqs() const
+{
+    Xapian::termcount total = 0;
+    for (auto&& sub : plist) {
+	if (sub.did != did) break;
+	total += sub.pl->count_matching_subqs();
+    }
+    return total;
+}
+
+void
+WandPostList::gather_position_lists(OrPositionList* orposlist)
+{
+    for (auto&& sub : plist) {
+	if (sub.did != did) break;
+	sub.pl->gather_position_lists(orposlist);
+    }
+}
@@ -0,0 +1,163 @@
+/** @file
+ * @brief N-way OR postlist using Block-Max WAND
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_WANDPOSTLIST_H
+#define XAPIAN_INCLUDED_WANDPOSTLIST_H
+
+#include "backends/postlist.h"
+#include "postlisttree.h"
+
+#include <vector>
+
+/** N-way OR postlist using Block-Max WAND.
+ *
+ *  This implements the same operation as a tree of OrPostList objects, but
+ *  considers all the subqueries together so that once the matcher has a
+ *  minimum weight it can skip over documents which only match subqueries
+ *  whose combined maximum weight can't reach it.
+ *
+ *  The sub-postlists are kept sorted by their current docid.  To find the
+ *  next candidate we sum their maximum weights in that order until we reach
+ *  w_min - the docid of the sub-postlist where that happens (the "pivot") is
+ *  the first document which could possibly achieve w_min.  Sub-postlists
+ *  which report a per-block bound via PostList::get_block_maxweight() then
+ *  allow us to skip whole blocks which can't score highly enough.
+ *
+ *  See "Faster Top-k Document Retrieval Using Block-Max Indexes", Shuai Ding
+ *  and Torsten Suel, SIGIR 2011.
+ */
+class WandPostList : public PostList {
+    /// Don't allow assignment.
+    void operator=(const WandPostList&) = delete;
+
+    /// Don't allow copying.
+    WandPostList(const WandPostList&) = delete;
+
+    /// Information about a sub-postlist.
+    struct SubPostList {
+	/// The sub-postlist.
+	PostList* pl;
+
+	/// The current docid of @a pl (0 if not yet started).
+	Xapian::docid did;
+
+	/// Upper bound on the weight @a pl can return.
+	double max_wt;
+
+	/// Upper bound on the weight of @a pl in the current block.
+	double block_max;
+
+	/// The last docid which @a block_max covers (0 if not yet known).
+	Xapian::docid block_last;
+
+	explicit SubPostList(PostList* pl_)
+	    : pl(pl_), did(0), max_wt(0), block_max(0), block_last(0) { }
+    };
+
+    /// The sub-postlists, in ascending order of their current docid.
+    std::vector<SubPostList> plist;
+
+    /// The current docid, or zero if we haven't started or are at_end.
+    Xapian::docid did = 0;
+
+    /// The sum of the max_wt values in plist.
+    double max_total = 0;
+
+    /// Has recalc_maxweight() been called yet?
+    bool max_wt_set = false;
+
+    /// The number of documents in the database.
+    Xapian::doccount db_size;
+
+    /// Pointer to the matcher object, so we can report pruning.
+    PostListTree* matcher;
+
+    /** Advance sub-postlist @a i.
+     *
+     *  @param target	The docid to skip_to(), or 0 to call next().
+     *
+     *  If the sub-postlist reaches its end, it is deleted and its pl member
+     *  set to NULL - call remove_finished() to tidy up afterwards.
+     */
+    void advance(size_t i, Xapian::docid target, double w_min);
+
+    /// Remove any sub-postlists which have reached their end.
+    void remove_finished();
+
+    /// Restore the ordering of plist after entries have been advanced.
+    void sort_plist();
+
+    /// Return an upper bound for sub-postlist @a i for docids >= @a pivot.
+    double block_bound(size_t i, Xapian::docid pivot, Xapian::docid& limit);
+
+    /// Delete the sub-postlists and move to at_end().
+    void set_at_end();
+
+    /** Find the first candidate at or after the current positions.
+     *
+     *  This is called after sub-postlists have been advanced.
+     */
+    PostList* find_next(double w_min);
+
+  public:
+    /** Construct from 2 random-access iterators to a container of
+     *  PostListAndTermFreq, a pointer to the matcher, and the document
+     *  collection size.
+     */
+    template<class RandomItor>
+    WandPostList(RandomItor pl_begin, RandomItor pl_end,
+		 PostListTree* matcher_, Xapian::doccount db_size_)
+	: db_size(db_size_), matcher(matcher_)
+    {
+	plist.reserve(pl_end - pl_begin);
+	while (pl_begin != pl_end) {
+	    plist.emplace_back((*pl_begin++).pl);
+	}
+    }
+
+    ~WandPostList();
+
+    Xapian::doccount get_termfreq() const;
+
+    TermFreqs get_termfreq_est_using_stats(
+	const Xapian::Weight::Internal& stats) const;
+
+    Xapian::docid get_docid() const;
+
+    double get_weight(Xapian::termcount doclen,
+		      Xapian::termcount unique_terms,
+		      Xapian::termcount wdfdocmax) const;
+
+    bool at_end() const;
+
+    double recalc_maxweight();
+
+    PostList* next(double w_min);
+
+    PostList* skip_to(Xapian::docid did_min, double w_min);
+
+    std::string get_description() const;
+
+    Xapian::termcount get_wdf() const;
+
+    Xapian::termcount count_matching_subqs() const;
+
+    void gather_position_lists(OrPositionList* orposlist);
+};
+
+#endif // XAPIAN_INCLUDED_WANDPOSTLIST_H
@@ -513,6 +513,38 @@ RemoteConnection::send_file(char type, int fd, double end_time)
 #endif
 }
 
+bool
+RemoteConnection::ready_to_read()
+{
+    LOGCALL(REMOTE, bool, "RemoteConnection::ready_to_read", NO_ARGS);
+    if (fdin == -1)
+	throw_database_closed();
+
+    if (!buffer.empty())
+	RETURN(true);
+
+#ifdef __WIN32__
+    // FIXME: We could check for pending overlapped IO here.
+    RETURN(false);
+#elif defined HAVE_POLL
+    struct pollfd fds;
+    fds.fd = fdin;
+    fds.events = POLLIN;
+    fds.revents = 0;
+    RETURN(poll(&fds, 1, 0) > 0);
+#else
+    if (fdin >= FD_SETSIZE)
+	RETURN(false);
+    fd_set fdset;
+    FD_ZERO(&fdset);
+    FD_SET(fdin, &fdset);
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = 0;
+    RETURN(select(fdin + 1, &fdset, 0, 0, &tv) > 0);
+#endif
+}
+
 int
 RemoteConnection::sniff_next_message_type(double end_time)
 {
@@ -242,6 +242,15 @@ class RemoteConnection {
     /** Return the underlying fd this remote connection reads from. */
     int get_read_fd() const { return fdin; }
 
+    /** Check if there's data waiting to be read, without blocking.
+     *
+     *  This returns true at EOF too, since a read won't block then.
+     *
+     *  On platforms where this can't be checked without blocking, this
+     *  returns false unless some data has already been read.
+     */
+    bool ready_to_read();
+
     /** Check what the next message type is.
      *
      *  This must not be called after a call to get_message_chunked() until
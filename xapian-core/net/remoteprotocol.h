@@ -57,7 +57,9 @@
 // 44: pre-1.5.0 pack_uint() now used; many other changes
 // 44.1: pre-1.5.0 MSG_RECONSTRUCTTEXT added
 // 45: 1.5.0 Remote support for sorters
-#define XAPIAN_REMOTE_PROTOCOL_MAJOR_VERSION 45
+// 45.1: 1.5.0 MSG_SETMINWEIGHT added
+// 46: 1.5.0 REPLY_UPDATE includes a key identifying the database revision
+#define XAPIAN_REMOTE_PROTOCOL_MAJOR_VERSION 46
 #define XAPIAN_REMOTE_PROTOCOL_MINOR_VERSION 0
 
 /** Message types (client -> server).
@@ -105,6 +107,7 @@ enum message_type {
     MSG_ADDSYNONYM,		// Add a synonym
     MSG_REMOVESYNONYM,		// Remove a synonym
     MSG_CLEARSYNONYMS,		// Clear synonyms for a term
+    MSG_SETMINWEIGHT,		// Set min weight during MSG_GETMSET
     MSG_MAX
 };
 
@@ -32,6 +32,7 @@
 #include "xapian/valueiterator.h"
 
 #include <signal.h>
+#include <algorithm>
 #include <cerrno>
 #include <cstdlib>
 #include <memory>
@@ -273,6 +274,10 @@ RemoteServer::run()
 		case MSG_CLEARSYNONYMS:
 		    msg_clearsynonyms(message);
 		    continue;
+		case MSG_SETMINWEIGHT:
+		    // The client can send this after we've finished the match
+		    // it was for, in which case it's of no use.
+		    continue;
 		default: {
 		    // MSG_GETMSET - used during a conversation.
 		    // MSG_SHUTDOWN - handled by get_message().
@@ -495,10 +500,44 @@ RemoteServer::msg_update(const string &)
     pack_uint(message, db->get_doclength_upper_bound() - doclen_lb);
     pack_bool(message, db->has_positions());
     pack_uint(message, db->get_total_length());
+    pack_string(message, db->internal->get_cache_key());
     message += db->get_uuid();
     send_message(REPLY_UPDATE, message);
 }
 
+class RemoteServer::ClientMinWeight : public Matcher::ExternalMinWeight {
+    RemoteServer& server;
+
+    /// The highest minimum weight the client has sent.
+    double min_weight = 0.0;
+
+  public:
+    explicit ClientMinWeight(RemoteServer& server_) : server(server_) {}
+
+    double get_min_weight() {
+	// Only read if that won't block - the client only sends these while
+	// it's waiting for REPLY_RESULTS and there may be nothing waiting.
+	while (server.ready_to_read()) {
+	    double end_time = RealTime::end_time(server.active_timeout);
+	    if (server.sniff_next_message_type(end_time) != MSG_SETMINWEIGHT) {
+		// Leave anything else (including EOF) for after the match.
+		break;
+	    }
+	    string message;
+	    server.get_message(server.active_timeout, message,
+			       MSG_SETMINWEIGHT);
+	    const char* p = message.data();
+	    const char* p_end = p + message.size();
+	    double new_min_weight = unserialise_double(&p, p_end);
+	    if (p != p_end) {
+		throw Xapian::NetworkError("Bad MSG_SETMINWEIGHT");
+	    }
+	    min_weight = max(min_weight, new_min_weight);
+	}
+	return min_weight;
+    }
+};
+
 void
 RemoteServer::msg_query(const string &message_in)
 {
@@ -660,13 +699,18 @@ RemoteServer::msg_query(const string &message_in)
     unique_ptr<Xapian::Weight::Internal> total_stats(new Xapian::Weight::Internal);
     unserialise_stats(p, p_end, *total_stats);
 
+    // The client may send us the weight needed to make its merged MSet while
+    // we're matching, which allows us to skip documents which can't.
+    ClientMinWeight client_min_weight(*this);
+    matcher.set_external_min_weight(&client_min_weight);
+
     Xapian::MSet mset = matcher.get_mset(first, maxitems, check_at_least,
 					 *total_stats, *wt, 0, sorter.get(),
 					 collapse_key, collapse_max,
 					 percent_threshold, weight_threshold,
 					 order,
 					 sort_key, sort_by, sort_value_forward,
-					 time_limit, matchspies);
+					 time_limit, 0, matchspies);
     // FIXME: The local side already has these stats, except for the maxpart
     // information.
     mset.internal->set_stats(total_stats.release());
@@ -69,6 +69,9 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
     /// The registry, which allows unserialisation of user subclasses.
     Xapian::Registry reg;
 
+    /// Applies minimum weights which the client sends during a match.
+    class ClientMinWeight;
+
     /// Accept a message from the client.
     XAPIAN_VISIBILITY_INTERNAL
     message_type get_message(double timeout, std::string & result,
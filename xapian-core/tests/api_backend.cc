@@ -27,6 +27,8 @@
 #include <xapian.h>
 
 #include "backendmanager.h"
+#include "dbcheck.h"
+#include "envguard.h"
 #include "errno_to_string.h"
 #include "filetests.h"
 #include "str.h"
@@ -46,9 +48,11 @@
 # include "safesyswait.h"
 #endif
 
+#include <algorithm>
 #include <cerrno>
 #include <fstream>
 #include <iterator>
+#include <vector>
 
 using namespace std;
 
@@ -572,6 +576,10 @@ DEFINE_TESTCASE(databasemodified1, writable && !inmemory && !remote && !multi) {
     // test harness issues.
     //
     // With multi, DatabaseModifiedError doesn't trigger as easily.
+    //
+    // Segmented honey readers keep the segments they opened, so never see
+    // them modified.
+    SKIP_TEST_FOR_BACKEND("honey_segmented");
     Xapian::WritableDatabase db(get_writable_database());
     Xapian::Document doc;
     doc.set_data("cargo");
@@ -1610,6 +1618,440 @@ DEFINE_TESTCASE(getrevision2, glass) {
     TEST_EQUAL(wdb.get_revision(), 0);
 }
 
+/// Check databases @a a and @a b have the same contents.
+static void
+check_same_contents(const Xapian::Database& a, const Xapian::Database& b)
+{
+    TEST_EQUAL(a.get_doccount(), b.get_doccount());
+    TEST_EQUAL(a.get_lastdocid(), b.get_lastdocid());
+    auto t = b.allterms_begin();
+    for (auto i = a.allterms_begin(); i != a.allterms_end(); ++i, ++t) {
+	TEST(t != b.allterms_end());
+	TEST_EQUAL(*i, *t);
+	TEST_EQUAL(postlist_to_string(a, *i), postlist_to_string(b, *t));
+    }
+    TEST(t == b.allterms_end());
+    for (auto i = a.postlist_begin(""); i != a.postlist_end(""); ++i) {
+	Xapian::docid did = *i;
+	TEST_EQUAL(docterms_to_string(a, did), docterms_to_string(b, did));
+	TEST_EQUAL(a.get_document(did).get_data(),
+		   b.get_document(did).get_data());
+    }
+}
+
+/// Test reading glass databases through the shared block cache.
+DEFINE_TESTCASE(blockcache2, glass) {
+    Xapian::WritableDatabase wdb =
+	get_named_writable_database("blockcache2", "apitest_simpledata");
+    wdb.commit();
+    string path = get_named_writable_database_path("blockcache2");
+
+    struct RestoreSize {
+	size_t old_size = Xapian::Database::get_block_cache_size();
+	~RestoreSize() { Xapian::Database::set_block_cache_size(old_size); }
+    } restore_size;
+    Xapian::Database::set_block_cache_size(4 * 1024 * 1024);
+    TEST_EQUAL(Xapian::Database::get_block_cache_size(), 4 * 1024 * 1024);
+
+    Xapian::Database ref(path);
+    unsigned long long misses = Xapian::Database::get_block_cache_misses();
+    Xapian::Database db1(path);
+    check_same_contents(ref, db1);
+    TEST_REL(Xapian::Database::get_block_cache_misses(), >, misses);
+
+    // A second database on the same files should find the blocks cached.
+    unsigned long long hits = Xapian::Database::get_block_cache_hits();
+    Xapian::Database db2(path);
+    check_same_contents(ref, db2);
+    TEST_REL(Xapian::Database::get_block_cache_hits(), >, hits);
+
+    // Blocks cached for an old revision mustn't be returned for a new one.
+    for (Xapian::docid did = 1; did <= wdb.get_lastdocid(); ++did) {
+	Xapian::Document doc = wdb.get_document(did);
+	doc.set_data("changed " + str(did));
+	doc.add_term("changed");
+	wdb.replace_document(did, doc);
+    }
+    wdb.commit();
+    TEST(db2.reopen());
+    TEST(ref.reopen());
+    check_same_contents(ref, db2);
+    TEST_EQUAL(db2.get_document(1).get_data(), "changed 1");
+    TEST_EQUAL(db2.get_termfreq("changed"), db2.get_doccount());
+
+    // db1 is still at the old revision, which glass keeps until the next
+    // commit.
+    TEST_EQUAL(db1.get_termfreq("changed"), 0);
+    TEST_NOT_EQUAL(db1.get_document(1).get_data(), "changed 1");
+
+    // Reducing the size evicts blocks.
+    unsigned long long evictions =
+	Xapian::Database::get_block_cache_evictions();
+    Xapian::Database::set_block_cache_size(16 * 1024);
+    TEST_REL(Xapian::Database::get_block_cache_evictions(), >, evictions);
+    Xapian::Database::set_block_cache_size(0);
+    check_same_contents(ref, db2);
+}
+
+/// Check readahead of glass posting list blocks is counted.
+DEFINE_TESTCASE(readaheadstats1, glass) {
+#ifndef HAVE_POSIX_FADVISE
+    SKIP_TEST("Postlist readahead not implemented for this platform");
+#endif
+    string path = get_named_writable_database_path("readaheadstats1");
+    {
+	// Use small blocks so the posting lists span many of them.
+	Xapian::WritableDatabase wdb(path, Xapian::DB_CREATE_OR_OVERWRITE,
+				     2048);
+	for (int i = 0; i < 20000; ++i) {
+	    Xapian::Document doc;
+	    doc.add_term("all");
+	    doc.add_term("t" + str(i % 7), i % 5 + 1);
+	    wdb.add_document(doc);
+	}
+    }
+
+    Xapian::Database db(path);
+    TEST_EQUAL(db.get_readahead_issued(), 0);
+    TEST_EQUAL(db.get_readahead_used(), 0);
+    Xapian::doccount count = 0;
+    for (auto i = db.postlist_begin("all"); i != db.postlist_end("all"); ++i) {
+	++count;
+    }
+    TEST_EQUAL(count, 20000);
+    size_t issued = db.get_readahead_issued();
+    size_t used = db.get_readahead_used();
+    TEST_REL(issued, >, 0);
+    TEST_REL(used, >, 0);
+    TEST_REL(used, <=, issued);
+
+    // The counts are per database, and summed over shards.
+    Xapian::Database db2(path);
+    TEST_EQUAL(db2.get_readahead_issued(), 0);
+    Xapian::Database multi;
+    multi.add_database(db);
+    multi.add_database(db2);
+    TEST_EQUAL(multi.get_readahead_issued(), issued);
+    TEST_EQUAL(multi.get_readahead_used(), used);
+}
+
+/// Test reading a glass database via memory mappings.
+DEFINE_TESTCASE(mmapdb1, glass) {
+    Xapian::WritableDatabase wdb =
+	get_named_writable_database("mmapdb1", "apitest_simpledata");
+    wdb.commit();
+    string path = get_named_writable_database_path("mmapdb1");
+    Xapian::Database db(path);
+    Xapian::Database mdb(path, Xapian::DB_MMAP);
+    check_same_contents(db, mdb);
+
+    // Start iterating a postlist, then grow the table files so reopen()
+    // needs to map them again.
+    Xapian::doccount old_termfreq = mdb.get_termfreq("this");
+    TEST_REL(old_termfreq,>,1);
+    Xapian::PostingIterator p = mdb.postlist_begin("this");
+    ++p;
+    for (int i = 0; i < 1000; ++i) {
+	Xapian::Document doc;
+	doc.set_data("document " + str(i));
+	doc.add_term("new" + str(i % 37), 2);
+	doc.add_posting("added", 1);
+	wdb.add_document(doc);
+    }
+    wdb.commit();
+    TEST(db.reopen());
+    TEST(mdb.reopen());
+    check_same_contents(db, mdb);
+
+    // The postlist iterator should still work.
+    Xapian::doccount count = 1;
+    while (p != mdb.postlist_end("this")) {
+	++count;
+	++p;
+    }
+    TEST_EQUAL(count, old_termfreq);
+
+    // Check single-file databases, opened by path and by fd.
+    string single = get_compaction_output_path("mmapdb1-single");
+    wdb.compact(single, Xapian::DBCOMPACT_SINGLE_FILE);
+    wdb.close();
+    check_same_contents(db, Xapian::Database(single, Xapian::DB_MMAP));
+    int fd = open(single.c_str(), O_RDONLY|O_BINARY);
+    TEST(fd >= 0);
+    check_same_contents(db, Xapian::Database(fd, Xapian::DB_MMAP));
+
+    // Accessing a closed database should throw the usual exception.
+    mdb.close();
+    TEST_EXCEPTION(Xapian::DatabaseClosedError,
+		   postlist_to_string(mdb, "this"));
+}
+
+/// Test reading honey databases compacted from glass via memory mappings.
+DEFINE_TESTCASE(compacthoneymmap1, glass) {
+    Xapian::Database db = get_database("apitest_simpledata");
+    static const int mmap_flags[] = {
+	Xapian::DB_MMAP,
+	Xapian::DB_MMAP | Xapian::DB_MMAP_RANDOM,
+	Xapian::DB_MMAP | Xapian::DB_MMAP_WILLNEED
+    };
+    for (int single_file = 0; single_file != 2; ++single_file) {
+	string path = get_compaction_output_path("compacthoneymmap1");
+	rm_rf(path);
+	unlink(path.c_str());
+	int flags = Xapian::DB_BACKEND_HONEY;
+	if (single_file) flags |= Xapian::DBCOMPACT_SINGLE_FILE;
+	db.compact(path, flags);
+	for (int f : mmap_flags) {
+	    Xapian::Database mdb(path, f);
+	    check_same_contents(db, mdb);
+	    for (auto i = db.postlist_begin(""); i != db.postlist_end(""); ++i) {
+		Xapian::docid did = *i;
+		TEST_EQUAL(db.get_doclength(did), mdb.get_doclength(did));
+	    }
+	    TEST_EQUAL(db.get_total_length(), mdb.get_total_length());
+	    TEST_EQUAL(db.get_termfreq("this"), mdb.get_termfreq("this"));
+	    TEST(!mdb.term_exists("zzzzzz"));
+	}
+	if (single_file) {
+	    int fd = open(path.c_str(), O_RDONLY|O_BINARY);
+	    TEST(fd >= 0);
+	    check_same_contents(db, Xapian::Database(fd, Xapian::DB_MMAP));
+	}
+    }
+}
+
+/// Check a writer reusing blocks is reported to readers using DB_MMAP.
+DEFINE_TESTCASE(mmapdb3, glass) {
+    Xapian::WritableDatabase db = get_named_writable_database("mmapdb3");
+    string path = get_named_writable_database_path("mmapdb3");
+    Xapian::Document doc;
+    doc.set_data("cargo");
+    doc.add_term("abc");
+    doc.add_term("def");
+    doc.add_term("ghi");
+    const int N = 500;
+    for (int i = 0; i < N; ++i) {
+	db.add_document(doc);
+    }
+    db.commit();
+
+    Xapian::Database rodb(path, Xapian::DB_MMAP);
+    db.add_document(doc);
+    db.commit();
+
+    db.add_document(doc);
+    db.commit();
+
+    db.add_document(doc);
+    try {
+	TEST_EQUAL(*rodb.termlist_begin(N - 1), "abc");
+	FAIL_TEST("Expected DatabaseModifiedError wasn't thrown");
+    } catch (const Xapian::DatabaseModifiedError &) {
+    }
+
+    try {
+	Xapian::Enquire enq(rodb);
+	enq.set_query(Xapian::Query("abc"));
+	Xapian::MSet mset = enq.get_mset(0, 10);
+	FAIL_TEST("Expected DatabaseModifiedError wasn't thrown");
+    } catch (const Xapian::DatabaseModifiedError &) {
+    }
+
+    // Overwriting the database shouldn't affect a reader which has it
+    // mapped.
+    TEST(rodb.reopen());
+    Xapian::doccount doccount = rodb.get_doccount();
+    db.close();
+    db = Xapian::WritableDatabase(path, Xapian::DB_CREATE_OR_OVERWRITE);
+    db.commit();
+    TEST_EQUAL(rodb.get_termfreq("abc"), doccount);
+    TEST_EQUAL(postlist_to_string(rodb, "def").size(),
+	       postlist_to_string(rodb, "abc").size());
+    TEST(rodb.reopen());
+    TEST_EQUAL(rodb.get_doccount(), 0);
+}
+
+/// Check @a db has the same document lengths as @a ref.
+static void
+check_same_doclengths(const Xapian::Database& ref, const Xapian::Database& db)
+{
+    TEST_EQUAL(db.get_lastdocid(), ref.get_lastdocid());
+    for (Xapian::docid did = 1; did <= ref.get_lastdocid() + 2; ++did) {
+	Xapian::termcount len;
+	try {
+	    len = ref.get_doclength(did);
+	} catch (const Xapian::DocNotFoundError&) {
+	    TEST_EXCEPTION(Xapian::DocNotFoundError, db.get_doclength(did));
+	    continue;
+	}
+	TEST_EQUAL(db.get_doclength(did), len);
+    }
+}
+
+/// Test the dense document length column.
+DEFINE_TESTCASE(doclencolumn1, glass) {
+    string path = get_named_writable_database_path("doclencolumn1");
+    string ref_path = get_named_writable_database_path("doclencolumn1ref");
+    string column = path + "/doclens";
+    Xapian::WritableDatabase wdb(path,
+				 Xapian::DB_CREATE_OR_OVERWRITE |
+				 Xapian::DB_BACKEND_GLASS |
+				 Xapian::DB_DOCLEN_COLUMN);
+    Xapian::WritableDatabase ref(ref_path,
+				 Xapian::DB_CREATE_OR_OVERWRITE |
+				 Xapian::DB_BACKEND_GLASS);
+    check_same_doclengths(ref, wdb);
+
+    auto apply = [&](void (*f)(Xapian::WritableDatabase&)) {
+	f(wdb);
+	f(ref);
+	check_same_doclengths(ref, wdb);
+	wdb.commit();
+	ref.commit();
+	check_same_doclengths(ref, wdb);
+    };
+
+    apply([](Xapian::WritableDatabase& db) {
+	for (Xapian::termcount i = 0; i != 100; ++i) {
+	    Xapian::Document doc;
+	    for (Xapian::termcount j = 0; j <= i % 17; ++j) {
+		doc.add_term("t" + str(j), j + 1);
+	    }
+	    db.add_document(doc);
+	}
+	// Leave a gap in the docids.
+	Xapian::Document doc;
+	doc.add_term("gap", 3);
+	db.replace_document(150, doc);
+    });
+    TEST(file_exists(column));
+    Xapian::Database reader(path);
+    check_same_doclengths(ref, reader);
+
+    // Changes which need a wider entry, delete documents and extend the
+    // column.
+    apply([](Xapian::WritableDatabase& db) {
+	Xapian::Document doc;
+	doc.add_term("big", 100000);
+	db.replace_document(3, doc);
+	db.delete_document(5);
+	db.delete_document(150);
+	doc.clear_terms();
+	doc.add_term("new");
+	db.add_document(doc);
+    });
+    TEST(reader.reopen());
+    check_same_doclengths(ref, reader);
+
+    // Commits append the changes to a log rather than rewriting the column,
+    // until the log gets large.
+    string log = column + ".log";
+    TEST(file_exists(log));
+    bool rewritten = false;
+    for (Xapian::docid first = 1000; !rewritten; first += 5000) {
+	TEST_REL(first, <, 200000);
+	for (Xapian::WritableDatabase* db : { &wdb, &ref }) {
+	    for (Xapian::docid did = first; did != first + 3000; ++did) {
+		Xapian::Document doc;
+		doc.add_term("t", did % 7 + 1);
+		db->replace_document(did, doc);
+	    }
+	    for (Xapian::docid did = 1; did <= 100; did += 2) {
+		Xapian::Document doc;
+		doc.add_term("u", (did + first) % 11 + 1);
+		db->replace_document(did, doc);
+	    }
+	    db->delete_document(first + 3);
+	    db->commit();
+	}
+	if (!file_exists(log)) rewritten = true;
+	TEST(reader.reopen());
+	check_same_doclengths(ref, reader);
+    }
+    check_same_doclengths(ref, Xapian::Database(path));
+
+    // The column is still maintained without the flag.
+    wdb.close();
+    wdb = Xapian::WritableDatabase(path, Xapian::DB_BACKEND_GLASS);
+    apply([](Xapian::WritableDatabase& db) {
+	db.delete_document(7);
+	Xapian::Document doc;
+	doc.add_term("x", 2);
+	db.replace_document(8, doc);
+    });
+    TEST(reader.reopen());
+    check_same_doclengths(ref, reader);
+
+    // Without the file, the postlist table is used.
+    wdb.close();
+    TEST(file_exists(log));
+    TEST(unlink(column.c_str()) == 0);
+    check_same_doclengths(ref, Xapian::Database(path));
+    wdb = Xapian::WritableDatabase(path, Xapian::DB_BACKEND_GLASS);
+    apply([](Xapian::WritableDatabase& db) {
+	db.delete_document(9);
+    });
+    TEST(!file_exists(column));
+    TEST(!file_exists(log));
+
+    // Compacting can create the column.
+    string out_path = get_compaction_output_path("doclencolumn1out");
+    Xapian::Database(ref_path).compact(out_path, Xapian::DB_DOCLEN_COLUMN);
+    TEST(file_exists(out_path + "/doclens"));
+    Xapian::Database out(out_path);
+    check_same_doclengths(ref, out);
+    dbcheck(out, ref.get_doccount(), ref.get_lastdocid());
+}
+
+/// Test glass databases which compress tags with lz4 or zstd.
+DEFINE_TESTCASE(compresscodec1, glass) {
+    Xapian::Database db = get_database("apitest_simpledata");
+    static const int codecs[] = {
+	Xapian::DB_COMPRESS_LZ4, Xapian::DB_COMPRESS_ZSTD
+    };
+    bool tested = false;
+    for (int codec : codecs) {
+	string path = get_named_writable_database_path("compresscodec1");
+	Xapian::WritableDatabase wdb;
+	try {
+	    wdb = Xapian::WritableDatabase(path,
+					   Xapian::DB_CREATE_OR_OVERWRITE |
+					   Xapian::DB_BACKEND_GLASS |
+					   codec);
+	} catch (const Xapian::FeatureUnavailableError&) {
+	    continue;
+	}
+	tested = true;
+	for (auto i = db.postlist_begin(""); i != db.postlist_end(""); ++i) {
+	    wdb.replace_document(*i, db.get_document(*i));
+	}
+	wdb.commit();
+	wdb.close();
+
+	Xapian::Database cdb(path);
+	check_same_contents(db, cdb);
+
+	// Compact to zlib, and then back to the codec again.
+	string zlib_path = get_compaction_output_path("compresscodec1zlib");
+	cdb.compact(zlib_path);
+	check_same_contents(db, Xapian::Database(zlib_path));
+	string out_path = get_compaction_output_path("compresscodec1out");
+	Xapian::Database(zlib_path).compact(out_path, codec);
+	check_same_contents(db, Xapian::Database(out_path));
+	dbcheck(Xapian::Database(out_path), db.get_doccount(),
+		db.get_lastdocid());
+    }
+    if (!tested) SKIP_TEST("Neither lz4 nor zstd support enabled");
+
+    // Specifying both codecs is an error.
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   Xapian::WritableDatabase(
+		       get_named_writable_database_path("compresscodec1"),
+		       Xapian::DB_CREATE_OR_OVERWRITE |
+		       Xapian::DB_BACKEND_GLASS |
+		       Xapian::DB_COMPRESS_LZ4 | Xapian::DB_COMPRESS_ZSTD));
+}
+
 /// Feature test for DOC_ASSUME_VALID.
 DEFINE_TESTCASE(getdocumentlazy1, backend) {
     Xapian::Database db = get_database("apitest_simpledata");
@@ -1893,3 +2335,668 @@ DEFINE_TESTCASE(allterms7, backend) {
 	TEST(db.postlist_begin(term) != db.postlist_end(term));
     }
 }
+
+static Xapian::termcount
+chunkwdfmax1_wdf(Xapian::docid did)
+{
+    // A run of documents with a much higher wdf part way through the list.
+    if (did >= 4000 && did < 4010) return 1000;
+    return did % 50 + 1;
+}
+
+static void
+gen_chunkwdfmax1_db(Xapian::WritableDatabase& db, const string&)
+{
+    for (Xapian::docid did = 1; did <= 5000; ++did) {
+	Xapian::Document doc;
+	doc.add_term("varied", chunkwdfmax1_wdf(did));
+	doc.add_term("flat", 3);
+	db.add_document(doc);
+    }
+}
+
+/// Test posting lists which span several chunks with varying wdf.
+DEFINE_TESTCASE(chunkwdfmax1, generated) {
+    Xapian::Database db = get_database("chunkwdfmax1", gen_chunkwdfmax1_db);
+    // Only some backends give an exact bound.
+    TEST_REL(db.get_wdf_upper_bound("varied"), >=, 1000);
+    TEST_REL(db.get_wdf_upper_bound("flat"), >=, 3);
+
+    Xapian::docid expect = 1;
+    for (auto p = db.postlist_begin("varied"); p != db.postlist_end("varied");
+	 ++p) {
+	TEST_EQUAL(*p, expect);
+	TEST_EQUAL(p.get_wdf(), chunkwdfmax1_wdf(expect));
+	++expect;
+    }
+    TEST_EQUAL(expect, 5001);
+
+    // Skipping to the last entry should give its wdf, not that of the last
+    // entry in the first chunk.
+    static const Xapian::docid targets[] = { 2500, 4005, 4999, 5000 };
+    for (Xapian::docid target : targets) {
+	auto p = db.postlist_begin("varied");
+	p.skip_to(target);
+	TEST(p != db.postlist_end("varied"));
+	TEST_EQUAL(*p, target);
+	TEST_EQUAL(p.get_wdf(), chunkwdfmax1_wdf(target));
+    }
+
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query("varied"));
+    Xapian::MSet mset = enq.get_mset(0, 10);
+    TEST_EQUAL(mset.size(), 10);
+    for (auto i = mset.begin(); i != mset.end(); ++i) {
+	TEST_EQUAL(chunkwdfmax1_wdf(*i), 1000);
+    }
+}
+
+static void
+gen_wandor1_db(Xapian::WritableDatabase& db, const string&)
+{
+    for (Xapian::docid did = 1; did <= 3000; ++did) {
+	Xapian::Document doc;
+	for (unsigned i = 0; i != 20; ++i) {
+	    // Give the terms a range of frequencies and wdfs.
+	    if ((did * (i + 7)) % (i + 3) == 0) {
+		doc.add_term("t" + str(i), (did + i) % (i + 5) + 1);
+	    }
+	}
+	doc.add_term("padding", did % 97 + 1);
+	db.add_document(doc);
+    }
+}
+
+/// Check wide OR queries give the same results with and without WAND.
+DEFINE_TESTCASE(wandor1, generated && !remote) {
+    EnvGuard wand_min("XAPIAN_WAND_MIN_SUBQUERIES", "0");
+
+    Xapian::Database db = get_database("wandor1", gen_wandor1_db);
+    Xapian::Enquire enq(db);
+
+    static const unsigned widths[] = { 2, 5, 10, 20 };
+    for (unsigned width : widths) {
+	vector<Xapian::Query> subqs;
+	for (unsigned i = 0; i != width; ++i) {
+	    subqs.emplace_back("t" + str(i * 19 % 20));
+	}
+	Xapian::Query query(Xapian::Query::OP_OR, subqs.begin(), subqs.end());
+	enq.set_query(query);
+	for (Xapian::doccount size : { 1, 10, 100, 3000 }) {
+	    wand_min.set("0");
+	    Xapian::MSet mset1 = enq.get_mset(0, size);
+	    wand_min.set("2");
+	    Xapian::MSet mset2 = enq.get_mset(0, size);
+	    tout << "width " << width << ", size " << size << '\n';
+	    TEST_EQUAL(mset1.size(), mset2.size());
+	    // The weights may be summed in a different order, so documents
+	    // with equal weights can end up ranked differently.
+	    TEST(mset_range_is_same_weights(mset1, 0, mset2, 0, mset1.size()));
+	    TEST_EQUAL_DOUBLE(mset1.get_max_possible(),
+			      mset2.get_max_possible());
+	    TEST_EQUAL_DOUBLE(mset1.get_max_attained(),
+			      mset2.get_max_attained());
+	    if (size == 3000) {
+		TEST_EQUAL(mset1.get_matches_estimated(),
+			   mset2.get_matches_estimated());
+		vector<Xapian::docid> docids1(mset1.begin(), mset1.end());
+		vector<Xapian::docid> docids2(mset2.begin(), mset2.end());
+		sort(docids1.begin(), docids1.end());
+		sort(docids2.begin(), docids2.end());
+		TEST(docids1 == docids2);
+	    }
+	}
+    }
+
+    // A bad value is reported before matching starts.
+    wand_min.set("lots");
+    TEST_EXCEPTION(Xapian::InvalidArgumentError, enq.get_mset(0, 10));
+}
+
+static void
+gen_parallelmatch1_db(Xapian::WritableDatabase& db, const string& arg)
+{
+    unsigned shard = unsigned(atoi(arg.c_str()));
+    for (Xapian::docid did = 1; did <= 1000; ++did) {
+	Xapian::Document doc;
+	unsigned n = did * 3 + shard;
+	doc.add_term("all");
+	for (unsigned i = 0; i != 8; ++i) {
+	    if (n % (i + 2) == 0) {
+		doc.add_term("t" + str(i), (n + i) % 7 + 1);
+	    }
+	}
+	doc.add_value(0, str(n % 13));
+	db.add_document(doc);
+    }
+}
+
+/// Check matching local shards in parallel gives the same results.
+DEFINE_TESTCASE(parallelmatch1, generated && !remote) {
+    Xapian::Database db;
+    for (unsigned shard = 0; shard != 3; ++shard) {
+	db.add_database(get_database("parallelmatch1_" + str(shard),
+				     gen_parallelmatch1_db, str(shard)));
+    }
+    Xapian::doccount db_size = db.get_doccount();
+
+    vector<Xapian::Query> subqs;
+    for (unsigned i = 0; i != 8; ++i) {
+	subqs.emplace_back("t" + str(i));
+    }
+    Xapian::Query query(Xapian::Query::OP_OR, subqs.begin(), subqs.end());
+
+    Xapian::Enquire serial(db);
+    Xapian::Enquire parallel(db);
+    parallel.set_match_threads(4);
+
+    for (int setting = 0; setting != 4; ++setting) {
+	for (Xapian::Enquire* enq : { &serial, &parallel }) {
+	    enq->set_query(query);
+	    switch (setting) {
+		case 1:
+		    enq->set_sort_by_value_then_relevance(0, false);
+		    break;
+		case 2:
+		    enq->set_sort_by_relevance();
+		    enq->set_collapse_key(0);
+		    break;
+		case 3:
+		    enq->set_collapse_key(Xapian::BAD_VALUENO);
+		    enq->set_query(Xapian::Query(Xapian::Query::OP_FILTER,
+						 query,
+						 Xapian::Query("t2")));
+		    break;
+	    }
+	}
+	for (Xapian::doccount size : { 1, 10, 100 }) {
+	    tout << "setting " << setting << ", size " << size << '\n';
+	    Xapian::MSet mset1 = serial.get_mset(0, size);
+	    Xapian::MSet mset2 = parallel.get_mset(0, size);
+	    TEST_EQUAL(mset1.size(), mset2.size());
+	    TEST(mset_range_is_same(mset1, 0, mset2, 0, mset1.size()));
+
+	    // Check a later page too.
+	    mset1 = serial.get_mset(5, size);
+	    mset2 = parallel.get_mset(5, size);
+	    TEST_EQUAL(mset1.size(), mset2.size());
+	    TEST(mset_range_is_same(mset1, 0, mset2, 0, mset1.size()));
+
+	    mset1 = serial.get_mset(0, size, db_size);
+	    mset2 = parallel.get_mset(0, size, db_size);
+	    TEST(mset_range_is_same(mset1, 0, mset2, 0, mset1.size()));
+	    TEST_EQUAL_DOUBLE(mset1.get_max_attained(),
+			      mset2.get_max_attained());
+	    if (setting != 2) {
+		// If we check all the documents the counts should be exact
+		// (unless collapsing, when they're still estimates).
+		TEST_EQUAL(mset1.get_matches_lower_bound(),
+			   mset2.get_matches_lower_bound());
+		TEST_EQUAL(mset1.get_matches_estimated(),
+			   mset2.get_matches_estimated());
+		TEST_EQUAL(mset1.get_matches_upper_bound(),
+			   mset2.get_matches_upper_bound());
+	    }
+	}
+    }
+
+    // Check MatchSpy objects see all the documents from every shard.
+    Xapian::ValueCountMatchSpy spy1(0);
+    Xapian::ValueCountMatchSpy spy2(0);
+    serial.add_matchspy(&spy1);
+    parallel.add_matchspy(&spy2);
+    serial.set_query(query);
+    parallel.set_query(query);
+    Xapian::MSet mset1 = serial.get_mset(0, 10, db_size);
+    Xapian::MSet mset2 = parallel.get_mset(0, 10, db_size);
+    TEST(mset_range_is_same(mset1, 0, mset2, 0, mset1.size()));
+    TEST_EQUAL(spy1.get_total(), spy2.get_total());
+    TEST_EQUAL(spy1.get_description(), spy2.get_description());
+    auto v2 = spy2.values_begin();
+    for (auto v1 = spy1.values_begin(); v1 != spy1.values_end(); ++v1) {
+	TEST(v2 != spy2.values_end());
+	TEST_EQUAL(*v1, *v2);
+	TEST_EQUAL(v1.get_termfreq(), v2.get_termfreq());
+	++v2;
+    }
+    TEST(v2 == spy2.values_end());
+}
+
+/// FixedWeightPostingSource which doesn't support clone().
+class NoCloneFixedWeightPostingSource
+    : public Xapian::FixedWeightPostingSource {
+  public:
+    explicit NoCloneFixedWeightPostingSource(double wt)
+	: Xapian::FixedWeightPostingSource(wt) {}
+
+    NoCloneFixedWeightPostingSource* clone() const override {
+	return NULL;
+    }
+};
+
+/// Check splitting a shard into docid ranges to match in parallel.
+DEFINE_TESTCASE(parallelmatch2, generated && path) {
+    Xapian::Database db = get_database("parallelmatch1_0",
+				       gen_parallelmatch1_db, "0");
+    Xapian::doccount db_size = db.get_doccount();
+
+    // Split even this small database into ranges.
+    EnvGuard min_docs("XAPIAN_MATCH_RANGE_MIN_DOCS", "1");
+
+    vector<Xapian::Query> subqs;
+    for (unsigned i = 0; i != 8; ++i) {
+	subqs.emplace_back("t" + str(i));
+    }
+    Xapian::Query query(Xapian::Query::OP_OR, subqs.begin(), subqs.end());
+
+    // Each range may build a different PostList tree, so the weights of
+    // documents can differ in the last few bits and tied documents can be
+    // ordered differently - hence we compare weights rather than docids.
+    Xapian::Enquire serial(db);
+    Xapian::Enquire parallel(db);
+    parallel.set_match_threads(4);
+
+    for (int setting = 0; setting != 4; ++setting) {
+	for (Xapian::Enquire* enq : { &serial, &parallel }) {
+	    enq->set_query(query);
+	    switch (setting) {
+		case 1:
+		    enq->set_sort_by_value_then_relevance(0, false);
+		    break;
+		case 2:
+		    enq->set_sort_by_relevance();
+		    enq->set_collapse_key(0);
+		    break;
+		case 3:
+		    enq->set_collapse_key(Xapian::BAD_VALUENO);
+		    enq->set_query(Xapian::Query(Xapian::Query::OP_AND,
+						 Xapian::Query("t1"),
+						 Xapian::Query("t2")));
+		    break;
+	    }
+	}
+	for (Xapian::doccount size : { 1, 10, 100 }) {
+	    tout << "setting " << setting << ", size " << size << '\n';
+	    Xapian::MSet mset1 = serial.get_mset(0, size);
+	    Xapian::MSet mset2 = parallel.get_mset(0, size);
+	    TEST_EQUAL(mset1.size(), mset2.size());
+	    TEST(mset_range_is_same_weights(mset1, 0, mset2, 0, mset1.size()));
+	    TEST_REL(mset2.get_matches_lower_bound(), <=,
+		     mset2.get_matches_estimated());
+	    TEST_REL(mset2.get_matches_estimated(), <=,
+		     mset2.get_matches_upper_bound());
+	    TEST_REL(mset2.get_matches_upper_bound(), <=, db_size);
+
+	    mset1 = serial.get_mset(7, size);
+	    mset2 = parallel.get_mset(7, size);
+	    TEST_EQUAL(mset1.size(), mset2.size());
+	    TEST(mset_range_is_same_weights(mset1, 0, mset2, 0, mset1.size()));
+
+	    mset1 = serial.get_mset(0, size, db_size);
+	    mset2 = parallel.get_mset(0, size, db_size);
+	    TEST(mset_range_is_same_weights(mset1, 0, mset2, 0, mset1.size()));
+	    if (setting != 2) {
+		TEST_EQUAL(mset1.get_matches_lower_bound(),
+			   mset2.get_matches_lower_bound());
+		TEST_EQUAL(mset1.get_matches_estimated(),
+			   mset2.get_matches_estimated());
+		TEST_EQUAL(mset1.get_matches_upper_bound(),
+			   mset2.get_matches_upper_bound());
+	    }
+	}
+    }
+
+    // Check MatchSpy objects see the documents from every range.
+    Xapian::ValueCountMatchSpy spy1(0);
+    Xapian::ValueCountMatchSpy spy2(0);
+    serial.add_matchspy(&spy1);
+    parallel.add_matchspy(&spy2);
+    serial.set_query(query);
+    parallel.set_query(query);
+    Xapian::MSet mset1 = serial.get_mset(0, 10, db_size);
+    Xapian::MSet mset2 = parallel.get_mset(0, 10, db_size);
+    TEST(mset_range_is_same_weights(mset1, 0, mset2, 0, mset1.size()));
+    TEST_EQUAL(spy1.get_total(), spy2.get_total());
+    TEST_EQUAL(spy1.get_description(), spy2.get_description());
+    serial.clear_matchspies();
+    parallel.clear_matchspies();
+
+    // A PostingSource which can't be cloned means we match serially (with
+    // more than one shard such a PostingSource isn't supported at all).
+    if (db.size() == 1) {
+	NoCloneFixedWeightPostingSource source(0.5);
+	Xapian::Query ps_query(Xapian::Query::OP_AND,
+			       query, Xapian::Query(&source));
+	serial.set_query(ps_query);
+	mset1 = serial.get_mset(3, 10);
+	parallel.set_query(ps_query);
+	mset2 = parallel.get_mset(3, 10);
+	TEST_EQUAL(mset1.size(), mset2.size());
+	TEST(mset_range_is_same(mset1, 0, mset2, 0, mset1.size()));
+    }
+}
+
+/// Check parallel ranges follow the shard when it's reopened.
+DEFINE_TESTCASE(parallelmatch3, glass) {
+    Xapian::WritableDatabase wdb = get_named_writable_database("parallelmatch3");
+    for (unsigned i = 1; i <= 100; ++i) {
+	Xapian::Document doc;
+	doc.add_term("all");
+	doc.add_term("t" + str(i % 7));
+	wdb.add_document(doc);
+    }
+    wdb.commit();
+
+    EnvGuard min_docs("XAPIAN_MATCH_RANGE_MIN_DOCS", "1");
+
+    Xapian::Database db(get_named_writable_database_path("parallelmatch3"));
+    Xapian::Enquire enq(db);
+    enq.set_match_threads(4);
+    enq.set_query(Xapian::Query("all"));
+    Xapian::MSet mset = enq.get_mset(0, 200);
+    TEST_EQUAL(mset.size(), 100);
+
+    // Commit more changes, so the instances the Enquire opened for the
+    // other ranges are out of date.
+    for (unsigned i = 101; i <= 150; ++i) {
+	Xapian::Document doc;
+	doc.add_term("all");
+	wdb.add_document(doc);
+    }
+    wdb.delete_document(1);
+    wdb.commit();
+
+    // Before reopening we still see the old revision in every range.
+    mset = enq.get_mset(0, 200);
+    TEST_EQUAL(mset.size(), 100);
+
+    TEST(db.reopen());
+    mset = enq.get_mset(0, 200);
+    TEST_EQUAL(mset.size(), 149);
+    TEST_EQUAL(mset.get_matches_estimated(), 149);
+    for (Xapian::MSetIterator i = mset.begin(); i != mset.end(); ++i) {
+	TEST_NOT_EQUAL(*i, 1);
+    }
+}
+
+static void
+gen_remoteminweight1_db(Xapian::WritableDatabase& db, const string& arg)
+{
+    // Shard "big" has many documents which can't make the top 10 once the
+    // documents in shard "small" have been seen.
+    bool big = (arg == "big");
+    for (Xapian::docid did = 1; did <= (big ? 30000 : 10); ++did) {
+	Xapian::Document doc;
+	doc.add_term("a");
+	if (!big) doc.add_term("b");
+	db.add_document(doc);
+    }
+}
+
+/// Check telling remote shards the weight needed doesn't change the results.
+DEFINE_TESTCASE(remoteminweight1, generated && remote) {
+    Xapian::Database db;
+    for (unsigned shard = 0; shard != 3; ++shard) {
+	db.add_database(get_database("parallelmatch1_" + str(shard),
+				     gen_parallelmatch1_db, str(shard)));
+    }
+    Xapian::doccount db_size = db.get_doccount();
+
+    vector<Xapian::Query> subqs;
+    for (unsigned i = 0; i != 8; ++i) {
+	subqs.emplace_back("t" + str(i));
+    }
+    Xapian::Query query(Xapian::Query::OP_OR, subqs.begin(), subqs.end());
+
+    Xapian::Enquire enquire(db);
+    enquire.set_query(query);
+    for (int setting = 0; setting != 2; ++setting) {
+	if (setting == 1) {
+	    enquire.set_sort_by_relevance_then_value(0, false);
+	}
+	for (Xapian::doccount size : { 1, 10, 100 }) {
+	    tout << "setting " << setting << ", size " << size << '\n';
+	    // No weight is sent to the remotes if we ask for all the documents
+	    // to be checked.  Pruning can change the order the weights are
+	    // summed in, so tied documents may be ordered differently.
+	    Xapian::MSet mset1 = enquire.get_mset(0, size, db_size);
+	    Xapian::MSet mset2 = enquire.get_mset(0, size);
+	    TEST_EQUAL(mset1.size(), mset2.size());
+	    TEST(mset_range_is_same_weights(mset1, 0, mset2, 0, mset1.size()));
+
+	    mset1 = enquire.get_mset(5, size, db_size);
+	    mset2 = enquire.get_mset(5, size);
+	    TEST_EQUAL(mset1.size(), mset2.size());
+	    TEST(mset_range_is_same_weights(mset1, 0, mset2, 0, mset1.size()));
+	    TEST_REL(mset2.get_matches_lower_bound(), <=,
+		     mset1.get_matches_estimated());
+	    TEST_REL(mset2.get_matches_upper_bound(), >=,
+		     mset1.get_matches_estimated());
+	    TEST_REL(mset2.get_matches_lower_bound(), <=,
+		     mset2.get_matches_estimated());
+	    TEST_REL(mset2.get_matches_estimated(), <=,
+		     mset2.get_matches_upper_bound());
+	}
+    }
+
+    // Check a server actually applies a weight it's sent.  Each shard here
+    // is on its own server.  Shard "small" finishes almost at once, and
+    // the weight the client then sends lets the server for shard "big"
+    // stop early, so the matchspy sees fewer documents than match.  The
+    // weight may not arrive in time on a heavily loaded machine, so we try
+    // several times.
+    //
+    // The multi backends interleave the documents of each database we ask
+    // for across their shards, so there's no shard which finishes early.
+    if (startswith(get_dbtype(), "multi")) return;
+    Xapian::Database db2;
+    db2.add_database(get_database("remoteminweight1_small",
+				  gen_remoteminweight1_db, "small"));
+    db2.add_database(get_database("remoteminweight1_big",
+				  gen_remoteminweight1_db, "big"));
+    Xapian::doccount db2_size = db2.get_doccount();
+    Xapian::Enquire enquire2(db2);
+    enquire2.set_query(Xapian::Query(Xapian::Query::OP_OR,
+				     Xapian::Query("a"),
+				     Xapian::Query("b")));
+    Xapian::MSet mset1 = enquire2.get_mset(0, 10, db2_size);
+    bool applied = false;
+    for (int attempt = 0; attempt != 10 && !applied; ++attempt) {
+	Xapian::ValueCountMatchSpy spy(0);
+	enquire2.add_matchspy(&spy);
+	Xapian::MSet mset2 = enquire2.get_mset(0, 10);
+	enquire2.clear_matchspies();
+	TEST(mset_range_is_same(mset1, 0, mset2, 0, mset1.size()));
+	TEST_REL(mset2.get_matches_lower_bound(), <=, db2_size);
+	TEST_REL(mset2.get_matches_upper_bound(), >=, db2_size);
+	tout << "matchspy saw " << spy.get_total() << '\n';
+	applied = (spy.get_total() < db2_size);
+    }
+    TEST(applied);
+}
+
+/// Check updating a segmented honey database.
+DEFINE_TESTCASE(segmented1, honey) {
+    string path = get_compaction_output_path("segmented1");
+    rm_rf(path);
+    Xapian::WritableDatabase db(path, Xapian::DB_BACKEND_HONEY);
+    for (int i = 1; i <= 10; ++i) {
+	Xapian::Document doc;
+	doc.set_data("doc " + str(i));
+	doc.add_term("all");
+	doc.add_term("Q" + str(i));
+	doc.add_posting(i % 2 ? "odd" : "even", 1);
+	doc.add_value(0, str(i));
+	TEST_EQUAL(db.add_document(doc), Xapian::docid(i));
+    }
+    db.set_metadata("key", "value");
+    // Uncommitted documents are visible to the writer.
+    TEST_EQUAL(db.get_doccount(), 10);
+    TEST_EQUAL(db.get_termfreq("odd"), 5);
+    db.commit();
+
+    Xapian::Database rdb(path);
+    TEST_EQUAL(rdb.get_doccount(), 10);
+    TEST_EQUAL(rdb.get_lastdocid(), 10);
+    TEST_EQUAL(rdb.get_metadata("key"), "value");
+    TEST_EQUAL(rdb.get_document(3).get_data(), "doc 3");
+    TEST(rdb.locked());
+
+    // Update documents in the segment.
+    db.delete_document(2);
+    db.delete_document("Q4");
+    Xapian::Document doc;
+    doc.set_data("new 5");
+    doc.add_term("all");
+    doc.add_term("Q5");
+    doc.add_term("new");
+    doc.add_value(0, "x");
+    db.replace_document(5, doc);
+    TEST_EQUAL(db.replace_document("Q7", doc), 7);
+    TEST_EQUAL(db.get_doccount(), 8);
+    TEST_EQUAL(db.get_document(5).get_data(), "new 5");
+    TEST_EXCEPTION(Xapian::DocNotFoundError, db.get_document(2));
+    TEST_EXCEPTION(Xapian::DocNotFoundError, db.delete_document(4));
+    db.commit();
+
+    TEST(rdb.reopen());
+    TEST_EQUAL(rdb.get_doccount(), 8);
+    TEST_EQUAL(rdb.get_lastdocid(), 10);
+    TEST_EXCEPTION(Xapian::DocNotFoundError, rdb.get_document(4));
+    TEST_EQUAL(rdb.get_document(7).get_data(), "new 5");
+    TEST_EQUAL(rdb.get_doclength(1), 3);
+
+    // Postlists are merged in docid order and skip deleted documents.
+    const Xapian::docid all[] = { 1, 3, 5, 6, 7, 8, 9, 10 };
+    TEST(equal(rdb.postlist_begin("all"), rdb.postlist_end("all"), all));
+    TEST(equal(rdb.postlist_begin(""), rdb.postlist_end(""), all));
+    const Xapian::docid odd[] = { 1, 3, 9 };
+    TEST(equal(rdb.postlist_begin("odd"), rdb.postlist_end("odd"), odd));
+
+    string values;
+    for (auto v = rdb.valuestream_begin(0); v != rdb.valuestream_end(0); ++v) {
+	values += str(v.get_docid());
+	values += '=';
+	values += *v;
+	values += ' ';
+    }
+    TEST_EQUAL(values, "1=1 3=3 5=x 6=6 7=x 8=8 9=9 10=10 ");
+
+    Xapian::Enquire enq(rdb);
+    enq.set_query(Xapian::Query("new"));
+    Xapian::MSet mset = enq.get_mset(0, 10);
+    mset_expect_order(mset, 5, 7);
+
+    // Replacing a docid which has never been used adds it.
+    db.replace_document(20, doc);
+    TEST_EQUAL(db.get_lastdocid(), 20);
+    db.close();
+    TEST(rdb.reopen());
+    TEST_EQUAL(rdb.get_doccount(), 9);
+    TEST_EQUAL(rdb.get_lastdocid(), 20);
+    TEST(!rdb.locked());
+}
+
+/// Check transactions with a segmented honey database.
+DEFINE_TESTCASE(segmented2, honey) {
+    string path = get_compaction_output_path("segmented2");
+    rm_rf(path);
+    Xapian::WritableDatabase db(path, Xapian::DB_BACKEND_HONEY);
+    Xapian::Document doc;
+    doc.add_term("foo");
+    db.add_document(doc);
+    db.add_document(doc);
+    db.commit();
+    Xapian::rev rev = db.get_revision();
+
+    db.begin_transaction();
+    db.delete_document(1);
+    db.add_document(doc);
+    db.set_metadata("key", "value");
+    TEST_EQUAL(db.get_doccount(), 2);
+    db.cancel_transaction();
+    TEST_EQUAL(db.get_doccount(), 2);
+    TEST_EQUAL(db.get_lastdocid(), 2);
+    TEST_EQUAL(db.get_document(1).termlist_count(), 1);
+    TEST_EQUAL(db.get_metadata("key"), "");
+    TEST_EQUAL(db.get_revision(), rev);
+
+    db.begin_transaction();
+    db.delete_document(2);
+    TEST_EQUAL(db.add_document(doc), 3);
+    db.commit_transaction();
+    TEST_EQUAL(db.get_revision(), rev + 1);
+
+    // Opening the database again works, and DB_CREATE refuses to overwrite.
+    db.close();
+    db = Xapian::WritableDatabase(path, Xapian::DB_OPEN);
+    TEST_EQUAL(db.get_doccount(), 2);
+    TEST_EQUAL(db.get_termfreq("foo"), 2);
+    TEST_EXCEPTION(Xapian::DatabaseLockError,
+		   Xapian::WritableDatabase(path, Xapian::DB_BACKEND_HONEY));
+    db.close();
+    TEST_EXCEPTION(Xapian::DatabaseCreateError,
+		   Xapian::WritableDatabase(path,
+					    Xapian::DB_BACKEND_HONEY |
+					    Xapian::DB_CREATE));
+    db = Xapian::WritableDatabase(path, Xapian::DB_BACKEND_HONEY |
+					Xapian::DB_CREATE_OR_OVERWRITE);
+    TEST_EQUAL(db.get_doccount(), 0);
+}
+
+/// Check segments get merged.
+DEFINE_TESTCASE(segmentedmerge1, honey) {
+    string path = get_compaction_output_path("segmentedmerge1");
+    rm_rf(path);
+    EnvGuard merge_factor("XAPIAN_SEGMENT_MERGE_FACTOR", "2");
+    Xapian::WritableDatabase db(path, Xapian::DB_BACKEND_HONEY);
+    merge_factor.unset();
+    // Make a segment per commit, with some documents replaced or deleted so
+    // both ways of merging get used.
+    for (int i = 1; i <= 40; ++i) {
+	Xapian::Document doc;
+	doc.set_data(str(i));
+	doc.add_term("all");
+	doc.add_term("Q" + str(i));
+	doc.add_term("t" + str(i % 3));
+	db.add_document(doc);
+	if (i % 4 == 0) {
+	    db.commit();
+	    if (i % 8 == 0) db.delete_document(i - 5);
+	    if (i % 12 == 0) {
+		doc.set_data("replaced");
+		db.replace_document(i - 6, doc);
+	    }
+	}
+    }
+    db.close();
+
+    Xapian::Database rdb(path);
+    TEST_EQUAL(rdb.get_doccount(), 35);
+    TEST_EQUAL(rdb.get_lastdocid(), 40);
+    Xapian::doccount count = 0;
+    Xapian::docid prev = 0;
+    for (auto i = rdb.postlist_begin("all"); i != rdb.postlist_end("all"); ++i) {
+	Xapian::docid did = *i;
+	TEST_REL(did, >, prev);
+	prev = did;
+	TEST(did % 8 != 3);
+	string data = rdb.get_document(did).get_data();
+	if (did % 12 == 6) {
+	    TEST_EQUAL(data, "replaced");
+	} else {
+	    TEST_EQUAL(data, str(did));
+	}
+	++count;
+    }
+    TEST_EQUAL(count, 35);
+    TEST_EQUAL(rdb.get_termfreq("Q3"), 0);
+    TEST_EQUAL(rdb.get_termfreq("Q4"), 1);
+
+    // With a merge factor of 2 there should be fewer segments than commits.
+    unsigned segments = 0;
+    for (int n = 1; n <= 40; ++n) {
+	if (dir_exists(path + "/seg" + str(n))) ++segments;
+    }
+    TEST_REL(segments, <, 10);
+}
@@ -25,6 +25,7 @@
 #include <xapian.h>
 
 #include "apitest.h"
+#include "str.h"
 #include "testutils.h"
 
 using namespace std;
@@ -104,3 +105,37 @@ DEFINE_TESTCASE(collapsekey6, backend) {
 	}
     }
 }
+
+static void
+gen_collapsekey7_db(Xapian::WritableDatabase& db, const string&)
+{
+    for (Xapian::docid did = 1; did <= 200; ++did) {
+	Xapian::Document doc;
+	doc.add_term("t", did * 37 % 23 + 1);
+	doc.add_term("filler", did % 5 + 1);
+	doc.add_value(0, str(did % 7));
+	db.add_document(doc);
+    }
+}
+
+/** Regression test for collapsing onto an entry which has been dropped.
+ *
+ *  If the entry a new result with the same collapse key would replace had
+ *  already been pushed out of the proto-MSet by higher ranking results, the
+ *  new result used to overwrite an unrelated entry.
+ */
+DEFINE_TESTCASE(collapsekey7, generated) {
+    Xapian::Database db = get_database("collapsekey7", gen_collapsekey7_db);
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("t"));
+    enquire.set_collapse_key(0);
+
+    Xapian::MSet full_mset = enquire.get_mset(0, db.get_doccount());
+    TEST_EQUAL(full_mset.size(), 7);
+    for (Xapian::doccount size = 1; size <= 7; ++size) {
+	tout << "size " << size << endl;
+	Xapian::MSet mset = enquire.get_mset(0, size);
+	TEST_EQUAL(mset.size(), size);
+	TEST(mset_range_is_same(mset, 0, full_mset, 0, size));
+    }
+}
@@ -28,15 +28,19 @@
 
 #include "apitest.h"
 #include "dbcheck.h"
+#include "envguard.h"
 #include "filetests.h"
 #include "msvcignoreinvalidparam.h"
 #include "str.h"
 #include "testsuite.h"
 #include "testutils.h"
 
+#include <algorithm>
 #include <cerrno>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <vector>
 
 #include <sys/types.h>
 #include "safesysstat.h"
@@ -727,3 +731,444 @@ DEFINE_TESTCASE(compact1, compact && writable) {
 
     TEST_EQUAL(Xapian::Database(output).get_doccount(), 3);
 }
+
+/** Compact @a db to honey and check lookups in the output.
+ *
+ *  @a terms should be the sorted terms in @a db, which should have 2000
+ *  documents.
+ */
+static void
+check_compact_honey_index(Xapian::WritableDatabase& db,
+			  const vector<string>& terms,
+			  Xapian::Compactor& compactor)
+{
+    for (int single_file = 0; single_file != 2; ++single_file) {
+	string output = get_compaction_output_path("compacthoneyindex1");
+	rm_rf(output);
+	unlink(output.c_str());
+	int flags = Xapian::DB_BACKEND_HONEY;
+	if (single_file) flags |= Xapian::DBCOMPACT_SINGLE_FILE;
+	db.compact(output, flags, 0, compactor);
+	Xapian::Database out(output);
+	TEST_EQUAL(out.get_doccount(), 2000);
+
+	// Check lookups in a different order to the keys.
+	for (int i = 2000; i > 0; i -= 7) {
+	    TEST_EQUAL(out.get_document(i).get_data(),
+		       db.get_document(i).get_data());
+	}
+	for (size_t i = 0; i < terms.size(); i += 3) {
+	    TEST_EQUAL(out.get_termfreq(terms[i]), 1);
+	}
+	TEST(!out.term_exists("0"));
+	TEST(!out.term_exists("a"));
+	TEST(!out.term_exists("b100"));
+	TEST(!out.term_exists("zz"));
+	TEST(!out.term_exists("\xff"));
+
+	// Check iterating and skipping through the postlist table.
+	Xapian::TermIterator t = out.allterms_begin();
+	for (const string& term : terms) {
+	    TEST(t != out.allterms_end());
+	    TEST_EQUAL(*t, term);
+	    ++t;
+	}
+	TEST(t == out.allterms_end());
+	t = out.allterms_begin();
+	for (size_t i = 0; i < terms.size(); i += 97) {
+	    t.skip_to(terms[i]);
+	    TEST(t != out.allterms_end());
+	    TEST_EQUAL(*t, terms[i]);
+	    // Skip to a term which isn't present.
+	    t.skip_to(terms[i] + "!");
+	    TEST(t != out.allterms_end());
+	    TEST_EQUAL(*t, terms[i + 1]);
+	}
+	t.skip_to("\xff");
+	TEST(t == out.allterms_end());
+    }
+}
+
+/// Check each type of honey table index.
+DEFINE_TESTCASE(compacthoneyindex1, glass) {
+    Xapian::WritableDatabase db = get_writable_database();
+    // Make the tables big enough that the skiplist index has several levels.
+    vector<string> terms;
+    for (unsigned i = 1; i <= 2000; ++i) {
+	Xapian::Document doc;
+	doc.set_data(string(2000, char('a' + i % 26)) + str(i));
+	for (unsigned j = 0; j != 5; ++j) {
+	    string term(1, char('a' + (i + j) % 26));
+	    term += str(i * 5 + j);
+	    doc.add_term(term, j + 1);
+	    terms.push_back(term);
+	}
+	db.add_document(doc);
+    }
+    db.commit();
+    sort(terms.begin(), terms.end());
+
+    static const char* const types[] = {
+	"array", "binarychop", "skiplist", "eytzinger"
+    };
+    Xapian::Compactor default_compactor;
+    for (const char* type : types) {
+	tout << type << '\n';
+	EnvGuard sstindex("XAPIAN_HONEY_SSTINDEX", type);
+	check_compact_honey_index(db, terms, default_compactor);
+
+	tout << type << " via Compactor\n";
+	sstindex.unset();
+	Xapian::Compactor compactor;
+	compactor.set_honey_index_type(type);
+	check_compact_honey_index(db, terms, compactor);
+    }
+
+    {
+	tout << "Per table\n";
+	EnvGuard sstindex("XAPIAN_HONEY_SSTINDEX",
+			  "postlist=skiplist,docdata=binarychop,"
+			  "termlist=eytzinger");
+	check_compact_honey_index(db, terms, default_compactor);
+
+	// The Compactor takes precedence over the environment, and later
+	// calls over earlier ones.
+	tout << "Per table via Compactor\n";
+	Xapian::Compactor compactor;
+	compactor.set_honey_index_type("array");
+	compactor.set_honey_index_type("binarychop", "postlist");
+	compactor.set_honey_index_type("skiplist", "docdata");
+	compactor.set_honey_index_type("eytzinger", "docdata");
+	check_compact_honey_index(db, terms, compactor);
+    }
+
+    string output = get_compaction_output_path("compacthoneyindex1");
+    rm_rf(output);
+    {
+	EnvGuard sstindex("XAPIAN_HONEY_SSTINDEX", "btree");
+	TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		       db.compact(output, Xapian::DB_BACKEND_HONEY));
+    }
+    Xapian::Compactor compactor;
+    compactor.set_honey_index_type("btree", "termlist");
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   db.compact(output, Xapian::DB_BACKEND_HONEY, 0, compactor));
+}
+
+/// Check lookups in the honey database compacthoneybloom1 makes.
+static void
+check_compact_honey_bloom(const Xapian::Database& out)
+{
+    for (unsigned i = 1; i <= 1000; ++i) {
+	string term = "T" + str(i);
+	TEST(out.term_exists(term));
+	TEST_EQUAL(out.get_termfreq(term), 1);
+	TEST(!out.term_exists("U" + str(i)));
+	TEST_EQUAL(out.get_termfreq("U" + str(i)), 0);
+	TEST_EQUAL(out.get_collection_freq("U" + str(i)), 0);
+    }
+    TEST_EQUAL(out.get_termfreq("even0"), 500);
+    TEST(!out.term_exists("even2"));
+    TEST(out.postlist_begin("missing") == out.postlist_end("missing"));
+    TEST(out.synonyms_begin("T1") != out.synonyms_end("T1"));
+    TEST(out.synonyms_begin("T2") == out.synonyms_end("T2"));
+
+    // Check queries which mix present and absent terms.
+    Xapian::Enquire enquire(out);
+    Xapian::Query q(Xapian::Query::OP_OR,
+		    Xapian::Query("T7"),
+		    Xapian::Query("U7"));
+    q = Xapian::Query(Xapian::Query::OP_OR, q, Xapian::Query("T8"));
+    enquire.set_query(q);
+    TEST_EQUAL(enquire.get_mset(0, 10).size(), 2);
+    enquire.set_query(Xapian::Query(Xapian::Query::OP_AND,
+				    Xapian::Query("even1"),
+				    Xapian::Query("U7")));
+    TEST(enquire.get_mset(0, 10).empty());
+}
+
+/// Check Bloom filters in honey tables.
+DEFINE_TESTCASE(compacthoneybloom1, glass) {
+    Xapian::WritableDatabase db = get_writable_database();
+    for (unsigned i = 1; i <= 1000; ++i) {
+	Xapian::Document doc;
+	doc.add_term("T" + str(i));
+	doc.add_term("even" + str(i % 2), i % 3 + 1);
+	db.add_document(doc);
+    }
+    db.add_synonym("T1", "T2");
+    db.commit();
+
+    // Each setting, as for XAPIAN_HONEY_BLOOM_BITS and as the equivalent
+    // Compactor::set_honey_bloom_bits() calls (-1 meaning no call).
+    static const struct {
+	const char* env;
+	int all_bits, postlist_bits, synonym_bits;
+    } settings[] = {
+	{ "", -1, -1, -1 },
+	{ "0", 0, -1, -1 },
+	{ "postlist=16,synonym=10", -1, 16, 10 },
+	{ "1", 1, -1, -1 },
+	{ "0,postlist=12", 0, 12, -1 }
+    };
+    off_t postlist_size = 0, env_size = 0;
+    for (auto& setting : settings) {
+	for (int use_api = 0; use_api != 2; ++use_api) {
+	    tout << "XAPIAN_HONEY_BLOOM_BITS=" << setting.env
+		 << (use_api ? " via Compactor" : "") << '\n';
+	    EnvGuard bloom_bits("XAPIAN_HONEY_BLOOM_BITS", "");
+	    Xapian::Compactor compactor;
+	    if (use_api) {
+		if (setting.all_bits >= 0)
+		    compactor.set_honey_bloom_bits(setting.all_bits);
+		if (setting.postlist_bits >= 0)
+		    compactor.set_honey_bloom_bits(setting.postlist_bits,
+						   "postlist");
+		if (setting.synonym_bits >= 0)
+		    compactor.set_honey_bloom_bits(setting.synonym_bits,
+						   "synonym");
+		// The Compactor takes precedence over the environment.
+		if (setting.all_bits >= 0 || setting.postlist_bits >= 0)
+		    bloom_bits.set("postlist=64");
+	    } else {
+		bloom_bits.set(setting.env);
+	    }
+	    for (int single_file = 0; single_file != 2; ++single_file) {
+		string output =
+		    get_compaction_output_path("compacthoneybloom1");
+		rm_rf(output);
+		unlink(output.c_str());
+		int flags = Xapian::DB_BACKEND_HONEY;
+		if (single_file) flags |= Xapian::DBCOMPACT_SINGLE_FILE;
+		db.compact(output, flags, 0, compactor);
+		if (!single_file) {
+		    off_t size = file_size(output + "/postlist.honey");
+		    if (use_api) {
+			// The equivalent Compactor settings should give the
+			// same postlist table.
+			TEST_EQUAL(size, env_size);
+		    } else if (*setting.env == '\0') {
+			postlist_size = size;
+		    } else if (strcmp(setting.env, "0") == 0) {
+			// The filter should make the postlist table larger.
+			TEST_REL(size, <, postlist_size);
+		    }
+		    env_size = size;
+		}
+		check_compact_honey_bloom(Xapian::Database(output));
+	    }
+	}
+    }
+
+    string output = get_compaction_output_path("compacthoneybloom1");
+    rm_rf(output);
+    unlink(output.c_str());
+    {
+	EnvGuard bloom_bits("XAPIAN_HONEY_BLOOM_BITS", "lots");
+	TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		       db.compact(output, Xapian::DB_BACKEND_HONEY));
+	bloom_bits.set("postlist=65");
+	TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		       db.compact(output, Xapian::DB_BACKEND_HONEY));
+    }
+    Xapian::Compactor compactor;
+    compactor.set_honey_bloom_bits(65, "postlist");
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   db.compact(output, Xapian::DB_BACKEND_HONEY, 0, compactor));
+}
+
+/// Check @a db has the same postings as @a ref for the compactbitmap1 terms.
+static void
+check_bitmap_postings(const Xapian::Database& db, const Xapian::Database& ref)
+{
+    static const char* const terms[] = {
+	"all", "dense", "flat", "mixed", "sparse", "varied"
+    };
+    TEST_EQUAL(db.get_doccount(), ref.get_doccount());
+    Xapian::docid last_did = ref.get_lastdocid();
+    for (const char* term : terms) {
+	tout << term << '\n';
+	TEST_EQUAL(db.get_termfreq(term), ref.get_termfreq(term));
+	TEST_EQUAL(db.get_collection_freq(term), ref.get_collection_freq(term));
+	Xapian::PostingIterator p = db.postlist_begin(term);
+	Xapian::PostingIterator r = ref.postlist_begin(term);
+	while (r != ref.postlist_end(term)) {
+	    TEST(p != db.postlist_end(term));
+	    TEST_EQUAL(*p, *r);
+	    TEST_EQUAL(p.get_wdf(), r.get_wdf());
+	    ++p;
+	    ++r;
+	}
+	TEST(p == db.postlist_end(term));
+
+	for (Xapian::docid step : { 1, 7, 61, 500 }) {
+	    p = db.postlist_begin(term);
+	    r = ref.postlist_begin(term);
+	    for (Xapian::docid did = 1; did <= last_did + 1; did += step) {
+		p.skip_to(did);
+		r.skip_to(did);
+		if (r == ref.postlist_end(term)) {
+		    TEST(p == db.postlist_end(term));
+		    break;
+		}
+		TEST(p != db.postlist_end(term));
+		TEST_EQUAL(*p, *r);
+		TEST_EQUAL(p.get_wdf(), r.get_wdf());
+	    }
+	}
+    }
+
+    Xapian::Query queries[] = {
+	Xapian::Query(Xapian::Query::OP_AND,
+		      Xapian::Query("dense"), Xapian::Query("flat")),
+	Xapian::Query(Xapian::Query::OP_AND,
+		      Xapian::Query("mixed"), Xapian::Query("all")),
+	Xapian::Query(Xapian::Query::OP_FILTER,
+		      Xapian::Query("varied"), Xapian::Query("dense")),
+	Xapian::Query(Xapian::Query::OP_FILTER,
+		      Xapian::Query("sparse"), Xapian::Query("mixed")),
+	Xapian::Query(Xapian::Query::OP_AND_NOT,
+		      Xapian::Query("all"), Xapian::Query("dense")),
+	Xapian::Query(Xapian::Query::OP_AND_NOT,
+		      Xapian::Query("flat"), Xapian::Query("mixed"))
+    };
+    Xapian::Enquire enquire(db);
+    Xapian::Enquire ref_enquire(ref);
+    enquire.set_docid_order(Xapian::Enquire::ASCENDING);
+    ref_enquire.set_docid_order(Xapian::Enquire::ASCENDING);
+    for (auto& query : queries) {
+	tout << query.get_description() << '\n';
+	enquire.set_query(query);
+	ref_enquire.set_query(query);
+	Xapian::MSet mset = enquire.get_mset(0, last_did);
+	Xapian::MSet ref_mset = ref_enquire.get_mset(0, last_did);
+	TEST_EQUAL(mset.size(), ref_mset.size());
+	for (Xapian::doccount i = 0; i != mset.size(); ++i) {
+	    TEST_EQUAL(*mset[i], *ref_mset[i]);
+	}
+    }
+}
+
+/// Add documents to a database for compactbitmap1.
+static void
+add_bitmap_docs(Xapian::WritableDatabase& db, Xapian::docid first,
+		Xapian::docid last)
+{
+    for (Xapian::docid did = first; did <= last; ++did) {
+	Xapian::Document doc;
+	doc.add_boolean_term("all");
+	if (did % 10 != 3) doc.add_boolean_term("dense");
+	if (did % 3 != 0) doc.add_term("flat", 2);
+	if (did % 2) doc.add_term("varied", did % 4 + 1);
+	if (did % 97 == 0) doc.add_boolean_term("sparse");
+	if (did < 3000 ? did % 5 != 0 : did % 50 == 0)
+	    doc.add_boolean_term("mixed");
+	db.replace_document(did, doc);
+    }
+}
+
+/// Check compaction storing dense posting lists as bitmaps.
+DEFINE_TESTCASE(compactbitmap1, glass) {
+    Xapian::WritableDatabase db = get_writable_database();
+    add_bitmap_docs(db, 1, 5000);
+    db.commit();
+
+    string output = get_compaction_output_path("compactbitmap1");
+    rm_rf(output);
+    db.compact(output);
+    TEST_EQUAL(Xapian::Database::check(output, 0, &tout), 0);
+    check_bitmap_postings(Xapian::Database(output), db);
+
+    string honey_output = get_compaction_output_path("compactbitmap1honey");
+    rm_rf(honey_output);
+    db.compact(honey_output, Xapian::DB_BACKEND_HONEY);
+    check_bitmap_postings(Xapian::Database(honey_output), db);
+
+    // Compacting the compacted database should give the same postings.
+    string output2 = get_compaction_output_path("compactbitmap1b");
+    rm_rf(output2);
+    Xapian::Database(output).compact(output2);
+    check_bitmap_postings(Xapian::Database(output2), db);
+    rm_rf(honey_output);
+    Xapian::Database(output).compact(honey_output, Xapian::DB_BACKEND_HONEY);
+    check_bitmap_postings(Xapian::Database(honey_output), db);
+
+    // Check updating a database with bitmap chunks.
+    Xapian::WritableDatabase wdb(output, Xapian::DB_OPEN);
+    for (Xapian::WritableDatabase* w : { &db, &wdb }) {
+	add_bitmap_docs(*w, 4900, 5100);
+	for (Xapian::docid did = 1000; did <= 1500; did += 3)
+	    w->delete_document(did);
+	w->commit();
+    }
+    check_bitmap_postings(wdb, db);
+    wdb.close();
+    TEST_EQUAL(Xapian::Database::check(output, 0, &tout), 0);
+    check_bitmap_postings(Xapian::Database(output), db);
+}
+
+/// Check converting glass values in slots which pack_uint() doesn't sort.
+DEFINE_TESTCASE(compacthoneyvalues1, glass) {
+    static const Xapian::valueno slots[] = {
+	0, 1, 7, 8, 127, 128, 129, 255, 256, 257, 1000, 16383, 16384, 70000
+    };
+    Xapian::WritableDatabase db = get_writable_database();
+    for (Xapian::docid did = 1; did <= 500; ++did) {
+	Xapian::Document doc;
+	for (Xapian::valueno slot : slots) {
+	    if ((did + slot) % 3 != 0)
+		doc.add_value(slot, str(slot) + ":" + str(did));
+	}
+	db.add_document(doc);
+    }
+    db.commit();
+
+    string output = get_compaction_output_path("compacthoneyvalues1");
+    rm_rf(output);
+    db.compact(output, Xapian::DB_BACKEND_HONEY);
+
+    // Merging two glass databases interleaves the value chunks for each slot
+    // from both.
+    string output2 = get_compaction_output_path("compacthoneyvalues1b");
+    rm_rf(output2);
+    Xapian::Database two(db);
+    two.add_database(db);
+    two.compact(output2, Xapian::DB_BACKEND_HONEY);
+
+    Xapian::Database out(output);
+    Xapian::Database out2(output2);
+    TEST_EQUAL(out2.get_doccount(), 1000);
+    for (Xapian::valueno slot : slots) {
+	TEST_EQUAL(out.get_value_freq(slot), db.get_value_freq(slot));
+	TEST_EQUAL(out.get_value_lower_bound(slot),
+		   db.get_value_lower_bound(slot));
+	TEST_EQUAL(out.get_value_upper_bound(slot),
+		   db.get_value_upper_bound(slot));
+	TEST_EQUAL(out2.get_value_freq(slot), 2 * db.get_value_freq(slot));
+	Xapian::ValueIterator v = db.valuestream_begin(slot);
+	Xapian::ValueIterator v1 = out.valuestream_begin(slot);
+	Xapian::ValueIterator v2 = out2.valuestream_begin(slot);
+	while (v != db.valuestream_end(slot)) {
+	    TEST(v1 != out.valuestream_end(slot));
+	    TEST_EQUAL(v1.get_docid(), v.get_docid());
+	    TEST_EQUAL(*v1, *v);
+	    TEST(v2 != out2.valuestream_end(slot));
+	    TEST_EQUAL(v2.get_docid(), v.get_docid());
+	    TEST_EQUAL(*v2, *v);
+	    ++v;
+	    ++v1;
+	    ++v2;
+	}
+	TEST(v1 == out.valuestream_end(slot));
+	// The second copy has the docids offset by 500.
+	for (v = db.valuestream_begin(slot); v != db.valuestream_end(slot);
+	     ++v) {
+	    TEST(v2 != out2.valuestream_end(slot));
+	    TEST_EQUAL(v2.get_docid(), v.get_docid() + 500);
+	    TEST_EQUAL(*v2, *v);
+	    ++v2;
+	}
+	TEST(v2 == out2.valuestream_end(slot));
+    }
+    TEST_EQUAL(out.get_document(4).get_value(70000), "70000:4");
+}
@@ -1385,7 +1385,7 @@ DEFINE_TESTCASE(databasenotfounderror1, glass || honey) {
     int db_type_flag;
     if (dbtype == "glass") {
 	db_type_flag = Xapian::DB_BACKEND_GLASS;
-    } else if (dbtype == "honey") {
+    } else if (dbtype == "honey" || dbtype == "honey_segmented") {
 	db_type_flag = Xapian::DB_BACKEND_HONEY;
     } else {
 	FAIL_TEST("Backend " + dbtype + " not handled by testcase");
@@ -1396,7 +1396,7 @@ DEFINE_TESTCASE(databasenotfounderror1, glass || honey) {
 
     TEST_EXCEPTION(Xapian::DatabaseNotFoundError,
 	    Xapian::Database(db_dir + "nosuchdirectory", db_type_flag));
-    if (db_type_flag != Xapian::DB_BACKEND_HONEY) {
+    if (dbtype != "honey") {
 	TEST_EXCEPTION(Xapian::DatabaseNotFoundError,
 		Xapian::WritableDatabase(db_dir + "nosuchdirectory",
 		    db_type_flag | Xapian::DB_OPEN));
@@ -1411,7 +1411,7 @@ DEFINE_TESTCASE(databasenotfounderror1, glass || honey) {
     touch(some_file);
     TEST_EXCEPTION(Xapian::DatabaseNotFoundError,
 	    Xapian::Database(some_file, db_type_flag));
-    if (db_type_flag != Xapian::DB_BACKEND_HONEY) {
+    if (dbtype != "honey") {
 	TEST_EXCEPTION(Xapian::DatabaseNotFoundError,
 		Xapian::WritableDatabase(some_file,
 		    db_type_flag | Xapian::DB_OPEN));
@@ -0,0 +1,244 @@
+/** @file
+ * @brief Tests of Xapian::FilterCache.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "api_filtercache.h"
+
+#include <xapian.h>
+
+#include "apitest.h"
+#include "envguard.h"
+#include "str.h"
+#include "testsuite.h"
+#include "testutils.h"
+
+#include <string>
+
+using namespace std;
+
+static void
+make_filtercache_db(Xapian::WritableDatabase& db, const string&)
+{
+    for (unsigned i = 1; i <= 300; ++i) {
+	Xapian::Document doc;
+	doc.add_term("all");
+	doc.add_term(i % 2 ? "odd" : "even");
+	doc.add_term("mod7_" + str(i % 7));
+	// Sparse enough to be stored as an array of docids.
+	if (i % 100 == 0) doc.add_term("rare");
+	if (i % 3 == 0) doc.add_term("fizz", i % 5 + 1);
+	db.add_document(doc);
+    }
+}
+
+/// Check that two MSet objects contain the same documents and weights.
+static void
+check_same_matches(const Xapian::MSet& a, const Xapian::MSet& b)
+{
+    TEST_EQUAL(a.size(), b.size());
+    for (Xapian::MSetIterator i = a.begin(), j = b.begin();
+	 i != a.end();
+	 ++i, ++j) {
+	TEST_EQUAL(*i, *j);
+	TEST_EQUAL_DOUBLE(i.get_weight(), j.get_weight());
+    }
+}
+
+/// Check filters are cached once used enough, and results don't change.
+DEFINE_TESTCASE(filtercache1, generated && !inmemory && !remote) {
+    Xapian::Database db = get_database("filtercache", make_filtercache_db);
+    static const Xapian::Query filters[] = {
+	Xapian::Query("even"),
+	Xapian::Query("rare"),
+	Xapian::Query(Xapian::Query::OP_OR,
+		      Xapian::Query("mod7_1"), Xapian::Query("rare")),
+	Xapian::Query(Xapian::Query::OP_AND_NOT,
+		      Xapian::Query("odd"), Xapian::Query("mod7_3")),
+	Xapian::Query("nosuchterm"),
+    };
+    for (const Xapian::Query& filter : filters) {
+	Xapian::Query query(Xapian::Query::OP_FILTER,
+			    Xapian::Query("fizz"), filter);
+	Xapian::Enquire enq(db);
+	enq.set_query(query);
+	Xapian::MSet uncached = enq.get_mset(0, 300);
+
+	Xapian::FilterCache cache;
+	TEST(cache.empty());
+	enq.set_filter_cache(cache);
+
+	// The first use is just counted.
+	check_same_matches(enq.get_mset(0, 300), uncached);
+	TEST(cache.empty());
+	TEST_EQUAL(cache.get_hits(), 0);
+	auto misses = cache.get_misses();
+	TEST_REL(misses, >, 0);
+
+	// The second use builds the cached docid set.
+	check_same_matches(enq.get_mset(0, 300), uncached);
+	TEST_EQUAL(cache.get_hits(), 0);
+	TEST_EQUAL(cache.get_misses(), misses * 2);
+	TEST_EQUAL(cache.size(), misses);
+	TEST_REL(cache.get_memory_used(), >, 0);
+
+	// Now the cached docid set is used.
+	check_same_matches(enq.get_mset(0, 300), uncached);
+	TEST_EQUAL(cache.get_misses(), misses * 2);
+	TEST_EQUAL(cache.get_hits(), misses);
+
+	// The cache can be shared by another Enquire.
+	Xapian::Enquire enq2(db);
+	enq2.set_query(Xapian::Query(Xapian::Query::OP_FILTER,
+				     Xapian::Query("all"), filter));
+	enq2.set_filter_cache(cache);
+	Xapian::MSet mset = enq2.get_mset(0, 300);
+	TEST_EQUAL(cache.get_hits(), misses * 2);
+	enq2.clear_filter_cache();
+	check_same_matches(enq2.get_mset(0, 300), mset);
+	TEST_EQUAL(cache.get_hits(), misses * 2);
+
+	// Filtering by a filter works too.
+	enq.set_query(Xapian::Query(Xapian::Query::OP_FILTER,
+				    Xapian::Query("fizz"),
+				    Xapian::Query(Xapian::Query::OP_FILTER,
+						  Xapian::Query("all"),
+						  filter)));
+	check_same_matches(enq.get_mset(0, 300), uncached);
+
+	// And when matching in parallel.
+	enq.set_match_threads(4);
+	check_same_matches(enq.get_mset(0, 300), uncached);
+	enq.set_match_threads(0);
+
+	auto hits = cache.get_hits();
+	cache.clear();
+	TEST(cache.empty());
+	TEST_EQUAL(cache.get_memory_used(), 0);
+	TEST_EQUAL(cache.get_hits(), hits);
+    }
+}
+
+/// Check the least recently used entries are evicted when the cache is full.
+DEFINE_TESTCASE(filtercache2, generated && !inmemory && !remote) {
+    Xapian::Database db = get_database("filtercache", make_filtercache_db);
+    Xapian::FilterCache cache(2000, 1);
+    Xapian::Enquire enq(db);
+    enq.set_filter_cache(cache);
+    for (int round = 0; round != 2; ++round) {
+	for (unsigned i = 0; i != 7; ++i) {
+	    Xapian::Query filter("mod7_" + str(i));
+	    Xapian::Query query(Xapian::Query::OP_FILTER,
+				Xapian::Query("fizz"), filter);
+	    enq.set_query(query);
+	    Xapian::MSet mset = enq.get_mset(0, 300);
+	    enq.clear_filter_cache();
+	    check_same_matches(mset, enq.get_mset(0, 300));
+	    enq.set_filter_cache(cache);
+	    TEST_REL(cache.get_memory_used(), <=, 2000);
+	}
+    }
+    TEST_REL(cache.get_evictions(), >, 0);
+    TEST_REL(cache.size(), <, 7 * db.size());
+    tout << cache.get_description() << '\n';
+
+    // Nothing is cached if the entries won't fit at all.
+    Xapian::FilterCache tiny_cache(10, 1);
+    enq.set_filter_cache(tiny_cache);
+    enq.set_query(Xapian::Query(Xapian::Query::OP_FILTER,
+				Xapian::Query("fizz"), Xapian::Query("even")));
+    (void)enq.get_mset(0, 10);
+    (void)enq.get_mset(0, 10);
+    TEST(tiny_cache.empty());
+    TEST_EQUAL(tiny_cache.get_hits(), 0);
+    TEST_EQUAL(tiny_cache.get_memory_used(), 0);
+}
+
+/// Check filters are cached per revision and aren't for a writable database.
+DEFINE_TESTCASE(filtercache3, writable && !inmemory && !remote && !multi) {
+    Xapian::WritableDatabase db = get_writable_database();
+    Xapian::Document doc;
+    doc.add_term("foo");
+    doc.add_term("bar");
+    db.add_document(doc);
+    db.commit();
+
+    Xapian::Query query(Xapian::Query::OP_FILTER,
+			Xapian::Query("foo"), Xapian::Query("bar"));
+    Xapian::FilterCache cache(1024 * 1024, 1);
+    Xapian::Enquire wenq(db);
+    wenq.set_query(query);
+    wenq.set_filter_cache(cache);
+    TEST_EQUAL(wenq.get_mset(0, 10).size(), 1);
+    TEST_EQUAL(cache.get_misses(), 0);
+    TEST(cache.empty());
+
+    Xapian::Database rodb = get_writable_database_as_database();
+    Xapian::Enquire enq(rodb);
+    enq.set_query(query);
+    enq.set_filter_cache(cache);
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 1);
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 1);
+    TEST_EQUAL(cache.get_hits(), 1);
+    TEST_EQUAL(cache.get_misses(), 1);
+
+    db.add_document(doc);
+    db.commit();
+    TEST(rodb.reopen());
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 2);
+    TEST_EQUAL(cache.get_hits(), 1);
+    TEST_EQUAL(cache.get_misses(), 2);
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 2);
+    TEST_EQUAL(cache.get_hits(), 2);
+}
+
+/// Check intersecting decoded blocks of docids doesn't change the results.
+DEFINE_TESTCASE(andblocks1, generated && !inmemory && !remote) {
+    Xapian::Database db = get_database("filtercache", make_filtercache_db);
+    static const Xapian::Query queries[] = {
+	Xapian::Query(Xapian::Query::OP_AND,
+		      Xapian::Query("fizz"), Xapian::Query("even")),
+	Xapian::Query(Xapian::Query::OP_AND,
+		      Xapian::Query(Xapian::Query::OP_AND,
+				    Xapian::Query("odd"),
+				    Xapian::Query("mod7_3")),
+		      Xapian::Query("fizz")),
+	Xapian::Query(Xapian::Query::OP_FILTER,
+		      Xapian::Query("fizz"), Xapian::Query("rare")),
+	Xapian::Query(Xapian::Query::OP_FILTER,
+		      Xapian::Query("all"), Xapian::Query("mod7_1")),
+	Xapian::Query(Xapian::Query::OP_FILTER,
+		      Xapian::Query("rare"), Xapian::Query("odd")),
+    };
+    Xapian::FilterCache cache(1024 * 1024, 1);
+    Xapian::Enquire enq(db);
+    for (const Xapian::Query& query : queries) {
+	enq.set_query(query);
+	enq.clear_filter_cache();
+	Xapian::MSet expected = enq.get_mset(0, 300);
+
+	EnvGuard blocks("XAPIAN_AND_DOCID_BLOCKS", "1");
+	check_same_matches(enq.get_mset(0, 300), expected);
+	// Also with the filters cached, once used enough to be cached.
+	enq.set_filter_cache(cache);
+	for (int i = 0; i != 3; ++i) {
+	    check_same_matches(enq.get_mset(0, 300), expected);
+	}
+    }
+}
@@ -0,0 +1,283 @@
+/** @file
+ * @brief Tests of Xapian::MSetCache.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "api_msetcache.h"
+
+#include <xapian.h>
+
+#include "apitest.h"
+#include "testsuite.h"
+#include "testutils.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/// Check that two MSet objects contain the same results.
+static void
+check_same_mset(const Xapian::MSet& a, const Xapian::MSet& b)
+{
+    TEST_EQUAL(a.size(), b.size());
+    TEST_EQUAL(a.get_firstitem(), b.get_firstitem());
+    TEST_EQUAL(a.get_matches_lower_bound(), b.get_matches_lower_bound());
+    TEST_EQUAL(a.get_matches_estimated(), b.get_matches_estimated());
+    TEST_EQUAL(a.get_matches_upper_bound(), b.get_matches_upper_bound());
+    TEST_EQUAL(a.get_max_possible(), b.get_max_possible());
+    TEST_EQUAL(a.get_max_attained(), b.get_max_attained());
+    for (Xapian::MSetIterator i = a.begin(), j = b.begin();
+	 i != a.end();
+	 ++i, ++j) {
+	TEST_EQUAL(*i, *j);
+	TEST_EQUAL(i.get_weight(), j.get_weight());
+	TEST_EQUAL(i.get_percent(), j.get_percent());
+	TEST_EQUAL(i.get_document().get_data(), j.get_document().get_data());
+    }
+}
+
+/// Check repeated searches are answered from the cache.
+DEFINE_TESTCASE(msetcache1, backend && !inmemory) {
+    Xapian::Database db = get_database("apitest_simpledata");
+    Xapian::Query query(Xapian::Query::OP_OR,
+			Xapian::Query("this"), Xapian::Query("paragraph"));
+
+    Xapian::Enquire enq(db);
+    enq.set_query(query);
+    Xapian::MSet uncached = enq.get_mset(0, 10);
+
+    Xapian::MSetCache cache;
+    TEST(cache.empty());
+    enq.set_mset_cache(cache);
+
+    Xapian::MSet mset1 = enq.get_mset(0, 10);
+    TEST_EQUAL(cache.get_hits(), 0);
+    TEST_EQUAL(cache.get_misses(), 1);
+    TEST_EQUAL(cache.size(), 1);
+    check_same_mset(mset1, uncached);
+
+    Xapian::MSet mset2 = enq.get_mset(0, 10);
+    TEST_EQUAL(cache.get_hits(), 1);
+    TEST_EQUAL(cache.get_misses(), 1);
+    check_same_mset(mset2, uncached);
+    TEST_EQUAL(mset2.get_termfreq("this"), uncached.get_termfreq("this"));
+    TEST_EQUAL(mset2.get_termweight("paragraph"),
+	       uncached.get_termweight("paragraph"));
+
+    // A different page of results isn't the same search.
+    Xapian::MSet mset3 = enq.get_mset(1, 10);
+    TEST_EQUAL(cache.get_hits(), 1);
+    TEST_EQUAL(cache.get_misses(), 2);
+    TEST_EQUAL(mset3.get_firstitem(), 1);
+    TEST_EQUAL(*mset3.begin(), *mset1[1]);
+
+    // Nor is a different query.
+    enq.set_query(Xapian::Query("this"));
+    (void)enq.get_mset(0, 10);
+    TEST_EQUAL(cache.get_hits(), 1);
+    TEST_EQUAL(cache.get_misses(), 3);
+    TEST_EQUAL(cache.size(), 3);
+
+    // Nor a different weighting scheme.
+    enq.set_query(query);
+    enq.set_weighting_scheme(Xapian::TradWeight());
+    (void)enq.get_mset(0, 10);
+    TEST_EQUAL(cache.get_hits(), 1);
+    TEST_EQUAL(cache.get_misses(), 4);
+
+    // The cache can be shared between Enquire objects.
+    Xapian::Enquire enq2(db);
+    enq2.set_query(query);
+    enq2.set_mset_cache(cache);
+    Xapian::MSet mset4 = enq2.get_mset(0, 10);
+    TEST_EQUAL(cache.get_hits(), 2);
+    TEST_EQUAL(cache.get_misses(), 4);
+    check_same_mset(mset4, uncached);
+
+    // Asking for results past the end gets the right firstitem.
+    Xapian::doccount past_end = db.get_doccount() + 5;
+    TEST_EQUAL(enq2.get_mset(past_end, 10).get_firstitem(), past_end);
+    TEST_EQUAL(enq2.get_mset(past_end, 10).get_firstitem(), past_end);
+    TEST_EQUAL(cache.get_hits(), 3);
+
+    enq2.clear_mset_cache();
+    (void)enq2.get_mset(0, 10);
+    TEST_EQUAL(cache.get_hits(), 3);
+    TEST_EQUAL(cache.get_misses(), 5);
+
+    TEST(!cache.empty());
+    cache.clear();
+    TEST(cache.empty());
+    TEST_EQUAL(cache.get_hits(), 3);
+}
+
+/// Check searches which can't be cached aren't.
+DEFINE_TESTCASE(msetcache2, backend && !inmemory) {
+    Xapian::Database db = get_database("apitest_simpledata");
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query("this"));
+    Xapian::MSetCache cache;
+    enq.set_mset_cache(cache);
+
+    Xapian::ValueCountMatchSpy spy(1);
+    enq.add_matchspy(&spy);
+    (void)enq.get_mset(0, 10);
+    (void)enq.get_mset(0, 10);
+    TEST_EQUAL(cache.get_hits(), 0);
+    TEST_EQUAL(cache.get_misses(), 0);
+    TEST(cache.empty());
+    enq.clear_matchspies();
+
+    Xapian::ValueSetMatchDecider decider(1, true);
+    try {
+	(void)enq.get_mset(0, 10, 0, NULL, &decider);
+    } catch (const Xapian::UnimplementedError&) {
+	// MatchDecider isn't supported by the remote backend.
+    }
+    TEST_EQUAL(cache.get_misses(), 0);
+
+    Xapian::RSet rset;
+    rset.add_document(1);
+    (void)enq.get_mset(0, 10, &rset);
+    (void)enq.get_mset(0, 10, &rset);
+    TEST_EQUAL(cache.get_hits(), 1);
+    TEST_EQUAL(cache.get_misses(), 1);
+    // A different RSet is a different search.
+    rset.add_document(2);
+    (void)enq.get_mset(0, 10, &rset);
+    TEST_EQUAL(cache.get_misses(), 2);
+
+    // Results which don't fit aren't stored.
+    Xapian::MSetCache tiny_cache(1);
+    enq.set_mset_cache(tiny_cache);
+    (void)enq.get_mset(0, 10);
+    (void)enq.get_mset(0, 10);
+    TEST_EQUAL(tiny_cache.get_hits(), 0);
+    TEST_EQUAL(tiny_cache.get_misses(), 2);
+    TEST(tiny_cache.empty());
+}
+
+/// Check results are cached per revision and aren't for a writable database.
+DEFINE_TESTCASE(msetcache3, writable && !inmemory) {
+    Xapian::WritableDatabase db = get_writable_database();
+    Xapian::Document doc;
+    doc.add_term("foo");
+    db.add_document(doc);
+    db.commit();
+
+    Xapian::MSetCache cache;
+    Xapian::Enquire wenq(db);
+    wenq.set_query(Xapian::Query("foo"));
+    wenq.set_mset_cache(cache);
+    TEST_EQUAL(wenq.get_mset(0, 10).size(), 1);
+    TEST_EQUAL(wenq.get_mset(0, 10).size(), 1);
+    TEST_EQUAL(cache.get_misses(), 0);
+    TEST(cache.empty());
+
+    Xapian::Database rodb = get_writable_database_as_database();
+    Xapian::Enquire enq(rodb);
+    enq.set_query(Xapian::Query("foo"));
+    enq.set_mset_cache(cache);
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 1);
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 1);
+    TEST_EQUAL(cache.get_hits(), 1);
+    TEST_EQUAL(cache.get_misses(), 1);
+
+    db.add_document(doc);
+    db.commit();
+    // Not reopened yet, so the old results are still valid.
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 1);
+    TEST_EQUAL(cache.get_hits(), 2);
+
+    TEST(rodb.reopen());
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 2);
+    TEST_EQUAL(cache.get_hits(), 2);
+    TEST_EQUAL(cache.get_misses(), 2);
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 2);
+    TEST_EQUAL(cache.get_hits(), 3);
+}
+
+/// Check an MSetCache can be shared by searches in different threads.
+DEFINE_TESTCASE(msetcache4, path && !inmemory) {
+    Xapian::Database db = get_database("apitest_simpledata");
+    string db_path = get_database_path("apitest_simpledata");
+    static const char* const terms[] = {
+	"this", "paragraph", "word", "simple", "test", "is", "a", "the"
+    };
+    const size_t n_terms = sizeof(terms) / sizeof(terms[0]);
+
+    // Get the expected results without a cache.
+    vector<Xapian::MSet> expected;
+    Xapian::Enquire enq(db);
+    for (size_t i = 0; i != n_terms; ++i) {
+	enq.set_query(Xapian::Query(terms[i]));
+	expected.push_back(enq.get_mset(0, 10));
+    }
+
+    // A cache too small to hold all the results, so entries get discarded
+    // as well as found and added.
+    Xapian::MSetCache cache(4096);
+    const unsigned n_threads = 4;
+    const unsigned n_searches = 500;
+    vector<string> errors(n_threads);
+    vector<thread> threads;
+    for (unsigned t = 0; t != n_threads; ++t) {
+	threads.emplace_back([&, t]() {
+	    try {
+		// Database and Enquire objects can't be shared between
+		// threads, so each thread opens its own.
+		Xapian::Database thread_db(db_path);
+		Xapian::Enquire thread_enq(thread_db);
+		thread_enq.set_mset_cache(cache);
+		for (unsigned n = 0; n != n_searches; ++n) {
+		    size_t i = (n * 7 + t) % n_terms;
+		    thread_enq.set_query(Xapian::Query(terms[i]));
+		    Xapian::MSet mset = thread_enq.get_mset(0, 10);
+		    const Xapian::MSet& e = expected[i];
+		    if (mset.size() != e.size() ||
+			mset.get_matches_estimated() !=
+			    e.get_matches_estimated()) {
+			errors[t] = "wrong results for " + string(terms[i]);
+			return;
+		    }
+		    for (Xapian::doccount j = 0; j != mset.size(); ++j) {
+			if (mset[j] != e[j] ||
+			    mset[j].get_weight() != e[j].get_weight()) {
+			    errors[t] = "wrong results for " + string(terms[i]);
+			    return;
+			}
+		    }
+		}
+	    } catch (const Xapian::Error& err) {
+		errors[t] = err.get_description();
+	    }
+	});
+    }
+    for (auto& th : threads) {
+	th.join();
+    }
+    for (auto& error : errors) {
+	TEST_EQUAL(error, string());
+    }
+    TEST_EQUAL(cache.get_hits() + cache.get_misses(),
+	       n_threads * n_searches);
+    TEST(cache.get_hits() > 0);
+}
@@ -28,10 +28,12 @@
 #include <xapian.h>
 
 #include "apitest.h"
+#include "str.h"
 #include "testsuite.h"
 #include "testutils.h"
 
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -415,3 +417,90 @@ DEFINE_TESTCASE(valuerangematchesub1, backend) {
     // proportional to the possible range.
     TEST_REL(mset.get_matches_estimated(), <=, db.get_doccount() / 3);
 }
+
+/// Value in @a slot for document @a did in the valuerangechunks1 database.
+static string
+chunks_value(Xapian::valueno slot, Xapian::docid did)
+{
+    if (slot == 0) return str(100000 + did);
+    return did % 7 == 0 ? str(did) : string();
+}
+
+/// Check value range queries against the valuerangechunks1 database.
+static void
+check_value_ranges(const Xapian::Database& db, Xapian::docid last_did)
+{
+    static const struct {
+	Xapian::valueno slot;
+	const char* lo;
+	const char* hi;
+    } ranges[] = {
+	{ 0, "101000", "101099" },
+	{ 0, "100500", "100500" },
+	{ 0, "102990", "zzz" },
+	{ 0, "0", "100010" },
+	{ 0, "103001", "2" },
+	{ 1, "10", "20" },
+	{ 1, "9", "9z" },
+	{ 1, "5", "5" }
+    };
+    Xapian::Enquire enq(db);
+    for (auto& r : ranges) {
+	const string lo(r.lo), hi(r.hi);
+	Xapian::Query queries[] = {
+	    Xapian::Query(Xapian::Query::OP_VALUE_RANGE, r.slot, lo, hi),
+	    Xapian::Query(Xapian::Query::OP_VALUE_GE, r.slot, lo),
+	    Xapian::Query(Xapian::Query::OP_VALUE_LE, r.slot, hi),
+	    Xapian::Query(Xapian::Query::OP_AND,
+			  Xapian::Query("even"),
+			  Xapian::Query(Xapian::Query::OP_VALUE_RANGE, r.slot,
+					lo, hi))
+	};
+	for (int q = 0; q != 4; ++q) {
+	    tout << queries[q].get_description() << '\n';
+	    vector<Xapian::docid> expected;
+	    for (Xapian::docid did = 1; did <= last_did; ++did) {
+		const string v = chunks_value(r.slot, did);
+		if (v.empty()) continue;
+		if (q != 2 && v < lo) continue;
+		if (q != 1 && v > hi) continue;
+		if (q == 3 && did % 2) continue;
+		expected.push_back(did);
+	    }
+	    enq.set_query(queries[q]);
+	    enq.set_docid_order(Xapian::Enquire::ASCENDING);
+	    Xapian::MSet mset = enq.get_mset(0, last_did);
+	    TEST_EQUAL(mset.size(), expected.size());
+	    for (Xapian::doccount i = 0; i != mset.size(); ++i) {
+		TEST_EQUAL(*mset[i], expected[i]);
+	    }
+	}
+    }
+}
+
+/// Test value range queries which skip whole value chunks using their bounds.
+DEFINE_TESTCASE(valuerangechunks1, glass) {
+    const Xapian::docid last_did = 3000;
+    string path = get_named_writable_database_path("valuerangechunks1");
+    {
+	Xapian::WritableDatabase db(path,
+				    Xapian::DB_CREATE_OR_OVERWRITE |
+				    Xapian::DB_BACKEND_GLASS |
+				    Xapian::DB_COLUMNAR_VALUES);
+	for (Xapian::docid did = 1; did <= last_did; ++did) {
+	    Xapian::Document doc;
+	    for (Xapian::valueno slot = 0; slot != 2; ++slot) {
+		const string v = chunks_value(slot, did);
+		if (!v.empty()) doc.add_value(slot, v);
+	    }
+	    if (did % 2 == 0) doc.add_term("even");
+	    db.add_document(doc);
+	}
+	db.commit();
+    }
+    check_value_ranges(Xapian::Database(path), last_did);
+
+    string honey_path = get_compaction_output_path("valuerangechunks1honey");
+    Xapian::Database(path).compact(honey_path, Xapian::DB_BACKEND_HONEY);
+    check_value_ranges(Xapian::Database(honey_path), last_did);
+}
@@ -25,6 +25,7 @@
 #include "api_valuestream.h"
 
 #include <xapian.h>
+#include "str.h"
 #include "testsuite.h"
 #include "testutils.h"
 
@@ -626,3 +627,119 @@ DEFINE_TESTCASE(decvalwtsource5, writable) {
 	TEST_EQUAL(mset1.size(), 0);
     }
 }
+
+/// Check @a db has the same values in slots 0 to 2 as @a ref.
+static void
+check_same_values(const Xapian::Database& ref, const Xapian::Database& db)
+{
+    for (Xapian::valueno slot = 0; slot != 3; ++slot) {
+	tout << "slot " << slot << endl;
+	Xapian::ValueIterator i = ref.valuestream_begin(slot);
+	Xapian::ValueIterator j = db.valuestream_begin(slot);
+	while (i != ref.valuestream_end(slot)) {
+	    TEST(j != db.valuestream_end(slot));
+	    TEST_EQUAL(i.get_docid(), j.get_docid());
+	    TEST_EQUAL(*i, *j);
+	    ++i;
+	    ++j;
+	}
+	TEST(j == db.valuestream_end(slot));
+
+	for (Xapian::docid did = 1; did <= ref.get_lastdocid(); did += 37) {
+	    i = ref.valuestream_begin(slot);
+	    j = db.valuestream_begin(slot);
+	    i.skip_to(did);
+	    j.skip_to(did);
+	    bool found = false;
+	    if (i == ref.valuestream_end(slot)) {
+		TEST(j == db.valuestream_end(slot));
+	    } else {
+		TEST_EQUAL(i.get_docid(), j.get_docid());
+		TEST_EQUAL(*i, *j);
+		found = (i.get_docid() == did);
+	    }
+
+	    // check() may act like skip_to() and return true.
+	    j = db.valuestream_begin(slot);
+	    if (j.check(did)) {
+		if (j != db.valuestream_end(slot) && j.get_docid() == did) {
+		    TEST(found);
+		    TEST_EQUAL(*j, *i);
+		} else {
+		    TEST(!found);
+		}
+	    } else {
+		TEST(!found);
+	    }
+	}
+
+	Xapian::Enquire ref_enq(ref), enq(db);
+	Xapian::Query q(Xapian::Query::OP_VALUE_RANGE, slot, "2", "5");
+	ref_enq.set_query(q);
+	enq.set_query(q);
+	Xapian::MSet ref_mset = ref_enq.get_mset(0, ref.get_doccount());
+	Xapian::MSet mset = enq.get_mset(0, db.get_doccount());
+	TEST_EQUAL(mset.size(), ref_mset.size());
+	for (Xapian::doccount k = 0; k != mset.size(); ++k) {
+	    TEST_EQUAL(*mset[k], *ref_mset[k]);
+	}
+    }
+}
+
+/// Test glass value chunks in the columnar format.
+DEFINE_TESTCASE(columnarvalues1, glass) {
+    string path = get_named_writable_database_path("columnarvalues1");
+    string ref_path = get_named_writable_database_path("columnarvalues1ref");
+    Xapian::WritableDatabase db(path,
+				Xapian::DB_CREATE_OR_OVERWRITE |
+				Xapian::DB_BACKEND_GLASS |
+				Xapian::DB_COLUMNAR_VALUES);
+    Xapian::WritableDatabase ref(ref_path,
+				 Xapian::DB_CREATE_OR_OVERWRITE |
+				 Xapian::DB_BACKEND_GLASS);
+
+    // Slot 0 has values which are all the same length, slot 1 has values of
+    // varying lengths, and slot 2 is sparse.
+    for (int pass = 0; pass != 3; ++pass) {
+	if (pass == 2) {
+	    // The format should still be used without the flag.
+	    db.close();
+	    db = Xapian::WritableDatabase(path, Xapian::DB_BACKEND_GLASS);
+	}
+	for (Xapian::docid did = 1; did <= 1000; ++did) {
+	    if (pass && did % (pass * 3) != 0) continue;
+	    if (pass == 1 && did % 50 == 0) {
+		db.delete_document(did);
+		ref.delete_document(did);
+		continue;
+	    }
+	    Xapian::Document doc;
+	    string fixed(4, '\0');
+	    fixed[0] = char('0' + pass);
+	    fixed[2] = char(did >> 8);
+	    fixed[3] = char(did);
+	    doc.add_value(0, fixed);
+	    doc.add_value(1, str(did * 7 + pass));
+	    if (did % 13 == 0) doc.add_value(2, "3" + str(did));
+	    db.replace_document(did, doc);
+	    ref.replace_document(did, doc);
+	}
+	db.commit();
+	ref.commit();
+	check_same_values(ref, db);
+	check_same_values(ref, Xapian::Database(path));
+    }
+
+    // Compacting with the flag converts the value chunks, and without it they
+    // are copied as they are.
+    string out_path = get_compaction_output_path("columnarvalues1out");
+    Xapian::Database(ref_path).compact(out_path, Xapian::DB_COLUMNAR_VALUES);
+    check_same_values(ref, Xapian::Database(out_path));
+    Xapian::Database(path).compact(out_path);
+    check_same_values(ref, Xapian::Database(out_path));
+
+    // Check conversion to honey.
+    string honey_path = get_compaction_output_path("columnarvalues1honey");
+    Xapian::Database(path).compact(honey_path, Xapian::DB_BACKEND_HONEY);
+    check_same_values(ref, Xapian::Database(honey_path));
+}
@@ -39,10 +39,12 @@
 #include "unixcmds.h"
 
 #include "apitest.h"
+#include "envguard.h"
 
 #include "safeunistd.h"
 #include <cmath>
 #include <cstdlib>
+#include <fstream>
 #include <map>
 #include <string>
 
@@ -1972,3 +1974,365 @@ DEFINE_TESTCASE(protocolbug1, remote && writable) {
 		   db.replace_document(1, doc));
     db.commit();
 }
+
+/// Test WritableDatabase::set_flush_memory_limit().
+DEFINE_TESTCASE(flushmemory1, glass) {
+    Xapian::WritableDatabase db = get_writable_database();
+    TEST_EQUAL(db.get_buffered_memory(), 0);
+
+    Xapian::Document doc;
+    doc.add_value(1, "value");
+    for (Xapian::termpos pos = 1; pos <= 100; ++pos) {
+	doc.add_posting("term" + str(pos), pos);
+    }
+    db.add_document(doc);
+    size_t one_doc = db.get_buffered_memory();
+    TEST_REL(one_doc, >, 0);
+    db.add_document(doc);
+    TEST_REL(db.get_buffered_memory(), >, one_doc);
+    db.commit();
+    TEST_EQUAL(db.get_buffered_memory(), 0);
+
+    // Changes should be committed whenever they reach the limit, so a reader
+    // should see documents we haven't explicitly committed.
+    size_t limit = one_doc * 10;
+    db.set_flush_memory_limit(limit);
+    for (int i = 0; i < 50; ++i) {
+	db.add_document(doc);
+	TEST_REL(db.get_buffered_memory(), <, limit);
+    }
+    TEST_REL(db.get_buffered_memory(), >, 0);
+    Xapian::Database rdb = get_writable_database_as_database();
+    TEST_REL(rdb.get_doccount(), >, 2);
+    TEST_REL(rdb.get_doccount(), <, db.get_doccount());
+
+    // Check the flushed changes are all there.
+    db.commit();
+    TEST_EQUAL(db.get_buffered_memory(), 0);
+    rdb.reopen();
+    TEST_EQUAL(rdb.get_doccount(), 52);
+    TEST_EQUAL(rdb.get_termfreq("term42"), 52);
+    TEST_EQUAL(rdb.get_value_freq(1), 52);
+    TEST_EQUAL(*rdb.positionlist_begin(52, "term42"), 42);
+
+    // Deletions are buffered too.
+    db.set_flush_memory_limit(0);
+    db.delete_document(1);
+    TEST_REL(db.get_buffered_memory(), >, 0);
+    db.commit();
+    TEST_EQUAL(db.get_buffered_memory(), 0);
+    TEST_EQUAL(db.get_doccount(), 51);
+}
+
+/// Test reaching the memory limit within a transaction.
+DEFINE_TESTCASE(flushmemory2, glass) {
+    Xapian::WritableDatabase db = get_writable_database();
+    Xapian::Document doc;
+    doc.add_value(0, "value");
+    for (Xapian::termpos pos = 1; pos <= 100; ++pos) {
+	doc.add_posting("term" + str(pos), pos);
+    }
+    db.add_document(doc);
+    db.commit();
+
+    db.set_flush_memory_limit(4096);
+    db.begin_transaction();
+    for (int i = 0; i < 20; ++i) {
+	db.add_document(doc);
+	TEST_REL(db.get_buffered_memory(), <, 4096);
+    }
+    TEST_EQUAL(db.get_doccount(), 21);
+    TEST_EQUAL(db.get_termfreq("term42"), 21);
+    TEST_EQUAL(db.get_value_freq(0), 21);
+
+    // Nothing should have been committed.
+    Xapian::Database rdb = get_writable_database_as_database();
+    TEST_EQUAL(rdb.get_doccount(), 1);
+
+    db.cancel_transaction();
+    TEST_EQUAL(db.get_buffered_memory(), 0);
+    TEST_EQUAL(db.get_doccount(), 1);
+    TEST_EQUAL(db.get_termfreq("term42"), 1);
+    TEST_EQUAL(db.get_value_freq(0), 1);
+}
+
+DEFINE_TESTCASE(commitasync1, writable && !inmemory) {
+    Xapian::WritableDatabase db = get_writable_database();
+    Xapian::Document doc;
+    doc.add_term("foo");
+    db.add_document(doc);
+    db.commit_async();
+
+    // Modifications can be made while the commit is being synced.
+    db.add_document(doc);
+    TEST_EQUAL(db.get_doccount(), 2);
+    db.wait_for_commit();
+    // Waiting again should just return.
+    db.wait_for_commit();
+
+    Xapian::Database rdb = get_writable_database_as_database();
+    TEST_EQUAL(rdb.get_doccount(), 1);
+    TEST_EQUAL(rdb.get_termfreq("foo"), 1);
+
+    // commit() should wait for the commit_async() before it.
+    db.commit_async();
+    db.add_document(doc);
+    db.commit();
+    TEST(rdb.reopen());
+    TEST_EQUAL(rdb.get_doccount(), 3);
+    TEST_EQUAL(rdb.get_termfreq("foo"), 3);
+}
+
+/// Check blocks freed by earlier revisions are handled correctly.
+DEFINE_TESTCASE(commitasync2, glass && path) {
+    Xapian::WritableDatabase db =
+	get_named_writable_database("commitasync2", string());
+    for (Xapian::docid did = 1; did <= 200; ++did) {
+	Xapian::Document doc;
+	doc.set_data(string(did * 10, 'x'));
+	doc.add_term("all");
+	doc.add_term("Q" + str(did));
+	db.replace_document(did, doc);
+    }
+    db.commit();
+
+    for (int round = 0; round < 10; ++round) {
+	// Replace documents so blocks are freed each revision.
+	for (Xapian::docid did = 1 + round; did <= 200; did += 3) {
+	    Xapian::Document doc;
+	    doc.set_data(string(did * 10 + round, 'y'));
+	    doc.add_term("all");
+	    doc.add_term("Q" + str(did));
+	    doc.add_term("R" + str(round));
+	    db.replace_document(did, doc);
+	}
+	db.commit_async();
+    }
+    db.wait_for_commit();
+    TEST_EQUAL(db.get_doccount(), 200);
+
+    Xapian::Database rdb = get_writable_database_as_database();
+    TEST_EQUAL(rdb.get_doccount(), 200);
+    TEST_EQUAL(rdb.get_termfreq("all"), 200);
+    TEST_EQUAL(rdb.get_document(10).get_data(), string(10 * 10 + 9, 'y'));
+    db.close();
+
+    const string& db_path = get_named_writable_database_path("commitasync2");
+    TEST_EQUAL(Xapian::Database::check(db_path), 0);
+}
+
+/// commit_async() isn't allowed in a transaction.
+DEFINE_TESTCASE(commitasync3, transactions) {
+    Xapian::WritableDatabase db = get_writable_database();
+    db.begin_transaction();
+    TEST_EXCEPTION(Xapian::InvalidOperationError, db.commit_async());
+    db.cancel_transaction();
+}
+
+/// Test committing to a write-ahead log.
+DEFINE_TESTCASE(writeaheadlog1, glass) {
+    string path = get_named_writable_database_path("writeaheadlog1");
+    string copy_path = get_named_writable_database_path("writeaheadlog1copy");
+    Xapian::WritableDatabase db(path,
+				Xapian::DB_CREATE_OR_OVERWRITE |
+				Xapian::DB_BACKEND_GLASS |
+				Xapian::DB_WRITE_AHEAD_LOG);
+    Xapian::Document doc;
+    doc.add_term("foo");
+    doc.set_data("one");
+    db.add_document(doc);
+    db.set_metadata("key", "value");
+    db.add_spelling("hello");
+    db.add_synonym("hi", "hello");
+    db.commit();
+    TEST(file_exists(path + "/wal"));
+    TEST_EQUAL(db.get_doccount(), 1);
+    // The tables haven't been written to, but a fresh reader replays the
+    // log so sees the committed changes.
+    Xapian::Database reader(path);
+    TEST_EQUAL(reader.get_doccount(), 1);
+    TEST_EQUAL(reader.get_revision(), db.get_revision());
+    TEST_EQUAL(reader.get_termfreq("foo"), 1);
+    TEST_EQUAL(reader.get_document(1).get_data(), "one");
+    TEST_EQUAL(reader.get_metadata("key"), "value");
+    TEST_EQUAL(reader.get_spelling_suggestion("helo"), "hello");
+    TEST_EQUAL(*reader.synonyms_begin("hi"), "hello");
+    {
+	Xapian::Enquire enquire(reader);
+	enquire.set_query(Xapian::Query("foo"));
+	Xapian::MSet mset = enquire.get_mset(0, 10);
+	TEST_EQUAL(mset.size(), 1);
+	TEST_EQUAL(*mset[0], 1);
+    }
+
+    doc.set_data("two");
+    db.replace_document(1, doc);
+    db.add_document(doc);
+    db.add_document(doc);
+    db.delete_document(2);
+    db.commit();
+
+    // This isn't committed so shouldn't be in the log.
+    db.add_document(doc);
+
+    // An open reader only sees the new commit after reopen().
+    TEST_EQUAL(reader.get_lastdocid(), 1);
+    TEST(reader.reopen());
+    TEST_EQUAL(reader.get_doccount(), 2);
+    TEST_EQUAL(reader.get_lastdocid(), 3);
+    TEST_EQUAL(reader.get_termfreq("foo"), 2);
+    TEST_EQUAL(reader.get_document(1).get_data(), "two");
+    TEST_EQUAL(Xapian::Database(path).get_doccount(), 2);
+    // Readers leave the log alone.
+    TEST(file_exists(path + "/wal"));
+
+    // Compacting a reader should include the changes in the log.
+    string out_path = get_compaction_output_path("writeaheadlog1out");
+    rm_rf(out_path);
+    reader.compact(out_path);
+    {
+	Xapian::Database out(out_path);
+	TEST_EQUAL(out.get_doccount(), 2);
+	TEST_EQUAL(out.get_lastdocid(), 3);
+	TEST_EQUAL(out.get_termfreq("foo"), 2);
+	TEST_EQUAL(out.get_document(1).get_data(), "two");
+	TEST_EQUAL(out.get_metadata("key"), "value");
+	TEST_EQUAL(out.get_spelling_suggestion("helo"), "hello");
+	TEST_EQUAL(*out.synonyms_begin("hi"), "hello");
+    }
+
+    // Simulate a crash by copying the database files.
+    rm_rf(copy_path);
+    cp_R(path, copy_path);
+    {
+	// Opening without DB_WRITE_AHEAD_LOG should apply the log and then
+	// write the changes to the tables.
+	Xapian::WritableDatabase db2(copy_path, Xapian::DB_BACKEND_GLASS);
+	TEST(!file_exists(copy_path + "/wal"));
+	Xapian::Database rdb(copy_path);
+	TEST_EQUAL(rdb.get_doccount(), 2);
+	TEST_EQUAL(rdb.get_lastdocid(), 3);
+	TEST_EQUAL(rdb.get_termfreq("foo"), 2);
+	TEST_EQUAL(rdb.get_document(1).get_data(), "two");
+	TEST_EQUAL(rdb.get_metadata("key"), "value");
+	TEST_EQUAL(rdb.get_spelling_suggestion("helo"), "hello");
+	TEST_EQUAL(*rdb.synonyms_begin("hi"), "hello");
+    }
+
+    // Cancelling should go back to the last commit, not the last revision.
+    db.begin_transaction(false);
+    db.delete_document(1);
+    db.cancel_transaction();
+    TEST_EQUAL(db.get_doccount(), 2);
+    TEST_EQUAL(db.get_lastdocid(), 3);
+    TEST_EQUAL(db.get_document(1).get_data(), "two");
+
+    // Closing should write the changes to the tables.
+    db.close();
+    TEST(!file_exists(path + "/wal"));
+    // The checkpoint is a new revision, so the reader needs to reopen to
+    // stop using the log it replayed.
+    TEST(reader.reopen());
+    TEST_EQUAL(reader.get_doccount(), 2);
+    TEST_EQUAL(reader.get_document(3).get_data(), "two");
+    Xapian::Database rdb(path);
+    TEST_EQUAL(rdb.get_doccount(), 2);
+    TEST_EQUAL(rdb.get_lastdocid(), 3);
+    TEST_EQUAL(rdb.get_document(1).get_data(), "two");
+    TEST_EQUAL(rdb.get_metadata("key"), "value");
+}
+
+/// Test a write-ahead log with an incomplete commit at the end.
+DEFINE_TESTCASE(writeaheadlog2, glass) {
+    string path = get_named_writable_database_path("writeaheadlog2");
+    string copy_path = get_named_writable_database_path("writeaheadlog2copy");
+    const int flags = Xapian::DB_BACKEND_GLASS | Xapian::DB_WRITE_AHEAD_LOG;
+    Xapian::WritableDatabase db(path, Xapian::DB_CREATE_OR_OVERWRITE | flags);
+    Xapian::Document doc;
+    doc.add_term("foo");
+    db.add_document(doc);
+    db.commit();
+    db.add_document(doc);
+    db.commit();
+
+    rm_rf(copy_path);
+    cp_R(path, copy_path);
+    {
+	// Append the start of a record claiming to have 16 bytes.
+	ofstream out(copy_path + "/wal", ios::binary | ios::app);
+	out.write("\0\0\0\0\0\0\0\x10" "crc!" "ab", 14);
+    }
+
+    Xapian::WritableDatabase db2(copy_path, flags);
+    TEST_EQUAL(db2.get_doccount(), 2);
+    // The incomplete record must be removed before more are appended.
+    db2.add_document(doc);
+    db2.commit();
+    TEST(file_exists(copy_path + "/wal"));
+
+    db.close();
+    rm_rf(path);
+    cp_R(copy_path, path);
+    Xapian::WritableDatabase db3(path, flags);
+    TEST_EQUAL(db3.get_doccount(), 3);
+    TEST_EQUAL(db3.get_termfreq("foo"), 3);
+}
+
+/// Check a reader reopened as the write-ahead log grows and is checkpointed.
+DEFINE_TESTCASE(writeaheadlog3, glass) {
+    string path = get_named_writable_database_path("writeaheadlog3");
+    const int flags = Xapian::DB_BACKEND_GLASS | Xapian::DB_WRITE_AHEAD_LOG;
+    // Small enough that a few commits of the documents below exceed it.
+    EnvGuard checkpoint_size("XAPIAN_WAL_CHECKPOINT_SIZE", "1000");
+    Xapian::WritableDatabase db(path, Xapian::DB_CREATE_OR_OVERWRITE | flags);
+    Xapian::Document doc;
+    doc.add_term("foo");
+    db.add_document(doc);
+    db.commit();
+    TEST(file_exists(path + "/wal"));
+    auto rev = db.get_revision();
+
+    Xapian::Database reader(path);
+    TEST_EQUAL(reader.get_doccount(), 1);
+    bool checkpointed = false;
+    Xapian::totallength added_length = 0;
+    for (Xapian::docid did = 2; did <= 60; ++did) {
+	Xapian::Document d;
+	d.add_term("foo");
+	d.add_term("bar" + str(did), did);
+	d.add_value(1, str(did));
+	db.add_document(d);
+	db.replace_document(1, d);
+	db.commit();
+	if (db.get_revision() != rev) {
+	    TEST(!file_exists(path + "/wal"));
+	    rev = db.get_revision();
+	    checkpointed = true;
+	}
+
+	TEST(reader.reopen());
+	TEST_EQUAL(reader.get_doccount(), did);
+	TEST_EQUAL(reader.get_lastdocid(), did);
+	TEST_EQUAL(reader.get_termfreq("foo"), did);
+	TEST_EQUAL(reader.get_termfreq("bar" + str(did)), 2);
+	TEST_EQUAL(reader.get_doclength(1), did + 1);
+	TEST_EQUAL(reader.get_doclength(did), did + 1);
+	TEST_EQUAL(reader.get_document(1).get_value(1), str(did));
+	TEST_EQUAL(reader.get_value_freq(1), did);
+	// Document 1 is now a copy of document did.
+	added_length += did + 1;
+	TEST_EQUAL(reader.get_total_length(), added_length + did + 1);
+    }
+    TEST(checkpointed);
+    TEST(!reader.reopen());
+
+    Xapian::Database fresh(path);
+    TEST_EQUAL(fresh.get_doccount(), 60);
+    TEST_EQUAL(fresh.get_doclength(1), 61);
+    TEST_EQUAL(fresh.get_total_length(), reader.get_total_length());
+
+    db.close();
+    checkpoint_size.set("0");
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   Xapian::WritableDatabase(path, flags));
+}
@@ -5,6 +5,7 @@ noinst_HEADERS +=\
 	harness/backendmanager.h\
 	harness/backendmanager_glass.h\
 	harness/backendmanager_honey.h\
+	harness/backendmanager_honeysegmented.h\
 	harness/backendmanager_inmemory.h\
 	harness/backendmanager_multi.h\
 	harness/backendmanager_remote.h\
@@ -12,6 +13,7 @@ noinst_HEADERS +=\
 	harness/backendmanager_remotetcp.h\
 	harness/backendmanager_singlefile.h\
 	harness/cputimer.h\
+	harness/envguard.h\
 	harness/fdtracker.h\
 	harness/index_utils.h\
 	harness/unixcmds.h\
@@ -50,7 +52,8 @@ endif
 
 if BUILD_BACKEND_HONEY
 testharness_sources +=\
-	harness/backendmanager_honey.cc
+	harness/backendmanager_honey.cc\
+	harness/backendmanager_honeysegmented.cc
 endif
 
 if BUILD_BACKEND_INMEMORY
@@ -0,0 +1,60 @@
+/** @file
+ * @brief Set an environment variable for the lifetime of an object.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_ENVGUARD_H
+#define XAPIAN_INCLUDED_ENVGUARD_H
+
+#include "setenv.h"
+
+/** Set an environment variable, and unset it again on destruction.
+ *
+ *  Tests use this for the environment variables which tune the library so a
+ *  failing check can't leave one set for later testcases.
+ */
+class EnvGuard {
+    /// Don't allow copying.
+    EnvGuard(const EnvGuard&) = delete;
+
+    /// Don't allow assignment.
+    EnvGuard& operator=(const EnvGuard&) = delete;
+
+    const char* name;
+
+  public:
+    /// Set environment variable @a name_ to @a value.
+    EnvGuard(const char* name_, const char* value) : name(name_) {
+	set(value);
+    }
+
+    ~EnvGuard() { unset(); }
+
+    /// Change the value.
+    void set(const char* value) { setenv(name, value, 1); }
+
+    /// Unset the variable.
+    void unset() {
+#ifdef HAVE_SETENV
+	unsetenv(name);
+#else
+	// _putenv_s() removes the variable when the value is empty.
+	setenv(name, "", 1);
+#endif
+    }
+};
+
+#endif // XAPIAN_INCLUDED_ENVGUARD_H
@@ -28,6 +28,7 @@
 #include "backendmanager.h"
 #include "backendmanager_glass.h"
 #include "backendmanager_honey.h"
+#include "backendmanager_honeysegmented.h"
 #include "backendmanager_inmemory.h"
 #include "backendmanager_multi.h"
 #include "backendmanager_remoteprog.h"
@@ -99,6 +100,9 @@ TestRunner::set_properties_for_backend(const string & backend_name)
 	    |GENERATED
 #endif
 	},
+	{ "honey_segmented", HONEY|
+	    BACKEND|TRANSACTIONS|POSITIONAL|WRITABLE|SPELLING|METADATA|
+	    SYNONYMS|VALUESTATS|GENERATED|PATH },
 	{ NULL, 0 }
     };
 
@@ -144,6 +148,10 @@ TestRunner::run_tests(int argc, char ** argv)
 # else
 	do_tests_for_backend(BackendManagerHoney(datadir));
 # endif
+# ifdef XAPIAN_HAS_GLASS_BACKEND
+	// Segmented honey databases buffer changes in a glass database.
+	do_tests_for_backend(BackendManagerHoneySegmented(datadir));
+# endif
 #endif
 
 	do_tests_for_backend(BackendManager(string()));
@@ -82,7 +82,8 @@ PerfTestLogger::PerfTestLogger()
 	: testcase_started(false),
 	  indexing_started(false),
 	  searching_started(false),
-	  diversifying_started(false)
+	  diversifying_started(false),
+	  lookingup_started(false)
 {}
 
 PerfTestLogger::~PerfTestLogger()
@@ -441,6 +442,45 @@ PerfTestLogger::diversifying_end()
     }
 }
 
+void
+PerfTestLogger::lookingup_start(const string & description)
+{
+    indexing_end();
+    lookingup_end();
+    write("   <lookuprun>\n"
+	  "    <description>" + escape_xml(description) + "</description>\n");
+    lookingup_started = true;
+    lookup_start();
+}
+
+void
+PerfTestLogger::lookup_start()
+{
+    lookingup_timer = RealTime::now();
+}
+
+void
+PerfTestLogger::lookup_end(unsigned count, unsigned found)
+{
+    Assert(lookingup_started);
+    double elapsed(RealTime::now() - lookingup_timer);
+    write("    <lookup>"
+	  "<time>" + str(elapsed) + "</time>"
+	  "<count>" + str(count) + "</count>"
+	  "<found>" + str(found) + "</found>"
+	  "</lookup>\n");
+    lookup_start();
+}
+
+void
+PerfTestLogger::lookingup_end()
+{
+    if (lookingup_started) {
+	write("   </lookuprun>\n");
+	lookingup_started = false;
+    }
+}
+
 void
 PerfTestLogger::testcase_begin(const string & testcase)
 {
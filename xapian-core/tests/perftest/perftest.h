@@ -48,6 +48,9 @@ class PerfTestLogger {
     bool diversifying_started;
     double diversifying_timer;
 
+    bool lookingup_started;
+    double lookingup_timer;
+
     /** Write a log entry for the current indexing run.
      */
     void indexing_log();
@@ -116,6 +119,25 @@ class PerfTestLogger {
      */
     void diversifying_end();
 
+    /** Log the start of a run of term lookups.
+     */
+    void lookingup_start(const std::string & description);
+
+    /** Log the start of a batch of term lookups.
+     */
+    void lookup_start();
+
+    /** Log the completion of a batch of term lookups.
+     *
+     *  @param count	The number of lookups in the batch.
+     *  @param found	The number of terms which were found.
+     */
+    void lookup_end(unsigned count, unsigned found);
+
+    /** Log the end of a run of term lookups.
+     */
+    void lookingup_end();
+
     /** Start a testcase.
      */
     void testcase_begin(const std::string & testcase);
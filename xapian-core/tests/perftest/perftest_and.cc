@@ -0,0 +1,148 @@
+/** @file
+ * @brief performance tests for AND queries
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "perftest/perftest_and.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <xapian.h>
+
+#include "backendmanager.h"
+#include "envguard.h"
+#include "perftest.h"
+#include "str.h"
+#include "testrunner.h"
+#include "testsuite.h"
+#include "testutils.h"
+
+using namespace std;
+
+/// Number of distinct words in the generated documents.
+static const unsigned VOCAB_SIZE = 20000;
+
+/** Pick a word number with a roughly Zipfian distribution.
+ *
+ *  Word 0 is the most frequent.
+ */
+static unsigned
+zipf_word()
+{
+    double r = rand() / (RAND_MAX + 1.0);
+    return unsigned(pow(double(VOCAB_SIZE), r)) - 1;
+}
+
+static void
+builddb_and1(Xapian::WritableDatabase& db, const string& dbname)
+{
+    logger.testcase_begin(dbname);
+    unsigned int runsize = 200000;
+    unsigned int seed = 42;
+
+    srand(seed);
+
+    std::map<std::string, std::string> params;
+    params["runsize"] = str(runsize);
+    params["seed"] = str(seed);
+    params["vocab_size"] = str(VOCAB_SIZE);
+    logger.indexing_begin(dbname, params);
+    for (unsigned int i = 0; i < runsize; ++i) {
+	Xapian::Document doc;
+	doc.set_data("and document " + str(i));
+	unsigned int length = 20 + rand() % 200;
+	for (unsigned int j = 0; j < length; ++j) {
+	    doc.add_term("w" + str(zipf_word()));
+	}
+	db.add_document(doc);
+	logger.indexing_add();
+    }
+    db.commit();
+    logger.indexing_end();
+    logger.testcase_end();
+}
+
+/// Run @a query finding all matches, with and without decoded docid blocks.
+static void
+compare_and(Xapian::Enquire& enquire, const Xapian::Query& query,
+	    const string& description, Xapian::doccount db_size)
+{
+    enquire.set_query(query);
+
+    EnvGuard blocks("XAPIAN_AND_DOCID_BLOCKS", "0");
+    logger.searching_start(description + " without docid blocks");
+    logger.search_start();
+    Xapian::MSet mset1 = enquire.get_mset(0, 10, db_size);
+    logger.search_end(query, mset1);
+    logger.searching_end();
+
+    blocks.set("1");
+    logger.searching_start(description + " with docid blocks");
+    logger.search_start();
+    Xapian::MSet mset2 = enquire.get_mset(0, 10, db_size);
+    logger.search_end(query, mset2);
+    logger.searching_end();
+    blocks.unset();
+
+    TEST_EQUAL(mset1.get_matches_estimated(), mset2.get_matches_estimated());
+    TEST(mset_range_is_same(mset1, 0, mset2, 0, mset1.size()));
+}
+
+// Compare the time to find all the matches of 2-5 term conjunctions.
+DEFINE_TESTCASE(andconj1, generated && !remote && !inmemory) {
+    Xapian::Database db;
+    db = backendmanager->get_database("and1", builddb_and1, "and1");
+    Xapian::doccount db_size = db.get_doccount();
+
+    logger.testcase_begin("andconj1");
+    Xapian::Enquire enquire(db);
+    enquire.set_weighting_scheme(Xapian::BoolWeight());
+
+    // Cached filters are stored as arrays of docids unless they're dense.
+    Xapian::FilterCache filter_cache(64 * 1024 * 1024, 1);
+
+    srand(7);
+    for (unsigned int width : { 2, 3, 4, 5 }) {
+	for (unsigned int q = 0; q != 5; ++q) {
+	    vector<Xapian::Query> subqs;
+	    for (unsigned int i = 0; i != width; ++i) {
+		// Pick fairly frequent words so there are plenty of matches.
+		subqs.emplace_back("w" + str(rand() % 200));
+	    }
+	    Xapian::Query query(Xapian::Query::OP_AND,
+				subqs.begin(), subqs.end());
+	    compare_and(enquire, query, "AND of " + str(width) + " terms",
+			db_size);
+
+	    // The same conjunction with all but the first term as filters.
+	    Xapian::Query filter_query(Xapian::Query::OP_FILTER,
+				       subqs.begin(), subqs.end());
+	    enquire.set_filter_cache(filter_cache);
+	    enquire.set_query(filter_query);
+	    (void)enquire.get_mset(0, 10);
+	    compare_and(enquire, filter_query,
+			"FILTER of " + str(width) + " cached terms", db_size);
+	    enquire.clear_filter_cache();
+	}
+    }
+
+    logger.testcase_end();
+}
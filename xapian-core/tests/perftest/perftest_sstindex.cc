@@ -0,0 +1,119 @@
+/** @file
+ * @brief performance tests for honey table index types
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "perftest/perftest_sstindex.h"
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <xapian.h>
+
+#include "backendmanager.h"
+#include "perftest.h"
+#include "str.h"
+#include "testrunner.h"
+#include "testsuite.h"
+#include "testutils.h"
+#include "unixcmds.h"
+
+using namespace std;
+
+/// Number of distinct terms in each generated document.
+static const unsigned TERMS_PER_DOC = 20;
+
+/// The i-th term in the generated database.
+static string
+sstindex_term(unsigned i)
+{
+    // Spread the terms over many different initial bytes and lengths.
+    string term(1, char('A' + i % 26));
+    term += str(i * 2654435761U);
+    return term;
+}
+
+static void
+builddb_sstindex1(Xapian::WritableDatabase& db, const string& dbname)
+{
+    logger.testcase_begin(dbname);
+    unsigned int runsize = 50000;
+
+    std::map<std::string, std::string> params;
+    params["runsize"] = str(runsize);
+    params["terms_per_doc"] = str(TERMS_PER_DOC);
+    logger.indexing_begin(dbname, params);
+    unsigned term = 0;
+    for (unsigned int i = 0; i < runsize; ++i) {
+	Xapian::Document doc;
+	doc.set_data("sstindex document " + str(i));
+	for (unsigned int j = 0; j < TERMS_PER_DOC; ++j) {
+	    doc.add_term(sstindex_term(term++));
+	}
+	db.add_document(doc);
+	logger.indexing_add();
+    }
+    db.commit();
+    logger.indexing_end();
+    logger.testcase_end();
+}
+
+// Compare the speed of term lookups in honey databases with each index type.
+DEFINE_TESTCASE(sstindex1, writable && !remote && !inmemory) {
+    Xapian::Database db;
+    db = backendmanager->get_database("sstindex1", builddb_sstindex1,
+				      "sstindex1");
+    unsigned num_terms = db.get_doccount() * TERMS_PER_DOC;
+
+    logger.testcase_begin("sstindex1");
+    for (const char* type : { "array", "binarychop", "skiplist",
+			      "eytzinger" }) {
+	string path = backendmanager->get_compaction_output_path(
+	    string("sstindex1_") + type);
+	rm_rf(path);
+	Xapian::Compactor compactor;
+	compactor.set_honey_index_type(type);
+	db.compact(path, Xapian::DB_BACKEND_HONEY, 0, compactor);
+
+	Xapian::Database honey_db(path);
+	srand(42);
+	logger.lookingup_start(string("Term lookups with ") + type +
+			       " index");
+	for (unsigned batch = 0; batch != 10; ++batch) {
+	    // Look up a mix of present and absent terms.
+	    vector<string> terms;
+	    for (unsigned i = 0; i != 1000; ++i) {
+		unsigned t = unsigned(rand()) % (num_terms * 2);
+		terms.push_back(sstindex_term(t));
+	    }
+	    unsigned found = 0;
+	    logger.lookup_start();
+	    for (const string& term : terms) {
+		if (honey_db.get_termfreq(term)) ++found;
+	    }
+	    logger.lookup_end(terms.size(), found);
+	    TEST_REL(found, >, 0);
+	    TEST_REL(found, <, terms.size());
+	}
+	logger.lookingup_end();
+	honey_db.close();
+	rm_rf(path);
+    }
+    logger.testcase_end();
+}
@@ -0,0 +1,125 @@
+/** @file
+ * @brief performance tests for wide OR queries
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "perftest/perftest_wand.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <xapian.h>
+
+#include "backendmanager.h"
+#include "envguard.h"
+#include "perftest.h"
+#include "str.h"
+#include "testrunner.h"
+#include "testsuite.h"
+#include "testutils.h"
+
+using namespace std;
+
+/// Number of distinct words in the generated documents.
+static const unsigned VOCAB_SIZE = 20000;
+
+/** Pick a word number with a roughly Zipfian distribution.
+ *
+ *  Word 0 is the most frequent.
+ */
+static unsigned
+zipf_word()
+{
+    double r = rand() / (RAND_MAX + 1.0);
+    return unsigned(pow(double(VOCAB_SIZE), r)) - 1;
+}
+
+static void
+builddb_wand1(Xapian::WritableDatabase& db, const string& dbname)
+{
+    logger.testcase_begin(dbname);
+    unsigned int runsize = 200000;
+    unsigned int seed = 42;
+
+    srand(seed);
+
+    std::map<std::string, std::string> params;
+    params["runsize"] = str(runsize);
+    params["seed"] = str(seed);
+    params["vocab_size"] = str(VOCAB_SIZE);
+    logger.indexing_begin(dbname, params);
+    for (unsigned int i = 0; i < runsize; ++i) {
+	Xapian::Document doc;
+	doc.set_data("wand document " + str(i));
+	unsigned int length = 20 + rand() % 200;
+	for (unsigned int j = 0; j < length; ++j) {
+	    doc.add_term("w" + str(zipf_word()));
+	}
+	db.add_document(doc);
+	logger.indexing_add();
+    }
+    db.commit();
+    logger.indexing_end();
+    logger.testcase_end();
+}
+
+// Compare the top-10 latency of wide OR queries with and without WAND.
+DEFINE_TESTCASE(wandor1, writable && !remote && !inmemory) {
+    Xapian::Database db;
+    db = backendmanager->get_database("wand1", builddb_wand1, "wand1");
+
+    logger.testcase_begin("wandor1");
+    Xapian::Enquire enquire(db);
+
+    srand(7);
+    for (unsigned int width : { 2, 4, 8, 16, 32, 64 }) {
+	for (unsigned int q = 0; q != 5; ++q) {
+	    vector<Xapian::Query> subqs;
+	    for (unsigned int i = 0; i != width; ++i) {
+		subqs.emplace_back("w" + str(zipf_word()));
+	    }
+	    Xapian::Query query(Xapian::Query::OP_OR,
+				subqs.begin(), subqs.end());
+	    enquire.set_query(query);
+
+	    // The tree before WandPostList was added.
+	    EnvGuard wand_min("XAPIAN_WAND_MIN_SUBQUERIES", "0");
+	    logger.searching_start("OR of " + str(width) + " terms without WAND");
+	    logger.search_start();
+	    Xapian::MSet mset1 = enquire.get_mset(0, 10);
+	    logger.search_end(query, mset1);
+	    logger.searching_end();
+
+	    wand_min.set("2");
+	    logger.searching_start("OR of " + str(width) + " terms with WAND");
+	    logger.search_start();
+	    Xapian::MSet mset2 = enquire.get_mset(0, 10);
+	    logger.search_end(query, mset2);
+	    logger.searching_end();
+
+	    wand_min.unset();
+
+	    TEST_EQUAL(mset1.size(), mset2.size());
+	    TEST(mset_range_is_same_weights(mset1, 0, mset2, 0, mset1.size()));
+	}
+    }
+
+    logger.testcase_end();
+}
@@ -22,6 +22,7 @@
 
 #include <config.h>
 
+#include <algorithm>
 #include <cctype>
 #include <cerrno>
 #include <cfloat>
@@ -31,7 +32,9 @@
 #include <iostream>
 #include <limits>
 #include <utility>
+#include <vector>
 
+#include "safefcntl.h"
 #include "safeunistd.h"
 
 #define XAPIAN_UNITTEST
@@ -83,7 +86,11 @@ using namespace std;
 #include "../common/parseint.h"
 #include "../common/serialise-double.cc"
 #include "../common/str.cc"
+#include "../backends/docidsearch.cc"
 #include "../backends/uuids.cc"
+#include "../backends/glass/glass_blockcache.cc"
+#include "../backends/honey/honey_bloom.cc"
+#include "../backends/honey/honey_postingblock.cc"
 #include "../net/serialise-error.cc"
 #include "../api/error.cc"
 #include "../api/sortable-serialise.cc"
@@ -588,6 +595,291 @@ static void test_shard1()
     }
 }
 
+static void test_blockcache1()
+{
+    const unsigned block_size = 2048;
+    // Room for two blocks in each shard.
+    GlassBlockCache cache(16 * 2 * block_size);
+    uint8_t block[block_size];
+    uint8_t buf[block_size];
+
+    TEST(!cache.read_block(1, 7, 42, buf, block_size));
+    memset(block, 'x', block_size);
+    cache.add_block(1, 7, 42, block, block_size);
+    memset(buf, 0, block_size);
+    TEST(cache.read_block(1, 7, 42, buf, block_size));
+    TEST(memcmp(block, buf, block_size) == 0);
+
+    // Different file, revision or block number shouldn't match.
+    TEST(!cache.read_block(2, 7, 42, buf, block_size));
+    TEST(!cache.read_block(1, 8, 42, buf, block_size));
+    TEST(!cache.read_block(1, 7, 43, buf, block_size));
+
+    GlassBlockCache::Stats stats = cache.get_stats();
+    TEST_EQUAL(stats.hits, 1);
+    TEST_EQUAL(stats.misses, 4);
+    TEST_EQUAL(stats.evictions, 0);
+    TEST_EQUAL(stats.blocks, 1);
+    TEST_EQUAL(stats.bytes, block_size);
+
+    // Add lots more blocks and check the size stays bounded, and that a block
+    // which keeps being used isn't evicted.
+    for (glass_block_t n = 100; n != 1000; ++n) {
+	memset(block, char(n), block_size);
+	cache.add_block(1, 7, n, block, block_size);
+	TEST(cache.read_block(1, 7, 42, buf, block_size));
+	TEST_EQUAL(buf[0], 'x');
+    }
+    stats = cache.get_stats();
+    TEST_REL(stats.bytes, <=, 16 * 2 * block_size);
+    TEST_EQUAL(stats.bytes, stats.blocks * block_size);
+    TEST_REL(stats.evictions, >, 0);
+    TEST_EQUAL(stats.evictions + stats.blocks, 901);
+
+    // A block bigger than a shard shouldn't be cached.
+    GlassBlockCache small_cache(16 * 1024);
+    small_cache.add_block(1, 7, 42, block, block_size);
+    TEST(!small_cache.read_block(1, 7, 42, buf, block_size));
+    TEST_EQUAL(small_cache.get_stats().blocks, 0);
+
+#ifndef __WIN32__
+    // Check file ids are shared for the same file and offset.
+    int fd = open(".", O_RDONLY);
+    TEST(fd >= 0);
+    int fd2 = dup(fd);
+    GlassBlockCache::file_id id = cache.acquire_file_id(fd, 0);
+    TEST_NOT_EQUAL(id, 0);
+    TEST_EQUAL(cache.acquire_file_id(fd2, 0), id);
+    GlassBlockCache::file_id id2 = cache.acquire_file_id(fd, 8192);
+    TEST_NOT_EQUAL(id2, id);
+    cache.release_file_id(id2);
+    cache.release_file_id(id);
+    // Still in use via fd2.
+    TEST_EQUAL(cache.acquire_file_id(fd, 0), id);
+    cache.release_file_id(id);
+    cache.release_file_id(id);
+    // Once released by all users, a new id should be allocated.
+    TEST_NOT_EQUAL(cache.acquire_file_id(fd, 0), id);
+    close(fd);
+    close(fd2);
+#endif
+}
+
+// Check encoding and decoding of blocks of postings.
+static void test_postingblock1()
+{
+    // Try lengths around block and SIMD boundaries, and values with each
+    // possible number of bytes.
+    for (unsigned n : { 1, 3, 4, 7, 8, 9, 31, 127, 128, 129, 300, 1000 }) {
+	for (bool have_wdfs : { false, true }) {
+	    vector<uint32_t> deltas, wdfs;
+	    string varints;
+	    uint32_t x = n;
+	    for (unsigned i = 0; i != n; ++i) {
+		x = x * 1103515245 + 12345;
+		// Shift by 0, 8, 16 or 24 bits so all lengths get used.
+		uint32_t delta = (x >> 8) >> (8 * (i % 4));
+		uint32_t wdf = (x >> 4) % (i % 3 == 0 ? 100000 : 10);
+		deltas.push_back(delta);
+		wdfs.push_back(wdf);
+		pack_uint(varints, delta);
+		if (have_wdfs) pack_uint(varints, wdf);
+	    }
+
+	    string blocks;
+	    Honey::encode_posting_blocks(varints.data(),
+					 varints.data() + varints.size(),
+					 have_wdfs, blocks);
+	    string decoded;
+	    Honey::decode_posting_blocks(blocks.data(),
+					 blocks.data() + blocks.size(),
+					 have_wdfs, decoded);
+	    TEST(decoded == varints);
+
+	    // Decode each block directly and check the docids.
+	    const char* p = blocks.data();
+	    const char* end = p + blocks.size();
+	    uint32_t did = 0;
+	    unsigned i = 0;
+	    while (p != end) {
+		unsigned count;
+		Honey::posting_block_type type;
+		Xapian::docid delta_sum;
+		const char* data_end;
+		TEST(Honey::decode_posting_block_header(&p, end, count, type,
+							 delta_sum, &data_end));
+		TEST_EQUAL(type, Honey::POSTING_BLOCK_VBYTE);
+		TEST_REL(count, <=, Honey::POSTING_BLOCK_MAX);
+		uint32_t values[Honey::POSTING_BLOCK_MAX];
+		TEST(Honey::decode_vbyte(&p, data_end, count, values));
+		Honey::docids_from_deltas(values, count, did);
+		for (unsigned j = 0; j != count; ++j) {
+		    did += deltas[i + j] + 1;
+		    TEST_EQUAL(values[j], did);
+		}
+		if (have_wdfs) {
+		    TEST(Honey::decode_vbyte(&p, data_end, count, values));
+		    for (unsigned j = 0; j != count; ++j) {
+			TEST_EQUAL(values[j], wdfs[i + j]);
+		    }
+		}
+		TEST(p == data_end);
+		i += count;
+	    }
+	    TEST_EQUAL(i, n);
+
+	    // Check truncated data is detected.
+	    p = blocks.data();
+	    unsigned count;
+	    Honey::posting_block_type type;
+	    Xapian::docid delta_sum;
+	    const char* data_end;
+	    TEST(Honey::decode_posting_block_header(&p, end, count, type,
+						     delta_sum, &data_end));
+	    uint32_t values[Honey::POSTING_BLOCK_MAX];
+	    const char* q = p;
+	    TEST(Honey::decode_vbyte(&q, data_end, count, values));
+	    const char* deltas_end = q;
+	    q = p;
+	    TEST(!Honey::decode_vbyte(&q, deltas_end - 1, count, values));
+	}
+    }
+
+    // Dense postings should be stored in bitmap blocks.
+    for (unsigned gap : { 1, 2, 3, 9, 40 }) {
+	for (bool have_wdfs : { false, true }) {
+	    vector<uint32_t> deltas;
+	    string varints;
+	    for (unsigned i = 0; i != 300; ++i) {
+		uint32_t delta = (i * 7) % gap;
+		deltas.push_back(delta);
+		pack_uint(varints, delta);
+		if (have_wdfs) pack_uint(varints, i % 5);
+	    }
+
+	    string blocks;
+	    Honey::encode_posting_blocks(varints.data(),
+					 varints.data() + varints.size(),
+					 have_wdfs, blocks);
+	    string decoded;
+	    Honey::decode_posting_blocks(blocks.data(),
+					 blocks.data() + blocks.size(),
+					 have_wdfs, decoded);
+	    TEST(decoded == varints);
+
+	    const char* p = blocks.data();
+	    const char* end = p + blocks.size();
+	    Xapian::docid did = 0;
+	    unsigned i = 0;
+	    while (p != end) {
+		unsigned count;
+		Honey::posting_block_type type;
+		Xapian::docid delta_sum;
+		const char* data_end;
+		TEST(Honey::decode_posting_block_header(&p, end, count, type,
+							 delta_sum, &data_end));
+		TEST_EQUAL(type, gap < 40 ? Honey::POSTING_BLOCK_BITMAP :
+					   Honey::POSTING_BLOCK_VBYTE);
+		if (type != Honey::POSTING_BLOCK_BITMAP) break;
+		Xapian::docid dids[Honey::POSTING_BLOCK_MAX];
+		const char* q = p;
+		TEST(!Honey::decode_bitmap_docids(&q, p + 1, count, delta_sum,
+						  did, dids));
+		TEST(Honey::decode_bitmap_docids(&p, data_end, count,
+						 delta_sum, did, dids));
+		for (unsigned j = 0; j != count; ++j) {
+		    did += deltas[i + j] + 1;
+		    TEST_EQUAL(dids[j], did);
+		}
+		p = data_end;
+		i += count;
+	    }
+	    if (gap < 40) TEST_EQUAL(i, 300);
+	}
+    }
+}
+
+// Check galloping search of docid arrays against std::lower_bound().
+static void test_docidsearch1()
+{
+    vector<Xapian::docid> dids;
+    Xapian::docid did = 0;
+    for (unsigned i = 0; i != 1000; ++i) {
+	did += 1 + (i * 7919) % 13;
+	dids.push_back(did);
+    }
+    const Xapian::docid* begin = dids.data();
+    const Xapian::docid* end = begin + dids.size();
+    TEST(find_docid_ge(begin, begin, 1) == begin);
+    for (size_t start : { 0, 1, 7, 500, 999 }) {
+	for (Xapian::docid target = 1; target <= did + 2; ++target) {
+	    auto expected = lower_bound(begin + start, end, target);
+	    TEST(find_docid_ge(begin + start, end, target) == expected);
+	}
+    }
+    // Check lengths around the SIMD widths.
+    for (size_t n = 1; n != 40; ++n) {
+	for (Xapian::docid target = 1; target <= dids[n] + 1; ++target) {
+	    auto expected = lower_bound(begin, begin + n, target);
+	    TEST(find_docid_ge(begin, begin + n, target) == expected);
+	}
+    }
+}
+
+// Check the Bloom filter used for honey tables.
+static void test_bloom1()
+{
+    // The hash is part of the on-disk format, so check it doesn't change.
+    TEST_EQUAL(HoneyBloomFilter::hash(string()), 0xefd01f60ba992926ull);
+    TEST_EQUAL(HoneyBloomFilter::hash("xapian"), 0xff8a10ddb4641628ull);
+
+    // A default constructed filter doesn't rule anything out.
+    HoneyBloomFilter empty;
+    TEST(empty.may_contain("anything"));
+
+    for (unsigned bits_per_key : { 1, 10, 16 }) {
+	const unsigned n = 10000;
+	vector<uint64_t> hashes;
+	for (unsigned i = 0; i != n; ++i) {
+	    hashes.push_back(HoneyBloomFilter::hash("K" + str(i)));
+	}
+	HoneyBloomFilter built;
+	built.build(hashes, bits_per_key);
+	TEST_REL(built.size(), >=, n * bits_per_key / 8);
+
+	// Round-trip through the serialised form.
+	string s;
+	built.serialise(s);
+	const char* p = s.data();
+	const char* end = p + s.size();
+	uint64_t num_blocks;
+	TEST(unpack_uint(&p, end, &num_blocks));
+	string blocks(p, end);
+	TEST_EQUAL(blocks.size(), HoneyBloomFilter::blocks_size(num_blocks));
+	HoneyBloomFilter filter;
+	filter.assign(num_blocks, std::move(blocks));
+
+	// There must be no false negatives.
+	for (unsigned i = 0; i != n; ++i) {
+	    TEST(filter.may_contain("K" + str(i)));
+	}
+	unsigned false_positives = 0;
+	for (unsigned i = 0; i != n; ++i) {
+	    if (filter.may_contain("A" + str(i))) ++false_positives;
+	}
+	tout << bits_per_key << " bits per key: " << false_positives
+	     << " false positives\n";
+	if (bits_per_key == 1) {
+	    // Even a tiny filter should rule out some keys.
+	    TEST_REL(false_positives, <, n);
+	} else if (bits_per_key == 10) {
+	    TEST_REL(false_positives, <, n / 50);
+	} else {
+	    TEST_REL(false_positives, <, n / 500);
+	}
+    }
+}
+
 static void test_uuid1()
 {
     Uuid uuid, uuid2;
@@ -877,6 +1169,10 @@ static const test_desc tests[] = {
     TESTCASE(strbool1),
     TESTCASE(closefrom1),
     TESTCASE(shard1),
+    TESTCASE(blockcache1),
+    TESTCASE(postingblock1),
+    TESTCASE(docidsearch1),
+    TESTCASE(bloom1),
     TESTCASE(uuid1),
     TESTCASE(movesupport1),
     TESTCASE(addoverflows1),
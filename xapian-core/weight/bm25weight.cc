@@ -184,8 +184,16 @@ double
 BM25Weight::get_maxpart() const
 {
     LOGCALL(WTCALC, double, "BM25Weight::get_maxpart", NO_ARGS);
+    RETURN(get_block_maxpart(get_wdf_upper_bound()));
+}
+
+double
+BM25Weight::get_block_maxpart(Xapian::termcount wdf_max) const
+{
+    LOGCALL(WTCALC, double, "BM25Weight::get_block_maxpart", wdf_max);
+    // The bound for the whole posting list also applies to every block.
+    wdf_max = min(wdf_max, get_wdf_upper_bound());
     double denom = param_k1;
-    Xapian::termcount wdf_max = get_wdf_upper_bound();
     if (param_k1 != 0.0) {
 	if (param_b != 0.0) {
 	    // "Upper-bound Approximations for Dynamic Pruning" Craig
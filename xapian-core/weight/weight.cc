@@ -130,6 +130,12 @@ Weight::init_(const Internal & stats, Xapian::termcount query_length,
 
 Weight::~Weight() { }
 
+double
+Weight::get_block_maxpart(Xapian::termcount) const
+{
+    return get_maxpart();
+}
+
 string
 Weight::name() const
 {